@@ -0,0 +1,1160 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2015  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AlgorithmBorderOptimize.h"
+#include "AlgorithmException.h"
+
+#include "AlgorithmBorderResample.h"
+#include "AlgorithmBorderToVertices.h"
+#include "AlgorithmCiftiCorrelationGradient.h"
+#include "AlgorithmCiftiRestrictDenseMap.h"
+#include "AlgorithmCiftiSeparate.h"
+#include "AlgorithmMetricDilate.h"
+#include "AlgorithmMetricGradient.h"
+#include "AlgorithmMetricFindClusters.h"
+#include "AlgorithmNodesInsideBorder.h"
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "AlgorithmSurfaceResample.h"
+#include "Border.h"
+#include "BorderFile.h"
+#include "CaretDataFileHelper.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CaretProfiler.h"
+#include "CiftiFile.h"
+#include "CiftiMappableDataFile.h"
+#include "EventManager.h"
+#include "EventProgressUpdate.h"
+#include "FileInformation.h"
+#include "GeodesicHelper.h"
+#include "MathFunctions.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "SurfaceProjectedItem.h"
+#include "SurfaceProjectionBarycentric.h"
+#include "SurfaceResamplingHelper.h"
+#include "TopologyHelper.h"
+
+#include <cmath>
+#include <iostream>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    void doCombination(const MetricFile& gradient, const vector<int32_t>& roiNodes, const bool& invert, const float& mapStrength, vector<float>& combinedGradData)
+    {
+        const float* gradVals = gradient.getValuePointerForColumn(0);
+        float myMin = 0.0f, myMax = 0.0f;
+        bool first = true;
+        int numSelected = (int)roiNodes.size();
+        for (int i = 0; i < numSelected; ++i)//for normalizing, gather min/max
+        {
+            float tempVal = gradVals[roiNodes[i]];
+            if (MathFunctions::isNumeric(tempVal))
+            {
+                if (first)
+                {
+                    first = false;
+                    myMin = tempVal;
+                    myMax = tempVal;
+                } else {
+                    if (tempVal < myMin) myMin = tempVal;
+                    if (tempVal > myMax) myMax = tempVal;
+                }
+            }
+        }
+        if (myMin == myMax)//if no contrast, map it all to (post-inversion) minimum - also trips if no numeric data
+        {
+            if (invert)
+            {
+                myMin -= 1.0f;
+            } else {
+                myMax += 1.0f;
+            }
+        }
+        float myRange = myMax - myMin;
+        for (int i = 0; i < numSelected; ++i)//for normalizing, gather min/max
+        {
+            float tempVal = gradVals[roiNodes[i]];
+            if (MathFunctions::isNumeric(tempVal))
+            {
+                float toCombine;
+                if (invert)
+                {
+                    toCombine = (myMax - tempVal) / myRange;
+                } else {
+                    toCombine = (tempVal - myMin) / myRange;
+                }
+                combinedGradData[roiNodes[i]] *= 1.0f + mapStrength * (toCombine - 1.0f);//equals toCombine * mapStrength + 1.0f - mapStrength
+            } else {
+                combinedGradData[roiNodes[i]] *= 1.0f - mapStrength;
+            }
+        }
+    }
+    
+    bool extractGradientData(const CaretMappableDataFile* dataFile, const int32_t& mapIndex, SurfaceFile* surface, const MetricFile* gradRoi,
+                             const float& smoothing, const MetricFile* correctedAreasMetric, MetricFile& gradientOut, const bool& skipGradient, const float& excludeDist)
+    {
+        int numNodes = surface->getNumberOfNodes();
+        MetricFile tempData, tempRoi;
+        const MetricFile* useData = &tempData, *useRoi = gradRoi;
+        switch (dataFile->getDataFileType())
+        {
+            case DataFileTypeEnum::METRIC:
+            {
+                const MetricFile* metricFile = dynamic_cast<const MetricFile*>(dataFile);
+                CaretAssert(metricFile != NULL);
+                CaretAssert(metricFile->getNumberOfNodes() == numNodes);
+                useData = metricFile;
+                break;
+            }
+            case DataFileTypeEnum::CONNECTIVITY_DENSE_SCALAR:
+            case DataFileTypeEnum::CONNECTIVITY_DENSE_TIME_SERIES:
+            {
+                tempData.setNumberOfNodesAndColumns(numNodes, 1);
+                tempData.setStructure(surface->getStructure());
+                tempRoi.setNumberOfNodesAndColumns(numNodes, 1);
+                const CiftiMappableDataFile* ciftiMappableFile = dynamic_cast<const CiftiMappableDataFile*>(dataFile);
+                CaretAssert(ciftiMappableFile != NULL);
+                CaretAssert(ciftiMappableFile->getMappingSurfaceNumberOfNodes(surface->getStructure()) == numNodes);
+                vector<float> surfData, ciftiRoi;
+                bool result = ciftiMappableFile->getMapDataForSurface(mapIndex, surface->getStructure(), surfData, &ciftiRoi);
+                CaretAssert(result);
+                if (!result)
+                {
+                    CaretLogSevere("failed to get map data for map " + AString::number(mapIndex) + " of data file of type " + DataFileTypeEnum::toName(dataFile->getDataFileType()));
+                    return false;
+                }
+                tempData.setValuesForColumn(0, surfData.data());
+                vector<float> maskedROI(numNodes);
+                const float* gradRoiData = gradRoi->getValuePointerForColumn(0);
+                for (int i = 0; i < numNodes; ++i)
+                {
+                    if (gradRoiData[i] > 0.0f)
+                    {
+                        maskedROI[i] = ciftiRoi[i];
+                    } else {
+                        maskedROI[i] = 0.0f;
+                    }
+                }
+                tempRoi.setValuesForColumn(0, maskedROI.data());
+                useRoi = &tempRoi;
+                break;
+            }
+            case DataFileTypeEnum::CONNECTIVITY_DENSE:
+            {
+                const CiftiMappableDataFile* ciftiMappableFile = dynamic_cast<const CiftiMappableDataFile*>(dataFile);
+                CaretAssert(ciftiMappableFile != NULL);
+                CaretAssert(ciftiMappableFile->getMappingSurfaceNumberOfNodes(surface->getStructure()) == numNodes);
+                const CiftiFile* dataCifti = ciftiMappableFile->getCiftiFile();
+                const MetricFile* leftRoi = NULL, *rightRoi = NULL, *cerebRoi = NULL;
+                const MetricFile* leftCorrAreas = NULL, *rightCorrAreas = NULL, *cerebCorrAreas = NULL;
+                SurfaceFile* leftSurf = NULL, *rightSurf = NULL, *cerebSurf = NULL;
+                switch (surface->getStructure())
+                {
+                    case StructureEnum::CORTEX_LEFT:
+                        leftRoi = gradRoi;
+                        leftCorrAreas = correctedAreasMetric;
+                        leftSurf = surface;
+                        break;
+                    case StructureEnum::CORTEX_RIGHT:
+                        rightRoi = gradRoi;
+                        rightCorrAreas = correctedAreasMetric;
+                        rightSurf = surface;
+                        break;
+                    case StructureEnum::CEREBELLUM:
+                        cerebRoi = gradRoi;
+                        cerebCorrAreas = correctedAreasMetric;
+                        cerebSurf = surface;
+                        break;
+                    default:
+                        CaretAssert(false);
+                        break;
+                }
+                CiftiFile restrictCifti, corrGradCifti;
+                AlgorithmCiftiRestrictDenseMap(NULL, dataCifti, CiftiXML::ALONG_COLUMN, &restrictCifti, leftRoi, rightRoi, cerebRoi, NULL);
+                AlgorithmCiftiCorrelationGradient(NULL, &restrictCifti, &corrGradCifti, leftSurf, rightSurf, cerebSurf,
+                                                  leftCorrAreas, rightCorrAreas, cerebCorrAreas, smoothing, 0.0f, false, false, excludeDist, -1.0f);
+                AlgorithmCiftiSeparate(NULL, &corrGradCifti, CiftiXML::ALONG_COLUMN, surface->getStructure(), &gradientOut);
+                return true;
+            }
+            default:
+                CaretLogWarning("ignoring map " + AString::number(mapIndex) + " of data file of type " + DataFileTypeEnum::toName(dataFile->getDataFileType()));
+                return false;
+        }
+        if (skipGradient)
+        {
+            gradientOut.setNumberOfNodesAndColumns(numNodes, 1);
+            gradientOut.setStructure(surface->getStructure());
+            gradientOut.setValuesForColumn(0, useData->getValuePointerForColumn(0));
+        } else {
+            AlgorithmMetricGradient(NULL, surface, useData, &gradientOut, NULL, smoothing, useRoi, false, 0, correctedAreasMetric);
+        }
+        return true;
+    }
+    
+    bool getStatisticsString(const CaretMappableDataFile* dataFile, const int32_t& mapIndex, const vector<int32_t> nodeLists[2],
+                             const SurfaceFile& surface, const MetricFile* correctedAreasMetric, const float& excludeDist, AString& statsOut)
+    {
+        vector<float> tempStatsStore, roiData;
+        StructureEnum::Enum structure = surface.getStructure();
+        int numNodes = surface.getNumberOfNodes();
+        const float* statsData = NULL;
+        switch (dataFile->getDataFileType())
+        {
+            case DataFileTypeEnum::METRIC:
+            {
+                const MetricFile* metricFile = dynamic_cast<const MetricFile*>(dataFile);
+                CaretAssert(metricFile != NULL);
+                statsData = metricFile->getValuePointerForColumn(mapIndex);
+                break;
+            }
+            case DataFileTypeEnum::CONNECTIVITY_DENSE_SCALAR:
+            case DataFileTypeEnum::CONNECTIVITY_DENSE_TIME_SERIES:
+            {
+                const CiftiMappableDataFile* ciftiMappableFile = dynamic_cast<const CiftiMappableDataFile*>(dataFile);
+                CaretAssert(ciftiMappableFile != NULL);
+                bool result = ciftiMappableFile->getMapDataForSurface(mapIndex, structure, tempStatsStore, &roiData);
+                CaretAssert(result);
+                if (!result)
+                {
+                    CaretLogSevere("failed to get map data for map " + AString::number(mapIndex) + " of data file of type " + DataFileTypeEnum::toName(dataFile->getDataFileType()));
+                    return false;
+                }
+                statsData = tempStatsStore.data();
+                break;
+            }
+            case DataFileTypeEnum::CONNECTIVITY_DENSE:
+            {
+                const CiftiMappableDataFile* ciftiMappableFile = dynamic_cast<const CiftiMappableDataFile*>(dataFile);
+                CaretAssert(ciftiMappableFile != NULL);
+                const CiftiFile* dataCifti = ciftiMappableFile->getCiftiFile();
+                const CiftiXML& myXML = dataCifti->getCiftiXML();
+                const CiftiBrainModelsMap& myDenseMap = myXML.getBrainModelsMap(CiftiXML::ALONG_ROW);
+                CaretAssert(myDenseMap.hasSurfaceData(structure));//the GUI should filter by structure, right?
+                int64_t rowLength = myXML.getDimensionLength(CiftiXML::ALONG_ROW);
+                vector<vector<float> > data[2];
+                for (int i = 0; i < 2; ++i)
+                {
+                    data[i].resize(nodeLists[i].size());
+                    for (int j = 0; j < (int)nodeLists[i].size(); ++j)
+                    {
+                        int64_t index = myDenseMap.getIndexForNode(nodeLists[i][j], structure);
+                        if (index != -1)//roi can go outside the cifti ROI, ignore such vertices
+                        {
+                            data[i][j].resize(rowLength);//only allocate the ones inside the cifti ROI
+                            dataCifti->getRow(data[i][j].data(), index);
+                        }
+                    }
+                }
+                vector<float> samples[2][2];
+                CaretPointer<GeodesicHelperBase> myGeoBase;
+                if (correctedAreasMetric != NULL)
+                {
+                    myGeoBase.grabNew(new GeodesicHelperBase(&surface, correctedAreasMetric->getValuePointerForColumn(0)));
+                }
+                for (int posSide = 0; posSide < 2; ++posSide)
+                {
+                    int listSize = (int)nodeLists[posSide].size();
+#pragma omp CARET_PAR
+                    {
+                        CaretPointer<GeodesicHelper> myGeoHelp;
+                        if (correctedAreasMetric != NULL)
+                        {
+                            myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
+                        } else {
+                            myGeoHelp = surface.getGeodesicHelper();
+                        }
+#pragma omp CARET_FOR schedule(dynamic)
+                        for (int i = 0; i < listSize; ++i)
+                        {
+                            if (!data[posSide][i].empty())
+                            {
+                                vector<int32_t> excludeNodes;
+                                vector<float> excludeDists;
+                                myGeoHelp->getNodesToGeoDist(nodeLists[posSide][i], excludeDist, excludeNodes, excludeDists);
+                                vector<char> excludeLookup(numNodes, 0);
+                                for (int j = 0; j < (int)excludeNodes.size(); ++j)
+                                {
+                                    excludeLookup[excludeNodes[j]] = 1;
+                                }
+                                for (int side = 0; side < 2; ++side)
+                                {
+                                    vector<double> averagerow(rowLength, 0.0);
+                                    int count = 0;
+                                    for (int j = 0; j < (int)nodeLists[side].size(); ++j)
+                                    {
+                                        if (excludeLookup[nodeLists[side][j]] == 0 && !data[side][j].empty())
+                                        {
+                                            ++count;
+                                            float* dataRef = data[side][j].data();
+                                            for (int k = 0; k < rowLength; ++k)
+                                            {
+                                                averagerow[k] += dataRef[k];
+                                            }
+                                        }
+                                    }
+                                    if (count != 0)
+                                    {
+                                        double accum1 = 0.0, accum2 = 0.0;
+                                        for (int k = 0; k < rowLength; ++k)
+                                        {
+                                            averagerow[k] /= count;
+                                            accum1 += averagerow[k];
+                                            accum2 += data[posSide][i][k];
+                                        }
+                                        float mean1 = accum1 / rowLength, mean2 = accum2 / rowLength;
+                                        accum1 = 0.0, accum2 = 0.0;
+                                        double accum3 = 0.0;
+                                        for (int k = 0; k < rowLength; ++k)
+                                        {
+                                            float val1 = averagerow[k] - mean1, val2 = data[posSide][i][k] - mean2;
+                                            accum1 += val1 * val2;
+                                            accum2 += val1 * val1;
+                                            accum3 += val2 * val2;
+                                        }
+                                        double corrval = accum1 / sqrt(accum2 * accum3);
+                                        if (corrval >= 0.999999)  corrval = 0.999999;//prevent inf
+                                        if (corrval <= -0.999999)  corrval = -0.999999;//prevent -inf
+#pragma omp critical
+                                        {
+                                            samples[posSide][side].push_back(0.5f * log((1 + corrval)/(1 - corrval)));//fisher z transform
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+                float tstats[2], cohen_ds[2], pvals[2];
+                for (int piece = 0; piece < 2; ++piece)
+                {
+                    int count[2];
+                    float mean[2], variance[2];
+                    for (int posSide = 0; posSide < 2; ++posSide)
+                    {
+                        count[posSide] = (int)samples[posSide][piece].size();
+                        if (count[posSide] < 2) return false;
+                        double accum = 0.0;
+                        for (int i = 0; i < count[posSide]; ++i)
+                        {
+                            accum += samples[posSide][piece][i];
+                        }
+                        mean[posSide] = accum / count[posSide];
+                        accum = 0.0;
+                        for (int i = 0; i < count[posSide]; ++i)
+                        {
+                            float tempf = samples[posSide][piece][i] - mean[posSide];
+                            accum += tempf * tempf;
+                        }
+                        variance[posSide] = accum / (count[posSide] - 1);
+                    }
+                    tstats[piece] = (mean[0] - mean[1]) / sqrt(variance[0] / count[0] + variance[1] / count[1]);//welch's t-test
+                    cohen_ds[piece] = (mean[0] - mean[1]) / sqrt(((count[0] - 1) * variance[0] + (count[1] - 1) * variance[1]) / (count[0] + count[1] - 2));
+                    pvals[piece] = 2.0f * MathFunctions::q_func(abs(tstats[piece]));//treat as 2-tailed z-stat, this isn't meant to be rigorous, and the t-test cdf is a pain
+                }
+                statsOut = "p1=" + AString::number(pvals[0], 'g', 3) + ", p2=" + AString::number(pvals[1], 'g', 3) +
+                           ", t1=" + AString::number(tstats[0], 'g', 3) + ", t2=" + AString::number(tstats[1], 'g', 3) +
+                           ", d1=" + AString::number(cohen_ds[0], 'g', 3) + ", d2=" + AString::number(cohen_ds[1], 'g', 3);
+                return true;
+            }
+            default:
+                CaretLogWarning("statistics: ignoring data file of type " + DataFileTypeEnum::toName(dataFile->getDataFileType()));
+                return false;
+        }
+        float mean[2], variance[2];
+        int count[2] = {0, 0};
+        for (int piece = 0; piece < 2; ++piece)
+        {
+            double accum = 0.0;
+            for (int i = 0; i < (int)nodeLists[piece].size(); ++i)
+            {
+                if (roiData.empty() || roiData[nodeLists[piece][i]] > 0.0f)
+                {
+                    accum += statsData[nodeLists[piece][i]];//weight by vertex area?  weighted welch's t-test, oh joy
+                    ++count[piece];
+                }
+            }
+            mean[piece] = accum / count[piece];
+            accum = 0.0;
+            for (int i = 0; i < (int)nodeLists[piece].size(); ++i)
+            {
+                if (roiData.empty() || roiData[nodeLists[piece][i]] > 0.0f)
+                {
+                    float tempf = (statsData[nodeLists[piece][i]] - mean[piece]);
+                    accum += tempf * tempf;
+                }
+            }
+            variance[piece] = accum / (count[piece] - 1);
+        }
+        float tstat = (mean[0] - mean[1]) / sqrt(variance[0] / count[0] + variance[1] / count[1]);//welch's t-test
+        float cohen_d = (mean[0] - mean[1]) / sqrt(((count[0] - 1) * variance[0] + (count[1] - 1) * variance[1]) / (count[0] + count[1] - 2));
+        float pval = 2.0f * MathFunctions::q_func(abs(tstat));//treat as 2-tailed z-stat, this isn't meant to be rigorous, and the t-test cdf is a pain
+        statsOut = "p=" + AString::number(pval, 'g', 3) + ", t=" + AString::number(tstat, 'g', 3) + ", d=" + AString::number(cohen_d, 'g', 3);
+        return true;
+    }
+    
+    int getBorderPointNode(const Border* theBorder, const int& index)
+    {
+        CaretAssert(index >= 0 && index < theBorder->getNumberOfPoints());
+        const SurfaceProjectionBarycentric* thisBary = theBorder->getPoint(index)->getBarycentricProjection();
+        CaretAssert(thisBary != NULL && thisBary->isValid());
+        int thisNode = thisBary->getNodeWithLargestWeight();
+        CaretAssert(thisNode >= 0);
+        return thisNode;
+    }
+    
+    struct BorderRedrawInfo
+    {
+        int startpoint, endpoint;
+    };
+
+    int findSinglePartBorder(const BorderFile* borderFile, const AString& borderName)
+    {
+        int ret = -1;
+        int numBorders = borderFile->getNumberOfBorders();
+        for (int i = 0; i < numBorders; ++i)
+        {
+            if (borderFile->getBorder(i)->getName() == borderName)
+            {
+                if (ret != -1)
+                {
+                    throw AlgorithmException("border '" + borderName + "' has multiple parts, only single-part borders can be used");
+                }
+                ret = i;
+            }
+        }
+        if (ret == -1)
+        {
+            throw AlgorithmException("border '" + borderName + "' not found in border file");
+        }
+        return ret;
+    }
+
+    void reportStage(LevelProgress& myProgress, const int& percentDone, const AString& message)
+    {//the progress event is how the GUI shows progress and requests cancellation, nothing listens to it on the command line
+        myProgress.setTask(message);
+        myProgress.reportProgress(percentDone / 100.0f);
+        EventProgressUpdate tempEvent(0, 100, percentDone, message);
+        EventManager::get()->sendEvent(&tempEvent);
+        if (tempEvent.isCancelled())
+        {
+            throw AlgorithmException("cancelled by user");
+        }
+    }
+}
+
+AString AlgorithmBorderOptimize::getCommandSwitch()
+{
+    return "-border-optimize";
+}
+
+AString AlgorithmBorderOptimize::getShortDescription()
+{
+    return "OPTIMIZE BORDERS TO FOLLOW GRADIENTS IN DATA";
+}
+
+OperationParameters* AlgorithmBorderOptimize::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+
+    ret->addSurfaceParameter(1, "surface", "the surface to compute gradients and draw borders on");
+
+    ret->addBorderParameter(2, "border-file", "the border file containing the borders to optimize and the roi border");
+
+    ret->addStringParameter(3, "roi-border", "name of the closed border that encloses the region to optimize within");
+
+    ret->addBorderOutputParameter(4, "border-out", "output - a copy of the border file, with the optimized borders modified");
+
+    ParameterComponent* borderOpt = ret->createRepeatableParameter(5, "-border", "specify a border to optimize");
+    borderOpt->addStringParameter(1, "name", "the name of the border");
+
+    ParameterComponent* dataOpt = ret->createRepeatableParameter(6, "-data", "specify a data file to compute a gradient from");
+    dataOpt->addStringParameter(1, "data-file", "a metric, dense scalar, dense timeseries, or dense connectivity file");
+    OptionalParameter* mapOpt = dataOpt->createOptionalParameter(2, "-map", "use only one map of the file");
+    mapOpt->addStringParameter(1, "map", "the map number or name");
+    OptionalParameter* smoothOpt = dataOpt->createOptionalParameter(3, "-smoothing", "smooth the data before computing the gradient");
+    smoothOpt->addDoubleParameter(1, "kernel", "the sigma for the gaussian smoothing kernel, in mm (default 1)");
+    OptionalParameter* weightOpt = dataOpt->createOptionalParameter(4, "-weight", "set the strength of this file in the combined gradient");
+    weightOpt->addDoubleParameter(1, "weight", "the weight, from 0 to 1 (default 0.7)");
+    dataOpt->createOptionalParameter(5, "-invert", "follow the minimum of the gradient instead of the maximum");
+    dataOpt->createOptionalParameter(6, "-skip-gradient", "use the data values directly instead of their gradient");
+    OptionalParameter* excludeOpt = dataOpt->createOptionalParameter(7, "-exclude-distance", "dense connectivity only: set the correlation gradient exclusion distance");
+    excludeOpt->addDoubleParameter(1, "distance", "geodesic distance in mm to exclude around each vertex (default 2)");
+
+    OptionalParameter* areasOpt = ret->createOptionalParameter(7, "-vertex-areas", "use vertex areas other than the areas of the surface");
+    areasOpt->addMetricParameter(1, "area-metric", "metric containing the vertex areas to use");
+
+    OptionalParameter* upsampleOpt = ret->createOptionalParameter(8, "-upsample", "redraw the borders on an upsampled mesh");
+    upsampleOpt->addSurfaceParameter(1, "sphere", "a sphere surface with the mesh of <surface>");
+    upsampleOpt->addIntegerParameter(2, "num-vertices", "the number of vertices in the upsampled mesh");
+
+    OptionalParameter* strengthOpt = ret->createOptionalParameter(9, "-gradient-following-strength", "set how strongly the redrawn borders follow the combined gradient");
+    strengthOpt->addDoubleParameter(1, "strength", "the strength (default 5)");
+
+    OptionalParameter* pairOpt = ret->createOptionalParameter(10, "-border-pair", "compute statistics between the two regions the optimized borders split the roi into");
+    pairOpt->addStringParameter(1, "border-1", "name of a closed border mostly inside the first region");
+    pairOpt->addStringParameter(2, "border-2", "name of a closed border mostly inside the second region");
+
+    OptionalParameter* gradOutOpt = ret->createOptionalParameter(11, "-gradient-out", "output the combined gradient");
+    gradOutOpt->addMetricOutputParameter(1, "metric-out", "the combined gradient metric");
+
+    ret->setHelpText(
+        AString("Redraws the part of each specified border that lies inside the roi border so that it follows the ridge of a combined gradient.  ") +
+        "Each -data file contributes the gradient of its selected map (all maps when -map is not specified), normalized within the roi, and the " +
+        "contributions are multiplied together.  " +
+        "Each border must have exactly one contiguous section inside the roi, and all borders must be single-part borders.  " +
+        "When -border-pair is specified, statistics comparing the two regions of the roi on each data map are printed to standard output.  " +
+        "The borders are redrawn in parallel."
+    );
+    return ret;
+}
+
+void AlgorithmBorderOptimize::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    SurfaceFile* mySurf = myParams->getSurface(1);
+    BorderFile* myBorderFile = myParams->getBorder(2);
+    AString roiBorderName = myParams->getString(3);
+    BorderFile* myBorderOut = myParams->getOutputBorder(4);
+    const vector<ParameterComponent*>& borderInstances = *(myParams->getRepeatableParameterInstances(5));
+    if (borderInstances.empty())
+    {
+        throw AlgorithmException("you must specify at least one border to optimize");
+    }
+    vector<int> borderIndices;
+    vector<const Border*> bordersToOptimize;
+    for (int i = 0; i < (int)borderInstances.size(); ++i)
+    {
+        int index = findSinglePartBorder(myBorderFile, borderInstances[i]->getString(1));
+        borderIndices.push_back(index);
+        bordersToOptimize.push_back(myBorderFile->getBorder(index));
+    }
+    const Border* roiBorder = myBorderFile->getBorder(findSinglePartBorder(myBorderFile, roiBorderName));
+    const vector<ParameterComponent*>& dataInstances = *(myParams->getRepeatableParameterInstances(6));
+    if (dataInstances.empty())
+    {
+        throw AlgorithmException("you must specify at least one data file");
+    }
+    vector<CaretPointer<CaretDataFile> > dataFileStore(dataInstances.size());//keep the files alive until the algorithm finishes
+    vector<DataInput> dataInputs;
+    for (int i = 0; i < (int)dataInstances.size(); ++i)
+    {
+        AString fileName = dataInstances[i]->getString(1);
+        dataFileStore[i].grabNew(CaretDataFileHelper::readAnyCaretDataFile(fileName, true));//dense connectivity files are rarely small enough to read entirely
+        const CaretMappableDataFile* mapFile = dynamic_cast<const CaretMappableDataFile*>(dataFileStore[i].getPointer());
+        if (mapFile == NULL)
+        {
+            throw AlgorithmException("file '" + fileName + "' is not a mappable data file");
+        }
+        switch (mapFile->getDataFileType())
+        {
+            case DataFileTypeEnum::METRIC:
+                if (dynamic_cast<const MetricFile*>(mapFile)->getNumberOfNodes() != mySurf->getNumberOfNodes())
+                {
+                    throw AlgorithmException("metric file '" + fileName + "' does not match the surface");
+                }
+                break;
+            case DataFileTypeEnum::CONNECTIVITY_DENSE:
+            case DataFileTypeEnum::CONNECTIVITY_DENSE_SCALAR:
+            case DataFileTypeEnum::CONNECTIVITY_DENSE_TIME_SERIES:
+                if (dynamic_cast<const CiftiMappableDataFile*>(mapFile)->getMappingSurfaceNumberOfNodes(mySurf->getStructure()) != mySurf->getNumberOfNodes())
+                {
+                    throw AlgorithmException("file '" + fileName + "' has no data for structure " + StructureEnum::toName(mySurf->getStructure()) +
+                                             " with the number of vertices in the surface");
+                }
+                break;
+            default:
+                throw AlgorithmException("file '" + fileName + "' is not a metric, dense scalar, dense timeseries, or dense connectivity file");
+        }
+        int32_t mapIndex = 0;
+        bool allMaps = true;
+        OptionalParameter* mapOpt = dataInstances[i]->getOptionalParameter(2);
+        if (mapOpt->m_present)
+        {
+            mapIndex = mapFile->getMapIndexFromNameOrNumber(mapOpt->getString(1));
+            if (mapIndex < 0)
+            {
+                throw AlgorithmException("invalid map number or name specified for file '" + fileName + "'");
+            }
+            allMaps = false;
+        }
+        float smoothing = 1.0f, weight = 0.7f, excludeDist = 2.0f;
+        OptionalParameter* smoothOpt = dataInstances[i]->getOptionalParameter(3);
+        if (smoothOpt->m_present)
+        {
+            smoothing = (float)smoothOpt->getDouble(1);
+        }
+        OptionalParameter* weightOpt = dataInstances[i]->getOptionalParameter(4);
+        if (weightOpt->m_present)
+        {
+            weight = (float)weightOpt->getDouble(1);
+            if (weight < 0.0f || weight > 1.0f)
+            {
+                throw AlgorithmException("weight must be between 0 and 1");
+            }
+        }
+        bool invert = dataInstances[i]->getOptionalParameter(5)->m_present;
+        bool skipGradient = dataInstances[i]->getOptionalParameter(6)->m_present;
+        OptionalParameter* excludeOpt = dataInstances[i]->getOptionalParameter(7);
+        if (excludeOpt->m_present)
+        {
+            excludeDist = (float)excludeOpt->getDouble(1);
+        }
+        dataInputs.push_back(DataInput(mapFile, mapIndex, allMaps, smoothing, weight, invert, skipGradient, excludeDist));
+    }
+    MetricFile* correctedAreas = NULL;
+    OptionalParameter* areasOpt = myParams->getOptionalParameter(7);
+    if (areasOpt->m_present)
+    {
+        correctedAreas = areasOpt->getMetric(1);
+    }
+    SurfaceFile* upsampleSphere = NULL;
+    int upsampleResolution = 0;
+    OptionalParameter* upsampleOpt = myParams->getOptionalParameter(8);
+    if (upsampleOpt->m_present)
+    {
+        upsampleSphere = upsampleOpt->getSurface(1);
+        upsampleResolution = (int)upsampleOpt->getInteger(2);
+    }
+    float followStrength = 5.0f;
+    OptionalParameter* strengthOpt = myParams->getOptionalParameter(9);
+    if (strengthOpt->m_present)
+    {
+        followStrength = (float)strengthOpt->getDouble(1);
+    }
+    vector<const Border*> borderPair;
+    OptionalParameter* pairOpt = myParams->getOptionalParameter(10);
+    if (pairOpt->m_present)
+    {
+        borderPair.push_back(myBorderFile->getBorder(findSinglePartBorder(myBorderFile, pairOpt->getString(1))));
+        borderPair.push_back(myBorderFile->getBorder(findSinglePartBorder(myBorderFile, pairOpt->getString(2))));
+    }
+    MetricFile* gradientOut = NULL;
+    OptionalParameter* gradOutOpt = myParams->getOptionalParameter(11);
+    if (gradOutOpt->m_present)
+    {
+        gradientOut = gradOutOpt->getOutputMetric(1);
+    }
+    vector<int32_t> nodesInsideROI;
+    AlgorithmNodesInsideBorder(NULL, mySurf, roiBorder, false, nodesInsideROI);
+    vector<Border> optimizedBorders;
+    AString statistics;
+    AlgorithmBorderOptimize(myProgObj, mySurf, bordersToOptimize, nodesInsideROI, dataInputs, optimizedBorders, statistics,
+                            correctedAreas, followStrength, upsampleSphere, upsampleResolution, gradientOut, borderPair);
+    *myBorderOut = *myBorderFile;
+    for (int i = 0; i < (int)borderIndices.size(); ++i)
+    {
+        Border* outBorder = myBorderOut->getBorder(borderIndices[i]);
+        outBorder->removeAllPoints();
+        outBorder->addPoints(&optimizedBorders[i]);
+    }
+    if (!statistics.isEmpty())
+    {
+        cout << qPrintable(statistics) << endl;
+    }
+}
+
+AlgorithmBorderOptimize::AlgorithmBorderOptimize(ProgressObject* myProgObj, SurfaceFile* computeSurf, const vector<const Border*>& bordersToOptimize,
+                                                 const vector<int32_t>& nodesInsideROI, const vector<DataInput>& dataInputs,
+                                                 vector<Border>& optimizedBordersOut, AString& statisticsOut, const MetricFile* correctedAreasMetric,
+                                                 const float& gradientFollowingStrength, const SurfaceFile* upsamplingSphere, const int& upsamplingResolution,
+                                                 MetricFile* combinedGradientOut, const vector<const Border*>& statisticsBorderPair) : AbstractAlgorithm(myProgObj)
+{
+    CaretProfileSpan mySpan("AlgorithmBorderOptimize", "compute");
+    LevelProgress myProgress(myProgObj);
+    statisticsOut.clear();
+    optimizedBordersOut.clear();
+    int32_t numNodes = computeSurf->getNumberOfNodes();
+    int numSelected = (int)nodesInsideROI.size();
+    if (numSelected < 1)
+    {
+        throw AlgorithmException("no vertices selected");
+    }
+    if (correctedAreasMetric != NULL && correctedAreasMetric->getNumberOfNodes() != numNodes)
+    {
+        throw AlgorithmException("vertex areas metric does not match surface in number of vertices");
+    }
+    if (statisticsBorderPair.size() != 0 && statisticsBorderPair.size() != 2)
+    {
+        throw AlgorithmException("statistics border pair must contain exactly two borders");
+    }
+    vector<float> roiData(numNodes, 0.0f);
+    vector<float> combinedGradData(numNodes, 0.0f);
+    for (int i = 0; i < numSelected; ++i)
+    {
+        roiData[nodesInsideROI[i]] = 1.0f;
+        combinedGradData[nodesInsideROI[i]] = 1.0f;//also initialize only the inside-roi parts of the gradient combining function, leaving the outside 0
+    }
+    int numBorders = (int)bordersToOptimize.size();
+    vector<BorderRedrawInfo> myRedrawInfo(numBorders);
+    const int SEGMENT_PROGRESS = 10;
+    const int COMPUTE_PROGRESS = 55;
+    const int HELPER_PROGRESS = 5;
+    const int DRAW_PROGRESS = 10;
+    const int STATISTICS_PROGRESS = 20;
+    CaretAssert(SEGMENT_PROGRESS + COMPUTE_PROGRESS + HELPER_PROGRESS + DRAW_PROGRESS + STATISTICS_PROGRESS == 100);
+    for (int i = 0; i < numBorders; ++i)
+    {//find pieces of border to redraw, before doing gradient, so it can error early
+        const Border* thisBorder = bordersToOptimize[i];
+        reportStage(myProgress, (SEGMENT_PROGRESS * i) / numBorders, "finding in-roi segment of border '" + thisBorder->getName() + "'");
+        int numPoints = thisBorder->getNumberOfPoints();
+        int start, end;
+        if (thisBorder->isClosed())
+        {
+            if (numPoints < 3)//one outside, two inside will work
+            {
+                throw AlgorithmException("Border '" + thisBorder->getName() + "' has too few points to adjust");
+            }
+            for (start = numPoints - 1; start >= 0; --start)//search backwards for a point outside the roi
+            {
+                if (!(roiData[getBorderPointNode(thisBorder, start)] > 0.0f)) break;
+            }
+            if (start == -1)//no points outside ROI
+            {
+                throw AlgorithmException("Border '" + thisBorder->getName() + "' has no points outside the ROI");
+            }
+            int added;
+            for (added = 1; added < numPoints; ++added)//search forward from it to find the point inside the roi - if the above loop had to loop, this will end on the first iteration
+            {
+                int pointIndex = (start + added) % numPoints;//closed border requires mod arithmetic
+                if (roiData[getBorderPointNode(thisBorder, pointIndex)] > 0.0f) break;
+            }
+            if (added == numPoints)//no points inside ROI
+            {//NOTE: if multipart borders are used, and passed borders don't check the parts for being in/out, then this name is not unique
+                throw AlgorithmException("Border '" + thisBorder->getName() + "' has no points inside the ROI");
+            }
+            start = (start + added) % numPoints;
+            for (added = 1; added < numPoints; ++added)
+            {
+                int pointIndex = (start + added) % numPoints;
+                if (!(roiData[getBorderPointNode(thisBorder, pointIndex)] > 0.0f)) break;
+            }
+            CaretAssert(added != numPoints);//we have points inside and outside roi, this search should have stopped
+            end = (start + added - 1) % numPoints;//we will check this for being equal to start later, first check for multiple sections
+            for (; added < numPoints; ++added)
+            {
+                int pointIndex = (start + added) % numPoints;
+                if (roiData[getBorderPointNode(thisBorder, pointIndex)] > 0.0f)
+                {
+                    throw AlgorithmException("Border '" + thisBorder->getName() + "' has multiple sections inside the ROI");
+                }
+            }
+            if (end == start)
+            {
+                throw AlgorithmException("Border '" + thisBorder->getName() + "' has only one point inside the ROI");
+            }
+            if (getBorderPointNode(thisBorder, start) == getBorderPointNode(thisBorder, end))
+            {
+                throw AlgorithmException("Border '" + thisBorder->getName() + "' enters and exits the ROI too close to the same vertex");
+            }
+        } else {//open border
+            if (numPoints < 2)//two, both inside, will work
+            {
+                throw AlgorithmException("Border '" + thisBorder->getName() + "' has too few points to adjust");
+            }
+            for (start = 0; start < numPoints; ++start)//search for first point inside
+            {
+                if (roiData[getBorderPointNode(thisBorder, start)] > 0.0f) break;
+            }
+            if (start == numPoints)
+            {//NOTE: if multipart borders are used, and passed borders don't check the parts for being in/out, then this name is not unique
+                throw AlgorithmException("Border '" + thisBorder->getName() + "' has no points inside the ROI");
+            }
+            for (end = start + 1; end < numPoints; ++end)//search for first point outside
+            {
+                if (!(roiData[getBorderPointNode(thisBorder, end)] > 0.0f)) break;
+            }
+            --end;//and subtract one to get inclusive range, also deals with == numPoints
+            for (int check = end + 2; check < numPoints; ++check)//look for a second piece inside
+            {
+                if (roiData[getBorderPointNode(thisBorder, check)] > 0.0f)
+                {
+                    throw AlgorithmException("Border '" + thisBorder->getName() + "' has multiple sections inside the ROI");
+                }
+            }
+        }
+        myRedrawInfo[i].startpoint = start;
+        myRedrawInfo[i].endpoint = end;
+    }
+    int numInputs = (int)dataInputs.size();
+    MetricFile inputRoi, dilatedRoi;
+    inputRoi.setNumberOfNodesAndColumns(numNodes, 1);
+    inputRoi.setValuesForColumn(0, roiData.data());
+    AlgorithmMetricDilate(NULL, &inputRoi, computeSurf, 0.0001f, &dilatedRoi);//dilate roi by 1 neighbor
+    for (int i = 0; i < numInputs; ++i)
+    {//the gradient algorithms are parallel internally, and AlgorithmMetricGradient updates the surface normals, so inputs are processed one at a time
+        const DataInput& thisInput = dataInputs[i];
+        reportStage(myProgress, SEGMENT_PROGRESS + (COMPUTE_PROGRESS * i) / numInputs, "processing data file '" + thisInput.m_mapFile->getFileNameNoPath() + "'");
+        int mapStart = thisInput.m_mapIndex, mapEnd = thisInput.m_mapIndex + 1;
+        if (thisInput.m_allMaps)
+        {
+            mapStart = 0;
+            mapEnd = thisInput.m_mapFile->getNumberOfMaps();
+        }
+        for (int j = mapStart; j < mapEnd; ++j)
+        {
+            MetricFile tempGradient;
+            if (extractGradientData(thisInput.m_mapFile, j, computeSurf, &dilatedRoi, thisInput.m_smoothing, correctedAreasMetric, tempGradient,
+                                    thisInput.m_skipGradient, thisInput.m_corrGradExcludeDist))
+            {
+                doCombination(tempGradient, nodesInsideROI, thisInput.m_invertGradient, thisInput.m_weight, combinedGradData);
+            }
+        }
+    }
+    if (combinedGradientOut != NULL)
+    {
+        combinedGradientOut->setNumberOfNodesAndColumns(numNodes, 1);
+        combinedGradientOut->setStructure(computeSurf->getStructure());
+        combinedGradientOut->setValuesForColumn(0, combinedGradData.data());
+    }
+    const SurfaceFile* drawSurf = computeSurf;
+    SurfaceFile highresSphere, highresMidthick;
+    vector<float> drawGrad = combinedGradData, drawRoi = roiData;
+    vector<float> origAreasStore, highresAreasStore;
+    const float* origAreas = NULL;
+    if (correctedAreasMetric != NULL)
+    {
+        origAreas = correctedAreasMetric->getValuePointerForColumn(0);
+    }
+    const float* drawAreas = origAreas;
+    if (upsamplingSphere != NULL)
+    {
+        if (upsamplingSphere->getNumberOfNodes() != numNodes)
+        {
+            throw AlgorithmException("upsampling sphere does not match surface in number of vertices");
+        }
+        if (upsamplingSphere->getNumberOfNodes() >= upsamplingResolution)
+        {
+            throw AlgorithmException("upsampling number of vertices must be greater than current vertex count");
+        }
+        AlgorithmSurfaceCreateSphere(NULL, upsamplingResolution, &highresSphere);
+        int highresNumNodes = highresSphere.getNumberOfNodes();
+        highresSphere.setStructure(upsamplingSphere->getStructure());
+        AlgorithmSurfaceResample(NULL, computeSurf, upsamplingSphere, &highresSphere, SurfaceResamplingMethodEnum::BARYCENTRIC, &highresMidthick);
+        if (origAreas == NULL)
+        {
+            computeSurf->computeNodeAreas(origAreasStore);
+            origAreas = origAreasStore.data();
+            highresMidthick.computeNodeAreas(highresAreasStore);
+        } else {
+            vector<float> origRatioStore(origAreas, origAreas + numNodes), highresRatioStore(highresNumNodes), wrongAreas, highresWrongAreas;
+            computeSurf->computeNodeAreas(wrongAreas);//to get high res corrected areas, convert to expansion ratio,
+            highresMidthick.computeNodeAreas(highresWrongAreas);//then resample and multiply by the high res surface areas
+            for (int i = 0; i < numNodes; ++i)
+            {
+                origRatioStore[i] /= wrongAreas[i];
+            }//we don't have anything high res but the wrong areas yet, so use like area measures - expansion ratio should be fairly smooth anyway, so not as important
+            SurfaceResamplingHelper initialUpsampler(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, upsamplingSphere, &highresSphere, wrongAreas.data(), highresWrongAreas.data());
+            initialUpsampler.resampleNormal(origRatioStore.data(), highresRatioStore.data());
+            highresAreasStore.resize(highresNumNodes);
+            for (int i = 0; i < highresNumNodes; ++i)
+            {
+                highresAreasStore[i] = highresRatioStore[i] * highresWrongAreas[i];
+            }
+        }
+        drawSurf = &highresMidthick;
+        drawAreas = highresAreasStore.data();
+        drawGrad.resize(highresNumNodes);
+        drawRoi.resize(highresNumNodes);
+        SurfaceResamplingHelper finalUpsampler(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, upsamplingSphere, &highresSphere, origAreas, highresAreasStore.data(), roiData.data());
+        finalUpsampler.resampleNormal(combinedGradData.data(), drawGrad.data());
+        finalUpsampler.getResampleValidROI(drawRoi.data());
+    }
+    reportStage(myProgress, SEGMENT_PROGRESS + COMPUTE_PROGRESS, "generating geodesic helper");
+    CaretPointer<GeodesicHelperBase> myGeoBase;
+    if (correctedAreasMetric != NULL)
+    {
+        myGeoBase.grabNew(new GeodesicHelperBase(drawSurf, drawAreas));
+    }
+    CaretPointer<TopologyHelper> myTopoHelp = drawSurf->getTopologyHelper();
+    vector<const Border*> drawOrigBorders = bordersToOptimize;
+    BorderFile highresOrigBorders;
+    if (upsamplingSphere != NULL)
+    {//first, copy all borders and resample to get endpoint positions on high res mesh, then draw new segments as borders and downsample just the segments
+        BorderFile origBorders;
+        for (int i = 0; i < numBorders; ++i)
+        {
+            origBorders.addBorder(new Border(*(bordersToOptimize[i])));
+        }
+        AlgorithmBorderResample(NULL, &origBorders, upsamplingSphere, &highresSphere, &highresOrigBorders);//NOTE: this must keep each border and point intact and in the same order, just on the new sphere
+        for (int i = 0; i < numBorders; ++i)
+        {
+            drawOrigBorders[i] = highresOrigBorders.getBorder(i);
+        }
+    }
+    reportStage(myProgress, SEGMENT_PROGRESS + COMPUTE_PROGRESS + HELPER_PROGRESS, "redrawing border segments");
+    vector<int32_t> pathStartNodes(numBorders), pathEndNodes(numBorders);
+    for (int i = 0; i < numBorders; ++i)
+    {
+        pathStartNodes[i] = getBorderPointNode(drawOrigBorders[i], myRedrawInfo[i].startpoint);
+        pathEndNodes[i] = getBorderPointNode(drawOrigBorders[i], myRedrawInfo[i].endpoint);
+    }
+    vector<vector<int32_t> > pathNodes(numBorders);
+    {
+        CaretProfileSpan pathSpan("AlgorithmBorderOptimize path following", "compute");
+#pragma omp CARET_PAR
+        {
+            CaretPointer<GeodesicHelper> myGeoHelp;//a helper can only do one search at a time
+            if (myGeoBase != NULL)
+            {
+                myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
+            } else {
+                myGeoHelp = drawSurf->getGeodesicHelper();
+            }
+            const float* drawGradData = drawGrad.data(), *drawRoiData = drawRoi.data();
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int i = 0; i < numBorders; ++i)
+            {//each border writes only its own path, so the result doesn't depend on the number of threads
+                vector<float> dists;
+                myGeoHelp->getPathFollowingData(pathStartNodes[i], pathEndNodes[i], drawGradData, pathNodes[i], dists,
+                                                gradientFollowingStrength, drawRoiData, true, true);
+            }
+        }
+    }
+    vector<float> roiMinusTracesData = drawRoi;
+    BorderFile redrawnSegments;
+    for (int i = 0; i < numBorders; ++i)
+    {
+        const vector<int32_t>& nodes = pathNodes[i];
+        if (nodes.size() < 3)//require at least 1 surviving point after removing endpoints
+        {
+            throw AlgorithmException("Unable to redraw border segment for border '" + bordersToOptimize[i]->getName() + "'");//use non-resampled borders for name, just in case
+        }
+        CaretPointer<Border> redrawnSegment(new Border());
+        for (int j = 1; j < (int)nodes.size() - 1; ++j)//drop the closest node to the start and end points from the redrawn segment
+        {
+            const vector<int32_t>& nodeTiles = myTopoHelp->getNodeTiles(nodes[j]);
+            CaretAssert(!nodeTiles.empty());
+            const int32_t* tileNodes = drawSurf->getTriangle(nodeTiles[0]);
+            int whichNode;
+            for (whichNode = 0; whichNode < 3; ++whichNode)
+            {
+                if (tileNodes[whichNode] == nodes[j]) break;
+            }
+            CaretAssert(whichNode < 3);//it should always find it
+            float weights[3] = { 0.0f, 0.0f, 0.0f };
+            weights[whichNode] = 1.0f;
+            SurfaceProjectedItem* myItem = new SurfaceProjectedItem();
+            myItem->getBarycentricProjection()->setTriangleNodes(tileNodes);//none of these should throw
+            myItem->getBarycentricProjection()->setTriangleAreas(weights);
+            myItem->getBarycentricProjection()->setValid(true);
+            myItem->setStructure(computeSurf->getStructure());
+            redrawnSegment->addPoint(myItem);
+        }
+        redrawnSegments.addBorder(redrawnSegment.releasePointer());
+        const Border* redrawnSegmentRef = redrawnSegments.getBorder(i);
+        int numOrigPoints = bordersToOptimize[i]->getNumberOfPoints();
+        Border fullRedrawn = *(drawOrigBorders[i]);//use the potentially upsampled version for the ROI splitting, but don't re-downsample it as the modified border on the current mesh
+        fullRedrawn.removeAllPoints();
+        if (!(bordersToOptimize[i]->isClosed()))//if it is a closed border, start with the newly drawn section, for simplicity
+        {
+            for (int j = 0; j <= myRedrawInfo[i].startpoint; ++j)//include the original startpoint
+            {
+                fullRedrawn.addPoint(new SurfaceProjectedItem(*(drawOrigBorders[i]->getPoint(j))));
+            }
+        }
+        fullRedrawn.addPoints(redrawnSegmentRef);
+        if (bordersToOptimize[i]->isClosed())
+        {//mod arithmetic for closed borders
+            int numKeep = ((numOrigPoints + myRedrawInfo[i].startpoint - myRedrawInfo[i].endpoint) % numOrigPoints) + 1;//inclusive
+            for (int j = 0; j < numKeep; ++j)
+            {
+                fullRedrawn.addPoint(new SurfaceProjectedItem(*(drawOrigBorders[i]->getPoint((j + myRedrawInfo[i].endpoint) % numOrigPoints))));
+            }
+        } else {
+            for (int j = myRedrawInfo[i].endpoint; j < numOrigPoints; ++j)//include original endpoint
+            {
+                fullRedrawn.addPoint(new SurfaceProjectedItem(*(drawOrigBorders[i]->getPoint(j))));
+            }
+        }
+        MetricFile borderTrace;
+        BorderFile tempBorderFile;
+        tempBorderFile.addBorder(new Border(fullRedrawn));//because it takes ownership of a pointer
+        AlgorithmBorderToVertices(NULL, drawSurf, &tempBorderFile, &borderTrace);
+        const float* traceData = borderTrace.getValuePointerForColumn(0);
+        int drawNumNodes = drawSurf->getNumberOfNodes();
+        for (int j = 0; j < drawNumNodes; ++j)
+        {
+            if (traceData[j] > 0.0f)
+            {
+                roiMinusTracesData[j] = 0.0f;
+            }
+        }
+    }
+    BorderFile* segmentsToUse = &redrawnSegments;
+    BorderFile downsampledSegments;
+    if (upsamplingSphere != NULL)
+    {
+        AlgorithmBorderResample(NULL, &redrawnSegments, &highresSphere, upsamplingSphere, &downsampledSegments);
+        segmentsToUse = &downsampledSegments;
+    }
+    optimizedBordersOut.resize(numBorders);
+    for (int i = 0; i < numBorders; ++i)
+    {
+        Border& modifiedBorder = optimizedBordersOut[i];
+        modifiedBorder = *(bordersToOptimize[i]);
+        int numOrigPoints = bordersToOptimize[i]->getNumberOfPoints();
+        modifiedBorder.removeAllPoints();//keep name, color, class, etc
+        if (!(bordersToOptimize[i]->isClosed()))//if it is a closed border, start with the newly drawn section, for simplicity
+        {
+            for (int j = 0; j <= myRedrawInfo[i].startpoint; ++j)//include the original startpoint
+            {
+                modifiedBorder.addPoint(new SurfaceProjectedItem(*(bordersToOptimize[i]->getPoint(j))));
+            }
+        }
+        modifiedBorder.addPoints(segmentsToUse->getBorder(i));
+        if (bordersToOptimize[i]->isClosed())
+        {//mod arithmetic for closed borders
+            int numKeep = ((numOrigPoints + myRedrawInfo[i].startpoint - myRedrawInfo[i].endpoint) % numOrigPoints) + 1;//inclusive
+            for (int j = 0; j < numKeep; ++j)
+            {
+                modifiedBorder.addPoint(new SurfaceProjectedItem(*(bordersToOptimize[i]->getPoint((j + myRedrawInfo[i].endpoint) % numOrigPoints))));
+            }
+        } else {
+            for (int j = myRedrawInfo[i].endpoint; j < numOrigPoints; ++j)//include original endpoint
+            {
+                modifiedBorder.addPoint(new SurfaceProjectedItem(*(bordersToOptimize[i]->getPoint(j))));
+            }
+        }
+    }
+    MetricFile roiMinusBorderTraces, roiMetric, drawAreasMetric;
+    roiMinusBorderTraces.setNumberOfNodesAndColumns(roiMinusTracesData.size(), 1);
+    roiMinusBorderTraces.setValuesForColumn(0, roiMinusTracesData.data());
+    roiMetric.setNumberOfNodesAndColumns(drawRoi.size(), 1);
+    roiMetric.setValuesForColumn(0, drawRoi.data());
+    const MetricFile* drawAreasMetricPtr = NULL;
+    if (drawAreas != NULL)
+    {
+        drawAreasMetric.setNumberOfNodesAndColumns(drawSurf->getNumberOfNodes(), 1);
+        drawAreasMetric.setValuesForColumn(0, drawAreas);
+        drawAreasMetricPtr = &drawAreasMetric;
+    }
+    MetricFile clustersMetric;
+    int endVal = 0;
+    AlgorithmMetricFindClusters(NULL, drawSurf, &roiMinusBorderTraces, 0.5f, 10.0f, &clustersMetric, false, &roiMetric, drawAreasMetricPtr, 0, 1, &endVal);
+    if (endVal != 3)
+    {
+        statisticsOut = AString::number(endVal - 1) + " cluster(s) found after splitting the roi with the redrawn borders, skipping statistics";
+        return;
+    }
+    const float* clusterData = clustersMetric.getValuePointerForColumn(0);
+    vector<float> downsampledClusters;
+    if (upsamplingSphere != NULL)
+    {
+        SurfaceResamplingHelper downsampler(SurfaceResamplingMethodEnum::ADAP_BARY_AREA, &highresSphere, upsamplingSphere, highresAreasStore.data(), origAreas, drawRoi.data());
+        vector<int32_t> highresData(highresSphere.getNumberOfNodes()), downsampledData(numNodes);
+        for (int i = 0; i < (int)highresData.size(); ++i)
+        {
+            highresData[i] = floor(clusterData[i] + 0.5f);
+        }
+        downsampler.resamplePopular(highresData.data(), downsampledData.data());
+        downsampledClusters.resize(numNodes);
+        for (int i = 0; i < (int)downsampledData.size(); ++i)
+        {
+            downsampledClusters[i] = downsampledData[i];
+        }
+        clusterData = downsampledClusters.data();
+    }
+    vector<int32_t> nodeLists[2];
+    for (int i = 0; i < numNodes; ++i)
+    {
+        int label = (int)floor(clusterData[i] + 0.5f);
+        CaretAssert(label < 3);
+        if (label > 0) nodeLists[label - 1].push_back(i);
+    }
+    vector<int32_t> orderedNodeLists[2];
+    if (nodeLists[0].size() >= nodeLists[1].size())
+    {
+        orderedNodeLists[0] = nodeLists[0];
+        orderedNodeLists[1] = nodeLists[1];
+    } else {
+        orderedNodeLists[0] = nodeLists[1];
+        orderedNodeLists[1] = nodeLists[0];
+    }
+    if (statisticsBorderPair.size() != 2) return;
+    vector<int32_t> insideBorderNodes;
+    AlgorithmNodesInsideBorder(NULL, computeSurf, statisticsBorderPair[0], false, insideBorderNodes);
+    vector<char> insideLookup(numNodes, 0);
+    for (int i = 0; i < (int)insideBorderNodes.size(); ++i)
+    {
+        insideLookup[insideBorderNodes[i]] = 1;
+    }
+    int counts[2] = {0, 0};
+    for (int whichList = 0; whichList < 2; ++whichList)
+    {
+        for (int i = 0; i < (int)orderedNodeLists[whichList].size(); ++i)
+        {
+            if (insideLookup[orderedNodeLists[whichList][i]] != 0)
+            {
+                ++counts[whichList];
+            }
+        }
+    }
+    if (counts[0] >= counts[1])
+    {
+        statisticsOut += statisticsBorderPair[0]->getName() + " n=" + AString::number(orderedNodeLists[0].size()) + ", " +
+                         statisticsBorderPair[1]->getName() + " n=" + AString::number(orderedNodeLists[1].size()) + "\n\n";
+    } else {
+        statisticsOut += statisticsBorderPair[1]->getName() + " n=" + AString::number(orderedNodeLists[0].size()) + ", " +
+                         statisticsBorderPair[0]->getName() + " n=" + AString::number(orderedNodeLists[1].size()) + "\n\n";
+    }
+    if (orderedNodeLists[0].size() < 2 || orderedNodeLists[1].size() < 2)
+    {
+        statisticsOut += "roi pieces are too small for statistics";
+        return;
+    }
+    for (int i = 0; i < numInputs; ++i)
+    {
+        const DataInput& thisInput = dataInputs[i];
+        reportStage(myProgress, SEGMENT_PROGRESS + COMPUTE_PROGRESS + HELPER_PROGRESS + DRAW_PROGRESS + (STATISTICS_PROGRESS * i) / numInputs,
+                    "computing statistics on file '" + thisInput.m_mapFile->getFileNameNoPath() + "'");
+        AString fileDescription = thisInput.m_mapFile->getFileNameNoPath() + ", " + FileInformation(thisInput.m_mapFile->getFileName()).getLastDirectory();
+        if (thisInput.m_allMaps)
+        {
+            for (int j = 0; j < thisInput.m_mapFile->getNumberOfMaps(); ++j)
+            {
+                AString statsOut;
+                if (getStatisticsString(thisInput.m_mapFile, j, orderedNodeLists, *computeSurf, correctedAreasMetric, thisInput.m_corrGradExcludeDist, statsOut))
+                {
+                    statisticsOut += statsOut + ": " + thisInput.m_mapFile->getMapName(j) + ", " + fileDescription + "\n";
+                }
+            }
+            statisticsOut += "\n";
+        } else {
+            AString statsOut;
+            if (getStatisticsString(thisInput.m_mapFile, thisInput.m_mapIndex, orderedNodeLists, *computeSurf, correctedAreasMetric, thisInput.m_corrGradExcludeDist, statsOut))
+            {
+                statisticsOut += statsOut + ": " + thisInput.m_mapFile->getMapName(thisInput.m_mapIndex) + ", " + fileDescription + "\n\n";
+            }
+        }
+    }
+}
+
+float AlgorithmBorderOptimize::getAlgorithmInternalWeight()
+{
+    return 1.0f;//override this if needed, if the progress bar isn't smooth
+}
+
+float AlgorithmBorderOptimize::getSubAlgorithmWeight()
+{
+    return 0.0f;//subalgorithms are called without progress objects
+}
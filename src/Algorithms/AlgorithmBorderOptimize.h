@@ -0,0 +1,74 @@
+#ifndef __ALGORITHM_BORDER_OPTIMIZE_H__
+#define __ALGORITHM_BORDER_OPTIMIZE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2015  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AbstractAlgorithm.h"
+
+#include <vector>
+
+namespace caret {
+
+    class Border;
+    class CaretMappableDataFile;
+
+    class AlgorithmBorderOptimize : public AbstractAlgorithm
+    {
+        AlgorithmBorderOptimize();
+    protected:
+        static float getSubAlgorithmWeight();
+        static float getAlgorithmInternalWeight();
+    public:
+        ///a data map (or all maps of a file) whose gradient is combined into the function the borders follow
+        struct DataInput
+        {
+            DataInput(const CaretMappableDataFile* mapFile, const int32_t& mapIndex, const bool& allMaps, const float& smoothing, const float& weight,
+                      const bool& invertGradient, const bool& skipGradient, const float& corrGradExcludeDist)
+            : m_mapFile(mapFile), m_mapIndex(mapIndex), m_allMaps(allMaps), m_smoothing(smoothing), m_weight(weight),
+            m_invertGradient(invertGradient), m_skipGradient(skipGradient), m_corrGradExcludeDist(corrGradExcludeDist)
+            { }
+            const CaretMappableDataFile* m_mapFile;
+            int32_t m_mapIndex;
+            bool m_allMaps;
+            float m_smoothing;
+            float m_weight;
+            bool m_invertGradient;
+            bool m_skipGradient;
+            float m_corrGradExcludeDist;
+        };
+
+        ///optimizedBordersOut gets a modified copy of each border, in the same order, the input borders are not changed
+        AlgorithmBorderOptimize(ProgressObject* myProgObj, SurfaceFile* computeSurf, const std::vector<const Border*>& bordersToOptimize,
+                                const std::vector<int32_t>& nodesInsideROI, const std::vector<DataInput>& dataInputs,
+                                std::vector<Border>& optimizedBordersOut, AString& statisticsOut, const MetricFile* correctedAreasMetric = NULL,
+                                const float& gradientFollowingStrength = 5.0f, const SurfaceFile* upsamplingSphere = NULL, const int& upsamplingResolution = 0,
+                                MetricFile* combinedGradientOut = NULL, const std::vector<const Border*>& statisticsBorderPair = std::vector<const Border*>());
+        static OperationParameters* getParameters();
+        static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
+        static AString getCommandSwitch();
+        static AString getShortDescription();
+    };
+
+    typedef TemplateAutoOperation<AlgorithmBorderOptimize> AutoAlgorithmBorderOptimize;
+
+}
+
+#endif //__ALGORITHM_BORDER_OPTIMIZE_H__
@@ -22,15 +22,92 @@
 #include "AlgorithmException.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "CaretPointer.h"
 #include "CiftiFile.h"
+#include "GroupReduction.h"
 #include "MathFunctions.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int64_t BLOCK_MEMORY_BYTES = ((int64_t)1) << 28;//bounds the buffers of one row block, across all inputs
+    
+    int64_t getRowsPerBlock(const int64_t& bytesPerRow, const int64_t& numRows)
+    {
+        return max((int64_t)1, min(numRows, BLOCK_MEMORY_BYTES / max((int64_t)1, bytesPerRow)));
+    }
+    
+    void getBlockIndices(const int64_t& firstRow, const int64_t& blockRows, vector<int64_t>& indicesOut)
+    {
+        indicesOut.resize(blockRows);
+        for (int64_t i = 0; i < blockRows; ++i)
+        {
+            indicesOut[i] = firstRow + i;
+        }
+    }
+    
+    void checkInputs(const vector<const CiftiFile*>& ciftiList, const vector<float>* weightsPtr, const vector<const CiftiFile*>* excludeMasks)
+    {
+        if (weightsPtr != NULL && ciftiList.size() != weightsPtr->size())
+        {
+            throw AlgorithmException("number of weights doesn't match number of input cifti files");
+        }
+        if (excludeMasks != NULL && ciftiList.size() != excludeMasks->size())
+        {
+            throw AlgorithmException("number of exclusion masks doesn't match number of input cifti files");
+        }
+        CaretAssert(ciftiList[0] != NULL);
+        const CiftiXML& baseXML = ciftiList[0]->getCiftiXML();
+        if (baseXML.getNumberOfDimensions() != 2) throw AlgorithmException("cifti average currently only supports 2D files");
+        for (int i = 0; i < (int)ciftiList.size(); ++i)
+        {
+            CaretAssert(ciftiList[i] != NULL);
+            if (i > 0 && !baseXML.approximateMatch(ciftiList[i]->getCiftiXML()))//requires at least length to match, often more restrictive
+            {
+                throw AlgorithmException("cifti file '" + ciftiList[i]->getFileName() + "' does not match earlier inputs");
+            }
+            if (excludeMasks != NULL && (*excludeMasks)[i] != NULL && !baseXML.approximateMatch((*excludeMasks)[i]->getCiftiXML()))
+            {
+                throw AlgorithmException("exclusion mask '" + (*excludeMasks)[i]->getFileName() + "' does not match its input");
+            }
+        }
+    }
+    
+    //reads one input's block, and its mask if it has one, returns the mask pointer to use
+    const float* readBlock(const vector<const CiftiFile*>& ciftiList, const vector<const CiftiFile*>* excludeMasks, const int& which,
+                           const vector<int64_t>& blockIndices, float* dataOut, float* maskScratch)
+    {
+        ciftiList[which]->getRows(dataOut, blockIndices);
+        if (excludeMasks == NULL || (*excludeMasks)[which] == NULL) return NULL;
+        (*excludeMasks)[which]->getRows(maskScratch, blockIndices);
+        return maskScratch;
+    }
+    
+    void writeBlock(CiftiFile* ciftiOut, CiftiFile* varianceOut, const GroupReduction& myReduction, float* scratch, const int64_t& firstRow, const int64_t& blockRows, const int64_t& rowSize)
+    {
+        myReduction.getMean(scratch);
+        for (int64_t i = 0; i < blockRows; ++i)
+        {
+            ciftiOut->setRow(scratch + i * rowSize, firstRow + i);
+        }
+        if (varianceOut != NULL)
+        {
+            myReduction.getVariance(scratch);
+            for (int64_t i = 0; i < blockRows; ++i)
+            {
+                varianceOut->setRow(scratch + i * rowSize, firstRow + i);
+            }
+        }
+    }
+}
+
 AString AlgorithmCiftiAverage::getCommandSwitch()
 {
     return "-cifti-average";
@@ -57,11 +134,20 @@ OperationParameters* AlgorithmCiftiAverage::getParameters()
     OptionalParameter* weightOpt = ciftiOpt->createOptionalParameter(1, "-weight", "give a weight for this file");
     weightOpt->addDoubleParameter(1, "weight", "the weight to use");
     
+    OptionalParameter* maskOpt = ciftiOpt->createOptionalParameter(2, "-exclude-mask", "leave out elements of this file");
+    maskOpt->addCiftiParameter(1, "mask", "cifti file matching the input, positive values mark elements to leave out");
+    
+    OptionalParameter* varOpt = ret->createOptionalParameter(4, "-var-out", "also output the weighted variance across files");
+    varOpt->addCiftiOutputParameter(1, "var-out", "output cifti file for the variance");
+    
     ret->setHelpText(
         AString("Averages cifti files together.  ") +
         "Files without -weight specified are given a weight of 1.  " +
         "If -exclude-outliers is specified, at each element, the data across all files is taken as a set, its unweighted mean and sample standard deviation are found, " +
-        "and values outside the specified number of standard deviations are excluded from the (potentially weighted) average at that element."
+        "and values outside the specified number of standard deviations are excluded from the (potentially weighted) average at that element.  " +
+        "Elements where a file's -exclude-mask is positive are treated as missing for that file, including when finding outliers.  " +
+        "The -var-out option uses the same weights and exclusions as the average, and is unbiased for the weights used (the sample variance when all weights are 1).  " +
+        "Each file is read in large blocks of rows, and the sums are accumulated in parallel."
     );
     return ret;
 }
@@ -71,6 +157,8 @@ void AlgorithmCiftiAverage::useParameters(OperationParameters* myParams, Progres
     CiftiFile* ciftiOut = myParams->getOutputCifti(1);
     vector<const CiftiFile*> ciftiList;//this is just so that it can pass them to the algorithm
     vector<float> weights;
+    vector<const CiftiFile*> masks;
+    bool haveMask = false;
     const vector<ParameterComponent*>& myInstances = *(myParams->getRepeatableParameterInstances(3));
     for (int i = 0; i < (int)myInstances.size(); ++i)
     {
@@ -82,183 +170,154 @@ void AlgorithmCiftiAverage::useParameters(OperationParameters* myParams, Progres
         } else {
             weights.push_back(1.0f);
         }
+        OptionalParameter* maskOpt = myInstances[i]->getOptionalParameter(2);
+        if (maskOpt->m_present)
+        {
+            masks.push_back(maskOpt->getCifti(1));
+            haveMask = true;
+        } else {
+            masks.push_back(NULL);
+        }
+    }
+    CiftiFile* varianceOut = NULL;
+    OptionalParameter* varOpt = myParams->getOptionalParameter(4);
+    if (varOpt->m_present)
+    {
+        varianceOut = varOpt->getOutputCifti(1);
     }
     OptionalParameter* excludeOpt = myParams->getOptionalParameter(2);
     if (excludeOpt->m_present)
     {
-        AlgorithmCiftiAverage(myProgObj, ciftiList, excludeOpt->getDouble(1), excludeOpt->getDouble(2), ciftiOut, &weights);
+        AlgorithmCiftiAverage(myProgObj, ciftiList, excludeOpt->getDouble(1), excludeOpt->getDouble(2), ciftiOut, &weights, (haveMask ? &masks : NULL), varianceOut);
     } else {
-        AlgorithmCiftiAverage(myProgObj, ciftiList, ciftiOut, &weights);
+        AlgorithmCiftiAverage(myProgObj, ciftiList, ciftiOut, &weights, (haveMask ? &masks : NULL), varianceOut);
     }
 }
 
-AlgorithmCiftiAverage::AlgorithmCiftiAverage(ProgressObject* myProgObj, const vector<const CiftiFile*>& ciftiList, CiftiFile* ciftiOut, const vector<float>* weightsPtr) : AbstractAlgorithm(myProgObj)
+AlgorithmCiftiAverage::AlgorithmCiftiAverage(ProgressObject* myProgObj, const vector<const CiftiFile*>& ciftiList, CiftiFile* ciftiOut, const vector<float>* weightsPtr,
+                                             const vector<const CiftiFile*>* excludeMasks, CiftiFile* varianceOut) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     if (ciftiList.size() == 0)
     {
         throw AlgorithmException("no files specified");
     }
-    if (weightsPtr != NULL && ciftiList.size() != weightsPtr->size())
-    {
-        throw AlgorithmException("number of weights doesn't match number of input cifti files");
-    }
-    CaretAssert(ciftiList[0] != NULL);
+    checkInputs(ciftiList, weightsPtr, excludeMasks);
     CiftiXML baseXML = ciftiList[0]->getCiftiXML();
-    if (baseXML.getNumberOfDimensions() != 2) throw AlgorithmException("cifti average currently only supports 2D files");
     int numRows = baseXML.getDimensionLength(CiftiXML::ALONG_COLUMN), rowSize = baseXML.getDimensionLength(CiftiXML::ALONG_ROW), numFiles = (int)ciftiList.size();
-    for (int i = 1; i < numFiles; ++i)
-    {
-        CaretAssert(ciftiList[i] != NULL);
-        if (!baseXML.approximateMatch(ciftiList[i]->getCiftiXML()))//requires at least length to match, often more restrictive
-        {
-            throw AlgorithmException("cifti file '" + ciftiList[i]->getFileName() + "' does not match earlier inputs");
-        }
-    }
     ciftiOut->setCiftiXML(baseXML);
-    vector<double> accum(rowSize);
-    vector<float> myrow(rowSize);
-    for (int i = 0; i < numRows; ++i)
+    if (varianceOut != NULL) varianceOut->setCiftiXML(baseXML);
+    //read each input as one contiguous block of rows at a time, rather than interleaving single rows across all inputs
+    const int64_t rowsPerBlock = getRowsPerBlock(rowSize * (2 * sizeof(float) + (varianceOut != NULL ? 4 : 2) * sizeof(double)), numRows);
+    vector<float> blockIn(rowsPerBlock * rowSize), maskScratch(excludeMasks != NULL ? rowsPerBlock * rowSize : 0);
+    GroupReduction myReduction(0, varianceOut != NULL);
+    vector<int64_t> blockIndices;
+    for (int64_t firstRow = 0; firstRow < numRows; firstRow += rowsPerBlock)
     {
-        vector<double> weightaccum(rowSize, 0.0);
-        for (int j = 0; j < rowSize; ++j)
-        {
-            accum[j] = 0.0;
-        }
+        const int64_t blockRows = min(rowsPerBlock, numRows - firstRow);
+        getBlockIndices(firstRow, blockRows, blockIndices);
+        myReduction.reset(blockRows * rowSize);
         for (int j = 0; j < numFiles; ++j)
-        {
-            ciftiList[j]->getRow(myrow.data(), i);
-            if (weightsPtr == NULL)
-            {
-                for (int k = 0; k < rowSize; ++k)
-                {
-                    if (MathFunctions::isNumeric(myrow[k]))
-                    {
-                        weightaccum[k] += 1.0;
-                        accum[k] += myrow[k];
-                    }
-                }
-            } else {
-                float weight = (*weightsPtr)[j];
-                for (int k = 0; k < rowSize; ++k)
-                {
-                    if (MathFunctions::isNumeric(myrow[k]))
-                    {
-                        weightaccum[k] += weight;
-                        accum[k] += myrow[k] * weight;
-                    }
-                }
-            }
-        }
-        for (int k = 0; k < rowSize; ++k)
-        {
-            if (weightaccum[k] != 0.0)
-            {
-                myrow[k] = accum[k] / weightaccum[k];
-            } else {
-                myrow[k] = 0.0f;
-            }
+        {//file access stays serial, only the accumulation is parallel
+            const float* mask = readBlock(ciftiList, excludeMasks, j, blockIndices, blockIn.data(), maskScratch.data());
+            myReduction.addInput(blockIn.data(), (weightsPtr == NULL ? 1.0f : (*weightsPtr)[j]), mask);
         }
-        ciftiOut->setRow(myrow.data(), i);
+        writeBlock(ciftiOut, varianceOut, myReduction, blockIn.data(), firstRow, blockRows, rowSize);
     }
 }
 
 AlgorithmCiftiAverage::AlgorithmCiftiAverage(ProgressObject* myProgObj, const vector<const CiftiFile*>& ciftiList,
                                              const float& sigmaBelow, const float& sigmaAbove,
-                                             CiftiFile* ciftiOut, const std::vector<float>* weightsPtr): AbstractAlgorithm(myProgObj)
+                                             CiftiFile* ciftiOut, const std::vector<float>* weightsPtr,
+                                             const vector<const CiftiFile*>* excludeMasks, CiftiFile* varianceOut): AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     if (ciftiList.size() < 2)
     {
         throw AlgorithmException("fewer than 2 files specified with outlier exclusion");
     }
-    if (weightsPtr != NULL && ciftiList.size() != weightsPtr->size())
-    {
-        throw AlgorithmException("number of weights doesn't match number of input cifti files");
-    }
-    CaretAssert(ciftiList[0] != NULL);
+    checkInputs(ciftiList, weightsPtr, excludeMasks);
     CiftiXML baseXML = ciftiList[0]->getCiftiXML();
-    if (baseXML.getNumberOfDimensions() != 2) throw AlgorithmException("cifti average currently only supports 2D files");
     int numRows = baseXML.getDimensionLength(CiftiXML::ALONG_COLUMN), rowSize = baseXML.getDimensionLength(CiftiXML::ALONG_ROW), numFiles = (int)ciftiList.size();
-    for (int i = 1; i < numFiles; ++i)
-    {
-        CaretAssert(ciftiList[i] != NULL);
-        if (!baseXML.approximateMatch(ciftiList[i]->getCiftiXML()))
-        {
-            throw AlgorithmException("cifti files do not match");
-        }
-    }
     bool haveWarned = false;
     ciftiOut->setCiftiXML(baseXML);
-    vector<vector<float> > myrows(numFiles, vector<float>(rowSize));
-    for (int i = 0; i < numRows; ++i)
+    if (varianceOut != NULL) varianceOut->setCiftiXML(baseXML);
+    //the mean and deviation for exclusion need every input at once, so the block size is limited by the number of files
+    const int64_t rowsPerBlock = getRowsPerBlock(rowSize * ((numFiles + 4) * sizeof(float) + (varianceOut != NULL ? 4 : 2) * sizeof(double)), numRows);
+    const int64_t blockAlloc = rowsPerBlock * rowSize;
+    vector<vector<float> > blocksIn(numFiles, vector<float>(blockAlloc));
+    vector<float> cutoffLow(blockAlloc), cutoffHigh(blockAlloc), maskScratch(blockAlloc), blockOut(blockAlloc);
+    GroupReduction myReduction(0, varianceOut != NULL);
+    vector<int64_t> blockIndices;
+    for (int64_t firstRow = 0; firstRow < numRows; firstRow += rowsPerBlock)
     {
+        const int64_t blockRows = min(rowsPerBlock, numRows - firstRow);
+        const int64_t blockSize = blockRows * rowSize;
+        getBlockIndices(firstRow, blockRows, blockIndices);
         for (int j = 0; j < numFiles; ++j)
         {
-            ciftiList[j]->getRow(myrows[j].data(), i);
+            const float* mask = readBlock(ciftiList, excludeMasks, j, blockIndices, blocksIn[j].data(), maskScratch.data());
+            if (mask != NULL)
+            {//masked values are missing for this file, so they don't affect the outlier cutoffs either
+                for (int64_t k = 0; k < blockSize; ++k)
+                {
+                    if (mask[k] > 0.0f) blocksIn[j][k] = numeric_limits<float>::quiet_NaN();
+                }
+            }
         }
-        vector<float> outrow(rowSize);
-        for (int k = 0; k < rowSize; ++k)
+        bool needWarning = false;
+#pragma omp CARET_PARFOR schedule(static) reduction(||:needWarning)
+        for (int64_t k = 0; k < blockSize; ++k)
         {
             double accum = 0.0;
-            double weightaccum = 0.0;
             int nonnumeric = 0;
             for (int j = 0; j < numFiles; ++j)
             {
-                if (MathFunctions::isNumeric(myrows[j][k]))
+                if (MathFunctions::isNumeric(blocksIn[j][k]))
                 {
-                    accum += myrows[j][k];
+                    accum += blocksIn[j][k];
                 } else {
                     ++nonnumeric;
                 }
             }
             if (nonnumeric >= numFiles - 1)
             {
-                if (!haveWarned)
-                {
-                    CaretLogWarning("found element where less than 2 files have numeric values");
-                    haveWarned = true;
-                }
-                outrow[k] = 0.0f;
+                needWarning = true;
+                cutoffLow[k] = numeric_limits<float>::quiet_NaN();//NaN cutoffs exclude everything, so the output is zero
+                cutoffHigh[k] = numeric_limits<float>::quiet_NaN();
             } else {
                 float mean = accum / (numFiles - nonnumeric);
                 accum = 0.0;
                 for (int j = 0; j < numFiles; ++j)
                 {
-                    if (MathFunctions::isNumeric(myrows[j][k]))
+                    if (MathFunctions::isNumeric(blocksIn[j][k]))
                     {
-                        float temp = myrows[j][k] - mean;
+                        float temp = blocksIn[j][k] - mean;
                         accum += temp * temp;
                     }
                 }
                 float stdev = sqrt(accum / (numFiles - 1 - nonnumeric));
-                float cutoffLow = mean - sigmaBelow * stdev;
-                float cutoffHigh = mean + sigmaAbove * stdev;
-                accum = 0.0;
-                for (int j = 0; j < numFiles; ++j)
-                {
-                    if (myrows[j][k] > cutoffLow && myrows[j][k] < cutoffHigh)//implicitly excludes NaN and inf
-                    {
-                        if (weightsPtr != NULL)
-                        {
-                            float weight = (*weightsPtr)[j];
-                            accum += myrows[j][k] * weight;
-                            weightaccum += weight;
-                        } else {
-                            accum += myrows[j][k];
-                            weightaccum += 1.0;
-                        }
-                    }
-                }
-                if (weightaccum != 0.0)
-                {
-                    outrow[k] = accum / weightaccum;
-                } else {
-                    outrow[k] = 0.0f;
-                }
+                cutoffLow[k] = mean - sigmaBelow * stdev;
+                cutoffHigh[k] = mean + sigmaAbove * stdev;
+            }
+        }
+        if (needWarning && !haveWarned)
+        {
+            CaretLogWarning("found element where less than 2 files have numeric values");
+            haveWarned = true;
+        }
+        myReduction.reset(blockSize);
+        for (int j = 0; j < numFiles; ++j)
+        {
+            const float* thisBlock = blocksIn[j].data();
+#pragma omp CARET_PARFOR schedule(static)
+            for (int64_t k = 0; k < blockSize; ++k)
+            {
+                maskScratch[k] = ((thisBlock[k] > cutoffLow[k] && thisBlock[k] < cutoffHigh[k]) ? 0.0f : 1.0f);//implicitly excludes NaN and inf
             }
+            myReduction.addInput(thisBlock, (weightsPtr == NULL ? 1.0f : (*weightsPtr)[j]), maskScratch.data());
         }
-        ciftiOut->setRow(outrow.data(), i);
+        writeBlock(ciftiOut, varianceOut, myReduction, blockOut.data(), firstRow, blockRows, rowSize);
     }
 }
 
@@ -33,8 +33,11 @@ namespace caret {
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
     public:
-        AlgorithmCiftiAverage(ProgressObject* myProgObj, const std::vector<const CiftiFile*>& ciftiList, CiftiFile* ciftiOut, const std::vector<float>* weightsPtr = NULL);
-        AlgorithmCiftiAverage(ProgressObject* myProgObj, const std::vector<const CiftiFile*>& ciftiList, const float& sigmaBelow, const float& sigmaAbove, CiftiFile* ciftiOut, const std::vector<float>* weightsPtr = NULL);
+        ///excludeMasks, if given, has one entry per input (NULL for no mask), elements where the mask is positive are left out for that input
+        AlgorithmCiftiAverage(ProgressObject* myProgObj, const std::vector<const CiftiFile*>& ciftiList, CiftiFile* ciftiOut, const std::vector<float>* weightsPtr = NULL,
+                              const std::vector<const CiftiFile*>* excludeMasks = NULL, CiftiFile* varianceOut = NULL);
+        AlgorithmCiftiAverage(ProgressObject* myProgObj, const std::vector<const CiftiFile*>& ciftiList, const float& sigmaBelow, const float& sigmaAbove, CiftiFile* ciftiOut, const std::vector<float>* weightsPtr = NULL,
+                              const std::vector<const CiftiFile*>* excludeMasks = NULL, CiftiFile* varianceOut = NULL);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
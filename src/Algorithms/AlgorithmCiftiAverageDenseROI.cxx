@@ -27,6 +27,7 @@
 #include "MetricFile.h"
 #include "VolumeFile.h"
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -398,6 +399,43 @@ void AlgorithmCiftiAverageDenseROI::verifySurfaceComponent(const CiftiFile* myCi
     }
 }
 
+namespace
+{
+    struct WeightedRow
+    {
+        int64_t m_row;
+        vector<float> m_weights;//one per roi map, zero means the row isn't in that roi
+        bool operator<(const WeightedRow& rhs) const { return m_row < rhs.m_row; }
+    };
+    
+    class RoiMapWeights : public CiftiFile::RowSumWeights
+    {
+        const vector<WeightedRow>& m_rowList;
+    public:
+        RoiMapWeights(const vector<WeightedRow>& rowList) : m_rowList(rowList) { }
+        float getWeight(const int& sumIndex, const int64_t& rowPosition) const { return m_rowList[rowPosition].m_weights[sumIndex]; }
+    };
+    
+    void accumulateWeightedRows(vector<vector<double> >& accum, vector<double>& denom, const CiftiFile* myCifti, vector<WeightedRow>& rowList)
+    {
+        if (rowList.empty()) return;
+        sort(rowList.begin(), rowList.end());//getRows needs sorted indices, and sorted order lets it merge adjacent rows into one read
+        const int numMaps = (int)accum.size();
+        const int64_t numRows = (int64_t)rowList.size();
+        vector<int64_t> rowIndices(numRows);
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            rowIndices[i] = rowList[i].m_row;
+            for (int m = 0; m < numMaps; ++m)
+            {
+                denom[m] += rowList[i].m_weights[m];
+            }
+        }
+        RoiMapWeights myWeights(rowList);
+        myCifti->sumWeightedRows(rowIndices, myWeights, accum);
+    }
+}
+
 void AlgorithmCiftiAverageDenseROI::processSurfaceComponent(vector<vector<double> >& accum, vector<double>& denom, const CiftiFile* myCifti, const StructureEnum::Enum& myStruct, const MetricFile* myRoi, const float* myAreas)
 {
     const CiftiXML& myXml = myCifti->getCiftiXML();
@@ -408,61 +446,35 @@ void AlgorithmCiftiAverageDenseROI::processSurfaceComponent(vector<vector<double
         return;
     }
     if (myRoi->getNumberOfNodes() != brainModelsMap.getSurfaceNumberOfNodes(myStruct)) throw AlgorithmException("cifti number of vertices does not match roi");
-    int rowSize = myXml.getDimensionLength(CiftiXML::ALONG_ROW);
-    vector<float> rowScratch(rowSize);
-    CaretAssert(rowScratch.size() == accum[0].size());
+    CaretAssert(myXml.getDimensionLength(CiftiXML::ALONG_ROW) == (int64_t)accum[0].size());
     vector<CiftiBrainModelsMap::SurfaceMap> myMap = brainModelsMap.getSurfaceMap(myStruct);
     int mapSize = (int)myMap.size();
     int numMaps = myRoi->getNumberOfMaps();
-    if (myAreas == NULL)
+    vector<WeightedRow> rowList;
+    WeightedRow tempRow;
+    tempRow.m_weights.resize(numMaps);
+    for (int i = 0; i < mapSize; ++i)
     {
-        for (int i = 0; i < mapSize; ++i)
+        const int& myNode = myMap[i].m_surfaceNode;
+        bool inAnyROI = false;
+        for (int m = 0; m < numMaps; ++m)
         {
-            const int& myNode = myMap[i].m_surfaceNode;
-            bool dataLoaded = false;
-            for (int m = 0; m < numMaps; ++m)
+            const float roiVal = myRoi->getValue(myNode, m);
+            if (roiVal != 0.0f)
             {
-                const float roiVal = myRoi->getValue(myNode, m);
-                if (roiVal != 0.0f)
-                {
-                    if (!dataLoaded)
-                    {
-                        myCifti->getRow(rowScratch.data(), myMap[i].m_ciftiIndex);
-                        dataLoaded = true;
-                    }
-                    for (int j = 0; j < rowSize; ++j)
-                    {
-                        accum[m][j] += rowScratch[j] * roiVal;
-                    }
-                    denom[m] += roiVal;
-                }
+                tempRow.m_weights[m] = (myAreas == NULL ? roiVal : roiVal * myAreas[myNode]);
+                inAnyROI = true;
+            } else {
+                tempRow.m_weights[m] = 0.0f;
             }
         }
-    } else {
-        for (int i = 0; i < mapSize; ++i)
+        if (inAnyROI)
         {
-            const int& myNode = myMap[i].m_surfaceNode;
-            bool dataLoaded = false;
-            for (int m = 0; m < numMaps; ++m)
-            {
-                const float& roiVal = myRoi->getValue(myNode, m);
-                if (roiVal != 0.0f)
-                {
-                    const float weight = roiVal * myAreas[myMap[i].m_surfaceNode];
-                    if (!dataLoaded)
-                    {
-                        myCifti->getRow(rowScratch.data(), myMap[i].m_ciftiIndex);
-                        dataLoaded = true;
-                    }
-                    for (int j = 0; j < rowSize; ++j)
-                    {
-                        accum[m][j] += rowScratch[j] * weight;
-                    }
-                    denom[m] += weight;
-                }
-            }
+            tempRow.m_row = myMap[i].m_ciftiIndex;
+            rowList.push_back(tempRow);
         }
     }
+    accumulateWeightedRows(accum, denom, myCifti, rowList);
 }
 
 void AlgorithmCiftiAverageDenseROI::verifyVolumeComponent(const CiftiFile* myCifti, const VolumeFile* volROI)
@@ -479,34 +491,30 @@ void AlgorithmCiftiAverageDenseROI::processVolumeComponent(vector<vector<double>
     CaretAssert(myXml.getMappingType(CiftiXML::ALONG_COLUMN) == CiftiMappingType::BRAIN_MODELS);//should be checked in the algorithm constructor
     const CiftiBrainModelsMap& brainModelsMap = myXml.getBrainModelsMap(CiftiXML::ALONG_COLUMN);
     if (!volROI->matchesVolumeSpace(brainModelsMap.getVolumeSpace())) throw AlgorithmException("cifti files don't match the ROI volume's space");
-    int rowSize = myXml.getDimensionLength(CiftiXML::ALONG_ROW);
-    vector<float> rowScratch(rowSize);
-    CaretAssert(rowScratch.size() == accum[0].size());
+    CaretAssert(myXml.getDimensionLength(CiftiXML::ALONG_ROW) == (int64_t)accum[0].size());
     vector<CiftiBrainModelsMap::VolumeMap> myMap = brainModelsMap.getFullVolumeMap();
     int mapSize = (int)myMap.size();
     int numMaps = volROI->getNumberOfMaps();
+    vector<WeightedRow> rowList;
+    WeightedRow tempRow;
+    tempRow.m_weights.resize(numMaps);
     for (int i = 0; i < mapSize; ++i)
     {
-        bool dataLoaded = false;
         if (!volROI->indexValid(myMap[i].m_ijk)) throw AlgorithmException("cifti file lists invalid voxels");
+        bool inAnyROI = false;
         for (int m = 0; m < numMaps; ++m)
         {
             const float& roiVal = volROI->getValue(myMap[i].m_ijk, m);
-            if (roiVal != 0.0f)
-            {
-                if (!dataLoaded)
-                {
-                    myCifti->getRow(rowScratch.data(), myMap[i].m_ciftiIndex);
-                    dataLoaded = true;
-                }
-                for (int j = 0; j < rowSize; ++j)
-                {
-                    accum[m][j] += rowScratch[j] * roiVal;
-                }
-                denom[m] += roiVal;
-            }
+            tempRow.m_weights[m] = roiVal;
+            if (roiVal != 0.0f) inAnyROI = true;
+        }
+        if (inAnyROI)
+        {
+            tempRow.m_row = myMap[i].m_ciftiIndex;
+            rowList.push_back(tempRow);
         }
     }
+    accumulateWeightedRows(accum, denom, myCifti, rowList);
 }
 
 void AlgorithmCiftiAverageDenseROI::processCifti(vector<vector<double> >& accum, vector<double>& denom, const CiftiFile* myCifti, const CiftiFile* ciftiROI,
@@ -515,10 +523,11 @@ void AlgorithmCiftiAverageDenseROI::processCifti(vector<vector<double> >& accum,
     const CiftiXML& myXml = myCifti->getCiftiXML();//same along columns for data and roi, we already checked
     CaretAssert(myXml.getMappingType(CiftiXML::ALONG_COLUMN) == CiftiMappingType::BRAIN_MODELS);//should be checked in the algorithm constructor
     const CiftiBrainModelsMap& brainModelsMap = myXml.getBrainModelsMap(CiftiXML::ALONG_COLUMN);
-    int rowSize = myXml.getDimensionLength(CiftiXML::ALONG_ROW);
     vector<StructureEnum::Enum> surfList = brainModelsMap.getSurfaceStructureList();
     int numMaps = ciftiROI->getNumberOfColumns();
-    vector<float> dataScratch(rowSize), roiScratch(numMaps);
+    vector<WeightedRow> rowList;
+    WeightedRow tempRow;
+    tempRow.m_weights.resize(numMaps);
     for (int s = 0; s < (int)surfList.size(); ++s)
     {
         const float* myAreas = NULL;
@@ -538,54 +547,22 @@ void AlgorithmCiftiAverageDenseROI::processCifti(vector<vector<double> >& accum,
         }
         vector<CiftiBrainModelsMap::SurfaceMap> myMap = brainModelsMap.getSurfaceMap(surfList[s]);
         int mapSize = (int)myMap.size();
-        if (myAreas != NULL)
+        for (int i = 0; i < mapSize; ++i)
         {
-            for (int i = 0; i < mapSize; ++i)
+            ciftiROI->getRow(tempRow.m_weights.data(), myMap[i].m_ciftiIndex);
+            bool inAnyROI = false;
+            for (int m = 0; m < numMaps; ++m)//ROI maps, not cifti mapping
             {
-                ciftiROI->getRow(roiScratch.data(), myMap[i].m_ciftiIndex);
-                const float& thisArea = myAreas[myMap[i].m_surfaceNode];
-                bool dataLoaded = false;
-                for (int m = 0; m < numMaps; ++m)//ROI maps, not cifti mapping
+                if (tempRow.m_weights[m] != 0.0f)
                 {
-                    const float& roiValue = roiScratch[m];
-                    if (roiValue != 0.0f)
-                    {
-                        if (!dataLoaded)
-                        {
-                            myCifti->getRow(dataScratch.data(), i);
-                            dataLoaded = true;
-                        }
-                        const float weight = roiValue * thisArea;
-                        for (int j = 0; j < rowSize; ++j)
-                        {
-                            accum[m][j] += dataScratch[j] * weight;
-                        }
-                        denom[m] += weight;
-                    }
+                    if (myAreas != NULL) tempRow.m_weights[m] *= myAreas[myMap[i].m_surfaceNode];
+                    inAnyROI = true;
                 }
             }
-        } else {
-            for (int i = 0; i < mapSize; ++i)
+            if (inAnyROI)
             {
-                ciftiROI->getRow(roiScratch.data(), myMap[i].m_ciftiIndex);
-                bool dataLoaded = false;
-                for (int m = 0; m < numMaps; ++m)//ROI maps, not cifti mapping
-                {
-                    const float& roiValue = roiScratch[m];
-                    if (roiValue != 0.0f)
-                    {
-                        if (!dataLoaded)
-                        {
-                            myCifti->getRow(dataScratch.data(), i);
-                            dataLoaded = true;
-                        }
-                        for (int j = 0; j < rowSize; ++j)
-                        {
-                            accum[m][j] += dataScratch[j] * roiValue;
-                        }
-                        denom[m] += roiValue;
-                    }
-                }
+                tempRow.m_row = myMap[i].m_ciftiIndex;
+                rowList.push_back(tempRow);
             }
         }
     }
@@ -593,26 +570,19 @@ void AlgorithmCiftiAverageDenseROI::processCifti(vector<vector<double> >& accum,
     int mapSize = (int)myMap.size();
     for (int i = 0; i < mapSize; ++i)
     {
-        ciftiROI->getRow(roiScratch.data(), myMap[i].m_ciftiIndex);
-        bool dataLoaded = false;
+        ciftiROI->getRow(tempRow.m_weights.data(), myMap[i].m_ciftiIndex);
+        bool inAnyROI = false;
         for (int m = 0; m < numMaps; ++m)//ROI maps, not cifti mapping
         {
-            const float& roiValue = roiScratch[m];
-            if (roiValue != 0.0f)
-            {
-                if (!dataLoaded)
-                {
-                    myCifti->getRow(dataScratch.data(), i);
-                    dataLoaded = true;
-                }
-                for (int j = 0; j < rowSize; ++j)
-                {
-                    accum[m][j] += dataScratch[j] * roiValue;
-                }
-                denom[m] += roiValue;
-            }
+            if (tempRow.m_weights[m] != 0.0f) inAnyROI = true;
+        }
+        if (inAnyROI)
+        {
+            tempRow.m_row = myMap[i].m_ciftiIndex;
+            rowList.push_back(tempRow);
         }
     }
+    accumulateWeightedRows(accum, denom, myCifti, rowList);
 }
 
 float AlgorithmCiftiAverageDenseROI::getAlgorithmInternalWeight()
@@ -24,10 +24,12 @@
 #include "CaretOMP.h"
 #include "CiftiFile.h"
 #include "FileInformation.h"
+#include "GroupReduction.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
 #include "VolumeFile.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <string>
@@ -36,6 +38,29 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    //the per-file results are rows of map values, the group reduction wants one flat array
+    void addFileResult(GroupReduction& myReduction, const vector<vector<float> >& fileResult, vector<float>& flatScratch)
+    {
+        int numRows = (int)fileResult.size();
+        for (int i = 0; i < numRows; ++i)
+        {
+            copy(fileResult[i].begin(), fileResult[i].end(), flatScratch.begin() + i * fileResult[i].size());
+        }
+        myReduction.addInput(flatScratch.data());
+    }
+    
+    void writeGroupMean(const GroupReduction& myReduction, vector<float>& flatScratch, const int& colSize, const int& numMaps, CiftiFile* ciftiOut)
+    {
+        myReduction.getMean(flatScratch.data());
+        for (int i = 0; i < colSize; ++i)
+        {
+            ciftiOut->setRow(flatScratch.data() + i * numMaps, i);
+        }
+    }
+}
+
 AString AlgorithmCiftiAverageROICorrelation::getCommandSwitch()
 {
     return "-cifti-average-roi-correlation";
@@ -266,26 +291,14 @@ AlgorithmCiftiAverageROICorrelation::AlgorithmCiftiAverageROICorrelation(Progres
     ciftiOut->setCiftiXML(newXml);
     if (numCifti > 1)//skip averaging in single subject case
     {
-        vector<vector<double> > accum(colSize, vector<double>(numMaps, 0.0));
+        GroupReduction myReduction((int64_t)colSize * numMaps, false, false);//a constant row gives a NaN correlation, keep letting that show in the average
+        vector<float> flatScratch((int64_t)colSize * numMaps);
         for (int i = 0; i < numCifti; ++i)
         {
             processCifti(ciftiList[i], tempresult, leftROI, rightROI, cerebROI, volROI, numMaps, leftAreaPointer, rightAreaPointer, cerebAreaPointer);
-            for (int j = 0; j < colSize; ++j)
-            {
-                for (int myMap = 0; myMap < numMaps; ++myMap)
-                {
-                    accum[j][myMap] += tempresult[j][myMap];
-                }
-            }
-        }
-        for (int i = 0; i < colSize; ++i)
-        {
-            for (int myMap = 0; myMap < numMaps; ++myMap)
-            {
-                tempresult[i][myMap] = accum[i][myMap] / numCifti;
-            }
-            ciftiOut->setRow(tempresult[i].data(), i);
+            addFileResult(myReduction, tempresult, flatScratch);
         }
+        writeGroupMean(myReduction, flatScratch, colSize, numMaps, ciftiOut);
     } else {
         processCifti(ciftiList[0], tempresult, leftROI, rightROI, cerebROI, volROI, numMaps, leftAreaPointer, rightAreaPointer, cerebAreaPointer);
         for (int i = 0; i < colSize; ++i)
@@ -351,26 +364,14 @@ AlgorithmCiftiAverageROICorrelation::AlgorithmCiftiAverageROICorrelation(Progres
     ciftiOut->setCiftiXML(newXml);
     if (numCifti > 1)//skip averaging in single subject case
     {
-        vector<vector<double> > accum(colSize, vector<double>(numMaps, 0.0));
+        GroupReduction myReduction((int64_t)colSize * numMaps, false, false);//a constant row gives a NaN correlation, keep letting that show in the average
+        vector<float> flatScratch((int64_t)colSize * numMaps);
         for (int i = 0; i < numCifti; ++i)
         {
             processCifti(ciftiList[i], tempresult, ciftiROI, numMaps, leftAreaPointer, rightAreaPointer, cerebAreaPointer);
-            for (int j = 0; j < colSize; ++j)
-            {
-                for (int myMap = 0; myMap < numMaps; ++myMap)
-                {
-                    accum[j][myMap] += tempresult[j][myMap];
-                }
-            }
-        }
-        for (int i = 0; i < colSize; ++i)
-        {
-            for (int myMap = 0; myMap < numMaps; ++myMap)
-            {
-                tempresult[i][myMap] = accum[i][myMap] / numCifti;
-            }
-            ciftiOut->setRow(tempresult[i].data(), i);
+            addFileResult(myReduction, tempresult, flatScratch);
         }
+        writeGroupMean(myReduction, flatScratch, colSize, numMaps, ciftiOut);
     } else {
         processCifti(ciftiList[0], tempresult, ciftiROI, numMaps, leftAreaPointer, rightAreaPointer, cerebAreaPointer);
         for (int i = 0; i < colSize; ++i)
@@ -412,7 +413,6 @@ void AlgorithmCiftiAverageROICorrelation::processCifti(const CiftiFile* myCifti,
                                                        const int& numMaps, const float* leftAreas, const float* rightAreas, const float* cerebAreas)
 {
     int rowSize = myCifti->getNumberOfColumns();
-    int colSize = myCifti->getNumberOfRows();
     vector<vector<float> > average(numMaps, vector<float>(rowSize));
     vector<float> rrs(numMaps);
     for (int myMap = 0; myMap < numMaps; ++myMap)
@@ -436,54 +436,13 @@ void AlgorithmCiftiAverageROICorrelation::processCifti(const CiftiFile* myCifti,
         }
         rrs[myMap] = sqrt(accum);//compute this only once
     }
-    int curRow = 0;
-#pragma omp CARET_PAR
-    {
-        vector<float> rowscratch(rowSize);
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < colSize; ++i)
-        {
-            int myRow;
-#pragma omp critical
-            {
-                myRow = curRow;//force sequential reading
-                ++curRow;
-                myCifti->getRow(rowscratch.data(), myRow);//and never read multiple rows at once from the same file
-            }
-            double tempaccum = 0.0;//compute mean of new row
-            for (int j = 0; j < rowSize; ++j)
-            {
-                tempaccum += rowscratch[j];
-            }
-            float thismean = tempaccum / rowSize;
-            tempaccum = 0.0;
-            for (int j = 0; j < rowSize; ++j)
-            {
-                rowscratch[j] -= thismean;//demean
-                tempaccum += rowscratch[j] * rowscratch[j];//precompute rrs
-            }
-            float thisrrs = sqrt(tempaccum);
-            for (int myMap = 0; myMap < numMaps; ++myMap)
-            {
-                double corraccum = 0.0;//correlate
-                for (int j = 0; j < rowSize; ++j)
-                {
-                    corraccum += rowscratch[j] * average[myMap][j];//gather the correlation
-                }
-                corraccum /= rrs[myMap] * thisrrs;
-                if (corraccum > 0.999999) corraccum = 0.999999;
-                if (corraccum < -0.999999) corraccum = -0.999999;
-                output[myRow][myMap] = 0.5 * log((1 + corraccum) / (1 - corraccum));//fisher z transform, needed for averaging
-            }
-        }
-    }
+    correlateRows(myCifti, output, average, rrs, numMaps);
 }
 
 void AlgorithmCiftiAverageROICorrelation::processCifti(const CiftiFile* myCifti, vector<vector<float> >& output, const CiftiFile* ciftiROI, const int& numMaps,
                                                        const float* leftAreas, const float* rightAreas, const float* cerebAreas)
 {
     int rowSize = myCifti->getNumberOfColumns();
-    int colSize = myCifti->getNumberOfRows();
     vector<vector<float> > average(numMaps, vector<float>(rowSize));
     vector<float> rrs(numMaps);
     const CiftiXMLOld& roiXML = ciftiROI->getCiftiXMLOld();
@@ -580,20 +539,30 @@ void AlgorithmCiftiAverageROICorrelation::processCifti(const CiftiFile* myCifti,
             rrs[i] = sqrt(accum);
         }
     }
-    int curRow = 0;
-#pragma omp CARET_PAR
+    correlateRows(myCifti, output, average, rrs, numMaps);
+}
+
+void AlgorithmCiftiAverageROICorrelation::correlateRows(const CiftiFile* myCifti, vector<vector<float> >& output, const vector<vector<float> >& average,
+                                                        const vector<float>& rrs, const int& numMaps)
+{
+    const int64_t ROW_BLOCK_SIZE = 1024;//rows read together before computing them in parallel
+    int rowSize = myCifti->getNumberOfColumns();
+    int colSize = myCifti->getNumberOfRows();
+    vector<float> block(min((int64_t)colSize, ROW_BLOCK_SIZE) * rowSize);
+    vector<int64_t> blockIndices;
+    for (int firstRow = 0; firstRow < colSize; firstRow += ROW_BLOCK_SIZE)
     {
-        vector<float> rowscratch(rowSize);
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int i = 0; i < colSize; ++i)
+        const int blockRows = (int)min((int64_t)(colSize - firstRow), ROW_BLOCK_SIZE);
+        blockIndices.resize(blockRows);
+        for (int i = 0; i < blockRows; ++i)
         {
-            int myRow;
-#pragma omp critical
-            {
-                myRow = curRow;//force sequential reading
-                ++curRow;
-                myCifti->getRow(rowscratch.data(), myRow);//and never read multiple rows at once from the same file
-            }
+            blockIndices[i] = firstRow + i;
+        }
+        myCifti->getRows(block.data(), blockIndices);//one sequential read per block, file access stays serial
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int i = 0; i < blockRows; ++i)
+        {
+            float* rowscratch = block.data() + (int64_t)i * rowSize;
             double tempaccum = 0.0;//compute mean of new row
             for (int j = 0; j < rowSize; ++j)
             {
@@ -617,7 +586,7 @@ void AlgorithmCiftiAverageROICorrelation::processCifti(const CiftiFile* myCifti,
                 corraccum /= rrs[myMap] * thisrrs;
                 if (corraccum > 0.999999) corraccum = 0.999999;
                 if (corraccum < -0.999999) corraccum = -0.999999;
-                output[myRow][myMap] = 0.5 * log((1 + corraccum) / (1 - corraccum));//fisher z transform, needed for averaging
+                output[firstRow + i][myMap] = 0.5 * log((1 + corraccum) / (1 - corraccum));//fisher z transform, needed for averaging
             }
         }
     }
@@ -36,6 +36,8 @@ namespace caret {
                           const int& numMaps, const float* leftAreas, const float* rightAreas, const float* cerebAreas);
         void processCifti(const CiftiFile* myCifti, std::vector<std::vector<float> >& output, const CiftiFile* ciftiROI,
                           const int& numMaps, const float* leftAreas, const float* rightAreas, const float* cerebAreas);
+        void correlateRows(const CiftiFile* myCifti, std::vector<std::vector<float> >& output, const std::vector<std::vector<float> >& average,
+                           const std::vector<float>& rrs, const int& numMaps);
         void addSurface(const CiftiFile* myCifti, StructureEnum::Enum myStruct, std::vector<double>& accum, const MetricFile* myRoi, const int& myMap, const float* myAreas);
         void addVolume(const CiftiFile* myCifti, std::vector<double>& accum, const VolumeFile* myRoi, const int& myMap);
     protected:
@@ -443,6 +443,11 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
     vector<vector<bool> > roiLookup(numCacheRows);//this gets bit compressed
     vector<bool> origRoi(mySurf->getNumberOfNodes());
     vector<vector<int32_t> > excludeNodes(numCacheRows);
+#ifdef CARET_OMP
+    vector<CaretPointer<GeodesicHelper> > geoHelpers(omp_get_max_threads());//one per thread, kept across row chunks
+#else
+    vector<CaretPointer<GeodesicHelper> > geoHelpers(1);
+#endif
     vector<int> rowsToCache;
     for (int i = 0; i < mapSize; ++i)
     {
@@ -478,7 +483,12 @@ void AlgorithmCiftiCorrelationGradient::processSurfaceComponent(StructureEnum::E
 #pragma omp CARET_PAR
         {
             vector<float> distances;
-            CaretPointer<GeodesicHelper> myGeoHelp(new GeodesicHelper(myGeoBase));
+#ifdef CARET_OMP
+            CaretPointer<GeodesicHelper>& myGeoHelp = geoHelpers[omp_get_thread_num()];
+#else
+            CaretPointer<GeodesicHelper>& myGeoHelp = geoHelpers[0];
+#endif
+            if (myGeoHelp == NULL) myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
 #pragma omp CARET_FOR
             for (int i = startpos; i < endpos; ++i)
             {
@@ -23,11 +23,15 @@
 
 #include "AlgorithmCiftiReplaceStructure.h"
 #include "AlgorithmCiftiSeparate.h"
+#include "CaretOMP.h"
 #include "CiftiFile.h"
 #include "LabelFile.h"
 #include "MetricFile.h"
 #include "VolumeFile.h"
 
+#include <algorithm>
+#include <set>
+
 using namespace caret;
 using namespace std;
 
@@ -80,6 +84,142 @@ void AlgorithmCiftiMergeDense::useParameters(OperationParameters* myParams, Prog
     AlgorithmCiftiMergeDense(myProgObj, myDir, ciftiList, myCiftiOut);
 }
 
+namespace
+{
+    const int64_t MERGE_ROW_BLOCK = 64;//rows read from each input before gathering, bounds the memory used
+    
+    struct GatherPlan
+    {
+        vector<int> m_sourceFile;//for each output dense index, which input it comes from, -1 if it is filled some other way
+        vector<int64_t> m_sourceIndex;//and which dense index in that input
+    };
+    
+    bool allFilesDistinct(const vector<const CiftiFile*>& ciftiList)
+    {//the same file object can't be read from two threads at once
+        return set<const CiftiFile*>(ciftiList.begin(), ciftiList.end()).size() == ciftiList.size();
+    }
+    
+    //read the given sorted rows from each input that has any, in parallel across inputs when possible
+    void readRowsFromInputs(const vector<const CiftiFile*>& ciftiList, const vector<vector<int64_t> >& rowsPerFile, vector<vector<float> >& dataPerFile)
+    {
+        const int numFiles = (int)ciftiList.size();
+        vector<AString> errors(numFiles);//exceptions can't leave an omp region, so collect them and throw afterwards
+        const bool parallelReads = allFilesDistinct(ciftiList);
+#pragma omp CARET_PARFOR schedule(dynamic) if(parallelReads)
+        for (int f = 0; f < numFiles; ++f)
+        {
+            if (rowsPerFile[f].empty()) continue;
+            try
+            {
+                const int64_t rowLength = ciftiList[f]->getNumberOfColumns();
+                dataPerFile[f].resize(rowsPerFile[f].size() * rowLength);
+                ciftiList[f]->getRows(dataPerFile[f].data(), rowsPerFile[f]);
+            } catch (CaretException& e) {
+                errors[f] = e.whatString();
+            }
+        }
+        for (int f = 0; f < numFiles; ++f)
+        {
+            if (!errors[f].isEmpty()) throw AlgorithmException(errors[f]);
+        }
+    }
+    
+    //dense along rows: every output row takes columns from the same row of several inputs
+    void executeGatherAlongRow(const GatherPlan& myPlan, const vector<const CiftiFile*>& ciftiList, CiftiFile* myCiftiOut)
+    {
+        const int numFiles = (int)ciftiList.size();
+        const int64_t numRows = myCiftiOut->getNumberOfRows(), outLength = (int64_t)myPlan.m_sourceFile.size();
+        vector<bool> fileUsed(numFiles, false);
+        vector<int64_t> inputRowLength(numFiles);
+        for (int f = 0; f < numFiles; ++f)
+        {
+            inputRowLength[f] = ciftiList[f]->getNumberOfColumns();
+        }
+        for (int64_t c = 0; c < outLength; ++c)
+        {
+            if (myPlan.m_sourceFile[c] != -1) fileUsed[myPlan.m_sourceFile[c]] = true;
+        }
+        vector<vector<int64_t> > rowsPerFile(numFiles);
+        vector<vector<float> > dataPerFile(numFiles);
+        vector<float> blockOut(MERGE_ROW_BLOCK * outLength, 0.0f);//indices not in the plan stay zero for later filling
+        for (int64_t blockStart = 0; blockStart < numRows; blockStart += MERGE_ROW_BLOCK)
+        {
+            const int64_t blockEnd = min(blockStart + MERGE_ROW_BLOCK, numRows), blockRows = blockEnd - blockStart;
+            for (int f = 0; f < numFiles; ++f)
+            {
+                rowsPerFile[f].clear();
+                if (!fileUsed[f]) continue;
+                for (int64_t r = blockStart; r < blockEnd; ++r)
+                {
+                    rowsPerFile[f].push_back(r);
+                }
+            }
+            readRowsFromInputs(ciftiList, rowsPerFile, dataPerFile);
+#pragma omp CARET_PARFOR schedule(static)
+            for (int64_t r = 0; r < blockRows; ++r)
+            {
+                float* outRow = blockOut.data() + r * outLength;
+                for (int64_t c = 0; c < outLength; ++c)
+                {
+                    const int f = myPlan.m_sourceFile[c];
+                    if (f == -1) continue;
+                    outRow[c] = dataPerFile[f][r * inputRowLength[f] + myPlan.m_sourceIndex[c]];
+                }
+            }
+            for (int64_t r = 0; r < blockRows; ++r)
+            {
+                myCiftiOut->setRow(blockOut.data() + r * outLength, blockStart + r);
+            }
+        }
+    }
+    
+    //dense along columns: every output row is a copy of one row of one input
+    void executeGatherAlongColumn(const GatherPlan& myPlan, const vector<const CiftiFile*>& ciftiList, CiftiFile* myCiftiOut)
+    {
+        const int numFiles = (int)ciftiList.size();
+        const int64_t outLength = (int64_t)myPlan.m_sourceFile.size(), rowLength = myCiftiOut->getNumberOfColumns();
+        vector<vector<int64_t> > rowsPerFile(numFiles);
+        vector<vector<float> > dataPerFile(numFiles);
+        vector<pair<int64_t, int64_t> > sortedRows;//source row and output row, for finding where each output row ended up after sorting
+        for (int64_t blockStart = 0; blockStart < outLength; blockStart += MERGE_ROW_BLOCK)
+        {
+            const int64_t blockEnd = min(blockStart + MERGE_ROW_BLOCK, outLength);
+            vector<vector<pair<int64_t, int64_t> > > blockPerFile(numFiles);
+            for (int64_t outRow = blockStart; outRow < blockEnd; ++outRow)
+            {
+                const int f = myPlan.m_sourceFile[outRow];
+                if (f == -1) continue;
+                blockPerFile[f].push_back(pair<int64_t, int64_t>(myPlan.m_sourceIndex[outRow], outRow));
+            }
+            for (int f = 0; f < numFiles; ++f)
+            {//getRows wants sorted rows, which also lets it merge adjacent reads
+                sort(blockPerFile[f].begin(), blockPerFile[f].end());
+                rowsPerFile[f].clear();
+                for (int64_t k = 0; k < (int64_t)blockPerFile[f].size(); ++k)
+                {
+                    rowsPerFile[f].push_back(blockPerFile[f][k].first);
+                }
+            }
+            readRowsFromInputs(ciftiList, rowsPerFile, dataPerFile);
+            sortedRows.clear();
+            for (int f = 0; f < numFiles; ++f)
+            {
+                for (int64_t k = 0; k < (int64_t)blockPerFile[f].size(); ++k)
+                {
+                    sortedRows.push_back(pair<int64_t, int64_t>(blockPerFile[f][k].second, f * MERGE_ROW_BLOCK + k));
+                }
+            }
+            sort(sortedRows.begin(), sortedRows.end());//write in output order
+            for (int64_t k = 0; k < (int64_t)sortedRows.size(); ++k)
+            {
+                const int f = (int)(sortedRows[k].second / MERGE_ROW_BLOCK);
+                const int64_t pos = sortedRows[k].second % MERGE_ROW_BLOCK;
+                myCiftiOut->setRow(dataPerFile[f].data() + pos * rowLength, sortedRows[k].first);
+            }
+        }
+    }
+}
+
 AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, const int& myDir, const vector<const CiftiFile*>& ciftiList, CiftiFile* myCiftiOut) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
@@ -169,45 +309,32 @@ AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, co
     }
     CaretAssert((int)sourceCifti.size() == outXML.getNumberOfBrainModels(myDir));
     myCiftiOut->setCiftiXML(outXML);
+    GatherPlan myPlan;//compile the merge into which input file and index each output index comes from, so the output is written in one pass
+    int64_t outLength = (myDir == CiftiXMLOld::ALONG_ROW ? outXML.getNumberOfColumns() : outXML.getNumberOfRows());
+    myPlan.m_sourceFile.resize(outLength, -1);
+    myPlan.m_sourceIndex.resize(outLength, -1);
+    vector<int> labelSurfaceModels;
     for (int i = 0; i < (int)sourceCifti.size(); ++i)
     {
         CiftiBrainModelInfo myInfo = outXML.getBrainModelInfo(myDir, i);
+        const CiftiXMLOld& otherXML = ciftiList[sourceCifti[i]]->getCiftiXMLOld();
         switch (myInfo.m_type)
         {
             case CIFTI_MODEL_TYPE_SURFACE:
             {
                 if (isLabel)
                 {
-                    LabelFile tempFile;
-                    AlgorithmCiftiSeparate(NULL, ciftiList[sourceCifti[i]], myDir, myInfo.m_structure, &tempFile);//using this because dealing with label tables is nasty, but doesn't happen on large files
-                    AlgorithmCiftiReplaceStructure(NULL, myCiftiOut, myDir, myInfo.m_structure, &tempFile);
-                } else {//for everything else, just use rows directly, because making large metric files in-memory is problematic
+                    labelSurfaceModels.push_back(i);//label tables need to be merged, handled after the main pass
+                } else {
                     vector<CiftiSurfaceMap> inMap, outMap;
-                    const CiftiXMLOld& otherXML = ciftiList[sourceCifti[i]]->getCiftiXMLOld();
                     outXML.getSurfaceMap(myDir, outMap, myInfo.m_structure);
                     otherXML.getSurfaceMap(myDir, inMap, myInfo.m_structure);
                     CaretAssert(inMap.size() == outMap.size());
-                    vector<float> rowscratch(outXML.getNumberOfColumns()), otherscratch(otherXML.getNumberOfColumns());
-                    if (myDir == CiftiXMLOld::ALONG_ROW)
+                    for (int k = 0; k < (int)inMap.size(); ++k)
                     {
-                        for (int j = 0; j < outXML.getNumberOfRows(); ++j)
-                        {
-                            myCiftiOut->getRow(rowscratch.data(), j, true);
-                            ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), j);
-                            for (int k = 0; k < (int)inMap.size(); ++k)
-                            {
-                                CaretAssert(inMap[k].m_surfaceNode == outMap[k].m_surfaceNode);
-                                rowscratch[outMap[k].m_ciftiIndex] = otherscratch[inMap[k].m_ciftiIndex];
-                            }
-                            myCiftiOut->setRow(rowscratch.data(), j);
-                        }
-                    } else {
-                        for (int k = 0; k < (int)inMap.size(); ++k)
-                        {
-                            CaretAssert(inMap[k].m_surfaceNode == outMap[k].m_surfaceNode);
-                            ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), inMap[k].m_ciftiIndex);
-                            myCiftiOut->setRow(otherscratch.data(), outMap[k].m_ciftiIndex);
-                        }
+                        CaretAssert(inMap[k].m_surfaceNode == outMap[k].m_surfaceNode);
+                        myPlan.m_sourceFile[outMap[k].m_ciftiIndex] = sourceCifti[i];
+                        myPlan.m_sourceIndex[outMap[k].m_ciftiIndex] = inMap[k].m_ciftiIndex;
                     }
                 }
                 break;
@@ -215,35 +342,16 @@ AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, co
             case CIFTI_MODEL_TYPE_VOXELS:
             {
                 vector<CiftiVolumeMap> inMap, outMap;
-                const CiftiXMLOld& otherXML = ciftiList[sourceCifti[i]]->getCiftiXMLOld();
                 outXML.getVolumeStructureMap(myDir, outMap, myInfo.m_structure);
                 otherXML.getVolumeStructureMap(myDir, inMap, myInfo.m_structure);
                 CaretAssert(inMap.size() == outMap.size());
-                vector<float> rowscratch(outXML.getNumberOfColumns()), otherscratch(otherXML.getNumberOfColumns());
-                if (myDir == CiftiXMLOld::ALONG_ROW)
+                for (int k = 0; k < (int)inMap.size(); ++k)
                 {
-                    for (int j = 0; j < outXML.getNumberOfRows(); ++j)
-                    {
-                        myCiftiOut->getRow(rowscratch.data(), j, true);
-                        ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), j);
-                        for (int k = 0; k < (int)inMap.size(); ++k)
-                        {
-                            CaretAssert(inMap[k].m_ijk[0] == outMap[k].m_ijk[0]);
-                            CaretAssert(inMap[k].m_ijk[1] == outMap[k].m_ijk[1]);
-                            CaretAssert(inMap[k].m_ijk[2] == outMap[k].m_ijk[2]);
-                            rowscratch[outMap[k].m_ciftiIndex] = otherscratch[inMap[k].m_ciftiIndex];
-                        }
-                        myCiftiOut->setRow(rowscratch.data(), j);
-                    }
-                } else {
-                    for (int k = 0; k < (int)inMap.size(); ++k)
-                    {
-                        CaretAssert(inMap[k].m_ijk[0] == outMap[k].m_ijk[0]);
-                        CaretAssert(inMap[k].m_ijk[1] == outMap[k].m_ijk[1]);
-                        CaretAssert(inMap[k].m_ijk[2] == outMap[k].m_ijk[2]);
-                        ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), inMap[k].m_ciftiIndex);
-                        myCiftiOut->setRow(otherscratch.data(), outMap[k].m_ciftiIndex);
-                    }
+                    CaretAssert(inMap[k].m_ijk[0] == outMap[k].m_ijk[0]);
+                    CaretAssert(inMap[k].m_ijk[1] == outMap[k].m_ijk[1]);
+                    CaretAssert(inMap[k].m_ijk[2] == outMap[k].m_ijk[2]);
+                    myPlan.m_sourceFile[outMap[k].m_ciftiIndex] = sourceCifti[i];
+                    myPlan.m_sourceIndex[outMap[k].m_ciftiIndex] = inMap[k].m_ciftiIndex;
                 }
                 break;
             }
@@ -251,6 +359,19 @@ AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, co
                 throw AlgorithmException("encountered unknown model type in cifti merge dense");
         }
     }
+    if (myDir == CiftiXMLOld::ALONG_ROW)
+    {
+        executeGatherAlongRow(myPlan, ciftiList, myCiftiOut);
+    } else {
+        executeGatherAlongColumn(myPlan, ciftiList, myCiftiOut);
+    }
+    for (int i = 0; i < (int)labelSurfaceModels.size(); ++i)
+    {
+        CiftiBrainModelInfo myInfo = outXML.getBrainModelInfo(myDir, labelSurfaceModels[i]);
+        LabelFile tempFile;
+        AlgorithmCiftiSeparate(NULL, ciftiList[sourceCifti[labelSurfaceModels[i]]], myDir, myInfo.m_structure, &tempFile);//using this because dealing with label tables is nasty, but doesn't happen on large files
+        AlgorithmCiftiReplaceStructure(NULL, myCiftiOut, myDir, myInfo.m_structure, &tempFile);
+    }
 }
 
 float AlgorithmCiftiMergeDense::getAlgorithmInternalWeight()
@@ -21,6 +21,8 @@
 #include "AlgorithmCiftiParcellate.h"
 #include "AlgorithmException.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CaretProfiler.h"
 #include "CiftiFile.h"
 #include "GiftiLabel.h"
 #include "GiftiLabelTable.h"
@@ -29,6 +31,7 @@
 #include "ReductionOperation.h"
 #include "SurfaceFile.h"
 
+#include <algorithm>
 #include <cmath>
 #include <map>
 
@@ -205,6 +208,202 @@ void AlgorithmCiftiParcellate::useParameters(OperationParameters* myParams, Prog
     AlgorithmCiftiParcellate(myProgObj, myCiftiIn, myCiftiLabel, direction, myCiftiOut, method, excludeLow, excludeHigh, onlyNumeric);
 }
 
+namespace
+{
+    //MEAN and SUM (weighted or not) are linear in the data, so they can be done as a sparse matrix product with no per-parcel buckets
+    struct ParcelMatrix
+    {
+        vector<int64_t> m_parcelStart;//CSR layout, members of parcel p are [m_parcelStart[p], m_parcelStart[p + 1])
+        vector<int64_t> m_memberIndex;
+        vector<float> m_memberWeight;
+        vector<double> m_divisor;//sum of weights for MEAN, 1 for SUM
+        vector<float> m_indexWeight;//weight of each dense index, for parcellating along columns
+    };
+    
+    bool canUseParcelMatrix(const ReductionEnum::Enum& method, const bool& isLabel, const float& excludeLow, const float& excludeHigh, const bool& onlyNumeric)
+    {//label data needs rounding, and the exclusion options need to look at the values, so those use the general path
+        if (isLabel || onlyNumeric || (excludeLow > 0.0f && excludeHigh > 0.0f)) return false;
+        return (method == ReductionEnum::MEAN || method == ReductionEnum::SUM);
+    }
+    
+    //parcelWeights is NULL for unweighted, otherwise it has the weights of each parcel's members in dense index order
+    void buildParcelMatrix(ParcelMatrix& matrixOut, const vector<int>& indexToParcel, const int& numParcels,
+                           const vector<vector<float> >* parcelWeights, const ReductionEnum::Enum& method)
+    {
+        CaretAssert(method == ReductionEnum::MEAN || method == ReductionEnum::SUM);
+        const int64_t numIndices = (int64_t)indexToParcel.size();
+        matrixOut.m_parcelStart.assign(numParcels + 1, 0);
+        for (int64_t i = 0; i < numIndices; ++i)
+        {
+            if (indexToParcel[i] != -1) ++matrixOut.m_parcelStart[indexToParcel[i] + 1];
+        }
+        for (int p = 0; p < numParcels; ++p)
+        {
+            matrixOut.m_parcelStart[p + 1] += matrixOut.m_parcelStart[p];
+        }
+        matrixOut.m_memberIndex.resize(matrixOut.m_parcelStart[numParcels]);
+        matrixOut.m_memberWeight.resize(matrixOut.m_parcelStart[numParcels]);
+        matrixOut.m_indexWeight.assign(numIndices, 0.0f);
+        vector<int64_t> fillPos(matrixOut.m_parcelStart.begin(), matrixOut.m_parcelStart.end() - 1);
+        for (int64_t i = 0; i < numIndices; ++i)
+        {
+            int parcel = indexToParcel[i];
+            if (parcel == -1) continue;
+            const int64_t pos = fillPos[parcel]++;
+            float weight = 1.0f;
+            if (parcelWeights != NULL)
+            {
+                CaretAssert(pos - matrixOut.m_parcelStart[parcel] < (int64_t)(*parcelWeights)[parcel].size());
+                weight = (*parcelWeights)[parcel][pos - matrixOut.m_parcelStart[parcel]];
+            }
+            matrixOut.m_memberIndex[pos] = i;
+            matrixOut.m_memberWeight[pos] = weight;
+            matrixOut.m_indexWeight[i] = weight;
+        }
+        matrixOut.m_divisor.assign(numParcels, 1.0);
+        if (method == ReductionEnum::MEAN)
+        {
+            for (int p = 0; p < numParcels; ++p)
+            {
+                double weightSum = 0.0;
+                for (int64_t k = matrixOut.m_parcelStart[p]; k < matrixOut.m_parcelStart[p + 1]; ++k)
+                {
+                    weightSum += matrixOut.m_memberWeight[k];
+                }
+                matrixOut.m_divisor[p] = weightSum;
+            }
+        }
+    }
+    
+    const int64_t PARCEL_ROW_BLOCK = 256;//input rows read before computing them in parallel, file access stays serial
+    const int64_t PARCEL_BLOCK_BYTES = 64 * 1024 * 1024;//but fewer when rows are long, such as dconn rows
+    
+    int64_t getRowBlockSize(const int64_t& rowLength)
+    {
+        return max((int64_t)1, min(PARCEL_ROW_BLOCK, PARCEL_BLOCK_BYTES / max((int64_t)1, rowLength * (int64_t)sizeof(float))));
+    }
+    
+    void doMatrixParcellation(const CiftiFile* myCiftiIn, const int& direction, CiftiFile* myCiftiOut, const vector<int>& indexToParcel, const ParcelMatrix& myMatrix)
+    {
+        const CiftiXML& myInputXML = myCiftiIn->getCiftiXML();
+        vector<int64_t> dims = myInputXML.getDimensions();
+        CaretAssert(direction < (int)dims.size());
+        const int numParcels = (int)myMatrix.m_divisor.size();
+        const int64_t numCols = dims[0];
+        const int64_t blockSize = getRowBlockSize(numCols);
+        if (direction == CiftiXML::ALONG_ROW)
+        {
+            vector<vector<int64_t> > blockIndices;
+            blockIndices.reserve(blockSize);
+            vector<float> blockIn(blockSize * numCols), blockOut(blockSize * numParcels);
+            MultiDimIterator<int64_t> iter(vector<int64_t>(dims.begin() + 1, dims.end()));
+            while (!iter.atEnd())
+            {
+                blockIndices.clear();
+                for (; !iter.atEnd() && (int64_t)blockIndices.size() < blockSize; ++iter)
+                {
+                    myCiftiIn->getRow(blockIn.data() + blockIndices.size() * numCols, *iter);
+                    blockIndices.push_back(*iter);
+                }
+                const int64_t numOutputs = (int64_t)blockIndices.size() * numParcels;//parallelize over rows and parcels together, so a single-row file still uses all threads
+                {
+                    CaretProfileSpan parallelSpan("AlgorithmCiftiParcellate rows", "omp");
+#pragma omp CARET_PARFOR schedule(static)
+                    for (int64_t t = 0; t < numOutputs; ++t)
+                    {
+                        const int64_t row = t / numParcels;
+                        const int parcel = (int)(t % numParcels);
+                        const float* inRow = blockIn.data() + row * numCols;
+                        const int64_t start = myMatrix.m_parcelStart[parcel], end = myMatrix.m_parcelStart[parcel + 1];
+                        if (start == end)
+                        {
+                            blockOut[t] = 0.0f;
+                        } else {
+                            double accum = 0.0;
+                            for (int64_t k = start; k < end; ++k)
+                            {
+                                accum += inRow[myMatrix.m_memberIndex[k]] * myMatrix.m_memberWeight[k];
+                            }
+                            blockOut[t] = accum / myMatrix.m_divisor[parcel];
+                        }
+                    }
+                }
+                for (int64_t row = 0; row < (int64_t)blockIndices.size(); ++row)
+                {
+                    myCiftiOut->setRow(blockOut.data() + row * numParcels, blockIndices[row]);
+                }
+            }
+        } else {
+            vector<int64_t> members;//dense indices that are in a parcel, in increasing order
+            for (int64_t i = 0; i < dims[direction]; ++i)
+            {
+                if (indexToParcel[i] != -1) members.push_back(i);
+            }
+            const int64_t numMembers = (int64_t)members.size();
+            const bool useGetRows = (dims.size() == 2);//reading a sorted set of rows can merge adjacent reads, but only works on 2D
+            vector<int64_t> otherDims = dims;
+            otherDims.erase(otherDims.begin() + direction);//direction being parcellated
+            otherDims.erase(otherDims.begin());//row
+            vector<double> parcelAccum(numParcels * numCols);
+            vector<float> blockIn(min(blockSize, max(numMembers, (int64_t)1)) * numCols), scratchOutRow(numCols);
+            vector<int64_t> blockRows;
+            for (MultiDimIterator<int64_t> iter(otherDims); !iter.atEnd(); ++iter)
+            {
+                vector<int64_t> indices(dims.size() - 1);//we need to add the parcellated direction index back into the index list to use it in getRow/setRow
+                for (int i = 0; i < (int)otherDims.size(); ++i)
+                {
+                    if (i < direction - 1)
+                    {
+                        indices[i] = (*iter)[i];
+                    } else {
+                        indices[i + 1] = (*iter)[i];
+                    }
+                }//indices[direction - 1] is uninitialized, as it is the dimension to be parcellated
+                fill(parcelAccum.begin(), parcelAccum.end(), 0.0);
+                for (int64_t blockStart = 0; blockStart < numMembers; blockStart += blockSize)
+                {
+                    const int64_t blockEnd = min(blockStart + blockSize, numMembers);
+                    if (useGetRows)
+                    {
+                        blockRows.assign(members.begin() + blockStart, members.begin() + blockEnd);
+                        myCiftiIn->getRows(blockIn.data(), blockRows);
+                    } else {
+                        for (int64_t m = blockStart; m < blockEnd; ++m)
+                        {
+                            indices[direction - 1] = members[m];
+                            myCiftiIn->getRow(blockIn.data() + (m - blockStart) * numCols, indices);
+                        }
+                    }
+#pragma omp CARET_PARFOR schedule(static)
+                    for (int64_t j = 0; j < numCols; ++j)
+                    {//each thread owns a range of columns, so no two threads touch the same accumulator
+                        for (int64_t m = blockStart; m < blockEnd; ++m)
+                        {
+                            const int64_t denseIndex = members[m];
+                            parcelAccum[indexToParcel[denseIndex] * numCols + j] += blockIn[(m - blockStart) * numCols + j] * myMatrix.m_indexWeight[denseIndex];
+                        }
+                    }
+                }
+                for (int p = 0; p < numParcels; ++p)
+                {
+                    indices[direction - 1] = p;
+                    if (myMatrix.m_parcelStart[p] == myMatrix.m_parcelStart[p + 1])
+                    {
+                        fill(scratchOutRow.begin(), scratchOutRow.end(), 0.0f);
+                    } else {
+                        const double* accumRow = parcelAccum.data() + p * numCols;
+                        for (int64_t j = 0; j < numCols; ++j)
+                        {
+                            scratchOutRow[j] = accumRow[j] / myMatrix.m_divisor[p];
+                        }
+                    }
+                    myCiftiOut->setRow(scratchOutRow.data(), indices);
+                }
+            }
+        }
+    }
+}
+
 AlgorithmCiftiParcellate::AlgorithmCiftiParcellate(ProgressObject* myProgObj, const CiftiFile* myCiftiIn, const CiftiFile* myCiftiLabel, const int& direction, CiftiFile* myCiftiOut,
                                                    const ReductionEnum::Enum& method, const float& excludeLow, const float& excludeHigh, const bool& onlyNumeric) : AbstractAlgorithm(myProgObj)
 {
@@ -270,6 +469,13 @@ AlgorithmCiftiParcellate::AlgorithmCiftiParcellate(ProgressObject* myProgObj, co
     {
         CaretLogWarning(ReductionEnum::toName(method) + " reduction requested while parcellating label data");
     }
+    if (canUseParcelMatrix(method, isLabel, excludeLow, excludeHigh, onlyNumeric))
+    {
+        ParcelMatrix myMatrix;
+        buildParcelMatrix(myMatrix, indexToParcel, numParcels, NULL, method);
+        doMatrixParcellation(myCiftiIn, direction, myCiftiOut, indexToParcel, myMatrix);
+        return;
+    }
     if (direction == CiftiXML::ALONG_ROW)
     {
         vector<float> scratchOutRow(numParcels);
@@ -446,6 +652,13 @@ namespace
             CaretLogWarning(ReductionEnum::toName(method) + " reduction requested while parcellating label data");
         }
         int numParcels = myCiftiOut->getCiftiXML().getDimensionLength(direction);
+        if (canUseParcelMatrix(method, isLabel, excludeLow, excludeHigh, onlyNumeric))
+        {
+            ParcelMatrix myMatrix;
+            buildParcelMatrix(myMatrix, indexToParcel, numParcels, &parcelWeights, method);
+            doMatrixParcellation(myCiftiIn, direction, myCiftiOut, indexToParcel, myMatrix);
+            return;
+        }
         int64_t numCols = myInputXML.getDimensionLength(CiftiXML::ALONG_ROW);
         vector<float> scratchRow(numCols);
         if (direction == CiftiXML::ALONG_ROW)
@@ -22,8 +22,10 @@
 #include "AlgorithmException.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "CiftiFile.h"
 #include "MultiDimIterator.h"
+#include "MultiReduction.h"
 #include "ReductionOperation.h"
 
 #include <vector>
@@ -59,9 +61,14 @@ OperationParameters* AlgorithmCiftiReduce::getParameters()
     
     ret->createOptionalParameter(5, "-only-numeric", "exclude non-numeric values");
     
+    ParameterComponent* extraOpt = ret->createRepeatableParameter(7, "-extra-operation", "also compute another reduction operation");
+    extraOpt->addStringParameter(1, "operation", "the reduction operator to use");
+    
     ret->setHelpText(
         AString("For the specified direction (default ROW), perform a reduction operation along that direction.  ") +
         CiftiXML::directionFromStringExplanation() + "  " +
+        "Use -extra-operation to compute more reductions from the same pass over the input, the output will then have one map per operation, " +
+        "starting with <operation> and followed by the extra operations in the order given.  " +
         "The reduction operators are as follows:\n\n" + ReductionOperation::getHelpInfo()
     );
     return ret;
@@ -80,131 +87,191 @@ void AlgorithmCiftiReduce::useParameters(OperationParameters* myParams, Progress
     }
     OptionalParameter* excludeOpt = myParams->getOptionalParameter(4);
     bool onlyNumeric = myParams->getOptionalParameter(5)->m_present;
+    vector<ReductionEnum::Enum> myReduces;
     bool ok = false;
-    ReductionEnum::Enum myReduce = ReductionEnum::fromName(opString, &ok);
+    myReduces.push_back(ReductionEnum::fromName(opString, &ok));
     if (!ok) throw AlgorithmException("unrecognized operation string '" + opString + "'");
+    const vector<ParameterComponent*>& extraInstances = *(myParams->getRepeatableParameterInstances(7));
+    for (int i = 0; i < (int)extraInstances.size(); ++i)
+    {
+        myReduces.push_back(ReductionEnum::fromName(extraInstances[i]->getString(1), &ok));
+        if (!ok) throw AlgorithmException("unrecognized operation string '" + extraInstances[i]->getString(1) + "'");
+    }
     if (excludeOpt->m_present)
     {
         if (onlyNumeric) CaretLogWarning("-only-numeric is redundant when -exclude-outliers is specified");
-        AlgorithmCiftiReduce(myProgObj, ciftiIn, myReduce, ciftiOut, excludeOpt->getDouble(1), excludeOpt->getDouble(2), direction);
+        AlgorithmCiftiReduce(myProgObj, ciftiIn, myReduces, ciftiOut, excludeOpt->getDouble(1), excludeOpt->getDouble(2), direction);
     } else {
-        AlgorithmCiftiReduce(myProgObj, ciftiIn, myReduce, ciftiOut, onlyNumeric, direction);
+        AlgorithmCiftiReduce(myProgObj, ciftiIn, myReduces, ciftiOut, onlyNumeric, direction);
     }
 }
 
-AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const ReductionEnum::Enum& myReduce, CiftiFile* ciftiOut,
-                                           const bool& onlyNumeric, const int& direction) : AbstractAlgorithm(myProgObj)
+namespace
 {
-    LevelProgress myProgress(myProgObj);
-    CaretAssert(direction >= 0);
-    const CiftiXML& inputXML = ciftiIn->getCiftiXML();
-    CiftiXML myOutXML = inputXML;
-    if (direction >= myOutXML.getNumberOfDimensions()) throw AlgorithmException("specified reduction direction doesn't exist in input cifti file");
-    CiftiScalarsMap newMap;
-    newMap.setLength(1);
-    newMap.setMapName(0, ReductionEnum::toName(myReduce));
-    myOutXML.setMap(direction, newMap);
-    ciftiOut->setCiftiXML(myOutXML);
-    vector<int64_t> inDims = inputXML.getDimensions();
-    if (direction == CiftiXML::ALONG_ROW)
+    enum ExcludeMode
     {
-        vector<float> scratchInRow(inDims[0]);
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(inDims.begin() + 1, inDims.end())); !iter.atEnd(); ++iter)
-        {// + 1 to exclude row dimension, because getRow/setRow
-            ciftiIn->getRow(scratchInRow.data(), *iter);
-            float result = -1;
-            if (onlyNumeric)
-            {
-                result = ReductionOperation::reduceOnlyNumeric(scratchInRow.data(), inDims[0], myReduce);
-            } else {
-                result = ReductionOperation::reduce(scratchInRow.data(), inDims[0], myReduce);
-            }
-            ciftiOut->setRow(&result, *iter);//if reducing along row, length of output row is 1
+        EXCLUDE_NONE,
+        EXCLUDE_NON_NUMERIC,
+        EXCLUDE_OUTLIERS
+    };
+    
+    void computeReductions(const MultiReduction& myReduce, const float* data, const int64_t& numElems, float* resultsOut,
+                           const ExcludeMode& mode, const float& sigmaBelow, const float& sigmaAbove)
+    {
+        switch (mode)
+        {
+            case EXCLUDE_NONE:
+                myReduce.compute(data, numElems, resultsOut);
+                break;
+            case EXCLUDE_NON_NUMERIC:
+                myReduce.computeOnlyNumeric(data, numElems, resultsOut);
+                break;
+            case EXCLUDE_OUTLIERS:
+                myReduce.computeExcludeDev(data, numElems, resultsOut, sigmaBelow, sigmaAbove);
+                break;
         }
-    } else {
-        vector<vector<float> > scratchInRows(inDims[direction], vector<float>(inDims[0]));
-        vector<float> outRow(inDims[0]), reduceScratch(inDims[direction]);//reduction isn't along row, so out rows will be same length as in rows
-        vector<int64_t> otherDims = inDims;
-        otherDims.erase(otherDims.begin() + direction);//direction isn't 0
-        otherDims.erase(otherDims.begin());//remove row direction because getRow/setRow
-        for (MultiDimIterator<int64_t> iter(otherDims); !iter.atEnd(); ++iter)
+    }
+    
+    const int64_t ROW_BLOCK_ROWS = 1024;//rows read before computing them in parallel, to keep file access serial
+    const int64_t ROW_BLOCK_BYTES = 64 * 1024 * 1024;//but fewer when rows are long, such as dconn rows
+    
+    void reduceCifti(const CiftiFile* ciftiIn, const vector<ReductionEnum::Enum>& myReduces, CiftiFile* ciftiOut,
+                     const ExcludeMode& mode, const float& sigmaBelow, const float& sigmaAbove, const int& direction)
+    {
+        CaretAssert(direction >= 0);
+        if (myReduces.empty()) throw AlgorithmException("no reduction operations specified");
+        MultiReduction myReduce;
+        for (int i = 0; i < (int)myReduces.size(); ++i)
+        {
+            myReduce.addReduction(myReduces[i]);
+        }
+        const int numResults = myReduce.getNumberOfResults();
+        const CiftiXML& inputXML = ciftiIn->getCiftiXML();
+        CiftiXML myOutXML = inputXML;
+        if (direction >= myOutXML.getNumberOfDimensions()) throw AlgorithmException("specified reduction direction doesn't exist in input cifti file");
+        CiftiScalarsMap newMap;
+        newMap.setLength(numResults);
+        for (int i = 0; i < numResults; ++i)
         {
-            vector<int64_t> indexvec = *iter;
-            indexvec.insert(indexvec.begin() + direction - 1, -1);//dummy value in place of reduce direction
-            for (int64_t i = 0; i < inDims[direction]; ++i)
+            newMap.setMapName(i, myReduce.getResultName(i));
+        }
+        myOutXML.setMap(direction, newMap);
+        ciftiOut->setCiftiXML(myOutXML);
+        vector<int64_t> inDims = inputXML.getDimensions();
+        if (direction == CiftiXML::ALONG_ROW)
+        {
+            int64_t blockSize = ROW_BLOCK_BYTES / (inDims[0] * (int64_t)sizeof(float));
+            if (blockSize > ROW_BLOCK_ROWS) blockSize = ROW_BLOCK_ROWS;
+            if (blockSize < 1) blockSize = 1;
+            vector<vector<int64_t> > blockIndices;
+            blockIndices.reserve(blockSize);
+            vector<float> blockIn(blockSize * inDims[0]), blockOut(blockSize * numResults);
+            vector<AString> errors(blockSize);//exceptions can't leave an omp region, so collect them and throw afterwards
+            MultiDimIterator<int64_t> iter(vector<int64_t>(inDims.begin() + 1, inDims.end()));// + 1 to exclude row dimension, because getRow/setRow
+            while (!iter.atEnd())
             {
-                indexvec[direction - 1] = i;
-                ciftiIn->getRow(scratchInRows[i].data(), indexvec);
+                blockIndices.clear();
+                for (; !iter.atEnd() && (int64_t)blockIndices.size() < blockSize; ++iter)
+                {
+                    ciftiIn->getRow(blockIn.data() + blockIndices.size() * inDims[0], *iter);
+                    blockIndices.push_back(*iter);
+                }
+                const int64_t blockRows = (int64_t)blockIndices.size();
+#pragma omp CARET_PARFOR schedule(dynamic)
+                for (int64_t i = 0; i < blockRows; ++i)
+                {
+                    try
+                    {
+                        computeReductions(myReduce, blockIn.data() + i * inDims[0], inDims[0], blockOut.data() + i * numResults, mode, sigmaBelow, sigmaAbove);
+                    } catch (CaretException& e) {
+                        errors[i] = e.whatString();
+                    }
+                }
+                for (int64_t i = 0; i < blockRows; ++i)
+                {
+                    if (!errors[i].isEmpty()) throw AlgorithmException(errors[i]);
+                    ciftiOut->setRow(blockOut.data() + i * numResults, blockIndices[i]);//if reducing along row, length of output row is number of reductions
+                }
             }
-            for (int64_t i = 0; i < inDims[0]; ++i)
+        } else {
+            vector<vector<float> > scratchInRows(inDims[direction], vector<float>(inDims[0]));
+            vector<vector<float> > outRows(numResults, vector<float>(inDims[0]));//reduction isn't along row, so out rows will be same length as in rows
+            vector<AString> errors(inDims[0]);
+            vector<int64_t> otherDims = inDims;
+            otherDims.erase(otherDims.begin() + direction);//direction isn't 0
+            otherDims.erase(otherDims.begin());//remove row direction because getRow/setRow
+            for (MultiDimIterator<int64_t> iter(otherDims); !iter.atEnd(); ++iter)
             {
-                for (int64_t j = 0; j < inDims[direction]; ++j)
-                {//need reduction input in contiguous array
-                    reduceScratch[j] = scratchInRows[j][i];
+                vector<int64_t> indexvec = *iter;
+                indexvec.insert(indexvec.begin() + direction - 1, -1);//dummy value in place of reduce direction
+                for (int64_t i = 0; i < inDims[direction]; ++i)
+                {
+                    indexvec[direction - 1] = i;
+                    ciftiIn->getRow(scratchInRows[i].data(), indexvec);
+                }
+#pragma omp CARET_PAR
+                {
+                    vector<float> reduceScratch(inDims[direction]), resultScratch(numResults);
+#pragma omp CARET_FOR schedule(dynamic, 64)
+                    for (int64_t i = 0; i < inDims[0]; ++i)
+                    {
+                        for (int64_t j = 0; j < inDims[direction]; ++j)
+                        {//need reduction input in contiguous array
+                            reduceScratch[j] = scratchInRows[j][i];
+                        }
+                        try
+                        {
+                            computeReductions(myReduce, reduceScratch.data(), inDims[direction], resultScratch.data(), mode, sigmaBelow, sigmaAbove);
+                        } catch (CaretException& e) {
+                            errors[i] = e.whatString();
+                            continue;
+                        }
+                        for (int r = 0; r < numResults; ++r)
+                        {
+                            outRows[r][i] = resultScratch[r];
+                        }
+                    }
                 }
-                if (onlyNumeric)
+                for (int64_t i = 0; i < inDims[0]; ++i)
                 {
-                    outRow[i] = ReductionOperation::reduceOnlyNumeric(reduceScratch.data(), inDims[direction], myReduce);
-                } else {
-                    outRow[i] = ReductionOperation::reduce(reduceScratch.data(), inDims[direction], myReduce);
+                    if (!errors[i].isEmpty()) throw AlgorithmException(errors[i]);
+                }
+                for (int r = 0; r < numResults; ++r)
+                {
+                    indexvec[direction - 1] = r;
+                    ciftiOut->setRow(outRows[r].data(), indexvec);
                 }
             }
-            indexvec[direction - 1] = 0;//only one element along reduce output direction
-            ciftiOut->setRow(outRow.data(), indexvec);
         }
     }
 }
 
+AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const ReductionEnum::Enum& myReduce, CiftiFile* ciftiOut,
+                                           const bool& onlyNumeric, const int& direction) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    reduceCifti(ciftiIn, vector<ReductionEnum::Enum>(1, myReduce), ciftiOut, (onlyNumeric ? EXCLUDE_NON_NUMERIC : EXCLUDE_NONE), 0.0f, 0.0f, direction);
+}
+
 AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const ReductionEnum::Enum& myReduce, CiftiFile* ciftiOut,
                                            const float& sigmaBelow, const float& sigmaAbove, const int& direction) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
-    CaretAssert(direction >= 0);
-    const CiftiXML& inputXML = ciftiIn->getCiftiXML();
-    CiftiXML myOutXML = inputXML;
-    if (direction >= myOutXML.getNumberOfDimensions()) throw AlgorithmException("specified reduction direction doesn't exist in input cifti file");
-    CiftiScalarsMap newMap;
-    newMap.setLength(1);
-    newMap.setMapName(0, ReductionEnum::toName(myReduce));
-    myOutXML.setMap(direction, newMap);
-    ciftiOut->setCiftiXML(myOutXML);
-    vector<int64_t> inDims = inputXML.getDimensions();
-    if (direction == CiftiXML::ALONG_ROW)
-    {
-        vector<float> scratchInRow(inDims[0]);
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(inDims.begin() + 1, inDims.end())); !iter.atEnd(); ++iter)
-        {// + 1 to exclude row dimension, because getRow/setRow
-            ciftiIn->getRow(scratchInRow.data(), *iter);
-            float result = ReductionOperation::reduceExcludeDev(scratchInRow.data(), inDims[0], myReduce, sigmaBelow, sigmaAbove);
-            ciftiOut->setRow(&result, *iter);//if reducing along row, length of output row is 1
-        }
-    } else {
-        vector<vector<float> > scratchInRows(inDims[direction], vector<float>(inDims[0]));
-        vector<float> outRow(inDims[0]), reduceScratch(inDims[direction]);//reduction isn't along row, so out rows will be same length as in rows
-        vector<int64_t> otherDims = inDims;
-        otherDims.erase(otherDims.begin() + direction);//direction isn't 0
-        otherDims.erase(otherDims.begin());//remove row direction because getRow/setRow
-        for (MultiDimIterator<int64_t> iter(otherDims); !iter.atEnd(); ++iter)
-        {
-            vector<int64_t> indexvec = *iter;
-            indexvec.insert(indexvec.begin() + direction - 1, -1);//dummy value in place of reduce direction
-            for (int64_t i = 0; i < inDims[direction]; ++i)
-            {
-                indexvec[direction - 1] = i;
-                ciftiIn->getRow(scratchInRows[i].data(), indexvec);
-            }
-            for (int64_t i = 0; i < inDims[0]; ++i)
-            {
-                for (int64_t j = 0; j < inDims[direction]; ++j)
-                {//need reduction input in contiguous array
-                    reduceScratch[j] = scratchInRows[j][i];
-                }
-                outRow[i] = ReductionOperation::reduceExcludeDev(reduceScratch.data(), inDims[direction], myReduce, sigmaBelow, sigmaAbove);
-            }
-            indexvec[direction - 1] = 0;//only one element along reduce output direction
-            ciftiOut->setRow(outRow.data(), indexvec);
-        }
-    }
+    reduceCifti(ciftiIn, vector<ReductionEnum::Enum>(1, myReduce), ciftiOut, EXCLUDE_OUTLIERS, sigmaBelow, sigmaAbove, direction);
+}
+
+AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const vector<ReductionEnum::Enum>& myReduces, CiftiFile* ciftiOut,
+                                           const bool& onlyNumeric, const int& direction) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    reduceCifti(ciftiIn, myReduces, ciftiOut, (onlyNumeric ? EXCLUDE_NON_NUMERIC : EXCLUDE_NONE), 0.0f, 0.0f, direction);
+}
+
+AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const vector<ReductionEnum::Enum>& myReduces, CiftiFile* ciftiOut,
+                                           const float& sigmaBelow, const float& sigmaAbove, const int& direction) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    reduceCifti(ciftiIn, myReduces, ciftiOut, EXCLUDE_OUTLIERS, sigmaBelow, sigmaAbove, direction);
 }
 
 float AlgorithmCiftiReduce::getAlgorithmInternalWeight()
@@ -25,6 +25,8 @@
 #include "CiftiXML.h"
 #include "ReductionEnum.h"
 
+#include <vector>
+
 namespace caret {
     
     class AlgorithmCiftiReduce : public AbstractAlgorithm
@@ -38,6 +40,11 @@ namespace caret {
                              const bool& onlyNumeric = false, const int& direction = CiftiXML::ALONG_ROW);
         AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const ReductionEnum::Enum& myReduce, CiftiFile* ciftiOut,
                              const float& sigmaBelow, const float& sigmaAbove, const int& direction = CiftiXML::ALONG_ROW);
+        ///compute several reductions in one pass, output has one map per reduction along the reduce direction
+        AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const std::vector<ReductionEnum::Enum>& myReduces, CiftiFile* ciftiOut,
+                             const bool& onlyNumeric = false, const int& direction = CiftiXML::ALONG_ROW);
+        AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const std::vector<ReductionEnum::Enum>& myReduces, CiftiFile* ciftiOut,
+                             const float& sigmaBelow, const float& sigmaAbove, const int& direction = CiftiXML::ALONG_ROW);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
@@ -383,6 +383,8 @@ void AlgorithmMetricDilate::processColumn(float* colScratch, const float* myInpu
         } else {
             myGeoHelp.grabNew(new GeodesicHelper(correctedBase));
         }
+        vector<int32_t> nodeList;//per-thread, reused for every node
+        vector<float> distList;
 #pragma omp CARET_FOR schedule(dynamic)
         for (int i = 0; i < numNodes; ++i)
         {
@@ -420,8 +422,6 @@ void AlgorithmMetricDilate::processColumn(float* colScratch, const float* myInpu
                     {
                         colScratch[i] = myInputData[closestNode];
                     } else {
-                        vector<int32_t> nodeList;
-                        vector<float> distList;
                         if (linear)
                         {
                             myGeoHelp->getNodesToGeoDist(i, distance, nodeList, distList);
@@ -603,6 +603,8 @@ void AlgorithmMetricDilate::precomputeStencils(vector<pair<int, StencilElem> >&
         } else {
             myGeoHelp.grabNew(new GeodesicHelper(correctedBase));
         }
+        vector<int32_t> nodeList;//per-thread, reused for every node
+        vector<float> distList;
 #pragma omp CARET_FOR schedule(dynamic)
         for (int i = 0; i < numNodes; ++i)
         {
@@ -635,8 +637,6 @@ void AlgorithmMetricDilate::precomputeStencils(vector<pair<int, StencilElem> >&
                 }
                 if (closestNode != -1)
                 {
-                    vector<int32_t> nodeList;
-                    vector<float> distList;
                     myGeoHelp->getNodesToGeoDist(i, closestDist * cutoffRatio, nodeList, distList);
                     int numInRange = (int)nodeList.size();
                     myElem.m_weightsum = 0.0f;
@@ -34,6 +34,20 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class NeighborhoodVisitor : public GeodesicHelper::NodeVisitor
+    {
+        vector<int32_t>& m_nodes;
+    public:
+        NeighborhoodVisitor(vector<int32_t>& nodes) : m_nodes(nodes) { }
+        void visit(const int32_t& node, const float&)
+        {
+            m_nodes.push_back(node);
+        }
+    };
+}
+
 AString AlgorithmMetricExtrema::getCommandSwitch()
 {
     return "-metric-extrema";
@@ -407,7 +421,6 @@ void AlgorithmMetricExtrema::precomputeNeighborhoods(const SurfaceFile* mySurf,
     neighborhoods.resize(numNodes);
     CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();//can share this, we will only use 1-hop neighbors
     CaretPointer<GeodesicHelper> myGeoHelp = mySurf->getGeodesicHelper();//must be thread-private
-    vector<float> junk;//also thread-private
     for (int i = 0; i < numNodes; ++i)
     {
         if (roiColumn == NULL || roiColumn[i] > 0.0f)
@@ -431,7 +444,8 @@ void AlgorithmMetricExtrema::precomputeNeighborhoods(const SurfaceFile* mySurf,
                     continue;
                 }
             }
-            myGeoHelp->getNodesToGeoDist(i, distance, neighborhoods[i], junk);
+            NeighborhoodVisitor myVisitor(neighborhoods[i]);//we don't need the distances, so don't build them
+            myGeoHelp->visitNodesToGeoDist(i, distance, myVisitor);
             int numelems = (int)neighborhoods[i].size();
             if (numelems < 7)
             {
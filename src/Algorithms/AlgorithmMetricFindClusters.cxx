@@ -21,12 +21,15 @@
 #include "AlgorithmMetricFindClusters.h"
 #include "AlgorithmException.h"
 
+#include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "ClusterHelper.h"
 #include "GeodesicHelper.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
-#include "TopologyHelper.h"
 
+#include <algorithm>
 #include <vector>
 
 using namespace caret;
@@ -145,87 +148,66 @@ void AlgorithmMetricFindClusters::useParameters(OperationParameters* myParams, P
 
 namespace
 {
-    struct Cluster
+    struct ColumnClusters
     {
-        Cluster() { area = 0.0; }
-        vector<int32_t> members;
-        double area;
+        vector<int64_t> labels;//index of the surviving cluster for each vertex, -1 for none
+        int64_t numClusters;
+        bool nonPositive;//clusters were found, but none had positive area
     };
     
-    void processColumn(const float* data, const float* roiData, const float* nodeAreas, TopologyHelper* myTopoHelp, GeodesicHelper* myGeoHelp,
-                       const float& threshVal, const float& minArea, const bool& lessThan, const float& areaRatio, const float& distanceCutoff,
-                       float* outData, int& markVal)
+    //thread-safe part, so many columns can be processed at once, marking values are handed out afterwards in column order
+    void findColumnClusters(const float* data, const float* roiData, const float* nodeAreas, const ClusterHelper& myClusterHelp, GeodesicHelper* myGeoHelp,
+                            const float& threshVal, const float& minArea, const bool& lessThan, const float& areaRatio, const float& distanceCutoff,
+                            vector<char>& maskScratch, vector<ClusterHelper::Cluster>& clusterScratch, ColumnClusters& result)
     {
-        int numNodes = myTopoHelp->getNumberOfNodes();
-        vector<int> marked(numNodes, 0);
-        if (lessThan)
+        int numNodes = (int)myClusterHelp.getNumberOfElements();
+        maskScratch.resize(numNodes);
+        for (int i = 0; i < numNodes; ++i)
         {
-            for (int i = 0; i < numNodes; ++i)
-            {
-                if ((roiData == NULL || roiData[i] > 0.0f) && data[i] < threshVal)
-                {
-                    marked[i] = 1;
-                }
-            }
-        } else {
-            for (int i = 0; i < numNodes; ++i)
-            {
-                if ((roiData == NULL || roiData[i] > 0.0f) && data[i] > threshVal)
-                {
-                    marked[i] = 1;
-                }
-            }
+            maskScratch[i] = (roiData == NULL || roiData[i] > 0.0f) && (lessThan ? data[i] < threshVal : data[i] > threshVal);
         }
-        vector<Cluster> clusters;
+        myClusterHelp.findClusters(maskScratch.data(), nodeAreas, result.labels, clusterScratch);//sums the areas in the same pass
+        int numFound = (int)clusterScratch.size();
+        vector<char> keep(numFound, 0);
         float biggestSize = 0.0f;
         int biggestCluster = -1;
-        for (int i = 0; i < numNodes; ++i)
+        bool anyKept = false;
+        for (int i = 0; i < numFound; ++i)
         {
-            if (marked[i])
+            if (clusterScratch[i].m_size > minArea)
             {
-                Cluster newCluster;
-                newCluster.members.push_back(i);
-                marked[i] = 0;//unmark it when added to list to prevent multiples
-                for (int index = 0; index < (int)newCluster.members.size(); ++index)//NOTE: vector grows inside loop
+                keep[i] = 1;
+                anyKept = true;
+                if (clusterScratch[i].m_size > biggestSize)
                 {
-                    int node = newCluster.members[index];//keep list around so we can put it into the output immediately if it is large enough
-                    newCluster.area += nodeAreas[node];
-                    const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(node);
-                    int numNeigh = (int)neighbors.size();
-                    for (int n = 0; n < numNeigh; ++n)
-                    {
-                        const int32_t& neighbor = neighbors[n];
-                        if (marked[neighbor])
-                        {
-                            newCluster.members.push_back(neighbor);
-                            marked[neighbor] = 0;
-                        }
-                    }
-                }
-                if (newCluster.area > minArea)
-                {
-                    if (newCluster.area > biggestSize)
-                    {
-                        biggestSize = newCluster.area;
-                        biggestCluster = (int)clusters.size();
-                    }
-                    clusters.push_back(newCluster);
+                    biggestSize = clusterScratch[i].m_size;
+                    biggestCluster = i;
                 }
             }
         }
-        vector<int32_t> pathScratch;
-        vector<float> distScratch;
-        if (!clusters.empty() && biggestCluster == -1) CaretLogWarning("clusters found, but none have positive area, check your vertex areas for negatives");
+        result.nonPositive = (anyKept && biggestCluster == -1);
         if (biggestCluster != -1 && (distanceCutoff > 0.0f || areaRatio > 0.0f))
         {
-            for (size_t i = 0; i < clusters.size(); ++i)
+            vector<vector<int32_t> > members;
+            if (distanceCutoff > 0.0f)
             {
-                if ((int)i != biggestCluster)
+                members.resize(numFound);
+                for (int i = 0; i < numNodes; ++i)
+                {
+                    int64_t label = result.labels[i];
+                    if (label != -1 && keep[label]) members[label].push_back(i);
+                }
+            }
+            vector<int32_t> pathScratch;
+            vector<float> distScratch;
+            for (int i = 0; i < numFound; ++i)
+            {
+                if (keep[i] && i != biggestCluster)
                 {
                     bool erase = false;
                     if (areaRatio > 0.0f)
                     {
-                        if ((clusters[i].area / biggestSize) < areaRatio)
+                        if ((clusterScratch[i].m_size / biggestSize) < areaRatio)
                         {
                             erase = true;
                         }
@@ -233,22 +215,33 @@ namespace
                     if (!erase && distanceCutoff > 0.0f)
                     {
                         CaretAssert(myGeoHelp != NULL);
-                        myGeoHelp->getPathBetweenNodeLists(clusters[i].members, clusters[biggestCluster].members, distanceCutoff, pathScratch, distScratch, true);
+                        myGeoHelp->getPathBetweenNodeLists(members[i], members[biggestCluster], distanceCutoff, pathScratch, distScratch, true);
                         if (pathScratch.empty())//empty path means no path found
                         {
                             erase = true;
                         }
                     }
-                    if (erase)
-                    {
-                        clusters.erase(clusters.begin() + i);//remove it
-                        --i;//don't skip a cluster
-                        if (biggestCluster > (int)i) --biggestCluster;//don't lose track of the biggest cluster
-                    }
+                    if (erase) keep[i] = 0;
                 }
             }
         }
-        for (size_t i = 0; i < clusters.size(); ++i)
+        vector<int64_t> newIndex(numFound, -1);//renumber the survivors, keeping their order
+        result.numClusters = 0;
+        for (int i = 0; i < numFound; ++i)
+        {
+            if (keep[i]) newIndex[i] = result.numClusters++;
+        }
+        for (int i = 0; i < numNodes; ++i)
+        {
+            if (result.labels[i] != -1) result.labels[i] = newIndex[result.labels[i]];
+        }
+    }
+    
+    void markClusters(const ColumnClusters& result, float* outData, int& markVal)
+    {
+        if (result.nonPositive) CaretLogWarning("clusters found, but none have positive area, check your vertex areas for negatives");
+        vector<float> markValues(result.numClusters);
+        for (int64_t i = 0; i < result.numClusters; ++i)
         {
             if (markVal == 0)
             {
@@ -257,13 +250,14 @@ namespace
             }
             float tempVal = markVal;
             if ((int)tempVal != markVal) throw AlgorithmException("too many clusters, unable to mark them uniquely");
-            int numMembers = (int)clusters[i].members.size();
-            for (int index = 0; index < numMembers; ++index)
-            {
-                outData[clusters[i].members[index]] = tempVal;
-            }
+            markValues[i] = tempVal;
             ++markVal;
         }
+        int numNodes = (int)result.labels.size();
+        for (int i = 0; i < numNodes; ++i)
+        {
+            outData[i] = (result.labels[i] == -1 ? 0.0f : markValues[result.labels[i]]);
+        }
     }
 }
 
@@ -302,41 +296,68 @@ AlgorithmMetricFindClusters::AlgorithmMetricFindClusters(ProgressObject* myProgO
     } else {
         nodeAreas = myAreas->getValuePointerForColumn(0);
     }
-    CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();
-    CaretPointer<GeodesicHelper> myGeoHelp;
+    ClusterHelper myClusterHelp(mySurf);
     CaretPointer<GeodesicHelperBase> myGeoBase;
-    if (distanceCutoff > 0.0f)//geodesic is only needed for distance cutoff
+    if (distanceCutoff > 0.0f && myAreas != NULL)//geodesic is only needed for distance cutoff
+    {
+        myGeoBase.grabNew(new GeodesicHelperBase(mySurf, myAreas->getValuePointerForColumn(0)));
+    }
+    vector<int> inColumns;
+    if (columnNum == -1)
     {
-        if (myAreas == NULL)
+        for (int c = 0; c < numCols; ++c)
         {
-            myGeoHelp = mySurf->getGeodesicHelper();
-        } else {
-            myGeoBase.grabNew(new GeodesicHelperBase(mySurf, myAreas->getValuePointerForColumn(0)));
-            myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
+            inColumns.push_back(c);
         }
+    } else {
+        inColumns.push_back(columnNum);
     }
-    vector<int> toSearch;
+    int numOutCols = (int)inColumns.size();
+    myMetricOut->setNumberOfNodesAndColumns(numNodes, numOutCols);
+    myMetricOut->setStructure(mySurf->getStructure());
+#ifdef CARET_OMP
+    int batchSize = omp_get_max_threads();//only keep one batch of labels in memory at a time
+#else
+    int batchSize = 1;
+#endif
+    vector<CaretPointer<GeodesicHelper> > geoHelpers(batchSize);//one per thread, kept across batches
+    vector<ColumnClusters> results(min(batchSize, numOutCols));
+    vector<float> outData(numNodes);
     int markVal = startVal;//give each cluster a different value, including across maps
-    if (columnNum == -1)
+    for (int batchStart = 0; batchStart < numOutCols; batchStart += batchSize)
     {
-        myMetricOut->setNumberOfNodesAndColumns(numNodes, numCols);
-        myMetricOut->setStructure(mySurf->getStructure());
-        for (int c = 0; c < numCols; ++c)
+        int batchEnd = min(batchStart + batchSize, numOutCols);
+#pragma omp CARET_PAR
         {
-            myMetricOut->setColumnName(c, myMetric->getColumnName(c));
-            vector<float> outData(numNodes, 0.0f);
-            const float* data = myMetric->getValuePointerForColumn(c);
-            processColumn(data, roiData, nodeAreas, myTopoHelp, myGeoHelp, threshVal, minArea, lessThan, areaRatio, distanceCutoff, outData.data(), markVal);
+#ifdef CARET_OMP
+            CaretPointer<GeodesicHelper>& myGeoHelp = geoHelpers[omp_get_thread_num()];
+#else
+            CaretPointer<GeodesicHelper>& myGeoHelp = geoHelpers[0];
+#endif
+            if (distanceCutoff > 0.0f && myGeoHelp == NULL)
+            {
+                if (myGeoBase == NULL)
+                {
+                    myGeoHelp = mySurf->getGeodesicHelper();
+                } else {
+                    myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
+                }
+            }
+            vector<char> maskScratch;
+            vector<ClusterHelper::Cluster> clusterScratch;
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int c = batchStart; c < batchEnd; ++c)
+            {
+                findColumnClusters(myMetric->getValuePointerForColumn(inColumns[c]), roiData, nodeAreas, myClusterHelp, myGeoHelp, threshVal, minArea, lessThan,
+                                   areaRatio, distanceCutoff, maskScratch, clusterScratch, results[c - batchStart]);
+            }
+        }
+        for (int c = batchStart; c < batchEnd; ++c)
+        {
+            myMetricOut->setColumnName(c, myMetric->getColumnName(inColumns[c]));
+            markClusters(results[c - batchStart], outData.data(), markVal);
             myMetricOut->setValuesForColumn(c, outData.data());
         }
-    } else {
-        myMetricOut->setNumberOfNodesAndColumns(numNodes, 1);
-        myMetricOut->setStructure(mySurf->getStructure());
-        myMetricOut->setColumnName(0, myMetric->getColumnName(columnNum));
-        vector<float> outData(numNodes, 0.0f);
-        const float* data = myMetric->getValuePointerForColumn(columnNum);
-        processColumn(data, roiData, nodeAreas, myTopoHelp, myGeoHelp, threshVal, minArea, lessThan, areaRatio, distanceCutoff, outData.data(), markVal);
-        myMetricOut->setValuesForColumn(0, outData.data());
     }
     if (endVal != NULL) *endVal = markVal;
 }
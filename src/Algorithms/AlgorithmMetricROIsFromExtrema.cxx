@@ -240,12 +240,12 @@ void AlgorithmMetricROIsFromExtrema::processMap(const float* data, vector<float>
                                                 int64_t& mapCounter, CaretPointer<GeodesicHelper>& myHelp, const float& limit, const float* roiData,
                                                 const OverlapLogicEnum::Enum& overlapType, const int& numNodes)
 {
+    vector<int32_t> nodeList;//reused across nodes, getNodesToGeoDist clears them but keeps their capacity
+    vector<float> distList;
     for (int j = 0; j < numNodes; ++j)
     {
         if ((roiData == NULL || roiData[j] > 0.0f) && data[j] != 0.0f)
         {
-            vector<int32_t> nodeList;
-            vector<float> distList;
             myHelp->getNodesToGeoDist(j, limit, nodeList, distList);
             int listNum = (int)nodeList.size();
             switch (overlapType)
@@ -21,11 +21,12 @@
 #include "AlgorithmMetricRemoveIslands.h"
 #include "AlgorithmException.h"
 
+#include "CaretOMP.h"
+#include "ClusterHelper.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
-#include "TopologyHelper.h"
 
-#include <utility>
+#include <algorithm>
 #include <vector>
 
 using namespace caret;
@@ -92,68 +93,58 @@ AlgorithmMetricRemoveIslands::AlgorithmMetricRemoveIslands(ProgressObject* myPro
     int numCols = myMetric->getNumberOfColumns();
     myMetricOut->setNumberOfNodesAndColumns(numNodes, numCols);
     myMetricOut->setStructure(myMetric->getStructure());
-    for (int col = 0; col < numCols; ++col)
+    ClusterHelper myClusterHelp(mySurf);
+#ifdef CARET_OMP
+    int batchSize = omp_get_max_threads();//only keep one batch of output columns in memory at a time
+#else
+    int batchSize = 1;
+#endif
+    vector<vector<float> > outColumns(min(batchSize, numCols));
+    for (int batchStart = 0; batchStart < numCols; batchStart += batchSize)
     {
-        vector<pair<float, vector<int> > > areas;
-        vector<int> used(numNodes, 0);
-        CaretPointer<TopologyHelper> myHelp = mySurf->getTopologyHelper();
-        const float* roiData = myMetric->getValuePointerForColumn(col);
-        myMetricOut->setColumnName(col, myMetric->getColumnName(col));
-        for (int i = 0; i < numNodes; ++i)
+        int batchEnd = min(batchStart + batchSize, numCols);
+#pragma omp CARET_PAR
         {
-            if (used[i] == 0 && roiData[i] > 0.0f)
+            vector<char> mask(numNodes);
+            vector<int64_t> labels;
+            vector<ClusterHelper::Cluster> clusters;
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int col = batchStart; col < batchEnd; ++col)
             {
-                areas.push_back(make_pair(0.0f, vector<int>()));
-                vector<int>& thisAreaMembers = areas.back().second;
-                float& thisSurfArea = areas.back().first;
-                thisAreaMembers.push_back(i);
-                thisSurfArea += areaData[i];
-                used[i] = 1;
-                vector<int> mystack;
-                mystack.push_back(i);
-                while (!mystack.empty())
+                const float* roiData = myMetric->getValuePointerForColumn(col);
+                for (int i = 0; i < numNodes; ++i)
                 {
-                    int curnode = mystack.back();
-                    mystack.pop_back();
-                    const vector<int32_t>& neighbors = myHelp->getNodeNeighbors(curnode);
-                    int numNeigh = (int)neighbors.size();
-                    for (int j = 0; j < numNeigh; ++j)
+                    mask[i] = (roiData[i] > 0.0f);
+                }
+                myClusterHelp.findClusters(mask.data(), areaData, labels, clusters);
+                vector<float>& outscratch = outColumns[col - batchStart];
+                outscratch.assign(numNodes, 0.0f);
+                int numAreas = (int)clusters.size();
+                if (numAreas > 0)
+                {
+                    int bestIndex = 0;
+                    float bestArea = clusters[0].m_size;
+                    for (int i = 1; i < numAreas; ++i)
                     {
-                        int thisneigh = neighbors[j];
-                        if (used[thisneigh] == 0 && roiData[thisneigh] > 0.0f)
+                        float thisArea = (int)clusters[i].m_size;
+                        if (thisArea > bestArea)
                         {
-                            used[thisneigh] = 1;
-                            thisAreaMembers.push_back(thisneigh);
-                            thisSurfArea += areaData[thisneigh];
-                            mystack.push_back(thisneigh);
+                            bestIndex = i;
+                            bestArea = thisArea;
                         }
                     }
+                    for (int i = 0; i < numNodes; ++i)
+                    {
+                        if (labels[i] == bestIndex) outscratch[i] = 1.0f;//make it into a simple 0/1 metric, even if it wasn't before
+                    }
                 }
             }
         }
-        vector<float> outscratch(numNodes, 0.0f);
-        int numAreas = (int)areas.size();
-        if (numAreas > 0)
+        for (int col = batchStart; col < batchEnd; ++col)
         {
-            int bestIndex = 0;
-            float bestArea = areas[0].first;
-            for (int i = 1; i < numAreas; ++i)
-            {
-                float thisArea = (int)areas[i].first;
-                if (thisArea > bestArea)
-                {
-                    bestIndex = i;
-                    bestArea = thisArea;
-                }
-            }
-            const vector<int>& thisArea = areas[bestIndex].second;
-            int numAreaNodes = (int)thisArea.size();
-            for (int i = 0; i < numAreaNodes; ++i)
-            {
-                outscratch[thisArea[i]] = 1.0f;//make it into a simple 0/1 metric, even if it wasn't before
-            }
+            myMetricOut->setColumnName(col, myMetric->getColumnName(col));
+            myMetricOut->setValuesForColumn(col, outColumns[col - batchStart].data());
         }
-        myMetricOut->setValuesForColumn(col, outscratch.data());
     }
 }
 
@@ -27,7 +27,9 @@
 #include "BoundingBox.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "SurfaceFile.h"
+#include "SurfaceLaplacianHelper.h"
 
 using namespace caret;
 
@@ -165,6 +167,11 @@ AlgorithmSurfaceInflation::AlgorithmSurfaceInflation(ProgressObject* myProgObj,
     
     const int32_t numberOfNodes = outputSurfaceFile->getNumberOfNodes();
     
+    /*
+     * Topology doesn't change between cycles, so build the adjacency once
+     */
+    const SurfaceLaplacianHelper laplacianHelper(outputSurfaceFile);
+    
     for (int iCycle = 0; iCycle < cycles; iCycle++) {
         /*
          * Smooth
@@ -178,15 +185,17 @@ AlgorithmSurfaceInflation::AlgorithmSurfaceInflation(ProgressObject* myProgObj,
                                   outputSurfaceFile,
                                   outputSurfaceFile,
                                   strength,
-                                  iterations);
+                                  iterations,
+                                  &laplacianHelper);
         
         /*
          * Inflate
          */
-        float xyz[3];
+        std::vector<float> coords(outputSurfaceFile->getCoordinateData(),
+                                  outputSurfaceFile->getCoordinateData() + (numberOfNodes * 3));
+#pragma omp CARET_PARFOR schedule(static)
         for (int32_t iNode = 0; iNode < numberOfNodes; iNode++) {
-            outputSurfaceFile->getCoordinate(iNode,
-                                             xyz);
+            float* xyz = &coords[iNode * 3];
             
             const float x = xyz[0] / anatomicalRangeX;
             const float y = xyz[1] / anatomicalRangeY;
@@ -198,10 +207,8 @@ AlgorithmSurfaceInflation::AlgorithmSurfaceInflation(ProgressObject* myProgObj,
             xyz[0] *= scale;
             xyz[1] *= scale;
             xyz[2] *= scale;
-            
-            outputSurfaceFile->setCoordinate(iNode,
-                                             xyz);
         }
+        outputSurfaceFile->setCoordinates(&coords[0]);
         
         myProgress.reportProgress(static_cast<float>(iCycle +1)
                                   / static_cast<float>(cycles));
@@ -19,14 +19,16 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
+
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretPointer.h"
 
 #include "AlgorithmSurfaceSmoothing.h"
 #include "AlgorithmException.h"
-#include "MathFunctions.h"
 #include "SurfaceFile.h"
-#include "TopologyHelper.h"
+#include "SurfaceLaplacianHelper.h"
 
 using namespace caret;
 
@@ -120,7 +122,8 @@ AlgorithmSurfaceSmoothing::AlgorithmSurfaceSmoothing(ProgressObject* myProgObj,
                                                      const SurfaceFile* inputSurfaceFile,
                                                      SurfaceFile* outputSurfaceFile,
                                                      const float strength,
-                                                     const int32_t iterations)
+                                                     const int32_t iterations,
+                                                     const SurfaceLaplacianHelper* laplacianHelper)
    : AbstractAlgorithm(myProgObj)
 {
     if ((strength < 0.0)
@@ -142,153 +145,56 @@ AlgorithmSurfaceSmoothing::AlgorithmSurfaceSmoothing(ProgressObject* myProgObj,
     
     *outputSurfaceFile = *inputSurfaceFile;
     
-    CaretPointer<TopologyHelper> myTopoHelp = outputSurfaceFile->getTopologyHelper(true);
-    
     const int32_t numNodes = outputSurfaceFile->getNumberOfNodes();
     if (numNodes <= 0) {
         return;
     }
     
     /*
-     * Storage for coordinates, input and output of each iteration
+     * Neighbor adjacency of the surface, shared by all iterations,
+     * callers that smooth the same topology repeatedly can pass their own
      */
-    std::vector<float> coordsIn(numNodes * 3);
-    std::vector<float> coordsOut(numNodes * 3);
+    CaretPointer<SurfaceLaplacianHelper> ownHelper;
+    if (laplacianHelper == NULL) {
+        ownHelper.grabNew(new SurfaceLaplacianHelper(outputSurfaceFile));
+        laplacianHelper = ownHelper;
+    }
+    else if (laplacianHelper->getNumberOfNodes() != numNodes) {
+        throw AlgorithmException("Laplacian helper was built for a surface with a different number of vertices");
+    }
     
     /*
      * Copy coordinates from surface
      */
-    for (int32_t i = 0; i < numNodes; i++) {
-        const float* xyz = outputSurfaceFile->getCoordinate(i);
-        
-        const int32_t i3 = i * 3;
-        coordsIn[i3]   = xyz[0];
-        coordsIn[i3+1] = xyz[1];
-        coordsIn[i3+2] = xyz[2];
-        coordsOut[i3]   = xyz[0];
-        coordsOut[i3+1] = xyz[1];
-        coordsOut[i3+2] = xyz[2];
-    }
-    
-    std::vector<float> triangleAreas(100);
-    std::vector<float> triangleCenters(100*3);
-    
-    const float inverseStrength = 1.0 - strength;
+    const float* coordsSurface = outputSurfaceFile->getCoordinateData();
+    std::vector<float> coords(coordsSurface,
+                              coordsSurface + (numNodes * 3));
     
     /*
-     * Perform the requested number of iterations
+     * Perform the requested number of iterations.  Iterations are
+     * done in blocks so that each block runs in one parallel region
+     * while progress is still updated between blocks.
      */
-    for (int32_t iter = 1; iter <= iterations; iter++) {
-        /*
-         * Copy coordinates from previous iteration
-         */
-        if (iter > 1) {
-            coordsIn = coordsOut;
-        }
-        
-        /*
-         * Process each node
-         */
-        for (int32_t iNode = 0; iNode < numNodes; iNode++) {
-            /*
-             * Get node's neighbors
-             */
-            int32_t numNeighbors = 0;
-            const int32_t* neighbors = myTopoHelp->getNodeNeighbors(iNode, numNeighbors);
-            
-            if (numNeighbors < 2) {
-                coordsOut[iNode*3]   = coordsIn[iNode*3];
-                coordsOut[iNode*3+1] = coordsIn[iNode*3+1];
-                coordsOut[iNode*3+2] = coordsIn[iNode*3+2];
-            }
-            else {
-                /*
-                 * Ensure adequate space for triangle areas and center coordinate
-                 */
-                if (numNeighbors > static_cast<int32_t>(triangleAreas.size())) {
-                    triangleAreas.resize(numNeighbors);
-                    triangleCenters.resize(numNeighbors * 3);
-                }
-                double totalArea = 0.0;
-                
-                /*
-                 * Average node with its neighbors
-                 */
-                for (int jn = 0; jn < numNeighbors; jn++) {
-                    /*
-                     * Get two consecutive neighbors
-                     */
-                    const int32_t n1 = neighbors[jn];
-                    int nextNeighborIndex = jn + 1;
-                    if (nextNeighborIndex >= numNeighbors) {
-                        nextNeighborIndex = 0;
-                    }
-                    const int32_t n2 = neighbors[nextNeighborIndex];
-                    
-                    /*
-                     * Coordinates of nodes and neighbors
-                     */
-                    const float* c1 = &coordsIn[iNode*3];
-                    const float* c2 = &coordsIn[n1*3];
-                    const float* c3 = &coordsIn[n2*3];
-                    const float area = MathFunctions::triangleArea(c1,
-                                                                   c2,
-                                                                   c3);
-                    
-                    /*
-                     * Area of triangle formed by node and neighbors
-                     */
-                    triangleAreas[jn] = area;
-                    totalArea += area;
-                    
-                    /*
-                     * Average of nodes that form triangle
-                     */
-                    for (int32_t k = 0; k < 3; k++) {
-                        triangleCenters[jn*3+k] = (c1[k] + c2[k] + c3[k]) / 3.0;
-                    }
-                }
-                    
-                /*
-                 * Influence of neighbors
-                 */
-                float neighborAverageX = 0.0;
-                float neighborAverageY = 0.0;
-                float neighborAverageZ = 0.0;
-                for (int j = 0; j < numNeighbors; j++) {
-                    if (triangleAreas[j] > 0.0) {
-                        const float weight = triangleAreas[j] / totalArea;
-                        neighborAverageX += (weight * triangleCenters[j*3]);
-                        neighborAverageY += (weight * triangleCenters[j*3+1]);
-                        neighborAverageZ += (weight * triangleCenters[j*3+2]);
-                    }
-                }
-                
-                /*
-                 * Update coordinates
-                 */
-                coordsOut[iNode*3]   = ((coordsIn[iNode*3] * inverseStrength)
-                                        + (neighborAverageX * strength));
-                coordsOut[iNode*3+1] = ((coordsIn[iNode*3+1] * inverseStrength)
-                                        + (neighborAverageY * strength));
-                coordsOut[iNode*3+2] = ((coordsIn[iNode*3+2] * inverseStrength)
-                                        + (neighborAverageZ * strength));
-            }
-        }
+    const int32_t iterationsPerBlock = 10;
+    for (int32_t iterDone = 0; iterDone < iterations; iterDone += iterationsPerBlock) {
+        const int32_t blockIterations = std::min(iterationsPerBlock,
+                                                 iterations - iterDone);
+        laplacianHelper->smoothAreaWeighted(&coords[0],
+                                            strength,
+                                            blockIterations);
         
         /*
          * Update progress
          */
-        const float percentDone = (static_cast<float>(iter)
+        const float percentDone = (static_cast<float>(iterDone + blockIterations)
                                     / static_cast<float>(iterations));
-        myProgress.reportProgress(percentDone);//give continuous updates, if it slows things down we can reduce the resolution in the progress framework
-        
+        myProgress.reportProgress(percentDone);
     }
 
     /*
      * Copy coordinates into surface
      */
-    outputSurfaceFile->setCoordinates(&coordsOut[0]);
+    outputSurfaceFile->setCoordinates(&coords[0]);
 
     myProgress.reportProgress(1.0f);
 }
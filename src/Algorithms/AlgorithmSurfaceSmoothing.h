@@ -26,6 +26,8 @@
 
 namespace caret {
 
+    class SurfaceLaplacianHelper;
+    
     class AlgorithmSurfaceSmoothing : public AbstractAlgorithm {
 
     private:
@@ -41,7 +43,8 @@ namespace caret {
                                   const SurfaceFile* inputSurfaceFile,
                                   SurfaceFile* outputSurfaceFile,
                                   const float strength,
-                                  const int32_t iterations);
+                                  const int32_t iterations,
+                                  const SurfaceLaplacianHelper* laplacianHelper = NULL);
 
         static OperationParameters* getParameters();
 
@@ -21,13 +21,14 @@
 #include "AlgorithmVolumeFindClusters.h"
 #include "AlgorithmException.h"
 
-#include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "CaretPointer.h"
 #include "CaretPointLocator.h"
+#include "ClusterHelper.h"
 #include "VolumeFile.h"
-#include "VoxelIJK.h"
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -135,123 +136,89 @@ void AlgorithmVolumeFindClusters::useParameters(OperationParameters* myParams, P
 
 namespace
 {
-    void processSubvol(const float* inFrame, VolumeFile* volOut, const int64_t& outSubvol, const int64_t& outComponent, const float& threshValue, const float& minVolume,
-                       const bool& lessThan, const float* roiFrame, const float& sizeRatio, const float& distanceCutoff, int& markVal)
+    struct FrameClusters
     {
-        vector<int64_t> dims = volOut->getDimensions();
-        int64_t frameSize = dims[0] * dims[1] * dims[2];
-        const VolumeSpace& mySpace = volOut->getVolumeSpace();
+        vector<int64_t> labels;//index of the surviving cluster for each voxel, -1 for none
+        int64_t numClusters;
+    };
+    
+    //thread-safe part, so many frames can be processed at once, marking values are handed out afterwards in frame order
+    void findFrameClusters(const float* inFrame, const VolumeSpace& mySpace, const ClusterHelper& myClusterHelp, const float& threshValue, const float& minVolume,
+                           const bool& lessThan, const float* roiFrame, const float& sizeRatio, const float& distanceCutoff,
+                           vector<char>& maskScratch, vector<ClusterHelper::Cluster>& clusterScratch, FrameClusters& result)
+    {
+        const int64_t* dims = mySpace.getDims();
+        int64_t frameSize = myClusterHelp.getNumberOfElements();
         Vector3D ivec, jvec, kvec, origin;
         mySpace.getSpacingVectors(ivec, jvec, kvec, origin);
         float voxelVolume = abs(ivec.dot(jvec.cross(kvec)));
         int64_t minVoxels = (int64_t)ceil(minVolume / voxelVolume);
-        vector<VoxelIJK> neighbors;
-        neighbors.push_back(VoxelIJK(1, 0, 0));
-        neighbors.push_back(VoxelIJK(-1, 0, 0));
-        neighbors.push_back(VoxelIJK(0, 1, 0));
-        neighbors.push_back(VoxelIJK(0, -1, 0));
-        neighbors.push_back(VoxelIJK(0, 0, 1));
-        neighbors.push_back(VoxelIJK(0, 0, -1));
-        vector<char> marked(frameSize, 0);
-        if (lessThan)
+        maskScratch.resize(frameSize);
+        for (int64_t i = 0; i < frameSize; ++i)
         {
-            for (int64_t i = 0; i < frameSize; ++i)
-            {
-                if ((roiFrame == NULL || roiFrame[i] > 0.0f) && inFrame[i] < threshValue)
-                {
-                    marked[i] = 1;
-                }
-            }
-        } else {
-            for (int64_t i = 0; i < frameSize; ++i)
-            {
-                if ((roiFrame == NULL || roiFrame[i] > 0.0f) && inFrame[i] > threshValue)
-                {
-                    marked[i] = 1;
-                }
-            }
+            maskScratch[i] = (roiFrame == NULL || roiFrame[i] > 0.0f) && (lessThan ? inFrame[i] < threshValue : inFrame[i] > threshValue);
         }
-        vector<vector<VoxelIJK> > clusters;
-        size_t biggestCount = 0;
+        myClusterHelp.findClusters(maskScratch.data(), NULL, result.labels, clusterScratch);//counts the voxels in the same pass
+        int64_t numFound = (int64_t)clusterScratch.size();
+        vector<char> keep(numFound, 0);
+        int64_t biggestCount = 0;
         int64_t biggestCluster = -1;
-        for (int64_t k = 0; k < dims[2]; ++k)
+        for (int64_t i = 0; i < numFound; ++i)
         {
-            for (int64_t j = 0; j < dims[1]; ++j)
+            if (clusterScratch[i].m_count >= minVoxels)
             {
-                for (int64_t i = 0; i < dims[0]; ++i)
+                keep[i] = 1;
+                if (clusterScratch[i].m_count > biggestCount)
                 {
-                    int64_t myIndex = mySpace.getIndex(i, j, k);
-                    if (marked[myIndex])
-                    {
-                        vector<VoxelIJK> voxelList;
-                        voxelList.push_back(VoxelIJK(i, j, k));
-                        marked[myIndex] = 0;//don't let voxels get duplicated in the list
-                        for (int64_t index = 0; index < (int64_t)voxelList.size(); ++index)//NOTE: vector grows inside loop
-                        {
-                            const VoxelIJK& thisVoxel = voxelList[index];
-                            for (int n = 0; n < (int)neighbors.size(); ++n)
-                            {
-                                VoxelIJK neighVox(thisVoxel.m_ijk[0] + neighbors[n].m_ijk[0],
-                                                    thisVoxel.m_ijk[1] + neighbors[n].m_ijk[1],
-                                                    thisVoxel.m_ijk[2] + neighbors[n].m_ijk[2]);
-                                if (mySpace.indexValid(neighVox.m_ijk))
-                                {
-                                    int64_t neighIndex = mySpace.getIndex(neighVox.m_ijk);
-                                    if (marked[neighIndex])
-                                    {
-                                        voxelList.push_back(neighVox);
-                                        marked[neighIndex] = 0;
-                                    }
-                                }
-                            }
-                        }
-                        if ((int64_t)voxelList.size() >= minVoxels)
-                        {
-                            if (voxelList.size() > biggestCount)
-                            {
-                                biggestCount = voxelList.size();
-                                biggestCluster = (int64_t)clusters.size();
-                            }
-                            clusters.push_back(voxelList);
-                        }
-                    }
+                    biggestCount = clusterScratch[i].m_count;
+                    biggestCluster = i;
                 }
             }
         }
-        if (!clusters.empty()) CaretAssert(biggestCluster != -1);
         if (biggestCluster != -1 && (distanceCutoff > 0.0f || sizeRatio > 0.0f))
         {
+            vector<vector<int64_t> > members;
             CaretPointer<CaretPointLocator> myLocator;
             if (distanceCutoff > 0.0f)
             {
+                members.resize(numFound);
+                for (int64_t i = 0; i < frameSize; ++i)
+                {
+                    int64_t label = result.labels[i];
+                    if (label != -1 && keep[label]) members[label].push_back(i);
+                }
                 vector<float> biggestCoords;//gather coordinates of biggest cluster voxels
                 biggestCoords.reserve(biggestCount * 3);
-                for (size_t i = 0; i < clusters[biggestCluster].size(); ++i)
+                for (size_t i = 0; i < members[biggestCluster].size(); ++i)
                 {
+                    int64_t index = members[biggestCluster][i];
+                    int64_t ijk[3] = { index % dims[0], (index / dims[0]) % dims[1], index / dims[0] / dims[1] };
                     float thisCoord[3];
-                    mySpace.indexToSpace(clusters[biggestCluster][i].m_ijk, thisCoord);
+                    mySpace.indexToSpace(ijk, thisCoord);
                     biggestCoords.push_back(thisCoord[0]);
                     biggestCoords.push_back(thisCoord[1]);
                     biggestCoords.push_back(thisCoord[2]);
                 }
                 myLocator.grabNew(new CaretPointLocator(biggestCoords.data(), biggestCoords.size()));
             }
-            for (size_t i = 0; i < clusters.size(); ++i)
+            for (int64_t i = 0; i < numFound; ++i)
             {
-                if ((int64_t)i != biggestCluster)
+                if (keep[i] && i != biggestCluster)
                 {
                     bool erase = false;
-                    if (sizeRatio > 0.0f && ((float)clusters[i].size()) / biggestCount < sizeRatio)
+                    if (sizeRatio > 0.0f && ((float)clusterScratch[i].m_count) / biggestCount < sizeRatio)
                     {
                         erase = true;
                     }
                     if (!erase && distanceCutoff > 0.0f)
                     {
                         erase = true;//erase unless we find a point close enough to the biggest cluster
-                        for (size_t j = 0; j < clusters[i].size(); ++j)
+                        for (size_t j = 0; j < members[i].size(); ++j)
                         {
+                            int64_t index = members[i][j];
+                            int64_t ijk[3] = { index % dims[0], (index / dims[0]) % dims[1], index / dims[0] / dims[1] };
                             float thisCoord[3];
-                            mySpace.indexToSpace(clusters[i][j].m_ijk, thisCoord);
+                            mySpace.indexToSpace(ijk, thisCoord);
                             int32_t ret = myLocator->closestPointLimited(thisCoord, distanceCutoff);
                             if (ret == -1)
                             {
@@ -260,16 +227,26 @@ namespace
                             }
                         }
                     }
-                    if (erase)
-                    {
-                        clusters.erase(clusters.begin() + i);//remove it
-                        --i;//don't skip a cluster
-                        if (biggestCluster > (int64_t)i) --biggestCluster;//don't lose track of the biggest cluster
-                    }
+                    if (erase) keep[i] = 0;
                 }
             }
         }
-        for (size_t i = 0; i < clusters.size(); ++i)
+        vector<int64_t> newIndex(numFound, -1);//renumber the survivors, keeping their order
+        result.numClusters = 0;
+        for (int64_t i = 0; i < numFound; ++i)
+        {
+            if (keep[i]) newIndex[i] = result.numClusters++;
+        }
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            if (result.labels[i] != -1) result.labels[i] = newIndex[result.labels[i]];
+        }
+    }
+    
+    void markClusters(const FrameClusters& result, float* outFrame, int& markVal)
+    {
+        vector<float> markValues(result.numClusters);
+        for (int64_t i = 0; i < result.numClusters; ++i)
         {
             if (markVal == 0)
             {
@@ -278,12 +255,14 @@ namespace
             }
             float tempVal = markVal;
             if ((int)tempVal != markVal) throw AlgorithmException("too many clusters, unable to mark them uniquely");
-            for (size_t index = 0; index < clusters[i].size(); ++index)
-            {
-                volOut->setValue(tempVal, clusters[i][index].m_ijk, outSubvol, outComponent);
-            }
+            markValues[i] = tempVal;
             ++markVal;
         }
+        int64_t frameSize = (int64_t)result.labels.size();
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            outFrame[i] = (result.labels[i] == -1 ? 0.0f : markValues[result.labels[i]]);
+        }
     }
 }
 
@@ -304,28 +283,58 @@ AlgorithmVolumeFindClusters::AlgorithmVolumeFindClusters(ProgressObject* myProgO
         roiFrame = myRoi->getFrame();
     }
     vector<int64_t> dims = volIn->getDimensions();
-    int markVal = startVal;
+    vector<int64_t> inSubvols, outSubvols, components;//frames in marking order
     if (subvolNum == -1)
     {
         volOut->reinitialize(volIn->getOriginalDimensions(), volIn->getSform(), dims[4]);
-        volOut->setValueAllVoxels(0.0f);
         for (int64_t c = 0; c < dims[4]; ++c)
         {
             for (int64_t s = 0; s < dims[3]; ++s)
             {
-                const float* inFrame = volIn->getFrame(s, c);
-                processSubvol(inFrame, volOut, s, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, markVal);
+                inSubvols.push_back(s);
+                outSubvols.push_back(s);
+                components.push_back(c);
             }
         }
     } else {
         vector<int64_t> outDims = volIn->getOriginalDimensions();
         outDims.resize(3);
         volOut->reinitialize(outDims, volIn->getSform(), dims[4]);
-        volOut->setValueAllVoxels(0.0f);
         for (int64_t c = 0; c < dims[4]; ++c)
         {
-            const float* inFrame = volIn->getFrame(subvolNum, c);
-            processSubvol(inFrame, volOut, 0, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, markVal);
+            inSubvols.push_back(subvolNum);
+            outSubvols.push_back(0);
+            components.push_back(c);
+        }
+    }
+    ClusterHelper myClusterHelp(mySpace.getDims());
+    int numFrames = (int)inSubvols.size();
+#ifdef CARET_OMP
+    int batchSize = omp_get_max_threads();//only keep one batch of labels in memory at a time
+#else
+    int batchSize = 1;
+#endif
+    vector<FrameClusters> results(min(batchSize, numFrames));
+    vector<float> outFrame(myClusterHelp.getNumberOfElements());
+    int markVal = startVal;
+    for (int batchStart = 0; batchStart < numFrames; batchStart += batchSize)
+    {
+        int batchEnd = min(batchStart + batchSize, numFrames);
+#pragma omp CARET_PAR
+        {
+            vector<char> maskScratch;
+            vector<ClusterHelper::Cluster> clusterScratch;
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int f = batchStart; f < batchEnd; ++f)
+            {
+                findFrameClusters(volIn->getFrame(inSubvols[f], components[f]), mySpace, myClusterHelp, threshValue, minVolume, lessThan, roiFrame,
+                                  sizeRatio, distanceCutoff, maskScratch, clusterScratch, results[f - batchStart]);
+            }
+        }
+        for (int f = batchStart; f < batchEnd; ++f)
+        {
+            markClusters(results[f - batchStart], outFrame.data(), markVal);
+            volOut->setFrame(outFrame.data(), outSubvols[f], components[f]);
         }
     }
     if (endVal != NULL) *endVal = markVal;
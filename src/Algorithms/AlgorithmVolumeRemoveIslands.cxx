@@ -21,8 +21,11 @@
 #include "AlgorithmVolumeRemoveIslands.h"
 #include "AlgorithmException.h"
 
+#include "CaretOMP.h"
+#include "ClusterHelper.h"
 #include "VolumeFile.h"
 
+#include <algorithm>
 #include <vector>
 
 using namespace caret;
@@ -61,93 +64,68 @@ void AlgorithmVolumeRemoveIslands::useParameters(OperationParameters* myParams,
 AlgorithmVolumeRemoveIslands::AlgorithmVolumeRemoveIslands(ProgressObject* myProgObj, const VolumeFile* myVolIn, VolumeFile* myVolOut) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
-    const int STENCIL_SIZE = 18;//the easy way, and prepare for different stencils if we ever need them
-    const int stencil[STENCIL_SIZE] = { 0, 0, -1,
-                                  0, -1, 0,
-                                  -1, 0, 0,
-                                  1, 0, 0,
-                                  0, 1, 0,
-                                  0, 0, 1 };
     vector<int64_t> dims;
     myVolIn->getDimensions(dims);
     myVolOut->reinitialize(myVolIn->getOriginalDimensions(), myVolIn->getSform(), myVolIn->getNumberOfComponents(), myVolIn->getType());
+    vector<int> subvols, components;
     for (int s = 0; s < dims[3]; ++s)
     {
         myVolOut->setMapName(s, myVolIn->getMapName(s));
         for (int c = 0; c < dims[4]; ++c)
         {
-            int64_t ijk[3];
-            vector<vector<int64_t> > parts;
-            vector<int> used(dims[0] * dims[1] * dims[2], 0);
-            const float* frame = myVolIn->getFrame(s, c);
-            for (ijk[2] = 0; ijk[2] < dims[2]; ++ijk[2])
+            subvols.push_back(s);
+            components.push_back(c);
+        }
+    }
+    ClusterHelper myClusterHelp(dims.data(), ClusterHelper::FACE);//prepare for different stencils if we ever need them
+    const int64_t frameSize = myClusterHelp.getNumberOfElements();
+    const int numFrames = (int)subvols.size();
+#ifdef CARET_OMP
+    int batchSize = omp_get_max_threads();//only keep one batch of output frames in memory at a time
+#else
+    int batchSize = 1;
+#endif
+    vector<vector<float> > outFrames(min(batchSize, numFrames));
+    for (int batchStart = 0; batchStart < numFrames; batchStart += batchSize)
+    {
+        int batchEnd = min(batchStart + batchSize, numFrames);
+#pragma omp CARET_PAR
+        {
+            vector<char> mask(frameSize);
+            vector<int64_t> labels;
+            vector<ClusterHelper::Cluster> parts;
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int f = batchStart; f < batchEnd; ++f)
             {
-                for (ijk[1] = 0; ijk[1] < dims[1]; ++ijk[1])
+                const float* frame = myVolIn->getFrame(subvols[f], components[f]);
+                for (int64_t i = 0; i < frameSize; ++i)
                 {
-                    for (ijk[0] = 0; ijk[0] < dims[0]; ++ijk[0])
-                    {
-                        int64_t index = myVolIn->getIndex(ijk);
-                        if (used[index] == 0 && frame[index] > 0.0f)
-                        {
-                            parts.push_back(vector<int64_t>());
-                            vector<int64_t>& thispart = parts.back();
-                            thispart.push_back(ijk[0]);
-                            thispart.push_back(ijk[1]);
-                            thispart.push_back(ijk[2]);
-                            used[index] = 1;
-                            vector<int64_t> mystack;
-                            mystack.push_back(ijk[0]);
-                            mystack.push_back(ijk[1]);
-                            mystack.push_back(ijk[2]);
-                            while (!mystack.empty())
-                            {
-                                int64_t curSize = (int64_t)mystack.size();
-                                int64_t curvox[3] = { mystack[curSize - 3], mystack[curSize - 2], mystack[curSize - 1] };
-                                mystack.resize(curSize - 3);//basically pop_back
-                                for (int i = 0; i < STENCIL_SIZE; i += 3)
-                                {
-                                    int64_t neighbor[3] = { curvox[0] + stencil[i], curvox[1] + stencil[i + 1], curvox[2] + stencil[i + 2] };
-                                    if (myVolIn->indexValid(neighbor))
-                                    {
-                                        int64_t neighindex = myVolIn->getIndex(neighbor);
-                                        if (used[neighindex] == 0 && frame[neighindex] > 0.0f)
-                                        {
-                                            thispart.push_back(neighbor[0]);
-                                            thispart.push_back(neighbor[1]);
-                                            thispart.push_back(neighbor[2]);
-                                            used[neighindex] = 1;
-                                            mystack.push_back(neighbor[0]);
-                                            mystack.push_back(neighbor[1]);
-                                            mystack.push_back(neighbor[2]);
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
+                    mask[i] = (frame[i] > 0.0f);
                 }
-            }
-            int64_t bestCount = -1, bestPart = -1, numParts = (int64_t)parts.size();
-            for (int64_t i = 0; i < numParts; ++i)
-            {
-                int64_t thisCount = (int64_t)parts[i].size();
-                if (thisCount > bestCount)
+                myClusterHelp.findClusters(mask.data(), NULL, labels, parts);
+                int64_t bestCount = -1, bestPart = -1, numParts = (int64_t)parts.size();
+                for (int64_t i = 0; i < numParts; ++i)
                 {
-                    bestCount = thisCount;
-                    bestPart = i;
+                    if (parts[i].m_count > bestCount)
+                    {
+                        bestCount = parts[i].m_count;
+                        bestPart = i;
+                    }
                 }
-            }
-            vector<float> outFrame(dims[0] * dims[1] * dims[2], 0.0f);
-            if (bestPart != -1)
-            {
-                vector<int64_t>& myPart = parts[bestPart];
-                for (int64_t i = 0; i < bestCount; i += 3)
+                vector<float>& outFrame = outFrames[f - batchStart];
+                outFrame.assign(frameSize, 0.0f);
+                if (bestPart != -1)
                 {
-                    int64_t myIndex = myVolIn->getIndex(myPart.data() + i);
-                    outFrame[myIndex] = 1.0f;//make it a simple 0/1 volume, even if it wasn't before
+                    for (int64_t i = 0; i < frameSize; ++i)
+                    {
+                        if (labels[i] == bestPart) outFrame[i] = 1.0f;//make it a simple 0/1 volume, even if it wasn't before
+                    }
                 }
             }
-            myVolOut->setFrame(outFrame.data(), s, c);
+        }
+        for (int f = batchStart; f < batchEnd; ++f)
+        {
+            myVolOut->setFrame(outFrames[f - batchStart].data(), subvols[f], components[f]);
         }
     }
 }
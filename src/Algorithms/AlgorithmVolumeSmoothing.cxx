@@ -24,7 +24,9 @@
 #include "Vector3D.h"
 #include "CaretLogger.h"
 #include "CaretOMP.h"
+#include "CaretProfiler.h"
 #include "CaretAssert.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -33,6 +35,282 @@ using namespace std;
 //makes the program issue warning only once per launch, prevents repeated calls by other algorithms from spamming
 bool AlgorithmVolumeSmoothing::haveWarned = false;
 
+namespace
+{
+    struct SmoothWorkspace
+    {//per-thread scratch, reused for every frame that thread handles
+        vector<float> m_data, m_scratch, m_weights, m_weightScratch;
+        vector<char> m_mask;
+        bool m_haveWeights;
+        SmoothWorkspace() { m_haveWeights = false; }
+    };
+    
+    //three 1-dimensional gaussian passes over the bounding box of the ROI, every pass keeps the contiguous i dimension innermost so it streams and vectorizes
+    class OrthogonalSmoother
+    {
+        int64_t m_fullDims[3], m_boxStart[3], m_boxDims[3], m_boxSize;
+        vector<float> m_kernels[3];
+        int m_ranges[3];
+        vector<char> m_roiMask;//box sized, empty when there is no ROI
+        vector<float> m_sharedWeights;//smoothed mask, only when it is the same for every frame
+        bool m_fixZeros;
+        
+        void passI(const float* in, float* out, const bool& parallel) const;
+        void passJ(const float* in, float* out, const bool& parallel) const;
+        void passK(const float* in, float* out, const bool& parallel) const;
+        void smoothBox(vector<float>& data, vector<float>& scratch, const bool& parallel) const;
+    public:
+        OrthogonalSmoother(const vector<int64_t>& myDims, const VolumeFile* roiVol, const float& kernel, const Vector3D& spacing, const bool& fixZeros);
+        void smooth(const float* inFrame, float* outFrame, SmoothWorkspace& work, const bool& parallel) const;
+    };
+    
+    OrthogonalSmoother::OrthogonalSmoother(const vector<int64_t>& myDims, const VolumeFile* roiVol, const float& kernel, const Vector3D& spacing, const bool& fixZeros)
+    {
+        m_fixZeros = fixZeros;
+        float kernBox = kernel * 3.0f;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            m_fullDims[axis] = myDims[axis];
+            int range = (int)floor(kernBox / spacing[axis]);
+            if (range < 1) range = 1;//don't underflow
+            m_ranges[axis] = range;
+            m_kernels[axis].resize(range * 2 + 1);
+            for (int i = 0; i < range * 2 + 1; ++i)
+            {
+                float tempf = spacing[axis] * (i - range) / kernel;
+                m_kernels[axis][i] = exp(-tempf * tempf / 2.0f);
+            }
+            m_boxStart[axis] = 0;
+            m_boxDims[axis] = myDims[axis];
+        }
+        if (roiVol != NULL)
+        {//intermediate sums outside the ROI bounding box are never read by an output voxel inside it, so crop to the box
+            const float* roiFrame = roiVol->getFrame();
+            int64_t boxMin[3] = { myDims[0], myDims[1], myDims[2] }, boxMax[3] = { -1, -1, -1 };
+            for (int64_t k = 0; k < myDims[2]; ++k)
+            {
+                for (int64_t j = 0; j < myDims[1]; ++j)
+                {
+                    const float* roiRow = roiFrame + (k * myDims[1] + j) * myDims[0];
+                    for (int64_t i = 0; i < myDims[0]; ++i)
+                    {
+                        if (roiRow[i] > 0.0f)
+                        {
+                            if (i < boxMin[0]) boxMin[0] = i;
+                            if (i > boxMax[0]) boxMax[0] = i;
+                            if (j < boxMin[1]) boxMin[1] = j;
+                            if (j > boxMax[1]) boxMax[1] = j;
+                            if (k < boxMin[2]) boxMin[2] = k;
+                            if (k > boxMax[2]) boxMax[2] = k;
+                        }
+                    }
+                }
+            }
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (boxMax[axis] < boxMin[axis])
+                {//empty ROI, output is all zeros
+                    m_boxStart[axis] = 0;
+                    m_boxDims[axis] = 0;
+                } else {
+                    m_boxStart[axis] = boxMin[axis];
+                    m_boxDims[axis] = boxMax[axis] - boxMin[axis] + 1;
+                }
+            }
+            m_boxSize = m_boxDims[0] * m_boxDims[1] * m_boxDims[2];
+            m_roiMask.resize(m_boxSize);
+            for (int64_t k = 0; k < m_boxDims[2]; ++k)
+            {
+                for (int64_t j = 0; j < m_boxDims[1]; ++j)
+                {
+                    const float* roiRow = roiFrame + ((k + m_boxStart[2]) * myDims[1] + j + m_boxStart[1]) * myDims[0] + m_boxStart[0];
+                    char* maskRow = m_roiMask.data() + (k * m_boxDims[1] + j) * m_boxDims[0];
+                    for (int64_t i = 0; i < m_boxDims[0]; ++i)
+                    {
+                        maskRow[i] = (roiRow[i] > 0.0f ? 1 : 0);
+                    }
+                }
+            }
+        } else {
+            m_boxSize = m_boxDims[0] * m_boxDims[1] * m_boxDims[2];
+        }
+        if (!fixZeros && m_boxSize > 0)
+        {//the mask is the same for every frame, so the normalization is too
+            m_sharedWeights.resize(m_boxSize);
+            vector<float> scratch(m_boxSize);
+            for (int64_t b = 0; b < m_boxSize; ++b)
+            {
+                m_sharedWeights[b] = ((m_roiMask.empty() || m_roiMask[b] != 0) ? 1.0f : 0.0f);
+            }
+            smoothBox(m_sharedWeights, scratch, true);
+        }
+    }
+    
+    void OrthogonalSmoother::passI(const float* in, float* out, const bool& parallel) const
+    {
+        const int64_t numRows = m_boxDims[1] * m_boxDims[2], rowSize = m_boxDims[0];
+        const int range = m_ranges[0];
+        const float* weights = m_kernels[0].data();
+#pragma omp CARET_PARFOR schedule(dynamic, 16) if(parallel)
+        for (int64_t row = 0; row < numRows; ++row)
+        {
+            const float* inRow = in + row * rowSize;
+            float* outRow = out + row * rowSize;
+            for (int64_t i = 0; i < rowSize; ++i) outRow[i] = 0.0f;
+            for (int offset = -range; offset <= range; ++offset)
+            {//shifted multiply-add instead of a per-voxel kernel loop, so the inner loop has no bounds tests
+                const float weight = weights[offset + range];
+                const int64_t istart = max<int64_t>(0, -offset), iend = min<int64_t>(rowSize, rowSize - offset);
+                for (int64_t i = istart; i < iend; ++i)
+                {
+                    outRow[i] += weight * inRow[i + offset];
+                }
+            }
+        }
+    }
+    
+    void OrthogonalSmoother::passJ(const float* in, float* out, const bool& parallel) const
+    {
+        const int64_t rowSize = m_boxDims[0], sliceSize = m_boxDims[0] * m_boxDims[1];
+        const int range = m_ranges[1];
+        const float* weights = m_kernels[1].data();
+#pragma omp CARET_PARFOR schedule(dynamic) if(parallel)
+        for (int64_t k = 0; k < m_boxDims[2]; ++k)//one slice at a time, its rows stay in cache while they are reused by neighboring rows
+        {
+            const float* inSlice = in + k * sliceSize;
+            float* outSlice = out + k * sliceSize;
+            for (int64_t j = 0; j < m_boxDims[1]; ++j)
+            {
+                float* outRow = outSlice + j * rowSize;
+                for (int64_t i = 0; i < rowSize; ++i) outRow[i] = 0.0f;
+                int64_t jmin = max<int64_t>(0, j - range), jmax = min<int64_t>(m_boxDims[1], j + range + 1);//one-after array size convention
+                for (int64_t jkern = jmin; jkern < jmax; ++jkern)
+                {
+                    const float weight = weights[jkern - j + range];
+                    const float* inRow = inSlice + jkern * rowSize;
+                    for (int64_t i = 0; i < rowSize; ++i)
+                    {
+                        outRow[i] += weight * inRow[i];
+                    }
+                }
+            }
+        }
+    }
+    
+    void OrthogonalSmoother::passK(const float* in, float* out, const bool& parallel) const
+    {
+        const int64_t rowSize = m_boxDims[0], sliceSize = m_boxDims[0] * m_boxDims[1];
+        const int range = m_ranges[2];
+        const float* weights = m_kernels[2].data();
+#pragma omp CARET_PARFOR schedule(dynamic) if(parallel)
+        for (int64_t j = 0; j < m_boxDims[1]; ++j)//one i-k plane at a time, so the rows in the kernel window are reused while still in cache
+        {
+            for (int64_t k = 0; k < m_boxDims[2]; ++k)
+            {
+                float* outRow = out + k * sliceSize + j * rowSize;
+                for (int64_t i = 0; i < rowSize; ++i) outRow[i] = 0.0f;
+                int64_t kmin = max<int64_t>(0, k - range), kmax = min<int64_t>(m_boxDims[2], k + range + 1);
+                for (int64_t kkern = kmin; kkern < kmax; ++kkern)
+                {
+                    const float weight = weights[kkern - k + range];
+                    const float* inRow = in + kkern * sliceSize + j * rowSize;
+                    for (int64_t i = 0; i < rowSize; ++i)
+                    {
+                        outRow[i] += weight * inRow[i];
+                    }
+                }
+            }
+        }
+    }
+    
+    void OrthogonalSmoother::smoothBox(vector<float>& data, vector<float>& scratch, const bool& parallel) const
+    {//result ends up in data
+        passI(data.data(), scratch.data(), parallel);
+        passJ(scratch.data(), data.data(), parallel);
+        passK(data.data(), scratch.data(), parallel);
+        data.swap(scratch);
+    }
+    
+    void OrthogonalSmoother::smooth(const float* inFrame, float* outFrame, SmoothWorkspace& work, const bool& parallel) const
+    {
+        const int64_t frameSize = m_fullDims[0] * m_fullDims[1] * m_fullDims[2];
+        if (m_boxSize != frameSize)
+        {
+            for (int64_t v = 0; v < frameSize; ++v) outFrame[v] = 0.0f;
+        }
+        if (m_boxSize == 0) return;
+        work.m_data.resize(m_boxSize);
+        work.m_scratch.resize(m_boxSize);
+        const bool haveROI = !m_roiMask.empty();
+        bool maskChanged = false;
+        if (m_fixZeros)
+        {
+            work.m_mask.resize(m_boxSize, 0);
+        }
+        for (int64_t k = 0; k < m_boxDims[2]; ++k)//gather the box, applying the mask
+        {
+            for (int64_t j = 0; j < m_boxDims[1]; ++j)
+            {
+                const int64_t boxRowStart = (k * m_boxDims[1] + j) * m_boxDims[0];
+                const float* inRow = inFrame + ((k + m_boxStart[2]) * m_fullDims[1] + j + m_boxStart[1]) * m_fullDims[0] + m_boxStart[0];
+                float* dataRow = work.m_data.data() + boxRowStart;
+                for (int64_t i = 0; i < m_boxDims[0]; ++i)
+                {
+                    char use = ((!haveROI || m_roiMask[boxRowStart + i] != 0) ? 1 : 0);
+                    if (m_fixZeros)
+                    {
+                        if (inRow[i] == 0.0f) use = 0;
+                        if (work.m_mask[boxRowStart + i] != use)
+                        {
+                            work.m_mask[boxRowStart + i] = use;
+                            maskChanged = true;
+                        }
+                    }
+                    dataRow[i] = (use != 0 ? inRow[i] : 0.0f);
+                }
+            }
+        }
+        const float* weights = NULL;
+        if (m_fixZeros)
+        {
+            if (maskChanged || !work.m_haveWeights)
+            {//frames with the same zero pattern (typical for 4D data) reuse the previous normalization
+                work.m_weights.resize(m_boxSize);
+                work.m_weightScratch.resize(m_boxSize);
+                for (int64_t b = 0; b < m_boxSize; ++b)
+                {
+                    work.m_weights[b] = (work.m_mask[b] != 0 ? 1.0f : 0.0f);
+                }
+                smoothBox(work.m_weights, work.m_weightScratch, parallel);
+                work.m_haveWeights = true;
+            }
+            weights = work.m_weights.data();
+        } else {
+            weights = m_sharedWeights.data();
+        }
+        smoothBox(work.m_data, work.m_scratch, parallel);
+        for (int64_t k = 0; k < m_boxDims[2]; ++k)//divide by the smoothed weights and scatter back, zero outside the ROI
+        {
+            for (int64_t j = 0; j < m_boxDims[1]; ++j)
+            {
+                const int64_t boxRowStart = (k * m_boxDims[1] + j) * m_boxDims[0];
+                float* outRow = outFrame + ((k + m_boxStart[2]) * m_fullDims[1] + j + m_boxStart[1]) * m_fullDims[0] + m_boxStart[0];
+                const float* dataRow = work.m_data.data() + boxRowStart;
+                const float* weightRow = weights + boxRowStart;
+                for (int64_t i = 0; i < m_boxDims[0]; ++i)
+                {
+                    if (weightRow[i] != 0.0f && (!haveROI || m_roiMask[boxRowStart + i] != 0))
+                    {
+                        outRow[i] = dataRow[i] / weightRow[i];
+                    } else {
+                        outRow[i] = 0.0f;
+                    }
+                }
+            }
+        }
+    }
+}
+
 AString AlgorithmVolumeSmoothing::getCommandSwitch()
 {
     return "-volume-smoothing";
@@ -116,7 +394,7 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     {
         throw AlgorithmException("kernel too small");
     }
-    CaretArray<float> scratchFrame(myDims[0] * myDims[1] * myDims[2]);//it could be faster to preinitialize with zeros, then generate a usable voxels list if there is a small ROI...
+    const int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
     float kernBox = kernel * 3.0f;
     vector<vector<float> > volSpace = inVol->getSform();
     Vector3D ivec, jvec, kvec, origin, ijorth, jkorth, kiorth;
@@ -126,56 +404,18 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     const float ORTH_TOLERANCE = 0.001f;//tolerate this much deviation from orthogonal (dot product divided by product of lengths) to use orthogonal assumptions to smooth
     if (abs(ivec.dot(jvec.normal())) / ivec.length() < ORTH_TOLERANCE && abs(jvec.dot(kvec.normal())) / jvec.length() < ORTH_TOLERANCE && abs(kvec.dot(ivec.normal())) / kvec.length() < ORTH_TOLERANCE)
     {//if our axes are orthogonal, optimize by doing three 1-dimensional smoothings for O(voxels * (ki + kj + kk)) instead of O(voxels * (ki * kj * kk))
-        CaretArray<float> scratchFrame2(myDims[0] * myDims[1] * myDims[2]), scratchWeights(myDims[0] * myDims[1] * myDims[2]), scratchWeights2(myDims[0] * myDims[1] * myDims[2]), scratchFrame3;
-        if (roiVol != NULL)
-        {
-            scratchFrame3 = CaretArray<float> (myDims[0] * myDims[1] * myDims[2]);
-        }
-        float ispace = ivec.length(), jspace = jvec.length(), kspace = kvec.length();
-        int irange = (int)floor(kernBox / ispace);
-        int jrange = (int)floor(kernBox / jspace);
-        int krange = (int)floor(kernBox / kspace);
-        if (irange < 1) irange = 1;//don't underflow
-        if (jrange < 1) jrange = 1;
-        if (krange < 1) krange = 1;
-        int isize = irange * 2 + 1;//and construct a precomputed kernel in the box
-        int jsize = jrange * 2 + 1;
-        int ksize = krange * 2 + 1;
-        CaretArray<float> iweights(isize), jweights(jsize), kweights(ksize);
-        for (int i = 0; i < isize; ++i)
-        {
-            float tempf = ispace * (i - irange) / kernel;
-            iweights[i] = exp(-tempf * tempf / 2.0f);
-        }
-        for (int j = 0; j < jsize; ++j)
-        {
-            float tempf = jspace * (j - jrange) / kernel;
-            jweights[j] = exp(-tempf * tempf / 2.0f);
-        }
-        for (int k = 0; k < ksize; ++k)
-        {
-            float tempf = kspace * (k - krange) / kernel;
-            kweights[k] = exp(-tempf * tempf / 2.0f);
-        }
+        Vector3D spacing;
+        spacing[0] = ivec.length(); spacing[1] = jvec.length(); spacing[2] = kvec.length();
+        OrthogonalSmoother mySmoother(myDims, roiVol, kernel, spacing, fixZeros);
+        vector<int> frameMaps;//subvolume of each frame to do, component is looped separately
         if (subvol == -1)
         {
             vector<int64_t> origDims = inVol->getOriginalDimensions();
             outVol->reinitialize(origDims, volSpace, myDims[4]);
-            vector<int> lists[3];
             for (int s = 0; s < myDims[3]; ++s)
             {
                 outVol->setMapName(s, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
-                for (int c = 0; c < myDims[4]; ++c)
-                {
-                    const float* inFrame = inVol->getFrame(s, c);
-                    if (roiVol == NULL)
-                    {
-                        smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                    } else {
-                        smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                    }
-                    outVol->setFrame(scratchFrame, s, c);
-                }
+                frameMaps.push_back(s);
             }
         } else {
             vector<int64_t> origDims = inVol->getOriginalDimensions(), newDims;
@@ -184,19 +424,39 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
             newDims[1] = origDims[1];
             newDims[2] = origDims[2];
             outVol->reinitialize(newDims, volSpace, myDims[4]);
-            vector<int> lists[3];
             outVol->setMapName(0, inVol->getMapName(subvol) + ", smooth " + AString::number(kernel));
-            for (int c = 0; c < myDims[4]; ++c)
+            frameMaps.push_back(subvol);
+        }
+        int numThreads = 1;
+#ifdef CARET_OMP
+        numThreads = omp_get_max_threads();
+#endif
+        const int64_t numFrames = (int64_t)frameMaps.size() * myDims[4];
+        const int64_t BATCH_MEMORY_BYTES = ((int64_t)1) << 29;//bounds the output frames and workspaces of one batch
+        const int64_t bytesPerFrame = frameSize * (5 * (int64_t)sizeof(float) + 1);//output frame, plus up to four float buffers and a mask in the workspace
+        const int64_t maxBatchFrames = max((int64_t)1, BATCH_MEMORY_BYTES / max((int64_t)1, bytesPerFrame));
+        const bool acrossFrames = (numThreads > 1 && numFrames >= numThreads && maxBatchFrames >= numThreads);//with enough frames and memory, give each thread whole frames, otherwise split each frame's passes
+        const int64_t batchSize = (acrossFrames ? numThreads : 1);
+        vector<SmoothWorkspace> workspaces(batchSize);
+        vector<vector<float> > outFrames(batchSize, vector<float>(frameSize));
+        for (int64_t batchStart = 0; batchStart < numFrames; batchStart += batchSize)
+        {
+            const int64_t batchEnd = min(numFrames, batchStart + batchSize);
             {
-                const float* inFrame = inVol->getFrame(subvol, c);
-                if (roiVol == NULL)
+                CaretProfileSpan parallelSpan("AlgorithmVolumeSmoothing frames", "omp");
+#pragma omp CARET_PARFOR schedule(dynamic) if(acrossFrames)
+                for (int64_t frame = batchStart; frame < batchEnd; ++frame)
                 {
-                    smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                } else {
-                    smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                    int64_t slot = frame - batchStart;
+                    const float* inFrame = inVol->getFrame(frameMaps[frame / myDims[4]], frame % myDims[4]);
+                    mySmoother.smooth(inFrame, outFrames[slot].data(), workspaces[slot], !acrossFrames);
                 }
-                outVol->setFrame(scratchFrame, 0, c);
             }
+            for (int64_t frame = batchStart; frame < batchEnd; ++frame)
+            {
+                outVol->setFrame(outFrames[frame - batchStart].data(), (subvol == -1 ? frameMaps[frame / myDims[4]] : 0), frame % myDims[4]);
+            }
+            myProgress.reportProgress(batchEnd / (float)numFrames);
         }
     } else {
         if (!haveWarned)
@@ -204,6 +464,7 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
             CaretLogWarning("input volume is not orthogonal, smoothing will take longer");
             haveWarned = true;
         }
+        CaretArray<float> scratchFrame(frameSize);
         ijorth = ivec.cross(jvec).normal();//find the bounding box that encloses a sphere of radius kernBox
         jkorth = jvec.cross(kvec).normal();
         kiorth = kvec.cross(ivec).normal();
@@ -273,310 +534,6 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     }
 }
 
-void AlgorithmVolumeSmoothing::smoothFrame(const float* inFrame, vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, const VolumeFile* inVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights, int irange, int jrange, int krange, const bool& fixZeros)
-{//this function should ONLY get invoked when the volume is orthogonal (axes are perpendicular, not necessarily aligned with x, y, z, and not necessarily equal spacing)
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int k = 0; k < myDims[2]; ++k)//smooth along i axis
-    {
-        for (int j = 0; j < myDims[1]; ++j)
-        {
-            for (int i = 0; i < myDims[0]; ++i)
-            {
-                int imin = i - irange, imax = i + irange + 1;//one-after array size convention
-                if (imin < 0) imin = 0;
-                if (imax > myDims[0]) imax = myDims[0];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(0, j, k, 0);//extra 0 on a default parameter is to prevent int->pointer vs int->int64 conversion ambiguity
-                int64_t curInd = baseInd + i;
-                for (int ikern = imin; ikern < imax; ++ikern)
-                {
-                    int64_t thisIndex = baseInd + ikern;
-                    if ((!fixZeros || inFrame[thisIndex] != 0.0f))
-                    {
-                        float weight = iweights[ikern - i + irange];
-                        weightsum += weight;
-                        sum += weight * inFrame[thisIndex];
-                    }
-                }
-                scratchWeights[curInd] = weightsum;
-                scratchFrame[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
-            }
-        }
-    }
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int k = 0; k < myDims[2]; ++k)//now j
-    {
-        for (int i = 0; i < myDims[0]; ++i)
-        {
-            for (int j = 0; j < myDims[1]; ++j)//step along the dimension being smoothed last for best cache coherence
-            {
-                int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-                if (jmin < 0) jmin = 0;
-                if (jmax > myDims[1]) jmax = myDims[1];
-                float sum = 0.0f, weightsum = 0.0f;
-                int64_t baseInd = inVol->getIndex(i, 0, k);
-                int64_t curInd = baseInd + j * myDims[0];
-                for (int jkern = jmin; jkern < jmax; ++jkern)
-                {
-                    int64_t thisIndex = baseInd + jkern * myDims[0];
-                    float weight = jweights[jkern - j + jrange];
-                    weightsum += weight * scratchWeights[thisIndex];
-                    sum += weight * scratchFrame[thisIndex];
-                }
-                scratchWeights2[curInd] = weightsum;
-                scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
-            }
-        }
-    }
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int j = 0; j < myDims[1]; ++j)//and finally k
-    {
-        for (int i = 0; i < myDims[0]; ++i)
-        {
-            for (int k = 0; k < myDims[2]; ++k)//ditto
-            {
-                int64_t baseInd = inVol->getIndex(i, j, 0);
-                int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-                int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-                if (kmin < 0) kmin = 0;
-                if (kmax > myDims[2]) kmax = myDims[2];
-                float sum = 0.0f, weightsum = 0.0f;
-                for (int kkern = kmin; kkern < kmax; ++kkern)
-                {
-                    int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];
-                    float weight = kweights[kkern - k + krange];
-                    weightsum += weight * scratchWeights2[thisIndex];
-                    sum += weight * scratchFrame2[thisIndex];
-                }
-                if (weightsum != 0.0f)
-                {
-                    scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-                } else {
-                    scratchFrame[curInd] = 0.0f;
-                }
-            }
-        }
-    }
-}
-
-void AlgorithmVolumeSmoothing::smoothFrameROI(const float* inFrame, vector<int64_t> myDims, CaretArray<float> scratchFrame, CaretArray<float> scratchFrame2, CaretArray<float> scratchFrame3,
-                                              CaretArray<float> scratchWeights, CaretArray<float> scratchWeights2, vector<int> lists[3],
-                                              const VolumeFile* inVol, const VolumeFile* roiVol, CaretArray<float> iweights, CaretArray<float> jweights, CaretArray<float> kweights,
-                                              int irange, int jrange, int krange, const bool& fixZeros)
-{//optimized for orthogonal, plus lists of voxels for ROI smoothing
-    if (lists[0].size() == 0)
-    {//this is our first time into this function, we must populate the lists
-        const float* roiFrame = roiVol->getFrame();
-        CaretArray<int> markROI(myDims[0] * myDims[1] * myDims[2], 0);//need a temporary array to sort out ROI zeros from -fix-zeros zeros
-#pragma omp CARET_PARFOR
-        for (int k = 0; k < myDims[2]; ++k)//smooth along i axis
-        {
-            for (int j = 0; j < myDims[1]; ++j)
-            {
-                for (int i = 0; i < myDims[0]; ++i)//don't test whether intermediate voxel is insode ROI, or we lose some data
-                {
-                    int imin = i - irange, imax = i + irange + 1;//one-after array size convention
-                    if (imin < 0) imin = 0;
-                    if (imax > myDims[0]) imax = myDims[0];
-                    float sum = 0.0f, weightsum = 0.0f;
-                    int64_t baseInd = inVol->getIndex(0, j, k, 0);
-                    int64_t curInd = baseInd + i;
-                    bool used = false;
-                    for (int ikern = imin; ikern < imax; ++ikern)
-                    {
-                        int64_t thisIndex = baseInd + ikern;
-                        if (roiFrame[thisIndex] > 0.0f)//only test source and final voxels for being in ROI
-                        {
-                            if (!used)//keep a list of voxels whose i-kernel intersects the ROI
-                            {
-                                used = true;
-                                markROI[curInd] = 1;
-#pragma omp critical
-                                {
-                                    lists[0].push_back(i);
-                                    lists[0].push_back(j);
-                                    lists[0].push_back(k);
-                                }
-                            }
-                            if (!fixZeros || inFrame[thisIndex] != 0.0f)
-                            {
-                                float weight = iweights[ikern - i + irange];
-                                weightsum += weight;
-                                sum += weight * inFrame[thisIndex];
-                            }
-                        }
-                    }
-                    scratchWeights[curInd] = weightsum;
-                    scratchFrame3[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
-                }
-            }
-        }
-#pragma omp CARET_PARFOR
-        for (int k = 0; k < myDims[2]; ++k)//now j
-        {
-            for (int i = 0; i < myDims[0]; ++i)
-            {
-                for (int j = 0; j < myDims[1]; ++j)//step along the dimension being smoothed last for best cache coherence
-                {
-                    int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-                    if (jmin < 0) jmin = 0;
-                    if (jmax > myDims[1]) jmax = myDims[1];
-                    float sum = 0.0f, weightsum = 0.0f;
-                    int64_t baseInd = inVol->getIndex(i, 0, k);
-                    int64_t curInd = baseInd + j * myDims[0];
-                    bool used = false;
-                    for (int jkern = jmin; jkern < jmax; ++jkern)
-                    {
-                        int64_t thisIndex = baseInd + jkern * myDims[0];//DO NOT test for this source voxel being outside ROI, or you will skip good data
-                        if ((markROI[thisIndex] & 1) == 1)
-                        {//skip voxels whose i-kernels don't touch the ROI, they will always have 0/0
-                            if (!used)
-                            {
-                                used = true;
-                                markROI[curInd] |= 2;//bitwise so i can track all 3 lists separately in one array
-#pragma omp critical
-                                {
-                                    lists[1].push_back(i);
-                                    lists[1].push_back(j);
-                                    lists[1].push_back(k);
-                                }
-                            }
-                            float weight = jweights[jkern - j + jrange];
-                            weightsum += weight * scratchWeights[thisIndex];
-                            sum += weight * scratchFrame3[thisIndex];
-                        }
-                    }
-                    scratchWeights2[curInd] = weightsum;
-                    scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
-                }
-            }
-        }
-#pragma omp CARET_PARFOR
-        for (int j = 0; j < myDims[1]; ++j)//and finally k
-        {
-            for (int i = 0; i < myDims[0]; ++i)
-            {
-                for (int k = 0; k < myDims[2]; ++k)//ditto
-                {
-                    int64_t baseInd = inVol->getIndex(i, j, 0);
-                    int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-                    if (roiFrame[curInd] > 0.0f)
-                    {
-#pragma omp critical
-                        {
-                            lists[2].push_back(i);//third list is a little different, since we don't output stuff outside the ROI, we can drop the voxels that "grew" from the ROI
-                            lists[2].push_back(j);//we do need to calculate those grown voxels, though, since we use some of them within the k-kernel
-                            lists[2].push_back(k);
-                        }
-                        int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-                        if (kmin < 0) kmin = 0;
-                        if (kmax > myDims[2]) kmax = myDims[2];
-                        float sum = 0.0f, weightsum = 0.0f;
-                        for (int kkern = kmin; kkern < kmax; ++kkern)
-                        {
-                            int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];//ditto
-                            float weight = kweights[kkern - k + krange];
-                            weightsum += weight * scratchWeights2[thisIndex];
-                            sum += weight * scratchFrame2[thisIndex];
-                        }
-                        if (weightsum != 0.0f)
-                        {
-                            scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-                        } else {
-                            scratchFrame[curInd] = 0.0f;
-                        }
-                    } else {
-                        scratchFrame[curInd] = 0.0f;
-                    }
-                }
-            }
-        }
-        if (lists[0].size() == 0)
-        {
-            lists[0].push_back(-1);//to keep it from scanning the ROI again when the ROI has no voxels, slightly hacky
-        }
-    } else {//lists already made, use them
-        const float* roiFrame = roiVol->getFrame();
-        int64_t ibasesize = (int64_t)lists[0].size();
-        if (ibasesize < 3) return;//handle the case of empty ROI here (ibasesize will be 1)
-        int64_t jbasesize = (int64_t)lists[1].size();
-        int64_t kbasesize = (int64_t)lists[2].size();
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int ibase = 0; ibase < ibasesize; ibase += 3)
-        {
-            int i = lists[0][ibase];
-            int j = lists[0][ibase + 1];
-            int k = lists[0][ibase + 2];
-            int imin = i - irange, imax = i + irange + 1;//one-after array size convention
-            if (imin < 0) imin = 0;
-            if (imax > myDims[0]) imax = myDims[0];
-            float sum = 0.0f, weightsum = 0.0f;
-            int64_t baseInd = inVol->getIndex(0, j, k, 0);
-            int64_t curInd = baseInd + i;
-            for (int ikern = imin; ikern < imax; ++ikern)
-            {
-                int64_t thisIndex = baseInd + ikern;
-                if (roiFrame[thisIndex] > 0.0f && (!fixZeros || inFrame[thisIndex] != 0.0f))
-                {
-                    float weight = iweights[ikern - i + irange];
-                    weightsum += weight;
-                    sum += weight * inFrame[thisIndex];
-                }
-            }
-            scratchWeights[curInd] = weightsum;
-            scratchFrame3[curInd] = sum;//don't divide yet, we will divide later after we gather the weighted sums of the weighted sums of the weight sums (yes, that repetition is right)
-        }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int jbase = 0; jbase < jbasesize; jbase += 3)
-        {
-            int i = lists[1][jbase];
-            int j = lists[1][jbase + 1];
-            int k = lists[1][jbase + 2];
-            int jmin = j - jrange, jmax = j + jrange + 1;//one-after array size convention
-            if (jmin < 0) jmin = 0;
-            if (jmax > myDims[1]) jmax = myDims[1];
-            float sum = 0.0f, weightsum = 0.0f;
-            int64_t baseInd = inVol->getIndex(i, 0, k);
-            int64_t curInd = baseInd + j * myDims[0];
-            for (int jkern = jmin; jkern < jmax; ++jkern)
-            {
-                int64_t thisIndex = baseInd + jkern * myDims[0];//DO NOT test for this source voxel having zero data, or it will skip good data
-                float weight = jweights[jkern - j + jrange];
-                weightsum += weight * scratchWeights[thisIndex];
-                sum += weight * scratchFrame3[thisIndex];
-            }
-            scratchWeights2[curInd] = weightsum;
-            scratchFrame2[curInd] = sum;//we now have the weighted sum of the weight sums
-        }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int kbase = 0; kbase < kbasesize; kbase += 3)
-        {
-            int i = lists[2][kbase];
-            int j = lists[2][kbase + 1];
-            int k = lists[2][kbase + 2];
-            int64_t baseInd = inVol->getIndex(i, j, 0);
-            int64_t curInd = baseInd + k * myDims[0] * myDims[1];
-            int kmin = k - krange, kmax = k + krange + 1;//one-after array size convention
-            if (kmin < 0) kmin = 0;
-            if (kmax > myDims[2]) kmax = myDims[2];
-            float sum = 0.0f, weightsum = 0.0f;
-            for (int kkern = kmin; kkern < kmax; ++kkern)
-            {
-                int64_t thisIndex = baseInd + kkern * myDims[0] * myDims[1];//ditto
-                float weight = kweights[kkern - k + krange];
-                weightsum += weight * scratchWeights2[thisIndex];
-                sum += weight * scratchFrame2[thisIndex];
-            }
-            if (weightsum != 0.0f)
-            {
-                scratchFrame[curInd] = sum / weightsum;//NOW we can divide
-            } else {
-                scratchFrame[curInd] = 0.0f;
-            }
-        }//the frame should be zeroed outside the ROI already due to the first time through
-    }
-}
-
 void AlgorithmVolumeSmoothing::smoothFrameNonOrth(const float* inFrame, const vector<int64_t>& myDims, CaretArray<float>& scratchFrame, const VolumeFile* inVol, const VolumeFile* roiVol, const CaretArray<float**>& weights, const int& irange, const int& jrange, const int& krange, const bool& fixZeros)
 {
     const float* roiFrame = NULL;
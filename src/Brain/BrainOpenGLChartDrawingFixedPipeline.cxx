@@ -42,7 +42,6 @@
 #include "ChartModelTimeSeries.h"
 #include "ChartableMatrixInterface.h"
 #include "CaretPreferences.h"
-#include "ChartPoint.h"
 #include "CiftiMappableConnectivityMatrixDataFile.h"
 #include "CiftiParcelLabelFile.h"
 #include "CiftiParcelScalarFile.h"
@@ -854,6 +853,8 @@ BrainOpenGLChartDrawingFixedPipeline::drawChartGraphicsLineSeries(BrainOpenGLTex
             CaretColorEnum::Enum color = chartDataCart->getColor();
             drawChartDataCartesian(chartDataIndex,
                                    chartDataCart,
+                                   xMin,
+                                   xMax,
                                    lineWidth,
                                    CaretColorEnum::toRGB(color));
         }
@@ -866,6 +867,8 @@ BrainOpenGLChartDrawingFixedPipeline::drawChartGraphicsLineSeries(BrainOpenGLTex
             CaretAssert(chartDataCart);
             drawChartDataCartesian(-1,
                                    chartDataCart,
+                                   xMin,
+                                   xMax,
                                    lineWidth,
                                    m_fixedPipelineDrawing->m_foregroundColorFloat);
         }
@@ -877,10 +880,19 @@ BrainOpenGLChartDrawingFixedPipeline::drawChartGraphicsLineSeries(BrainOpenGLTex
 /**
  * Draw the cartesian data with the given color.
  *
+ * Points are drawn with a vertex array.  When the data contains many
+ * more points than there are pixels across the chart, the points are
+ * decimated to the minimum and maximum in each pixel so that the
+ * drawing cost is proportional to the width of the chart.
+ *
  * @param chartDataIndex
  *   Index of chart data
  * @param chartDataCartesian
  *   Cartesian data that is drawn.
+ * @param xMinimum
+ *   Minimum X visible in the chart.
+ * @param xMaximum
+ *   Maximum X visible in the chart.
  * @param lineWidth
  *   Width of lines.
  * @param color
@@ -889,6 +901,8 @@ BrainOpenGLChartDrawingFixedPipeline::drawChartGraphicsLineSeries(BrainOpenGLTex
 void
 BrainOpenGLChartDrawingFixedPipeline::drawChartDataCartesian(const int32_t chartDataIndex,
                                                              const ChartDataCartesian* chartDataCartesian,
+                                                             const float xMinimum,
+                                                             const float xMaximum,
                                                              const float lineWidth,
                                                              const float rgb[3])
 {
@@ -896,24 +910,52 @@ BrainOpenGLChartDrawingFixedPipeline::drawChartDataCartesian(const int32_t chart
         return;
     }
     
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT,
+                  viewport);
+    
+    chartDataCartesian->getPointsForDrawing(xMinimum,
+                                            xMaximum,
+                                            viewport[2],
+                                            m_lineStripXY,
+                                            m_lineStripPointIndices);
+    const int32_t numPoints = static_cast<int32_t>(m_lineStripPointIndices.size());
+    if (numPoints <= 0) {
+        return;
+    }
+    
     glColor3fv(rgb);
     
     glLineWidth(lineWidth);
+    
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2,
+                    GL_FLOAT,
+                    0,
+                    reinterpret_cast<const GLvoid*>(&m_lineStripXY[0]));
+    
     if (m_identificationModeFlag) {
         glLineWidth(5.0);
-    }
-    glBegin(GL_LINE_STRIP);
-    const int32_t numPoints = chartDataCartesian->getNumberOfPoints();
-    for (int32_t i = 0; i < numPoints; i++) {
-        const ChartPoint* point = chartDataCartesian->getPointAtIndex(i);
-        if (m_identificationModeFlag) {
-            uint8_t rgbaForID[4];
-            addToChartLineIdentification(chartDataIndex, i, rgbaForID);
-            glColor4ubv(rgbaForID);
+        
+        m_lineStripIdentificationRGBA.resize(numPoints * 4);
+        for (int32_t i = 0; i < numPoints; i++) {
+            addToChartLineIdentification(chartDataIndex,
+                                         m_lineStripPointIndices[i],
+                                         &m_lineStripIdentificationRGBA[i * 4]);
         }
-        glVertex2fv(point->getXY());
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4,
+                       GL_UNSIGNED_BYTE,
+                       0,
+                       reinterpret_cast<const GLvoid*>(&m_lineStripIdentificationRGBA[0]));
     }
-    glEnd();
+    
+    glDrawArrays(GL_LINE_STRIP,
+                 0,
+                 numPoints);
+    
+    glPopClientAttrib();
 }
 
 /**
@@ -1544,10 +1586,9 @@ BrainOpenGLChartDrawingFixedPipeline::processIdentification()
                                             chartDataCartesian,
                                             chartLineIndex);
                 
-                const ChartPoint* chartPoint = chartDataCartesian->getPointAtIndex(chartLineIndex);
                 const float lineXYZ[3] = {
-                    chartPoint->getX(),
-                    chartPoint->getY(),
+                    chartDataCartesian->getPointX(chartLineIndex),
+                    chartDataCartesian->getPointY(chartLineIndex),
                     0.0
                 };
                 
@@ -1576,10 +1617,9 @@ BrainOpenGLChartDrawingFixedPipeline::processIdentification()
                                                  chartDataCartesian,
                                                  chartLineIndex);
                 
-                const ChartPoint* chartPoint = chartDataCartesian->getPointAtIndex(chartLineIndex);
                 const float lineXYZ[3] = {
-                    chartPoint->getX(),
-                    chartPoint->getY(),
+                    chartDataCartesian->getPointX(chartLineIndex),
+                    chartDataCartesian->getPointY(chartLineIndex),
                     0.0
                 };
                 
@@ -1608,10 +1648,9 @@ BrainOpenGLChartDrawingFixedPipeline::processIdentification()
                                             chartDataCartesian,
                                             chartLineIndex);
                 
-                const ChartPoint* chartPoint = chartDataCartesian->getPointAtIndex(chartLineIndex);
                 const float lineXYZ[3] = {
-                    chartPoint->getX(),
-                    chartPoint->getY(),
+                    chartDataCartesian->getPointX(chartLineIndex),
+                    chartDataCartesian->getPointY(chartLineIndex),
                     0.0
                 };
                 
@@ -115,6 +115,8 @@ namespace caret {
         
         void drawChartDataCartesian(const int32_t chartDataIndex,
                                     const ChartDataCartesian* chartDataCartesian,
+                                    const float xMinimum,
+                                    const float xMaximum,
                                     const float lineWidth,
                                     const float rgb[3]);
         
@@ -165,6 +167,15 @@ namespace caret {
 
         std::vector<int32_t> m_identificationIndices;
         
+        /** XY of line strip points, reused to avoid allocation each frame */
+        std::vector<float> m_lineStripXY;
+        
+        /** Index of the chart point for each line strip point */
+        std::vector<int32_t> m_lineStripPointIndices;
+        
+        /** Identification colors for line strip points */
+        std::vector<uint8_t> m_lineStripIdentificationRGBA;
+        
         bool m_identificationModeFlag;
         
         // ADD_NEW_MEMBERS_HERE
@@ -0,0 +1,489 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#define __BRAIN_OPEN_G_L_FEATURE_DRAW_CACHE_DECLARE__
+#include "BrainOpenGLFeatureDrawCache.h"
+#undef __BRAIN_OPEN_G_L_FEATURE_DRAW_CACHE_DECLARE__
+
+#include "Border.h"
+#include "BorderFile.h"
+#include "CaretAssert.h"
+#include "CaretProfiler.h"
+#include "FociFile.h"
+#include "Focus.h"
+#include "GiftiLabel.h"
+#include "GiftiLabelTable.h"
+#include "GroupAndNameHierarchyModel.h"
+#include "SurfaceFile.h"
+#include "SurfaceProjectedItem.h"
+
+using namespace caret;
+
+
+namespace {
+    /**
+     * Get the color of a focus or border, assigning the color from the
+     * class or name color table if the feature does not yet have one.
+     */
+    template <class T>
+    void getFeatureColor(T* feature,
+                         const FeatureColoringTypeEnum::Enum coloringType,
+                         const GiftiLabelTable* classColorTable,
+                         const GiftiLabelTable* nameColorTable,
+                         const float standardColorRGBA[4],
+                         float rgbaOut[4])
+    {
+        rgbaOut[0] = 0.0;
+        rgbaOut[1] = 0.0;
+        rgbaOut[2] = 0.0;
+        rgbaOut[3] = 1.0;
+        switch (coloringType) {
+            case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_CLASS:
+                if (feature->isClassRgbaValid() == false) {
+                    const GiftiLabel* colorLabel = classColorTable->getLabelBestMatching(feature->getClassName());
+                    if (colorLabel != NULL) {
+                        colorLabel->getColor(rgbaOut);
+                    }
+                    feature->setClassRgba(rgbaOut);
+                }
+                feature->getClassRgba(rgbaOut);
+                break;
+            case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_STANDARD_COLOR:
+                rgbaOut[0] = standardColorRGBA[0];
+                rgbaOut[1] = standardColorRGBA[1];
+                rgbaOut[2] = standardColorRGBA[2];
+                rgbaOut[3] = standardColorRGBA[3];
+                break;
+            case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_NAME:
+                if (feature->isNameRgbaValid() == false) {
+                    const GiftiLabel* colorLabel = nameColorTable->getLabelBestMatching(feature->getName());
+                    if (colorLabel != NULL) {
+                        colorLabel->getColor(rgbaOut);
+                    }
+                    feature->setNameRgba(rgbaOut);
+                }
+                feature->getNameRgba(rgbaOut);
+                break;
+        }
+    }
+}
+
+/**
+ * \class caret::BrainOpenGLFeatureDrawCache
+ * \brief Caches the selected foci and borders with their colors and positions.
+ * \ingroup Brain
+ *
+ * Testing selection and resolving colors (which may require matching
+ * names in a color table) for each focus and border in every frame is
+ * slow for files containing many thousands of foci.  A draw list is
+ * built for each file and browser tab (and surface for foci) and it is
+ * rebuilt only when the selections, the coloring, the file, or the
+ * surface's coordinates change.  Clipping is not cached since it changes
+ * while the user interacts.
+ *
+ * Building a draw list does not use OpenGL.
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLFeatureDrawCache::DrawSettings::DrawSettings()
+{
+    m_displayGroup = DisplayGroupEnum::DISPLAY_GROUP_TAB;
+    m_tabIndex = -1;
+    m_coloringType = FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_CLASS;
+    m_standardColor = CaretColorEnum::BLACK;
+    m_pasteOntoSurface = false;
+    m_contralateralEnabled = false;
+}
+
+/**
+ * @return True if the settings are the same.
+ */
+bool
+BrainOpenGLFeatureDrawCache::DrawSettings::operator==(const DrawSettings& rhs) const
+{
+    return ((m_displayGroup == rhs.m_displayGroup)
+            && (m_tabIndex == rhs.m_tabIndex)
+            && (m_coloringType == rhs.m_coloringType)
+            && (m_standardColor == rhs.m_standardColor)
+            && (m_pasteOntoSurface == rhs.m_pasteOntoSurface)
+            && (m_contralateralEnabled == rhs.m_contralateralEnabled));
+}
+
+/**
+ * Constructor.
+ */
+BrainOpenGLFeatureDrawCache::BrainOpenGLFeatureDrawCache()
+: CaretObject()
+{
+    m_frameNumber = 0;
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLFeatureDrawCache::~BrainOpenGLFeatureDrawCache()
+{
+    for (std::map<FociKey, CachedFociDrawList*>::iterator iter = m_fociDrawLists.begin();
+         iter != m_fociDrawLists.end();
+         iter++) {
+        delete iter->second;
+    }
+    m_fociDrawLists.clear();
+
+    for (std::map<BorderKey, CachedBorderDrawList*>::iterator iter = m_borderDrawLists.begin();
+         iter != m_borderDrawLists.end();
+         iter++) {
+        delete iter->second;
+    }
+    m_borderDrawLists.clear();
+}
+
+/**
+ * @return True if a draw list with the cached validity may be used.
+ * Draw lists of modified files are never used since the content of a
+ * modified file may change without a new stamp.
+ *
+ * @param cached
+ *    Validity when the draw list was built.
+ * @param current
+ *    Current validity.
+ */
+bool
+BrainOpenGLFeatureDrawCache::isCacheValid(const CacheValidity& cached,
+                                          const CacheValidity& current)
+{
+    return ((current.m_fileStamp != 0)
+            && (cached.m_fileStamp == current.m_fileStamp)
+            && (cached.m_coordinateStamp == current.m_coordinateStamp)
+            && (cached.m_selectionCounter == current.m_selectionCounter)
+            && (cached.m_drawSettings == current.m_drawSettings));
+}
+
+/**
+ * Get the draw list for the foci file, rebuilding it if needed.
+ *
+ * @param fociFile
+ *    The foci file.
+ * @param surface
+ *    Surface on which the foci are drawn.
+ * @param drawSettings
+ *    Settings for the browser tab.
+ * @return
+ *    Draw list that remains valid until the next call to a method of
+ *    this cache.
+ */
+const BrainOpenGLFeatureDrawCache::FociDrawList*
+BrainOpenGLFeatureDrawCache::getFociDrawList(FociFile* fociFile,
+                                             const SurfaceFile* surface,
+                                             const DrawSettings& drawSettings)
+{
+    CaretAssert(fociFile);
+    CaretAssert(surface);
+
+    /*
+     * Updating the hierarchy may replace selection items
+     * so it must be done before the selection counter is read.
+     */
+    fociFile->getGroupAndNameHierarchyModel();
+
+    CacheValidity validity;
+    validity.m_drawSettings = drawSettings;
+    validity.m_fileStamp = (fociFile->isModified()
+                            ? 0
+                            : fociFile->getUnmodifiedContentStamp());
+    validity.m_coordinateStamp = surface->getCoordinateModificationStamp();
+    validity.m_selectionCounter = GroupAndNameHierarchyItem::getSelectionChangeCounter();
+
+    const FociKey key(fociFile,
+                      std::make_pair(surface,
+                                     drawSettings.m_tabIndex));
+    CachedFociDrawList* cached = NULL;
+    std::map<FociKey, CachedFociDrawList*>::iterator iter = m_fociDrawLists.find(key);
+    if (iter != m_fociDrawLists.end()) {
+        cached = iter->second;
+    }
+    else {
+        cached = new CachedFociDrawList();
+        cached->m_validity.m_fileStamp = 0;
+        m_fociDrawLists.insert(std::make_pair(key,
+                                              cached));
+    }
+
+    if ( ! isCacheValid(cached->m_validity,
+                        validity)) {
+        buildFociDrawList(fociFile,
+                          surface,
+                          drawSettings,
+                          cached->m_drawList);
+        cached->m_validity = validity;
+    }
+    cached->m_lastFrameUsed = m_frameNumber;
+
+    return &cached->m_drawList;
+}
+
+/**
+ * Get the draw list for the border file, rebuilding it if needed.
+ *
+ * @param borderFile
+ *    The border file.
+ * @param drawSettings
+ *    Settings for the browser tab.
+ * @return
+ *    Draw list that remains valid until the next call to a method of
+ *    this cache.
+ */
+const BrainOpenGLFeatureDrawCache::BorderDrawList*
+BrainOpenGLFeatureDrawCache::getBorderDrawList(BorderFile* borderFile,
+                                               const DrawSettings& drawSettings)
+{
+    CaretAssert(borderFile);
+
+    borderFile->getGroupAndNameHierarchyModel();
+
+    CacheValidity validity;
+    validity.m_drawSettings = drawSettings;
+    validity.m_fileStamp = (borderFile->isModified()
+                            ? 0
+                            : borderFile->getUnmodifiedContentStamp());
+    validity.m_coordinateStamp = 0;
+    validity.m_selectionCounter = GroupAndNameHierarchyItem::getSelectionChangeCounter();
+
+    const BorderKey key(borderFile,
+                        drawSettings.m_tabIndex);
+    CachedBorderDrawList* cached = NULL;
+    std::map<BorderKey, CachedBorderDrawList*>::iterator iter = m_borderDrawLists.find(key);
+    if (iter != m_borderDrawLists.end()) {
+        cached = iter->second;
+    }
+    else {
+        cached = new CachedBorderDrawList();
+        cached->m_validity.m_fileStamp = 0;
+        m_borderDrawLists.insert(std::make_pair(key,
+                                                cached));
+    }
+
+    if ( ! isCacheValid(cached->m_validity,
+                        validity)) {
+        buildBorderDrawList(borderFile,
+                            drawSettings,
+                            cached->m_drawList);
+        cached->m_validity = validity;
+    }
+    cached->m_lastFrameUsed = m_frameNumber;
+
+    return &cached->m_drawList;
+}
+
+/**
+ * Release draw lists that have not been used recently such as
+ * those for closed files and tabs.  Call once each frame.
+ */
+void
+BrainOpenGLFeatureDrawCache::releaseUnusedDrawLists()
+{
+    m_frameNumber++;
+
+    std::map<FociKey, CachedFociDrawList*>::iterator fociIter = m_fociDrawLists.begin();
+    while (fociIter != m_fociDrawLists.end()) {
+        if ((m_frameNumber - fociIter->second->m_lastFrameUsed) > s_framesUntilRelease) {
+            delete fociIter->second;
+            m_fociDrawLists.erase(fociIter++);
+        }
+        else {
+            fociIter++;
+        }
+    }
+
+    std::map<BorderKey, CachedBorderDrawList*>::iterator borderIter = m_borderDrawLists.begin();
+    while (borderIter != m_borderDrawLists.end()) {
+        if ((m_frameNumber - borderIter->second->m_lastFrameUsed) > s_framesUntilRelease) {
+            delete borderIter->second;
+            m_borderDrawLists.erase(borderIter++);
+        }
+        else {
+            borderIter++;
+        }
+    }
+}
+
+/**
+ * Build the draw list containing the selected foci projections that
+ * have a valid position on the surface and a structure compatible
+ * with the surface.
+ *
+ * @param fociFile
+ *    The foci file.
+ * @param surface
+ *    Surface on which the foci are drawn.
+ * @param drawSettings
+ *    Settings for the browser tab.
+ * @param drawListOut
+ *    Output containing the draw list.
+ */
+void
+BrainOpenGLFeatureDrawCache::buildFociDrawList(FociFile* fociFile,
+                                               const SurfaceFile* surface,
+                                               const DrawSettings& drawSettings,
+                                               FociDrawList& drawListOut)
+{
+    CaretAssert(fociFile);
+    CaretAssert(surface);
+    CaretProfileSpan mySpan("BrainOpenGLFeatureDrawCache::buildFociDrawList", "draw");
+
+    drawListOut.m_xyz.clear();
+    drawListOut.m_rgba.clear();
+    drawListOut.m_focusIndices.clear();
+    drawListOut.m_projectionIndices.clear();
+
+    const DisplayGroupEnum::Enum displayGroup = drawSettings.m_displayGroup;
+    const int32_t tabIndex = drawSettings.m_tabIndex;
+
+    const GroupAndNameHierarchyModel* classAndNameSelection = fociFile->getGroupAndNameHierarchyModel();
+    if (classAndNameSelection->isSelected(displayGroup,
+                                          tabIndex) == false) {
+        return;
+    }
+
+    const StructureEnum::Enum surfaceStructure = surface->getStructure();
+    const StructureEnum::Enum surfaceContralateralStructure = StructureEnum::getContralateralStructure(surfaceStructure);
+
+    float standardColorRGBA[4];
+    CaretColorEnum::toRGBFloat(drawSettings.m_standardColor,
+                               standardColorRGBA);
+
+    const GiftiLabelTable* classColorTable = fociFile->getClassColorTable();
+    const GiftiLabelTable* nameColorTable = fociFile->getNameColorTable();
+
+    const int32_t numFoci = fociFile->getNumberOfFoci();
+    for (int32_t j = 0; j < numFoci; j++) {
+        Focus* focus = fociFile->getFocus(j);
+
+        const GroupAndNameHierarchyItem* nameItem = focus->getGroupNameSelectionItem();
+        if (nameItem != NULL) {
+            if (nameItem->isSelected(displayGroup,
+                                     tabIndex) == false) {
+                continue;
+            }
+        }
+
+        float rgba[4];
+        getFeatureColor(focus,
+                        drawSettings.m_coloringType,
+                        classColorTable,
+                        nameColorTable,
+                        standardColorRGBA,
+                        rgba);
+
+        const int32_t numProjections = focus->getNumberOfProjections();
+        for (int32_t k = 0; k < numProjections; k++) {
+            const SurfaceProjectedItem* spi = focus->getProjection(k);
+            float xyz[3];
+            if (spi->getProjectedPosition(*surface,
+                                          xyz,
+                                          drawSettings.m_pasteOntoSurface) == false) {
+                continue;
+            }
+
+            const StructureEnum::Enum focusStructure = spi->getStructure();
+            bool drawIt = false;
+            if (focusStructure == surfaceStructure) {
+                drawIt = true;
+            }
+            else if (focusStructure == StructureEnum::INVALID) {
+                drawIt = true;
+            }
+            else if (drawSettings.m_contralateralEnabled) {
+                if (focusStructure == surfaceContralateralStructure) {
+                    drawIt = true;
+                }
+            }
+
+            if (drawIt) {
+                drawListOut.m_xyz.insert(drawListOut.m_xyz.end(), xyz, xyz + 3);
+                drawListOut.m_rgba.insert(drawListOut.m_rgba.end(), rgba, rgba + 4);
+                drawListOut.m_focusIndices.push_back(j);
+                drawListOut.m_projectionIndices.push_back(k);
+            }
+        }
+    }
+}
+
+/**
+ * Build the draw list containing the selected borders.
+ *
+ * @param borderFile
+ *    The border file.
+ * @param drawSettings
+ *    Settings for the browser tab.
+ * @param drawListOut
+ *    Output containing the draw list.
+ */
+void
+BrainOpenGLFeatureDrawCache::buildBorderDrawList(BorderFile* borderFile,
+                                                 const DrawSettings& drawSettings,
+                                                 BorderDrawList& drawListOut)
+{
+    CaretAssert(borderFile);
+    CaretProfileSpan mySpan("BrainOpenGLFeatureDrawCache::buildBorderDrawList", "draw");
+
+    drawListOut.m_borderIndices.clear();
+    drawListOut.m_rgba.clear();
+
+    const DisplayGroupEnum::Enum displayGroup = drawSettings.m_displayGroup;
+    const int32_t tabIndex = drawSettings.m_tabIndex;
+
+    const GroupAndNameHierarchyModel* classAndNameSelection = borderFile->getGroupAndNameHierarchyModel();
+    if (classAndNameSelection->isSelected(displayGroup,
+                                          tabIndex) == false) {
+        return;
+    }
+
+    float standardColorRGBA[4];
+    CaretColorEnum::toRGBFloat(drawSettings.m_standardColor,
+                               standardColorRGBA);
+
+    const GiftiLabelTable* classColorTable = borderFile->getClassColorTable();
+    const GiftiLabelTable* nameColorTable = borderFile->getNameColorTable();
+
+    const int32_t numBorders = borderFile->getNumberOfBorders();
+    for (int32_t j = 0; j < numBorders; j++) {
+        Border* border = borderFile->getBorder(j);
+        if (borderFile->isBorderDisplayed(displayGroup,
+                                          tabIndex,
+                                          border) == false) {
+            continue;
+        }
+
+        float rgba[4];
+        getFeatureColor(border,
+                        drawSettings.m_coloringType,
+                        classColorTable,
+                        nameColorTable,
+                        standardColorRGBA,
+                        rgba);
+
+        drawListOut.m_borderIndices.push_back(j);
+        drawListOut.m_rgba.insert(drawListOut.m_rgba.end(), rgba, rgba + 4);
+    }
+}
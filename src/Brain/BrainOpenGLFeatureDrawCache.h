@@ -0,0 +1,168 @@
+#ifndef __BRAIN_OPEN_G_L_FEATURE_DRAW_CACHE_H__
+#define __BRAIN_OPEN_G_L_FEATURE_DRAW_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "CaretColorEnum.h"
+#include "CaretObject.h"
+#include "DisplayGroupEnum.h"
+#include "FeatureColoringTypeEnum.h"
+
+
+namespace caret {
+
+    class BorderFile;
+    class FociFile;
+    class SurfaceFile;
+
+    class BrainOpenGLFeatureDrawCache : public CaretObject {
+
+    public:
+        /** Display settings that determine the content of a draw list */
+        struct DrawSettings {
+            DrawSettings();
+
+            bool operator==(const DrawSettings& rhs) const;
+
+            DisplayGroupEnum::Enum m_displayGroup;
+
+            int32_t m_tabIndex;
+
+            FeatureColoringTypeEnum::Enum m_coloringType;
+
+            CaretColorEnum::Enum m_standardColor;
+
+            /** Foci only */
+            bool m_pasteOntoSurface;
+
+            /** Foci only, borders test structures for each point when drawn */
+            bool m_contralateralEnabled;
+        };
+
+        /** Selected focus projections of a foci file positioned on a surface */
+        struct FociDrawList {
+            /** Three per projection */
+            std::vector<float> m_xyz;
+
+            /** Four per projection */
+            std::vector<float> m_rgba;
+
+            std::vector<int32_t> m_focusIndices;
+
+            std::vector<int32_t> m_projectionIndices;
+        };
+
+        /** Selected borders of a border file */
+        struct BorderDrawList {
+            std::vector<int32_t> m_borderIndices;
+
+            /** Four per border */
+            std::vector<float> m_rgba;
+        };
+
+        BrainOpenGLFeatureDrawCache();
+
+        virtual ~BrainOpenGLFeatureDrawCache();
+
+        const FociDrawList* getFociDrawList(FociFile* fociFile,
+                                            const SurfaceFile* surface,
+                                            const DrawSettings& drawSettings);
+
+        const BorderDrawList* getBorderDrawList(BorderFile* borderFile,
+                                                const DrawSettings& drawSettings);
+
+        void releaseUnusedDrawLists();
+
+        static void buildFociDrawList(FociFile* fociFile,
+                                      const SurfaceFile* surface,
+                                      const DrawSettings& drawSettings,
+                                      FociDrawList& drawListOut);
+
+        static void buildBorderDrawList(BorderFile* borderFile,
+                                        const DrawSettings& drawSettings,
+                                        BorderDrawList& drawListOut);
+
+        // ADD_NEW_METHODS_HERE
+
+    private:
+        /** Everything that invalidates a cached draw list */
+        struct CacheValidity {
+            DrawSettings m_drawSettings;
+
+            int64_t m_fileStamp;
+
+            int64_t m_coordinateStamp;
+
+            int64_t m_selectionCounter;
+        };
+
+        struct CachedFociDrawList {
+            CacheValidity m_validity;
+
+            FociDrawList m_drawList;
+
+            int64_t m_lastFrameUsed;
+        };
+
+        struct CachedBorderDrawList {
+            CacheValidity m_validity;
+
+            BorderDrawList m_drawList;
+
+            int64_t m_lastFrameUsed;
+        };
+
+        /** File, surface, and tab */
+        typedef std::pair<const FociFile*, std::pair<const SurfaceFile*, int32_t> > FociKey;
+
+        /** File and tab */
+        typedef std::pair<const BorderFile*, int32_t> BorderKey;
+
+        BrainOpenGLFeatureDrawCache(const BrainOpenGLFeatureDrawCache&);
+
+        BrainOpenGLFeatureDrawCache& operator=(const BrainOpenGLFeatureDrawCache&);
+
+        static bool isCacheValid(const CacheValidity& cached,
+                                 const CacheValidity& current);
+
+        std::map<FociKey, CachedFociDrawList*> m_fociDrawLists;
+
+        std::map<BorderKey, CachedBorderDrawList*> m_borderDrawLists;
+
+        /** Incremented each time unused draw lists are released */
+        int64_t m_frameNumber;
+
+        static const int64_t s_framesUntilRelease;
+
+        // ADD_NEW_MEMBERS_HERE
+
+    };
+
+#ifdef __BRAIN_OPEN_G_L_FEATURE_DRAW_CACHE_DECLARE__
+    const int64_t BrainOpenGLFeatureDrawCache::s_framesUntilRelease = 50;
+#endif // __BRAIN_OPEN_G_L_FEATURE_DRAW_CACHE_DECLARE__
+
+} // namespace
+#endif  //__BRAIN_OPEN_G_L_FEATURE_DRAW_CACHE_H__
@@ -43,7 +43,9 @@
 #include "Brain.h"
 #include "BrainOpenGLAnnotationDrawingFixedPipeline.h"
 #include "BrainOpenGLChartDrawingFixedPipeline.h"
+#include "BrainOpenGLFeatureDrawCache.h"
 #include "BrainOpenGLPrimitiveDrawing.h"
+#include "BrainOpenGLSurfaceBufferCache.h"
 #include "BrainOpenGLTextureManager.h"
 #include "BrainOpenGLVolumeObliqueSliceDrawing.h"
 #include "BrainOpenGLVolumeSliceDrawing.h"
@@ -171,6 +173,8 @@ m_windowIndex(windowIndex)
     this->colorIdentification   = new IdentificationWithColor();
     m_annotationDrawing.grabNew(new BrainOpenGLAnnotationDrawingFixedPipeline(this));
     m_textureManager.grabNew(new BrainOpenGLTextureManager(m_windowIndex));
+    m_surfaceBufferCache.grabNew(new BrainOpenGLSurfaceBufferCache());
+    m_featureDrawCache.grabNew(new BrainOpenGLFeatureDrawCache());
                              
     m_shapeSphere = NULL;
     m_shapeCone   = NULL;
@@ -510,6 +514,9 @@ BrainOpenGLFixedPipeline::drawModels(Brain* brain,
     
     this->checkForOpenGLError(NULL, "At beginning of drawModels()");
     
+    m_surfaceBufferCache->releaseUnusedBuffers();
+    m_featureDrawCache->releaseUnusedDrawLists();
+    
     /*
      * Default the background colors to first model
      * NOTE: If there are no models, the surface background color is used
@@ -2280,7 +2287,8 @@ BrainOpenGLFixedPipeline::drawSurfaceNodes(Surface* surface,
 
 
 /**
- * Draw a surface triangles with vertex arrays.
+ * Draw a surface triangles with vertex arrays.  Retained vertex
+ * buffers are used when vertex buffers are the drawing mode.
  * @param surface
  *    Surface that is drawn.
  * @param nodeColoringRGBA
@@ -2290,6 +2298,15 @@ void
 BrainOpenGLFixedPipeline::drawSurfaceTrianglesWithVertexArrays(const Surface* surface,
                                                                const float* nodeColoringRGBA)
 {
+    if (nodeColoringRGBA == NULL) {
+        glColor3fv(m_backgroundColorFloat);
+    }
+    
+    if (m_surfaceBufferCache->drawSurfaceTriangles(surface,
+                                                   nodeColoringRGBA)) {
+        return;
+    }
+    
     glEnableClientState(GL_VERTEX_ARRAY);
     if (nodeColoringRGBA != NULL) {
         glEnableClientState(GL_COLOR_ARRAY);
@@ -2305,9 +2322,6 @@ BrainOpenGLFixedPipeline::drawSurfaceTrianglesWithVertexArrays(const Surface* su
                        0,
                        reinterpret_cast<const GLvoid*>(nodeColoringRGBA));
     }
-    else {
-        glColor3fv(m_backgroundColorFloat);
-    }
     glNormalPointer(GL_FLOAT,
                     0, 
                     reinterpret_cast<const GLvoid*>(surface->getNormalVector(0)));
@@ -3001,7 +3015,6 @@ BrainOpenGLFixedPipeline::drawSurfaceFoci(Surface* surface)
                                                                                                this->windowTabIndex);
     
     const StructureEnum::Enum surfaceStructure = surface->getStructure();
-    const StructureEnum::Enum surfaceContralateralStructure = StructureEnum::getContralateralStructure(surfaceStructure);
     
     const bool doClipping = isFeatureClippingEnabled();
     
@@ -3017,146 +3030,95 @@ BrainOpenGLFixedPipeline::drawSurfaceFoci(Surface* surface)
     
     const CaretColorEnum::Enum caretColor = fociDisplayProperties->getStandardColorType(displayGroup,
                                                                                            this->windowTabIndex);
-    float caretColorRGBA[4];
-    CaretColorEnum::toRGBFloat(caretColor, caretColorRGBA);
     
     const bool isPasteOntoSurface = fociDisplayProperties->isPasteOntoSurface(displayGroup,
                                                                               this->windowTabIndex);
     
     const bool isContralateralEnabled = fociDisplayProperties->isContralateralDisplayed(displayGroup,
                                                                                         this->windowTabIndex);
+    
+    BrainOpenGLFeatureDrawCache::DrawSettings drawSettings;
+    drawSettings.m_displayGroup = displayGroup;
+    drawSettings.m_tabIndex = this->windowTabIndex;
+    drawSettings.m_coloringType = fociColoringType;
+    drawSettings.m_standardColor = caretColor;
+    drawSettings.m_pasteOntoSurface = isPasteOntoSurface;
+    drawSettings.m_contralateralEnabled = isContralateralEnabled;
+    
+    /*
+     * Squares are collected and drawn together after all files
+     */
+    std::vector<float> squaresXYZ;
+    std::vector<float> squaresRGBA;
+    std::vector<uint8_t> squaresIdRGBA;
+    
     const int32_t numFociFiles = brain->getNumberOfFociFiles();
     for (int32_t i = 0; i < numFociFiles; i++) {
         FociFile* fociFile = brain->getFociFile(i);
         
-        const GroupAndNameHierarchyModel* classAndNameSelection = fociFile->getGroupAndNameHierarchyModel();
-        if (classAndNameSelection->isSelected(displayGroup,
-                                              this->windowTabIndex) == false) {
-            continue;
-        }
-        
-        const GiftiLabelTable* classColorTable = fociFile->getClassColorTable();
-        const GiftiLabelTable* nameColorTable = fociFile->getNameColorTable();
-        
-        const int32_t numFoci = fociFile->getNumberOfFoci();
-        
-        for (int32_t j = 0; j < numFoci; j++) {
-            Focus* focus = fociFile->getFocus(j);
-            float rgba[4] = { 0.0, 0.0, 0.0, 1.0 };
+        const BrainOpenGLFeatureDrawCache::FociDrawList* drawList = m_featureDrawCache->getFociDrawList(fociFile,
+                                                                                                         surface,
+                                                                                                         drawSettings);
+        const int32_t numItems = static_cast<int32_t>(drawList->m_focusIndices.size());
+        for (int32_t n = 0; n < numItems; n++) {
+            const float* xyz  = &drawList->m_xyz[n * 3];
+            const float* rgba = &drawList->m_rgba[n * 4];
             
-            const GroupAndNameHierarchyItem* nameItem = focus->getGroupNameSelectionItem();
-            if (nameItem != NULL) {
-                if (nameItem->isSelected(displayGroup,
-                                         this->windowTabIndex) == false) {
+            if (doClipping) {
+                if ( ! isCoordinateInsideClippingPlanesForStructure(surfaceStructure,
+                                                                    xyz)) {
                     continue;
                 }
             }
             
-            switch (fociColoringType) {
-                case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_CLASS:
-                    if (focus->isClassRgbaValid() == false) {
-                        const GiftiLabel* colorLabel = classColorTable->getLabelBestMatching(focus->getClassName());
-                        if (colorLabel != NULL) {
-                            colorLabel->getColor(rgba);
-                            focus->setClassRgba(rgba);
-                        }
-                        else {
-                            focus->setClassRgba(rgba);
-                        }
-                    }
-                    focus->getClassRgba(rgba);
-                    break;
-                case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_STANDARD_COLOR:
-                    rgba[0] = caretColorRGBA[0];
-                    rgba[1] = caretColorRGBA[1];
-                    rgba[2] = caretColorRGBA[2];
-                    rgba[3] = caretColorRGBA[3];
-                    break;
-                case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_NAME:
-                    if (focus->isNameRgbaValid() == false) {
-                        const GiftiLabel* colorLabel = nameColorTable->getLabelBestMatching(focus->getName());
-                        if (colorLabel != NULL) {
-                            colorLabel->getColor(rgba);
-                            focus->setNameRgba(rgba);
-                        }
-                        else {
-                            focus->setNameRgba(rgba);
-                        }
-                    }
-                    focus->getNameRgba(rgba);
-                    break;
+            uint8_t idRGBA[4];
+            if (isSelect) {
+                this->colorIdentification->addItem(idRGBA,
+                                                   SelectionItemDataTypeEnum::FOCUS_SURFACE,
+                                                   i, // file index
+                                                   drawList->m_focusIndices[n],
+                                                   drawList->m_projectionIndices[n]);
+                idRGBA[3] = 255;
             }
             
-            glColor3fv(rgba);
-            
-            
-            const int32_t numProjections = focus->getNumberOfProjections();
-            for (int32_t k = 0; k < numProjections; k++) {
-                const SurfaceProjectedItem* spi = focus->getProjection(k);
-                float xyz[3];
-                if (spi->getProjectedPosition(*surface,
-                                              xyz,
-                                              isPasteOntoSurface)) {
-                    const StructureEnum::Enum focusStructure = spi->getStructure();
-                    bool drawIt = false;
-                    if (focusStructure == surfaceStructure) {
-                        drawIt = true;
-                    }
-                    else if (focusStructure == StructureEnum::INVALID) {
-                        drawIt = true;
-                    }
-                    else if (isContralateralEnabled) {
-                        if (focusStructure == surfaceContralateralStructure) {
-                            drawIt = true;
-                        }
-                    }
-
-                    if (doClipping) {
-                        if ( ! isCoordinateInsideClippingPlanesForStructure(surfaceStructure,
-                                                                            xyz)) {
-                            drawIt = false;
-                        }
-                    }
-                    
-                    if (drawIt) {
-                        glPushMatrix();
-                        glTranslatef(xyz[0], xyz[1], xyz[2]);
-                        
-                        if (isSelect) {
-                            uint8_t idRGBA[4];
-                            this->colorIdentification->addItem(idRGBA,
-                                                               SelectionItemDataTypeEnum::FOCUS_SURFACE, 
-                                                               i, // file index
-                                                               j, // focus index
-                                                               k);// projection index
-                            idRGBA[3] = 255;
-                            if (drawAsSpheres) {
-                                this->drawSphereWithDiameter(idRGBA,
-                                                             focusDiameter);
-                            }
-                            else {
-                                this->drawSquare(idRGBA,
+            if (drawAsSpheres) {
+                glPushMatrix();
+                glTranslatef(xyz[0], xyz[1], xyz[2]);
+                if (isSelect) {
+                    this->drawSphereWithDiameter(idRGBA,
                                                  focusDiameter);
-                            }
-                        }
-                        else {
-                            if (drawAsSpheres) {
-                                this->drawSphereWithDiameter(rgba,
-                                                             focusDiameter);
-                            }
-                            else {
-                                this->drawSquare(rgba,
+                }
+                else {
+                    this->drawSphereWithDiameter(rgba,
                                                  focusDiameter);
-                            }
-                        }
-                        
-                        glPopMatrix();
-                    }
-                }                
+                }
+                glPopMatrix();
+            }
+            else {
+                squaresXYZ.insert(squaresXYZ.end(), xyz, xyz + 3);
+                if (isSelect) {
+                    squaresIdRGBA.insert(squaresIdRGBA.end(), idRGBA, idRGBA + 4);
+                }
+                else {
+                    squaresRGBA.insert(squaresRGBA.end(), rgba, rgba + 4);
+                }
             }
         }
     }
     
+    if ( ! squaresXYZ.empty()) {
+        if (isSelect) {
+            this->drawSquares(squaresXYZ,
+                              squaresIdRGBA,
+                              focusDiameter);
+        }
+        else {
+            this->drawSquares(squaresXYZ,
+                              squaresRGBA,
+                              focusDiameter);
+        }
+    }
+    
     if (isSelect) {
         int32_t fociFileIndex = -1;
         int32_t focusIndex = -1;
@@ -3243,67 +3205,26 @@ BrainOpenGLFixedPipeline::drawSurfaceBorders(Surface* surface)
                                                                                                       this->windowTabIndex);
     const CaretColorEnum::Enum caretColor = borderDisplayProperties->getStandardColorType(displayGroup,
                                                                                        this->windowTabIndex);
-    float caretColorRGBA[4];
-    CaretColorEnum::toRGBFloat(caretColor, caretColorRGBA);
     const bool isContralateralEnabled = borderDisplayProperties->isContralateralDisplayed(displayGroup,
                                                                                           this->windowTabIndex);
+    
+    BrainOpenGLFeatureDrawCache::DrawSettings drawSettings;
+    drawSettings.m_displayGroup = displayGroup;
+    drawSettings.m_tabIndex = this->windowTabIndex;
+    drawSettings.m_coloringType = borderColoringType;
+    drawSettings.m_standardColor = caretColor;
+    
     const int32_t numBorderFiles = brain->getNumberOfBorderFiles();
     for (int32_t i = 0; i < numBorderFiles; i++) {
         BorderFile* borderFile = brain->getBorderFile(i);
-
-        const GroupAndNameHierarchyModel* classAndNameSelection = borderFile->getGroupAndNameHierarchyModel();
-        if (classAndNameSelection->isSelected(displayGroup,
-                                              this->windowTabIndex) == false) {
-            continue;
-        }
         
-        const GiftiLabelTable* classColorTable = borderFile->getClassColorTable();
-        const GiftiLabelTable* nameColorTable  = borderFile->getNameColorTable();
-        const int32_t numBorders = borderFile->getNumberOfBorders();
-        
-        for (int32_t j = 0; j < numBorders; j++) {
+        const BrainOpenGLFeatureDrawCache::BorderDrawList* drawList = m_featureDrawCache->getBorderDrawList(borderFile,
+                                                                                                             drawSettings);
+        const int32_t numItems = static_cast<int32_t>(drawList->m_borderIndices.size());
+        for (int32_t n = 0; n < numItems; n++) {
+            const int32_t j = drawList->m_borderIndices[n];
             Border* border = borderFile->getBorder(j);
-            if (borderFile->isBorderDisplayed(displayGroup,
-                                              this->windowTabIndex,
-                                              border) == false) {
-                continue;
-            }
-            
-            float rgba[4] = { 0.0, 0.0, 0.0, 1.0 };
-            switch (borderColoringType) {
-                case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_CLASS:
-                    if (border->isClassRgbaValid() == false) {
-                        const GiftiLabel* colorLabel = classColorTable->getLabelBestMatching(border->getClassName());
-                        if (colorLabel != NULL) {
-                            colorLabel->getColor(rgba);
-                            border->setClassRgba(rgba);
-                        }
-                        else {
-                            border->setClassRgba(rgba);
-                        }
-                    }
-                    border->getClassRgba(rgba);
-                    break;
-                case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_STANDARD_COLOR:
-                    rgba[0] = caretColorRGBA[0];
-                    rgba[1] = caretColorRGBA[1];
-                    rgba[2] = caretColorRGBA[2];
-                    rgba[3] = caretColorRGBA[3];
-                    break;
-                case FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_NAME:
-                    if (border->isNameRgbaValid() == false) {
-                        const GiftiLabel* colorLabel = nameColorTable->getLabelBestMatching(border->getName());
-                        if (colorLabel != NULL) {
-                            colorLabel->getColor(rgba);
-                            border->setNameRgba(rgba);
-                        }
-                        else {
-                            border->setNameRgba(rgba);
-                        }
-                    }
-                    border->getNameRgba(rgba);
-                    break;
-            }
+            const float* rgba = &drawList->m_rgba[n * 4];
             glColor3fv(rgba);
             
             BorderDrawInfo borderDrawInfo;
@@ -6170,6 +6091,178 @@ BrainOpenGLFixedPipeline::drawSquare(const uint8_t rgba[4],
     }
 }
 
+/**
+ * Draw squares facing the user at each of the positions with
+ * a single OpenGL call.  Produces the same result as translating
+ * to each position and calling drawSquare().
+ *
+ * @param xyz
+ *     Centers of the squares, three per square.
+ * @param rgba
+ *     RGBA coloring ranging 0.0 to 1.0, four per square.
+ * @param size
+ *     Size of the squares.
+ */
+void
+BrainOpenGLFixedPipeline::drawSquares(const std::vector<float>& xyz,
+                                      const std::vector<float>& rgba,
+                                      const float size)
+{
+    CaretAssert((xyz.size() / 3) == (rgba.size() / 4));
+    
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    if ( ! createSquareVertices(xyz,
+                                size,
+                                vertices,
+                                normals)) {
+        return;
+    }
+    
+    /*
+     * Each square has four vertices on both its front and back
+     */
+    const int64_t numSquares = xyz.size() / 3;
+    std::vector<float> vertexRGBA;
+    vertexRGBA.reserve(numSquares * 8 * 4);
+    for (int64_t i = 0; i < numSquares; i++) {
+        const float* squareRGBA = &rgba[i * 4];
+        for (int32_t j = 0; j < 8; j++) {
+            vertexRGBA.insert(vertexRGBA.end(), squareRGBA, squareRGBA + 4);
+        }
+    }
+    
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &vertices[0]);
+    glNormalPointer(GL_FLOAT, 0, &normals[0]);
+    glColorPointer(4, GL_FLOAT, 0, &vertexRGBA[0]);
+    glDrawArrays(GL_QUADS, 0, numSquares * 8);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+}
+
+/**
+ * Draw squares facing the user at each of the positions with
+ * a single OpenGL call.  Produces the same result as translating
+ * to each position and calling drawSquare().
+ *
+ * @param xyz
+ *     Centers of the squares, three per square.
+ * @param rgba
+ *     RGBA coloring ranging 0 to 255, four per square.
+ * @param size
+ *     Size of the squares.
+ */
+void
+BrainOpenGLFixedPipeline::drawSquares(const std::vector<float>& xyz,
+                                      const std::vector<uint8_t>& rgba,
+                                      const float size)
+{
+    CaretAssert((xyz.size() / 3) == (rgba.size() / 4));
+    
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    if ( ! createSquareVertices(xyz,
+                                size,
+                                vertices,
+                                normals)) {
+        return;
+    }
+    
+    const int64_t numSquares = xyz.size() / 3;
+    std::vector<uint8_t> vertexRGBA;
+    vertexRGBA.reserve(numSquares * 8 * 4);
+    for (int64_t i = 0; i < numSquares; i++) {
+        const uint8_t* squareRGBA = &rgba[i * 4];
+        for (int32_t j = 0; j < 8; j++) {
+            vertexRGBA.insert(vertexRGBA.end(), squareRGBA, squareRGBA + 4);
+        }
+    }
+    
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &vertices[0]);
+    glNormalPointer(GL_FLOAT, 0, &normals[0]);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, &vertexRGBA[0]);
+    glDrawArrays(GL_QUADS, 0, numSquares * 8);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+}
+
+/**
+ * Create the vertices and normal vectors for squares facing the user.
+ * Rather than removing the rotation with the inverse rotation matrix
+ * for each square, the matrix's axes are used to place the corners.
+ *
+ * @param xyz
+ *     Centers of the squares, three per square.
+ * @param size
+ *     Size of the squares.
+ * @param verticesOut
+ *     Output with eight vertices per square (front then back).
+ * @param normalsOut
+ *     Output with a normal vector for each vertex.
+ * @return
+ *     True if there are squares and the inverse rotation matrix is valid.
+ */
+bool
+BrainOpenGLFixedPipeline::createSquareVertices(const std::vector<float>& xyz,
+                                               const float size,
+                                               std::vector<float>& verticesOut,
+                                               std::vector<float>& normalsOut) const
+{
+    verticesOut.clear();
+    normalsOut.clear();
+    
+    const int64_t numSquares = xyz.size() / 3;
+    if ((numSquares <= 0)
+        || ( ! this->inverseRotationMatrixValid)) {
+        return false;
+    }
+    
+    /*
+     * Screen X, Y, and Z axes in model coordinates are the
+     * first three columns of the column-major inverse rotation matrix
+     */
+    const double* m = this->inverseRotationMatrix;
+    const float halfSize = size * 0.5;
+    const float right[3] = { m[0] * halfSize, m[1] * halfSize, m[2] * halfSize };
+    const float up[3]    = { m[4] * halfSize, m[5] * halfSize, m[6] * halfSize };
+    const float normal[3] = { m[8], m[9], m[10] };
+    
+    /*
+     * Corners are in the same order as drawSquare(), the back
+     * side is wound in the opposite direction.
+     */
+    const float cornerSigns[8][2] = {
+        { -1.0, -1.0 }, {  1.0, -1.0 }, {  1.0,  1.0 }, { -1.0,  1.0 },
+        { -1.0, -1.0 }, { -1.0,  1.0 }, {  1.0,  1.0 }, {  1.0, -1.0 }
+    };
+    
+    verticesOut.resize(numSquares * 8 * 3);
+    normalsOut.resize(numSquares * 8 * 3);
+    for (int64_t i = 0; i < numSquares; i++) {
+        const float* center = &xyz[i * 3];
+        for (int32_t j = 0; j < 8; j++) {
+            const int64_t offset = (i * 8 + j) * 3;
+            const float rs = cornerSigns[j][0];
+            const float us = cornerSigns[j][1];
+            const float normalSign = ((j < 4) ? 1.0 : -1.0);
+            for (int32_t k = 0; k < 3; k++) {
+                verticesOut[offset + k] = center[k] + rs * right[k] + us * up[k];
+                normalsOut[offset + k]  = normalSign * normal[k];
+            }
+        }
+    }
+    
+    return true;
+}
+
 /**
  * Draw the user's selected image over the background
  *
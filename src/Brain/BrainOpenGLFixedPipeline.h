@@ -50,12 +50,14 @@ namespace caret {
     class BoundingBox;
     class Brain;
     class BrainOpenGLAnnotationDrawingFixedPipeline;
+    class BrainOpenGLFeatureDrawCache;
     class BrainOpenGLShapeCone;
     class BrainOpenGLShapeCube;
     class BrainOpenGLShapeCylinder;
     class BrainOpenGLShapeRing;
     class BrainOpenGLShapeRingOutline;
     class BrainOpenGLShapeSphere;
+    class BrainOpenGLSurfaceBufferCache;
     class BrainOpenGLTextureManager;
     class BrainOpenGLViewportContent;
     class BrowserTabContent;
@@ -406,6 +408,19 @@ namespace caret {
         void drawSquare(const uint8_t rgba[4],
                         const float size);
         
+        void drawSquares(const std::vector<float>& xyz,
+                         const std::vector<float>& rgba,
+                         const float size);
+        
+        void drawSquares(const std::vector<float>& xyz,
+                         const std::vector<uint8_t>& rgba,
+                         const float size);
+        
+        bool createSquareVertices(const std::vector<float>& xyz,
+                                  const float size,
+                                  std::vector<float>& verticesOut,
+                                  std::vector<float>& normalsOut) const;
+        
         void drawCube(const float rgba[4],
                       const double cubeSize);
         
@@ -614,6 +629,12 @@ namespace caret {
         /** The texture manager. */
         CaretPointer<BrainOpenGLTextureManager> m_textureManager;
         
+        /** Retained vertex buffers for drawing surfaces */
+        CaretPointer<BrainOpenGLSurfaceBufferCache> m_surfaceBufferCache;
+        
+        /** Selected foci and borders with their colors */
+        CaretPointer<BrainOpenGLFeatureDrawCache> m_featureDrawCache;
+        
         static bool s_staticInitialized;
 
         static const float s_gluLookAtCenterFromEyeOffsetDistance;
@@ -0,0 +1,494 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <algorithm>
+#include <cstring>
+
+#define __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+#include "BrainOpenGLSurfaceBufferCache.h"
+#undef __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+
+#include "BrainOpenGL.h"
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretProfiler.h"
+#include "SurfaceFile.h"
+
+using namespace caret;
+
+
+
+/**
+ * \class caret::BrainOpenGLSurfaceBufferCache
+ * \brief Retains surface geometry and coloring in OpenGL vertex buffers.
+ * \ingroup Brain
+ *
+ * Coordinates, normals, and triangles are uploaded only when the
+ * surface's modification stamps change.  A copy of the uploaded
+ * coloring is kept so that only the ranges of vertices whose
+ * coloring changed are sent again.
+ *
+ * Each window has its own OpenGL context, so each instance of
+ * BrainOpenGLFixedPipeline has its own cache.
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLSurfaceBufferCache::BrainOpenGLSurfaceBufferCache()
+: CaretObject()
+{
+    m_frameNumber = 0;
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLSurfaceBufferCache::~BrainOpenGLSurfaceBufferCache()
+{
+    /*
+     * The OpenGL context is deleted along with the owner of
+     * this cache, which deletes the buffers.
+     */
+    forgetAllBuffers();
+}
+
+/**
+ * Draw the surface's triangles from retained vertex buffers, uploading
+ * whatever changed since the surface was last drawn.
+ *
+ * @param surface
+ *    Surface that is drawn.
+ * @param nodeColoringRGBA
+ *    RGBA coloring for the nodes, NULL uses the current OpenGL color.
+ * @return
+ *    True if the surface was drawn.  False if vertex buffers are
+ *    not in use, in which case the caller must draw the surface.
+ */
+bool
+BrainOpenGLSurfaceBufferCache::drawSurfaceTriangles(const SurfaceFile* surface,
+                                                    const float* nodeColoringRGBA)
+{
+    CaretAssert(surface);
+
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (BrainOpenGL::getBestDrawingMode() != BrainOpenGL::DRAW_MODE_VERTEX_BUFFERS) {
+        return false;
+    }
+
+    const int32_t numberOfNodes     = surface->getNumberOfNodes();
+    const int32_t numberOfTriangles = surface->getNumberOfTriangles();
+    if ((numberOfNodes <= 0)
+        || (numberOfTriangles <= 0)) {
+        return false;
+    }
+
+    CaretProfileSpan mySpan("BrainOpenGLSurfaceBufferCache::drawSurfaceTriangles", "draw");
+
+    SurfaceBuffers* surfaceBuffers = getSurfaceBuffers(surface);
+    if (surfaceBuffers == NULL) {
+        return false;
+    }
+
+    if (surfaceBuffers->m_numberOfNodes != numberOfNodes) {
+        /*
+         * Color buffers are sized by the number of nodes
+         */
+        for (std::map<const float*, ColorBuffer*>::iterator iter = surfaceBuffers->m_colorBuffers.begin();
+             iter != surfaceBuffers->m_colorBuffers.end();
+             iter++) {
+            iter->second->m_uploadedRGBA.clear();
+        }
+    }
+
+    const int64_t coordinateStamp = surface->getCoordinateModificationStamp();
+    if ((surfaceBuffers->m_coordinateStamp != coordinateStamp)
+        || (surfaceBuffers->m_numberOfNodes != numberOfNodes)) {
+        const GLsizeiptr numberOfBytes = static_cast<GLsizeiptr>(numberOfNodes) * 3 * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER,
+                     surfaceBuffers->m_coordinateBufferID);
+        glBufferData(GL_ARRAY_BUFFER,
+                     numberOfBytes,
+                     surface->getCoordinateData(),
+                     GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER,
+                     surfaceBuffers->m_normalBufferID);
+        glBufferData(GL_ARRAY_BUFFER,
+                     numberOfBytes,
+                     surface->getNormalData(),
+                     GL_STATIC_DRAW);
+        mySpan.addBytes(numberOfBytes * 2);
+
+        surfaceBuffers->m_coordinateStamp = coordinateStamp;
+        surfaceBuffers->m_numberOfNodes   = numberOfNodes;
+    }
+
+    const int64_t topologyStamp = surface->getTopologyModificationStamp();
+    if ((surfaceBuffers->m_topologyStamp != topologyStamp)
+        || (surfaceBuffers->m_numberOfTriangles != numberOfTriangles)) {
+        const GLsizeiptr numberOfBytes = static_cast<GLsizeiptr>(numberOfTriangles) * 3 * sizeof(int32_t);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                     surfaceBuffers->m_triangleBufferID);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     numberOfBytes,
+                     surface->getTriangle(0),
+                     GL_STATIC_DRAW);
+        mySpan.addBytes(numberOfBytes);
+
+        surfaceBuffers->m_topologyStamp     = topologyStamp;
+        surfaceBuffers->m_numberOfTriangles = numberOfTriangles;
+    }
+
+    GLuint colorBufferID = 0;
+    if (nodeColoringRGBA != NULL) {
+        ColorBuffer* colorBuffer = getColorBuffer(surfaceBuffers,
+                                                  nodeColoringRGBA);
+        if (colorBuffer == NULL) {
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            return false;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER,
+                     colorBuffer->m_bufferID);
+        const int64_t numberOfComponents = static_cast<int64_t>(numberOfNodes) * 4;
+        if (static_cast<int64_t>(colorBuffer->m_uploadedRGBA.size()) != numberOfComponents) {
+            colorBuffer->m_uploadedRGBA.assign(nodeColoringRGBA,
+                                               nodeColoringRGBA + numberOfComponents);
+            glBufferData(GL_ARRAY_BUFFER,
+                         numberOfComponents * sizeof(float),
+                         nodeColoringRGBA,
+                         GL_DYNAMIC_DRAW);
+            mySpan.addBytes(numberOfComponents * sizeof(float));
+        }
+        else {
+            std::vector<std::pair<int64_t, int64_t> > changedRanges;
+            findChangedVertexRanges(&colorBuffer->m_uploadedRGBA[0],
+                                    nodeColoringRGBA,
+                                    numberOfNodes,
+                                    s_maximumColorGap,
+                                    changedRanges);
+            for (std::vector<std::pair<int64_t, int64_t> >::const_iterator iter = changedRanges.begin();
+                 iter != changedRanges.end();
+                 iter++) {
+                const int64_t firstComponent = iter->first * 4;
+                const int64_t componentCount = (iter->second - iter->first) * 4;
+                glBufferSubData(GL_ARRAY_BUFFER,
+                                firstComponent * sizeof(float),
+                                componentCount * sizeof(float),
+                                nodeColoringRGBA + firstComponent);
+                std::copy(nodeColoringRGBA + firstComponent,
+                          nodeColoringRGBA + firstComponent + componentCount,
+                          colorBuffer->m_uploadedRGBA.begin() + firstComponent);
+                mySpan.addBytes(componentCount * sizeof(float));
+            }
+        }
+        colorBufferID = colorBuffer->m_bufferID;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 surfaceBuffers->m_coordinateBufferID);
+    glVertexPointer(3,
+                    GL_FLOAT,
+                    0,
+                    0);
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 surfaceBuffers->m_normalBufferID);
+    glNormalPointer(GL_FLOAT,
+                    0,
+                    0);
+    if (colorBufferID > 0) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER,
+                     colorBufferID);
+        glColorPointer(4,
+                       GL_FLOAT,
+                       0,
+                       0);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 surfaceBuffers->m_triangleBufferID);
+    glDrawElements(GL_TRIANGLES,
+                   (3 * numberOfTriangles),
+                   GL_UNSIGNED_INT,
+                   0);
+
+    /*
+     * Unbind so that client-side arrays work for other drawing
+     */
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+
+    return true;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return false;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Release buffers for surfaces and colorings that have not been drawn
+ * recently, such as those of surfaces that were closed.  Call once each
+ * time a window is drawn, with the window's OpenGL context current.
+ */
+void
+BrainOpenGLSurfaceBufferCache::releaseUnusedBuffers()
+{
+    m_frameNumber++;
+
+    std::map<const SurfaceFile*, SurfaceBuffers*>::iterator surfaceIter = m_surfaceBuffers.begin();
+    while (surfaceIter != m_surfaceBuffers.end()) {
+        SurfaceBuffers* surfaceBuffers = surfaceIter->second;
+        if ((m_frameNumber - surfaceBuffers->m_lastFrameUsed) > s_framesUntilRelease) {
+            releaseSurfaceBuffers(surfaceBuffers,
+                                  true);
+            m_surfaceBuffers.erase(surfaceIter++);
+            continue;
+        }
+
+        std::map<const float*, ColorBuffer*>::iterator colorIter = surfaceBuffers->m_colorBuffers.begin();
+        while (colorIter != surfaceBuffers->m_colorBuffers.end()) {
+            ColorBuffer* colorBuffer = colorIter->second;
+            if ((m_frameNumber - colorBuffer->m_lastFrameUsed) > s_framesUntilRelease) {
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+                glDeleteBuffers(1, &colorBuffer->m_bufferID);
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+                delete colorBuffer;
+                surfaceBuffers->m_colorBuffers.erase(colorIter++);
+            }
+            else {
+                colorIter++;
+            }
+        }
+
+        surfaceIter++;
+    }
+}
+
+/**
+ * Find the ranges of vertices whose coloring differs.  Ranges separated
+ * by no more than the maximum gap of unchanged vertices are merged so
+ * that many small changes do not become many small uploads.
+ *
+ * @param previousRGBA
+ *    RGBA coloring that was previously uploaded.
+ * @param newRGBA
+ *    New RGBA coloring.
+ * @param numberOfVertices
+ *    Number of vertices in both colorings.
+ * @param maximumGap
+ *    Largest run of unchanged vertices that is included in a range.
+ * @param rangesOut
+ *    Output containing [first, end) vertex ranges that changed.
+ */
+void
+BrainOpenGLSurfaceBufferCache::findChangedVertexRanges(const float* previousRGBA,
+                                                       const float* newRGBA,
+                                                       const int64_t numberOfVertices,
+                                                       const int64_t maximumGap,
+                                                       std::vector<std::pair<int64_t, int64_t> >& rangesOut)
+{
+    rangesOut.clear();
+
+    const size_t vertexBytes = 4 * sizeof(float);
+    int64_t i = 0;
+    while (i < numberOfVertices) {
+        if (std::memcmp(previousRGBA + i * 4, newRGBA + i * 4, vertexBytes) == 0) {
+            i++;
+            continue;
+        }
+
+        const int64_t first = i;
+        int64_t end = i + 1;
+        int64_t j = i + 1;
+        while (j < numberOfVertices) {
+            if (std::memcmp(previousRGBA + j * 4, newRGBA + j * 4, vertexBytes) != 0) {
+                end = j + 1;
+            }
+            else if ((j + 1 - end) > maximumGap) {
+                break;
+            }
+            j++;
+        }
+        rangesOut.push_back(std::make_pair(first, end));
+        i = j;
+    }
+}
+
+/**
+ * Get the buffers for a surface, creating them if needed.
+ *
+ * @param surface
+ *    The surface.
+ * @return
+ *    Buffers for the surface or NULL if buffers could not be created.
+ */
+BrainOpenGLSurfaceBufferCache::SurfaceBuffers*
+BrainOpenGLSurfaceBufferCache::getSurfaceBuffers(const SurfaceFile* surface)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    std::map<const SurfaceFile*, SurfaceBuffers*>::iterator iter = m_surfaceBuffers.find(surface);
+    if (iter != m_surfaceBuffers.end()) {
+        SurfaceBuffers* surfaceBuffers = iter->second;
+
+        /*
+         * Capturing an image may recreate the OpenGL context
+         * which invalidates all buffers.
+         */
+        if (glIsBuffer(surfaceBuffers->m_coordinateBufferID)) {
+            surfaceBuffers->m_lastFrameUsed = m_frameNumber;
+            return surfaceBuffers;
+        }
+        forgetAllBuffers();
+    }
+
+    GLuint bufferIDs[3] = { 0, 0, 0 };
+    glGenBuffers(3, bufferIDs);
+    if ((bufferIDs[0] == 0)
+        || (bufferIDs[1] == 0)
+        || (bufferIDs[2] == 0)) {
+        CaretLogSevere("Failed to create OpenGL Vertex Buffers for surface "
+                       + surface->getFileNameNoPath());
+        for (int32_t i = 0; i < 3; i++) {
+            if (bufferIDs[i] > 0) {
+                glDeleteBuffers(1, &bufferIDs[i]);
+            }
+        }
+        return NULL;
+    }
+
+    SurfaceBuffers* surfaceBuffers = new SurfaceBuffers();
+    surfaceBuffers->m_coordinateBufferID = bufferIDs[0];
+    surfaceBuffers->m_normalBufferID     = bufferIDs[1];
+    surfaceBuffers->m_triangleBufferID   = bufferIDs[2];
+    surfaceBuffers->m_coordinateStamp    = 0;
+    surfaceBuffers->m_topologyStamp      = 0;
+    surfaceBuffers->m_numberOfNodes      = 0;
+    surfaceBuffers->m_numberOfTriangles  = 0;
+    surfaceBuffers->m_lastFrameUsed      = m_frameNumber;
+    m_surfaceBuffers.insert(std::make_pair(surface,
+                                           surfaceBuffers));
+
+    return surfaceBuffers;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return NULL;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Get the color buffer for a coloring of a surface, creating it if needed.
+ *
+ * @param surfaceBuffers
+ *    Buffers of the surface.
+ * @param nodeColoringRGBA
+ *    The coloring.
+ * @return
+ *    The color buffer or NULL if it could not be created.
+ */
+BrainOpenGLSurfaceBufferCache::ColorBuffer*
+BrainOpenGLSurfaceBufferCache::getColorBuffer(SurfaceBuffers* surfaceBuffers,
+                                              const float* nodeColoringRGBA)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    std::map<const float*, ColorBuffer*>::iterator iter = surfaceBuffers->m_colorBuffers.find(nodeColoringRGBA);
+    if (iter != surfaceBuffers->m_colorBuffers.end()) {
+        iter->second->m_lastFrameUsed = m_frameNumber;
+        return iter->second;
+    }
+
+    GLuint bufferID = 0;
+    glGenBuffers(1, &bufferID);
+    if (bufferID == 0) {
+        CaretLogSevere("Failed to create a new OpenGL Vertex Buffer for surface coloring");
+        return NULL;
+    }
+
+    ColorBuffer* colorBuffer = new ColorBuffer();
+    colorBuffer->m_bufferID      = bufferID;
+    colorBuffer->m_lastFrameUsed = m_frameNumber;
+    surfaceBuffers->m_colorBuffers.insert(std::make_pair(nodeColoringRGBA,
+                                                         colorBuffer));
+
+    return colorBuffer;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return NULL;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Release the buffers of a surface and delete the surface's entry.
+ *
+ * @param surfaceBuffers
+ *    Buffers of the surface.
+ * @param deleteBuffersFlag
+ *    If true, delete the OpenGL buffers.  False when the OpenGL
+ *    context that owned the buffers no longer exists.
+ */
+void
+BrainOpenGLSurfaceBufferCache::releaseSurfaceBuffers(SurfaceBuffers* surfaceBuffers,
+                                                     const bool deleteBuffersFlag)
+{
+    for (std::map<const float*, ColorBuffer*>::iterator iter = surfaceBuffers->m_colorBuffers.begin();
+         iter != surfaceBuffers->m_colorBuffers.end();
+         iter++) {
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+        if (deleteBuffersFlag) {
+            glDeleteBuffers(1, &iter->second->m_bufferID);
+        }
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+        delete iter->second;
+    }
+    surfaceBuffers->m_colorBuffers.clear();
+
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (deleteBuffersFlag) {
+        const GLuint bufferIDs[3] = {
+            surfaceBuffers->m_coordinateBufferID,
+            surfaceBuffers->m_normalBufferID,
+            surfaceBuffers->m_triangleBufferID
+        };
+        glDeleteBuffers(3, bufferIDs);
+    }
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+
+    delete surfaceBuffers;
+}
+
+/**
+ * Remove all entries without deleting their OpenGL buffers.
+ */
+void
+BrainOpenGLSurfaceBufferCache::forgetAllBuffers()
+{
+    for (std::map<const SurfaceFile*, SurfaceBuffers*>::iterator iter = m_surfaceBuffers.begin();
+         iter != m_surfaceBuffers.end();
+         iter++) {
+        releaseSurfaceBuffers(iter->second,
+                              false);
+    }
+    m_surfaceBuffers.clear();
+}
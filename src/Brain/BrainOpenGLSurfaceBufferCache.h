@@ -0,0 +1,122 @@
+#ifndef __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_H__
+#define __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "CaretObject.h"
+#include "CaretOpenGLInclude.h"
+
+
+namespace caret {
+
+    class SurfaceFile;
+
+    class BrainOpenGLSurfaceBufferCache : public CaretObject {
+
+    public:
+        BrainOpenGLSurfaceBufferCache();
+
+        virtual ~BrainOpenGLSurfaceBufferCache();
+
+        bool drawSurfaceTriangles(const SurfaceFile* surface,
+                                  const float* nodeColoringRGBA);
+
+        void releaseUnusedBuffers();
+
+        static void findChangedVertexRanges(const float* previousRGBA,
+                                            const float* newRGBA,
+                                            const int64_t numberOfVertices,
+                                            const int64_t maximumGap,
+                                            std::vector<std::pair<int64_t, int64_t> >& rangesOut);
+
+        // ADD_NEW_METHODS_HERE
+
+    private:
+        /** Color buffer and a copy of the colors last uploaded to it */
+        struct ColorBuffer {
+            GLuint m_bufferID;
+
+            std::vector<float> m_uploadedRGBA;
+
+            int64_t m_lastFrameUsed;
+        };
+
+        /** Buffers for one surface */
+        struct SurfaceBuffers {
+            GLuint m_coordinateBufferID;
+
+            GLuint m_normalBufferID;
+
+            GLuint m_triangleBufferID;
+
+            int64_t m_coordinateStamp;
+
+            int64_t m_topologyStamp;
+
+            int32_t m_numberOfNodes;
+
+            int32_t m_numberOfTriangles;
+
+            /** KEY is the coloring array, each browser tab has its own */
+            std::map<const float*, ColorBuffer*> m_colorBuffers;
+
+            int64_t m_lastFrameUsed;
+        };
+
+        BrainOpenGLSurfaceBufferCache(const BrainOpenGLSurfaceBufferCache&);
+
+        BrainOpenGLSurfaceBufferCache& operator=(const BrainOpenGLSurfaceBufferCache&);
+
+        SurfaceBuffers* getSurfaceBuffers(const SurfaceFile* surface);
+
+        ColorBuffer* getColorBuffer(SurfaceBuffers* surfaceBuffers,
+                                    const float* nodeColoringRGBA);
+
+        void releaseSurfaceBuffers(SurfaceBuffers* surfaceBuffers,
+                                   const bool deleteBuffersFlag);
+
+        void forgetAllBuffers();
+
+        /** KEY is the surface, stamps detect a different surface at a reused address */
+        std::map<const SurfaceFile*, SurfaceBuffers*> m_surfaceBuffers;
+
+        /** Incremented each time unused buffers are released */
+        int64_t m_frameNumber;
+
+        static const int64_t s_framesUntilRelease;
+
+        static const int64_t s_maximumColorGap;
+
+        // ADD_NEW_MEMBERS_HERE
+
+    };
+
+#ifdef __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+    const int64_t BrainOpenGLSurfaceBufferCache::s_framesUntilRelease = 50;
+    const int64_t BrainOpenGLSurfaceBufferCache::s_maximumColorGap = 1024;
+#endif // __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+
+} // namespace
+#endif  //__BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_H__
@@ -683,17 +683,16 @@ SurfaceNodeColoring::assignLabelTableColors(const GiftiLabelTable* labelTable,
     outlineRGBA[3] = 1.0;
     
     /*
-     * Assign colors from labels to nodes
+     * Resolve selection and color once per label so that each
+     * node only needs a flat key lookup.
      */
-    float nodeRGBA[4];
-    for (int32_t i = 0; i < numberOfIndices; i++) {
-        CaretAssertVectorIndex(labelIndices, i);
-        const int32_t labelKey= static_cast<int32_t>(labelIndices[i]);
-        const GiftiLabel* label = labelTable->getLabel(labelKey);
-        if (label == NULL) {
-            continue;
-        }
-        
+    CaretPointer<const GiftiLabelTableLookup> lookupPointer = labelTable->getLookup();
+    const GiftiLabelTableLookup* lookup = lookupPointer.getPointer();
+    const int32_t numberOfLabels = lookup->getNumberOfLabels();
+    std::vector<float> labelRGBA(numberOfLabels * 4);
+    std::vector<char> labelColoredFlags(numberOfLabels, 0);
+    for (int32_t iLabel = 0; iLabel < numberOfLabels; iLabel++) {
+        const GiftiLabel* label = lookup->getLabelAtIndex(iLabel);
         const GroupAndNameHierarchyItem* nameItem = label->getGroupNameSelectionItem();
         if (nameItem != NULL) {
             if (nameItem->isSelected(displayGroup,
@@ -701,14 +700,33 @@ SurfaceNodeColoring::assignLabelTableColors(const GiftiLabelTable* labelTable,
                 continue;
             }
         }
+        label->getColor(&labelRGBA[iLabel * 4]);
+        if (labelRGBA[iLabel * 4 + 3] > 0.0) {
+            labelColoredFlags[iLabel] = 1;
+        }
+    }
+    
+    /*
+     * Assign colors from labels to nodes
+     */
+    float nodeRGBA[4];
+    for (int32_t i = 0; i < numberOfIndices; i++) {
+        CaretAssertVectorIndex(labelIndices, i);
+        const int32_t labelKey= static_cast<int32_t>(labelIndices[i]);
+        const int32_t labelIndex = lookup->findIndex(labelKey);
+        if ((labelIndex < 0)
+            || (labelColoredFlags[labelIndex] == 0)) {
+            continue;
+        }
+        const GiftiLabel* label = lookup->getLabelAtIndex(labelIndex);
         
         /*
          * Initialize node color to its label's color
          */
-        label->getColor(nodeRGBA);
-        if (nodeRGBA[3] <= 0.0) {
-            continue;
-        }
+        nodeRGBA[0] = labelRGBA[labelIndex * 4];
+        nodeRGBA[1] = labelRGBA[labelIndex * 4 + 1];
+        nodeRGBA[2] = labelRGBA[labelIndex * 4 + 2];
+        nodeRGBA[3] = labelRGBA[labelIndex * 4 + 3];
         
         /*
          * If a node is the same color as all of its neighbors,
@@ -28,7 +28,6 @@
 #include <QTextStream>
 
 #include "CaretAssert.h"
-#include "ChartPoint.h"
 #include "SceneClass.h"
 #include "SceneClassAssistant.h"
 
@@ -126,12 +125,9 @@ ChartDataCartesian::initializeMembersChartDataCartesian()
 void
 ChartDataCartesian::removeAllPoints()
 {
-    for (std::vector<ChartPoint*>::const_iterator iter = m_points.begin();
-         iter != m_points.end();
-         iter++) {
-        delete *iter;
-    }
-    m_points.clear();
+    m_pointsX.clear();
+    m_pointsY.clear();
+    m_levelOfDetail.invalidate();
     
     m_boundsValid = false;
 }
@@ -197,12 +193,8 @@ ChartDataCartesian::copyHelperChartDataCartesian(const ChartDataCartesian& obj)
     
     removeAllPoints();
 
-    for (std::vector<ChartPoint*>::const_iterator iter = obj.m_points.begin();
-         iter != obj.m_points.end();
-         iter++) {
-        const ChartPoint* cp = *iter;
-        m_points.push_back(new ChartPoint(*cp));
-    }
+    m_pointsX = obj.m_pointsX;
+    m_pointsY = obj.m_pointsY;
 
     m_boundsValid       = false;
     m_color             = obj.m_color;
@@ -222,7 +214,9 @@ void
 ChartDataCartesian::addPoint(const float x,
                                   const float y)
 {
-    m_points.push_back(new ChartPoint(x, y));
+    m_pointsX.push_back(x);
+    m_pointsY.push_back(y);
+    m_levelOfDetail.invalidate();
     m_boundsValid = false;
 }
 
@@ -232,22 +226,69 @@ ChartDataCartesian::addPoint(const float x,
 int32_t
 ChartDataCartesian::getNumberOfPoints() const
 {
-    return m_points.size();
+    return m_pointsX.size();
+}
+
+/**
+ * Get the X-coordinate of the point at the given index.
+ *
+ * @param pointIndex
+ *    Index of point.
+ * @return
+ *    X-coordinate of point at the given index.
+ */
+float
+ChartDataCartesian::getPointX(const int32_t pointIndex) const
+{
+    CaretAssertVectorIndex(m_pointsX, pointIndex);
+    return m_pointsX[pointIndex];
 }
 
 /**
- * Get the point at the given index.
+ * Get the Y-coordinate of the point at the given index.
  *
  * @param pointIndex
  *    Index of point.
  * @return
- *    Point at the given index.
+ *    Y-coordinate of point at the given index.
+ */
+float
+ChartDataCartesian::getPointY(const int32_t pointIndex) const
+{
+    CaretAssertVectorIndex(m_pointsY, pointIndex);
+    return m_pointsY[pointIndex];
+}
+
+/**
+ * Get the points for drawing the data as a line strip.  When there
+ * are many points per pixel, the points are decimated so that only
+ * the minimum and maximum points within each pixel are drawn.
+ *
+ * @param xMinimum
+ *    Minimum X visible in the chart.
+ * @param xMaximum
+ *    Maximum X visible in the chart.
+ * @param pixelWidth
+ *    Width of the chart, in pixels.
+ * @param xyOut
+ *    Output containing XY pairs for drawing.
+ * @param pointIndicesOut
+ *    Output containing the index of the point for each XY pair.
  */
-const ChartPoint*
-ChartDataCartesian::getPointAtIndex(const int32_t pointIndex) const
+void
+ChartDataCartesian::getPointsForDrawing(const float xMinimum,
+                                        const float xMaximum,
+                                        const int32_t pixelWidth,
+                                        std::vector<float>& xyOut,
+                                        std::vector<int32_t>& pointIndicesOut) const
 {
-    CaretAssertVectorIndex(m_points, pointIndex);
-    return m_points[pointIndex];
+    m_levelOfDetail.getPointsForDrawing(m_pointsX,
+                                        m_pointsY,
+                                        xMinimum,
+                                        xMaximum,
+                                        pixelWidth,
+                                        xyOut,
+                                        pointIndicesOut);
 }
 
 /**
@@ -282,9 +323,8 @@ ChartDataCartesian::getBounds(float& xMinimumOut,
             yMin = std::numeric_limits<float>::max();
             yMax = -std::numeric_limits<float>::max();
             for (int32_t i = 0; i < numPoints; i++) {
-                const float* xy = getPointAtIndex(i)->getXY();
-                const float x = xy[0];
-                const float y = xy[1];
+                const float x = m_pointsX[i];
+                const float y = m_pointsY[i];
                 if (x < xMin) xMin = x;
                 if (x > xMax) xMax = x;
                 if (y < yMin) yMin = y;
@@ -427,8 +467,7 @@ ChartDataCartesian::saveSubClassDataToScene(const SceneAttributes* sceneAttribut
                                QIODevice::WriteOnly);
         
         for (int32_t i = 0; i < numPoints2D; i++) {
-            const float* xy = m_points[i]->getXY();
-            textStream << xy[0] << " " << xy[1] << " ";
+            textStream << m_pointsX[i] << " " << m_pointsY[i] << " ";
         }
         
         chartDataCartesian->addString("points2D",
@@ -473,6 +512,8 @@ ChartDataCartesian::restoreSubClassDataFromScene(const SceneAttributes* sceneAtt
             float x, y;
             QTextStream textStream(&pointString,
                                    QIODevice::ReadOnly);
+            m_pointsX.reserve(numPoints2D);
+            m_pointsY.reserve(numPoints2D);
             for (int32_t i = 0; i < numPoints2D; i++) {
                 if (textStream.atEnd()) {
                     sceneAttributes->addToErrorMessage("Tried to read "
@@ -484,7 +525,8 @@ ChartDataCartesian::restoreSubClassDataFromScene(const SceneAttributes* sceneAtt
                 
                 textStream >> x;
                 textStream >> y;
-                m_points.push_back(new ChartPoint(x, y));
+                m_pointsX.push_back(x);
+                m_pointsY.push_back(y);
             }
         }
     }
@@ -24,13 +24,12 @@
 #include "CaretColorEnum.h"
 #include "ChartAxisUnitsEnum.h"
 #include "ChartData.h"
+#include "ChartLineLevelOfDetail.h"
 
 
 
 namespace caret {
 
-    class ChartPoint;
-    
     class ChartDataCartesian : public ChartData {
         
     public:
@@ -47,7 +46,15 @@ namespace caret {
         
         int32_t getNumberOfPoints() const;
         
-        const ChartPoint* getPointAtIndex(const int32_t pointIndex) const;
+        float getPointX(const int32_t pointIndex) const;
+        
+        float getPointY(const int32_t pointIndex) const;
+        
+        void getPointsForDrawing(const float xMinimum,
+                                 const float xMaximum,
+                                 const int32_t pixelWidth,
+                                 std::vector<float>& xyOut,
+                                 std::vector<int32_t>& pointIndicesOut) const;
         
         void getBounds(float& xMinimumOut,
                        float& xMaximumOut,
@@ -91,7 +98,14 @@ namespace caret {
         
         void removeAllPoints();
         
-        std::vector<ChartPoint*> m_points;
+        /** X-coordinates of points */
+        std::vector<float> m_pointsX;
+        
+        /** Y-coordinates of points */
+        std::vector<float> m_pointsY;
+        
+        /** Decimation of points for drawing */
+        ChartLineLevelOfDetail m_levelOfDetail;
         
         mutable float m_bounds[6];
         
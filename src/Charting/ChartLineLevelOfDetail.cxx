@@ -0,0 +1,312 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <algorithm>
+
+#define __CHART_LINE_LEVEL_OF_DETAIL_DECLARE__
+#include "ChartLineLevelOfDetail.h"
+#undef __CHART_LINE_LEVEL_OF_DETAIL_DECLARE__
+
+#include "CaretAssert.h"
+
+using namespace caret;
+
+
+    
+/**
+ * \class caret::ChartLineLevelOfDetail 
+ * \brief Min/max decimation pyramid for drawing long line series.
+ * \ingroup Charting
+ *
+ * Drawing a line series with many more points than there are pixels
+ * across the chart wastes time since many points map to the same
+ * pixel column.  For each power-of-two bucket size, this pyramid keeps
+ * the indices of the points with the minimum and maximum Y-values in
+ * each bucket.  Drawing the minimum and maximum of each bucket, in
+ * point order, produces the same envelope as drawing all of the points
+ * while the number of vertices is proportional to the width of the
+ * chart instead of the number of points.
+ *
+ * The pyramid is built lazily from the point data and must be
+ * invalidated by the owner whenever the points change.
+ */
+
+/**
+ * Constructor.
+ */
+ChartLineLevelOfDetail::ChartLineLevelOfDetail()
+{
+    m_levelsValid   = false;
+    m_xValuesSorted = false;
+}
+
+/**
+ * Destructor.
+ */
+ChartLineLevelOfDetail::~ChartLineLevelOfDetail()
+{
+}
+
+/**
+ * Invalidate the levels so that they are rebuilt the next
+ * time points are requested for drawing.
+ */
+void
+ChartLineLevelOfDetail::invalidate()
+{
+    m_levelMinimumIndices.clear();
+    m_levelMaximumIndices.clear();
+    m_levelsValid   = false;
+    m_xValuesSorted = false;
+}
+
+/**
+ * @return Number of decimation levels (zero until points have
+ * been requested for drawing).
+ */
+int32_t
+ChartLineLevelOfDetail::getNumberOfLevels() const
+{
+    return static_cast<int32_t>(m_levelMinimumIndices.size());
+}
+
+/**
+ * Build the decimation levels.
+ *
+ * @param xValues
+ *     X-values of the points.
+ * @param yValues
+ *     Y-values of the points.
+ */
+void
+ChartLineLevelOfDetail::buildLevels(const std::vector<float>& xValues,
+                                    const std::vector<float>& yValues) const
+{
+    CaretAssert(xValues.size() == yValues.size());
+    
+    m_levelMinimumIndices.clear();
+    m_levelMaximumIndices.clear();
+    
+    const int32_t numPoints = static_cast<int32_t>(yValues.size());
+    
+    m_xValuesSorted = true;
+    for (int32_t i = 1; i < numPoints; i++) {
+        if (xValues[i] < xValues[i - 1]) {
+            m_xValuesSorted = false;
+            break;
+        }
+    }
+    
+    /*
+     * First level pairs up the points
+     */
+    int32_t previousCount = numPoints;
+    if (previousCount > 1) {
+        const int32_t numBuckets = (previousCount + 1) / 2;
+        m_levelMinimumIndices.push_back(std::vector<int32_t>(numBuckets));
+        m_levelMaximumIndices.push_back(std::vector<int32_t>(numBuckets));
+        std::vector<int32_t>& minIndices = m_levelMinimumIndices.back();
+        std::vector<int32_t>& maxIndices = m_levelMaximumIndices.back();
+        for (int32_t iBucket = 0; iBucket < numBuckets; iBucket++) {
+            const int32_t i0 = iBucket * 2;
+            const int32_t i1 = std::min(i0 + 1, numPoints - 1);
+            minIndices[iBucket] = ((yValues[i1] < yValues[i0]) ? i1 : i0);
+            maxIndices[iBucket] = ((yValues[i1] > yValues[i0]) ? i1 : i0);
+        }
+        previousCount = numBuckets;
+    }
+    
+    /*
+     * Remaining levels merge pairs of buckets from the previous level
+     */
+    while (previousCount > 1) {
+        const int32_t numBuckets = (previousCount + 1) / 2;
+        m_levelMinimumIndices.push_back(std::vector<int32_t>(numBuckets));
+        m_levelMaximumIndices.push_back(std::vector<int32_t>(numBuckets));
+        const int32_t numLevels = static_cast<int32_t>(m_levelMinimumIndices.size());
+        const std::vector<int32_t>& prevMinIndices = m_levelMinimumIndices[numLevels - 2];
+        const std::vector<int32_t>& prevMaxIndices = m_levelMaximumIndices[numLevels - 2];
+        std::vector<int32_t>& minIndices = m_levelMinimumIndices[numLevels - 1];
+        std::vector<int32_t>& maxIndices = m_levelMaximumIndices[numLevels - 1];
+        for (int32_t iBucket = 0; iBucket < numBuckets; iBucket++) {
+            const int32_t b0 = iBucket * 2;
+            const int32_t b1 = std::min(b0 + 1, previousCount - 1);
+            const int32_t min0 = prevMinIndices[b0];
+            const int32_t min1 = prevMinIndices[b1];
+            const int32_t max0 = prevMaxIndices[b0];
+            const int32_t max1 = prevMaxIndices[b1];
+            minIndices[iBucket] = ((yValues[min1] < yValues[min0]) ? min1 : min0);
+            maxIndices[iBucket] = ((yValues[max1] > yValues[max0]) ? max1 : max0);
+        }
+        previousCount = numBuckets;
+    }
+    
+    m_levelsValid = true;
+}
+
+/**
+ * Add a point to the drawing output.
+ *
+ * @param xValues
+ *     X-values of the points.
+ * @param yValues
+ *     Y-values of the points.
+ * @param pointIndex
+ *     Index of point that is added.
+ * @param xyOut
+ *     Output with XY of point appended.
+ * @param pointIndicesOut
+ *     Output with index of point appended.
+ */
+void
+ChartLineLevelOfDetail::addPoint(const std::vector<float>& xValues,
+                                 const std::vector<float>& yValues,
+                                 const int32_t pointIndex,
+                                 std::vector<float>& xyOut,
+                                 std::vector<int32_t>& pointIndicesOut) const
+{
+    CaretAssertVectorIndex(xValues, pointIndex);
+    CaretAssertVectorIndex(yValues, pointIndex);
+    xyOut.push_back(xValues[pointIndex]);
+    xyOut.push_back(yValues[pointIndex]);
+    pointIndicesOut.push_back(pointIndex);
+}
+
+/**
+ * Get the points for drawing a line strip across the given X-range.
+ * When there are several points per pixel, only the minimum and maximum
+ * points in each pixel-sized bucket are output.  Otherwise, all points
+ * in the X-range (plus one point on either side so that the line
+ * reaches the edges) are output.
+ *
+ * @param xValues
+ *     X-values of the points.  If they are not in increasing order,
+ *     the X-range is ignored and decimation covers all points.
+ * @param yValues
+ *     Y-values of the points.
+ * @param xMinimum
+ *     Minimum X visible in the chart.
+ * @param xMaximum
+ *     Maximum X visible in the chart.
+ * @param pixelWidth
+ *     Width of the chart, in pixels.
+ * @param xyOut
+ *     Output containing XY pairs for drawing as a line strip.
+ * @param pointIndicesOut
+ *     Output containing the index of the point for each XY pair.
+ */
+void
+ChartLineLevelOfDetail::getPointsForDrawing(const std::vector<float>& xValues,
+                                            const std::vector<float>& yValues,
+                                            const float xMinimum,
+                                            const float xMaximum,
+                                            const int32_t pixelWidth,
+                                            std::vector<float>& xyOut,
+                                            std::vector<int32_t>& pointIndicesOut) const
+{
+    xyOut.clear();
+    pointIndicesOut.clear();
+    
+    const int32_t numPoints = static_cast<int32_t>(yValues.size());
+    if (numPoints <= 0) {
+        return;
+    }
+    
+    if ( ! m_levelsValid) {
+        buildLevels(xValues,
+                    yValues);
+    }
+    
+    /*
+     * Find range of points that are visible
+     */
+    int32_t firstIndex = 0;
+    int32_t lastIndex  = numPoints - 1;
+    if (m_xValuesSorted
+        && (xMinimum < xMaximum)) {
+        firstIndex = static_cast<int32_t>(std::lower_bound(xValues.begin(),
+                                                           xValues.end(),
+                                                           xMinimum) - xValues.begin());
+        lastIndex  = static_cast<int32_t>(std::upper_bound(xValues.begin(),
+                                                           xValues.end(),
+                                                           xMaximum) - xValues.begin());
+        firstIndex = std::max(firstIndex - 1, 0);
+        lastIndex  = std::min(lastIndex, numPoints - 1);
+    }
+    if (firstIndex > lastIndex) {
+        return;
+    }
+    
+    const int32_t numVisible = lastIndex - firstIndex + 1;
+    const int32_t pointsPerPixel = ((pixelWidth > 0)
+                                    ? (numVisible / pixelWidth)
+                                    : 0);
+    
+    /*
+     * Find largest level whose bucket size (2^(level+1)) does not
+     * exceed the number of points per pixel.  With fewer than
+     * four points per pixel, decimation does not reduce the number of
+     * vertices (two per bucket) enough to be worthwhile.
+     */
+    int32_t level = -1;
+    if (pointsPerPixel >= 4) {
+        const int32_t numLevels = getNumberOfLevels();
+        while (((level + 1) < numLevels)
+               && ((2 << (level + 1)) <= pointsPerPixel)) {
+            level++;
+        }
+    }
+    
+    if (level < 0) {
+        xyOut.reserve(numVisible * 2);
+        pointIndicesOut.reserve(numVisible);
+        for (int32_t i = firstIndex; i <= lastIndex; i++) {
+            addPoint(xValues, yValues, i, xyOut, pointIndicesOut);
+        }
+        return;
+    }
+    
+    CaretAssertVectorIndex(m_levelMinimumIndices, level);
+    const std::vector<int32_t>& minIndices = m_levelMinimumIndices[level];
+    const std::vector<int32_t>& maxIndices = m_levelMaximumIndices[level];
+    const int32_t bucketShift = level + 1;
+    const int32_t firstBucket = firstIndex >> bucketShift;
+    const int32_t lastBucket  = lastIndex  >> bucketShift;
+    const int32_t numBuckets  = lastBucket - firstBucket + 1;
+    xyOut.reserve(numBuckets * 4);
+    pointIndicesOut.reserve(numBuckets * 2);
+    for (int32_t iBucket = firstBucket; iBucket <= lastBucket; iBucket++) {
+        CaretAssertVectorIndex(minIndices, iBucket);
+        const int32_t minIndex = minIndices[iBucket];
+        const int32_t maxIndex = maxIndices[iBucket];
+        if (minIndex == maxIndex) {
+            addPoint(xValues, yValues, minIndex, xyOut, pointIndicesOut);
+        }
+        else if (minIndex < maxIndex) {
+            addPoint(xValues, yValues, minIndex, xyOut, pointIndicesOut);
+            addPoint(xValues, yValues, maxIndex, xyOut, pointIndicesOut);
+        }
+        else {
+            addPoint(xValues, yValues, maxIndex, xyOut, pointIndicesOut);
+            addPoint(xValues, yValues, minIndex, xyOut, pointIndicesOut);
+        }
+    }
+}
+
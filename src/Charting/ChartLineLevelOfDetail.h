@@ -0,0 +1,86 @@
+#ifndef __CHART_LINE_LEVEL_OF_DETAIL_H__
+#define __CHART_LINE_LEVEL_OF_DETAIL_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <stdint.h>
+#include <vector>
+
+namespace caret {
+
+    class ChartLineLevelOfDetail {
+        
+    public:
+        ChartLineLevelOfDetail();
+        
+        virtual ~ChartLineLevelOfDetail();
+        
+        void invalidate();
+        
+        void getPointsForDrawing(const std::vector<float>& xValues,
+                                 const std::vector<float>& yValues,
+                                 const float xMinimum,
+                                 const float xMaximum,
+                                 const int32_t pixelWidth,
+                                 std::vector<float>& xyOut,
+                                 std::vector<int32_t>& pointIndicesOut) const;
+        
+        int32_t getNumberOfLevels() const;
+
+        // ADD_NEW_METHODS_HERE
+
+    private:
+        ChartLineLevelOfDetail(const ChartLineLevelOfDetail&);
+
+        ChartLineLevelOfDetail& operator=(const ChartLineLevelOfDetail&);
+        
+        void buildLevels(const std::vector<float>& xValues,
+                         const std::vector<float>& yValues) const;
+        
+        void addPoint(const std::vector<float>& xValues,
+                      const std::vector<float>& yValues,
+                      const int32_t pointIndex,
+                      std::vector<float>& xyOut,
+                      std::vector<int32_t>& pointIndicesOut) const;
+        
+        /**
+         * Each level contains, for each bucket of 2^(level+1) consecutive points,
+         * the index of the point with the minimum Y and the index of
+         * the point with the maximum Y.
+         */
+        mutable std::vector<std::vector<int32_t> > m_levelMinimumIndices;
+        
+        mutable std::vector<std::vector<int32_t> > m_levelMaximumIndices;
+        
+        mutable bool m_levelsValid;
+        
+        mutable bool m_xValuesSorted;
+        
+        // ADD_NEW_MEMBERS_HERE
+
+    };
+    
+#ifdef __CHART_LINE_LEVEL_OF_DETAIL_DECLARE__
+    // <PLACE DECLARATIONS OF STATIC MEMBERS HERE>
+#endif // __CHART_LINE_LEVEL_OF_DETAIL_DECLARE__
+
+} // namespace
+#endif  //__CHART_LINE_LEVEL_OF_DETAIL_H__
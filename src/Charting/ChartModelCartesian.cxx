@@ -30,7 +30,6 @@
 #include "ChartAxis.h"
 #include "ChartAxisCartesian.h"
 #include "ChartDataCartesian.h"
-#include "ChartPoint.h"
 #include "ChartScaleAutoRanging.h"
 #include "SceneClassAssistant.h"
 
@@ -188,9 +187,8 @@ ChartModelCartesian::getAverageChartDataForDisplay(const int32_t tabIndex) const
                     xValue.resize(numPoints);
                     ySum.resize(numPoints);
                     for (int64_t i = 0; i < numPoints; i++) {
-                        const ChartPoint* point = cartesianData->getPointAtIndex(i);
-                        xValue[i] = point->getX();
-                        ySum[i]   = point->getY();
+                        xValue[i] = cartesianData->getPointX(i);
+                        ySum[i]   = cartesianData->getPointY(i);
                     }
                     
                     firstChartDataType = cartesianData->getChartDataType();
@@ -200,8 +198,7 @@ ChartModelCartesian::getAverageChartDataForDisplay(const int32_t tabIndex) const
             else {
                 if (numPoints == static_cast<int64_t>(ySum.size())) {
                     for (int64_t i = 0; i < numPoints; i++) {
-                        const ChartPoint* point = cartesianData->getPointAtIndex(i);
-                        ySum[i] += point->getY();
+                        ySum[i] += cartesianData->getPointY(i);
                     }
                     averageCounter++;
                 }
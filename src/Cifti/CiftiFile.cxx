@@ -24,12 +24,22 @@
 #include "CaretAssert.h"
 #include "CaretHttpManager.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CaretProfiler.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "MultiDimArray.h"
 #include "MultiDimIterator.h"
 #include "NiftiIO.h"
 
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <map>
+
 using namespace std;
 using namespace caret;
 
@@ -40,14 +50,18 @@ namespace
     {
         mutable NiftiIO m_nifti;//because file objects aren't stateless (current position), so reading "changes" them
         CiftiXML m_xml;//because we need to parse it to set up the dimensions anyway
+        NiftiOutputDataType m_dataType;//for checking written values against what the header can represent
+        void checkData(const float* dataIn, const int64_t& count);//removes the partial file if the data is refused
     public:
         CiftiOnDiskImpl(const QString& filename);//read-only
-        CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian);//make new empty file with read/write
+        CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian, const NiftiOutputDataType& dataType);//make new empty file with read/write
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
         void getColumn(float* dataOut, const int64_t& index) const;
+        void getRows(float* dataOut, const std::vector<int64_t>& rowIndices, const int64_t& rowSize) const;
         const CiftiXML& getCiftiXML() const { return m_xml; }
         QString getFilename() const { return m_nifti.getFilename(); }
         bool isSwapped() const { return m_nifti.getHeader().isSwapped(); }
+        int16_t getDataType() const { return m_nifti.getHeader().getDataType(); }
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
         void setColumn(const float* dataIn, const int64_t& index);
     };
@@ -64,6 +78,59 @@ namespace
         void setColumn(const float* dataIn, const int64_t& index);
     };
     
+    class CiftiWriteBehindImpl;
+    
+    class CiftiWriteBehindThread : public QThread
+    {
+        CiftiWriteBehindImpl* m_impl;
+    public:
+        CiftiWriteBehindThread(CiftiWriteBehindImpl* impl) { m_impl = impl; }
+        void run();
+    };
+    
+    //queues setRow calls and writes them to the on-disk implementation from a background thread
+    //the queue coalesces rewrites of the same row, and is bounded, setRow blocks while it is full
+    //a write error is thrown from the next call, or from flush()
+    class CiftiWriteBehindImpl : public CiftiFile::WriteImplInterface
+    {
+        CaretPointer<CiftiOnDiskImpl> m_disk;
+        int64_t m_rowSize, m_maxQueuedRows;
+        mutable QMutex m_queueMutex;//protects everything below, except m_disk
+        mutable QMutex m_diskMutex;//NiftiIO has a file position, so reads and writes can't overlap
+        mutable QWaitCondition m_queueChanged;
+        map<vector<int64_t>, vector<float> > m_queue;
+        vector<int64_t> m_inFlightIndex, m_lastWritten;
+        vector<float> m_inFlightRow;
+        bool m_haveInFlight, m_stopping;
+        AString m_error;
+        mutable bool m_errorReported;
+        CiftiWriteBehindThread m_thread;
+        void checkError() const;//call with m_queueMutex locked
+        void flushLocked() const;
+        CiftiWriteBehindImpl(const CiftiWriteBehindImpl&);
+        CiftiWriteBehindImpl& operator=(const CiftiWriteBehindImpl&);
+    public:
+        CiftiWriteBehindImpl(const CaretPointer<CiftiOnDiskImpl>& disk);
+        ~CiftiWriteBehindImpl();
+        void writerLoop();
+        const CiftiOnDiskImpl* getOnDiskImpl() const { return m_disk; }
+        void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
+        void getColumn(float* dataOut, const int64_t& index) const;
+        void getRows(float* dataOut, const std::vector<int64_t>& rowIndices, const int64_t& rowSize) const;
+        void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
+        void setColumn(const float* dataIn, const int64_t& index);
+        void flush();
+    };
+    
+    const CiftiOnDiskImpl* getOnDiskImpl(const CiftiFile::ReadImplInterface* impl)
+    {
+        const CiftiOnDiskImpl* ret = dynamic_cast<const CiftiOnDiskImpl*>(impl);
+        if (ret != NULL) return ret;
+        const CiftiWriteBehindImpl* writeBehind = dynamic_cast<const CiftiWriteBehindImpl*>(impl);
+        if (writeBehind != NULL) return writeBehind->getOnDiskImpl();
+        return NULL;
+    }
+    
     class CiftiXnatImpl : public CiftiFile::ReadImplInterface
     {
         CiftiXML m_xml;//because we need to parse it to check the dimensions anyway
@@ -97,6 +164,16 @@ namespace
     
 }
 
+void CiftiFile::ReadImplInterface::getRows(float* dataOut, const vector<int64_t>& rowIndices, const int64_t& rowSize) const
+{
+    vector<int64_t> indexSelect(1);
+    for (int64_t i = 0; i < (int64_t)rowIndices.size(); ++i)
+    {
+        indexSelect[0] = rowIndices[i];
+        getRow(dataOut + i * rowSize, indexSelect, false);
+    }
+}
+
 CiftiFile::ReadImplInterface::~ReadImplInterface()
 {
 }
@@ -105,14 +182,21 @@ CiftiFile::WriteImplInterface::~WriteImplInterface()
 {
 }
 
+void CiftiFile::WriteImplInterface::flush()
+{
+}
+
 CiftiFile::CiftiFile(const QString& fileName)
 {
     m_endianPref = NATIVE;
+    m_haveWritingDataType = false;
+    m_modified = false;
     openFile(fileName);
 }
 
 void CiftiFile::openFile(const QString& fileName)
 {
+    CaretProfileSpan mySpan("CiftiFile::openFile", "io");
     m_writingImpl.grabNew(NULL);
     m_readingImpl.grabNew(NULL);//to make sure it closes everything first, even if the open throws
     m_dims.clear();
@@ -122,6 +206,7 @@ void CiftiFile::openFile(const QString& fileName)
     m_dims = m_xml.getDimensions();
     m_onDiskVersion = m_xml.getParsedVersion();
     m_fileName = fileName;
+    m_modified = false;
 }
 
 void CiftiFile::openURL(const QString& url, const QString& user, const QString& pass)
@@ -134,6 +219,7 @@ void CiftiFile::openURL(const QString& url, const QString& user, const QString&
     m_xml = newRead->getCiftiXML();
     m_dims = m_xml.getDimensions();
     m_fileName = url;
+    m_modified = false;
 }
 
 void CiftiFile::openURL(const QString& url)
@@ -146,6 +232,7 @@ void CiftiFile::openURL(const QString& url)
     m_xml = newRead->getCiftiXML();
     m_dims = m_xml.getDimensions();
     m_fileName = url;
+    m_modified = false;
 }
 
 void CiftiFile::setWritingFile(const QString& fileName, const CiftiVersion& writingVersion, const ENDIAN& endian)
@@ -160,21 +247,33 @@ void CiftiFile::setWritingFile(const QString& fileName, const CiftiVersion& writ
 void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVersion, const ENDIAN& endian)
 {
     if (m_readingImpl == NULL || m_dims.empty()) throw DataFileException("writeFile called on uninitialized CiftiFile");
+    CaretProfileSpan mySpan("CiftiFile::writeFile", "io");
+    if (m_writingImpl != NULL) m_writingImpl->flush();//finish queued on-disk writes, and report any error from them
     bool writeSwapped = shouldSwap(endian);
+    NiftiOutputDataType writeType = getWritingDataType();
     FileInformation myInfo(fileName);
     QString canonicalFilename = myInfo.getCanonicalFilePath();//NOTE: returns EMPTY STRING for nonexistant file
-    const CiftiOnDiskImpl* testImpl = dynamic_cast<CiftiOnDiskImpl*>(m_readingImpl.getPointer());
+    const CiftiOnDiskImpl* testImpl = getOnDiskImpl(m_readingImpl);
     bool collision = false, hadWriter = (m_writingImpl != NULL);
     if (testImpl != NULL && canonicalFilename != "" && FileInformation(testImpl->getFilename()).getCanonicalFilePath() == canonicalFilename)
     {//empty string test is so that we don't say collision if both are nonexistant - could happen if file is removed/unlinked while reading on some filesystems
-        if (m_onDiskVersion == writingVersion && !m_xml.mutablesModified() && (dontRewrite(endian) || writeSwapped == testImpl->isSwapped())) return;//don't need to copy to itself
+        bool typeMatches = (writeType.isFloat32() || writeType.getType() == testImpl->getDataType());//float32 is the historical default, don't rewrite other types to it without changes
+        if (m_onDiskVersion == writingVersion && !m_xml.mutablesModified() && typeMatches && (dontRewrite(endian) || writeSwapped == testImpl->isSwapped())) return;//don't need to copy to itself
         collision = true;//we need to copy to memory temporarily
         CaretPointer<WriteImplInterface> tempMemory(new CiftiMemoryImpl(m_xml));
         copyImplData(m_readingImpl, tempMemory, m_dims);
         m_readingImpl = tempMemory;//we are about to make the old reading impl very unhappy, replace it so that if we get an error while writing, we hang onto the memory version
         m_writingImpl.grabNew(NULL);//and make it re-magic the writing implementation again if data is set
     }
-    CaretPointer<WriteImplInterface> tempWrite(new CiftiOnDiskImpl(myInfo.getAbsoluteFilePath(), m_xml, writingVersion, writeSwapped));
+    if (writeType.needsScan())
+    {
+        scanImplData(m_readingImpl, m_dims, writeType);//first pass finds the range for the scaling, second pass is the copy
+    }
+    if (!writeType.isFloat32())
+    {
+        checkImplData(m_readingImpl, m_dims, writeType);//check everything before creating the file, so a refused datatype doesn't leave a truncated file behind, or clobber the file we are reading from
+    }
+    CaretPointer<WriteImplInterface> tempWrite(new CiftiOnDiskImpl(myInfo.getAbsoluteFilePath(), m_xml, writingVersion, writeSwapped, writeType));
     copyImplData(m_readingImpl, tempWrite, m_dims);
     if (collision)//if we rewrote the file, we need the handle to the new file, and to dump the temporary in-memory version
     {
@@ -188,11 +287,24 @@ void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVe
     m_xml.clearMutablesModified();
 }
 
+void CiftiFile::setWritingDataType(const NiftiOutputDataType& type)
+{
+    m_writingDataType = type;
+    m_haveWritingDataType = true;
+}
+
+NiftiOutputDataType CiftiFile::getWritingDataType() const
+{
+    if (m_haveWritingDataType) return m_writingDataType;
+    return NiftiOutputDataType::getDefault();
+}
+
 void CiftiFile::convertToInMemory()
 {
     if (isInMemory()) return;
     m_writingFile = "";//make sure it doesn't do on-disk when set...() is called
     if (m_readingImpl == NULL) return;//not set up yet
+    CaretProfileSpan mySpan("CiftiFile::convertToInMemory", "io");
     CaretPointer<WriteImplInterface> tempWrite(new CiftiMemoryImpl(m_xml));//if we get an error while reading, free the memory immediately, and don't leave m_readingImpl and m_writingImpl pointing to different things
     copyImplData(m_readingImpl, tempWrite, m_dims);
     m_writingImpl = tempWrite;
@@ -224,6 +336,70 @@ void CiftiFile::getColumn(float* dataOut, const int64_t& index) const
     m_readingImpl->getColumn(dataOut, index);
 }
 
+void CiftiFile::getRows(float* dataOut, const vector<int64_t>& rowIndices) const
+{
+    if (m_dims.empty()) throw DataFileException("getRows called on uninitialized CiftiFile");
+    if (m_dims.size() != 2) throw DataFileException("getRows called on non-2D CiftiFile");
+    int64_t numIndices = (int64_t)rowIndices.size();
+    for (int64_t i = 0; i < numIndices; ++i)
+    {
+        if (rowIndices[i] < 0 || rowIndices[i] >= m_dims[1]) throw DataFileException("getRows called with invalid row index");
+        if (i > 0 && rowIndices[i] <= rowIndices[i - 1]) throw DataFileException("getRows called with unsorted or repeated row indices");
+    }
+    if (m_readingImpl == NULL) return;//NOT an error because we are pretending to have a matrix already, while we are waiting for setRow to actually start writing the file
+    m_readingImpl->getRows(dataOut, rowIndices, m_dims[0]);
+}
+
+bool CiftiFile::sumWeightedRows(const vector<int64_t>& rowIndices, RowSumWeights& weights, vector<vector<double> >& sumsOut) const
+{
+    const int64_t numRows = (int64_t)rowIndices.size();
+    if (numRows == 0) return true;
+    const int64_t rowSize = getNumberOfColumns();
+    const int numSums = (int)sumsOut.size();
+    for (int m = 0; m < numSums; ++m)
+    {
+        if ((int64_t)sumsOut[m].size() != rowSize) throw DataFileException("sumWeightedRows called with a sum of the wrong length");
+    }
+    const int64_t ROW_CHUNK_SIZE = 64;//rows per coalesced read, bounds the scratch memory
+    vector<float> chunkData(min(ROW_CHUNK_SIZE, numRows) * rowSize);
+    vector<int64_t> chunkRows;
+    vector<pair<int64_t, float> > sumRows;//offsets within the chunk of the rows used in the current sum, and their weights
+    for (int64_t start = 0; start < numRows; start += ROW_CHUNK_SIZE)
+    {
+        if (!weights.beforeChunk(start)) return false;
+        const int64_t end = min(start + ROW_CHUNK_SIZE, numRows);
+        chunkRows.assign(rowIndices.begin() + start, rowIndices.begin() + end);
+        getRows(chunkData.data(), chunkRows);
+        for (int m = 0; m < numSums; ++m)
+        {
+            sumRows.clear();
+            for (int64_t i = start; i < end; ++i)
+            {
+                const float weight = weights.getWeight(m, i);
+                if (weight != 0.0f)
+                {
+                    sumRows.push_back(pair<int64_t, float>((i - start) * rowSize, weight));
+                }
+            }
+            if (sumRows.empty()) continue;
+            const int64_t numSumRows = (int64_t)sumRows.size();
+            const float* chunkPointer = chunkData.data();
+            double* sumPointer = sumsOut[m].data();
+#pragma omp CARET_PARFOR schedule(static)
+            for (int64_t j = 0; j < rowSize; ++j)
+            {//each thread owns a range of columns, so the sums need no locking
+                double tempAccum = 0.0;
+                for (int64_t k = 0; k < numSumRows; ++k)
+                {
+                    tempAccum += chunkPointer[sumRows[k].first + j] * sumRows[k].second;
+                }
+                sumPointer[j] += tempAccum;
+            }
+        }
+    }
+    return true;
+}
+
 void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
 {
     m_readingImpl.grabNew(NULL);//drop old implementation, as it is now invalid due to XML (and therefore matrix size) change
@@ -253,6 +429,7 @@ void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
     {
         if (m_dims[i] < 1) throw DataFileException("cifti xml dimensions must be greater than zero");
     }
+    m_modified = true;
 }
 
 void CiftiFile::setCiftiXML(const CiftiXMLOld& xml, const bool useOldMetadata)
@@ -278,6 +455,7 @@ void CiftiFile::setRow(const float* dataIn, const vector<int64_t>& indexSelect)
 {
     verifyWriteImpl();
     m_writingImpl->setRow(dataIn, indexSelect);
+    m_modified = true;
 }
 
 void CiftiFile::setColumn(const float* dataIn, const int64_t& index)
@@ -285,6 +463,7 @@ void CiftiFile::setColumn(const float* dataIn, const int64_t& index)
     verifyWriteImpl();
     if (m_dims.size() != 2) throw DataFileException("setColumn called on non-2D CiftiFile");
     m_writingImpl->setColumn(dataIn, index);
+    m_modified = true;
 }
 
 //compatibility with old interface
@@ -322,6 +501,7 @@ void CiftiFile::setRow(const float* dataIn, const int64_t& index)
     if (m_dims.size() != 2) throw DataFileException("setRow with single index called on non-2D CiftiFile");
     vector<int64_t> tempvec(1, index);//could use a member if we need more speed
     m_writingImpl->setRow(dataIn, tempvec);
+    m_modified = true;
 }
 //*///end old compatibility functions
 
@@ -338,10 +518,18 @@ void CiftiFile::verifyWriteImpl()
         } else {
             m_writingImpl.grabNew(new CiftiMemoryImpl(m_xml));
         }
+    } else if (getWritingDataType().needsScan()) {//the header can't be written until the data range is known, so keep it in memory until writeFile
+        CaretLogFine("output datatype " + getWritingDataType().getName() + " has no range hint, holding '" + m_writingFile + "' in memory until it is written");
+        CaretPointer<WriteImplInterface> tempWrite(new CiftiMemoryImpl(m_xml));
+        if (m_readingImpl != NULL)
+        {
+            copyImplData(m_readingImpl, tempWrite, m_dims);
+        }
+        m_writingImpl = tempWrite;
     } else {//NOTE: m_onDiskVersion gets set in setWritingFile
         if (m_readingImpl != NULL)
         {
-            CiftiOnDiskImpl* testImpl = dynamic_cast<CiftiOnDiskImpl*>(m_readingImpl.getPointer());
+            const CiftiOnDiskImpl* testImpl = getOnDiskImpl(m_readingImpl);
             if (testImpl != NULL)
             {
                 QString canonicalCurrent = FileInformation(testImpl->getFilename()).getCanonicalFilePath();//returns "" if nonexistant, if unlinked while open
@@ -351,7 +539,8 @@ void CiftiFile::verifyWriteImpl()
                 }
             }
         }
-        m_writingImpl.grabNew(new CiftiOnDiskImpl(m_writingFile, m_xml, m_onDiskVersion, shouldSwap(m_endianPref)));//this constructor makes new file for writing
+        CaretPointer<CiftiOnDiskImpl> diskImpl(new CiftiOnDiskImpl(m_writingFile, m_xml, m_onDiskVersion, shouldSwap(m_endianPref), getWritingDataType()));//this constructor makes new file for writing
+        m_writingImpl.grabNew(new CiftiWriteBehindImpl(diskImpl));//so that the compute thread doesn't wait on every row write
         if (m_readingImpl != NULL)
         {
             copyImplData(m_readingImpl, m_writingImpl, m_dims);
@@ -371,6 +560,28 @@ void CiftiFile::copyImplData(const ReadImplInterface* from, WriteImplInterface*
     }
 }
 
+void CiftiFile::scanImplData(const ReadImplInterface* from, const vector<int64_t>& dims, NiftiOutputDataType& typeOut)
+{
+    vector<int64_t> iterateDims(dims.begin() + 1, dims.end());
+    vector<float> scratchRow(dims[0]);
+    for (MultiDimIterator<int64_t> iter(iterateDims); !iter.atEnd(); ++iter)
+    {
+        from->getRow(scratchRow.data(), *iter, false);
+        typeOut.scanData(scratchRow.data(), dims[0]);
+    }
+}
+
+void CiftiFile::checkImplData(const ReadImplInterface* from, const vector<int64_t>& dims, const NiftiOutputDataType& type)
+{
+    vector<int64_t> iterateDims(dims.begin() + 1, dims.end());
+    vector<float> scratchRow(dims[0]);
+    for (MultiDimIterator<int64_t> iter(iterateDims); !iter.atEnd(); ++iter)
+    {
+        from->getRow(scratchRow.data(), *iter, false);
+        type.checkData(scratchRow.data(), dims[0]);
+    }
+}
+
 CiftiMemoryImpl::CiftiMemoryImpl(const CiftiXML& xml)
 {
     CaretAssert(xml.getNumberOfDimensions() != 0);
@@ -481,10 +692,11 @@ CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename)
     }
 }
 
-CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian)
+CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian, const NiftiOutputDataType& dataType)
 {//starts writing new file
     NiftiHeader outHeader;
-    outHeader.setDataType(NIFTI_TYPE_FLOAT32);//actually redundant currently, default is float32
+    dataType.configureHeader(outHeader);
+    m_dataType = dataType;
     char intentName[16];
     int32_t intentCode = xml.getIntentInfo(version, intentName);
     outHeader.setIntent(intentCode, intentName);
@@ -538,8 +750,38 @@ void CiftiOnDiskImpl::getColumn(float* dataOut, const int64_t& index) const
     }
 }
 
+void CiftiOnDiskImpl::getRows(float* dataOut, const vector<int64_t>& rowIndices, const int64_t& rowSize) const
+{
+    const int64_t MAX_RUN_BYTES = 64 * 1024 * 1024;//limit the scratch memory NiftiIO needs for one read
+    const int64_t maxRunRows = max((int64_t)1, MAX_RUN_BYTES / (rowSize * (int64_t)sizeof(float)));
+    int64_t numIndices = (int64_t)rowIndices.size(), runStart = 0;
+    vector<int64_t> indexSelect(1);
+    while (runStart < numIndices)
+    {//merge runs of adjacent rows into one seek and read
+        int64_t runEnd = runStart + 1;
+        while (runEnd < numIndices && runEnd - runStart < maxRunRows && rowIndices[runEnd] == rowIndices[runEnd - 1] + 1) ++runEnd;
+        indexSelect[0] = rowIndices[runStart];
+        m_nifti.readDataSlabs(dataOut + runStart * rowSize, 5, indexSelect, runEnd - runStart);//5 means 4 reserved (space and time) plus the first cifti dimension
+        runStart = runEnd;
+    }
+}
+
+void CiftiOnDiskImpl::checkData(const float* dataIn, const int64_t& count)
+{//when writing as we go, the data isn't known before the header is written
+    try
+    {
+        m_dataType.checkData(dataIn, count);
+    } catch (DataFileException&) {
+        QString filename = m_nifti.getFilename();
+        m_nifti.close();
+        QFile::remove(filename);//don't leave a truncated file with a valid header behind
+        throw;
+    }
+}
+
 void CiftiOnDiskImpl::setRow(const float* dataIn, const vector<int64_t>& indexSelect)
 {
+    checkData(dataIn, m_xml.getDimensionLength(CiftiXML::ALONG_ROW));
     m_nifti.writeData(dataIn, 5, indexSelect);
 }
 
@@ -551,6 +793,7 @@ void CiftiOnDiskImpl::setColumn(const float* dataIn, const int64_t& index)
     vector<int64_t> indexSelect(2);
     indexSelect[0] = index;
     int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    checkData(dataIn, colLength);
     for (int64_t i = 0; i < colLength; ++i)//don't do RMW, so write it 1 element at a time
     {
         indexSelect[1] = i;
@@ -558,6 +801,171 @@ void CiftiOnDiskImpl::setColumn(const float* dataIn, const int64_t& index)
     }
 }
 
+void CiftiWriteBehindThread::run()
+{
+    m_impl->writerLoop();
+}
+
+CiftiWriteBehindImpl::CiftiWriteBehindImpl(const CaretPointer<CiftiOnDiskImpl>& disk) : m_thread(this)
+{
+    const int64_t MAX_QUEUE_BYTES = 64 * 1024 * 1024;//same order as the read scratch limit in getRows
+    m_disk = disk;
+    m_rowSize = m_disk->getCiftiXML().getDimensionLength(CiftiXML::ALONG_ROW);
+    m_maxQueuedRows = max((int64_t)2, MAX_QUEUE_BYTES / (m_rowSize * (int64_t)sizeof(float)));
+    m_haveInFlight = false;
+    m_stopping = false;
+    m_errorReported = false;
+    m_thread.start();
+}
+
+CiftiWriteBehindImpl::~CiftiWriteBehindImpl()
+{
+    {
+        QMutexLocker locker(&m_queueMutex);
+        m_stopping = true;
+        m_queueChanged.wakeAll();
+    }
+    m_thread.wait();//the writer drains the queue before it exits
+    if (m_error != "" && !m_errorReported)
+    {
+        CaretLogWarning("error writing cifti file '" + m_disk->getFilename() + "': " + m_error);//can't throw from a destructor
+    }
+}
+
+void CiftiWriteBehindImpl::writerLoop()
+{
+    QMutexLocker locker(&m_queueMutex);
+    while (true)
+    {
+        while (m_queue.empty() && !m_stopping) m_queueChanged.wait(&m_queueMutex);
+        if (m_queue.empty()) return;//only when stopping and everything is written
+        map<vector<int64_t>, vector<float> >::iterator iter = m_queue.lower_bound(m_lastWritten);//continue forward through the file before seeking back
+        if (iter == m_queue.end()) iter = m_queue.begin();
+        m_inFlightIndex = iter->first;
+        m_inFlightRow.swap(iter->second);
+        m_queue.erase(iter);
+        m_haveInFlight = true;
+        locker.unlock();
+        AString error;
+        try
+        {
+            QMutexLocker diskLocker(&m_diskMutex);
+            m_disk->setRow(m_inFlightRow.data(), m_inFlightIndex);
+        } catch (CaretException& e) {
+            error = e.whatString();
+            if (error == "") error = "unknown error";
+        } catch (std::exception& e) {
+            error = e.what();
+            if (error == "") error = "unknown error";
+        } catch (...) {
+            error = "unknown error";
+        }
+        locker.relock();
+        m_haveInFlight = false;
+        m_lastWritten = m_inFlightIndex;
+        if (error != "")
+        {
+            m_error = error;
+            m_queue.clear();//nothing more will be written, wake anyone waiting so they see the error
+            m_queueChanged.wakeAll();
+            return;
+        }
+        m_queueChanged.wakeAll();
+    }
+}
+
+void CiftiWriteBehindImpl::checkError() const
+{
+    if (m_error != "")
+    {
+        m_errorReported = true;
+        throw DataFileException(m_disk->getFilename(), m_error);
+    }
+}
+
+void CiftiWriteBehindImpl::flushLocked() const
+{
+    while ((!m_queue.empty() || m_haveInFlight) && m_error == "") m_queueChanged.wait(&m_queueMutex);
+    checkError();
+}
+
+void CiftiWriteBehindImpl::flush()
+{
+    QMutexLocker locker(&m_queueMutex);
+    flushLocked();
+}
+
+void CiftiWriteBehindImpl::getRow(float* dataOut, const vector<int64_t>& indexSelect, const bool& tolerateShortRead) const
+{
+    {
+        QMutexLocker locker(&m_queueMutex);
+        checkError();
+        const vector<float>* queuedRow = NULL;
+        map<vector<int64_t>, vector<float> >::const_iterator iter = m_queue.find(indexSelect);
+        if (iter != m_queue.end())
+        {
+            queuedRow = &(iter->second);
+        } else if (m_haveInFlight && m_inFlightIndex == indexSelect) {
+            queuedRow = &m_inFlightRow;//the writer only reads this while it is in flight
+        }
+        if (queuedRow != NULL)
+        {
+            copy(queuedRow->begin(), queuedRow->end(), dataOut);
+            return;
+        }
+        flushLocked();//make the file look the same as with synchronous writes, for rows that haven't been written
+    }
+    QMutexLocker diskLocker(&m_diskMutex);
+    m_disk->getRow(dataOut, indexSelect, tolerateShortRead);
+}
+
+void CiftiWriteBehindImpl::getColumn(float* dataOut, const int64_t& index) const
+{
+    {
+        QMutexLocker locker(&m_queueMutex);
+        flushLocked();
+    }
+    QMutexLocker diskLocker(&m_diskMutex);
+    m_disk->getColumn(dataOut, index);
+}
+
+void CiftiWriteBehindImpl::getRows(float* dataOut, const vector<int64_t>& rowIndices, const int64_t& rowSize) const
+{
+    {
+        QMutexLocker locker(&m_queueMutex);
+        flushLocked();
+    }
+    QMutexLocker diskLocker(&m_diskMutex);
+    m_disk->getRows(dataOut, rowIndices, rowSize);
+}
+
+void CiftiWriteBehindImpl::setRow(const float* dataIn, const vector<int64_t>& indexSelect)
+{
+    QMutexLocker locker(&m_queueMutex);
+    checkError();
+    map<vector<int64_t>, vector<float> >::iterator iter = m_queue.find(indexSelect);
+    if (iter != m_queue.end())
+    {//rewrite of a row that is still queued, replace it in place
+        copy(dataIn, dataIn + m_rowSize, iter->second.begin());
+        return;
+    }
+    while ((int64_t)m_queue.size() >= m_maxQueuedRows && m_error == "") m_queueChanged.wait(&m_queueMutex);
+    checkError();
+    vector<float>& newRow = m_queue[indexSelect];
+    newRow.assign(dataIn, dataIn + m_rowSize);
+    m_queueChanged.wakeAll();
+}
+
+void CiftiWriteBehindImpl::setColumn(const float* dataIn, const int64_t& index)
+{
+    {
+        QMutexLocker locker(&m_queueMutex);
+        flushLocked();
+    }
+    QMutexLocker diskLocker(&m_diskMutex);
+    m_disk->setColumn(dataIn, index);
+}
+
 CiftiXnatImpl::CiftiXnatImpl(const QString& url, const QString& user, const QString& pass)
 {
     CaretHttpManager::setAuthentication(url, user, pass);
@@ -25,6 +25,7 @@
 #include "CiftiInterface.h"
 #include "CiftiXML.h"
 #include "CiftiXMLOld.h"
+#include "NiftiOutputDataType.h"
 
 #include <QString>
 
@@ -44,7 +45,7 @@ namespace caret
             BIG
         };
 
-        CiftiFile() { m_endianPref = NATIVE; }
+        CiftiFile() { m_endianPref = NATIVE; m_haveWritingDataType = false; m_modified = false; }
         explicit CiftiFile(const QString &fileName);//calls openFile
         void openFile(const QString& fileName);//starts on-disk reading
         void openURL(const QString& url, const QString& user, const QString& pass);//open from XNAT
@@ -52,12 +53,33 @@ namespace caret
         void setWritingFile(const QString& fileName, const CiftiVersion& writingVersion = CiftiVersion(), const ENDIAN& endian = NATIVE);//starts on-disk writing
         void writeFile(const QString& fileName, const CiftiVersion& writingVersion = CiftiVersion(), const ENDIAN& endian = ANY);//leaves current state as-is, rewrites if already writing to that filename and version mismatch
         void convertToInMemory();
+        //datatype for writeFile and on-disk writing, call before setWritingFile to affect on-disk writing, defaults to NiftiOutputDataType::getDefault()
+        //a SCALED type without a range hint needs a pass over the data first, so on-disk writing then holds the data in memory until writeFile
+        void setWritingDataType(const NiftiOutputDataType& type);
         QString getFileName() const { return m_fileName; }
         
         bool isInMemory() const;
+        //true after setCiftiXML, setRow or setColumn since the last open or clearModified
+        bool isModified() const { return m_modified; }
+        void clearModified() { m_modified = false; }
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead = false) const;//tolerateShortRead is useful for on-disk writing when it is easiest to do RMW multiple times on a new file
         const std::vector<int64_t>& getDimensions() const { return m_dims; }
         void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk!
+        void getRows(float* dataOut, const std::vector<int64_t>& rowIndices) const;//for 2D only, rowIndices must be sorted and unique, rows are output consecutively, adjacent rows on disk are read together
+        
+        ///per-row weights for sumWeightedRows, and a hook between chunks
+        class RowSumWeights
+        {
+        public:
+            ///weight of rowIndices[rowPosition] in sum sumIndex, zero skips the row
+            virtual float getWeight(const int& sumIndex, const int64_t& rowPosition) const = 0;
+            ///called before each chunk is read with the number of rows already summed, return false to stop early
+            virtual bool beforeChunk(const int64_t&) { return true; }
+            virtual ~RowSumWeights() { }
+        };
+        //for 2D only, adds weighted rows into each of sumsOut (sized to the row length), reading sorted, unique rowIndices through getRows in bounded chunks
+        //returns false if beforeChunk stopped it
+        bool sumWeightedRows(const std::vector<int64_t>& rowIndices, RowSumWeights& weights, std::vector<std::vector<double> >& sumsOut) const;
         
         void setCiftiXML(const CiftiXML& xml, const bool useOldMetadata = true);
         void setCiftiXML(const CiftiXMLOld &xml, const bool useOldMetadata = true);//set xml from old implementation
@@ -76,6 +98,7 @@ namespace caret
         public:
             virtual void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const = 0;
             virtual void getColumn(float* dataOut, const int64_t& index) const = 0;
+            virtual void getRows(float* dataOut, const std::vector<int64_t>& rowIndices, const int64_t& rowSize) const;//default calls getRow for each index
             virtual bool isInMemory() const { return false; }
             virtual ~ReadImplInterface();
         };
@@ -85,6 +108,7 @@ namespace caret
         public:
             virtual void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect) = 0;
             virtual void setColumn(const float* dataIn, const int64_t& index) = 0;
+            virtual void flush();//for implementations that write asynchronously, default does nothing
             virtual ~WriteImplInterface();
         };
     private:
@@ -95,9 +119,15 @@ namespace caret
         //CiftiXML m_xml;//uncomment when we drop CiftiInterface
         CiftiVersion m_onDiskVersion;
         ENDIAN m_endianPref;
+        NiftiOutputDataType m_writingDataType;
+        bool m_haveWritingDataType;
+        bool m_modified;
         
+        NiftiOutputDataType getWritingDataType() const;
         void verifyWriteImpl();
         static void copyImplData(const ReadImplInterface* from, WriteImplInterface* to, const std::vector<int64_t>& dims);
+        static void scanImplData(const ReadImplInterface* from, const std::vector<int64_t>& dims, NiftiOutputDataType& typeOut);
+        static void checkImplData(const ReadImplInterface* from, const std::vector<int64_t>& dims, const NiftiOutputDataType& type);
     };
     
 }
@@ -0,0 +1,276 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "CommandFileCache.h"
+
+#include "BorderFile.h"
+#include "CaretLogger.h"
+#include "CiftiFile.h"
+#include "CommandException.h"
+#include "FociFile.h"
+#include "LabelFile.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QFileInfo>
+
+using namespace caret;
+using namespace std;
+
+bool CommandFileCache::isMemoryName(const AString& fileName)
+{
+    return fileName.startsWith("@");
+}
+
+template <typename T>
+bool CommandFileCache::getFileTemplate(map<AString, CaretPointer<T> >& fileMap, const AString& fileName, const AString& typeName, CaretPointer<T>& fileOut)
+{
+    if (isMemoryName(fileName))
+    {
+        typename map<AString, CaretPointer<T> >::iterator iter = fileMap.find(fileName);
+        if (iter == fileMap.end())
+        {
+            throw CommandException("in-memory file '" + fileName + "' was not output as a " + typeName + " file by an earlier command in the batch");
+        }
+        m_commandMemoryReads.insert(fileName);
+        fileOut = iter->second;
+        return true;
+    }
+    const QFileInfo fileInfo(fileName);
+    const AString key = fileInfo.canonicalFilePath();
+    if (key.isEmpty()) return false;
+    m_commandInputKeys.insert(key);
+    typename map<AString, CaretPointer<T> >::iterator iter = fileMap.find(key);
+    if (iter == fileMap.end()) return false;
+    map<AString, DiskStamp>::const_iterator stampIter = m_diskStamps.find(key);
+    if (stampIter == m_diskStamps.end() || stampIter->second.m_size != fileInfo.size() || stampIter->second.m_lastModified != fileInfo.lastModified())
+    {//changed by something outside the batch's control
+        removeKey(key);
+        return false;
+    }
+    fileOut = iter->second;
+    CaretLogFine("reusing already read file '" + fileName + "'");
+    return true;
+}
+
+template <typename T>
+void CommandFileCache::addFileTemplate(map<AString, CaretPointer<T> >& fileMap, const AString& fileName, const CaretPointer<T>& file)
+{
+    if (isMemoryName(fileName))
+    {
+        removeKey(fileName);
+        fileMap[fileName] = file;
+        file->clearModified();//so that endCommand of a later command can tell if it was changed in place
+        m_commandMemoryReads.erase(fileName);//replacing it is fine, whatever this command read from it
+        return;
+    }
+    const QFileInfo fileInfo(fileName);
+    const AString key = fileInfo.canonicalFilePath();
+    if (key.isEmpty()) return;
+    removeKey(key);
+    fileMap[key] = file;
+    DiskStamp& stamp = m_diskStamps[key];
+    stamp.m_size = fileInfo.size();
+    stamp.m_lastModified = fileInfo.lastModified();
+    m_commandInputKeys.insert(key);
+}
+
+bool CommandFileCache::getFile(const AString& fileName, CaretPointer<BorderFile>& fileOut)
+{
+    return getFileTemplate(m_borderFiles, fileName, "border", fileOut);
+}
+
+bool CommandFileCache::getFile(const AString& fileName, CaretPointer<CiftiFile>& fileOut)
+{
+    return getFileTemplate(m_ciftiFiles, fileName, "cifti", fileOut);
+}
+
+bool CommandFileCache::getFile(const AString& fileName, CaretPointer<FociFile>& fileOut)
+{
+    return getFileTemplate(m_fociFiles, fileName, "foci", fileOut);
+}
+
+bool CommandFileCache::getFile(const AString& fileName, CaretPointer<LabelFile>& fileOut)
+{
+    return getFileTemplate(m_labelFiles, fileName, "label", fileOut);
+}
+
+bool CommandFileCache::getFile(const AString& fileName, CaretPointer<MetricFile>& fileOut)
+{
+    return getFileTemplate(m_metricFiles, fileName, "metric", fileOut);
+}
+
+bool CommandFileCache::getFile(const AString& fileName, CaretPointer<SurfaceFile>& fileOut)
+{
+    return getFileTemplate(m_surfaceFiles, fileName, "surface", fileOut);
+}
+
+bool CommandFileCache::getFile(const AString& fileName, CaretPointer<VolumeFile>& fileOut)
+{
+    return getFileTemplate(m_volumeFiles, fileName, "volume", fileOut);
+}
+
+void CommandFileCache::addFile(const AString& fileName, const CaretPointer<BorderFile>& file)
+{
+    addFileTemplate(m_borderFiles, fileName, file);
+}
+
+void CommandFileCache::addFile(const AString& fileName, const CaretPointer<CiftiFile>& file)
+{
+    addFileTemplate(m_ciftiFiles, fileName, file);
+}
+
+void CommandFileCache::addFile(const AString& fileName, const CaretPointer<FociFile>& file)
+{
+    addFileTemplate(m_fociFiles, fileName, file);
+}
+
+void CommandFileCache::addFile(const AString& fileName, const CaretPointer<LabelFile>& file)
+{
+    addFileTemplate(m_labelFiles, fileName, file);
+}
+
+void CommandFileCache::addFile(const AString& fileName, const CaretPointer<MetricFile>& file)
+{
+    addFileTemplate(m_metricFiles, fileName, file);
+}
+
+void CommandFileCache::addFile(const AString& fileName, const CaretPointer<SurfaceFile>& file)
+{
+    addFileTemplate(m_surfaceFiles, fileName, file);
+}
+
+void CommandFileCache::addFile(const AString& fileName, const CaretPointer<VolumeFile>& file)
+{
+    addFileTemplate(m_volumeFiles, fileName, file);
+}
+
+void CommandFileCache::removeKey(const AString& key)
+{
+    m_borderFiles.erase(key);
+    m_ciftiFiles.erase(key);
+    m_fociFiles.erase(key);
+    m_labelFiles.erase(key);
+    m_metricFiles.erase(key);
+    m_surfaceFiles.erase(key);
+    m_volumeFiles.erase(key);
+    m_diskStamps.erase(key);
+}
+
+void CommandFileCache::removeFile(const AString& fileName)
+{
+    if (isMemoryName(fileName))
+    {
+        removeKey(fileName);
+        return;
+    }
+    if (m_diskStamps.empty()) return;//avoid filesystem queries when nothing from disk is cached
+    const AString key = QFileInfo(fileName).canonicalFilePath();
+    if (!key.isEmpty()) removeKey(key);
+}
+
+namespace
+{
+    template <typename T>
+    bool isModifiedTemplate(const map<AString, CaretPointer<T> >& fileMap, const AString& key, bool& foundOut)
+    {
+        typename map<AString, CaretPointer<T> >::const_iterator iter = fileMap.find(key);
+        if (iter == fileMap.end()) return false;
+        foundOut = true;
+        return iter->second->isModified();
+    }
+}
+
+bool CommandFileCache::isModified(const AString& key) const
+{
+    bool found = false;
+    bool ret = isModifiedTemplate(m_borderFiles, key, found);
+    if (!found) ret = isModifiedTemplate(m_ciftiFiles, key, found);
+    if (!found) ret = isModifiedTemplate(m_fociFiles, key, found);
+    if (!found) ret = isModifiedTemplate(m_labelFiles, key, found);
+    if (!found) ret = isModifiedTemplate(m_metricFiles, key, found);
+    if (!found) ret = isModifiedTemplate(m_surfaceFiles, key, found);
+    if (!found) ret = isModifiedTemplate(m_volumeFiles, key, found);
+    return ret;
+}
+
+void CommandFileCache::beginCommand()
+{
+    m_commandInputKeys.clear();
+    m_commandMemoryReads.clear();
+}
+
+void CommandFileCache::endCommand(const vector<AString>& arguments)
+{
+    for (set<AString>::const_iterator iter = m_commandMemoryReads.begin(); iter != m_commandMemoryReads.end(); ++iter)
+    {//later commands would silently see the change, so in-memory inputs are read-only
+        if (isModified(*iter))
+        {
+            const AString name = *iter;
+            removeKey(name);
+            m_commandMemoryReads.clear();
+            m_commandInputKeys.clear();
+            throw CommandException("in-memory file '" + name + "' was modified in place by this command, in-memory inputs are read-only, give the output a new name");
+        }
+    }
+    m_commandMemoryReads.clear();
+    if (m_diskStamps.empty())
+    {
+        m_commandInputKeys.clear();
+        return;
+    }
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {//a file argument that wasn't read as an input may have been written, whether as an output or by a command that edits files by name
+        if (isMemoryName(arguments[i])) continue;
+        const AString key = QFileInfo(arguments[i]).canonicalFilePath();
+        if (!key.isEmpty() && m_commandInputKeys.find(key) == m_commandInputKeys.end())
+        {
+            removeKey(key);
+        }
+    }
+    vector<AString> modifiedKeys;
+    for (map<AString, DiskStamp>::const_iterator iter = m_diskStamps.begin(); iter != m_diskStamps.end(); ++iter)
+    {//an input that a command changed in memory would no longer match the file
+        if (isModified(iter->first))
+        {
+            modifiedKeys.push_back(iter->first);
+        }
+    }
+    for (size_t i = 0; i < modifiedKeys.size(); ++i)
+    {
+        removeKey(modifiedKeys[i]);
+    }
+    m_commandInputKeys.clear();
+}
+
+void CommandFileCache::clear()
+{
+    m_borderFiles.clear();
+    m_ciftiFiles.clear();
+    m_fociFiles.clear();
+    m_labelFiles.clear();
+    m_metricFiles.clear();
+    m_surfaceFiles.clear();
+    m_volumeFiles.clear();
+    m_diskStamps.clear();
+    m_commandInputKeys.clear();
+    m_commandMemoryReads.clear();
+}
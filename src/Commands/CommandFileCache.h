@@ -0,0 +1,100 @@
+#ifndef __COMMAND_FILE_CACHE_H__
+#define __COMMAND_FILE_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+#include "CaretPointer.h"
+
+#include <QDateTime>
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+namespace caret {
+
+    class BorderFile;
+    class CiftiFile;
+    class FociFile;
+    class LabelFile;
+    class MetricFile;
+    class SurfaceFile;
+    class VolumeFile;
+    
+    ///files shared between the commands of a batch script, in-memory outputs are named with a leading '@', files read from disk are keyed by canonical path
+    ///in-memory files are read-only inputs: a command that modifies one in place fails in endCommand
+    class CommandFileCache
+    {
+        struct DiskStamp
+        {
+            int64_t m_size;
+            QDateTime m_lastModified;
+        };
+        std::map<AString, CaretPointer<BorderFile> > m_borderFiles;
+        std::map<AString, CaretPointer<CiftiFile> > m_ciftiFiles;
+        std::map<AString, CaretPointer<FociFile> > m_fociFiles;
+        std::map<AString, CaretPointer<LabelFile> > m_labelFiles;
+        std::map<AString, CaretPointer<MetricFile> > m_metricFiles;
+        std::map<AString, CaretPointer<SurfaceFile> > m_surfaceFiles;
+        std::map<AString, CaretPointer<VolumeFile> > m_volumeFiles;
+        std::map<AString, DiskStamp> m_diskStamps;
+        std::set<AString> m_commandInputKeys;
+        std::set<AString> m_commandMemoryReads;
+        template <typename T>
+        bool getFileTemplate(std::map<AString, CaretPointer<T> >& fileMap, const AString& fileName, const AString& typeName, CaretPointer<T>& fileOut);
+        template <typename T>
+        void addFileTemplate(std::map<AString, CaretPointer<T> >& fileMap, const AString& fileName, const CaretPointer<T>& file);
+        void removeKey(const AString& key);
+        bool isModified(const AString& key) const;
+        CommandFileCache(const CommandFileCache&);
+        CommandFileCache& operator=(const CommandFileCache&);
+    public:
+        CommandFileCache() { }
+        static bool isMemoryName(const AString& fileName);
+        ///returns false when the file should be read from disk, throws if an in-memory name doesn't exist
+        bool getFile(const AString& fileName, CaretPointer<BorderFile>& fileOut);
+        bool getFile(const AString& fileName, CaretPointer<CiftiFile>& fileOut);
+        bool getFile(const AString& fileName, CaretPointer<FociFile>& fileOut);
+        bool getFile(const AString& fileName, CaretPointer<LabelFile>& fileOut);
+        bool getFile(const AString& fileName, CaretPointer<MetricFile>& fileOut);
+        bool getFile(const AString& fileName, CaretPointer<SurfaceFile>& fileOut);
+        bool getFile(const AString& fileName, CaretPointer<VolumeFile>& fileOut);
+        ///an input just read from disk, or an output with an in-memory name
+        void addFile(const AString& fileName, const CaretPointer<BorderFile>& file);
+        void addFile(const AString& fileName, const CaretPointer<CiftiFile>& file);
+        void addFile(const AString& fileName, const CaretPointer<FociFile>& file);
+        void addFile(const AString& fileName, const CaretPointer<LabelFile>& file);
+        void addFile(const AString& fileName, const CaretPointer<MetricFile>& file);
+        void addFile(const AString& fileName, const CaretPointer<SurfaceFile>& file);
+        void addFile(const AString& fileName, const CaretPointer<VolumeFile>& file);
+        void removeFile(const AString& fileName);
+        void beginCommand();
+        ///drops disk files that the command may have changed: arguments it didn't read as inputs, and inputs it modified in memory
+        ///throws if the command modified an in-memory input in place
+        void endCommand(const std::vector<AString>& arguments);
+        void clear();
+    };
+
+}
+
+#endif //__COMMAND_FILE_CACHE_H__
@@ -72,6 +72,17 @@ bool CommandOperation::takesParameters()
     return true;
 }
 
+/**
+ * Share input files and in-memory outputs with other commands run in the
+ * same process, ignored by commands that don't read or write data files.
+ *
+ * @param fileCache
+ *   Cache to use, or NULL to read and write all files.
+ */
+void CommandOperation::setFileCache(CommandFileCache* /*fileCache*/)
+{
+}
+
 /**
  * Get the short description of the operation.
  */
@@ -29,6 +29,7 @@
 
 namespace caret {
 
+    class CommandFileCache;
     class ProgramParameters;
     
     /// Abstract class for a command operation.
@@ -74,6 +75,8 @@ namespace caret {
         
         virtual bool takesParameters();
         
+        virtual void setFileCache(CommandFileCache* fileCache);
+        
     private:
         /** Short description listing commands purpose */
         AString operationShortDescription;
@@ -24,6 +24,7 @@
 #include "CommandOperationManager.h"
 #undef __COMMAND_OPERATION_MANAGER_DEFINE__
 
+#include "AlgorithmBorderOptimize.h"
 #include "AlgorithmBorderResample.h"
 #include "AlgorithmBorderToVertices.h"
 #include "AlgorithmCiftiAllLabelsToROIs.h"
@@ -135,6 +136,7 @@
 #include "OperationAddToSpecFile.h"
 #include "OperationBackendAverageDenseROI.h"
 #include "OperationBackendAverageROICorrelation.h"
+#include "OperationBackendServer.h"
 #include "OperationBorderExportColorTable.h"
 #include "OperationBorderFileExportToCaret5.h"
 #include "OperationBorderLength.h"
@@ -223,6 +225,7 @@
 #include "AlgorithmException.h"
 #include "ApplicationInformation.h"
 #include "CommandParser.h"
+#include "NiftiOutputDataType.h"
 #include "OperationException.h"
 
 #include "CommandClassAddMember.h"
@@ -234,14 +237,40 @@
 #include "CommandUnitTest.h"
 #include "ProgramParameters.h"
 
+#include "CaretCommandLine.h"
 #include "CaretLogger.h"
+#include "CaretProfiler.h"
+#include "CommandFileCache.h"
+#include "GiftiFile.h"
 #include "StructureEnum.h"
 
+#include <QFile>
+#include <QTextStream>
+
 #include <iostream>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    //writes the profile when runCommand exits, including by exception
+    struct ProfileOutput
+    {
+        AString m_traceFileName;
+        ~ProfileOutput()
+        {
+            if (m_traceFileName.isEmpty()) return;
+            CaretProfiler::setEnabled(false);
+            cerr << CaretProfiler::getSummary();
+            if (!CaretProfiler::writeTrace(m_traceFileName))
+            {
+                cerr << "failed to write profile trace file '" << m_traceFileName << "'" << endl;
+            }
+        }
+    };
+}
+
 /**
  * Get the command operation manager.
  *
@@ -275,6 +304,7 @@ CommandOperationManager::deleteCommandOperationManager()
  */
 CommandOperationManager::CommandOperationManager()
 {
+    this->commandOperations.push_back(new CommandParser(new AutoAlgorithmBorderOptimize()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmBorderResample()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmBorderToVertices()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiAllLabelsToROIs()));
@@ -387,6 +417,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationAddToSpecFile()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationBackendAverageDenseROI()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationBackendAverageROICorrelation()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationBackendServer()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationBorderExportColorTable()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationBorderFileExportToCaret5()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationBorderLength()));
@@ -524,9 +555,33 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         if (!valid) throw CommandException("unrecognized logging level: '" + globalOptionArgs[0] + "'");
         CaretLogger::getLogger()->setLevel(level);
     }
+    NiftiOutputDataType outputType;
+    if (getGlobalOption(parameters, "-output-datatype", 1, globalOptionArgs))
+    {
+        bool valid = false;
+        outputType = NiftiOutputDataType::fromName(globalOptionArgs[0], &valid);
+        if (!valid) throw CommandException("unrecognized output datatype: '" + globalOptionArgs[0] + "', valid values are " + NiftiOutputDataType::getValidNames());
+    }
+    if (getGlobalOption(parameters, "-output-datatype-range", 2, globalOptionArgs))
+    {
+        if (outputType.getMode() != NiftiOutputDataType::SCALED) throw CommandException("-output-datatype-range requires a _SCALED type to be given with -output-datatype");
+        bool ok1 = false, ok2 = false;
+        double minVal = globalOptionArgs[0].toDouble(&ok1), maxVal = globalOptionArgs[1].toDouble(&ok2);
+        if (!ok1 || !ok2) throw CommandException("non-numeric argument to -output-datatype-range");
+        outputType.setRange(minVal, maxVal);
+    }
+    NiftiOutputDataType::setDefault(outputType);
+    ProfileOutput myProfileOutput;
+    if (getGlobalOption(parameters, "-profile", 1, globalOptionArgs))
+    {
+        myProfileOutput.m_traceFileName = globalOptionArgs[0];
+        CaretProfiler::setEnabled(true);
+    }
+    if (getGlobalOption(parameters, "-gifti-external-binary", 0, globalOptionArgs))
+    {
+        GiftiFile::setDefaultEncodingForWriting(GiftiEncodingEnum::EXTERNAL_FILE_BINARY);
+    }
 
-    const uint64_t numberOfCommands = this->commandOperations.size();
-    const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
 
     if (parameters.hasNext() == false) {
         printHelpInfo();
@@ -553,29 +608,11 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         printDeprecatedCommands();
     } else if (commandSwitch == "-all-commands-help") {
         printAllCommandsHelpInfo("wb_command");
+    } else if (commandSwitch == "-batch") {
+        runBatch(parameters, preventProvenance);
     } else {
         
-        CommandOperation* operation = NULL;
-        
-        for (uint64_t i = 0; i < numberOfCommands; i++)
-        {
-            if (this->commandOperations[i]->getCommandLineSwitch() == commandSwitch)
-            {
-                operation = this->commandOperations[i];
-                break;
-            }
-        }
-        if (operation == NULL)
-        {
-            for (uint64_t i = 0; i < numberOfDeprecated; i++)
-            {
-                if (this->deprecatedOperations[i]->getCommandLineSwitch() == commandSwitch)
-                {
-                    operation = this->deprecatedOperations[i];
-                    break;
-                }
-            }
-        }
+        CommandOperation* operation = findOperation(commandSwitch);
         
         if (operation == NULL) {
             if (!parameters.hasNext())
@@ -589,12 +626,222 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
             {
                 cout << operation->getHelpInformation("wb_command") << endl;
             } else {
+                CaretProfileSpan mySpan(commandSwitch, "command");
                 operation->execute(parameters, preventProvenance);
             }
         }
     }
 }
 
+CommandOperation* CommandOperationManager::findOperation(const AString& commandSwitch)
+{
+    const uint64_t numberOfCommands = this->commandOperations.size();
+    for (uint64_t i = 0; i < numberOfCommands; i++)
+    {
+        if (this->commandOperations[i]->getCommandLineSwitch() == commandSwitch)
+        {
+            return this->commandOperations[i];
+        }
+    }
+    const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
+    for (uint64_t i = 0; i < numberOfDeprecated; i++)
+    {
+        if (this->deprecatedOperations[i]->getCommandLineSwitch() == commandSwitch)
+        {
+            return this->deprecatedOperations[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Split a batch script into commands: one command per line with shell-style
+ * quoting, backslash-newline continues a line, and # starts a comment.
+ *
+ * @param text
+ *    Contents of the script.
+ * @param scriptName
+ *    Name of the script, for error messages.
+ * @param commandsOut
+ *    The commands with their arguments and the line each starts on.
+ * @throws CommandException
+ *    If a quote is unterminated.
+ */
+void CommandOperationManager::parseBatchScript(const QString& text, const AString& scriptName, vector<BatchCommand>& commandsOut)
+{
+    commandsOut.clear();
+    BatchCommand current;
+    current.m_lineNumber = 1;
+    int lineNumber = 1;
+    QString token;
+    bool inToken = false;
+    const int length = text.size();
+    int i = 0;
+    while (i <= length)
+    {
+        const QChar c = (i < length ? text[i] : QChar('\n'));
+        if (c.isSpace())
+        {
+            if (inToken)
+            {
+                if (current.m_arguments.empty()) current.m_lineNumber = lineNumber;
+                current.m_arguments.push_back(token);
+                token = "";
+                inToken = false;
+            }
+            if (c == '\n')
+            {
+                if (!current.m_arguments.empty()) commandsOut.push_back(current);
+                current.m_arguments.clear();
+                ++lineNumber;
+            }
+            ++i;
+            continue;
+        }
+        if (c == '\\')
+        {
+            if (i + 1 == length)
+            {//trailing backslash at end of file
+                ++i;
+                continue;
+            }
+            if (text[i + 1] == '\n')
+            {
+                ++lineNumber;
+            } else {
+                token += text[i + 1];
+                inToken = true;
+            }
+            i += 2;
+            continue;
+        }
+        if (c == '\'')
+        {
+            const int end = text.indexOf('\'', i + 1);
+            if (end < 0) throw CommandException(scriptName + " line " + AString::number(lineNumber) + ": unterminated single quote");
+            token += text.mid(i + 1, end - i - 1);
+            lineNumber += text.mid(i + 1, end - i - 1).count('\n');
+            inToken = true;
+            i = end + 1;
+            continue;
+        }
+        if (c == '"')
+        {
+            const int startLine = lineNumber;
+            ++i;
+            while (i < length && text[i] != '"')
+            {
+                if (text[i] == '\\' && i + 1 < length && (text[i + 1] == '"' || text[i + 1] == '\\'))
+                {
+                    ++i;
+                } else if (text[i] == '\n') {
+                    ++lineNumber;
+                }
+                token += text[i];
+                ++i;
+            }
+            if (i >= length) throw CommandException(scriptName + " line " + AString::number(startLine) + ": unterminated double quote");
+            inToken = true;
+            ++i;
+            continue;
+        }
+        if (c == '#' && !inToken)
+        {
+            while (i < length && text[i] != '\n') ++i;
+            continue;
+        }
+        token += c;
+        inToken = true;
+        ++i;
+    }
+}
+
+/**
+ * Run the commands in a script in this process.  Files read by one command are
+ * reused by later commands, and outputs named with a leading '@' are kept in
+ * memory for later commands instead of being written, and must not be modified
+ * in place by the commands that read them.  Each command gets the
+ * provenance it would get if run by itself, and the first error stops the script.
+ *
+ * @param parameters
+ *    Parameters following -batch.
+ * @param preventProvenance
+ *    Whether -disable-provenance was given.
+ * @throws CommandException
+ *    If a command fails.
+ */
+void CommandOperationManager::runBatch(ProgramParameters& parameters, const bool& preventProvenance)
+{
+    const AString scriptName = parameters.nextString("batch script");
+    parameters.verifyAllParametersProcessed();
+    QFile scriptFile(scriptName);
+    if (!scriptFile.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        throw CommandException("unable to open batch script '" + scriptName + "'");
+    }
+    QTextStream scriptStream(&scriptFile);
+    vector<BatchCommand> commands;
+    parseBatchScript(scriptStream.readAll(), scriptName, commands);
+    scriptFile.close();
+    const int numCommands = (int)commands.size();
+    map<AString, int> lastUse;//so files can be released once no later command names them
+    for (int i = 0; i < numCommands; ++i)
+    {
+        vector<AString>& arguments = commands[i].m_arguments;
+        if (arguments[0] == "wb_command" || arguments[0] == parameters.getProgramName())
+        {//allow pasting lines from a shell script
+            arguments.erase(arguments.begin());
+        }
+        for (int j = 0; j < (int)arguments.size(); ++j)
+        {
+            lastUse[arguments[j]] = i;
+        }
+    }
+    CommandFileCache fileCache;
+    for (int i = 0; i < numCommands; ++i)
+    {
+        const vector<AString>& arguments = commands[i].m_arguments;
+        const AString location = scriptName + " line " + AString::number(commands[i].m_lineNumber);
+        if (arguments.empty()) continue;
+        CommandOperation* operation = findOperation(arguments[0]);
+        if (operation == NULL)
+        {
+            throw CommandException(location + ": command \"" + arguments[0] + "\" not found.");
+        }
+        ProgramParameters lineParameters;
+        lineParameters.setProgramName(parameters.getProgramName());
+        for (int j = 0; j < (int)arguments.size(); ++j)
+        {
+            lineParameters.addParameter(arguments[j]);
+        }
+        caret_global_commandLine_init(lineParameters);//provenance and error reporting use the command being run, not the batch invocation
+        CaretLogFine("Running: " + caret_global_commandLine);
+        lineParameters.nextString("Command Name");
+        fileCache.beginCommand();
+        operation->setFileCache(&fileCache);
+        try
+        {
+            CaretProfileSpan mySpan(arguments[0], "command");
+            operation->execute(lineParameters, preventProvenance);
+            fileCache.endCommand(arguments);
+        } catch (CaretException& e) {
+            operation->setFileCache(NULL);
+            throw CommandException(location + ": " + e.whatString());
+        } catch (...) {
+            operation->setFileCache(NULL);
+            throw;
+        }
+        operation->setFileCache(NULL);
+        for (int j = 0; j < (int)arguments.size(); ++j)
+        {
+            if (lastUse[arguments[j]] == i)
+            {
+                fileCache.removeFile(arguments[j]);
+            }
+        }
+    }
+}
+
 bool CommandOperationManager::getGlobalOption(ProgramParameters& parameters, const AString& optionString, const int& numArgs, vector<AString>& arguments)
 {
     parameters.setParameterIndex(0);//this ends up being slightly redundant, but whatever
@@ -778,8 +1025,34 @@ void CommandOperationManager::printHelpInfo()
     cout << "   -list-deprecated-commands   list deprecated subcommands" << endl;
     cout << "   -all-commands-help          show all processing subcommands and their help" << endl;
     cout << "                                  info - VERY LONG" << endl;
+    cout << endl << "Batch mode:" << endl;
+    cout << "   -batch <script>             run the subcommands in <script> in one process," << endl;
+    cout << "                                  one per line with shell-style quoting, and" << endl;
+    cout << "                                  reuse files read by earlier lines.  Outputs" << endl;
+    cout << "                                  named with a leading '@' stay in memory for" << endl;
+    cout << "                                  later lines instead of being written, and" << endl;
+    cout << "                                  keep floating point values.  They are" << endl;
+    cout << "                                  read-only, a line that modifies one in" << endl;
+    cout << "                                  place fails.  Global options go before" << endl;
+    cout << "                                  -batch and apply to every line." << endl;
     cout << endl << "Global options (can be added to any command):" << endl;
     cout << "   -disable-provenance         don't generate provenance info in output files" << endl;
+    cout << "   -output-datatype <type>     write volume and cifti outputs as <type>, one of:" << endl;
+    cout << "            FLOAT32 (default)" << endl;
+    cout << "            INT32, UINT16, INT16, UINT8 - values must already be integers in" << endl;
+    cout << "               range, such as label keys, or writing fails" << endl;
+    cout << "            INT16_SCALED, UINT8_SCALED - map the data range onto the type with" << endl;
+    cout << "               scl_slope and scl_inter, lossy, needs an extra pass over the data" << endl;
+    cout << "   -output-datatype-range <min> <max>" << endl;
+    cout << "                               with a _SCALED type, scale for this range instead" << endl;
+    cout << "                                  of the data range, lets large cifti outputs" << endl;
+    cout << "                                  stream to disk, values outside it are an error" << endl;
+    cout << "   -gifti-external-binary      write gifti outputs with their data in an external" << endl;
+    cout << "                                  binary file next to the .gii, which is memory" << endl;
+    cout << "                                  mapped instead of read when the file is loaded" << endl;
+    cout << "   -profile <trace-file>       time commands, file I/O and parallel regions," << endl;
+    cout << "                                  write them to <trace-file> as chrome trace" << endl;
+    cout << "                                  event json, and print a summary to stderr" << endl;
     cout << "   -logging <level>            set the logging level, valid values are:" << endl;
     vector<LogLevelEnum::Enum> logLevels;
     LogLevelEnum::getAllEnums(logLevels);
@@ -46,6 +46,14 @@ namespace caret {
         
         std::vector<CommandOperation*> getCommandOperations();
         
+        struct BatchCommand
+        {
+            int m_lineNumber;
+            std::vector<AString> m_arguments;
+        };
+        
+        static void parseBatchScript(const QString& text, const AString& scriptName, std::vector<BatchCommand>& commandsOut);
+        
     private:
         CommandOperationManager();
         
@@ -73,6 +81,10 @@ namespace caret {
         
         bool getGlobalOption(ProgramParameters& parameters, const AString& optionString, const int& numArgs, std::vector<AString>& arguments);
         
+        CommandOperation* findOperation(const AString& commandSwitch);
+        
+        void runBatch(ProgramParameters& parameters, const bool& preventProvenance);
+        
     private:
         std::vector<CommandOperation*> commandOperations, deprecatedOperations;
         
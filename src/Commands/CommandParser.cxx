@@ -28,6 +28,7 @@
 #include "CaretDataFileHelper.h"
 #include "CaretLogger.h"
 #include "CiftiFile.h"
+#include "CommandFileCache.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "FociFile.h"
@@ -45,6 +46,20 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    template <typename T>
+    CaretPointer<T> readInputFile(const AString& fileName, CommandFileCache* fileCache)
+    {//in batch mode, files already read by an earlier command are reused
+        CaretPointer<T> ret;
+        if (fileCache != NULL && fileCache->getFile(fileName, ret)) return ret;
+        ret.grabNew(new T());
+        ret->readFile(fileName);
+        if (fileCache != NULL) fileCache->addFile(fileName, ret);
+        return ret;
+    }
+}
+
 const AString CommandParser::PROVENANCE_NAME = "Provenance";
 const AString CommandParser::PARENT_PROVENANCE_NAME = "ParentProvenance";
 const AString CommandParser::PROGRAM_PROVENANCE_NAME = "ProgramProvenance";
@@ -55,6 +70,7 @@ CommandParser::CommandParser(AutoOperationInterface* myAutoOper) :
     OperationParserInterface(myAutoOper)
 {
     m_doProvenance = true;
+    m_fileCache = NULL;
 }
 
 void CommandParser::disableProvenance()
@@ -62,6 +78,11 @@ void CommandParser::disableProvenance()
     m_doProvenance = false;
 }
 
+void CommandParser::setFileCache(CommandFileCache* fileCache)
+{
+    m_fileCache = fileCache;
+}
+
 
 void CommandParser::executeOperation(ProgramParameters& parameters)
 {
@@ -72,6 +93,7 @@ void CommandParser::executeOperation(ProgramParameters& parameters)
     //the parent provenance should never be generated manually
     m_parentProvenance = "";//in case someone tries to use the same instance more than once
     m_workingDir = QDir::currentPath();//get the current path, in case some stupid command changes the working directory
+    m_inputCiftiNames.clear();//batch mode runs the same instance again, don't keep pointers to files from a previous run
     //these get set on output files during writeOutput (and for on-disk in provenanceBeforeOperation)
     parseComponent(myAlgParams.getPointer(), parameters, myOutAssoc);//parsing block
     parameters.verifyAllParametersProcessed();
@@ -87,6 +109,7 @@ void CommandParser::executeOperation(ProgramParameters& parameters)
     if (m_doProvenance) provenanceAfterOperation(myOutAssoc);
     //TODO: deallocate input files - give abstract parameter a virtual deallocate method? use CaretPointer and rely on reference counting?
     writeOutput(myOutAssoc);
+    m_inputCiftiNames.clear();
 }
 
 void CommandParser::showParsedOperation(ProgramParameters& parameters)
@@ -142,8 +165,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::BORDER:
                 {
-                    CaretPointer<BorderFile> myFile(new BorderFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<BorderFile> myFile = readInputFile<BorderFile>(nextArg, m_fileCache);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -167,9 +189,17 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 case OperationParametersEnum::CIFTI:
                 {
                     FileInformation myInfo(nextArg);
-                    CaretPointer<CiftiFile> myFile(new CiftiFile());
-                    myFile->openFile(nextArg);
-                    m_inputCiftiNames[myInfo.getCanonicalFilePath()] = myFile;//track input cifti, so we can check their size
+                    CaretPointer<CiftiFile> myFile;
+                    if (m_fileCache == NULL || !m_fileCache->getFile(nextArg, myFile))
+                    {
+                        myFile.grabNew(new CiftiFile());
+                        myFile->openFile(nextArg);
+                        if (m_fileCache != NULL) m_fileCache->addFile(nextArg, myFile);
+                    }
+                    if (m_fileCache == NULL || !CommandFileCache::isMemoryName(nextArg))
+                    {
+                        m_inputCiftiNames[myInfo.getCanonicalFilePath()] = myFile;//track input cifti, so we can check their size
+                    }
                     if (m_doProvenance)//just an optimization, if we aren't going to write provenance, don't generate it, either
                     {
                         const GiftiMetaData* md = myFile->getCiftiXML().getFileMetaData();
@@ -206,8 +236,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::FOCI:
                 {
-                    CaretPointer<FociFile> myFile(new FociFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<FociFile> myFile = readInputFile<FociFile>(nextArg, m_fileCache);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -241,8 +270,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::LABEL:
                 {
-                    CaretPointer<LabelFile> myFile(new LabelFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<LabelFile> myFile = readInputFile<LabelFile>(nextArg, m_fileCache);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -265,8 +293,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::METRIC:
                 {
-                    CaretPointer<MetricFile> myFile(new MetricFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<MetricFile> myFile = readInputFile<MetricFile>(nextArg, m_fileCache);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -299,8 +326,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::SURFACE:
                 {
-                    CaretPointer<SurfaceFile> myFile(new SurfaceFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<SurfaceFile> myFile = readInputFile<SurfaceFile>(nextArg, m_fileCache);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -323,8 +349,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::VOLUME:
                 {
-                    CaretPointer<VolumeFile> myFile(new VolumeFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<VolumeFile> myFile = readInputFile<VolumeFile>(nextArg, m_fileCache);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -635,6 +660,11 @@ void CommandParser::makeOnDiskOutputs(const vector<OutputAssoc>& outAssociation)
             case OperationParametersEnum::CIFTI:
             {
                 CiftiParameter* myCiftiParam = (CiftiParameter*)myParam;
+                if (m_fileCache != NULL && CommandFileCache::isMemoryName(outAssociation[i].m_fileName))
+                {
+                    myCiftiParam->m_parameter.grabNew(new CiftiFile());//stays in memory for later commands in the batch
+                    break;
+                }
                 FileInformation myInfo(outAssociation[i].m_fileName);
                 map<AString, const CiftiFile*>::iterator iter = m_inputCiftiNames.find(myInfo.getCanonicalFilePath());
                 if (iter != m_inputCiftiNames.end())
@@ -666,6 +696,10 @@ void CommandParser::writeOutput(const vector<OutputAssoc>& outAssociation)
 {
     for (uint32_t i = 0; i < outAssociation.size(); ++i)
     {
+        if (m_fileCache != NULL && CommandFileCache::isMemoryName(outAssociation[i].m_fileName) && keepOutputInMemory(outAssociation[i]))
+        {
+            continue;
+        }
         AbstractParameter* myParam = outAssociation[i].m_param;
         switch (myParam->getType())
         {
@@ -727,6 +761,42 @@ void CommandParser::writeOutput(const vector<OutputAssoc>& outAssociation)
                 CaretAssertMessage(false, "Writing of this parameter type has not been implemented in this parser");//assert instead of throw because this is a code error, not a user error
                 throw CommandException("Internal parsing error, please let the developers know what you just tried to do");//but don't let release pass by it either
         }
+        if (m_fileCache != NULL && !CommandFileCache::isMemoryName(outAssociation[i].m_fileName))
+        {
+            m_fileCache->removeFile(outAssociation[i].m_fileName);//the file on disk no longer matches anything read from it earlier
+        }
+    }
+}
+
+bool CommandParser::keepOutputInMemory(const OutputAssoc& output)
+{
+    CaretAssert(m_fileCache != NULL);
+    AbstractParameter* myParam = output.m_param;
+    switch (myParam->getType())
+    {
+        case OperationParametersEnum::BORDER:
+            m_fileCache->addFile(output.m_fileName, ((BorderParameter*)myParam)->m_parameter);
+            return true;
+        case OperationParametersEnum::CIFTI:
+            m_fileCache->addFile(output.m_fileName, ((CiftiParameter*)myParam)->m_parameter);
+            return true;
+        case OperationParametersEnum::FOCI:
+            m_fileCache->addFile(output.m_fileName, ((FociParameter*)myParam)->m_parameter);
+            return true;
+        case OperationParametersEnum::LABEL:
+            m_fileCache->addFile(output.m_fileName, ((LabelParameter*)myParam)->m_parameter);
+            return true;
+        case OperationParametersEnum::METRIC:
+            m_fileCache->addFile(output.m_fileName, ((MetricParameter*)myParam)->m_parameter);
+            return true;
+        case OperationParametersEnum::SURFACE:
+            m_fileCache->addFile(output.m_fileName, ((SurfaceParameter*)myParam)->m_parameter);
+            return true;
+        case OperationParametersEnum::VOLUME:
+            m_fileCache->addFile(output.m_fileName, ((VolumeParameter*)myParam)->m_parameter);
+            return true;
+        default:
+            return false;
     }
 }
 
@@ -32,11 +32,14 @@
 
 namespace caret {
 
+    class CommandFileCache;
+    
     class CommandParser : public CommandOperation, OperationParserInterface
     {
         int m_minIndent, m_maxIndent, m_indentIncrement, m_maxWidth;
         AString m_provenance, m_parentProvenance, m_workingDir;
         bool m_doProvenance;
+        CommandFileCache* m_fileCache;
         const static AString PROVENANCE_NAME, PARENT_PROVENANCE_NAME, PROGRAM_PROVENANCE_NAME, CWD_PROVENANCE_NAME;//TODO: put this elsewhere?
         std::map<AString, const CiftiFile*> m_inputCiftiNames;
         struct OutputAssoc
@@ -51,6 +54,7 @@ namespace caret {
         void provenanceAfterOperation(const std::vector<OutputAssoc>& outAssociation);
         void makeOnDiskOutputs(const std::vector<OutputAssoc>& outAssociation);//ensures on-disk inputs aren't used as on-disk outputs, converting outputs to in-memory when needed
         void writeOutput(const std::vector<OutputAssoc>& outAssociation);
+        bool keepOutputInMemory(const OutputAssoc& output);//for in-memory names in batch mode, returns false for non-file outputs
         AString getIndentString(int desired);
         void addHelpComponent(AString& info, ParameterComponent* myComponent, int curIndent);
         void addHelpOptions(AString& info, ParameterComponent* myAlgParams, int curIndent);
@@ -61,6 +65,7 @@ namespace caret {
     public:
         CommandParser(AutoOperationInterface* myAutoOper);
         void disableProvenance();
+        void setFileCache(CommandFileCache* fileCache);
         void executeOperation(ProgramParameters& parameters);
         void showParsedOperation(ProgramParameters& parameters);
         AString getHelpInformation(const AString& programName);
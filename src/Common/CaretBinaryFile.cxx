@@ -27,12 +27,16 @@
 
 #include "CaretBinaryFile.h"
 #include "CaretLogger.h"
+#include "CaretProfiler.h"
 #include "DataFileException.h"
+#include "ZipArchiveReader.h"
 
 #include <QFile>
 #include "zlib.h"
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
 
 using namespace caret;
 using namespace std;
@@ -57,6 +61,37 @@ namespace caret
     };
     
     const int64_t ZFileImpl::CHUNK_SIZE = 1<<26;//64MiB, large enough for good performance, small enough for zlib, must convert to uint32
+    
+    //read-only access to a member of a zip archive, without extracting it
+    //a compressed member is inflated as a stream, and decompressed into memory on the first backward seek
+    class ZipMemberImpl : public CaretBinaryFile::ImplInterface
+    {
+        QFile m_file;
+        int64_t m_dataStart, m_dataSize;//location of the member's bytes in the archive
+        int64_t m_uncompressedSize;//from the directory, 0 if unknown
+        int64_t m_pos, m_dataPos;//logical position, and how far into the member's bytes the stream has consumed
+        bool m_direct;//stored member that isn't gzipped, can be read with offsets
+        bool m_inMemory;//compressed member that has been decompressed into m_memory
+        int m_windowBits;
+        bool m_streamOpen, m_streamEnded;
+        z_stream m_stream;
+        std::vector<char> m_inBuffer, m_memory;
+        const static int64_t CHUNK_SIZE;
+        void startStream();
+        void endStream();
+        void loadToMemory();
+    public:
+        ZipMemberImpl() { m_streamOpen = false; m_inMemory = false; }
+        void open(const QString& filename, const CaretBinaryFile::OpenMode& opmode);
+        void close();
+        void seek(const int64_t& position);
+        int64_t pos();
+        void read(void* dataOut, const int64_t& count, int64_t* numRead);
+        void write(const void* dataIn, const int64_t& count);
+        ~ZipMemberImpl();
+    };
+    
+    const int64_t ZipMemberImpl::CHUNK_SIZE = 1<<20;
 #endif //ZLIB_VERSION
 
     class QFileImpl : public CaretBinaryFile::ImplInterface
@@ -112,7 +147,15 @@ void CaretBinaryFile::open(const QString& filename, const OpenMode& opmode)
 {
     close();
     if (opmode == NONE) throw DataFileException("can't open file with NONE mode");
-    if (filename.endsWith(".gz"))
+    AString zipFileName, memberName;
+    if (ZipArchiveReader::splitMemberPath(filename, zipFileName, memberName))
+    {
+#ifdef ZLIB_VERSION
+        m_impl.grabNew(new ZipMemberImpl());
+#else //ZLIB_VERSION
+        throw DataFileException("can't open zip member '" + filename + "', compiled without zlib support");
+#endif //ZLIB_VERSION
+    } else if (filename.endsWith(".gz"))
     {
 #ifdef ZLIB_VERSION
         m_impl.grabNew(new ZFileImpl());
@@ -129,7 +172,9 @@ void CaretBinaryFile::open(const QString& filename, const OpenMode& opmode)
 void CaretBinaryFile::read(void* dataOut, const int64_t& count, int64_t* numRead)
 {
     if (!getOpenForRead()) throw DataFileException("file is not open for reading");
+    CaretProfileSpan mySpan("CaretBinaryFile::read", "io");
     m_impl->read(dataOut, count, numRead);
+    mySpan.addBytes(numRead == NULL ? count : *numRead);
 }
 
 void CaretBinaryFile::seek(const int64_t& position)
@@ -147,7 +192,9 @@ int64_t CaretBinaryFile::pos()
 void CaretBinaryFile::write(const void* dataIn, const int64_t& count)
 {
     if (!getOpenForWrite()) throw DataFileException("file is not open for writing");
+    CaretProfileSpan mySpan("CaretBinaryFile::write", "io");
     m_impl->write(dataIn, count);
+    mySpan.addBytes(count);
 }
 
 #ifdef ZLIB_VERSION
@@ -267,6 +314,200 @@ ZFileImpl::~ZFileImpl()
         CaretLogSevere("caught unknown exception type while closing a compressed file");
     }
 }
+void ZipMemberImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
+{
+    close();
+    m_uncompressedSize = 0;
+    m_fileName = filename;
+    if (opmode != CaretBinaryFile::READ) throw DataFileException("files inside zip archives can only be opened for reading: '" + filename + "'");
+    AString zipFileName, memberName;
+    if (!ZipArchiveReader::splitMemberPath(filename, zipFileName, memberName)) throw DataFileException("failed to open zip member '" + filename + "', archive does not exist");
+    ZipArchiveReader myReader(zipFileName);
+    const ZipArchiveReader::Member* myMember = myReader.findMember(memberName);
+    if (myMember == NULL) throw DataFileException("zip archive '" + zipFileName + "' does not contain '" + memberName + "'");
+    if (myMember->isEncrypted()) throw DataFileException("zip member '" + filename + "' is encrypted, which is not supported");
+    const bool gzipped = memberName.endsWith(".gz");
+    if (myMember->isStored())
+    {
+        m_direct = !gzipped;
+        m_windowBits = 15 + 16;//gzip header
+    } else if (myMember->isDeflated()) {
+        if (gzipped) throw DataFileException("zip member '" + filename + "' is compressed twice, which is not supported, extract it or store it uncompressed in the zip");
+        m_direct = false;
+        m_windowBits = -MAX_WBITS;//raw deflate
+        m_uncompressedSize = myMember->m_uncompressedSize;
+    } else {
+        throw DataFileException("zip member '" + filename + "' uses unsupported compression method " + AString::number(myMember->m_method));
+    }
+    m_dataStart = myReader.getDataOffset(*myMember);
+    m_dataSize = myMember->m_compressedSize;
+    m_file.setFileName(zipFileName);
+    if (!m_file.open(QIODevice::ReadOnly)) throw DataFileException("failed to open zip archive '" + zipFileName + "'");
+    m_pos = 0;
+    if (m_direct)
+    {
+        if (!m_file.seek(m_dataStart)) throw DataFileException("seek failed in zip archive '" + zipFileName + "'");
+    } else {
+        startStream();
+    }
+}
+
+void ZipMemberImpl::startStream()
+{
+    endStream();
+    memset(&m_stream, 0, sizeof(m_stream));
+    if (inflateInit2(&m_stream, m_windowBits) != Z_OK) throw DataFileException("failed to initialize decompression for '" + m_fileName + "'");
+    m_streamOpen = true;
+    m_streamEnded = false;
+    m_inBuffer.resize(CHUNK_SIZE);
+    m_dataPos = 0;
+    m_pos = 0;
+    if (!m_file.seek(m_dataStart)) throw DataFileException("seek failed in zip member '" + m_fileName + "'");
+}
+
+void ZipMemberImpl::endStream()
+{
+    if (!m_streamOpen) return;
+    inflateEnd(&m_stream);
+    m_streamOpen = false;
+}
+
+void ZipMemberImpl::loadToMemory()
+{//restarting the stream on every backward seek makes random access quadratic in the member size
+    CaretLogFine("random access in compressed zip member '" + m_fileName + "', decompressing it into memory, store it uncompressed in the zip to read it in place");
+    startStream();
+    vector<char> memory;
+    memory.reserve(m_uncompressedSize + CHUNK_SIZE);
+    int64_t total = 0, numRead = 0;
+    do
+    {
+        memory.resize(total + CHUNK_SIZE);
+        read(memory.data() + total, CHUNK_SIZE, &numRead);
+        total += numRead;
+    } while (numRead > 0);
+    memory.resize(total);
+    endStream();
+    m_memory.swap(memory);
+    m_inMemory = true;
+}
+
+void ZipMemberImpl::close()
+{
+    endStream();
+    m_file.close();
+    m_inMemory = false;
+    vector<char>().swap(m_memory);//actually free the memory
+}
+
+void ZipMemberImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
+{
+    int64_t total = 0;
+    bool error = false;
+    if (m_inMemory)
+    {
+        total = max((int64_t)0, min(count, (int64_t)m_memory.size() - m_pos));
+        if (total > 0) memcpy(dataOut, m_memory.data() + m_pos, total);
+    } else if (m_direct) {
+        const int64_t toRead = max((int64_t)0, min(count, m_dataSize - m_pos));//don't read into the next member
+        while (total < toRead)
+        {
+            int64_t readret = m_file.read(((char*)dataOut) + total, min(toRead - total, (int64_t)1<<30));
+            if (readret < 1)
+            {
+                error = (readret < 0);
+                break;
+            }
+            total += readret;
+        }
+    } else {
+        while (total < count && !m_streamEnded)
+        {
+            if (m_stream.avail_in == 0 && m_dataPos < m_dataSize)
+            {
+                int64_t readret = m_file.read(m_inBuffer.data(), min(CHUNK_SIZE, m_dataSize - m_dataPos));
+                if (readret < 1)
+                {
+                    error = (readret < 0);
+                    break;
+                }
+                m_dataPos += readret;
+                m_stream.next_in = (Bytef*)m_inBuffer.data();
+                m_stream.avail_in = (uInt)readret;
+            }
+            const int64_t iterSize = min(count - total, (int64_t)1<<30);
+            m_stream.next_out = ((Bytef*)dataOut) + total;
+            m_stream.avail_out = (uInt)iterSize;
+            int ret = inflate(&m_stream, Z_NO_FLUSH);
+            total += iterSize - m_stream.avail_out;
+            if (ret == Z_STREAM_END)
+            {
+                if (m_windowBits > 0 && (m_stream.avail_in > 0 || m_dataPos < m_dataSize))
+                {//concatenated gzip members, like gzread handles
+                    inflateReset(&m_stream);
+                } else {
+                    m_streamEnded = true;
+                }
+            } else if (ret == Z_BUF_ERROR) {
+                if (m_stream.avail_in == 0 && m_dataPos >= m_dataSize) break;//truncated stream
+            } else if (ret != Z_OK) {
+                error = true;
+                break;
+            }
+        }
+    }
+    m_pos += total;
+    if (numRead == NULL)
+    {
+        if (total != count)
+        {
+            if (error) throw DataFileException("error while reading zip member '" + m_fileName + "'");
+            throw DataFileException("premature end of file in zip member '" + m_fileName + "'");
+        }
+    } else {
+        if (error) throw DataFileException("error while reading zip member '" + m_fileName + "'");
+        *numRead = total;
+    }
+}
+
+void ZipMemberImpl::seek(const int64_t& position)
+{
+    if (position < 0) throw DataFileException("seek failed in zip member '" + m_fileName + "'");
+    if (m_direct)
+    {
+        if (!m_file.seek(m_dataStart + position)) throw DataFileException("seek failed in zip member '" + m_fileName + "'");
+        m_pos = position;
+        return;
+    }
+    if (m_inMemory || position < m_pos)
+    {
+        if (!m_inMemory) loadToMemory();//deflate streams can only go forward, so don't start over every time
+        m_pos = position;
+        return;
+    }
+    if (position == m_pos) return;
+    vector<char> scratch(min(position - m_pos, CHUNK_SIZE));
+    while (m_pos < position)
+    {
+        int64_t numRead = 0;
+        read(scratch.data(), min(position - m_pos, CHUNK_SIZE), &numRead);
+        if (numRead < 1) throw DataFileException("seek failed in zip member '" + m_fileName + "'");
+    }
+}
+
+int64_t ZipMemberImpl::pos()
+{
+    return m_pos;
+}
+
+void ZipMemberImpl::write(const void*, const int64_t&)
+{
+    throw DataFileException("files inside zip archives can't be written: '" + m_fileName + "'");
+}
+
+ZipMemberImpl::~ZipMemberImpl()
+{
+    close();
+}
 #endif //ZLIB_VERSION
 
 void QFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
@@ -344,7 +585,7 @@ void QFileImpl::write(const void* dataIn, const int64_t& count)
     while (total < count)
     {
         int64_t maxToWrite = min(count - total, CHUNK_SIZE);
-        writeret = m_file.write((const char*)dataIn, maxToWrite);//QFile probably also chokes on large writes
+        writeret = m_file.write(((const char*)dataIn) + total, maxToWrite);//QFile probably also chokes on large writes
         if (writeret < 1) break;//0 or -1 means error or eof
         total += writeret;
     }
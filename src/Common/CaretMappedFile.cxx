@@ -0,0 +1,123 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretMappedFile.h"
+
+#include <QFile>
+
+#include <limits>
+
+#ifdef CARET_OS_WINDOWS
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace caret;
+using namespace std;
+
+CaretMappedFile::CaretMappedFile()
+{
+    m_data = NULL;
+    m_size = 0;
+#ifdef CARET_OS_WINDOWS
+    m_fileHandle = NULL;
+    m_mappingHandle = NULL;
+#endif
+}
+
+CaretMappedFile::~CaretMappedFile()
+{
+    close();
+}
+
+bool CaretMappedFile::open(const AString& fileName)
+{
+    close();
+#ifdef CARET_OS_WINDOWS
+    HANDLE fileHandle = CreateFileW((const wchar_t*)fileName.utf16(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart <= 0 ||
+        (uint64_t)fileSize.QuadPart > (uint64_t)numeric_limits<size_t>::max())
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (mappingHandle == NULL)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+    m_fileHandle = fileHandle;
+    m_mappingHandle = mappingHandle;
+    m_data = (uint8_t*)view;
+    m_size = fileSize.QuadPart;
+#else
+    int fd = ::open(QFile::encodeName(fileName).constData(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode) || fileStat.st_size <= 0 ||
+        (uint64_t)fileStat.st_size > (uint64_t)numeric_limits<size_t>::max())
+    {
+        ::close(fd);
+        return false;
+    }
+    //MAP_PRIVATE with write permission gives kernel copy-on-write per page, the descriptor isn't needed after mapping
+    void* view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+    m_data = (uint8_t*)view;
+    m_size = fileStat.st_size;
+#endif
+    m_fileName = fileName;
+    return true;
+}
+
+void CaretMappedFile::close()
+{
+    if (m_data != NULL)
+    {
+#ifdef CARET_OS_WINDOWS
+        UnmapViewOfFile(m_data);
+        CloseHandle((HANDLE)m_mappingHandle);
+        CloseHandle((HANDLE)m_fileHandle);
+        m_fileHandle = NULL;
+        m_mappingHandle = NULL;
+#else
+        munmap(m_data, (size_t)m_size);
+#endif
+    }
+    m_data = NULL;
+    m_size = 0;
+    m_fileName = "";
+}
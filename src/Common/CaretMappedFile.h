@@ -0,0 +1,56 @@
+#ifndef __CARET_MAPPED_FILE_H__
+#define __CARET_MAPPED_FILE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+
+#include <stdint.h>
+
+namespace caret {
+
+    ///private copy-on-write mapping of an entire file, writes to the memory go to private pages and never reach the file
+    class CaretMappedFile
+    {
+        uint8_t* m_data;
+        int64_t m_size;
+        AString m_fileName;
+#ifdef CARET_OS_WINDOWS
+        void* m_fileHandle;
+        void* m_mappingHandle;
+#endif
+        CaretMappedFile(const CaretMappedFile&);
+        CaretMappedFile& operator=(const CaretMappedFile&);
+    public:
+        CaretMappedFile();
+        ~CaretMappedFile();
+        ///returns false rather than throwing, so callers can fall back to reading the file
+        bool open(const AString& fileName);
+        void close();
+        bool isOpen() const { return m_data != NULL; }
+        uint8_t* getData() const { return m_data; }
+        int64_t getSize() const { return m_size; }
+        const AString& getFileName() const { return m_fileName; }
+    };
+
+}
+
+#endif //__CARET_MAPPED_FILE_H__
@@ -0,0 +1,279 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretProfiler.h"
+
+#include "CaretMutex.h"
+
+#include <QFile>
+#include <QThread>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#ifdef CARET_OS_WINDOWS
+#include "windows.h"
+#else
+#include <sys/time.h>
+#endif
+
+using namespace caret;
+using namespace std;
+
+/**
+ * \class caret::CaretProfiler
+ * \brief Low-overhead timing spans with trace and summary output.
+ * \ingroup Common
+ *
+ * CaretProfileSpan objects placed around operations, file I/O and
+ * parallel regions check a single flag when profiling is disabled.  When
+ * enabled, each finished span is aggregated by name for the summary table,
+ * and the first MAX_EVENTS spans are also kept for the trace file.
+ */
+
+bool CaretProfiler::s_enabled = false;
+
+namespace
+{
+    const int64_t MAX_EVENTS = 1000000;//keep trace memory bounded on long runs, the summary still counts everything
+    
+    struct ProfileEvent
+    {
+        int32_t m_key, m_thread;
+        int64_t m_start, m_duration, m_bytes;
+    };
+    
+    struct ProfileTotal
+    {
+        AString m_name, m_category;
+        int64_t m_count, m_total, m_max, m_bytes;
+        ProfileTotal() : m_count(0), m_total(0), m_max(0), m_bytes(0) { }
+    };
+    
+    struct ProfileState
+    {
+        CaretMutex m_mutex;
+        vector<ProfileEvent> m_events;
+        vector<ProfileTotal> m_totals;
+        map<pair<AString, AString>, int32_t> m_keyLookup;
+        map<Qt::HANDLE, int32_t> m_threadLookup;
+        int64_t m_dropped, m_origin;
+        ProfileState() : m_dropped(0), m_origin(0) { }
+    };
+    
+    ProfileState& getState()
+    {
+        static ProfileState theState;
+        return theState;
+    }
+    
+    AString jsonEscape(const AString& input)
+    {
+        AString ret;
+        for (int i = 0; i < input.size(); ++i)
+        {
+            const QChar c = input[i];
+            if (c == '"' || c == '\\')
+            {
+                ret += '\\';
+                ret += c;
+            } else if (c.unicode() < 0x20) {
+                ret += ' ';
+            } else {
+                ret += c;
+            }
+        }
+        return ret;
+    }
+    
+    bool totalGreater(const ProfileTotal& left, const ProfileTotal& right)
+    {
+        return left.m_total > right.m_total;
+    }
+}
+
+CaretProfileSpan::CaretProfileSpan(const AString& name, const char* category)
+{
+    m_active = CaretProfiler::isEnabled();
+    m_ownedName = NULL;
+    if (m_active)
+    {
+        m_ownedName = new QByteArray(name.toUtf8());
+        m_name = m_ownedName->constData();
+        m_category = category;
+        m_bytes = 0;
+        m_start = CaretProfiler::getTimeMicroseconds();
+    }
+}
+
+void CaretProfiler::setEnabled(const bool& enabled)
+{
+    if (enabled && !s_enabled)
+    {
+        ProfileState& myState = getState();
+        CaretMutexLocker locked(&(myState.m_mutex));
+        myState.m_origin = getTimeMicroseconds();
+    }
+    s_enabled = enabled;
+}
+
+int64_t CaretProfiler::getTimeMicroseconds()
+{
+#ifdef CARET_OS_WINDOWS
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (int64_t)(counter.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+    struct timeval myTime;
+    gettimeofday(&myTime, NULL);
+    return ((int64_t)myTime.tv_sec) * 1000000 + myTime.tv_usec;
+#endif
+}
+
+void CaretProfiler::recordSpan(const char* name, const char* category, const int64_t& start, const int64_t& end, const int64_t& bytes)
+{
+    const Qt::HANDLE myThread = QThread::currentThreadId();
+    ProfileState& myState = getState();
+    CaretMutexLocker locked(&(myState.m_mutex));
+    pair<AString, AString> myKey(AString(category), AString(name));
+    map<pair<AString, AString>, int32_t>::iterator iter = myState.m_keyLookup.find(myKey);
+    int32_t keyIndex;
+    if (iter == myState.m_keyLookup.end())
+    {
+        keyIndex = (int32_t)myState.m_totals.size();
+        myState.m_keyLookup[myKey] = keyIndex;
+        myState.m_totals.push_back(ProfileTotal());
+        myState.m_totals.back().m_category = myKey.first;
+        myState.m_totals.back().m_name = myKey.second;
+    } else {
+        keyIndex = iter->second;
+    }
+    const int64_t duration = max((int64_t)0, end - start);
+    ProfileTotal& myTotal = myState.m_totals[keyIndex];
+    ++myTotal.m_count;
+    myTotal.m_total += duration;
+    myTotal.m_max = max(myTotal.m_max, duration);
+    myTotal.m_bytes += bytes;
+    if ((int64_t)myState.m_events.size() >= MAX_EVENTS)
+    {
+        ++myState.m_dropped;
+        return;
+    }
+    map<Qt::HANDLE, int32_t>::iterator threadIter = myState.m_threadLookup.find(myThread);
+    int32_t threadIndex;
+    if (threadIter == myState.m_threadLookup.end())
+    {
+        threadIndex = (int32_t)myState.m_threadLookup.size();
+        myState.m_threadLookup[myThread] = threadIndex;
+    } else {
+        threadIndex = threadIter->second;
+    }
+    ProfileEvent myEvent;
+    myEvent.m_key = keyIndex;
+    myEvent.m_thread = threadIndex;
+    myEvent.m_start = start - myState.m_origin;
+    myEvent.m_duration = duration;
+    myEvent.m_bytes = bytes;
+    myState.m_events.push_back(myEvent);
+}
+
+bool CaretProfiler::writeTrace(const AString& fileName)
+{
+    ProfileState& myState = getState();
+    CaretMutexLocker locked(&(myState.m_mutex));
+    QFile myFile(fileName);
+    if (!myFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    vector<QByteArray> escapedNames(myState.m_totals.size()), escapedCategories(myState.m_totals.size());
+    for (size_t i = 0; i < myState.m_totals.size(); ++i)
+    {
+        escapedNames[i] = jsonEscape(myState.m_totals[i].m_name).toUtf8();
+        escapedCategories[i] = jsonEscape(myState.m_totals[i].m_category).toUtf8();
+    }
+    QByteArray buffer = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (size_t i = 0; i < myState.m_events.size(); ++i)
+    {
+        const ProfileEvent& myEvent = myState.m_events[i];
+        if (i != 0) buffer += ",\n";
+        buffer += "{\"name\":\"" + escapedNames[myEvent.m_key] + "\",\"cat\":\"" + escapedCategories[myEvent.m_key] +
+                  "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + QByteArray::number(myEvent.m_thread) +
+                  ",\"ts\":" + QByteArray::number((qlonglong)myEvent.m_start) + ",\"dur\":" + QByteArray::number((qlonglong)myEvent.m_duration);
+        if (myEvent.m_bytes != 0)
+        {
+            buffer += ",\"args\":{\"bytes\":" + QByteArray::number((qlonglong)myEvent.m_bytes) + "}";
+        }
+        buffer += "}";
+        if (buffer.size() > (1<<20))
+        {
+            if (myFile.write(buffer) != buffer.size()) return false;
+            buffer.clear();
+        }
+    }
+    buffer += "\n]}\n";
+    if (myFile.write(buffer) != buffer.size()) return false;
+    myFile.close();
+    return true;
+}
+
+AString CaretProfiler::getSummary()
+{
+    ProfileState& myState = getState();
+    CaretMutexLocker locked(&(myState.m_mutex));
+    vector<ProfileTotal> sorted = myState.m_totals;
+    sort(sorted.begin(), sorted.end(), totalGreater);
+    AString ret = "profile summary (inclusive times, nested spans are also counted in their parents):\n";
+    ret += AString("%1 %2 %3 %4 %5 %6  %7\n").arg("total ms", 12).arg("count", 10).arg("mean ms", 10).arg("max ms", 10).arg("MB", 10).arg("MB/s", 9).arg("category: name");
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        const ProfileTotal& myTotal = sorted[i];
+        AString megabytes = "", rate = "";
+        if (myTotal.m_bytes != 0)
+        {
+            megabytes = AString::number(myTotal.m_bytes / 1000000.0, 'f', 1);
+            if (myTotal.m_total > 0) rate = AString::number(myTotal.m_bytes / (double)myTotal.m_total, 'f', 1);//bytes per microsecond is MB/s
+        }
+        ret += AString("%1 %2 %3 %4 %5 %6  ").arg(AString::number(myTotal.m_total / 1000.0, 'f', 1), 12)
+                                             .arg((qlonglong)myTotal.m_count, 10)
+                                             .arg(AString::number(myTotal.m_total / 1000.0 / myTotal.m_count, 'f', 3), 10)
+                                             .arg(AString::number(myTotal.m_max / 1000.0, 'f', 1), 10)
+                                             .arg(megabytes, 10)
+                                             .arg(rate, 9);
+        ret += myTotal.m_category + ": " + myTotal.m_name + "\n";//names may contain '%', so don't pass them through arg()
+    }
+    if (myState.m_dropped != 0)
+    {
+        ret += AString::number(myState.m_dropped) + " spans were left out of the trace file to limit memory, but are included above\n";
+    }
+    return ret;
+}
+
+void CaretProfiler::clear()
+{
+    ProfileState& myState = getState();
+    CaretMutexLocker locked(&(myState.m_mutex));
+    myState.m_events.clear();
+    myState.m_totals.clear();
+    myState.m_keyLookup.clear();
+    myState.m_threadLookup.clear();
+    myState.m_dropped = 0;
+    myState.m_origin = getTimeMicroseconds();
+}
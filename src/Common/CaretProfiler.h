@@ -0,0 +1,85 @@
+#ifndef __CARET_PROFILER_H__
+#define __CARET_PROFILER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+
+#include <stdint.h>
+
+namespace caret {
+    
+    ///collects timed spans for trace output, records nothing unless enabled
+    class CaretProfiler
+    {
+        static bool s_enabled;
+    public:
+        static bool isEnabled() { return s_enabled; }
+        ///enable before starting any spans, spans that were open when it changes are not recorded
+        static void setEnabled(const bool& enabled);
+        static int64_t getTimeMicroseconds();
+        static void recordSpan(const char* name, const char* category, const int64_t& start, const int64_t& end, const int64_t& bytes);
+        ///write chrome trace event json (chrome://tracing, perfetto), returns false rather than throwing
+        static bool writeTrace(const AString& fileName);
+        ///table of inclusive times by span name, largest first
+        static AString getSummary();
+        static void clear();
+    };
+    
+    ///RAII span, records its lifetime and optional byte count when profiling is enabled
+    class CaretProfileSpan
+    {
+        const char* m_name;//static strings only, to keep disabled spans free
+        const char* m_category;
+        QByteArray* m_ownedName;
+        int64_t m_start, m_bytes;
+        bool m_active;
+        CaretProfileSpan(const CaretProfileSpan&);
+        CaretProfileSpan& operator=(const CaretProfileSpan&);
+    public:
+        CaretProfileSpan(const char* name, const char* category)
+        {
+            m_active = CaretProfiler::isEnabled();
+            m_ownedName = NULL;
+            if (m_active)
+            {
+                m_name = name;
+                m_category = category;
+                m_bytes = 0;
+                m_start = CaretProfiler::getTimeMicroseconds();
+            }
+        }
+        ///copies the name only when enabled
+        CaretProfileSpan(const AString& name, const char* category);
+        void addBytes(const int64_t& bytes) { if (m_active) m_bytes += bytes; }
+        ~CaretProfileSpan()
+        {
+            if (m_active)
+            {
+                CaretProfiler::recordSpan(m_name, m_category, m_start, CaretProfiler::getTimeMicroseconds(), m_bytes);
+                delete m_ownedName;
+            }
+        }
+    };
+    
+} // namespace
+
+#endif //__CARET_PROFILER_H__
@@ -0,0 +1,84 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "DataBlockSource.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+
+#include <algorithm>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t MEMORY_BLOCK_SIZE = 1 << 20;
+}
+
+int DataBlockSource::getNumberOfSlots()
+{
+#ifdef CARET_OMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+void DataBlockSource::processBlocks(BlockProcessor& processor) const
+{
+    const int numSlots = getNumberOfSlots();
+    const int64_t numBlocks = getNumberOfBlocks();
+    vector<vector<float> > scratch(numSlots);
+    vector<const float*> blockData(numSlots);
+    vector<int64_t> blockCounts(numSlots);
+    for (int64_t batchStart = 0; batchStart < numBlocks; batchStart += numSlots)
+    {
+        const int batchCount = (int)min((int64_t)numSlots, numBlocks - batchStart);
+        for (int i = 0; i < batchCount; ++i)
+        {//getBlock may read from disk (on-disk cifti), which isn't thread safe, so fetch serially
+            blockData[i] = getBlock(batchStart + i, scratch[i], blockCounts[i]);
+        }
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int i = 0; i < batchCount; ++i)
+        {
+            processor.processBlock(blockData[i], blockCounts[i], i);
+        }
+    }
+}
+
+void MemoryBlockSource::addArray(const float* data, const int64_t& dataCount)
+{
+    for (int64_t start = 0; start < dataCount; start += MEMORY_BLOCK_SIZE)
+    {
+        Block block;
+        block.m_data = data + start;
+        block.m_count = min(MEMORY_BLOCK_SIZE, dataCount - start);
+        m_blocks.push_back(block);
+    }
+    m_numValues += dataCount;
+}
+
+const float* MemoryBlockSource::getBlock(const int64_t& index, vector<float>& /*scratch*/, int64_t& dataCountOut) const
+{
+    CaretAssertVectorIndex(m_blocks, index);
+    dataCountOut = m_blocks[index].m_count;
+    return m_blocks[index].m_data;
+}
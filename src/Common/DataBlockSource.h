@@ -0,0 +1,86 @@
+#ifndef __DATA_BLOCK_SOURCE_H__
+#define __DATA_BLOCK_SOURCE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <vector>
+#include "stdint.h"
+
+namespace caret
+{
+    
+    ///provides data that shouldn't be copied into one array (such as all rows of a large cifti file) as a sequence of blocks
+    class DataBlockSource
+    {
+    public:
+        ///receives blocks from processBlocks, may be called from several threads at once, but never concurrently with the same slot
+        class BlockProcessor
+        {
+        public:
+            ///must not throw, it is called inside a parallel region
+            virtual void processBlock(const float* data, const int64_t& dataCount, const int& slot) = 0;
+            
+            virtual ~BlockProcessor() { }
+        };
+        
+        virtual ~DataBlockSource() { }
+        
+        virtual int64_t getNumberOfBlocks() const = 0;
+        
+        ///total number of values in all blocks
+        virtual int64_t getNumberOfValues() const = 0;
+        
+        ///return the data of the block, either from inside the source or from scratch after filling it, only called by one thread at a time
+        virtual const float* getBlock(const int64_t& index, std::vector<float>& scratch, int64_t& dataCountOut) const = 0;
+        
+        ///the number of distinct slots processBlocks uses, so processors can keep one partial result per slot and merge them afterwards
+        static int getNumberOfSlots();
+        
+        ///fetches blocks in order, and processes up to one block per slot in parallel
+        void processBlocks(BlockProcessor& processor) const;
+    };
+    
+    ///blocks from arrays that are already in memory, without copying, large arrays are split so they are still processed in parallel
+    class MemoryBlockSource : public DataBlockSource
+    {
+        struct Block
+        {
+            const float* m_data;
+            int64_t m_count;
+        };
+        std::vector<Block> m_blocks;
+        int64_t m_numValues;
+    public:
+        MemoryBlockSource() { m_numValues = 0; }
+        
+        ///the array must not be changed or freed while the source is in use
+        void addArray(const float* data, const int64_t& dataCount);
+        
+        int64_t getNumberOfBlocks() const { return (int64_t)m_blocks.size(); }
+        
+        int64_t getNumberOfValues() const { return m_numValues; }
+        
+        const float* getBlock(const int64_t& index, std::vector<float>& scratch, int64_t& dataCountOut) const;
+    };
+    
+}
+
+#endif //__DATA_BLOCK_SOURCE_H__
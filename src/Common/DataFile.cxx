@@ -22,6 +22,7 @@
 #include "DataFileContentInformation.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
+#include "ZipArchiveReader.h"
 
 using namespace caret;
 
@@ -214,6 +215,9 @@ DataFile::checkFileReadability(const AString& filename)
     
     FileInformation fileInfo(filename);
     if (fileInfo.exists() == false) {
+        if (ZipArchiveReader::isExistingMemberPath(filename)) {
+            return;//read in place from inside the archive
+        }
         throw DataFileException(filename,
                                 "File does not exist.");
     }
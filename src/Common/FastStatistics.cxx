@@ -20,7 +20,9 @@
 /*LICENSE_END*/
 
 #include "FastStatistics.h"
+#include "CaretAssert.h"
 #include "CaretPointer.h"
+#include "DataBlockSource.h"
 
 #include <algorithm>
 #include <cmath>
@@ -31,6 +33,198 @@ using namespace std;
 
 const int64_t NUM_BUCKETS_PERCENTILE_HIST = 10000;//10,000 maximum to deal with some outliers outliers until I think of a better fix
 
+namespace
+{
+    ///first pass partial results: value classes, ranges, and sum
+    struct StatsPartial
+    {
+        int64_t m_posCount, m_zeroCount, m_negCount, m_infCount, m_negInfCount, m_nanCount;
+        float m_min, m_max, m_mostPos, m_leastPos, m_leastNeg, m_mostNeg, m_leastAbs, m_mostAbs;
+        double m_sum;
+        bool m_first;
+        
+        StatsPartial()
+        {
+            m_posCount = 0;
+            m_zeroCount = 0;
+            m_negCount = 0;
+            m_infCount = 0;
+            m_negInfCount = 0;
+            m_nanCount = 0;
+            m_min = 0.0f;
+            m_max = 0.0f;
+            m_mostPos = 0.0f;
+            m_leastPos = numeric_limits<float>::max();
+            m_leastNeg = -numeric_limits<float>::max();
+            m_mostNeg = 0.0f;
+            m_leastAbs = numeric_limits<float>::max();
+            m_mostAbs = 0.0f;
+            m_sum = 0.0;
+            m_first = true;
+        }
+        
+        void merge(const StatsPartial& other)
+        {
+            m_posCount += other.m_posCount;
+            m_zeroCount += other.m_zeroCount;
+            m_negCount += other.m_negCount;
+            m_infCount += other.m_infCount;
+            m_negInfCount += other.m_negInfCount;
+            m_nanCount += other.m_nanCount;
+            if (!other.m_first)
+            {
+                if (m_first || other.m_min < m_min) m_min = other.m_min;
+                if (m_first || other.m_max > m_max) m_max = other.m_max;
+                m_first = false;
+            }
+            m_mostPos = max(m_mostPos, other.m_mostPos);
+            m_leastPos = min(m_leastPos, other.m_leastPos);
+            m_leastNeg = max(m_leastNeg, other.m_leastNeg);
+            m_mostNeg = min(m_mostNeg, other.m_mostNeg);
+            m_leastAbs = min(m_leastAbs, other.m_leastAbs);
+            m_mostAbs = max(m_mostAbs, other.m_mostAbs);
+            m_sum += other.m_sum;
+        }
+    };
+    
+    class StatsProcessor : public DataBlockSource::BlockProcessor
+    {
+    public:
+        vector<StatsPartial> m_partials;
+        
+        StatsProcessor() : m_partials(DataBlockSource::getNumberOfSlots()) { }
+        
+        void processBlock(const float* data, const int64_t& dataCount, const int& slot)
+        {
+            StatsPartial& partial = m_partials[slot];
+            for (int64_t i = 0; i < dataCount; ++i)
+            {
+                if (data[i] != data[i])
+                {
+                    ++partial.m_nanCount;
+                    continue;
+                }
+                if (data[i] == 0.0f)
+                {
+                    ++partial.m_zeroCount;
+                } else {
+                    if (data[i] < 0.0f)
+                    {
+                        if (data[i] * 2.0f == data[i])
+                        {
+                            ++partial.m_negInfCount;
+                            continue;
+                        }
+                        ++partial.m_negCount;
+                        if (data[i] > partial.m_leastNeg) partial.m_leastNeg = data[i];
+                        if (data[i] < partial.m_mostNeg) partial.m_mostNeg = data[i];
+                        if (-data[i] > partial.m_mostAbs) partial.m_mostAbs = -data[i];
+                        if (-data[i] < partial.m_leastAbs) partial.m_leastAbs = -data[i];
+                    } else {
+                        if (data[i] * 2.0f == data[i])
+                        {
+                            ++partial.m_infCount;
+                            continue;
+                        }
+                        ++partial.m_posCount;
+                        if (data[i] > partial.m_mostPos) partial.m_mostPos = data[i];
+                        if (data[i] < partial.m_leastPos) partial.m_leastPos = data[i];
+                        if (data[i] > partial.m_mostAbs) partial.m_mostAbs = data[i];
+                        if (data[i] < partial.m_leastAbs) partial.m_leastAbs = data[i];
+                    }
+                }
+                if (partial.m_first || data[i] > partial.m_max) partial.m_max = data[i];
+                if (partial.m_first || data[i] < partial.m_min) partial.m_min = data[i];
+                partial.m_sum += data[i];
+                partial.m_first = false;
+            }
+        }
+    };
+    
+    ///second pass partial results: squared deviations, and the percentile histogram buckets
+    struct DeviationPartial
+    {
+        double m_sum2;
+        vector<int64_t> m_posBuckets, m_negBuckets, m_absBuckets;
+        
+        DeviationPartial(const int& numBuckets = 0) : m_posBuckets(numBuckets, 0), m_negBuckets(numBuckets, 0), m_absBuckets(numBuckets, 0)
+        {
+            m_sum2 = 0.0;
+        }
+        
+        void merge(const DeviationPartial& other)
+        {
+            m_sum2 += other.m_sum2;
+            CaretAssert(m_posBuckets.size() == other.m_posBuckets.size());
+            for (int i = 0; i < (int)m_posBuckets.size(); ++i)
+            {
+                m_posBuckets[i] += other.m_posBuckets[i];
+                m_negBuckets[i] += other.m_negBuckets[i];
+                m_absBuckets[i] += other.m_absBuckets[i];
+            }
+        }
+    };
+    
+    ///same bucket math as Histogram, with zero range putting everything in the first bucket for Histogram::setBuckets to split
+    struct BucketRange
+    {
+        float m_min, m_size;
+        int m_numBuckets;
+        
+        BucketRange(const float& rangeMin, const float& rangeMax, const int& numBuckets)
+        {
+            m_min = rangeMin;
+            m_size = (rangeMax - rangeMin) / numBuckets;
+            m_numBuckets = numBuckets;
+        }
+        
+        int getBucket(const float& value) const
+        {
+            if (m_size == 0.0f) return 0;
+            int bucket = (int)((value - m_min) / m_size);
+            if (bucket < 0) bucket = 0;
+            if (bucket >= m_numBuckets) bucket = m_numBuckets - 1;
+            return bucket;
+        }
+    };
+    
+    class DeviationProcessor : public DataBlockSource::BlockProcessor
+    {
+        float m_mean;
+        BucketRange m_posRange, m_negRange, m_absRange;
+    public:
+        vector<DeviationPartial> m_partials;
+        
+        DeviationProcessor(const float& mean, const BucketRange& posRange, const BucketRange& negRange, const BucketRange& absRange)
+        : m_posRange(posRange), m_negRange(negRange), m_absRange(absRange), m_partials(DataBlockSource::getNumberOfSlots(), DeviationPartial(posRange.m_numBuckets))
+        {
+            m_mean = mean;
+        }
+        
+        void processBlock(const float* data, const int64_t& dataCount, const int& slot)
+        {
+            DeviationPartial& partial = m_partials[slot];
+            float tempf;
+            for (int64_t i = 0; i < dataCount; ++i)
+            {
+                if (data[i] != data[i]) continue;//skip NaNs
+                if (data[i] < -1.0f && (data[i] * 2.0f == data[i])) continue;//exclude -inf
+                if (data[i] > 1.0f && (data[i] * 2.0f == data[i])) continue;//exclude inf
+                tempf = data[i] - m_mean;
+                partial.m_sum2 += tempf * tempf;
+                if (data[i] > 0.0f)
+                {
+                    ++partial.m_posBuckets[m_posRange.getBucket(data[i])];
+                    ++partial.m_absBuckets[m_absRange.getBucket(data[i])];
+                } else if (data[i] < 0.0f) {
+                    ++partial.m_negBuckets[m_negRange.getBucket(data[i])];
+                    ++partial.m_absBuckets[m_absRange.getBucket(-data[i])];
+                }
+            }
+        }
+    };
+}
+
 FastStatistics::FastStatistics()
 {
     reset();
@@ -259,6 +453,71 @@ void FastStatistics::update(const float* data, const int64_t& dataCount, const f
     }
 }
 
+void FastStatistics::update(const DataBlockSource& source)
+{
+    reset();
+    StatsProcessor statsProc;
+    source.processBlocks(statsProc);
+    StatsPartial stats = statsProc.m_partials[0];
+    for (int i = 1; i < (int)statsProc.m_partials.size(); ++i)
+    {
+        stats.merge(statsProc.m_partials[i]);
+    }
+    m_posCount = stats.m_posCount;
+    m_zeroCount = stats.m_zeroCount;
+    m_negCount = stats.m_negCount;
+    m_infCount = stats.m_infCount;
+    m_negInfCount = stats.m_negInfCount;
+    m_nanCount = stats.m_nanCount;
+    m_absCount = m_posCount + m_negCount;
+    m_min = stats.m_min;
+    m_max = stats.m_max;
+    m_mostPos = stats.m_mostPos;
+    m_leastPos = stats.m_leastPos;
+    m_leastNeg = stats.m_leastNeg;
+    m_mostNeg = stats.m_mostNeg;
+    m_leastAbs = stats.m_leastAbs;
+    m_mostAbs = stats.m_mostAbs;
+    int64_t totalGood = (m_negCount + m_zeroCount + m_posCount);
+    m_mean = stats.m_sum / totalGood;
+    if (m_negCount <= 0)
+    {
+        m_leastNeg = 0.0;
+        m_mostNeg  = 0.0;
+    }
+    if (m_posCount <= 0)
+    {
+        m_leastPos = 0.0;
+        m_mostPos  = 0.0;
+    }
+    if (m_absCount <= 0)
+    {
+        m_leastAbs = 0.0;
+        m_mostAbs  = 0.0;
+    }
+    int usebuckets = min(NUM_BUCKETS_PERCENTILE_HIST, source.getNumberOfValues());
+    if (usebuckets < 1) return;
+    BucketRange posRange(m_leastPos, m_mostPos, usebuckets), negRange(m_mostNeg, m_leastNeg, usebuckets), absRange(m_leastAbs, m_mostAbs, usebuckets);
+    DeviationProcessor devProc(m_mean, posRange, negRange, absRange);
+    source.processBlocks(devProc);
+    DeviationPartial deviations = devProc.m_partials[0];
+    for (int i = 1; i < (int)devProc.m_partials.size(); ++i)
+    {
+        deviations.merge(devProc.m_partials[i]);
+    }
+    if (totalGood > 0)
+    {
+        m_stdDevPop = sqrt(deviations.m_sum2 / totalGood);
+        if (totalGood > 1)
+        {
+            m_stdDevSample = sqrt(deviations.m_sum2 / (totalGood - 1));
+        }
+    }
+    m_negPercentHist.setBuckets(deviations.m_negBuckets, m_mostNeg, m_leastNeg);
+    m_posPercentHist.setBuckets(deviations.m_posBuckets, m_leastPos, m_mostPos);
+    m_absPercentHist.setBuckets(deviations.m_absBuckets, m_leastAbs, m_mostAbs);
+}
+
 float FastStatistics::getApproxNegativePercentile(const float& percent) const
 {
     float rank = percent / 100.0f * m_negCount;//translate to rank
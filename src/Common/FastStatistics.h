@@ -26,6 +26,8 @@
 namespace caret
 {
     
+    class DataBlockSource;
+    
     ///this class does statistics that are linear in complexity only, NO SORTING, this means its percentiles are approximate, using interpolation from a histogram
     class FastStatistics
     {
@@ -46,6 +48,9 @@ namespace caret
         
         void update(const float* data, const int64_t& dataCount);
         
+        ///for data that shouldn't be copied into one array, blocks are processed in parallel and their partial results merged, reads the source twice
+        void update(const DataBlockSource& source);
+        
         ///statistics and display are really not that related, so for now, only include a continuous clipping range, excluding the middle from data will do weird things to standard deviation
         void update(const float* data, const int64_t& dataCount, const float& minThreshInclusive, const float& maxThreshInclusive);
         
@@ -0,0 +1,122 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "GroupReduction.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+#include "MathFunctions.h"
+
+#include <algorithm>
+
+using namespace caret;
+using namespace std;
+
+GroupReduction::GroupReduction(const int64_t& numElements, const bool& computeVariance, const bool& skipNonNumeric)
+{
+    m_numElements = 0;
+    m_computeVariance = computeVariance;
+    m_skipNonNumeric = skipNonNumeric;
+    reset(numElements);
+}
+
+void GroupReduction::reset(const int64_t& numElements)
+{
+    if (numElements >= 0) m_numElements = numElements;
+    m_weightSum.assign(m_numElements, 0.0);
+    m_weightedSum.assign(m_numElements, 0.0);
+    if (m_computeVariance)
+    {
+        m_weightSquaredSum.assign(m_numElements, 0.0);
+        m_residSquared.assign(m_numElements, 0.0);
+    }
+}
+
+void GroupReduction::addInput(const float* data, const float& weight, const float* excludeMask)
+{
+    CaretAssert(data != NULL);
+    const int64_t numElements = m_numElements;//so the loop bound is a local
+    const bool skipNonNumeric = m_skipNonNumeric;
+    if (m_computeVariance)
+    {
+#pragma omp CARET_PARFOR schedule(static)
+        for (int64_t k = 0; k < numElements; ++k)
+        {
+            if ((!skipNonNumeric || MathFunctions::isNumeric(data[k])) && (excludeMask == NULL || !(excludeMask[k] > 0.0f)))
+            {
+                double oldWeight = m_weightSum[k];
+                double newWeight = oldWeight + weight;
+                if (newWeight != 0.0)//zero or negative weights can cancel, leaving nothing to normalize by, but the sums must still match the mean-only case
+                {
+                    double oldMean = (oldWeight != 0.0 ? m_weightedSum[k] / oldWeight : 0.0);
+                    double delta = data[k] - oldMean;
+                    double newMean = oldMean + delta * weight / newWeight;
+                    m_residSquared[k] += weight * delta * (data[k] - newMean);//West's weighted incremental update
+                }
+                m_weightSquaredSum[k] += (double)weight * weight;
+                m_weightSum[k] = newWeight;
+                m_weightedSum[k] += data[k] * weight;
+            }
+        }
+    } else {
+#pragma omp CARET_PARFOR schedule(static)
+        for (int64_t k = 0; k < numElements; ++k)
+        {
+            if ((!skipNonNumeric || MathFunctions::isNumeric(data[k])) && (excludeMask == NULL || !(excludeMask[k] > 0.0f)))
+            {
+                m_weightSum[k] += weight;
+                m_weightedSum[k] += data[k] * weight;
+            }
+        }
+    }
+}
+
+void GroupReduction::getMean(float* meanOut) const
+{
+    CaretAssert(meanOut != NULL);
+    for (int64_t k = 0; k < m_numElements; ++k)
+    {
+        if (m_weightSum[k] != 0.0)
+        {
+            meanOut[k] = m_weightedSum[k] / m_weightSum[k];
+        } else {
+            meanOut[k] = 0.0f;
+        }
+    }
+}
+
+void GroupReduction::getVariance(float* varianceOut, const bool& sample) const
+{
+    CaretAssert(varianceOut != NULL);
+    CaretAssert(m_computeVariance);
+    for (int64_t k = 0; k < m_numElements; ++k)
+    {
+        double denom = m_weightSum[k];
+        if (sample && denom != 0.0)
+        {
+            denom -= m_weightSquaredSum[k] / m_weightSum[k];//reliability weights: V1 - V2 / V1
+        }
+        if (denom > 0.0)
+        {
+            varianceOut[k] = max(0.0, m_residSquared[k] / denom);//rounding can make a tiny negative, with negative weights
+        } else {
+            varianceOut[k] = 0.0f;
+        }
+    }
+}
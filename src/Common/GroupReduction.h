@@ -0,0 +1,55 @@
+#ifndef __GROUP_REDUCTION_H__
+#define __GROUP_REDUCTION_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stddef.h"
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+    
+    ///accumulates a weighted mean and variance per element across a group of inputs, one input block at a time, so each input can be read contiguously
+    class GroupReduction
+    {
+        int64_t m_numElements;
+        bool m_computeVariance, m_skipNonNumeric;
+        std::vector<double> m_weightSum, m_weightedSum, m_weightSquaredSum, m_residSquared;//last two only with variance, m_residSquared is West's weighted sum of squared residuals
+    public:
+        ///with skipNonNumeric false, NaN and inf are accumulated like any other value, and propagate to the results
+        GroupReduction(const int64_t& numElements = 0, const bool& computeVariance = false, const bool& skipNonNumeric = true);
+        ///clear the accumulators, and change the number of elements if requested
+        void reset(const int64_t& numElements = -1);
+        int64_t getNumberOfElements() const { return m_numElements; }
+        bool isComputingVariance() const { return m_computeVariance; }
+        ///add one input's values for every element, elements where excludeMask is positive are skipped, as are non-numeric values unless disabled
+        void addInput(const float* data, const float& weight = 1.0f, const float* excludeMask = NULL);
+        ///weighted mean of the included values, elements without any included weight get zero
+        void getMean(float* meanOut) const;
+        ///population weighted variance if not sample, otherwise unbiased for reliability weights (equal to sample variance when all weights are 1), zero where undefined
+        void getVariance(float* varianceOut, const bool& sample = true) const;
+        ///total included weight per element
+        const double* getWeightSums() const { return m_weightSum.data(); }
+    };
+    
+}
+
+#endif //__GROUP_REDUCTION_H__
@@ -21,11 +21,246 @@
 
 #include "Histogram.h"
 #include "CaretAssert.h"
+#include "DataBlockSource.h"
 #include <cmath>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    ///partial results from the blocks processed in one slot
+    struct HistogramPartial
+    {
+        int64_t m_posCount, m_zeroCount, m_negCount, m_infCount, m_negInfCount, m_nanCount, m_equalCount;
+        float m_min, m_max;
+        bool m_first;
+        vector<int64_t> m_buckets;
+        
+        HistogramPartial(const int& numBuckets = 0) : m_buckets(numBuckets, 0)
+        {
+            m_posCount = 0;
+            m_zeroCount = 0;
+            m_negCount = 0;
+            m_infCount = 0;
+            m_negInfCount = 0;
+            m_nanCount = 0;
+            m_equalCount = 0;
+            m_min = 0.0f;
+            m_max = 0.0f;
+            m_first = true;
+        }
+        
+        void merge(const HistogramPartial& other)
+        {
+            m_posCount += other.m_posCount;
+            m_zeroCount += other.m_zeroCount;
+            m_negCount += other.m_negCount;
+            m_infCount += other.m_infCount;
+            m_negInfCount += other.m_negInfCount;
+            m_nanCount += other.m_nanCount;
+            m_equalCount += other.m_equalCount;
+            if (!other.m_first)
+            {
+                if (m_first || other.m_min < m_min) m_min = other.m_min;
+                if (m_first || other.m_max > m_max) m_max = other.m_max;
+                m_first = false;
+            }
+            CaretAssert(m_buckets.size() == other.m_buckets.size());
+            for (int i = 0; i < (int)m_buckets.size(); ++i)
+            {
+                m_buckets[i] += other.m_buckets[i];
+            }
+        }
+    };
+    
+    class HistogramProcessor : public DataBlockSource::BlockProcessor
+    {
+    protected:
+        vector<HistogramPartial> m_partials;
+    public:
+        HistogramProcessor(const int& numBuckets) : m_partials(DataBlockSource::getNumberOfSlots(), HistogramPartial(numBuckets)) { }
+        
+        HistogramPartial getMerged() const
+        {
+            HistogramPartial ret = m_partials[0];
+            for (int i = 1; i < (int)m_partials.size(); ++i)
+            {
+                ret.merge(m_partials[i]);
+            }
+            return ret;
+        }
+    };
+    
+    ///first pass of the unlimited histogram: value classes and range
+    class RangeProcessor : public HistogramProcessor
+    {
+    public:
+        RangeProcessor() : HistogramProcessor(0) { }
+        
+        void processBlock(const float* data, const int64_t& dataCount, const int& slot)
+        {
+            HistogramPartial& partial = m_partials[slot];
+            for (int64_t i = 0; i < dataCount; ++i)
+            {
+                if (data[i] != data[i])
+                {
+                    ++partial.m_nanCount;
+                    continue;
+                }
+                if (data[i] == 0.0f)
+                {
+                    ++partial.m_zeroCount;
+                } else {
+                    if (data[i] < 0.0f)
+                    {
+                        if (data[i] * 2.0f == data[i])
+                        {
+                            ++partial.m_negInfCount;
+                            continue;
+                        }
+                        ++partial.m_negCount;
+                    } else {
+                        if (data[i] * 2.0f == data[i])
+                        {
+                            ++partial.m_infCount;
+                            continue;
+                        }
+                        ++partial.m_posCount;
+                    }
+                }
+                if (partial.m_first || data[i] < partial.m_min) partial.m_min = data[i];
+                if (partial.m_first || data[i] > partial.m_max) partial.m_max = data[i];
+                partial.m_first = false;
+            }
+        }
+    };
+    
+    ///second pass of the unlimited histogram, once the range is known
+    class BucketProcessor : public HistogramProcessor
+    {
+        int m_numBuckets;
+        float m_bucketMin, m_bucketSize;
+    public:
+        BucketProcessor(const int& numBuckets, const float& bucketMin, const float& bucketSize) : HistogramProcessor(numBuckets)
+        {
+            m_numBuckets = numBuckets;
+            m_bucketMin = bucketMin;
+            m_bucketSize = bucketSize;
+        }
+        
+        void processBlock(const float* data, const int64_t& dataCount, const int& slot)
+        {
+            vector<int64_t>& buckets = m_partials[slot].m_buckets;
+            for (int64_t i = 0; i < dataCount; ++i)
+            {
+                if (data[i] != data[i]) continue;//exclude NaN
+                if (data[i] < -1.0f && (data[i] * 2.0f == data[i])) continue;//exclude -inf
+                if (data[i] > 1.0f && (data[i] * 2.0f == data[i])) continue;//exclude inf
+                int bucket = (int)((data[i] - m_bucketMin) / m_bucketSize);
+                if (bucket < 0) bucket = 0;
+                if (bucket >= m_numBuckets) bucket = m_numBuckets - 1;
+                ++buckets[bucket];
+            }
+        }
+    };
+    
+    ///the limited histogram, only needs one pass
+    class LimitedBucketProcessor : public HistogramProcessor
+    {
+        int m_numBuckets;
+        float m_bucketMin, m_bucketSize;
+        float m_mostPos, m_leastPos, m_leastNeg, m_mostNeg;
+        bool m_includeZero;
+    public:
+        LimitedBucketProcessor(const int& numBuckets, const float& bucketMin, const float& bucketSize,
+                               const float& mostPos, const float& leastPos, const float& leastNeg, const float& mostNeg, const bool& includeZero) : HistogramProcessor(numBuckets)
+        {
+            m_numBuckets = numBuckets;
+            m_bucketMin = bucketMin;
+            m_bucketSize = bucketSize;
+            m_mostPos = mostPos;
+            m_leastPos = leastPos;
+            m_leastNeg = leastNeg;
+            m_mostNeg = mostNeg;
+            m_includeZero = includeZero;
+        }
+        
+        void processBlock(const float* data, const int64_t& dataCount, const int& slot)
+        {
+            HistogramPartial& partial = m_partials[slot];
+            for (int64_t i = 0; i < dataCount; ++i)
+            {
+                if (data[i] != data[i])
+                {
+                    ++partial.m_nanCount;
+                    continue;
+                }
+                if (data[i] == 0.0f)
+                {
+                    if (!m_includeZero) continue;
+                    ++partial.m_zeroCount;
+                } else {
+                    if (data[i] < 0.0f)
+                    {
+                        if (data[i] * 2.0f == data[i])
+                        {
+                            ++partial.m_negInfCount;
+                            continue;
+                        }
+                        if (data[i] > m_leastNeg || data[i] < m_mostNeg) continue;
+                        ++partial.m_negCount;
+                    } else {
+                        if (data[i] * 2.0f == data[i])
+                        {
+                            ++partial.m_infCount;
+                            continue;
+                        }
+                        if (data[i] > m_mostPos || data[i] < m_leastPos) continue;
+                        ++partial.m_posCount;
+                    }
+                }
+                int bucket = (int)((data[i] - m_bucketMin) / m_bucketSize);
+                if (bucket < 0) bucket = 0;
+                if (bucket >= m_numBuckets) bucket = m_numBuckets - 1;
+                ++partial.m_buckets[bucket];
+            }
+        }
+    };
+    
+    ///for a bad or empty limited range, only counts
+    class EqualCountProcessor : public HistogramProcessor
+    {
+        float m_value;
+    public:
+        EqualCountProcessor(const float& value) : HistogramProcessor(0) { m_value = value; }
+        
+        void processBlock(const float* data, const int64_t& dataCount, const int& slot)
+        {
+            HistogramPartial& partial = m_partials[slot];
+            for (int64_t i = 0; i < dataCount; ++i)
+            {
+                if (data[i] != data[i])
+                {
+                    ++partial.m_nanCount;
+                    continue;
+                }
+                if (data[i] < -1.0f && (data[i] * 2.0f == data[i]))
+                {
+                    ++partial.m_negInfCount;
+                    continue;
+                }
+                if (data[i] > 1.0f && (data[i] * 2.0f == data[i]))
+                {
+                    ++partial.m_infCount;
+                    continue;
+                }
+                if (data[i] == m_value) ++partial.m_equalCount;
+            }
+        }
+    };
+}
+
 Histogram::Histogram(const int& numBuckets)
 {
     resize(numBuckets);
@@ -137,24 +372,7 @@ void Histogram::update(const float* data, const int64_t& dataCount)
     }
     if (m_bucketMin == m_bucketMax)
     {
-        int64_t totalValid = m_negCount + m_posCount + m_zeroCount;
-        for (int i = 0; i < numBuckets - 1; ++i)
-        {
-            m_cumulative[i] = (i + 1) * totalValid / numBuckets;//so, its not particularly useful if our range is zero, but split them evenly among buckets just for kicks
-            if (i == 0)
-            {
-                m_buckets[i] = m_cumulative[i];
-            } else {
-                m_buckets[i] = m_cumulative[i] - m_cumulative[i - 1];
-            }
-        }//display is already zeroed, so just return
-        m_cumulative[numBuckets - 1] = totalValid;//make sure the last one has all of them
-        if (numBuckets > 1)
-        {
-            m_buckets[numBuckets - 1] = m_cumulative[numBuckets - 1] - m_cumulative[numBuckets - 2];
-        } else {
-            m_buckets[numBuckets - 1] = m_cumulative[numBuckets - 1];
-        }
+        splitEvenly(m_negCount + m_posCount + m_zeroCount);
         return;
     }
     float bucketsize = (m_bucketMax - m_bucketMin) / numBuckets;
@@ -182,24 +400,7 @@ void Histogram::update(const float* data, const int64_t& dataCount, float mostPo
 {
     int numBuckets = (int)m_buckets.size();
     reset();
-    if (mostNegativeValueInclusive > 0.0f) mostNegativeValueInclusive = 0.0f;//sanity check the inputs without asserting
-    if (mostPositiveValueInclusive < 0.0f) mostPositiveValueInclusive = 0.0f;
-    if (leastNegativeValueInclusive > 0.0f) leastNegativeValueInclusive = 0.0f;
-    if (leastPositiveValueInclusive < 0.0f) leastPositiveValueInclusive = 0.0f;
-    if ((mostPositiveValueInclusive >= leastPositiveValueInclusive && mostPositiveValueInclusive != 0.0f) || includeZeroValues)
-    {
-        m_bucketMax = mostPositiveValueInclusive;
-    } else {
-        m_bucketMax = leastNegativeValueInclusive;
-    }
-    if (mostNegativeValueInclusive != 0.0f || includeZeroValues)
-    {
-        m_bucketMin = mostNegativeValueInclusive;
-    } else {
-        m_bucketMin = leastPositiveValueInclusive;
-    }
-    float sanity = m_bucketMax + m_bucketMin;
-    if (m_bucketMax <= m_bucketMin || sanity != sanity)
+    if (!setLimitedRange(mostPositiveValueInclusive, leastPositiveValueInclusive, leastNegativeValueInclusive, mostNegativeValueInclusive, includeZeroValues))
     {//bad input ranges, so collect counts, make a mock histogram if equal, and return (display values will be zeros)
         int64_t equalCount = 0;
         for (int64_t i = 0; i < dataCount; ++i)
@@ -237,23 +438,7 @@ void Histogram::update(const float* data, const int64_t& dataCount, float mostPo
                     m_posCount = equalCount;
                 }
             }
-            for (int i = 0; i < numBuckets - 1; ++i)
-            {
-                m_cumulative[i] = (i + 1) * equalCount / numBuckets;//so, its not particularly useful if our range is zero, but split them evenly among buckets just for kicks
-                if (i == 0)
-                {
-                    m_buckets[i] = m_cumulative[i];
-                } else {
-                    m_buckets[i] = m_cumulative[i] - m_cumulative[i - 1];
-                }
-            }//display is already zeroed, so just return
-            m_cumulative[numBuckets - 1] = equalCount;//make sure the last one has all of them
-            if (numBuckets > 1)
-            {
-                m_buckets[numBuckets - 1] = m_cumulative[numBuckets - 1] - m_cumulative[numBuckets - 2];
-            } else {
-                m_buckets[numBuckets - 1] = m_cumulative[numBuckets - 1];
-            }
+            splitEvenly(equalCount);
         }
         return;
     }
@@ -314,3 +499,161 @@ void Histogram::computeCumulative()
         m_cumulative[i] = accum;
     }
 }
+
+void Histogram::splitEvenly(const int64_t& count)
+{
+    int numBuckets = (int)m_buckets.size();
+    for (int i = 0; i < numBuckets - 1; ++i)
+    {
+        m_cumulative[i] = (i + 1) * count / numBuckets;//so, its not particularly useful if our range is zero, but split them evenly among buckets just for kicks
+        if (i == 0)
+        {
+            m_buckets[i] = m_cumulative[i];
+        } else {
+            m_buckets[i] = m_cumulative[i] - m_cumulative[i - 1];
+        }
+    }//display is already zeroed
+    m_cumulative[numBuckets - 1] = count;//make sure the last one has all of them
+    if (numBuckets > 1)
+    {
+        m_buckets[numBuckets - 1] = m_cumulative[numBuckets - 1] - m_cumulative[numBuckets - 2];
+    } else {
+        m_buckets[numBuckets - 1] = m_cumulative[numBuckets - 1];
+    }
+}
+
+bool Histogram::setLimitedRange(float& mostPositiveValueInclusive, float& leastPositiveValueInclusive, float& leastNegativeValueInclusive,
+                                float& mostNegativeValueInclusive, const bool& includeZeroValues)
+{
+    if (mostNegativeValueInclusive > 0.0f) mostNegativeValueInclusive = 0.0f;//sanity check the inputs without asserting
+    if (mostPositiveValueInclusive < 0.0f) mostPositiveValueInclusive = 0.0f;
+    if (leastNegativeValueInclusive > 0.0f) leastNegativeValueInclusive = 0.0f;
+    if (leastPositiveValueInclusive < 0.0f) leastPositiveValueInclusive = 0.0f;
+    if ((mostPositiveValueInclusive >= leastPositiveValueInclusive && mostPositiveValueInclusive != 0.0f) || includeZeroValues)
+    {
+        m_bucketMax = mostPositiveValueInclusive;
+    } else {
+        m_bucketMax = leastNegativeValueInclusive;
+    }
+    if (mostNegativeValueInclusive != 0.0f || includeZeroValues)
+    {
+        m_bucketMin = mostNegativeValueInclusive;
+    } else {
+        m_bucketMin = leastPositiveValueInclusive;
+    }
+    float sanity = m_bucketMax + m_bucketMin;
+    return !(m_bucketMax <= m_bucketMin || sanity != sanity);
+}
+
+void Histogram::update(const DataBlockSource& source)
+{
+    int numBuckets = (int)m_buckets.size();
+    reset();
+    RangeProcessor rangeProc;
+    source.processBlocks(rangeProc);
+    HistogramPartial counts = rangeProc.getMerged();
+    m_posCount = counts.m_posCount;
+    m_zeroCount = counts.m_zeroCount;
+    m_negCount = counts.m_negCount;
+    m_infCount = counts.m_infCount;
+    m_negInfCount = counts.m_negInfCount;
+    m_nanCount = counts.m_nanCount;
+    if (counts.m_first)
+    {
+        m_bucketMin = m_bucketMax = 0.0f;
+        return;
+    }
+    m_bucketMin = counts.m_min;
+    m_bucketMax = counts.m_max;
+    if (m_bucketMin == m_bucketMax)
+    {
+        splitEvenly(m_negCount + m_posCount + m_zeroCount);
+        return;
+    }
+    BucketProcessor bucketProc(numBuckets, m_bucketMin, (m_bucketMax - m_bucketMin) / numBuckets);
+    source.processBlocks(bucketProc);
+    HistogramPartial merged = bucketProc.getMerged();
+    m_buckets = merged.m_buckets;
+    computeCumulative();
+    float bucketsize = (m_bucketMax - m_bucketMin) / numBuckets;
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        m_display[i] = m_buckets[i] / bucketsize;
+    }
+}
+
+void Histogram::update(const DataBlockSource& source, float mostPositiveValueInclusive,
+                       float leastPositiveValueInclusive, float leastNegativeValueInclusive,
+                       float mostNegativeValueInclusive, const bool& includeZeroValues)
+{
+    int numBuckets = (int)m_buckets.size();
+    reset();
+    if (!setLimitedRange(mostPositiveValueInclusive, leastPositiveValueInclusive, leastNegativeValueInclusive, mostNegativeValueInclusive, includeZeroValues))
+    {//same as the array version, counts only, and a mock histogram if equal
+        EqualCountProcessor equalProc(m_bucketMax);
+        source.processBlocks(equalProc);
+        HistogramPartial counts = equalProc.getMerged();
+        m_nanCount = counts.m_nanCount;
+        m_negInfCount = counts.m_negInfCount;
+        m_infCount = counts.m_infCount;
+        if (m_bucketMax == m_bucketMin)
+        {
+            if (m_bucketMax == 0.0f)
+            {
+                m_zeroCount = counts.m_equalCount;
+            } else {
+                if (m_bucketMax < 0.0f)
+                {
+                    m_negCount = counts.m_equalCount;
+                } else {
+                    m_posCount = counts.m_equalCount;
+                }
+            }
+            splitEvenly(counts.m_equalCount);
+        }
+        return;
+    }
+    float bucketsize = (m_bucketMax - m_bucketMin) / numBuckets;
+    LimitedBucketProcessor bucketProc(numBuckets, m_bucketMin, bucketsize, mostPositiveValueInclusive, leastPositiveValueInclusive,
+                                      leastNegativeValueInclusive, mostNegativeValueInclusive, includeZeroValues);
+    source.processBlocks(bucketProc);
+    HistogramPartial merged = bucketProc.getMerged();
+    m_posCount = merged.m_posCount;
+    m_zeroCount = merged.m_zeroCount;
+    m_negCount = merged.m_negCount;
+    m_infCount = merged.m_infCount;
+    m_negInfCount = merged.m_negInfCount;
+    m_nanCount = merged.m_nanCount;
+    m_buckets = merged.m_buckets;
+    computeCumulative();
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        m_display[i] = m_buckets[i] / bucketsize;
+    }
+}
+
+void Histogram::setBuckets(const vector<int64_t>& bucketCounts, const float& bucketMin, const float& bucketMax)
+{
+    int numBuckets = (int)bucketCounts.size();
+    resize(numBuckets);
+    reset();
+    m_bucketMin = bucketMin;
+    m_bucketMax = bucketMax;
+    if (bucketMin == bucketMax)
+    {
+        int64_t total = 0;
+        for (int i = 0; i < numBuckets; ++i)
+        {
+            total += bucketCounts[i];
+        }
+        splitEvenly(total);
+        return;
+    }
+    m_buckets = bucketCounts;
+    computeCumulative();
+    float bucketsize = (m_bucketMax - m_bucketMin) / numBuckets;
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        m_display[i] = m_buckets[i] / bucketsize;
+    }
+}
@@ -27,6 +27,8 @@
 namespace caret
 {
     
+    class DataBlockSource;
+    
     class Histogram
     {
         std::vector<int64_t> m_buckets, m_cumulative;
@@ -41,6 +43,12 @@ namespace caret
         
         void computeCumulative();
         
+        void splitEvenly(const int64_t& count);
+        
+        ///sanitizes the limits and sets the bucket range, returns false if the range is empty or invalid
+        bool setLimitedRange(float& mostPositiveValueInclusive, float& leastPositiveValueInclusive, float& leastNegativeValueInclusive,
+                             float& mostNegativeValueInclusive, const bool& includeZeroValues);
+        
     public:
         Histogram(const int& numBuckets = 100);
         
@@ -60,6 +68,20 @@ namespace caret
                     float mostNegativeValueInclusive,
                     const bool& includeZeroValues);
         
+        ///for data that shouldn't be copied into one array, blocks are processed in parallel and their partial histograms merged, reads the source twice
+        void update(const DataBlockSource& source);
+        
+        ///reads the source once, since the range is given
+        void update(const DataBlockSource& source,
+                    float mostPositiveValueInclusive,
+                    float leastPositiveValueInclusive,
+                    float leastNegativeValueInclusive,
+                    float mostNegativeValueInclusive,
+                    const bool& includeZeroValues);
+        
+        ///set from bucket counts accumulated elsewhere (such as merged partial histograms), value class counts are left at zero
+        void setBuckets(const std::vector<int64_t>& bucketCounts, const float& bucketMin, const float& bucketMax);
+        
         ///get raw counts (useful mathematically)
         const std::vector<int64_t>& getHistogramCounts() const { return m_buckets; }
         
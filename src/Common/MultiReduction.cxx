@@ -0,0 +1,417 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "MultiReduction.h"
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "MathFunctions.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+using namespace caret;
+using namespace std;
+
+MultiReduction::Accumulator::Accumulator()
+{
+    m_count = 0;
+    m_countNonzero = 0;
+    m_indexMin = -1;
+    m_indexMax = -1;
+    m_sum = 0.0;
+    m_product = 1.0;
+    m_mean = 0.0;
+    m_m2 = 0.0;
+    m_min = 0.0f;
+    m_max = 0.0f;
+}
+
+void MultiReduction::Accumulator::add(const float& value)
+{
+    if (m_count == 0)
+    {
+        m_min = value;
+        m_max = value;
+        m_indexMin = 0;
+        m_indexMax = 0;
+    } else {
+        if (value < m_min)
+        {
+            m_min = value;
+            m_indexMin = m_count;
+        }
+        if (value > m_max)
+        {
+            m_max = value;
+            m_indexMax = m_count;
+        }
+    }
+    ++m_count;
+    if (value != 0.0f) ++m_countNonzero;
+    m_sum += value;
+    m_product *= value;
+    double delta = value - m_mean;
+    m_mean += delta / m_count;
+    m_m2 += delta * (value - m_mean);
+}
+
+void MultiReduction::Accumulator::merge(const Accumulator& rhs)
+{
+    if (rhs.m_count == 0) return;
+    if (m_count == 0)
+    {
+        *this = rhs;
+        return;
+    }
+    if (rhs.m_min < m_min)//ties keep the earlier index, like a sequential scan
+    {
+        m_min = rhs.m_min;
+        m_indexMin = rhs.m_indexMin + m_count;
+    }
+    if (rhs.m_max > m_max)
+    {
+        m_max = rhs.m_max;
+        m_indexMax = rhs.m_indexMax + m_count;
+    }
+    int64_t newCount = m_count + rhs.m_count;
+    double delta = rhs.m_mean - m_mean;
+    m_m2 += rhs.m_m2 + delta * delta * ((double)m_count * rhs.m_count / newCount);
+    m_mean += delta * rhs.m_count / newCount;
+    m_count = newCount;
+    m_countNonzero += rhs.m_countNonzero;
+    m_sum += rhs.m_sum;
+    m_product *= rhs.m_product;
+}
+
+float MultiReduction::Accumulator::getResult(const ReductionEnum::Enum& type) const
+{
+    if (m_count == 0) throw CaretException("reduction requested on empty data");
+    switch (type)
+    {
+        case ReductionEnum::INVALID:
+            throw CaretException("reduction requested with 'INVALID' method");
+        case ReductionEnum::MEDIAN:
+        case ReductionEnum::MODE:
+            throw CaretException("'" + ReductionEnum::toName(type) + "' reduction requires all values, it can't be computed from a streaming accumulator");
+        case ReductionEnum::SAMPSTDEV:
+        case ReductionEnum::TSNR:
+        case ReductionEnum::COV:
+            if (m_count < 2) throw CaretException("taking the sample standard deviation of 1 element would require dividing by zero");
+            break;
+        default:
+            break;
+    }
+    switch (type)
+    {
+        case ReductionEnum::MAX:
+            return m_max;
+        case ReductionEnum::MIN:
+            return m_min;
+        case ReductionEnum::INDEXMAX:
+            return m_indexMax + 1;//1-based, to match gui and column arguments
+        case ReductionEnum::INDEXMIN:
+            return m_indexMin + 1;
+        case ReductionEnum::SUM:
+            return m_sum;
+        case ReductionEnum::MEAN:
+            return m_sum / m_count;
+        case ReductionEnum::STDEV:
+            return sqrt(m_m2 / m_count);
+        case ReductionEnum::SAMPSTDEV:
+            return sqrt(m_m2 / (m_count - 1));
+        case ReductionEnum::VARIANCE:
+            return m_m2 / m_count;
+        case ReductionEnum::TSNR:
+            return (m_sum / m_count) / sqrt(m_m2 / (m_count - 1));
+        case ReductionEnum::COV:
+            return sqrt(m_m2 / (m_count - 1)) / (m_sum / m_count);
+        case ReductionEnum::PRODUCT:
+            return m_product;
+        case ReductionEnum::COUNT_NONZERO:
+            return m_countNonzero;
+        default:
+            CaretAssertMessage(0, "unhandled type in streaming reduction");
+            return 0.0f;
+    }
+}
+
+void MultiReduction::addReduction(const ReductionEnum::Enum& type)
+{
+    if (type == ReductionEnum::INVALID) throw CaretException("reduction requested with 'INVALID' method");
+    m_reductions.push_back(type);
+}
+
+void MultiReduction::addPercentile(const float& percent)
+{
+    if (!(percent >= 0.0f && percent <= 100.0f)) throw CaretException("percentile must be between 0 and 100");//use not within range to trap NaNs
+    m_percentiles.push_back(percent);
+}
+
+AString MultiReduction::getResultName(const int& index) const
+{
+    CaretAssert(index >= 0 && index < getNumberOfResults());
+    int numReductions = (int)m_reductions.size();
+    if (index < numReductions) return ReductionEnum::toName(m_reductions[index]);
+    return "PERCENTILE_" + AString::number(m_percentiles[index - numReductions]);
+}
+
+bool MultiReduction::isStreamable() const
+{
+    if (!m_percentiles.empty()) return false;
+    for (int i = 0; i < (int)m_reductions.size(); ++i)
+    {
+        if (m_reductions[i] == ReductionEnum::MEDIAN || m_reductions[i] == ReductionEnum::MODE) return false;
+    }
+    return true;
+}
+
+void MultiReduction::getResults(const Accumulator& myAccum, float* resultsOut) const
+{
+    CaretAssert(isStreamable());
+    for (int i = 0; i < (int)m_reductions.size(); ++i)
+    {
+        resultsOut[i] = myAccum.getResult(m_reductions[i]);
+    }
+}
+
+float MultiReduction::computeMode(const float* data, const int64_t& numElems)
+{
+    QHash<quint32, int64_t> counts;//hash on the bit pattern, as there is no float hash
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        float value = data[i];
+        if (value == 0.0f) value = 0.0f;//count negative zero with zero, as sorting did
+        quint32 bits;
+        memcpy(&bits, &value, sizeof(float));
+        ++counts[bits];
+    }
+    int64_t bestCount = 0;
+    float bestVal = -1.0f;
+    for (QHash<quint32, int64_t>::const_iterator iter = counts.constBegin(); iter != counts.constEnd(); ++iter)
+    {
+        float value;
+        quint32 bits = iter.key();
+        memcpy(&value, &bits, sizeof(float));
+        if (iter.value() > bestCount || (iter.value() == bestCount && value < bestVal))
+        {//ties go to the smallest value, as the old sort-based method did
+            bestCount = iter.value();
+            bestVal = value;
+        }
+    }
+    return bestVal;
+}
+
+float MultiReduction::computeTwoPassMoment(const ReductionEnum::Enum& type, const float& mean, const double& residsqr, const int64_t& numElems)
+{//same arithmetic as ReductionOperation, including the float mean, so whole-array results match it exactly
+    switch (type)
+    {
+        case ReductionEnum::STDEV:
+            return sqrt(residsqr / numElems);
+        case ReductionEnum::SAMPSTDEV:
+            return sqrt(residsqr / (numElems - 1));
+        case ReductionEnum::VARIANCE:
+            return residsqr / numElems;
+        case ReductionEnum::TSNR:
+            return mean / sqrt(residsqr / (numElems - 1));
+        case ReductionEnum::COV:
+            return sqrt(residsqr / (numElems - 1)) / mean;
+        default:
+            CaretAssertMessage(0, "unhandled type in two-pass moment");
+            return 0.0f;
+    }
+}
+
+void MultiReduction::computeOnlyNumeric(const float* data, const int64_t& numElems, float* resultsOut) const
+{
+    vector<float> excluded;
+    vector<int64_t> indices;
+    excluded.reserve(numElems);
+    indices.reserve(numElems);
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        if (MathFunctions::isNumeric(data[i]))
+        {
+            excluded.push_back(data[i]);
+            indices.push_back(i);
+        }
+    }
+    if (excluded.empty()) throw CaretException("all input values were non-numeric");
+    compute(excluded.data(), excluded.size(), resultsOut, indices.data());
+}
+
+void MultiReduction::computeExcludeDev(const float* data, const int64_t& numElems, float* resultsOut, const float& numDevBelow, const float& numDevAbove) const
+{
+    double sum = 0.0;
+    int64_t validNum = 0;
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        if (MathFunctions::isNumeric(data[i]))
+        {
+            ++validNum;
+            sum += data[i];
+        }
+    }
+    if (validNum == 0) throw CaretException("all input values were non-numeric");
+    float mean = sum / validNum;//two passes, as ReductionOperation::reduceExcludeDev, so the same values are excluded
+    double residsqr = 0.0;
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        if (MathFunctions::isNumeric(data[i]))
+        {
+            float tempf = data[i] - mean;
+            residsqr += tempf * tempf;
+        }
+    }
+    float stdev = computeTwoPassMoment(ReductionEnum::STDEV, mean, residsqr, validNum);
+    float low = mean - numDevBelow * stdev, high = mean + numDevAbove * stdev;
+    vector<float> excluded;
+    vector<int64_t> indices;
+    excluded.reserve(validNum);
+    indices.reserve(validNum);
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        if (MathFunctions::isNumeric(data[i]) && data[i] >= low && data[i] <= high)
+        {
+            excluded.push_back(data[i]);
+            indices.push_back(i);
+        }
+    }
+    if (excluded.empty()) throw CaretException("exclusion parameters resulted in no usable data");
+    compute(excluded.data(), excluded.size(), resultsOut, indices.data());
+}
+
+void MultiReduction::compute(const float* data, const int64_t& numElems, float* resultsOut, const int64_t* originalIndices) const
+{
+    if (numElems < 1) throw CaretException("reduction requested on empty data");
+    Accumulator myAccum;
+    for (int64_t i = 0; i < numElems; ++i)
+    {
+        myAccum.add(data[i]);
+    }
+    int numReductions = (int)m_reductions.size(), numPercentiles = (int)m_percentiles.size();
+    map<int64_t, float> ranked;//order statistics by rank, filled by selection
+    bool needRanked = (numPercentiles > 0);
+    for (int i = 0; i < numReductions; ++i)
+    {
+        if (m_reductions[i] == ReductionEnum::MEDIAN)
+        {
+            needRanked = true;
+            ranked[numElems / 2] = 0.0f;
+            if ((numElems & 1) == 0) ranked[numElems / 2 - 1] = 0.0f;
+        }
+    }
+    vector<double> percentIndex(numPercentiles);//double, so ranks stay exact beyond 2^24 elements
+    for (int i = 0; i < numPercentiles; ++i)
+    {
+        percentIndex[i] = m_percentiles[i] / 100.0 * (numElems - 1);
+        if (percentIndex[i] <= 0)
+        {
+            ranked[0] = 0.0f;
+        } else if (percentIndex[i] >= numElems - 1) {
+            ranked[numElems - 1] = 0.0f;
+        } else {
+            int64_t lower = (int64_t)floor(percentIndex[i]);
+            ranked[lower] = 0.0f;
+            ranked[lower + 1] = 0.0f;
+        }
+    }
+    if (needRanked)
+    {
+        vector<float> scratch(data, data + numElems);
+        vector<float>::iterator searchStart = scratch.begin();
+        for (map<int64_t, float>::iterator iter = ranked.begin(); iter != ranked.end(); ++iter)
+        {//ranks in increasing order, each selection only needs to look above the previous rank
+            vector<float>::iterator nth = scratch.begin() + iter->first;
+            nth_element(searchStart, nth, scratch.end());
+            iter->second = *nth;
+            searchStart = nth + 1;
+        }
+    }
+    bool haveResid = false;
+    float twoPassMean = 0.0f;
+    double residsqr = 0.0;
+    for (int i = 0; i < numReductions; ++i)
+    {
+        switch (m_reductions[i])
+        {
+            case ReductionEnum::MEDIAN:
+                if ((numElems & 1) == 0)//if even, average middle two
+                {
+                    resultsOut[i] = (ranked[numElems / 2 - 1] + ranked[numElems / 2]) / 2.0f;
+                } else {
+                    resultsOut[i] = ranked[numElems / 2];
+                }
+                break;
+            case ReductionEnum::MODE:
+                resultsOut[i] = computeMode(data, numElems);
+                break;
+            case ReductionEnum::INDEXMAX:
+                resultsOut[i] = (originalIndices == NULL ? myAccum.getIndexOfMax() : originalIndices[myAccum.getIndexOfMax()]) + 1;//1-based, to match gui and column arguments
+                break;
+            case ReductionEnum::INDEXMIN:
+                resultsOut[i] = (originalIndices == NULL ? myAccum.getIndexOfMin() : originalIndices[myAccum.getIndexOfMin()]) + 1;
+                break;
+            case ReductionEnum::STDEV:
+            case ReductionEnum::SAMPSTDEV:
+            case ReductionEnum::VARIANCE:
+            case ReductionEnum::TSNR:
+            case ReductionEnum::COV:
+                if (!haveResid)
+                {//we have all the values, so use the two-pass residual rather than the streaming one
+                    twoPassMean = myAccum.getSum() / numElems;
+                    for (int64_t j = 0; j < numElems; ++j)
+                    {
+                        float tempf = data[j] - twoPassMean;
+                        residsqr += tempf * tempf;
+                    }
+                    haveResid = true;
+                }
+                if (m_reductions[i] != ReductionEnum::STDEV && m_reductions[i] != ReductionEnum::VARIANCE && numElems < 2)
+                {
+                    throw CaretException("taking the sample standard deviation of 1 element would require dividing by zero");
+                }
+                resultsOut[i] = computeTwoPassMoment(m_reductions[i], twoPassMean, residsqr, numElems);
+                break;
+            default:
+                resultsOut[i] = myAccum.getResult(m_reductions[i]);
+                break;
+        }
+    }
+    for (int i = 0; i < numPercentiles; ++i)
+    {
+        const double index = percentIndex[i];
+        float result;
+        if (index <= 0)
+        {
+            result = ranked[0];
+        } else if (index >= numElems - 1) {
+            result = ranked[numElems - 1];
+        } else {
+            double ipart, fpart;
+            fpart = modf(index, &ipart);
+            result = (1.0 - fpart) * ranked[(int64_t)ipart] + fpart * ranked[((int64_t)ipart) + 1];
+        }
+        resultsOut[numReductions + i] = result;
+    }
+}
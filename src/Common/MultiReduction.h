@@ -0,0 +1,78 @@
+#ifndef __MULTI_REDUCTION_H__
+#define __MULTI_REDUCTION_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+#include "ReductionEnum.h"
+
+#include <vector>
+
+namespace caret {
+    
+    ///computes several reductions and percentiles of the same data at once, with one pass for moments and one selection pass for all order statistics
+    class MultiReduction
+    {
+    public:
+        ///streaming accumulator for the reductions that don't need to keep all values, partial accumulators can be merged
+        class Accumulator
+        {
+            int64_t m_count, m_countNonzero, m_indexMin, m_indexMax;
+            double m_sum, m_product, m_mean, m_m2;//m_mean and m_m2 are Welford running mean and sum of squared residuals
+            float m_min, m_max;
+        public:
+            Accumulator();
+            void add(const float& value);
+            ///combine with an accumulator of values that come after the values in this one
+            void merge(const Accumulator& rhs);
+            int64_t getCount() const { return m_count; }
+            double getSum() const { return m_sum; }
+            int64_t getIndexOfMax() const { return m_indexMax; }
+            int64_t getIndexOfMin() const { return m_indexMin; }
+            float getResult(const ReductionEnum::Enum& type) const;
+        };
+        
+        void addReduction(const ReductionEnum::Enum& type);
+        void addPercentile(const float& percent);
+        int getNumberOfResults() const { return (int)(m_reductions.size() + m_percentiles.size()); }
+        ///reductions in the order added, followed by percentiles in the order added
+        AString getResultName(const int& index) const;
+        ///true if every result can be computed from an Accumulator, without keeping the values
+        bool isStreamable() const;
+        ///compute all results, resultsOut must have getNumberOfResults() elements, originalIndices (if given) maps data positions to the indices reported by INDEXMAX/INDEXMIN
+        void compute(const float* data, const int64_t& numElems, float* resultsOut, const int64_t* originalIndices = NULL) const;
+        ///compute results from only the numeric values, indices refer to positions in the full input
+        void computeOnlyNumeric(const float* data, const int64_t& numElems, float* resultsOut) const;
+        ///compute results after excluding non-numeric values and outliers by standard deviation, indices refer to positions in the full input
+        void computeExcludeDev(const float* data, const int64_t& numElems, float* resultsOut, const float& numDevBelow, const float& numDevAbove) const;
+        ///get results from an accumulator, only valid if isStreamable()
+        void getResults(const Accumulator& myAccum, float* resultsOut) const;
+    private:
+        std::vector<ReductionEnum::Enum> m_reductions;
+        std::vector<float> m_percentiles;
+        
+        static float computeMode(const float* data, const int64_t& numElems);
+        static float computeTwoPassMoment(const ReductionEnum::Enum& type, const float& mean, const double& residsqr, const int64_t& numElems);
+    };
+    
+}
+
+#endif //__MULTI_REDUCTION_H__
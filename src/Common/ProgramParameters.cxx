@@ -380,3 +380,15 @@ ProgramParameters::getProgramName() const
     return this->programName;
 }
 
+/**
+ * Set the name of the program, for parameters that are not from argv.
+ *
+ * @param name
+ *   Name of the program.
+ */
+void
+ProgramParameters::setProgramName(const AString& name)
+{
+    this->programName = name;
+}
+
@@ -88,6 +88,8 @@ public:
     AString getAllParametersQuotedInString() const;
 
     AString getProgramName() const;
+
+    void setProgramName(const AString& name);
     
 private:
     /**The parameters. */
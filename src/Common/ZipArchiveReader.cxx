@@ -0,0 +1,274 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ZipArchiveReader.h"
+
+#include "DataFileException.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+
+using namespace caret;
+using namespace std;
+
+/**
+ * \class caret::ZipArchiveReader
+ * \brief Reads the member directory of a zip archive.
+ * \ingroup Common
+ *
+ * Parses the end of central directory record (including zip64) and the
+ * central directory, so that a member's data can be located and read
+ * directly from the archive without extracting it.
+ *
+ * Only stored members are read in place with random access.  A compressed
+ * member is decompressed into memory the first time a reader seeks backward
+ * in it, so large files that are read by row, like on-disk CIFTI, should be
+ * stored uncompressed in the archive.
+ */
+
+namespace
+{
+    const uint32_t ZIP_LOCAL_HEADER_SIGNATURE = 0x04034b50;
+    const uint32_t ZIP_CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+    const uint32_t ZIP_END_SIGNATURE = 0x06054b50;
+    const uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+    const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+    const int64_t ZIP_END_SIZE = 22, ZIP64_END_SIZE = 56, ZIP64_LOCATOR_SIZE = 20;
+    const int64_t ZIP_CENTRAL_HEADER_SIZE = 46, ZIP_LOCAL_HEADER_SIZE = 30;
+    const int64_t ZIP_MAX_COMMENT = 65535;
+    
+    //zip fields are always little endian
+    uint16_t readLE16(const char* data)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        return (uint16_t)(bytes[0] | (bytes[1] << 8));
+    }
+    
+    uint32_t readLE32(const char* data)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        return ((uint32_t)bytes[0]) | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+    
+    uint64_t readLE64(const char* data)
+    {
+        return ((uint64_t)readLE32(data)) | (((uint64_t)readLE32(data + 4)) << 32);
+    }
+    
+    void readAt(QFile& file, const int64_t& offset, const int64_t& count, vector<char>& dataOut, const AString& zipFileName)
+    {
+        dataOut.resize(count);
+        if (!file.seek(offset) || (count > 0 && file.read(dataOut.data(), count) != count))
+        {
+            throw DataFileException(zipFileName, "error reading zip archive structure, file may be truncated");
+        }
+    }
+}
+
+ZipArchiveReader::ZipArchiveReader(const AString& zipFileName)
+{
+    open(zipFileName);
+}
+
+void ZipArchiveReader::open(const AString& zipFileName)
+{
+    m_fileName = zipFileName;
+    m_members.clear();
+    m_memberIndex.clear();
+    QFile myFile(zipFileName);
+    if (!myFile.open(QIODevice::ReadOnly))
+    {
+        throw DataFileException(zipFileName, "unable to open zip archive for reading");
+    }
+    const int64_t fileSize = myFile.size();
+    if (fileSize < ZIP_END_SIZE)
+    {
+        throw DataFileException(zipFileName, "file is too small to be a zip archive");
+    }
+    const int64_t tailSize = min(fileSize, ZIP_END_SIZE + ZIP_MAX_COMMENT);
+    const int64_t tailStart = fileSize - tailSize;
+    vector<char> tail;
+    readAt(myFile, tailStart, tailSize, tail, zipFileName);
+    int64_t endPos = -1;
+    for (int64_t i = tailSize - ZIP_END_SIZE; i >= 0; --i)//the record is followed only by the archive comment, so search backwards
+    {
+        if (readLE32(tail.data() + i) == ZIP_END_SIGNATURE)
+        {
+            endPos = i;
+            break;
+        }
+    }
+    if (endPos < 0)
+    {
+        throw DataFileException(zipFileName, "end of central directory not found, file is not a zip archive");
+    }
+    int64_t numEntries = readLE16(tail.data() + endPos + 10);
+    int64_t directorySize = readLE32(tail.data() + endPos + 12);
+    int64_t directoryOffset = readLE32(tail.data() + endPos + 16);
+    if (tailStart + endPos >= ZIP64_LOCATOR_SIZE)
+    {
+        vector<char> locator;
+        readAt(myFile, tailStart + endPos - ZIP64_LOCATOR_SIZE, ZIP64_LOCATOR_SIZE, locator, zipFileName);
+        if (readLE32(locator.data()) == ZIP64_LOCATOR_SIGNATURE)
+        {
+            const int64_t zip64EndOffset = (int64_t)readLE64(locator.data() + 8);
+            if (zip64EndOffset < 0 || zip64EndOffset + ZIP64_END_SIZE > fileSize)
+            {
+                throw DataFileException(zipFileName, "invalid zip64 end of central directory location");
+            }
+            vector<char> zip64End;
+            readAt(myFile, zip64EndOffset, ZIP64_END_SIZE, zip64End, zipFileName);
+            if (readLE32(zip64End.data()) != ZIP64_END_SIGNATURE)
+            {
+                throw DataFileException(zipFileName, "invalid zip64 end of central directory record");
+            }
+            numEntries = (int64_t)readLE64(zip64End.data() + 32);
+            directorySize = (int64_t)readLE64(zip64End.data() + 40);
+            directoryOffset = (int64_t)readLE64(zip64End.data() + 48);
+        }
+    }
+    if (directoryOffset < 0 || directorySize < 0 || directoryOffset + directorySize > fileSize)
+    {
+        throw DataFileException(zipFileName, "central directory lies outside the file");
+    }
+    vector<char> directory;
+    readAt(myFile, directoryOffset, directorySize, directory, zipFileName);
+    int64_t position = 0;
+    for (int64_t entry = 0; entry < numEntries; ++entry)
+    {
+        if (position + ZIP_CENTRAL_HEADER_SIZE > directorySize || readLE32(directory.data() + position) != ZIP_CENTRAL_HEADER_SIGNATURE)
+        {
+            throw DataFileException(zipFileName, "corrupt central directory entry " + AString::number(entry));
+        }
+        const char* header = directory.data() + position;
+        Member thisMember;
+        thisMember.m_flags = readLE16(header + 8);
+        thisMember.m_method = readLE16(header + 10);
+        thisMember.m_crc = readLE32(header + 16);
+        thisMember.m_compressedSize = readLE32(header + 20);
+        thisMember.m_uncompressedSize = readLE32(header + 24);
+        const int64_t nameLength = readLE16(header + 28), extraLength = readLE16(header + 30), commentLength = readLE16(header + 32);
+        thisMember.m_localHeaderOffset = readLE32(header + 42);
+        if (position + ZIP_CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength > directorySize)
+        {
+            throw DataFileException(zipFileName, "corrupt central directory entry " + AString::number(entry));
+        }
+        const char* nameStart = header + ZIP_CENTRAL_HEADER_SIZE;
+        if (thisMember.m_flags & 0x800)//name is utf-8
+        {
+            thisMember.m_name = QString::fromUtf8(nameStart, nameLength);
+        } else {
+            thisMember.m_name = QString::fromLocal8Bit(nameStart, nameLength);
+        }
+        const char* extra = nameStart + nameLength;
+        int64_t extraPos = 0;
+        while (extraPos + 4 <= extraLength)
+        {
+            const uint16_t extraID = readLE16(extra + extraPos), extraSize = readLE16(extra + extraPos + 2);
+            if (extraPos + 4 + extraSize > extraLength) break;
+            if (extraID == 0x0001)//zip64 extended information, only contains the fields that overflowed, in this order
+            {
+                const char* field = extra + extraPos + 4;
+                const char* fieldEnd = field + extraSize;
+                if (thisMember.m_uncompressedSize == 0xFFFFFFFFLL && field + 8 <= fieldEnd)
+                {
+                    thisMember.m_uncompressedSize = (int64_t)readLE64(field);
+                    field += 8;
+                }
+                if (thisMember.m_compressedSize == 0xFFFFFFFFLL && field + 8 <= fieldEnd)
+                {
+                    thisMember.m_compressedSize = (int64_t)readLE64(field);
+                    field += 8;
+                }
+                if (thisMember.m_localHeaderOffset == 0xFFFFFFFFLL && field + 8 <= fieldEnd)
+                {
+                    thisMember.m_localHeaderOffset = (int64_t)readLE64(field);
+                    field += 8;
+                }
+            }
+            extraPos += 4 + extraSize;
+        }
+        position += ZIP_CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength;
+        m_memberIndex[thisMember.m_name] = (int64_t)m_members.size();
+        m_members.push_back(thisMember);
+    }
+}
+
+const ZipArchiveReader::Member* ZipArchiveReader::findMember(const AString& memberName) const
+{
+    map<AString, int64_t>::const_iterator iter = m_memberIndex.find(memberName);
+    if (iter == m_memberIndex.end()) return NULL;
+    return &(m_members[iter->second]);
+}
+
+int64_t ZipArchiveReader::getDataOffset(const Member& member) const
+{
+    QFile myFile(m_fileName);
+    if (!myFile.open(QIODevice::ReadOnly))
+    {
+        throw DataFileException(m_fileName, "unable to open zip archive for reading");
+    }
+    vector<char> header;
+    readAt(myFile, member.m_localHeaderOffset, ZIP_LOCAL_HEADER_SIZE, header, m_fileName);
+    if (readLE32(header.data()) != ZIP_LOCAL_HEADER_SIGNATURE)
+    {
+        throw DataFileException(m_fileName, "corrupt local header for member '" + member.m_name + "'");
+    }
+    //local extra field can differ from the central one, so the sizes must come from here
+    const int64_t ret = member.m_localHeaderOffset + ZIP_LOCAL_HEADER_SIZE + readLE16(header.data() + 26) + readLE16(header.data() + 28);
+    if (ret + member.m_compressedSize > myFile.size())
+    {
+        throw DataFileException(m_fileName, "data for member '" + member.m_name + "' extends past the end of the archive");
+    }
+    return ret;
+}
+
+bool ZipArchiveReader::splitMemberPath(const AString& path, AString& zipFileNameOut, AString& memberNameOut)
+{
+    int searchFrom = 0;
+    while (true)
+    {
+        const int index = path.indexOf(".zip/", searchFrom, Qt::CaseInsensitive);
+        if (index < 0) return false;
+        const AString zipName = path.left(index + 4);
+        if (QFileInfo(zipName).isFile())
+        {
+            zipFileNameOut = zipName;
+            memberNameOut = path.mid(index + 5);
+            return !memberNameOut.isEmpty();
+        }
+        searchFrom = index + 1;
+    }
+}
+
+bool ZipArchiveReader::isExistingMemberPath(const AString& path)
+{
+    AString zipName, memberName;
+    if (!splitMemberPath(path, zipName, memberName)) return false;
+    try
+    {
+        ZipArchiveReader myReader(zipName);
+        return myReader.findMember(memberName) != NULL;
+    } catch (DataFileException&) {
+        return false;
+    }
+}
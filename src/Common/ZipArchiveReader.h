@@ -0,0 +1,71 @@
+#ifndef __ZIP_ARCHIVE_READER_H__
+#define __ZIP_ARCHIVE_READER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+namespace caret {
+    
+    ///reads the central directory of a zip archive, so members can be read in place
+    class ZipArchiveReader
+    {
+    public:
+        struct Member
+        {
+            AString m_name;
+            int64_t m_compressedSize, m_uncompressedSize, m_localHeaderOffset;
+            uint32_t m_crc;
+            uint16_t m_method, m_flags;
+            Member() : m_compressedSize(0), m_uncompressedSize(0), m_localHeaderOffset(0), m_crc(0), m_method(0), m_flags(0) { }
+            bool isStored() const { return m_method == 0; }
+            bool isDeflated() const { return m_method == 8; }
+            bool isEncrypted() const { return (m_flags & 1) != 0; }
+        };
+        ZipArchiveReader() { }
+        ///constructor that reads the directory
+        ZipArchiveReader(const AString& zipFileName);
+        ///throws DataFileException if the file is not a readable zip archive
+        void open(const AString& zipFileName);
+        const AString& getFileName() const { return m_fileName; }
+        const std::vector<Member>& getMembers() const { return m_members; }
+        ///returns NULL if there is no such member
+        const Member* findMember(const AString& memberName) const;
+        ///offset of the first byte of member data, from the local header
+        int64_t getDataOffset(const Member& member) const;
+        ///splits "archive.zip/inner/file" where archive.zip is an existing file, returns false for ordinary paths
+        static bool splitMemberPath(const AString& path, AString& zipFileNameOut, AString& memberNameOut);
+        ///true if path names an existing member of an existing archive
+        static bool isExistingMemberPath(const AString& path);
+    private:
+        AString m_fileName;
+        std::vector<Member> m_members;
+        std::map<AString, int64_t> m_memberIndex;
+    };
+    
+} // namespace
+
+#endif //__ZIP_ARCHIVE_READER_H__
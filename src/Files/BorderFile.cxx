@@ -104,6 +104,7 @@ BorderFile::initializeBorderFile()
     m_classNameHierarchy = new GroupAndNameHierarchyModel();
     m_metadata = new GiftiMetaData();
     m_forceUpdateOfGroupAndNameHierarchy = true;
+    m_unmodifiedContentStamp = 0;
     m_structure = StructureEnum::ALL;
     m_numNodes = -1;
 }
@@ -427,6 +428,7 @@ BorderFile::clear()
     m_numNodes = -1;
     m_borderMDKeys.clear();
     m_borderMDValues.clear();
+    m_unmodifiedContentStamp = 0;
 }
 
 int32_t BorderFile::getNumberOfNodes() const
@@ -1335,6 +1337,7 @@ BorderFile::invalidateAllAssignedColors()
         m_borders[i]->setNameRgbaInvalid();
     }
     m_forceUpdateOfGroupAndNameHierarchy = true;
+    m_unmodifiedContentStamp = 0;
 }
 
 /**
@@ -2103,6 +2106,22 @@ BorderFile::clearModified()
     for (int32_t i = 0; i < numBorders; i++) {
         m_borders[i]->clearModified();
     }
+    
+    m_unmodifiedContentStamp = 0;
+}
+
+/**
+ * @return Stamp for the borders and their assigned colors that is
+ * replaced when the file is read, written, cleared, or its colors
+ * are invalidated.  It is only meaningful while isModified() is false.
+ */
+int64_t
+BorderFile::getUnmodifiedContentStamp() const
+{
+    if (m_unmodifiedContentStamp == 0) {
+        m_unmodifiedContentStamp = newModificationStamp();
+    }
+    return m_unmodifiedContentStamp;
 }
 
 
@@ -191,6 +191,8 @@ namespace caret {
         
         virtual void clearModified();
         
+        int64_t getUnmodifiedContentStamp() const;
+        
         void invalidateAllAssignedColors();
         
     private:
@@ -238,6 +240,9 @@ namespace caret {
         /** force an update of the class and name hierarchy */
         bool m_forceUpdateOfGroupAndNameHierarchy;
         
+        /** Identifies content while not modified, zero if a new stamp is needed */
+        mutable int64_t m_unmodifiedContentStamp;
+        
         StructureEnum::Enum m_structure;
         
         int32_t m_numNodes;
@@ -24,6 +24,7 @@
 #undef __CARET_DATA_FILE_DECLARE__
 
 #include "CaretMappableDataFile.h"
+#include "CaretMutex.h"
 #include "DataFileContentInformation.h"
 #include "SceneClass.h"
 
@@ -220,6 +221,20 @@ CaretDataFile::getFileReadingPassword()
     return s_fileReadingPassword;
 }
 
+/**
+ * @return A new, never zero, stamp for caches that need to detect changes
+ * in a file's content.  Stamps are unique across all files so that a
+ * cache keyed on a reused file address still sees a change.
+ */
+int64_t
+CaretDataFile::newModificationStamp()
+{
+    static CaretMutex stampMutex;
+    static int64_t lastStamp = 0;
+    CaretMutexLocker locked(&stampMutex);
+    return ++lastStamp;
+}
+
 /**
  * Create a scene for an instance of a class.
  *
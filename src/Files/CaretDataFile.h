@@ -92,6 +92,8 @@ namespace caret {
         
         void setDataFileType(const DataFileTypeEnum::Enum dataFileType);
         
+        static int64_t newModificationStamp();
+        
         virtual void saveFileDataToScene(const SceneAttributes* sceneAttributes,
                                          SceneClass* sceneClass);
         
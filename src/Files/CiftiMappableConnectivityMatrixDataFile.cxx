@@ -23,9 +23,12 @@
 #include "CiftiMappableConnectivityMatrixDataFile.h"
 #undef __CIFTI_MAPPABLE_CONNECTIVITY_MATRIX_DATA_FILE_DECLARE__
 
+#include <algorithm>
+
 #include "CaretAssert.h"
 #include "CiftiFile.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "ChartableMatrixParcelInterface.h"
 #include "ConnectivityDataLoaded.h"
 #include "DataFileException.h"
@@ -710,7 +713,6 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
     }
     
     const bool isDenseMatrix = (getDataFileType() == DataFileTypeEnum::CONNECTIVITY_DENSE);
-    const int32_t progressUpdateInterval = 1;
     
     bool dataWasLoaded = false;
     
@@ -726,21 +728,8 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
             break;
     }
     if (dataCount > 0) {
-        /*
-            * Contains the average 
-            */
-        std::vector<float> dataAverageVector(dataCount, 0.0);
-        float* dataAverage = &dataAverageVector[0];
-        
-        /*
-            * Contains row/column for a node
-            */
-        std::vector<float> dataRowColumnVector(dataCount, 0.0);
-        float* dataRowColumn = &dataRowColumnVector[0];
-        
         int64_t successCount = 0;
         
-        bool userCancelled = false;
         EventProgressUpdate progressEvent(0,
                                             numberOfNodeIndices,
                                             0,
@@ -751,23 +740,13 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
         EventManager::get()->sendEvent(progressEvent.getPointer());
         
         /*
-            * Read rows for each node
-            */
+         * Find the row or column for each node
+         */
+        std::vector<int64_t> rowIndices;
+        std::vector<int64_t> columnIndices;
         for (int32_t i = 0; i < numberOfNodeIndices; i++) {
             const int32_t nodeIndex = nodeIndices[i];
             
-            if (isDenseMatrix) {
-                if ((i % progressUpdateInterval) == 0) {
-                    progressEvent.setProgress(i,
-                                                "");
-                    EventManager::get()->sendEvent(progressEvent.getPointer());
-                    if (progressEvent.isCancelled()) {
-                        userCancelled = true;
-                        break;
-                    }
-                }
-            }
-            
             int64_t rowIndex = -1;
             int64_t columnIndex = -1;
             getRowColumnIndexForNodeWhenLoading(structure,
@@ -778,31 +757,30 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
             
             if (rowIndex >= 0) {
                 CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiFile->getNumberOfRows()));
-                m_ciftiFile->getRow(dataRowColumn, rowIndex);
-                
-                for (int64_t j = 0; j < dataCount; j++) {
-                    dataAverage[j] += dataRowColumn[j];
-                }
+                rowIndices.push_back(rowIndex);
                 successCount++;
-                
-                CaretLogFine("Read row for node " + AString::fromNumbers(nodeIndices, ","));
             }
             else if (columnIndex >= 0) {
                 CaretAssert((columnIndex >= 0) && (columnIndex < m_ciftiFile->getNumberOfColumns()));
-                m_ciftiFile->getColumn(dataRowColumn, columnIndex);
-                
-                for (int64_t j = 0; j < dataCount; j++) {
-                    dataAverage[j] += dataRowColumn[j];
-                }
+                columnIndices.push_back(columnIndex);
                 successCount++;
-                
-                CaretLogFine("Read column for node " + AString::fromNumbers(nodeIndices, ","));
             }
             else {
                 CaretLogFine("Failed reading data for node " + AString::number(nodeIndex));
             }
         }
         
+        /*
+         * Read and sum the rows and columns
+         */
+        std::vector<double> dataSumVector(dataCount, 0.0);
+        const bool userCancelled = ( ! sumRowsAndColumnsForAverage(rowIndices,
+                                                                   columnIndices,
+                                                                   dataSumVector,
+                                                                   (isDenseMatrix
+                                                                    ? &progressEvent
+                                                                    : NULL)));
+        
         if (userCancelled) {
             m_loadedRowData.clear();
             m_loadedRowData.resize(dataCount, 0.0);
@@ -811,8 +789,9 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForSurfaceNodes(const
             /*
                 * Average the data
                 */
+            std::vector<float> dataAverageVector(dataCount);
             for (int64_t i = 0; i < dataCount; i++) {
-                dataAverage[i] /= successCount;
+                dataAverageVector[i] = dataSumVector[i] / successCount;
             }
             
             m_rowLoadedTextForMapName = ("Structure: "
@@ -1038,8 +1017,6 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForVoxelIndices(const
     
     const int64_t numberOfVoxelIndices = static_cast<int64_t>(voxelIndices.size());
     
-    bool userCancelled = false;
-    const int32_t progressUpdateInterval = 1;
     EventProgressUpdate progressEvent(0,
                                       numberOfVoxelIndices,
                                       0,
@@ -1049,25 +1026,13 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForVoxelIndices(const
                                       + getFileNameNoPath());
     EventManager::get()->sendEvent(progressEvent.getPointer());
     
-    std::vector<float> rowColumnData(dataCount);
-    std::vector<double> rowColumnSum(dataCount, 0.0);
-    
     /*
-     * Load and sum the data for all rows/columns
+     * Find the row or column for each voxel
      */
-    int64_t numberOfRowColumnsLoaded = 0;
+    std::vector<int64_t> rowIndices;
+    std::vector<int64_t> columnIndices;
     for (int64_t i = 0; i < numberOfVoxelIndices; i++) {
-        if ((i % progressUpdateInterval) == 0) {
-            progressEvent.setProgress(i,
-                                      "");
-            EventManager::get()->sendEvent(progressEvent.getPointer());
-            if (progressEvent.isCancelled()) {
-                userCancelled = true;
-                break;
-            }
-        }
-        
-       const VoxelIJK& voxelIJK = voxelIndices[i];
+        const VoxelIJK& voxelIJK = voxelIndices[i];
         
         int64_t rowIndex;
         int64_t columnIndex;
@@ -1076,27 +1041,23 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForVoxelIndices(const
                                                   columnIndex);
         if (rowIndex >= 0) {
             CaretAssert((rowIndex >= 0) && (rowIndex < m_ciftiFile->getNumberOfRows()));
-            m_ciftiFile->getRow(&rowColumnData[0],
-                                     rowIndex);
-            
-            for (int64_t j = 0; j < dataCount; j++) {
-                rowColumnSum[j] += rowColumnData[j];
-            }
-            
-            numberOfRowColumnsLoaded++;
+            rowIndices.push_back(rowIndex);
         }
         else if (columnIndex >= 0) {
             CaretAssert((columnIndex >= 0) && (columnIndex < m_ciftiFile->getNumberOfColumns()));
-            m_ciftiFile->getColumn(&rowColumnData[0],
-                                   columnIndex);
-            
-            for (int64_t j = 0; j < dataCount; j++) {
-                rowColumnSum[j] += rowColumnData[j];
-            }
-            
-            numberOfRowColumnsLoaded++;
+            columnIndices.push_back(columnIndex);
         }
     }
+    const int64_t numberOfRowColumnsLoaded = static_cast<int64_t>(rowIndices.size() + columnIndices.size());
+    
+    /*
+     * Load and sum the data for all rows/columns
+     */
+    std::vector<double> rowColumnSum(dataCount, 0.0);
+    const bool userCancelled = ( ! sumRowsAndColumnsForAverage(rowIndices,
+                                                               columnIndices,
+                                                               rowColumnSum,
+                                                               &progressEvent));
     
     bool dataWasLoadedFlag = false;
     if (userCancelled) {
@@ -1128,6 +1089,140 @@ CiftiMappableConnectivityMatrixDataFile::loadMapAverageDataForVoxelIndices(const
     return dataWasLoadedFlag;
 }
 
+namespace {
+    /**
+     * Weights rows by how many times they were selected, and updates
+     * progress between chunks of rows.
+     */
+    class RowCountWeights : public CiftiFile::RowSumWeights {
+    public:
+        RowCountWeights(const std::vector<int64_t>& rowCounts,
+                        EventProgressUpdate* progressEvent)
+        : m_rowCounts(rowCounts),
+        m_progressEvent(progressEvent),
+        m_rowsDone(0),
+        m_progressCount(0) { }
+        
+        float getWeight(const int& /*sumIndex*/,
+                        const int64_t& rowPosition) const {
+            return m_rowCounts[rowPosition];
+        }
+        
+        bool beforeChunk(const int64_t& rowsDone) {
+            for ( ; m_rowsDone < rowsDone; m_rowsDone++) {
+                m_progressCount += m_rowCounts[m_rowsDone];
+            }
+            if (m_progressEvent != NULL) {
+                m_progressEvent->setProgress(m_progressCount,
+                                             "");
+                EventManager::get()->sendEvent(m_progressEvent->getPointer());
+                if (m_progressEvent->isCancelled()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    private:
+        const std::vector<int64_t>& m_rowCounts;
+        EventProgressUpdate* m_progressEvent;
+        int64_t m_rowsDone;
+        int64_t m_progressCount;
+    };
+}
+
+/**
+ * Read the given rows and columns and add them together.  Rows are
+ * sorted so that adjacent rows are read from the file together, and
+ * the summing is done in parallel.
+ *
+ * @param rowIndices
+ *    Indices of rows, may be unsorted and contain duplicates.
+ * @param columnIndices
+ *    Indices of columns.
+ * @param sumOut
+ *    Output containing the sum, must already be sized and zeroed.
+ * @param progressEvent
+ *    If not NULL, progress is updated and checked for cancellation.
+ * @return
+ *    True if all data was read, false if the user cancelled.
+ */
+bool
+CiftiMappableConnectivityMatrixDataFile::sumRowsAndColumnsForAverage(const std::vector<int64_t>& rowIndices,
+                                                                     const std::vector<int64_t>& columnIndices,
+                                                                     std::vector<double>& sumOut,
+                                                                     EventProgressUpdate* progressEvent)
+{
+    CaretAssert(m_ciftiFile);
+    const int64_t dataCount = static_cast<int64_t>(sumOut.size());
+    
+    /*
+     * Sort rows and count duplicates since the CiftiFile
+     * reads a sorted set of unique rows
+     */
+    std::vector<int64_t> sortedRows(rowIndices);
+    std::sort(sortedRows.begin(), sortedRows.end());
+    std::vector<int64_t> uniqueRows;
+    std::vector<int64_t> uniqueRowCounts;
+    for (std::vector<int64_t>::const_iterator iter = sortedRows.begin();
+         iter != sortedRows.end();
+         iter++) {
+        if (( ! uniqueRows.empty())
+            && (uniqueRows.back() == *iter)) {
+            uniqueRowCounts.back()++;
+        }
+        else {
+            uniqueRows.push_back(*iter);
+            uniqueRowCounts.push_back(1);
+        }
+    }
+    
+    /*
+     * Read rows in chunks to limit memory usage and to
+     * allow the user to cancel
+     */
+    std::vector<std::vector<double> > sums(1);
+    sums[0].swap(sumOut);
+    RowCountWeights rowWeights(uniqueRowCounts,
+                               progressEvent);
+    const bool finished = m_ciftiFile->sumWeightedRows(uniqueRows,
+                                                       rowWeights,
+                                                       sums);
+    sums[0].swap(sumOut);
+    if ( ! finished) {
+        return false;
+    }
+    int64_t progressCount = static_cast<int64_t>(rowIndices.size());
+    
+    /*
+     * Columns are read individually
+     */
+    std::vector<float> columnData(dataCount);
+    const int64_t numberOfColumns = static_cast<int64_t>(columnIndices.size());
+    for (int64_t i = 0; i < numberOfColumns; i++) {
+        if (progressEvent != NULL) {
+            progressEvent->setProgress(progressCount,
+                                       "");
+            EventManager::get()->sendEvent(progressEvent->getPointer());
+            if (progressEvent->isCancelled()) {
+                return false;
+            }
+        }
+        
+        m_ciftiFile->getColumn(&columnData[0],
+                               columnIndices[i]);
+        const float* columnPointer = &columnData[0];
+        double* sumPointer = &sumOut[0];
+#pragma omp CARET_PARFOR schedule(static)
+        for (int64_t j = 0; j < dataCount; j++) {
+            sumPointer[j] += columnPointer[j];
+        }
+        
+        progressCount++;
+    }
+    
+    return true;
+}
+
 /**
  * @return Text describing row loaded that uses
  * underscores as separators.
@@ -31,6 +31,7 @@
 namespace caret {
 
     class ConnectivityDataLoaded;
+    class EventProgressUpdate;
     class SceneClassAssistant;
     
     class CiftiMappableConnectivityMatrixDataFile :
@@ -140,6 +141,11 @@ namespace caret {
         
         int32_t getCifitDirectionForLoadingRowOrColumn();
         
+        bool sumRowsAndColumnsForAverage(const std::vector<int64_t>& rowIndices,
+                                         const std::vector<int64_t>& columnIndices,
+                                         std::vector<double>& sumOut,
+                                         EventProgressUpdate* progressEvent);
+        
         // ADD_NEW_MEMBERS_HERE
         
         SceneClassAssistant* m_sceneAssistant;
@@ -18,6 +18,7 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
 #include <set>
 
 #define __CIFTI_MAPPABLE_DATA_FILE_DECLARE__
@@ -36,6 +37,7 @@
 #include "CiftiParcelLabelFile.h"
 #include "CaretTemporaryFile.h"
 #include "CiftiXML.h"
+#include "DataBlockSource.h"
 #include "DataFileContentInformation.h"
 #include "EventManager.h"
 #include "EventPaletteGetByName.h"
@@ -53,7 +55,43 @@
 
 using namespace caret;
 
-
+namespace
+{
+    ///streams the matrix as blocks of whole rows, so file statistics don't need a copy of the entire file
+    class CiftiRowBlockSource : public DataBlockSource
+    {
+        const CiftiFile* m_ciftiFile;
+        int64_t m_numRows, m_numCols, m_rowsPerBlock;
+    public:
+        CiftiRowBlockSource(const CiftiFile* ciftiFile)
+        {
+            const int64_t BLOCK_VALUES = 1 << 20;
+            m_ciftiFile = ciftiFile;
+            m_numRows = ciftiFile->getNumberOfRows();
+            m_numCols = ciftiFile->getNumberOfColumns();
+            m_rowsPerBlock = std::max((int64_t)1, BLOCK_VALUES / std::max((int64_t)1, m_numCols));
+        }
+        
+        int64_t getNumberOfBlocks() const { return (m_numRows + m_rowsPerBlock - 1) / m_rowsPerBlock; }
+        
+        int64_t getNumberOfValues() const { return m_numRows * m_numCols; }
+        
+        const float* getBlock(const int64_t& index, std::vector<float>& scratch, int64_t& dataCountOut) const
+        {
+            const int64_t firstRow = index * m_rowsPerBlock;
+            const int64_t numBlockRows = std::min(m_rowsPerBlock, m_numRows - firstRow);
+            std::vector<int64_t> rowIndices(numBlockRows);
+            for (int64_t i = 0; i < numBlockRows; ++i)
+            {
+                rowIndices[i] = firstRow + i;
+            }
+            dataCountOut = numBlockRows * m_numCols;
+            scratch.resize(dataCountOut);
+            m_ciftiFile->getRows(&scratch[0], rowIndices);//adjacent rows on disk are read together
+            return &scratch[0];
+        }
+    };
+}
     
 /**
  * \class caret::CiftiMappableDataFile 
@@ -991,9 +1029,7 @@ CiftiMappableDataFile::initializeAfterReading(const AString& filename)
     m_forceUpdateOfGroupAndNameHierarchy = false;
     m_classNameHierarchy->setAllSelected(true);
     
-    m_fileFastStatistics.grabNew(NULL);
-    m_fileHistogram.grabNew(NULL);
-    m_fileHistorgramLimitedValues.grabNew(NULL);
+    invalidateFileStatistics();
     
     CaretLogFiner("CLASS/NAME Table for : "
                   + this->getFileNameNoPath()
@@ -1323,6 +1359,7 @@ CiftiMappableDataFile::setMapData(const int32_t mapIndex,
     m_forceUpdateOfGroupAndNameHierarchy = true;
     
     m_mapContent[mapIndex]->updateForChangeInMapData();
+    invalidateFileStatistics();
 }
 
 /**
@@ -1336,6 +1373,18 @@ CiftiMappableDataFile::updateForChangeInMapDataWithMapIndex(const int32_t mapInd
 {
     CaretAssertVectorIndex(m_mapContent, mapIndex);
     m_mapContent[mapIndex]->updateForChangeInMapData();
+    invalidateFileStatistics();
+}
+
+/**
+ * Invalidate the cached statistics and histograms for all data in the file.
+ */
+void
+CiftiMappableDataFile::invalidateFileStatistics()
+{
+    m_fileFastStatistics.grabNew(NULL);
+    m_fileHistogram.grabNew(NULL);
+    m_fileHistorgramLimitedValues.grabNew(NULL);
 }
 
 
@@ -1596,12 +1645,11 @@ const FastStatistics*
 CiftiMappableDataFile::getFileFastStatistics()
 {
     if (m_fileFastStatistics == NULL) {
-        std::vector<float> fileData;
-        getFileData(fileData);
-        if ( ! fileData.empty()) {
+        CaretAssert(m_ciftiFile);
+        const CiftiRowBlockSource blockSource(m_ciftiFile);
+        if (blockSource.getNumberOfValues() > 0) {
             m_fileFastStatistics.grabNew(new FastStatistics());
-            m_fileFastStatistics->update(&fileData[0],
-                                         fileData.size());
+            m_fileFastStatistics->update(blockSource);
         }
     }
     
@@ -1621,12 +1669,11 @@ const Histogram*
 CiftiMappableDataFile::getFileHistogram()
 {
     if (m_fileHistogram == NULL) {
-        std::vector<float> fileData;
-        getFileData(fileData);
-        if ( ! fileData.empty()) {
+        CaretAssert(m_ciftiFile);
+        const CiftiRowBlockSource blockSource(m_ciftiFile);
+        if (blockSource.getNumberOfValues() > 0) {
             m_fileHistogram.grabNew(new Histogram());
-            m_fileHistogram->update(&fileData[0],
-                                    fileData.size());
+            m_fileHistogram->update(blockSource);
         }
     }
     return m_fileHistogram;
@@ -1673,14 +1720,13 @@ CiftiMappableDataFile::getFileHistogram(const float mostPositiveValueInclusive,
     }
     
     if (updateHistogramFlag) {
-        std::vector<float> fileData;
-        getFileData(fileData);
-        if ( ! fileData.empty()) {
+        CaretAssert(m_ciftiFile);
+        const CiftiRowBlockSource blockSource(m_ciftiFile);
+        if (blockSource.getNumberOfValues() > 0) {
             if (m_fileHistorgramLimitedValues == NULL) {
                 m_fileHistorgramLimitedValues.grabNew(new Histogram());
             }
-            m_fileHistorgramLimitedValues->update(&fileData[0],
-                                                  fileData.size(),
+            m_fileHistorgramLimitedValues->update(blockSource,
                                                   mostPositiveValueInclusive,
                                                   leastPositiveValueInclusive,
                                                   leastNegativeValueInclusive,
@@ -2474,6 +2520,9 @@ CiftiMappableDataFile::getVoxelColorsForSliceInMap(const PaletteFile* paletteFil
         getMapData(mapIndex,
                    dataValues);
     }
+    const NodeAndVoxelColoring::LabelSelectionLookup labelSelection(labelTable,
+                                                                    displayGroup,
+                                                                    tabIndex);
     
     int64_t validVoxelCount = 0;
     
@@ -2518,13 +2567,8 @@ CiftiMappableDataFile::getVoxelColorsForSliceInMap(const PaletteFile* paletteFil
                                  */
                                 CaretAssertVectorIndex(dataValues, dataOffset);
                                 const int32_t dataValue = dataValues[dataOffset];
-                                const GiftiLabel* label = labelTable->getLabel(dataValue);
-                                if (label != NULL) {
-                                    const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                                    CaretAssert(item);
-                                    if (item->isSelected(displayGroup, tabIndex) == false) {
-                                        alpha = 0.0;
-                                    }
+                                if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                                    alpha = 0.0;
                                 }
                             }
                             
@@ -2572,13 +2616,8 @@ CiftiMappableDataFile::getVoxelColorsForSliceInMap(const PaletteFile* paletteFil
                                  */
                                 CaretAssertVectorIndex(dataValues, dataOffset);
                                 const int32_t dataValue = dataValues[dataOffset];
-                                const GiftiLabel* label = labelTable->getLabel(dataValue);
-                                if (label != NULL) {
-                                    const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                                    CaretAssert(item);
-                                    if (item->isSelected(displayGroup, tabIndex) == false) {
-                                        alpha = 0.0;
-                                    }
+                                if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                                    alpha = 0.0;
                                 }
                             }
                             
@@ -2626,13 +2665,8 @@ CiftiMappableDataFile::getVoxelColorsForSliceInMap(const PaletteFile* paletteFil
                                  */
                                 CaretAssertVectorIndex(dataValues, dataOffset);
                                 const int32_t dataValue = dataValues[dataOffset];
-                                const GiftiLabel* label = labelTable->getLabel(dataValue);
-                                if (label != NULL) {
-                                    const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                                    CaretAssert(item);
-                                    if (item->isSelected(displayGroup, tabIndex) == false) {
-                                        alpha = 0.0;
-                                    }
+                                if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                                    alpha = 0.0;
                                 }
                             }
                             
@@ -2789,6 +2823,9 @@ CiftiMappableDataFile::getVoxelColorsForSubSliceInMap(const PaletteFile* palette
         getMapData(mapIndex,
                    dataValues);
     }
+    const NodeAndVoxelColoring::LabelSelectionLookup labelSelection(labelTable,
+                                                                    displayGroup,
+                                                                    tabIndex);
     
     /*
      * Note that step indices may be positive or negative
@@ -2847,13 +2884,8 @@ CiftiMappableDataFile::getVoxelColorsForSubSliceInMap(const PaletteFile* palette
                                  */
                                 CaretAssertVectorIndex(dataValues, dataOffset);
                                 const int32_t dataValue = dataValues[dataOffset];
-                                const GiftiLabel* label = labelTable->getLabel(dataValue);
-                                if (label != NULL) {
-                                    const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                                    CaretAssert(item);
-                                    if (item->isSelected(displayGroup, tabIndex) == false) {
-                                        alpha = 0.0;
-                                    }
+                                if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                                    alpha = 0.0;
                                 }
                             }
                             
@@ -2927,13 +2959,8 @@ CiftiMappableDataFile::getVoxelColorsForSubSliceInMap(const PaletteFile* palette
                                  */
                                 CaretAssertVectorIndex(dataValues, dataOffset);
                                 const int32_t dataValue = dataValues[dataOffset];
-                                const GiftiLabel* label = labelTable->getLabel(dataValue);
-                                if (label != NULL) {
-                                    const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                                    CaretAssert(item);
-                                    if (item->isSelected(displayGroup, tabIndex) == false) {
-                                        alpha = 0.0;
-                                    }
+                                if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                                    alpha = 0.0;
                                 }
                             }
                             
@@ -3008,13 +3035,8 @@ CiftiMappableDataFile::getVoxelColorsForSubSliceInMap(const PaletteFile* palette
                                  */
                                 CaretAssertVectorIndex(dataValues, dataOffset);
                                 const int32_t dataValue = dataValues[dataOffset];
-                                const GiftiLabel* label = labelTable->getLabel(dataValue);
-                                if (label != NULL) {
-                                    const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                                    CaretAssert(item);
-                                    if (item->isSelected(displayGroup, tabIndex) == false) {
-                                        alpha = 0.0;
-                                    }
+                                if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                                    alpha = 0.0;
                                 }
                             }
                             
@@ -3077,13 +3099,8 @@ CiftiMappableDataFile::getVoxelColorsForSubSliceInMap(const PaletteFile* palette
                                  */
                                 CaretAssertVectorIndex(dataValues, dataOffset);
                                 const int32_t dataValue = dataValues[dataOffset];
-                                const GiftiLabel* label = labelTable->getLabel(dataValue);
-                                if (label != NULL) {
-                                    const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                                    CaretAssert(item);
-                                    if (item->isSelected(displayGroup, tabIndex) == false) {
-                                        alpha = 0.0;
-                                    }
+                                if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                                    alpha = 0.0;
                                 }
                             }
                             
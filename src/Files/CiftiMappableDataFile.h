@@ -472,6 +472,8 @@ namespace caret {
         
         void updateForChangeInMapDataWithMapIndex(const int32_t mapIndex);
         
+        void invalidateFileStatistics();
+        
         ChartDataCartesian* helpLoadChartDataForSurfaceNode(const StructureEnum::Enum structure,
                                                        const int32_t nodeIndex);
         
@@ -0,0 +1,190 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ClusterHelper.h"
+
+#include "CaretAssert.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+
+#include <cstdlib>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //parents always point to a lower index, so the root of a tree is its lowest member
+    int64_t findRoot(int64_t* parents, int64_t elem)
+    {
+        while (parents[elem] != elem)
+        {
+            parents[elem] = parents[parents[elem]];//path halving
+            elem = parents[elem];
+        }
+        return elem;
+    }
+    
+    void unite(int64_t* parents, const int64_t& elem1, const int64_t& elem2)
+    {
+        int64_t root1 = findRoot(parents, elem1), root2 = findRoot(parents, elem2);
+        if (root1 < root2)
+        {
+            parents[root2] = root1;
+        } else if (root2 < root1) {
+            parents[root1] = root2;
+        }
+    }
+}
+
+ClusterHelper::ClusterHelper(const SurfaceFile* mySurf)
+{
+    m_isVolume = false;
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();
+    int32_t numNodes = mySurf->getNumberOfNodes();
+    m_numElements = numNodes;
+    m_dims[0] = numNodes;
+    m_dims[1] = 1;
+    m_dims[2] = 1;
+    m_lowerOffsets.resize(numNodes + 1);
+    m_lowerOffsets[0] = 0;
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(i);
+        for (size_t j = 0; j < neighbors.size(); ++j)
+        {
+            if (neighbors[j] < i) m_lowerNeighbors.push_back(neighbors[j]);//edges are symmetric, so each only needs to be looked at from the higher node
+        }
+        m_lowerOffsets[i + 1] = (int64_t)m_lowerNeighbors.size();
+    }
+}
+
+ClusterHelper::ClusterHelper(const int64_t dims[3], const VoxelConnectivity& connectivity)
+{
+    m_isVolume = true;
+    m_dims[0] = dims[0];
+    m_dims[1] = dims[1];
+    m_dims[2] = dims[2];
+    m_numElements = dims[0] * dims[1] * dims[2];
+    int maxManhattan = 1;
+    switch (connectivity)
+    {
+        case FACE:
+            maxManhattan = 1;
+            break;
+        case EDGE:
+            maxManhattan = 2;
+            break;
+        case CORNER:
+            maxManhattan = 3;
+            break;
+    }
+    for (int k = -1; k <= 0; ++k)
+    {
+        for (int j = -1; j <= 1; ++j)
+        {
+            for (int i = -1; i <= 1; ++i)
+            {
+                if (k == 0 && (j > 0 || (j == 0 && i >= 0))) continue;//only neighbors earlier in memory order
+                if (abs(i) + abs(j) + abs(k) > maxManhattan) continue;
+                m_stencil.push_back(i);
+                m_stencil.push_back(j);
+                m_stencil.push_back(k);
+            }
+        }
+    }
+}
+
+void ClusterHelper::findClusters(const char* mask, const float* elementSizes, vector<int64_t>& labelsOut, vector<Cluster>& clustersOut) const
+{
+    clustersOut.clear();
+    labelsOut.resize(m_numElements);
+    int64_t* parents = labelsOut.data();//use the output as the union-find forest, -1 for outside the mask
+    if (m_isVolume)
+    {
+        const int numStencil = (int)m_stencil.size();
+        int64_t index = 0;
+        for (int64_t k = 0; k < m_dims[2]; ++k)
+        {
+            for (int64_t j = 0; j < m_dims[1]; ++j)
+            {
+                for (int64_t i = 0; i < m_dims[0]; ++i, ++index)
+                {
+                    if (mask[index] == 0)
+                    {
+                        parents[index] = -1;
+                        continue;
+                    }
+                    parents[index] = index;
+                    for (int n = 0; n < numStencil; n += 3)
+                    {
+                        int64_t ni = i + m_stencil[n], nj = j + m_stencil[n + 1], nk = k + m_stencil[n + 2];
+                        if (ni < 0 || ni >= m_dims[0] || nj < 0 || nj >= m_dims[1] || nk < 0) continue;//neighbors are never later in k
+                        int64_t neighIndex = ni + m_dims[0] * (nj + m_dims[1] * nk);
+                        if (parents[neighIndex] != -1) unite(parents, index, neighIndex);
+                    }
+                }
+            }
+        }
+    } else {
+        for (int64_t i = 0; i < m_numElements; ++i)
+        {
+            if (mask[i] == 0)
+            {
+                parents[i] = -1;
+                continue;
+            }
+            parents[i] = i;
+            const int64_t end = m_lowerOffsets[i + 1];
+            for (int64_t n = m_lowerOffsets[i]; n < end; ++n)
+            {
+                int64_t neighbor = m_lowerNeighbors[n];
+                if (parents[neighbor] != -1) unite(parents, i, neighbor);
+            }
+        }
+    }
+    //since every parent is lower than its child, one ascending pass can replace each parent with the cluster index of its root, and sum the sizes
+    for (int64_t i = 0; i < m_numElements; ++i)
+    {
+        int64_t parent = parents[i];
+        if (parent == -1) continue;
+        int64_t cluster;
+        if (parent == i)
+        {
+            cluster = (int64_t)clustersOut.size();
+            Cluster newCluster;
+            newCluster.m_first = i;
+            newCluster.m_count = 0;
+            newCluster.m_size = 0.0;
+            clustersOut.push_back(newCluster);
+        } else {
+            CaretAssert(parent < i);
+            cluster = parents[parent];
+        }
+        parents[i] = cluster;
+        ++clustersOut[cluster].m_count;
+        if (elementSizes != NULL)
+        {
+            clustersOut[cluster].m_size += elementSizes[i];
+        } else {
+            clustersOut[cluster].m_size += 1.0;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef __CLUSTER_HELPER_H__
+#define __CLUSTER_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+
+#include <vector>
+
+namespace caret {
+    
+    class SurfaceFile;
+    
+    /// Union-find connected components of a mask on a surface or voxel grid, shared by the find clusters, remove islands and fill holes algorithms
+    /// Const after construction, so one helper can be used by many threads, each with its own output vectors
+    class ClusterHelper
+    {
+    public:
+        enum VoxelConnectivity
+        {
+            FACE,//6 neighbors
+            EDGE,//18 neighbors
+            CORNER//26 neighbors
+        };
+        
+        struct Cluster
+        {
+            int64_t m_first;//lowest member index, clusters are returned in order of this
+            int64_t m_count;
+            double m_size;//sum of element sizes, or member count if no sizes were given
+        };
+    private:
+        std::vector<int64_t> m_lowerOffsets;//CSR adjacency, surface only: lower-numbered neighbors of node i are m_lowerNeighbors[m_lowerOffsets[i]] to m_lowerNeighbors[m_lowerOffsets[i + 1] - 1]
+        std::vector<int32_t> m_lowerNeighbors;
+        std::vector<int> m_stencil;//volume only: ijk offsets of the neighbors that come earlier in memory order, 3 per neighbor
+        int64_t m_dims[3];
+        int64_t m_numElements;
+        bool m_isVolume;
+        
+        ClusterHelper();//prevent default, copy, assign
+        ClusterHelper(const ClusterHelper&);
+        ClusterHelper& operator=(const ClusterHelper&);
+    public:
+        /// clusters are connected through surface edges
+        explicit ClusterHelper(const SurfaceFile* mySurf);
+        
+        /// clusters are connected through voxel neighbors, element index is i + dims[0] * (j + dims[1] * k)
+        ClusterHelper(const int64_t dims[3], const VoxelConnectivity& connectivity = FACE);
+        
+        int64_t getNumberOfElements() const { return m_numElements; }
+        
+        /// elements with nonzero mask are clustered, labelsOut gets the cluster index of each element (-1 outside the mask), elementSizes may be NULL
+        void findClusters(const char* mask, const float* elementSizes, std::vector<int64_t>& labelsOut, std::vector<Cluster>& clustersOut) const;
+    };
+    
+}
+
+#endif //__CLUSTER_HELPER_H__
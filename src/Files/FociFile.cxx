@@ -120,6 +120,7 @@ FociFile::initializeFociFile()
     m_classNameHierarchy = new GroupAndNameHierarchyModel();
     m_metadata = new GiftiMetaData();
     m_forceUpdateOfGroupAndNameHierarchy = true;
+    m_unmodifiedContentStamp = 0;
 }
 
 
@@ -213,6 +214,7 @@ FociFile::clear()
         delete m_foci[i];
     }
     m_foci.clear();
+    m_unmodifiedContentStamp = 0;
 }
 
 /**
@@ -492,6 +494,7 @@ FociFile::invalidateAllAssignedColors()
         m_foci[i]->setClassRgbaInvalid();
     }
     m_forceUpdateOfGroupAndNameHierarchy = true;
+    m_unmodifiedContentStamp = 0;
 }
 
 /**
@@ -706,6 +709,24 @@ FociFile::clearModified()
     for (int32_t i = 0; i < numFoci; i++) {
         m_foci[i]->clearModified();
     }
+    
+    m_unmodifiedContentStamp = 0;
+}
+
+/**
+ * @return Stamp identifying the content of this file while it is
+ * not modified.  A new stamp is issued when the file is read, written,
+ * or cleared and when its assigned colors are invalidated.  The content
+ * of a modified file may change without a new stamp so callers caching
+ * anything derived from the file must also test isModified().
+ */
+int64_t
+FociFile::getUnmodifiedContentStamp() const
+{
+    if (m_unmodifiedContentStamp == 0) {
+        m_unmodifiedContentStamp = newModificationStamp();
+    }
+    return m_unmodifiedContentStamp;
 }
 
 
@@ -91,6 +91,8 @@ namespace caret {
         
         virtual void clearModified();
         
+        int64_t getUnmodifiedContentStamp() const;
+        
         static int32_t getFileVersion();
         
         static AString getFileVersionAsString();
@@ -128,6 +130,9 @@ namespace caret {
         /** force an update of the class and name hierarchy */
         bool m_forceUpdateOfGroupAndNameHierarchy;
         
+        /** Identifies content while not modified, zero if a new stamp is needed */
+        mutable int64_t m_unmodifiedContentStamp;
+        
         /** Version of this FociFile */
         static const int32_t s_fociFileVersion;
         
@@ -34,6 +34,26 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class AppendNodeVisitor : public GeodesicHelper::NodeVisitor
+    {
+        vector<int32_t>& m_nodes;
+        vector<float>& m_dists;
+    public:
+        AppendNodeVisitor(vector<int32_t>& nodes, vector<float>& dists) : m_nodes(nodes), m_dists(dists) { }
+        void visit(const int32_t& node, const float& dist)
+        {
+            m_nodes.push_back(node);
+            m_dists.push_back(dist);
+        }
+    };
+}
+
+GeodesicHelper::NodeVisitor::~NodeVisitor()
+{
+}
+
 GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float* correctedAreas)
 {
     CaretPointer<TopologyHelperBase> topoBase(new TopologyHelperBase(surfaceIn));
@@ -196,7 +216,16 @@ void GeodesicHelper::getNodesToGeoDist(const int32_t node, const float maxdist,
     CaretAssert(node < numNodes && node >= 0);
     if (node >= numNodes || maxdist < 0.0f || node < 0) return;//check what we asserted so release doesn't do strange things
     CaretMutexLocker locked(&inUse);//let sanity checks go multithreaded, as if it mattered
-    dijkstra(node, maxdist, nodesOut, distsOut, smoothflag);
+    AppendNodeVisitor myVisitor(nodesOut, distsOut);
+    dijkstra(node, maxdist, myVisitor, smoothflag);
+}
+
+void GeodesicHelper::visitNodesToGeoDist(const int32_t node, const float maxdist, NodeVisitor& visitor, const bool smoothflag)
+{
+    CaretAssert(node < numNodes && node >= 0);
+    if (node >= numNodes || maxdist < 0.0f || node < 0) return;
+    CaretMutexLocker locked(&inUse);
+    dijkstra(node, maxdist, visitor, smoothflag);
 }
 
 void GeodesicHelper::getNodesToGeoDist(const int32_t node, const float maxdist, std::vector<int32_t>& nodesOut, std::vector<float>& distsOut, std::vector<int32_t>& parentsOut, const bool smoothflag)
@@ -206,7 +235,8 @@ void GeodesicHelper::getNodesToGeoDist(const int32_t node, const float maxdist,
     CaretAssert(node < numNodes && node >= 0);
     if (node >= numNodes || maxdist < 0.0f || node < 0) return;
     CaretMutexLocker locked(&inUse);//we need the parents array to stay put, so don't scope this
-    dijkstra(node, maxdist, nodesOut, distsOut, smoothflag);
+    AppendNodeVisitor myVisitor(nodesOut, distsOut);
+    dijkstra(node, maxdist, myVisitor, smoothflag);
     int32_t mysize = (int32_t)nodesOut.size();
     parentsOut.resize(mysize);
     for (int32_t i = 0; i < mysize; ++i)
@@ -215,7 +245,7 @@ void GeodesicHelper::getNodesToGeoDist(const int32_t node, const float maxdist,
     }
 }
 
-void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vector<int32_t>& nodes, std::vector<float>& dists, bool smooth)
+void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, NodeVisitor& visitor, bool smooth)
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0;
     const int32_t* neighbors;
@@ -230,8 +260,7 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
     while (!m_active.isEmpty())
     {
         whichnode = m_active.pop();
-        nodes.push_back(whichnode);
-        dists.push_back(output[whichnode]);
+        visitor.visit(whichnode, output[whichnode]);
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4)
         neighbors = nodeNeighbors[whichnode].data();
         numNeigh = (int32_t)nodeNeighbors[whichnode].size();
@@ -65,6 +65,15 @@ namespace caret {
 
     class GeodesicHelper
     {
+    public:
+        ///receives (node, distance) pairs in order of increasing distance, instead of building output vectors
+        class NodeVisitor
+        {
+        public:
+            virtual void visit(const int32_t& node, const float& dist) = 0;
+            virtual ~NodeVisitor();
+        };
+    private:
         CaretPointer<const GeodesicHelperBase> m_myBase;//mostly just for automatic memory management
         CaretMutex inUse;//could add a function and a locker pointer to be able to lock to thread once, then call repeatedly without locking, if mutex overhead is actually a factor
         CaretMinHeap<int32_t, float> m_active;//save and reuse the allocated space
@@ -84,7 +93,7 @@ namespace caret {
         GeodesicHelper();//Don't allow construction without arguments
         GeodesicHelper& operator=(const GeodesicHelper& right);//can't assign
         GeodesicHelper(const GeodesicHelper&);//can't use copy constructor
-        void dijkstra(const int32_t root, const float maxdist, std::vector<int32_t>& nodes, std::vector<float>& dists, bool smooth);//geodesic distance restricted
+        void dijkstra(const int32_t root, const float maxdist, NodeVisitor& visitor, bool smooth);//geodesic distance restricted
         void dijkstra(const int32_t root, bool smooth);//full surface
         void dijkstra(const int32_t root, const std::vector<int32_t>& interested, bool smooth);//partial surface
         int32_t dijkstra(const std::vector<int32_t>& startList, const std::vector<int32_t>& endList, const float& maxDist, bool smooth);//one path that connects lists
@@ -101,6 +110,9 @@ namespace caret {
         /// Get distances from root node, up to a geodesic distance cutoff (stops computing when no more nodes are within that distance)
         void getNodesToGeoDist(const int32_t node, const float maxdist, std::vector<int32_t>& neighborsOut, std::vector<float>& distsOut, const bool smoothflag = true);
 
+        /// Same as above, but streams each node and distance to the visitor without allocating, the visitor must not throw or call back into this helper
+        void visitNodesToGeoDist(const int32_t node, const float maxdist, NodeVisitor& visitor, const bool smoothflag = true);
+
         /// Get distances from root node, up to a geodesic distance cutoff, and also return their parents (root node has -1 as parent)
         void getNodesToGeoDist(const int32_t node, const float maxdist, std::vector<int32_t>& neighborsOut, std::vector<float>& distsOut, std::vector<int32_t>& parentsOut, const bool smoothflag = true);
 
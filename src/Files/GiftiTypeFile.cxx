@@ -19,6 +19,7 @@
 /*LICENSE_END*/
 
 #include "CaretLogger.h"
+#include "DataBlockSource.h"
 #include "DataFileContentInformation.h"
 #include "DataFileException.h"
 #include "FastStatistics.h"
@@ -90,6 +91,7 @@ GiftiTypeFile::clear()
 {
     DataFile::clear();
     this->giftiFile->clear(); 
+    this->invalidateFileStatistics();
 }
 
 /**
@@ -102,6 +104,17 @@ GiftiTypeFile::clearModified()
     this->giftiFile->clearModified();
 }
 
+/**
+ * Set this file as modified, data may have changed so
+ * statistics on all data in the file are invalidated.
+ */
+void
+GiftiTypeFile::setModified()
+{
+    CaretMappableDataFile::setModified();
+    this->invalidateFileStatistics();
+}
+
 /**
  * @return True if any of the maps in this file contain a
  * color mapping that possesses a modified status.
@@ -183,6 +196,7 @@ GiftiTypeFile::copyHelperGiftiTypeFile(const GiftiTypeFile& gtf)
     }
     this->giftiFile = new GiftiFile(*gtf.giftiFile);
     this->validateDataArraysAfterReading();
+    this->invalidateFileStatistics();
 }
 
 /**
@@ -607,6 +621,42 @@ GiftiTypeFile::getFileDataFloat(std::vector<float>& dataOut) const
     CaretAssert(dataOffset == static_cast<int64_t>(dataOut.size()));
 }
 
+/**
+ * Get all data for a file that contains floats as blocks that
+ * point into the data arrays, so that nothing is copied.
+ *
+ * @param blocksOut
+ *    Output with all data for a float file.  Empty if no data in file
+ *    or data is not float.
+ */
+void
+GiftiTypeFile::getFileDataFloatBlocks(MemoryBlockSource& blocksOut) const
+{
+    const int64_t numberOfDataArrays = this->giftiFile->getNumberOfDataArrays();
+    for (int64_t i = 0; i < numberOfDataArrays; i++) {
+        if (this->giftiFile->getDataArray(i)->getDataType() != NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32) {
+            return;
+        }
+    }
+    
+    for (int64_t i = 0; i < numberOfDataArrays; i++) {
+        const GiftiDataArray* gda = this->giftiFile->getDataArray(i);
+        blocksOut.addArray(gda->getDataPointerFloat(),
+                           gda->getTotalNumberOfElements());
+    }
+}
+
+/**
+ * Invalidate the statistics and histograms of all data in the file.
+ */
+void
+GiftiTypeFile::invalidateFileStatistics()
+{
+    m_fileFastStatistics.grabNew(NULL);
+    m_fileHistogram.grabNew(NULL);
+    m_fileHistorgramLimitedValues.grabNew(NULL);
+}
+
 /**
  * Get statistics describing the distribution of data
  * mapped with a color palette for all data within the file.
@@ -619,12 +669,11 @@ const FastStatistics*
 GiftiTypeFile::getFileFastStatistics()
 {
     if (m_fileFastStatistics == NULL) {
-        std::vector<float> fileData;
-        getFileDataFloat(fileData);
-        if ( ! fileData.empty()) {
+        MemoryBlockSource blockSource;
+        getFileDataFloatBlocks(blockSource);
+        if (blockSource.getNumberOfValues() > 0) {
             m_fileFastStatistics.grabNew(new FastStatistics());
-            m_fileFastStatistics->update(&fileData[0],
-                                         fileData.size());
+            m_fileFastStatistics->update(blockSource);
         }
     }
     
@@ -644,12 +693,11 @@ const Histogram*
 GiftiTypeFile::getFileHistogram()
 {
     if (m_fileHistogram == NULL) {
-        std::vector<float> fileData;
-        getFileDataFloat(fileData);
-        if ( ! fileData.empty()) {
+        MemoryBlockSource blockSource;
+        getFileDataFloatBlocks(blockSource);
+        if (blockSource.getNumberOfValues() > 0) {
             m_fileHistogram.grabNew(new Histogram());
-            m_fileHistogram->update(&fileData[0],
-                                    fileData.size());
+            m_fileHistogram->update(blockSource);
         }
     }
     return m_fileHistogram;
@@ -696,14 +744,13 @@ GiftiTypeFile::getFileHistogram(const float mostPositiveValueInclusive,
     }
     
     if (updateHistogramFlag) {
-        std::vector<float> fileData;
-        getFileDataFloat(fileData);
-        if ( ! fileData.empty()) {
+        MemoryBlockSource blockSource;
+        getFileDataFloatBlocks(blockSource);
+        if (blockSource.getNumberOfValues() > 0) {
             if (m_fileHistorgramLimitedValues == NULL) {
                 m_fileHistorgramLimitedValues.grabNew(new Histogram());
             }
-            m_fileHistorgramLimitedValues->update(&fileData[0],
-                                                  fileData.size(),
+            m_fileHistorgramLimitedValues->update(blockSource,
                                                   mostPositiveValueInclusive,
                                                   leastPositiveValueInclusive,
                                                   leastNegativeValueInclusive,
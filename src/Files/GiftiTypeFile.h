@@ -30,6 +30,7 @@
 namespace caret {
 
     class GiftiFile;
+    class MemoryBlockSource;
     class PaletteColorMapping;
     
     /// Encapsulates a GiftiFile for use by specific types of GIFTI data files.
@@ -64,6 +65,8 @@ namespace caret {
         
         virtual void clearModified();
         
+        virtual void setModified();
+        
         virtual bool isModifiedExcludingPaletteColorMapping() const;
         
         virtual bool isEmpty() const;
@@ -170,6 +173,10 @@ namespace caret {
         
         void initializeMembersGiftiTypeFile();
         
+        void getFileDataFloatBlocks(MemoryBlockSource& blocksOut) const;
+        
+        void invalidateFileStatistics();
+        
         /** Fast statistics used when statistics computed on all data in file */
         CaretPointer<FastStatistics> m_fileFastStatistics;
         
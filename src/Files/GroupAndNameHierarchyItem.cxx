@@ -128,6 +128,7 @@ GroupAndNameHierarchyItem::clearPrivate()
     for (int32_t i = 0; i < BrainConstants::MAXIMUM_NUMBER_OF_BROWSER_TABS; i++) {
         m_selectedInTab[i] = true;
     }
+    s_selectionChangeCounter++;
     
     bool defaultExpandStatus = false;
     switch (m_itemType) {
@@ -530,6 +531,7 @@ GroupAndNameHierarchyItem::setSelected(const DisplayGroupEnum::Enum displayGroup
     else {
         m_selectedInDisplayGroup[displayIndex] = status;
     }
+    s_selectionChangeCounter++;
 }
 
 /**
@@ -721,6 +723,7 @@ GroupAndNameHierarchyItem::copySelections(const int32_t sourceTabIndex,
 {
     m_selectedInTab[targetTabIndex] = m_selectedInTab[sourceTabIndex];
     m_expandedStatusInTab[targetTabIndex] = m_expandedStatusInTab[sourceTabIndex];
+    s_selectionChangeCounter++;
 
     for (std::vector<GroupAndNameHierarchyItem*>::const_iterator iter = m_children.begin();
          iter != m_children.end();
@@ -774,6 +777,17 @@ GroupAndNameHierarchyItem::getCounter() const
     return m_counter;
 }
 
+/**
+ * @return Counter that changes whenever the selection status of any
+ * item may have changed, so that anything derived from selections
+ * can be cached until the counter changes.
+ */
+int64_t
+GroupAndNameHierarchyItem::getSelectionChangeCounter()
+{
+    return s_selectionChangeCounter;
+}
+
 /**
  * Remove all descendants with counters equal to zero.
  */
@@ -930,6 +944,7 @@ GroupAndNameHierarchyItem::restoreFromScene(const SceneAttributes* sceneAttribut
     
     m_sceneAssistant->restoreMembers(sceneAttributes,
                                      sceneClass);
+    s_selectionChangeCounter++;
     
     for (std::vector<GroupAndNameHierarchyItem*>::iterator iter = m_children.begin();
          iter != m_children.end();
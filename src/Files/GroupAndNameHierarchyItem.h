@@ -129,6 +129,8 @@ namespace caret {
         
         void removeDescendantsWithCountersEqualToZeros();
         
+        static int64_t getSelectionChangeCounter();
+        
         // ADD_NEW_METHODS_HERE
 
         virtual AString toString() const;
@@ -238,10 +240,14 @@ namespace caret {
         /** Assists with scenes */
         SceneClassAssistant* m_sceneAssistant;
 
+        /** Incremented whenever the selection status of any item may have changed */
+        static int64_t s_selectionChangeCounter;
+        
         // ADD_NEW_MEMBERS_HERE
     };
     
 #ifdef __GROUP_AND_NAME_HIERARCHY_ITEM_DECLARE__
+    int64_t GroupAndNameHierarchyItem::s_selectionChangeCounter = 0;
 #endif // __GROUP_AND_NAME_HIERARCHY_ITEM_DECLARE__
 
 } // namespace
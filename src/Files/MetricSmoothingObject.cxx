@@ -32,6 +32,66 @@
 using namespace std;
 using namespace caret;
 
+namespace
+{
+    ///builds a gaussian kernel straight from the geodesic search, so the precompute loops don't need per-node distance vectors
+    class KernelVisitor : public GeodesicHelper::NodeVisitor
+    {
+        vector<int32_t>& m_nodes;
+        vector<float>& m_weights;
+        float& m_weightSum;
+        float m_gaussianDenom;
+        const float* m_nodeAreas;//NULL for unweighted
+        const float* m_roiColumn;//NULL for no ROI
+        bool m_sumOutsideRoi;//scattering kernels normalize by the weight outside the ROI too
+        int32_t m_numVisited;
+    public:
+        KernelVisitor(vector<int32_t>& nodes, vector<float>& weights, float& weightSum, const float& gaussianDenom,
+                      const float* nodeAreas = NULL, const float* roiColumn = NULL, const bool& sumOutsideRoi = false) :
+                      m_nodes(nodes), m_weights(weights), m_weightSum(weightSum), m_gaussianDenom(gaussianDenom),
+                      m_nodeAreas(nodeAreas), m_roiColumn(roiColumn), m_sumOutsideRoi(sumOutsideRoi)
+        {
+            reset();
+        }
+        void reset()
+        {
+            m_nodes.clear();
+            m_weights.clear();
+            m_weightSum = 0.0f;
+            m_numVisited = 0;
+        }
+        int32_t getNumVisited() const { return m_numVisited; }
+        void visit(const int32_t& node, const float& dist)
+        {
+            ++m_numVisited;
+            float weight = exp(dist * dist * m_gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
+            if (m_nodeAreas != NULL) weight *= m_nodeAreas[node];
+            bool inRoi = (m_roiColumn == NULL || m_roiColumn[node] > 0.0f);
+            if (inRoi || m_sumOutsideRoi) m_weightSum += weight;
+            if (inRoi)
+            {
+                m_nodes.push_back(node);
+                m_weights.push_back(weight);
+            }
+        }
+    };
+    
+    ///fallback for when the geodesic search missed a neighbor: rebuild the kernel from the node and its 1-hop neighbors
+    void kernelFromNeighbors(GeodesicHelper* geoHelp, const vector<int32_t>& neighbors, const int32_t& node,
+                             vector<int32_t>& nodeScratch, vector<float>& distScratch, KernelVisitor& visitor)
+    {
+        nodeScratch = neighbors;
+        nodeScratch.push_back(node);
+        geoHelp->getGeoToTheseNodes(node, nodeScratch, distScratch, true);
+        visitor.reset();
+        int32_t numNeigh = (int32_t)distScratch.size();
+        for (int32_t j = 0; j < numNeigh; ++j)
+        {
+            visitor.visit(nodeScratch[j], distScratch[j]);
+        }
+    }
+}
+
 MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi, Method myMethod, const float* nodeAreas)
 {
     CaretAssert(mySurf != NULL);
@@ -287,25 +347,16 @@ void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf,
     {
         CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();//don't really need one per thread here, but good practice in case we want getNeighborsToDepth
         CaretPointer<GeodesicHelper> myGeoHelp = mySurf->getGeodesicHelper();
-        vector<float> distances;
+        vector<float> distances;//only used by the fallback
+        vector<int32_t> nodes;
 #pragma omp CARET_FOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            myGeoHelp->getNodesToGeoDist(i, myGeoDist, m_weightLists[i].m_nodes, distances, true);
-            if (distances.size() < 7)
-            {
-                m_weightLists[i].m_nodes = myTopoHelp->getNodeNeighbors(i);
-                m_weightLists[i].m_nodes.push_back(i);
-                myGeoHelp->getGeoToTheseNodes(i, m_weightLists[i].m_nodes, distances, true);
-            }
-            int32_t numNeigh = (int32_t)distances.size();
-            m_weightLists[i].m_weights.resize(numNeigh);
-            m_weightLists[i].m_weightSum = 0.0f;
-            for (int32_t j = 0; j < numNeigh; ++j)
+            KernelVisitor myVisitor(m_weightLists[i].m_nodes, m_weightLists[i].m_weights, m_weightLists[i].m_weightSum, gaussianDenom);
+            myGeoHelp->visitNodesToGeoDist(i, myGeoDist, myVisitor, true);
+            if (myVisitor.getNumVisited() < 7)
             {
-                float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                m_weightLists[i].m_weights[j] = weight;
-                m_weightLists[i].m_weightSum += weight;
+                kernelFromNeighbors(myGeoHelp, myTopoHelp->getNodeNeighbors(i), i, nodes, distances, myVisitor);
             }
         }
     }
@@ -329,26 +380,11 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySu
         {
             if (myRoiColumn[i] > 0.0f)
             {
-                myGeoHelp->getNodesToGeoDist(i, myGeoDist, nodes, distances, true);
-                if (distances.size() < 7)
+                KernelVisitor myVisitor(m_weightLists[i].m_nodes, m_weightLists[i].m_weights, m_weightLists[i].m_weightSum, gaussianDenom, NULL, myRoiColumn);
+                myGeoHelp->visitNodesToGeoDist(i, myGeoDist, myVisitor, true);
+                if (myVisitor.getNumVisited() < 7)
                 {
-                    nodes = myTopoHelp->getNodeNeighbors(i);
-                    nodes.push_back(i);
-                    myGeoHelp->getGeoToTheseNodes(i, nodes, distances, true);
-                }
-                int32_t numNeigh = (int32_t)distances.size();
-                m_weightLists[i].m_weights.reserve(numNeigh);
-                m_weightLists[i].m_nodes.reserve(numNeigh);
-                m_weightLists[i].m_weightSum = 0.0f;
-                for (int32_t j = 0; j < numNeigh; ++j)
-                {
-                    if (myRoiColumn[nodes[j]] > 0.0f)
-                    {
-                        float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                        m_weightLists[i].m_weights.push_back(weight);
-                        m_weightLists[i].m_nodes.push_back(nodes[j]);
-                        m_weightLists[i].m_weightSum += weight;
-                    }
+                    kernelFromNeighbors(myGeoHelp, myTopoHelp->getNodeNeighbors(i), i, nodes, distances, myVisitor);
                 }
             }
         }
@@ -367,27 +403,20 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* myS
     {
         CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();//don't really need one per thread here, but good practice in case we want getNeighborsToDepth
         CaretPointer<GeodesicHelper> myGeoHelp(new GeodesicHelper(myGeoBase));
-        vector<float> distances;
+        vector<float> distances;//only used by the fallback
+        vector<int32_t> nodes;
 #pragma omp CARET_FOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
-        {
-            myGeoHelp->getNodesToGeoDist(i, myGeoDist, tempList[i].m_nodes, distances, true);
+        {//we multiply by area so that a node scattering to a dense region on one side and a sparse region on the other
+            //gives similar areal influence to each direction rather than giving a more influence on the dense region (simply because nodes are more numerous)
+            KernelVisitor myVisitor(tempList[i].m_nodes, tempList[i].m_weights, tempList[i].m_weightSum, gaussianDenom, nodeAreas);
+            myGeoHelp->visitNodesToGeoDist(i, myGeoDist, myVisitor, true);
             const vector<int32_t>& tempneighbors = myTopoHelp->getNodeNeighbors(i);
-            if (distances.size() <= tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
-            {
-                tempList[i].m_nodes = tempneighbors;
-                tempList[i].m_nodes.push_back(i);
-                myGeoHelp->getGeoToTheseNodes(i, tempList[i].m_nodes, distances, true);
-            }
-            int32_t numNeigh = (int32_t)distances.size();
-            tempList[i].m_weights.resize(numNeigh);
-            tempList[i].m_weightSum = 0.0f;
-            for (int32_t j = 0; j < numNeigh; ++j)
+            if (myVisitor.getNumVisited() <= (int32_t)tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
             {
-                float weight = exp(distances[j] * distances[j] * gaussianDenom) * nodeAreas[tempList[i].m_nodes[j]];//exp(- dist ^ 2 / (2 * sigma ^ 2)) * area
-                tempList[i].m_weights[j] = weight;//we multiply by area so that a node scattering to a dense region on one side and a sparse region on the other
-                tempList[i].m_weightSum += weight;//gives similar areal influence to each direction rather than giving a more influence on the dense region (simply because nodes are more numerous)
+                kernelFromNeighbors(myGeoHelp, tempneighbors, i, nodes, distances, myVisitor);
             }
+            int32_t numNeigh = (int32_t)tempList[i].m_nodes.size();
             float myFactor = nodeAreas[i] / tempList[i].m_weightSum;//make each scattering kernel sum to the area of the node it scatters from
             for (int32_t j = 0; j < numNeigh; ++j)
             {
@@ -438,25 +467,14 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile*
         {
             if (myRoiColumn[i] > 0.0f)//we don't need to scatter from things outside the ROI
             {
-                myGeoHelp->getNodesToGeoDist(i, myGeoDist, nodes, distances, true);
+                //we DO need to compute scattering TO things outside the ROI, so that our normalization doesn't increase the in-ROI influence of edge nodes,
+                //BUT, the visitor doesn't add them to the list
+                KernelVisitor myVisitor(tempList[i].m_nodes, tempList[i].m_weights, tempList[i].m_weightSum, gaussianDenom, nodeAreas, myRoiColumn, true);
+                myGeoHelp->visitNodesToGeoDist(i, myGeoDist, myVisitor, true);
                 const vector<int32_t>& tempneighbors = myTopoHelp->getNodeNeighbors(i);
-                if (distances.size() <= tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
+                if (myVisitor.getNumVisited() <= (int32_t)tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
                 {
-                    nodes = tempneighbors;
-                    nodes.push_back(i);
-                    myGeoHelp->getGeoToTheseNodes(i, nodes, distances, true);
-                }
-                int32_t numNeigh = (int32_t)distances.size();
-                tempList[i].m_weightSum = 0.0f;
-                for (int32_t j = 0; j < numNeigh; ++j)
-                {//but we DO need to compute scattering TO things outside the ROI, so that our normalization doesn't increase the in-ROI influence of edge nodes
-                    float weight = exp(distances[j] * distances[j] * gaussianDenom) * nodeAreas[nodes[j]];//exp(- dist ^ 2 / (2 * sigma ^ 2)) * area
-                    tempList[i].m_weightSum += weight;//add it to the total weight in order to normalize correctly
-                    if (myRoiColumn[nodes[j]] > 0.0f)
-                    {//BUT, don't add it to the list if it is outside the ROI
-                        tempList[i].m_nodes.push_back(nodes[j]);
-                        tempList[i].m_weights.push_back(weight);
-                    }
+                    kernelFromNeighbors(myGeoHelp, tempneighbors, i, nodes, distances, myVisitor);
                 }
                 float myFactor = nodeAreas[i] / tempList[i].m_weightSum;//make each scattering kernel sum to the area of the node it scatters from
                 int32_t numUsed = (int32_t)tempList[i].m_nodes.size();
@@ -501,27 +519,19 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* my
     {
         CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();//don't really need one per thread here, but good practice in case we want getNeighborsToDepth
         CaretPointer<GeodesicHelper> myGeoHelp = mySurf->getGeodesicHelper();
-        vector<float> distances;
+        vector<float> distances;//only used by the fallback
+        vector<int32_t> nodes;
 #pragma omp CARET_FOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            myGeoHelp->getNodesToGeoDist(i, myGeoDist, tempList[i].m_nodes, distances, true);
+            KernelVisitor myVisitor(tempList[i].m_nodes, tempList[i].m_weights, tempList[i].m_weightSum, gaussianDenom);
+            myGeoHelp->visitNodesToGeoDist(i, myGeoDist, myVisitor, true);
             const vector<int32_t>& tempneighbors = myTopoHelp->getNodeNeighbors(i);
-            if (distances.size() <= tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
+            if (myVisitor.getNumVisited() <= (int32_t)tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
             {
-                tempList[i].m_nodes = tempneighbors;
-                tempList[i].m_nodes.push_back(i);
-                myGeoHelp->getGeoToTheseNodes(i, tempList[i].m_nodes, distances, true);
-            }
-            int32_t numNeigh = (int32_t)distances.size();
-            tempList[i].m_weights.resize(numNeigh);
-            tempList[i].m_weightSum = 0.0f;
-            for (int32_t j = 0; j < numNeigh; ++j)
-            {
-                float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                tempList[i].m_weights[j] = weight;//we multiply by area so that a node scattering to a dense region on one side and a sparse region on the other
-                tempList[i].m_weightSum += weight;//gives similar areal influence to each direction rather than giving a more influence on the dense region (simply because nodes are more numerous)
+                kernelFromNeighbors(myGeoHelp, tempneighbors, i, nodes, distances, myVisitor);
             }
+            int32_t numNeigh = (int32_t)tempList[i].m_nodes.size();
             float myFactor = 1.0f / tempList[i].m_weightSum;//make each scattering kernel sum to 1
             for (int32_t j = 0; j < numNeigh; ++j)
             {
@@ -571,25 +581,14 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile*
         {
             if (myRoiColumn[i] > 0.0f)//we don't need to scatter from things outside the ROI
             {
-                myGeoHelp->getNodesToGeoDist(i, myGeoDist, nodes, distances, true);
+                //we DO need to compute scattering TO things outside the ROI, so that our normalization doesn't increase the in-ROI influence of edge nodes,
+                //BUT, the visitor doesn't add them to the list
+                KernelVisitor myVisitor(tempList[i].m_nodes, tempList[i].m_weights, tempList[i].m_weightSum, gaussianDenom, NULL, myRoiColumn, true);
+                myGeoHelp->visitNodesToGeoDist(i, myGeoDist, myVisitor, true);
                 const vector<int32_t>& tempneighbors = myTopoHelp->getNodeNeighbors(i);
-                if (distances.size() <= tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
+                if (myVisitor.getNumVisited() <= (int32_t)tempneighbors.size())//because neighbors doesn't include center, so if they are equal, geo is missing a neighbor
                 {
-                    nodes = tempneighbors;
-                    nodes.push_back(i);
-                    myGeoHelp->getGeoToTheseNodes(i, nodes, distances, true);
-                }
-                int32_t numNeigh = (int32_t)distances.size();
-                tempList[i].m_weightSum = 0.0f;
-                for (int32_t j = 0; j < numNeigh; ++j)
-                {//but we DO need to compute scattering TO things outside the ROI, so that our normalization doesn't increase the in-ROI influence of edge nodes
-                    float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                    tempList[i].m_weightSum += weight;//add it to the total weight in order to normalize correctly
-                    if (myRoiColumn[nodes[j]] > 0.0f)
-                    {//BUT, don't add it to the list if it is outside the ROI
-                        tempList[i].m_nodes.push_back(nodes[j]);
-                        tempList[i].m_weights.push_back(weight);
-                    }
+                    kernelFromNeighbors(myGeoHelp, tempneighbors, i, nodes, distances, myVisitor);
                 }
                 float myFactor = 1.0f / tempList[i].m_weightSum;//make each scattering kernel sum to 1
                 int32_t numUsed = (int32_t)tempList[i].m_nodes.size();
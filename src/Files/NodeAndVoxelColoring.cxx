@@ -21,6 +21,7 @@
 
 #include <cmath>
 #include <limits>
+#include <vector>
 
 //#include <QRunnable>
 //#include <QSemaphore>
@@ -528,6 +529,41 @@ NodeAndVoxelColoring::colorIndicesWithLabelTableForDisplayGroupTab(const GiftiLa
                                                             (void*)rgbv);
 }
 
+/**
+ * Constructor.
+ *
+ * @param labelTable
+ *    Label table whose selection is tested, may be NULL in which
+ *    case no key is deselected.
+ * @param displayGroup
+ *    The selected display group.
+ * @param tabIndex
+ *    Index of selected tab.
+ */
+NodeAndVoxelColoring::LabelSelectionLookup::LabelSelectionLookup(const GiftiLabelTable* labelTable,
+                                                                 const DisplayGroupEnum::Enum displayGroup,
+                                                                 const int32_t tabIndex)
+{
+    m_lookup = NULL;
+    if (labelTable == NULL) {
+        return;
+    }
+    
+    m_lookupPointer = labelTable->getLookup();
+    m_lookup = m_lookupPointer.getPointer();
+    
+    const int32_t numberOfLabels = m_lookup->getNumberOfLabels();
+    m_deselectedFlags.resize(numberOfLabels, 0);
+    for (int32_t iLabel = 0; iLabel < numberOfLabels; iLabel++) {
+        const GroupAndNameHierarchyItem* item = m_lookup->getLabelAtIndex(iLabel)->getGroupNameSelectionItem();
+        if (item != NULL) {
+            if (item->isSelected(displayGroup, tabIndex) == false) {
+                m_deselectedFlags[iLabel] = 1;
+            }
+        }
+    }
+}
+
 /**
  * Assign colors to label indices using a GIFTI label table.
  *
@@ -590,57 +626,75 @@ NodeAndVoxelColoring::colorIndicesWithLabelTableForDisplayGroupTabPrivate(const
     }
     
     /*
-     * Assign colors from labels to nodes
+     * Resolve selection and color once per label so that each
+     * index only needs a flat key lookup.
      */
-    float labelRGBA[4];
-	for (int64_t i = 0; i < numberOfIndices; i++) {
-        const int64_t labelKey = static_cast<int64_t>(labelIndices[i]);
-        const GiftiLabel* gl = labelTable->getLabel(labelKey);
-        if (gl != NULL) {
-            const GroupAndNameHierarchyItem* item = gl->getGroupNameSelectionItem();
-            bool colorDataFlag = false;
-            if (item != NULL) {
-                if (tabIndex == NodeAndVoxelColoring::INVALID_TAB_INDEX) {
-                    colorDataFlag = true;
-                }
-                else if (item->isSelected(displayGroup, tabIndex)) {
-                    colorDataFlag = true;
-                }
+    CaretPointer<const GiftiLabelTableLookup> lookupPointer = labelTable->getLookup();
+    const GiftiLabelTableLookup* lookup = lookupPointer.getPointer();
+    const int32_t numberOfLabels = lookup->getNumberOfLabels();
+    std::vector<float> labelRGBA(numberOfLabels * 4);
+    std::vector<uint8_t> labelRGBAByte(numberOfLabels * 4);
+    std::vector<char> labelColoredFlags(numberOfLabels, 0);
+    for (int32_t iLabel = 0; iLabel < numberOfLabels; iLabel++) {
+        const GiftiLabel* gl = lookup->getLabelAtIndex(iLabel);
+        const GroupAndNameHierarchyItem* item = gl->getGroupNameSelectionItem();
+        bool colorDataFlag = false;
+        if (item != NULL) {
+            if (tabIndex == NodeAndVoxelColoring::INVALID_TAB_INDEX) {
+                colorDataFlag = true;
             }
-            else {
+            else if (item->isSelected(displayGroup, tabIndex)) {
                 colorDataFlag = true;
             }
-            
-            if (colorDataFlag) {
-                gl->getColor(labelRGBA);
-                if (labelRGBA[3] > 0.0) {
-                    const int64_t i4 = i * 4;
-                    
-                    switch (colorDataType) {
-                        case COLOR_TYPE_FLOAT:
-                            CaretAssertArrayIndex(rgbaFloat, numberOfIndices * 4, i*4+3);
-                            rgbaFloat[i*4] = labelRGBA[0];
-                            rgbaFloat[i*4+1] = labelRGBA[1];
-                            rgbaFloat[i*4+2] = labelRGBA[2];
-                            rgbaFloat[i*4+3] = labelRGBA[3];
-                            break;
-                        case COLOR_TYPE_UNSIGNED_BTYE:
-                            CaretAssertArrayIndex(rgbaUnsignedByte, numberOfIndices * 4, i*4+3);
-                            rgbaUnsignedByte[i4]   = labelRGBA[0] * 255.0;
-                            rgbaUnsignedByte[i4+1] = labelRGBA[1] * 255.0;
-                            rgbaUnsignedByte[i4+2] = labelRGBA[2] * 255.0;
-                            if (labelRGBA[3] > 0.0) {
-                                rgbaUnsignedByte[i4+3] = labelRGBA[3] * 255.0;
-                            }
-                            else {
-                                rgbaUnsignedByte[i4+3] = 0;
-                            }
-                            break;
-                    }
-                }
+        }
+        else {
+            colorDataFlag = true;
+        }
+        
+        if (colorDataFlag) {
+            const int32_t i4 = iLabel * 4;
+            gl->getColor(&labelRGBA[i4]);
+            if (labelRGBA[i4 + 3] > 0.0) {
+                labelColoredFlags[iLabel] = 1;
+                labelRGBAByte[i4]   = labelRGBA[i4] * 255.0;
+                labelRGBAByte[i4+1] = labelRGBA[i4+1] * 255.0;
+                labelRGBAByte[i4+2] = labelRGBA[i4+2] * 255.0;
+                labelRGBAByte[i4+3] = labelRGBA[i4+3] * 255.0;
             }
         }
     }
+    
+    /*
+     * Assign colors from labels to nodes
+     */
+#pragma omp CARET_PARFOR schedule(static, 16384)
+	for (int64_t i = 0; i < numberOfIndices; i++) {
+        const int64_t labelKey = static_cast<int64_t>(labelIndices[i]);
+        const int32_t labelIndex = lookup->findIndex(labelKey);
+        if ((labelIndex < 0)
+            || (labelColoredFlags[labelIndex] == 0)) {
+            continue;
+        }
+        
+        const int64_t i4 = i * 4;
+        const int64_t label4 = labelIndex * 4;
+        switch (colorDataType) {
+            case COLOR_TYPE_FLOAT:
+                CaretAssertArrayIndex(rgbaFloat, numberOfIndices * 4, i*4+3);
+                rgbaFloat[i4]   = labelRGBA[label4];
+                rgbaFloat[i4+1] = labelRGBA[label4+1];
+                rgbaFloat[i4+2] = labelRGBA[label4+2];
+                rgbaFloat[i4+3] = labelRGBA[label4+3];
+                break;
+            case COLOR_TYPE_UNSIGNED_BTYE:
+                CaretAssertArrayIndex(rgbaUnsignedByte, numberOfIndices * 4, i*4+3);
+                rgbaUnsignedByte[i4]   = labelRGBAByte[label4];
+                rgbaUnsignedByte[i4+1] = labelRGBAByte[label4+1];
+                rgbaUnsignedByte[i4+2] = labelRGBAByte[label4+2];
+                rgbaUnsignedByte[i4+3] = labelRGBAByte[label4+3];
+                break;
+        }
+    }
 }
 
 /**
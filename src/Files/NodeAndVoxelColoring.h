@@ -22,9 +22,12 @@
 /*LICENSE_END*/
 
 #include <stdint.h>
+#include <vector>
 
 #include "CaretColorEnum.h"
+#include "CaretPointer.h"
 #include "DisplayGroupEnum.h"
+#include "GiftiLabelTableLookup.h"
 #include "LabelDrawingTypeEnum.h"
 
 namespace caret {
@@ -36,6 +39,34 @@ namespace caret {
     class NodeAndVoxelColoring {
         
     public:
+        /**
+         * Tests label keys against the label selection for a display group
+         * and tab, with selection resolved once per label instead of per voxel.
+         */
+        class LabelSelectionLookup {
+        public:
+            LabelSelectionLookup(const GiftiLabelTable* labelTable,
+                                 const DisplayGroupEnum::Enum displayGroup,
+                                 const int32_t tabIndex);
+            
+            /** @return True if the key's label exists and is not selected for display. */
+            inline bool isLabelKeyDeselected(const int64_t labelKey) const {
+                if (m_lookup == NULL) {
+                    return false;
+                }
+                const int32_t labelIndex = m_lookup->findIndex(labelKey);
+                return ((labelIndex >= 0)
+                        && (m_deselectedFlags[labelIndex] != 0));
+            }
+            
+        private:
+            CaretPointer<const GiftiLabelTableLookup> m_lookupPointer;
+            
+            const GiftiLabelTableLookup* m_lookup;
+            
+            std::vector<char> m_deselectedFlags;
+        };
+        
         static void colorScalarsWithPalette(const FastStatistics* statistics,
                                             const PaletteColorMapping* paletteColorMapping,
                                             const Palette* palette,
@@ -19,10 +19,15 @@
  */
 /*LICENSE_END*/
 
+#include <QFileInfo>
 #include <QTextStream>
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <string>
 
 #define __SCENE_FILE_DECLARE__
 #include "SceneFile.h"
@@ -30,6 +35,8 @@
 
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretMappedFile.h"
+#include "CaretProfiler.h"
 #include "DataFileContentInformation.h"
 #include "DataFileException.h"
 #include "FileAdapter.h"
@@ -39,6 +46,7 @@
 #include "SceneAttributes.h"
 #include "SceneClass.h"
 #include "SceneClassArray.h"
+#include "SceneDeferredContent.h"
 #include "SceneFileSaxReader.h"
 #include "SceneInfo.h"
 #include "SceneXmlElements.h"
@@ -48,6 +56,143 @@
 #include "XmlWriter.h"
 
 using namespace caret;
+using namespace std;
+
+namespace
+{
+    ///byte offsets of a Scene element, the content range is everything after its name and description
+    struct SceneElementLocation
+    {
+        int64_t m_start, m_startTagEnd, m_contentStart, m_contentEnd;
+    };
+    
+    bool matchesAt(const char* data, const int64_t& size, const int64_t& pos, const char* text)
+    {
+        const int64_t length = strlen(text);
+        return (pos + length <= size) && (memcmp(data + pos, text, length) == 0);
+    }
+    
+    ///returns -1 if not found
+    int64_t findText(const char* data, const int64_t& size, const int64_t& pos, const char* text)
+    {
+        const char* found = search(data + pos, data + size, text, text + strlen(text));
+        if (found == data + size) return -1;
+        return found - data;
+    }
+    
+    ///finds the Scene children of the root element without building anything, returns false if the file
+    ///uses anything this simple scan doesn't handle, so the caller can parse the whole file instead
+    bool findSceneElements(const char* data, const int64_t& size, vector<SceneElementLocation>& locationsOut)
+    {
+        locationsOut.clear();
+        const string rootTag = SceneFile::XML_TAG_SCENE_FILE.toStdString();
+        const string sceneTag = SceneXmlElements::SCENE_TAG.toStdString();
+        const string nameTag = SceneXmlElements::SCENE_NAME_TAG.toStdString();
+        const string descriptionTag = SceneXmlElements::SCENE_DESCRIPTION_TAG.toStdString();
+        int64_t depth = 0, pos = 0;
+        bool foundRoot = false, inScene = false;
+        SceneElementLocation current;
+        while (pos < size)
+        {
+            const char* next = (const char*)memchr(data + pos, '<', size - pos);
+            if (next == NULL) break;
+            const int64_t tagStart = next - data;
+            if (matchesAt(data, size, tagStart, "<!--"))
+            {
+                const int64_t end = findText(data, size, tagStart + 4, "-->");
+                if (end < 0) return false;
+                pos = end + 3;
+                continue;
+            }
+            if (matchesAt(data, size, tagStart, "<![CDATA["))
+            {
+                const int64_t end = findText(data, size, tagStart + 9, "]]>");
+                if (end < 0) return false;
+                pos = end + 3;
+                continue;
+            }
+            if (matchesAt(data, size, tagStart, "<?"))
+            {
+                const int64_t end = findText(data, size, tagStart + 2, "?>");
+                if (end < 0) return false;
+                if (matchesAt(data, size, tagStart, "<?xml"))
+                {//scene pieces are decoded as UTF-8, so other declared encodings get a full parse
+                    string declaration(data + tagStart, end - tagStart);
+                    for (size_t i = 0; i < declaration.size(); ++i) declaration[i] = tolower(declaration[i]);
+                    const size_t encodingPos = declaration.find("encoding");
+                    if (encodingPos != string::npos && declaration.find("utf-8", encodingPos) == string::npos) return false;
+                }
+                pos = end + 2;
+                continue;
+            }
+            if (matchesAt(data, size, tagStart, "<!"))
+            {
+                const int64_t end = findText(data, size, tagStart + 2, ">");
+                if (end < 0) return false;
+                if (findText(data, end, tagStart + 2, "[") >= 0) return false;//internal DTD subset could declare entities
+                pos = end + 1;
+                continue;
+            }
+            if (matchesAt(data, size, tagStart, "</"))
+            {
+                const int64_t end = findText(data, size, tagStart + 2, ">");
+                if (end < 0) return false;
+                --depth;
+                if (depth < 0) return false;
+                if (inScene && depth == 1)
+                {
+                    current.m_contentEnd = tagStart;
+                    if (current.m_contentStart < 0) current.m_contentStart = tagStart;
+                    locationsOut.push_back(current);
+                    inScene = false;
+                }
+                pos = end + 1;
+                continue;
+            }
+            int64_t nameEnd = tagStart + 1;
+            while (nameEnd < size && !isspace((unsigned char)data[nameEnd]) && data[nameEnd] != '/' && data[nameEnd] != '>') ++nameEnd;
+            const string name(data + tagStart + 1, nameEnd - tagStart - 1);
+            int64_t tagEnd = nameEnd;
+            char quote = '\0';
+            for (; tagEnd < size; ++tagEnd)
+            {//attribute values may contain '>'
+                const char c = data[tagEnd];
+                if (quote != '\0')
+                {
+                    if (c == quote) quote = '\0';
+                } else if (c == '"' || c == '\'') {
+                    quote = c;
+                } else if (c == '>') {
+                    break;
+                }
+            }
+            if (tagEnd >= size) return false;
+            const bool emptyElement = (data[tagEnd - 1] == '/');
+            if (depth == 0)
+            {
+                if (foundRoot || name != rootTag) return false;
+                foundRoot = true;
+            } else if (depth == 1 && name == sceneTag) {
+                current.m_start = tagStart;
+                current.m_startTagEnd = tagEnd + 1;
+                current.m_contentStart = -1;
+                if (emptyElement)
+                {
+                    current.m_contentStart = tagEnd + 1;
+                    current.m_contentEnd = tagEnd + 1;
+                    locationsOut.push_back(current);
+                } else {
+                    inScene = true;
+                }
+            } else if (depth == 2 && inScene && current.m_contentStart < 0 && name != nameTag && name != descriptionTag) {
+                current.m_contentStart = tagStart;
+            }
+            if (!emptyElement) ++depth;
+            pos = tagEnd + 1;
+        }
+        return foundRoot && depth == 0 && !inScene;
+    }
+}
 
 
     
@@ -514,6 +659,11 @@ SceneFile::setBaseDirectory(const AString& baseDirectory)
 
 /**
  * Read the scene file.
+ *
+ * A local file is first indexed so that only the scene info and each
+ * scene's name and description are parsed.  The classes of each scene
+ * are parsed from the file when the scene is first used.
+ *
  * @param filenameIn
  *    Name of scene file.
  * @throws DataFileException
@@ -522,20 +672,99 @@ SceneFile::setBaseDirectory(const AString& baseDirectory)
 void 
 SceneFile::readFile(const AString& filenameIn)
 {
+    CaretProfileSpan mySpan("SceneFile::readFile", "io");
     clear();
     
     AString filename = filenameIn;
-    if (DataFile::isFileOnNetwork(filename) == false) {
+    const bool localFileFlag = (DataFile::isFileOnNetwork(filename) == false);
+    if (localFileFlag) {
         FileInformation specInfo(filename);
         filename = specInfo.getAbsoluteFilePath();
     }
     checkFileReadability(filename);
     
     this->setFileName(filename);
+    
+    /*
+     * Find the scene classes in the file, if the scan fails
+     * the entire file is parsed.
+     */
+    QByteArray sceneIndexDocument;
+    std::vector<SceneElementLocation> sceneLocations;
+    CaretMappedFile mappedFile;
+    const QFileInfo fileInfo(filename);
+    const int64_t fileSize = fileInfo.size();
+    const QDateTime fileLastModified = fileInfo.lastModified();
+    bool indexedFlag = false;
+    if (localFileFlag
+        && mappedFile.open(filename)
+        && (mappedFile.getSize() == fileSize)
+        && (fileSize < std::numeric_limits<int>::max())) {
+        const char* data = (const char*)mappedFile.getData();
+        if (findSceneElements(data, fileSize, sceneLocations)) {
+            int64_t previousEnd = 0;
+            for (std::vector<SceneElementLocation>::const_iterator iter = sceneLocations.begin();
+                 iter != sceneLocations.end();
+                 iter++) {
+                sceneIndexDocument.append(data + previousEnd, iter->m_contentStart - previousEnd);
+                previousEnd = iter->m_contentEnd;
+            }
+            sceneIndexDocument.append(data + previousEnd, fileSize - previousEnd);
+            indexedFlag = true;
+        }
+    }
+    
     SceneFileSaxReader saxReader(this);
     std::auto_ptr<XmlSaxParser> parser(XmlSaxParser::createXmlParser());
     try {
-        parser->parseFile(filename, &saxReader);
+        if (indexedFlag) {
+            int64_t utf8Offset = 0;
+            if (sceneIndexDocument.startsWith("\xEF\xBB\xBF")) {
+                utf8Offset = 3;
+            }
+            parser->parseString(QString::fromUtf8(sceneIndexDocument.constData() + utf8Offset,
+                                                  sceneIndexDocument.size() - utf8Offset),
+                                &saxReader);
+            sceneIndexDocument.clear();
+            
+            const int32_t numScenes = getNumberOfScenes();
+            if (numScenes != static_cast<int32_t>(sceneLocations.size())) {
+                throw XmlSaxParserException("Number of scenes found while indexing ("
+                                            + AString::number(sceneLocations.size())
+                                            + ") does not match number of scenes read ("
+                                            + AString::number(numScenes)
+                                            + ")");
+            }
+            int64_t deferredBytes = 0;
+            for (int32_t i = 0; i < numScenes; i++) {
+                const SceneElementLocation& location = sceneLocations[i];
+                const int64_t contentSize = location.m_contentEnd - location.m_contentStart;
+                if (contentSize > 0) {
+                    const char* data = (const char*)mappedFile.getData();
+                    m_scenes[i]->setDeferredContent(new SceneDeferredContent(filename,
+                                                                             QByteArray(data + location.m_start,
+                                                                                        location.m_startTagEnd - location.m_start),
+                                                                             location.m_contentStart,
+                                                                             contentSize,
+                                                                             fileSize,
+                                                                             fileLastModified));
+                    deferredBytes += contentSize;
+                }
+            }
+            mySpan.addBytes(fileSize - deferredBytes);
+            CaretLogFine("Indexed "
+                         + AString::number(numScenes)
+                         + " scenes in "
+                         + filename
+                         + ", parsing of "
+                         + AString::number(deferredBytes)
+                         + " of "
+                         + AString::number(fileSize)
+                         + " bytes deferred until scenes are used");
+        }
+        else {
+            parser->parseFile(filename, &saxReader);
+        }
     }
     catch (const XmlSaxParserException& e) {
         clear();
@@ -579,6 +808,20 @@ SceneFile::writeFile(const AString& filename)
 {
     checkFileWritability(filename);
     
+    /*
+     * Scenes that have not been used are still in the file
+     * being read, which may be the file that is overwritten.
+     */
+    const int32_t numScenesToLoad = getNumberOfScenes();
+    for (int32_t i = 0; i < numScenesToLoad; i++) {
+        AString errorMessage;
+        if (m_scenes[i]->loadDeferredContent(errorMessage) == false) {
+            throw DataFileException(filename,
+                                    (errorMessage
+                                     + "\nThe scene file was not written."));
+        }
+    }
+    
     this->setFileName(filename);
     
     try {
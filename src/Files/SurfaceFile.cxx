@@ -124,6 +124,8 @@ SurfaceFile::clear()
     coordinatePointer = NULL;
     triangleDataArray = NULL;
     trianglePointer = NULL;
+    m_coordinateStamp = 0;
+    m_topologyStamp = 0;
     GiftiTypeFile::clear();
     invalidateHelpers();
     this->invalidateNodeColoringForBrowserTabs();
@@ -448,6 +450,7 @@ void SurfaceFile::setTriangle(const int32_t& index, const int32_t& node1, const
     trianglePointer[offset] = node1;
     trianglePointer[offset + 1] = node2;
     trianglePointer[offset + 2] = node3;
+    m_topologyStamp = 0;
     invalidateHelpers();
     invalidateNormals();
     setModified();
@@ -515,6 +518,8 @@ SurfaceFile::initializeMembersSurfaceFile()
     m_geoHelperIndex = 0;
     m_topoHelperIndex = 0;
     m_normalsComputed = false;
+    m_coordinateStamp = 0;
+    m_topologyStamp = 0;
 }
 
 /**
@@ -555,7 +560,35 @@ void
 SurfaceFile::invalidateNormals()
 {
     m_normalsComputed = false;
+    m_coordinateStamp = 0;
 }
+
+/**
+ * @return Stamp that changes whenever the coordinates or normal vectors
+ * change.  Stamps are never reused, even by another surface.
+ */
+int64_t
+SurfaceFile::getCoordinateModificationStamp() const
+{
+    if (m_coordinateStamp == 0) {
+        m_coordinateStamp = newModificationStamp();
+    }
+    return m_coordinateStamp;
+}
+
+/**
+ * @return Stamp that changes whenever the triangles change.
+ * Stamps are never reused, even by another surface.
+ */
+int64_t
+SurfaceFile::getTopologyModificationStamp() const
+{
+    if (m_topologyStamp == 0) {
+        m_topologyStamp = newModificationStamp();
+    }
+    return m_topologyStamp;
+}
+
 /**
  * Compute surface normals.
  */
@@ -567,6 +600,7 @@ SurfaceFile::computeNormals()
         return;
     }
     m_normalsComputed = true;
+    m_coordinateStamp = 0;
     int32_t numCoords = this->getNumberOfNodes();
     if (numCoords > 0) {
         this->normalVectors.resize(numCoords * 3);
@@ -741,14 +775,25 @@ SurfaceFile::setSecondaryType(const SecondarySurfaceTypeEnum::Enum secondaryType
 
 void SurfaceFile::getGeodesicHelper(CaretPointer<GeodesicHelper>& helpOut) const
 {
+    int32_t threadSlot = 0;
+#ifdef CARET_OMP
+    threadSlot = omp_get_thread_num();//nested teams can share a thread number, the reference count check below still keeps helpers private
+#endif
     {//lock before modifying member (base)
         CaretMutexLocker myLock(&m_geoHelperMutex);
         if (m_geoBase == NULL)
         {
             m_geoHelpers.clear();//just to be sure
+            m_geoThreadHelpers.clear();
             m_geoHelperIndex = 0;
             m_geoBase.grabNew(new GeodesicHelperBase(this));//yes, this takes some time, and is single threaded at the moment
         }//keep locked while searching
+        if (threadSlot < (int32_t)m_geoThreadHelpers.size() && m_geoThreadHelpers[threadSlot] != NULL &&
+            m_geoThreadHelpers[threadSlot].getReferenceCount() == 1)
+        {//same thread number gets the same helper back, its scratch arrays are already warm, and no search is needed
+            helpOut = m_geoThreadHelpers[threadSlot];
+            return;
+        }
         int32_t& myIndex = m_geoHelperIndex;
         int32_t myEnd = m_geoHelpers.size();
         for (int32_t i = 0; i < myEnd; ++i)
@@ -765,7 +810,13 @@ void SurfaceFile::getGeodesicHelper(CaretPointer<GeodesicHelper>& helpOut) const
     }//UNLOCK before building a new one, so they can be built in parallel - this actually just involves initializing the marked array
     CaretPointer<GeodesicHelper> ret(new GeodesicHelper(m_geoBase));
     CaretMutexLocker myLock(&m_geoHelperMutex);//relock before modifying the array
-    m_geoHelpers.push_back(ret);
+    if (threadSlot >= (int32_t)m_geoThreadHelpers.size()) m_geoThreadHelpers.resize(threadSlot + 1);
+    if (m_geoThreadHelpers[threadSlot] == NULL)
+    {
+        m_geoThreadHelpers[threadSlot] = ret;
+    } else {
+        m_geoHelpers.push_back(ret);
+    }
     helpOut = ret;
 }
 
@@ -853,6 +904,7 @@ void SurfaceFile::invalidateHelpers()
         CaretMutexLocker myLock(&m_geoHelperMutex);//make this function threadsafe
         m_geoHelperIndex = 0;
         m_geoHelpers.clear();//CaretPointers make this nice, if they are still in use elsewhere, they don't vanish, even though this class is supposed to "control" them to some extent
+        m_geoThreadHelpers.clear();
         m_geoBase.grabNew(NULL);
     }
     if (m_topoBase != NULL)
@@ -979,6 +1031,7 @@ SurfaceFile::applyMatrix(const Matrix4x4& matrix)
         }
     }
     
+    invalidateNormals();
     computeNormals();
     
     setModified();
@@ -1036,6 +1089,7 @@ SurfaceFile::flipNormals()
         trianglePointer[offset] = trianglePointer[offset + 1];
         trianglePointer[offset + 1] = tempvert;
     }
+    m_topologyStamp = 0;
     invalidateNormals();
     invalidateHelpers();//sorted topology helpers would change, so just for completeness
     setModified();
@@ -1190,6 +1244,7 @@ void SurfaceFile::clearCachedHelpers() const
         CaretMutexLocker locked(&m_geoHelperMutex);
         m_geoHelperIndex = 0;
         m_geoHelpers.clear();
+        m_geoThreadHelpers.clear();
         m_geoBase.grabNew(NULL);
     }
     {
@@ -176,6 +176,10 @@ namespace caret {
 
         void invalidateNormals();
         
+        int64_t getCoordinateModificationStamp() const;
+        
+        int64_t getTopologyModificationStamp() const;
+        
         void translateToCenterOfMass();
         
         void flipNormals();
@@ -257,6 +261,9 @@ namespace caret {
         
         bool m_normalsComputed;
         
+        ///stamps are handed out lazily after coordinates/normals or triangles change, zero means a new stamp is needed
+        mutable int64_t m_coordinateStamp, m_topologyStamp;
+        
         bool m_skipSanityCheck;
 
         ///topology base for surface
@@ -274,6 +281,9 @@ namespace caret {
         ///tracks allocated geodesic helpers for this class
         mutable std::vector<CaretPointer<GeodesicHelper> > m_geoHelpers;
         
+        ///geodesic helpers indexed by openmp thread number, tried before searching m_geoHelpers
+        mutable std::vector<CaretPointer<GeodesicHelper> > m_geoThreadHelpers;
+        
         ///used to search through geodesic helpers without starting from 0 every time, wraps around
         mutable int32_t m_geoHelperIndex;
         
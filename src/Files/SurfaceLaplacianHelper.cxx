@@ -0,0 +1,119 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SurfaceLaplacianHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+#include "MathFunctions.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+
+#include <algorithm>
+
+using namespace caret;
+using namespace std;
+
+SurfaceLaplacianHelper::SurfaceLaplacianHelper(const SurfaceFile* mySurf)
+{
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper(true);//need sorted neighbors for the triangles around each node
+    m_numNodes = mySurf->getNumberOfNodes();
+    m_neighborOffsets.resize(m_numNodes + 1);
+    m_neighborOffsets[0] = 0;
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        m_neighborOffsets[i + 1] = m_neighborOffsets[i] + myTopoHelp->getNodeNumberOfNeighbors(i);
+    }
+    m_neighbors.resize(m_neighborOffsets[m_numNodes]);
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(i);
+        CaretAssert((int32_t)neighbors.size() == m_neighborOffsets[i + 1] - m_neighborOffsets[i]);
+        copy(neighbors.begin(), neighbors.end(), m_neighbors.begin() + m_neighborOffsets[i]);
+    }
+}
+
+void SurfaceLaplacianHelper::smoothNodeAreaWeighted(const float* coordsIn, float* coordsOut, const int32_t& node, const float& strength) const
+{
+    const int32_t start = m_neighborOffsets[node];
+    const int32_t numNeighbors = m_neighborOffsets[node + 1] - start;
+    const float* c1 = coordsIn + node * 3;
+    float* out = coordsOut + node * 3;
+    if (numNeighbors < 2)
+    {
+        out[0] = c1[0];
+        out[1] = c1[1];
+        out[2] = c1[2];
+        return;
+    }
+    const int32_t* neighbors = m_neighbors.data() + start;
+    double totalArea = 0.0;
+    double weightedCenter[3] = { 0.0, 0.0, 0.0 };
+    for (int32_t j = 0; j < numNeighbors; ++j)
+    {
+        const int32_t next = (j + 1 < numNeighbors) ? j + 1 : 0;
+        const float* c2 = coordsIn + neighbors[j] * 3;
+        const float* c3 = coordsIn + neighbors[next] * 3;
+        const float area = MathFunctions::triangleArea(c1, c2, c3);
+        totalArea += area;
+        if (area > 0.0f)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                weightedCenter[k] += area * ((c1[k] + c2[k] + c3[k]) / 3.0f);
+            }
+        }
+    }
+    const float inverseStrength = 1.0f - strength;
+    for (int k = 0; k < 3; ++k)
+    {
+        float neighborAverage = 0.0f;//degenerate neighborhoods (all zero area) get no neighbor influence, as before
+        if (totalArea > 0.0)
+        {
+            neighborAverage = weightedCenter[k] / totalArea;
+        }
+        out[k] = c1[k] * inverseStrength + neighborAverage * strength;
+    }
+}
+
+void SurfaceLaplacianHelper::smoothAreaWeighted(float* coordsInOut, const float& strength, const int32_t& iterations) const
+{
+    if (iterations <= 0 || m_numNodes <= 0) return;
+    vector<float> scratch(m_numNodes * 3);
+    float* buffers[2] = { coordsInOut, scratch.data() };//double buffer, swapped every iteration instead of copying
+#pragma omp CARET_PAR
+    {//all iterations happen in one parallel region, static scheduling keeps each thread on the same nodes so their outputs stay in its cache
+     //each iteration is still a full pass over the coordinates, fusing iterations would need halo tracking across the irregular partitions
+        for (int32_t iter = 0; iter < iterations; ++iter)
+        {
+            const float* coordsIn = buffers[iter % 2];
+            float* coordsOut = buffers[(iter + 1) % 2];
+#pragma omp CARET_FOR schedule(static)
+            for (int32_t node = 0; node < m_numNodes; ++node)
+            {
+                smoothNodeAreaWeighted(coordsIn, coordsOut, node, strength);
+            }//implicit barrier before the next iteration reads this output
+        }
+    }
+    if (iterations % 2 == 1)
+    {
+        copy(scratch.begin(), scratch.end(), coordsInOut);
+    }
+}
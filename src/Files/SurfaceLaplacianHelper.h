@@ -0,0 +1,56 @@
+#ifndef __SURFACE_LAPLACIAN_HELPER_H__
+#define __SURFACE_LAPLACIAN_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+
+#include <vector>
+
+namespace caret {
+    
+    class SurfaceFile;
+    
+    /// Iterated neighborhood averaging of surface coordinates, shared by the surface smoothing and inflation algorithms
+    class SurfaceLaplacianHelper
+    {
+        std::vector<int32_t> m_neighborOffsets;//CSR adjacency: neighbors of node i are m_neighbors[m_neighborOffsets[i]] to m_neighbors[m_neighborOffsets[i + 1] - 1]
+        std::vector<int32_t> m_neighbors;//sorted around each node, so consecutive neighbors form a triangle with the node
+        int32_t m_numNodes;
+        
+        void smoothNodeAreaWeighted(const float* coordsIn, float* coordsOut, const int32_t& node, const float& strength) const;
+        
+        SurfaceLaplacianHelper();//prevent default, copy, assign
+        SurfaceLaplacianHelper(const SurfaceLaplacianHelper&);
+        SurfaceLaplacianHelper& operator=(const SurfaceLaplacianHelper&);
+    public:
+        /// build the adjacency from the surface topology
+        explicit SurfaceLaplacianHelper(const SurfaceFile* mySurf);
+        
+        int32_t getNumberOfNodes() const { return m_numNodes; }
+        
+        /// move each node toward the area-weighted average of the centers of its triangles, coordinates are packed xyz, modified in place
+        void smoothAreaWeighted(float* coordsInOut, const float& strength, const int32_t& iterations) const;
+    };
+    
+}
+
+#endif //__SURFACE_LAPLACIAN_HELPER_H__
@@ -29,6 +29,7 @@
 #include "CaretTemporaryFile.h"
 #include "ChartDataCartesian.h"
 #include "ChartDataSource.h"
+#include "DataBlockSource.h"
 #include "DataFileContentInformation.h"
 #include "ElapsedTimer.h"
 #include "EventManager.h"
@@ -85,6 +86,7 @@ VolumeFile::VolumeFile()
         m_chartingEnabledForTab[i] = false;
     }
     m_volumeFileEditorDelegate.grabNew(NULL);
+    m_haveWritingDataType = false;
     validateMembers();
 }
 
@@ -99,6 +101,7 @@ VolumeFile::VolumeFile(const vector<int64_t>& dimensionsIn, const vector<vector<
         m_chartingEnabledForTab[i] = false;
     }
     m_volumeFileEditorDelegate.grabNew(NULL);
+    m_haveWritingDataType = false;
     validateMembers();
     setType(whatType);
 }
@@ -308,10 +311,23 @@ VolumeFile::writeFile(const AString& filename)
     {
         outHeader = *((NiftiHeader*)m_header.getPointer());//also shallow copies extensions
     }
-    outHeader.clearDataScaling();
     outHeader.setSForm(getVolumeSpace().getSform());
     outHeader.setDimensions(getOriginalDimensions());
-    outHeader.setDataType(NIFTI_TYPE_FLOAT32);
+    NiftiOutputDataType writeType = (m_haveWritingDataType ? m_writingDataType : NiftiOutputDataType::getDefault());
+    const int64_t* dims = getDimensionsPtr();
+    const int64_t frameSize = dims[0] * dims[1] * dims[2];
+    if (writeType.needsScan())
+    {//the data is all in memory, so finding the range first is cheap
+        for (int64_t b = 0; b < dims[3]; ++b)
+        {
+            writeType.scanData(getFrame(b), frameSize);
+        }
+    }
+    writeType.configureHeader(outHeader);//also clears old scaling
+    for (int64_t b = 0; b < dims[3]; ++b)
+    {//check everything before creating the file, so a refused datatype doesn't leave a truncated file behind
+        writeType.checkData(getFrame(b), frameSize);
+    }
     NiftiIO myIO;
     int outVersion = 1;
     if (!outHeader.canWriteVersion(1)) outVersion = 2;
@@ -332,6 +348,12 @@ VolumeFile::writeFile(const AString& filename)
     m_volumeFileEditorDelegate->updateIfVolumeFileChangedNumberOfMaps();
 }
 
+void VolumeFile::setWritingDataType(const NiftiOutputDataType& type)
+{
+    m_writingDataType = type;
+    m_haveWritingDataType = true;
+}
+
 float VolumeFile::interpolateValue(const float* coordIn, InterpType interp, bool* validOut, const int64_t brickIndex, const int64_t component) const
 {
     return interpolateValue(coordIn[0], coordIn[1], coordIn[2], interp, validOut, brickIndex, component);
@@ -929,12 +951,11 @@ const FastStatistics*
 VolumeFile::getFileFastStatistics()
 {
     if (m_fileFastStatistics == NULL) {
-        std::vector<float> fileData;
-        getFileData(fileData);
-        if ( ! fileData.empty()) {
+        MemoryBlockSource blockSource;
+        getFileDataBlocks(blockSource);
+        if (blockSource.getNumberOfValues() > 0) {
             m_fileFastStatistics.grabNew(new FastStatistics());
-            m_fileFastStatistics->update(&fileData[0],
-                                         fileData.size());
+            m_fileFastStatistics->update(blockSource);
         }
     }
     
@@ -954,12 +975,11 @@ const Histogram*
 VolumeFile::getFileHistogram()
 {
     if (m_fileHistogram == NULL) {
-        std::vector<float> fileData;
-        getFileData(fileData);
-        if ( ! fileData.empty()) {
+        MemoryBlockSource blockSource;
+        getFileDataBlocks(blockSource);
+        if (blockSource.getNumberOfValues() > 0) {
             m_fileHistogram.grabNew(new Histogram());
-            m_fileHistogram->update(&fileData[0],
-                                    fileData.size());
+            m_fileHistogram->update(blockSource);
         }
     }
     return m_fileHistogram;
@@ -1006,14 +1026,13 @@ VolumeFile::getFileHistogram(const float mostPositiveValueInclusive,
     }
     
     if (updateHistogramFlag) {
-        std::vector<float> fileData;
-        getFileData(fileData);
-        if ( ! fileData.empty()) {
+        MemoryBlockSource blockSource;
+        getFileDataBlocks(blockSource);
+        if (blockSource.getNumberOfValues() > 0) {
             if (m_fileHistorgramLimitedValues == NULL) {
                 m_fileHistorgramLimitedValues.grabNew(new Histogram());
             }
-            m_fileHistorgramLimitedValues->update(&fileData[0],
-                                                  fileData.size(),
+            m_fileHistorgramLimitedValues->update(blockSource,
                                                   mostPositiveValueInclusive,
                                                   leastPositiveValueInclusive,
                                                   leastNegativeValueInclusive,
@@ -1069,6 +1088,24 @@ VolumeFile::getFileData(std::vector<float>& dataOut) const
     CaretAssert(dataOffset == static_cast<int64_t>(dataOut.size()));
 }
 
+/**
+ * Get all data for a volume file as blocks that point into the
+ * volume's own memory, so that nothing is copied.
+ *
+ * @param blocksOut
+ *    Output with all data for the file.  Empty if no data in file.
+ */
+void
+VolumeFile::getFileDataBlocks(MemoryBlockSource& blocksOut) const
+{
+    int64_t dimI, dimJ, dimK, dimTime, dimComp;
+    getDimensions(dimI, dimJ, dimK, dimTime, dimComp);
+    const int64_t dataSize = dimI * dimJ * dimK * dimTime * dimComp;
+    if (dataSize > 0) {
+        blocksOut.addArray(getFrame(), dataSize);//all frames and components are contiguous, starting at the first frame
+    }
+}
+
 /**
  * @return Is the data in the file mapped to colors using
  * a palette.
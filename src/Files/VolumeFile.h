@@ -30,6 +30,7 @@
 #include "ChartableLineSeriesBrainordinateInterface.h"
 #include "StructureEnum.h"
 #include "GiftiMetaData.h"
+#include "NiftiOutputDataType.h"
 #include "BoundingBox.h"
 #include "PaletteFile.h"
 #include "VolumeFileVoxelColorizer.h"
@@ -38,6 +39,7 @@
 namespace caret {
     
     class GroupAndNameHierarchyModel;
+    class MemoryBlockSource;
     class VolumeFileEditorDelegate;
     class VolumeFileVoxelColorizer;
     class VolumeSpline;
@@ -58,6 +60,8 @@ namespace caret {
         
         void checkStatisticsValid();
         
+        void getFileDataBlocks(MemoryBlockSource& blocksOut) const;//for file statistics without copying the data
+        
         struct BrickAttributes//for storing ONLY stuff that doesn't get saved to the caret extension
         {//TODO: prune this once statistics gets straightened out
             CaretPointer<FastStatistics> m_fastStatistics;
@@ -117,6 +121,11 @@ namespace caret {
         
         CaretPointer<VolumeFileEditorDelegate> m_volumeFileEditorDelegate;
         
+        /** datatype for writeFile, only used when m_haveWritingDataType, otherwise NiftiOutputDataType::getDefault() */
+        NiftiOutputDataType m_writingDataType;
+        
+        bool m_haveWritingDataType;
+        
     protected:
         virtual void saveFileDataToScene(const SceneAttributes* sceneAttributes,
                                          SceneClass* sceneClass);
@@ -180,6 +189,9 @@ namespace caret {
         void readFile(const AString& filename);
 
         void writeFile(const AString& filename);
+        
+        ///set the datatype writeFile uses, instead of the process-wide default
+        void setWritingDataType(const NiftiOutputDataType& type);
 
         bool isEmpty() const { return VolumeBase::isEmpty(); }
         
@@ -27,6 +27,7 @@
 
 #include "CaretAssert.h"
 #include "CaretPointer.h"
+#include "CaretProfiler.h"
 #include "CaretUndoStack.h"
 #include "Matrix4x4.h"
 #include "VolumeFile.h"
@@ -490,9 +491,12 @@ VolumeFileEditorDelegate::performTurnOnOrOffOrthogonal(const EditInfo& editInfo,
     CaretPointer<VolumeMapUndoCommand> modifiedVoxels;
     modifiedVoxels.grabNew(new VolumeMapUndoCommand(m_volumeFile,
                                                  editInfo.m_mapIndex));
-    for (int64_t i = editInfo.m_ijkMin[0]; i <= editInfo.m_ijkMax[0]; i++) {
+    /*
+     * "i" varies fastest so the undo command stores runs
+     */
+    for (int64_t k = editInfo.m_ijkMin[2]; k <= editInfo.m_ijkMax[2]; k++) {
         for (int64_t j = editInfo.m_ijkMin[1]; j <= editInfo.m_ijkMax[1]; j++) {
-            for (int64_t k = editInfo.m_ijkMin[2]; k <= editInfo.m_ijkMax[2]; k++) {
+            for (int64_t i = editInfo.m_ijkMin[0]; i <= editInfo.m_ijkMax[0]; i++) {
                 const int64_t ijk[3] = { i, j, k };
                 modifiedVoxels->addVoxelRedoUndo(ijk,
                                                  redoVoxelValue,
@@ -1029,11 +1033,12 @@ VolumeFileEditorDelegate::performRetainConnected3D(const EditInfo& editInfo,
     }
     
     /*
-     * Turn off not connected voxels
+     * Turn off not connected voxels, "i" varies fastest so the
+     * undo command stores runs
      */
-    for (int64_t i = 0; i < m_volumeDimensions[0]; i++) {
+    for (int64_t k = 0; k < m_volumeDimensions[2]; k++) {
         for (int64_t j = 0; j < m_volumeDimensions[1]; j++) {
-            for (int64_t k = 0; k < m_volumeDimensions[2]; k++) {
+            for (int64_t i = 0; i < m_volumeDimensions[0]; i++) {
                 const int64_t flagsOffset = (i
                                              + (j * (m_volumeDimensions[0]))
                                              + (k * m_volumeDimensions[0] * m_volumeDimensions[1]));
@@ -1101,118 +1106,133 @@ VolumeFileEditorDelegate::performFloodFillAndRemoveConnected(const EditInfo& edi
                                                     editInfo.m_mapIndex));
     
     float newVoxelValue = editInfo.m_voxelValueOff;
+    float matchingVoxelValue = editInfo.m_voxelValueOn;
     if (fillingFlag) {
         newVoxelValue = editInfo.m_voxelValueOn;
+        matchingVoxelValue = editInfo.m_voxelValueOff;
     }
     
     /*
-     * Initialize to the staring voxel
+     * Determine the axes that are in the fill region
      */
-    std::stack<VoxelIJK> st;
-    st.push(VoxelIJK(editInfo.m_voxelIJK));
+    bool axisInRegion[3] = { false, false, false };
+    switch (editInfo.m_slicePlane) {
+        case VolumeSliceViewPlaneEnum::PARASAGITTAL:
+            axisInRegion[0] = threeDimensionalFlag;
+            axisInRegion[1] = true;
+            axisInRegion[2] = true;
+            break;
+        case VolumeSliceViewPlaneEnum::CORONAL:
+            axisInRegion[0] = true;
+            axisInRegion[1] = threeDimensionalFlag;
+            axisInRegion[2] = true;
+            break;
+        case VolumeSliceViewPlaneEnum::AXIAL:
+            axisInRegion[0] = true;
+            axisInRegion[1] = true;
+            axisInRegion[2] = threeDimensionalFlag;
+            break;
+        case VolumeSliceViewPlaneEnum::ALL:
+            break;
+    }
     
     /*
-     * While there are voxels to process
+     * Fill whole runs along the first axis in the region ("i" unless
+     * in a parasagittal slice) and seed the neighboring lines once per
+     * matching segment, instead of pushing every neighbor of every voxel.
+     * With ALL, only the selected voxel is modified.
+     */
+    int32_t scanAxis = -1;
+    for (int32_t axis = 2; axis >= 0; axis--) {
+        if (axisInRegion[axis]) {
+            scanAxis = axis;
+        }
+    }
+    
+    CaretProfileSpan mySpan("VolumeFileEditorDelegate flood fill", "edit");
+    
+    /*
+     * If the new value matches, nothing would change (and the fill would never end)
      */
+    std::stack<VoxelIJK> st;
+    if (newVoxelValue != matchingVoxelValue) {
+        st.push(VoxelIJK(editInfo.m_voxelIJK));
+    }
+    
     while (st.empty() == false) {
-        /*
-         * Get the next voxel to process
-         */
-        const VoxelIJK v = st.top();
+        const VoxelIJK seed = st.top();
         st.pop();
-        int64_t i = v.m_ijk[0];
-        int64_t j = v.m_ijk[1];
-        int64_t k = v.m_ijk[2];
+        
+        if ((seed.m_ijk[0] < 0) || (seed.m_ijk[0] >= m_volumeDimensions[0]) ||
+            (seed.m_ijk[1] < 0) || (seed.m_ijk[1] >= m_volumeDimensions[1]) ||
+            (seed.m_ijk[2] < 0) || (seed.m_ijk[2] >= m_volumeDimensions[2])) {
+            continue;
+        }
+        if (m_volumeFile->getValue(seed.m_ijk, editInfo.m_mapIndex) != matchingVoxelValue) {
+            continue;
+        }
+        
+        if (scanAxis < 0) {
+            modifiedVoxels->addVoxelRedoUndo(seed.m_ijk,
+                                             newVoxelValue,
+                                             matchingVoxelValue);
+            m_volumeFile->setValue(newVoxelValue,
+                                   seed.m_ijk,
+                                   editInfo.m_mapIndex);
+            continue;
+        }
         
         /*
-         * If the voxel has valid indices
+         * Extend the run in both directions along the scan axis
          */
-        if ((i >= 0) && (i < m_volumeDimensions[0]) &&
-            (j >= 0) && (j < m_volumeDimensions[1]) &&
-            (k >= 0) && (k < m_volumeDimensions[2])) {
-            const int64_t ijk[3] = { i, j, k };
-            float currentValue = m_volumeFile->getValue(ijk, editInfo.m_mapIndex);
-            
-            /*
-             * See if voxel has proper value for operation
-             */
-            bool matchingVoxel = false;
-            if (fillingFlag) {
-                matchingVoxel = (currentValue == editInfo.m_voxelValueOff);
+        int64_t ijk[3] = { seed.m_ijk[0], seed.m_ijk[1], seed.m_ijk[2] };
+        int64_t runStart = seed.m_ijk[scanAxis];
+        int64_t runEnd = seed.m_ijk[scanAxis];
+        for (ijk[scanAxis] = runStart - 1; ijk[scanAxis] >= 0; ijk[scanAxis]--) {
+            if (m_volumeFile->getValue(ijk, editInfo.m_mapIndex) != matchingVoxelValue) {
+                break;
             }
-            else {
-                matchingVoxel = (currentValue == editInfo.m_voxelValueOn);
+            runStart = ijk[scanAxis];
+        }
+        for (ijk[scanAxis] = runEnd + 1; ijk[scanAxis] < m_volumeDimensions[scanAxis]; ijk[scanAxis]++) {
+            if (m_volumeFile->getValue(ijk, editInfo.m_mapIndex) != matchingVoxelValue) {
+                break;
             }
-            
-            /*
-             * If the voxel should be modified
-             */
-            if (matchingVoxel) {
-                /*
-                 * Update the voxels value
-                 */
-                modifiedVoxels->addVoxelRedoUndo(ijk,
-                                                 newVoxelValue,
-                                                 m_volumeFile->getValue(ijk, editInfo.m_mapIndex));
-                m_volumeFile->setValue(newVoxelValue,
-                                       ijk,
-                                       editInfo.m_mapIndex);
-
-                /*
-                 * Determine neighboring voxels
-                 */
-                int64_t iDelta = 0;
-                int64_t jDelta = 0;
-                int64_t kDelta = 0;
-                switch (editInfo.m_slicePlane) {
-                    case VolumeSliceViewPlaneEnum::PARASAGITTAL:
-                        if (threeDimensionalFlag) {
-                            iDelta = 1;
-                        }
-                        else {
-                            iDelta = 0;
-                        }
-                        jDelta = 1;
-                        kDelta = 1;
-                        break;
-                    case VolumeSliceViewPlaneEnum::CORONAL:
-                        iDelta = 1;
-                        if (threeDimensionalFlag) {
-                            jDelta = 1;
-                        }
-                        else {
-                            jDelta = 0;
-                        }
-                        kDelta = 1;
-                        break;
-                    case VolumeSliceViewPlaneEnum::AXIAL:
-                        iDelta = 1;
-                        jDelta = 1;
-                        if (threeDimensionalFlag) {
-                            kDelta = 1;
-                        }
-                        else {
-                            kDelta = 0;
-                        }
-                        break;
-                    case VolumeSliceViewPlaneEnum::ALL:
-                        break;
-                }
-                
-                /*
-                 * Add neighboring voxels for search
-                 */
-                if (iDelta != 0) {
-                    st.push(VoxelIJK(i - iDelta, j, k));
-                    st.push(VoxelIJK(i + iDelta, j, k));
-                }
-                if (jDelta != 0) {
-                    st.push(VoxelIJK(i, j - jDelta, k));
-                    st.push(VoxelIJK(i, j + jDelta, k));
+            runEnd = ijk[scanAxis];
+        }
+        
+        /*
+         * Update the run
+         */
+        for (ijk[scanAxis] = runStart; ijk[scanAxis] <= runEnd; ijk[scanAxis]++) {
+            modifiedVoxels->addVoxelRedoUndo(ijk,
+                                             newVoxelValue,
+                                             matchingVoxelValue);
+            m_volumeFile->setValue(newVoxelValue,
+                                   ijk,
+                                   editInfo.m_mapIndex);
+        }
+        
+        /*
+         * Seed each matching segment of the adjacent lines
+         */
+        for (int32_t axis = 0; axis < 3; axis++) {
+            if ((axis == scanAxis) || ( ! axisInRegion[axis])) {
+                continue;
+            }
+            for (int64_t delta = -1; delta <= 1; delta += 2) {
+                int64_t neighborIJK[3] = { seed.m_ijk[0], seed.m_ijk[1], seed.m_ijk[2] };
+                neighborIJK[axis] += delta;
+                if ((neighborIJK[axis] < 0) || (neighborIJK[axis] >= m_volumeDimensions[axis])) {
+                    continue;
                 }
-                if (kDelta != 0) {
-                    st.push(VoxelIJK(i, j, k - kDelta));
-                    st.push(VoxelIJK(i, j, k + kDelta));
+                bool inSegment = false;
+                for (neighborIJK[scanAxis] = runStart; neighborIJK[scanAxis] <= runEnd; neighborIJK[scanAxis]++) {
+                    const bool matchingVoxel = (m_volumeFile->getValue(neighborIJK, editInfo.m_mapIndex) == matchingVoxelValue);
+                    if (matchingVoxel && ( ! inSegment)) {
+                        st.push(VoxelIJK(neighborIJK));
+                    }
+                    inSegment = matchingVoxel;
                 }
             }
         }
@@ -276,6 +276,9 @@ VolumeFileVoxelColorizer::getVoxelColorsForSliceInMap(const int32_t mapIndex,
     if (m_volumeFile->isMappedWithLabelTable()) {
         CaretAssert(labelTable);
     }
+    const NodeAndVoxelColoring::LabelSelectionLookup labelSelection(labelTable,
+                                                                    displayGroup,
+                                                                    tabIndex);
     
     int64_t validVoxelCount = 0;
     
@@ -304,14 +307,8 @@ VolumeFileVoxelColorizer::getVoxelColorsForSliceInMap(const int32_t mapIndex,
                                                                                               j,
                                                                                               k,
                                                                                               mapIndex));
-                        const GiftiLabel* label = labelTable->getLabel(dataValue);
-                        if (label != NULL) {
-                            const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                            if (item != NULL) {
-                                if (item->isSelected(displayGroup, tabIndex) == false) {
-                                    alpha = 0;
-                                }
-                            }
+                        if (labelSelection.isLabelKeyDeselected(dataValue)) {
+                            alpha = 0;
                         }
                     }
                 }
@@ -432,6 +429,9 @@ VolumeFileVoxelColorizer::getVoxelColorsForSubSliceInMap(const int32_t mapIndex,
     if (m_volumeFile->isMappedWithLabelTable()) {
         CaretAssert(labelTable);
     }
+    const NodeAndVoxelColoring::LabelSelectionLookup labelSelection(labelTable,
+                                                                    displayGroup,
+                                                                    tabIndex);
     
     int64_t validVoxelCount = 0;
     
@@ -467,17 +467,9 @@ VolumeFileVoxelColorizer::getVoxelColorsForSubSliceInMap(const int32_t mapIndex,
                     //prevent display of the data.
                     
                     const int32_t dataValue = static_cast<int32_t>(m_volumeFile->getValue(iterijk, mapIndex));
-                    const GiftiLabel* label = labelTable->getLabel(dataValue);
-                    if (label != NULL)
+                    if (labelSelection.isLabelKeyDeselected(dataValue))
                     {
-                        const GroupAndNameHierarchyItem* item = label->getGroupNameSelectionItem();
-                        if (item != NULL)
-                        {
-                            if (item->isSelected(displayGroup, tabIndex) == false)
-                            {
-                                alpha = 0;
-                            }
-                        }
+                        alpha = 0;
                     }
                 }
             }
@@ -24,6 +24,7 @@
 #undef __VOLUME_MAP_UNDO_COMMAND_DECLARE__
 
 #include "CaretAssert.h"
+#include "CaretProfiler.h"
 #include "VolumeFile.h"
 
 using namespace caret;
@@ -54,12 +55,6 @@ m_mapIndex(mapIndex)
  */
 VolumeMapUndoCommand::~VolumeMapUndoCommand()
 {
-    for (std::vector<VoxelMemento*>::iterator iter = m_voxelMementos.begin();
-         iter != m_voxelMementos.end();
-         iter++) {
-        delete *iter;
-    }
-    m_voxelMementos.clear();
 }
 
 /**
@@ -75,13 +70,19 @@ VolumeMapUndoCommand::redo(AString& errorMessageOut)
 {
     errorMessageOut.clear();
     
-    for (std::vector<VoxelMemento*>::iterator iter = m_voxelMementos.begin();
-         iter != m_voxelMementos.end();
+    CaretProfileSpan mySpan("VolumeMapUndoCommand::redo", "edit");
+    for (std::vector<VoxelRun>::const_iterator iter = m_voxelRuns.begin();
+         iter != m_voxelRuns.end();
          iter++) {
-        const VoxelMemento* voxelMod = *iter;
-        m_volumeFile->setValue(voxelMod->m_redoValue,
-                               voxelMod->m_ijk,
-                               m_mapIndex);
+        const VoxelRun& run = *iter;
+        const float* values = &m_redoValues[run.m_valuesOffset];
+        for (int64_t n = 0; n < run.m_count; n++) {
+            m_volumeFile->setValue(values[n],
+                                   run.m_ijk[0] + n,
+                                   run.m_ijk[1],
+                                   run.m_ijk[2],
+                                   m_mapIndex);
+        }
     }
     
     return true;
@@ -89,19 +90,29 @@ VolumeMapUndoCommand::redo(AString& errorMessageOut)
 
 /**
  * Operation that "undoes" the command.
+ *
+ * Voxels are restored in the reverse of the order they were
+ * added so that a voxel modified more than once gets its
+ * original value.
  */
 bool
 VolumeMapUndoCommand::undo(AString& errorMessageOut)
 {
     errorMessageOut.clear();
     
-    for (std::vector<VoxelMemento*>::iterator iter = m_voxelMementos.begin();
-         iter != m_voxelMementos.end();
+    CaretProfileSpan mySpan("VolumeMapUndoCommand::undo", "edit");
+    for (std::vector<VoxelRun>::const_reverse_iterator iter = m_voxelRuns.rbegin();
+         iter != m_voxelRuns.rend();
          iter++) {
-        const VoxelMemento* voxelMod = *iter;
-        m_volumeFile->setValue(voxelMod->m_undoValue,
-                               voxelMod->m_ijk,
-                               m_mapIndex);
+        const VoxelRun& run = *iter;
+        const float* values = &m_undoValues[run.m_valuesOffset];
+        for (int64_t n = run.m_count - 1; n >= 0; n--) {
+            m_volumeFile->setValue(values[n],
+                                   run.m_ijk[0] + n,
+                                   run.m_ijk[1],
+                                   run.m_ijk[2],
+                                   m_mapIndex);
+        }
     }
     
     return true;
@@ -113,13 +124,16 @@ VolumeMapUndoCommand::undo(AString& errorMessageOut)
 int32_t
 VolumeMapUndoCommand::count() const
 {
-    return m_voxelMementos.size();
+    return m_redoValues.size();
 }
 
 
 /**
  * Add the redo and undo values for a voxel.
  * 
+ * A voxel that follows the previously added voxel along the "i"
+ * axis extends its run, so no per-voxel object is allocated.
+ *
  * @param ijk
  *     The voxel's indices.
  * @param redoValue
@@ -132,9 +146,29 @@ VolumeMapUndoCommand::addVoxelRedoUndo(const int64_t ijk[3],
                                        const float redoValue,
                                        const float undoValue)
 {
-    m_voxelMementos.push_back(new VoxelMemento(ijk,
-                                               redoValue,
-                                               undoValue));
+    bool extendsLastRun = false;
+    if ( ! m_voxelRuns.empty()) {
+        const VoxelRun& lastRun = m_voxelRuns.back();
+        extendsLastRun = ((lastRun.m_ijk[0] + lastRun.m_count == ijk[0])
+                          && (lastRun.m_ijk[1] == ijk[1])
+                          && (lastRun.m_ijk[2] == ijk[2]));
+    }
+    
+    if (extendsLastRun) {
+        m_voxelRuns.back().m_count++;
+    }
+    else {
+        VoxelRun run;
+        run.m_ijk[0] = ijk[0];
+        run.m_ijk[1] = ijk[1];
+        run.m_ijk[2] = ijk[2];
+        run.m_count = 1;
+        run.m_valuesOffset = m_redoValues.size();
+        m_voxelRuns.push_back(run);
+    }
+    
+    m_redoValues.push_back(redoValue);
+    m_undoValues.push_back(undoValue);
 }
 
 /**
@@ -161,33 +195,3 @@ VolumeMapUndoCommand::addVoxelRedoUndo(const int64_t i,
     const int64_t ijk[3] = { i, j, k };
     addVoxelRedoUndo(ijk, redoValue, undoValue);
 }
-/* ------------------------------------------------------------------ */
-/**
- * Constructor.
- *
- * @param ijk
- *     The voxel's indices.
- * @param redoValue
- *     Value for redo operation.
- * @param undoValue
- *     Value for undo operation.
- */
-VolumeMapUndoCommand::VoxelMemento::VoxelMemento(const int64_t ijk[3],
-                                                 const float redoValue,
-                                                 const float undoValue)
-{
-    m_ijk[0] = ijk[0];
-    m_ijk[1] = ijk[1];
-    m_ijk[2] = ijk[2];
-    
-    m_redoValue = redoValue;
-    m_undoValue = undoValue;
-}
-
-VolumeMapUndoCommand::VoxelMemento::~VoxelMemento()
-{
-    
-}
-
-
-
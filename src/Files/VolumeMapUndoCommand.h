@@ -22,8 +22,9 @@
 /*LICENSE_END*/
 
 
-#include "CaretUndoCommand.h"
+#include <vector>
 
+#include "CaretUndoCommand.h"
 
 
 namespace caret {
@@ -57,19 +58,17 @@ namespace caret {
         // ADD_NEW_METHODS_HERE
 
     private:
-        class VoxelMemento {
+        /**
+         * Voxels that were added consecutively along the "i" axis, their
+         * values start at m_valuesOffset in the redo and undo value arrays.
+         */
+        class VoxelRun {
         public:
-            VoxelMemento(const int64_t ijk[3],
-                         const float redoValue,
-                         const float undoValue);
-            
-            ~VoxelMemento();
-            
             int64_t m_ijk[3];
             
-            float m_redoValue;
+            int64_t m_count;
             
-            float m_undoValue;
+            int64_t m_valuesOffset;
         };
         
         VolumeMapUndoCommand(const VolumeMapUndoCommand&);
@@ -80,7 +79,11 @@ namespace caret {
         
         const int32_t m_mapIndex;
         
-        std::vector<VoxelMemento*> m_voxelMementos;
+        std::vector<VoxelRun> m_voxelRuns;
+        
+        std::vector<float> m_redoValues;
+        
+        std::vector<float> m_undoValues;
         
         // ADD_NEW_MEMBERS_HERE
 
@@ -129,6 +129,7 @@ GiftiLabelTable::clear()
         delete iter->second;
     }
     this->labelsMap.clear();
+    invalidateLookup();
     
     GiftiLabel gl(0, "???", 1.0, 1.0, 1.0, 0.0);
     this->addLabel(&gl);
@@ -293,6 +294,7 @@ GiftiLabelTable::addLabel(const GiftiLabel* glIn)
         GiftiLabel* gl = new GiftiLabel(*glIn);
         gl->setKey(key);
         this->labelsMap.insert(std::make_pair(key, gl));
+        invalidateLookup();
         return key;
     }
     
@@ -321,6 +323,7 @@ GiftiLabelTable::addLabel(const GiftiLabel* glIn)
          * Insert a new label
          */
         this->labelsMap.insert(std::make_pair(key, new GiftiLabel(*glIn)));
+        invalidateLookup();
     }
     return key;
 }
@@ -427,6 +430,7 @@ GiftiLabelTable::deleteLabel(const int32_t key)
         GiftiLabel* gl = iter->second;
         this->labelsMap.erase(iter);
         delete gl;
+        invalidateLookup();
         
         setModified();
     }
@@ -452,6 +456,7 @@ GiftiLabelTable::deleteLabel(const GiftiLabel* label)
          iter++) {
         if (iter->second == label) {
             this->labelsMap.erase(iter);
+            invalidateLookup();
             setModified();
             break;
         }
@@ -485,6 +490,7 @@ GiftiLabelTable::deleteUnusedLabels(const std::set<int32_t>& usedLabelKeys)
     }
     
     this->labelsMap = newMap;
+    invalidateLookup();
     this->setModified();
 }
 
@@ -520,6 +526,7 @@ GiftiLabelTable::insertLabel(const GiftiLabel* labelIn)
     }
         
     this->labelsMap.insert(std::make_pair(label->getKey(), label));
+    invalidateLookup();
     this->setModified();
 }
 
@@ -1076,6 +1083,7 @@ GiftiLabelTable::removeLabelsWithZeroCounts()
     }
     
     if (isLabelRemoved) {
+        invalidateLookup();
         this->setModified();
     }
 }
@@ -1610,6 +1618,36 @@ GiftiLabelTable::getKeysAndNames(std::map<int32_t, AString>& keysAndNamesOut) co
     }
 }
 
+/**
+ * Get a flat key lookup for coloring many keys, built on first use
+ * after labels were added, removed, or rekeyed.  Label colors and
+ * selection are not cached, so they are read from the labels.
+ *
+ * @return
+ *     The lookup.  It points to the labels of this table, so get it
+ *     again after modifying the table, as labels that were removed or
+ *     replaced have been deleted.
+ */
+CaretPointer<const GiftiLabelTableLookup>
+GiftiLabelTable::getLookup() const
+{
+    CaretMutexLocker locked(&m_lookupMutex);
+    if (m_lookup == NULL) {
+        m_lookup.grabNew(new GiftiLabelTableLookup(this->labelsMap));
+    }
+    return m_lookup;
+}
+
+/**
+ * Discard the key lookup after the set of labels or their keys change.
+ */
+void
+GiftiLabelTable::invalidateLookup()
+{
+    CaretMutexLocker locked(&m_lookupMutex);
+    m_lookup.grabNew(NULL);
+}
+
 /**
  * Change the key of a label from 'currentKey' to 'newKey'.
  * If a label exists with 'newKey', the label with 'newKey' is removed.
@@ -1649,6 +1687,7 @@ GiftiLabelTable::changeLabelKey(const int32_t currentKey,
     label->setKey(newKey);
     this->labelsMap.insert(std::make_pair(newKey,
                                           label));
+    invalidateLookup();
 }
 
 
@@ -22,7 +22,10 @@
 /*LICENSE_END*/
 
 #include "AString.h"
+#include "CaretMutex.h"
 #include "CaretObject.h"
+#include "CaretPointer.h"
+#include "GiftiLabelTableLookup.h"
 #include "TracksModificationInterface.h"
 
 #include "GiftiException.h"
@@ -202,6 +205,8 @@ public:
 
     void getKeysAndNames(std::map<int32_t, AString>& keysAndNamesOut) const;
     
+    CaretPointer<const GiftiLabelTableLookup> getLookup() const;
+    
 //    bool hasLabelsWithInvalidGroupNameHierarchy() const;
     
     int32_t generateUnusedKey() const;
@@ -214,6 +219,8 @@ public:
 private:
     void issueLabelKeyZeroWarning(const AString& name) const;
     
+    void invalidateLookup();
+    
     /** The label table storage.  Use a TreeMap since label keys
  may be sparse.
 */
@@ -225,6 +232,11 @@ private:
 
     /**tracks modification status */
     bool modifiedFlag;
+    
+    /** Flat key lookup for coloring, rebuilt on first use after labels are added, removed, or rekeyed */
+    mutable CaretPointer<const GiftiLabelTableLookup> m_lookup;
+    
+    mutable CaretMutex m_lookupMutex;
 
     int32_t m_tableModelColumnIndexKey;
     int32_t m_tableModelColumnIndexName;
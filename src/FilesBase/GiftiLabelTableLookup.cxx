@@ -0,0 +1,85 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GiftiLabelTableLookup.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t MIN_DENSE_RANGE = 1 << 16;//label keys are usually small, a dense table this size is only 256KB
+    const int64_t DENSE_RANGE_PER_LABEL = 8;
+}
+
+GiftiLabelTableLookup::GiftiLabelTableLookup(const map<int32_t, GiftiLabel*>& labelsMap)
+{
+    m_minimumKey = 0;
+    m_hashShift = 32;
+    if (labelsMap.empty()) return;
+    m_labels.reserve(labelsMap.size());
+    for (map<int32_t, GiftiLabel*>::const_iterator iter = labelsMap.begin(); iter != labelsMap.end(); ++iter)
+    {
+        m_labels.push_back(iter->second);
+    }
+    m_minimumKey = labelsMap.begin()->first;
+    const int64_t keyRange = (int64_t)labelsMap.rbegin()->first - m_minimumKey + 1;
+    if (keyRange <= max(MIN_DENSE_RANGE, DENSE_RANGE_PER_LABEL * (int64_t)labelsMap.size()))
+    {
+        m_denseIndices.resize(keyRange, -1);
+        int32_t index = 0;
+        for (map<int32_t, GiftiLabel*>::const_iterator iter = labelsMap.begin(); iter != labelsMap.end(); ++iter, ++index)
+        {
+            m_denseIndices[iter->first - m_minimumKey] = index;
+        }
+        return;
+    }
+    int32_t bits = 1;//at most half full
+    while (((int64_t)1 << bits) < 2 * (int64_t)labelsMap.size()) ++bits;
+    m_hashShift = 32 - bits;
+    m_hashKeys.resize((size_t)1 << bits, 0);
+    m_hashIndices.resize((size_t)1 << bits, -1);
+    const uint32_t mask = ((uint32_t)1 << bits) - 1;
+    int32_t index = 0;
+    for (map<int32_t, GiftiLabel*>::const_iterator iter = labelsMap.begin(); iter != labelsMap.end(); ++iter, ++index)
+    {
+        uint32_t slot = hashSlot(iter->first, m_hashShift);
+        while (m_hashIndices[slot] != -1) slot = (slot + 1) & mask;
+        m_hashKeys[slot] = iter->first;
+        m_hashIndices[slot] = index;
+    }
+}
+
+int32_t GiftiLabelTableLookup::findHashed(const int64_t key) const
+{
+    if (m_hashIndices.empty() || key < numeric_limits<int32_t>::min() || key > numeric_limits<int32_t>::max()) return -1;
+    const uint32_t mask = (uint32_t)m_hashIndices.size() - 1;
+    uint32_t slot = hashSlot((int32_t)key, m_hashShift);
+    while (true)
+    {
+        const int32_t index = m_hashIndices[slot];
+        if (index == -1) return -1;
+        if (m_hashKeys[slot] == key) return index;
+        slot = (slot + 1) & mask;
+    }
+}
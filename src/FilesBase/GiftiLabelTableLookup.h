@@ -0,0 +1,72 @@
+#ifndef __GIFTI_LABEL_TABLE_LOOKUP_H__
+#define __GIFTI_LABEL_TABLE_LOOKUP_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+namespace caret {
+
+    class GiftiLabel;
+    
+    ///flat key to label lookup for coloring, dense over the key range when that is compact, otherwise an open addressing hash
+    class GiftiLabelTableLookup
+    {
+        std::vector<const GiftiLabel*> m_labels;
+        int64_t m_minimumKey;
+        std::vector<int32_t> m_denseIndices;//label index for each key from m_minimumKey, -1 for unused keys
+        std::vector<int32_t> m_hashKeys;
+        std::vector<int32_t> m_hashIndices;//-1 for empty slots
+        int32_t m_hashShift;
+        
+        static uint32_t hashSlot(const int32_t key, const int32_t shift) { return (uint32_t(key) * 2654435761u) >> shift; }
+        
+        int32_t findHashed(const int64_t key) const;
+        
+        GiftiLabelTableLookup(const GiftiLabelTableLookup&);
+        GiftiLabelTableLookup& operator=(const GiftiLabelTableLookup&);
+    public:
+        explicit GiftiLabelTableLookup(const std::map<int32_t, GiftiLabel*>& labelsMap);
+        
+        ///number of labels, label indices are 0 to this minus one, in key order
+        int32_t getNumberOfLabels() const { return (int32_t)m_labels.size(); }
+        
+        const GiftiLabel* getLabelAtIndex(const int32_t index) const { return m_labels[index]; }
+        
+        ///returns index of the label with the key, or -1
+        int32_t findIndex(const int64_t key) const
+        {
+            if (!m_denseIndices.empty())
+            {
+                const int64_t offset = key - m_minimumKey;
+                if (offset < 0 || offset >= (int64_t)m_denseIndices.size()) return -1;
+                return m_denseIndices[offset];
+            }
+            return findHashed(key);
+        }
+    };
+
+}
+
+#endif //__GIFTI_LABEL_TABLE_LOOKUP_H__
@@ -29,10 +29,12 @@
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretMappedFile.h"
 #include "DataCompressZLib.h"
 
 //#include "FileUtilities.h"
 #include "FastStatistics.h"
+#include "FileInformation.h"
 #include "GiftiDataArray.h"
 #include "GiftiFile.h"
 #include "GiftiMetaDataXmlElements.h"
@@ -58,6 +60,8 @@ GiftiDataArray::GiftiDataArray(const NiftiIntentEnum::Enum intentIn,
    dataPointerFloat = NULL;
    dataPointerInt = NULL;
    dataPointerUByte = NULL;    
+   mappedData = NULL;
+   mappedDataSize = 0;
    this->paletteColorMapping = NULL;
   this->descriptiveStatistics = NULL;
     this->descriptiveStatisticsLimitedValues = NULL;
@@ -86,6 +90,8 @@ GiftiDataArray::GiftiDataArray(const NiftiIntentEnum::Enum intentIn)
    dataPointerFloat = NULL;
    dataPointerInt = NULL;
    dataPointerUByte = NULL;
+   mappedData = NULL;
+   mappedDataSize = 0;
    this->paletteColorMapping = NULL;
    this->descriptiveStatistics = NULL;
     this->descriptiveStatisticsLimitedValues = NULL;
@@ -125,6 +131,8 @@ GiftiDataArray::GiftiDataArray(const GiftiDataArray& nda)
    dataPointerFloat = NULL;
    dataPointerInt = NULL;
    dataPointerUByte = NULL;
+   mappedData = NULL;
+   mappedDataSize = 0;
    this->paletteColorMapping = NULL;
    this->descriptiveStatistics = NULL;
     this->descriptiveStatisticsLimitedValues = NULL;
@@ -169,8 +177,16 @@ GiftiDataArray::copyHelperGiftiDataArray(const GiftiDataArray& nda)
    dataTypeSize = nda.dataTypeSize;
    endian = nda.endian;
    dimensions = nda.dimensions;
+   mappedFile.grabNew(NULL);//copies always own their data, so modifying one never shows through the other
+   mappedData = NULL;
+   mappedDataSize = 0;
+   if (nda.mappedData != NULL) {
+      data.assign(nda.mappedData, nda.mappedData + nda.mappedDataSize);
+   }
+   else {
+      data = nda.data;
+   }
    allocateData();
-   data = nda.data;
    metaData = nda.metaData;
    nonWrittenMetaData = nda.nonWrittenMetaData;
    externalFileName = nda.externalFileName;
@@ -270,6 +286,8 @@ GiftiDataArray::deleteRows(const std::vector<int32_t>& rowsToDeleteIn)
    std::unique(rowsToDelete.begin(), rowsToDelete.end());
    std::reverse(rowsToDelete.begin(), rowsToDelete.end());
    
+   copyMappedDataToMemory();
+   
    //
    // size of row in bytes
    //
@@ -346,10 +364,20 @@ GiftiDataArray::allocateData()
    
    dataSizeInBytes *= dataTypeSize;
    
+   //
+   // Mapped data stays mapped unless the size changes
+   //
+   if ((mappedData != NULL) && (dataSizeInBytes != mappedDataSize)) {
+      copyMappedDataToMemory();
+   }
+   
    //
    // Does data need to be allocated
    //
-   if (dataSizeInBytes > 0) {
+   if (mappedData != NULL) {
+      data.clear();
+   }
+   else if (dataSizeInBytes > 0) {
        //
        //  Allocate the needed memory
        //
@@ -376,16 +404,20 @@ GiftiDataArray::updateDataPointers()
    dataPointerFloat = NULL;
    dataPointerInt = NULL;
    dataPointerUByte = NULL;
-   if (data.empty() == false) {
+   uint8_t* dataBytes = mappedData;
+   if ((dataBytes == NULL) && (data.empty() == false)) {
+      dataBytes = &data[0];
+   }
+   if (dataBytes != NULL) {
       switch (dataType) {
          case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
-            dataPointerFloat = (float*)&data[0];
+            dataPointerFloat = (float*)dataBytes;
             break;
          case NiftiDataTypeEnum::NIFTI_TYPE_INT32:
-            dataPointerInt   = (int32_t*)&data[0];
+            dataPointerInt   = (int32_t*)dataBytes;
             break;
          case NiftiDataTypeEnum::NIFTI_TYPE_UINT8:
-            dataPointerUByte = (uint8_t*)&data[0];
+            dataPointerUByte = (uint8_t*)dataBytes;
             break;
           default:
               CaretAssertMessage(0, "Unsupported GIFTI Data Type");
@@ -394,12 +426,122 @@ GiftiDataArray::updateDataPointers()
    }
 }
       
+/**
+ * get a pointer to the data bytes, in the mapping or in memory.
+ */
+const uint8_t*
+GiftiDataArray::getDataBytes() const
+{
+   if (mappedData != NULL) {
+      return mappedData;
+   }
+   if (data.empty()) {
+      return NULL;
+   }
+   return &data[0];
+}
+
+/**
+ * is the data mapped from the given file.
+ */
+bool
+GiftiDataArray::isDataMappedFromFile(const AString& fileName) const
+{
+   if (mappedData == NULL) {
+      return false;
+   }
+   return (FileInformation(mappedFile->getFileName()).getAbsoluteFilePath()
+           == FileInformation(fileName).getAbsoluteFilePath());
+}
+
+/**
+ * copy mapped data into memory owned by this array, needed before any
+ * operation that changes the size or layout of the data.  Plain value
+ * changes through the data pointers do not need this, modified pages of
+ * the mapping are private copies that are never written to the file.
+ */
+void
+GiftiDataArray::copyMappedDataToMemory()
+{
+   if (mappedData == NULL) {
+      return;
+   }
+   data.assign(mappedData, mappedData + mappedDataSize);
+   mappedData = NULL;
+   mappedDataSize = 0;
+   mappedFile.grabNew(NULL);
+   updateDataPointers();
+}
+
+/**
+ * use the data directly from a mapping of the external binary file, only
+ * done when the bytes can be used as is (no byte swapping, data type
+ * conversion, or transposing).
+ * @return true if the data was mapped, otherwise it must be read.
+ */
+bool
+GiftiDataArray::mapExternalData(const CaretPointer<CaretMappedFile>& externalFileMapping,
+                                const NiftiDataTypeEnum::Enum requiredDataType,
+                                const std::vector<int64_t>& dimensionsForReading,
+                                const int64_t externalFileOffsetForReading)
+{
+   if ((externalFileMapping == NULL) || (externalFileMapping->isOpen() == false)
+       || dimensionsForReading.empty()) {
+      return false;
+   }
+   if ((dataType != requiredDataType) && (intent != NiftiIntentEnum::NIFTI_INTENT_POINTSET)) {
+      return false;
+   }
+   if (endian != getSystemEndian()) {
+      return false;
+   }
+   if (arraySubscriptingOrder == GiftiArrayIndexingOrderEnum::COLUMN_MAJOR_ORDER) {
+      if ((dimensionsForReading.size() > 2)
+          || ((dimensionsForReading.size() == 2) && (dimensionsForReading[0] != 1) && (dimensionsForReading[1] != 1))) {
+         return false;
+      }
+   }
+   int64_t elementSize = 0;
+   switch (dataType) {
+      case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
+         elementSize = sizeof(float);
+         break;
+      case NiftiDataTypeEnum::NIFTI_TYPE_INT32:
+         elementSize = sizeof(int32_t);
+         break;
+      case NiftiDataTypeEnum::NIFTI_TYPE_UINT8:
+         elementSize = sizeof(uint8_t);
+         break;
+      default:
+         return false;
+   }
+   int64_t numBytes = elementSize;
+   for (uint32_t i = 0; i < dimensionsForReading.size(); i++) {
+      numBytes *= dimensionsForReading[i];
+   }
+   //the mapping starts on a page boundary, so this keeps the element pointers aligned
+   if ((numBytes <= 0) || (externalFileOffsetForReading < 0)
+       || ((externalFileOffsetForReading % elementSize) != 0)
+       || (externalFileOffsetForReading + numBytes > externalFileMapping->getSize())) {
+      return false;
+   }
+   mappedFile = externalFileMapping;
+   mappedData = externalFileMapping->getData() + externalFileOffsetForReading;
+   mappedDataSize = numBytes;
+   data.clear();
+   setDimensions(dimensionsForReading);//same size, so allocateData() keeps the mapping
+   return true;
+}
+
 /**
  * reset column.
  */
 void 
 GiftiDataArray::clear()
 {
+   mappedFile.grabNew(NULL);//drop the mapping without copying it
+   mappedData = NULL;
+   mappedDataSize = 0;
    arraySubscriptingOrder = GiftiArrayIndexingOrderEnum::ROW_MAJOR_ORDER;
    encoding = GiftiEncodingEnum::ASCII;
    dataType = NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32;
@@ -587,14 +729,25 @@ GiftiDataArray::readFromText(const AString text,
                              const GiftiEncodingEnum::Enum encodingForReading,
                              const AString& externalFileNameForReading,
                              const int64_t externalFileOffsetForReading,
-                             const bool isReadOnlyMetaData)
+                             const bool isReadOnlyMetaData,
+                             const CaretPointer<CaretMappedFile>& externalFileMapping)
 {
    const NiftiDataTypeEnum::Enum requiredDataType = dataType;
    dataType = dataTypeForReading;
    encoding = encodingForReading;
    endian   = dataEndianForReading;
    arraySubscriptingOrder = arraySubscriptingOrderForReading;
-   setDimensions(dimensionsForReading);
+   bool dataIsMapped = false;
+   if ((isReadOnlyMetaData == false)
+       && (encoding == GiftiEncodingEnum::EXTERNAL_FILE_BINARY)) {
+      dataIsMapped = mapExternalData(externalFileMapping,
+                                     requiredDataType,
+                                     dimensionsForReading,
+                                     externalFileOffsetForReading);
+   }
+   if (dataIsMapped == false) {
+      setDimensions(dimensionsForReading);
+   }
    if (dimensionsForReading.size() == 0) {
       throw GiftiException("Data array has no dimensions.");
    }
@@ -727,6 +880,9 @@ GiftiDataArray::readFromText(const AString text,
             break;
           case GiftiEncodingEnum::EXTERNAL_FILE_BINARY:
             {
+               if (dataIsMapped) {
+                  break;
+               }
                if (externalFileNameForReading.length() <= 0) {
                   throw GiftiException("External file name is empty.");
                }
@@ -846,6 +1002,7 @@ GiftiDataArray::convertArrayIndexingOrder()
             // Is matrix square?
             //
             if (dimI == dimJ) {
+                copyMappedDataToMemory();
                 switch (dataType) {
                 case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
                 {
@@ -894,6 +1051,7 @@ GiftiDataArray::convertArrayIndexingOrder()
                 //
                 // Copy the data
                 //
+                copyMappedDataToMemory();
                 std::vector<uint8_t> dataCopy = data;
 
                 switch (arraySubscriptingOrder)
@@ -1173,11 +1331,11 @@ GiftiDataArray::writeAsXML(std::ostream& stream,
             //
             // Encode the data with VTK's Base64 algorithm
             //
-            const uint64_t bufferLength = static_cast<uint64_t>(data.size() * 1.5);
+            const uint64_t bufferLength = static_cast<uint64_t>(getDataSizeInBytes() * 1.5);
             char* buffer = new char[bufferLength];
             const uint64_t compressedLength =
-               Base64::encode(&data[0],
-                                          data.size(),
+               Base64::encode(getDataBytes(),
+                                          getDataSizeInBytes(),
                                           (unsigned char*)buffer);
             if (compressedLength >= bufferLength) {
                throw GiftiException(
@@ -1206,11 +1364,11 @@ GiftiDataArray::writeAsXML(std::ostream& stream,
             //
              DataCompressZLib compressor;
              unsigned long compressedDataBufferLength = 
-                              compressor.getMaximumCompressionSpace(data.size());
+                              compressor.getMaximumCompressionSpace(getDataSizeInBytes());
             unsigned char* compressedDataBuffer = new unsigned char[compressedDataBufferLength];
             unsigned long compressedDataLength =
-                          compressor.compressData(&data[0], 
-                                               data.size(),
+                          compressor.compressData(getDataBytes(), 
+                                               getDataSizeInBytes(),
                                                compressedDataBuffer,
                                                compressedDataBufferLength);
             
@@ -1239,8 +1397,8 @@ GiftiDataArray::writeAsXML(std::ostream& stream,
          break;
        case GiftiEncodingEnum::EXTERNAL_FILE_BINARY:
          {
-            const int64_t dataLength = data.size();
-            externalBinaryOutputStream->write((const char*)&data[0], dataLength);
+            const int64_t dataLength = getDataSizeInBytes();
+            externalBinaryOutputStream->write((const char*)getDataBytes(), dataLength);
             if (externalBinaryOutputStream->bad()) {
                throw GiftiException("Output stream for external file reports its status as bad.");
             }
@@ -1266,6 +1424,13 @@ void
 GiftiDataArray::convertToDataType(const NiftiDataTypeEnum::Enum newDataType)
 {
    if (newDataType != dataType) {      
+      //
+      // allocateData() keeps a mapping when the byte size doesn't
+      // change (FLOAT32 and INT32), so the values must be in memory
+      // before the type changes
+      //
+      copyMappedDataToMemory();
+      
       //
       // make a copy of myself
       //
@@ -1358,6 +1523,7 @@ void
 GiftiDataArray::byteSwapData(const GiftiEndianEnum::Enum newEndian)
 {
    endian = newEndian;
+   copyMappedDataToMemory();
    switch (dataType) {
       case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
          ByteSwapping::swapBytes(dataPointerFloat, getTotalNumberOfElements());
@@ -1482,8 +1648,9 @@ GiftiDataArray::getMinMaxValuesFloat(float& minValue,
 void 
 GiftiDataArray::zeroize()
 {
-   if (data.empty() == false) {
-      std::fill(data.begin(), data.end(), 0);
+   uint8_t* dataBytes = (uint8_t*)getDataBytes();
+   if (dataBytes != NULL) {
+      std::fill(dataBytes, dataBytes + getDataSizeInBytes(), 0);
    }
    metaData.clear();
    nonWrittenMetaData.clear();
@@ -29,6 +29,7 @@
 
 #include <stdint.h>
 
+#include "CaretMappedFile.h"
 #include "CaretObject.h"
 #include "CaretPointer.h"
 #include "DescriptiveStatistics.h"
@@ -95,7 +96,7 @@ namespace caret {
         std::vector<int64_t> getDimensions() const { return dimensions; }
         
         /// current size of the data (in bytes)
-        int64_t getDataSizeInBytes() const { return data.size(); }
+        int64_t getDataSizeInBytes() const { return (mappedData != NULL) ? mappedDataSize : (int64_t)data.size(); }
         
         /// get a dimension
         int32_t getDimension(const int32_t dimIndex) const { return dimensions[dimIndex]; }
@@ -121,7 +122,8 @@ namespace caret {
                           const GiftiEncodingEnum::Enum encodingForReading,
                           const AString& externalFileNameForReading,
                           const int64_t externalFileOffsetForReading,
-                          const bool isReadOnlyMetaData);
+                          const bool isReadOnlyMetaData,
+                          const CaretPointer<CaretMappedFile>& externalFileMapping = CaretPointer<CaretMappedFile>());
         
         // write the data as XML
         void writeAsXML(std::ostream& stream, 
@@ -228,6 +230,15 @@ namespace caret {
         // set all elements of array to zero
         void zeroize();
         
+        /// true if the data points into a mapping of an external binary file
+        bool isDataMapped() const { return mappedData != NULL; }
+        
+        // is the data mapped from the given file
+        bool isDataMappedFromFile(const AString& fileName) const;
+        
+        // copy mapped data into memory owned by this array
+        void copyMappedDataToMemory();
+        
         // get minimum and maximum values (valid for int data only)
         void getMinMaxValues(int& minValue, int& maxValue) const;
         
@@ -323,9 +334,27 @@ namespace caret {
         /// convert array indexing order of data
         void convertArrayIndexingOrder();
         
+        // get a pointer to the data bytes, wherever they are
+        const uint8_t* getDataBytes() const;
+        
+        // map external binary data instead of reading it
+        bool mapExternalData(const CaretPointer<CaretMappedFile>& externalFileMapping,
+                             const NiftiDataTypeEnum::Enum requiredDataType,
+                             const std::vector<int64_t>& dimensionsForReading,
+                             const int64_t externalFileOffsetForReading);
+        
         /// the data
         std::vector<uint8_t> data;
         
+        /// mapping holding the data when it was mapped from an external binary file (shared by arrays in that file)
+        CaretPointer<CaretMappedFile> mappedFile;
+        
+        /// start of this array's data in the mapping, NULL when data is in memory
+        uint8_t* mappedData;
+        
+        /// size of this array's data in the mapping
+        int64_t mappedDataSize;
+        
         /// size of one data type element
         uint32_t dataTypeSize;
         
@@ -908,6 +908,17 @@ GiftiFile::writeFile(const AString& filename)
         GiftiFileWriter giftiFileWriter(filename,
                             this->encodingForWriting);
         
+        //
+        // The writer removes any old external binary file, so arrays
+        // mapped from it need their own copy of the data first
+        //
+        const AString externalFileName = giftiFileWriter.getExternalFileNameForWriting();
+        for (int i = 0; i < this->getNumberOfDataArrays(); i++) {
+            if (this->getDataArray(i)->isDataMappedFromFile(externalFileName)) {
+                this->getDataArray(i)->copyMappedDataToMemory();
+            }
+        }
+        
         //
         // Start writing the file
         //
@@ -1236,6 +1247,18 @@ GiftiFile::setEncodingForWriting(const GiftiEncodingEnum::Enum encoding)
     this->encodingForWriting = encoding;
 }
 
+/**
+ * Set the encoding used for writing files that are created
+ * after this call (existing files keep their encoding).
+ * @param encoding
+ *    New default encoding.
+ */
+void
+GiftiFile::setDefaultEncodingForWriting(const GiftiEncodingEnum::Enum encoding)
+{
+    GiftiFile::defaultEncodingForWriting = encoding;
+}
+
 
     
 /**
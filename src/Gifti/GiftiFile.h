@@ -191,6 +191,9 @@ class GiftiFile : public DataFile {
     
     void setEncodingForWriting(const GiftiEncodingEnum::Enum encoding);
     
+    // set the encoding used for writing files created after this call
+    static void setDefaultEncodingForWriting(const GiftiEncodingEnum::Enum encoding);
+    
     virtual void clearModified();
     
     virtual bool isModified() const;
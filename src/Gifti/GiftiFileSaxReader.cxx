@@ -515,6 +515,27 @@ GiftiFileSaxReader::processArrayData()
     this->dataArrayDataHasBeenRead = true;
 
     CaretAssert(dataArray);
+    
+    /*
+     * Map external binary files rather than reading them, arrays that
+     * can't use the bytes as they are in the file fall back to reading.
+     */
+    CaretPointer<CaretMappedFile> externalFileMapping;
+    if ((encodingForReadingArrayData == GiftiEncodingEnum::EXTERNAL_FILE_BINARY)
+        && (this->giftiFile->getReadMetaDataOnlyFlag() == false)) {
+        std::map<AString, CaretPointer<CaretMappedFile> >::iterator iter = externalFileMappings.find(externalFileNameForReadingData);
+        if (iter != externalFileMappings.end()) {
+            externalFileMapping = iter->second;
+        }
+        else {
+            externalFileMapping.grabNew(new CaretMappedFile());
+            if (externalFileMapping->open(externalFileNameForReadingData) == false) {
+                externalFileMapping.grabNew(NULL);
+            }
+            externalFileMappings[externalFileNameForReadingData] = externalFileMapping;
+        }
+    }
+    
     try {
         dataArray->readFromText(elementText,
                                 this->endianForReadingArrayData,
@@ -524,7 +545,8 @@ GiftiFileSaxReader::processArrayData()
                                 encodingForReadingArrayData,
                                 externalFileNameForReadingData,
                                 externalFileOffsetForReadingData,
-                                this->giftiFile->getReadMetaDataOnlyFlag());
+                                this->giftiFile->getReadMetaDataOnlyFlag(),
+                                externalFileMapping);
     }
     catch (const GiftiException& e) {
         throw XmlSaxParserException(e.whatString());
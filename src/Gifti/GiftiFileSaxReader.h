@@ -22,10 +22,12 @@
  */
 /*LICENSE_END*/
 
+#include <map>
 #include <stack>
 #include <AString.h>
 #include <stdint.h>
 
+#include "CaretMappedFile.h"
 #include "CaretPointer.h"
 #include "GiftiArrayIndexingOrderEnum.h"
 #include "GiftiEndianEnum.h"
@@ -160,6 +162,9 @@ namespace caret {
         /// external file offset
         int64_t externalFileOffsetForReadingData;
         
+        /// one mapping per external binary file, shared by all arrays stored in it
+        std::map<AString, CaretPointer<CaretMappedFile> > externalFileMappings;
+        
         /// tracks if data has been read since external binary may not have DATA tag
         bool dataArrayDataHasBeenRead;
     };
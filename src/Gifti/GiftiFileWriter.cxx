@@ -19,6 +19,7 @@
  */
 /*LICENSE_END*/
 
+#include <cstdio>
 #include <fstream>
 #include <memory>
 
@@ -32,6 +33,8 @@
 
 #include "XmlWriter.h"
 
+#include <QFile>
+
 using namespace caret;
 
 
@@ -72,6 +75,13 @@ GiftiFileWriter::~GiftiFileWriter()
 {
     this->closeFiles();
     
+    //
+    // Only left behind if writing failed
+    //
+    if (QFile::exists(this->getExternalTempFileName())) {
+        QFile::remove(this->getExternalTempFileName());
+    }
+    
     if (this->xmlWriter != NULL) {
         delete this->xmlWriter;
         this->xmlWriter = NULL;
@@ -201,16 +211,29 @@ GiftiFileWriter::writeDataArray(GiftiDataArray* gda)
         //
         if (this->encoding == GiftiEncodingEnum::EXTERNAL_FILE_BINARY) {
             if (this->externalFileOutputStream == NULL) {
-                char* name = this->getExternalFileNameForWriting().toCharArray();
+                //
+                // Write to a temporary file that replaces the external
+                // file in finish(), so that the old file is never
+                // truncated while it may still be memory mapped
+                //
+                char* name = this->getExternalTempFileName().toCharArray();
                 this->externalFileOutputStream = new std::ofstream(name,std::fstream::binary);
                 delete[] name;
                 if (! *this->externalFileOutputStream) {
                     this->closeFiles();
-                    const AString msg = ("Unable to open " + this->getExternalFileNameForWriting() + " for writing.");
+                    const AString msg = ("Unable to open " + this->getExternalTempFileName() + " for writing.");
                     throw GiftiException(msg);
                 }
             }
-            const int64_t fileOffset = this->externalFileOutputStream->tellp();
+            //
+            // Pad so every array starts on an 8 byte boundary, which
+            // allows readers to use the data in place from a mapping
+            //
+            int64_t fileOffset = this->externalFileOutputStream->tellp();
+            while ((fileOffset % 8) != 0) {
+                this->externalFileOutputStream->put('\0');
+                fileOffset++;
+            }
             FileInformation myInfo(this->getExternalFileNameForWriting());//TODO: get filename only without doing a stat?
             gda->setExternalFileInformation(myInfo.getFileName(),
                                             fileOffset);
@@ -264,6 +287,8 @@ GiftiFileWriter::finish()
     // Close the file
     //
     this->closeFiles();
+    
+    this->replaceExternalFile();
 }
 
 /**
@@ -370,6 +395,54 @@ GiftiFileWriter::getExternalFileNamePrefix() const
       return this->filename + ".data";
 }
 
+/**
+ * Get the name of the temporary file that external data is written to
+ * before it replaces the external file.
+ */
+AString
+GiftiFileWriter::getExternalTempFileName() const
+{
+    return this->getExternalFileNameForWriting() + ".tmp";
+}
+
+/**
+ * Move the temporary external file to the external file name.  A rename
+ * leaves any existing mapping of the old file (for instance, from a file
+ * that was read from the same name) with its own data.
+ *
+ * @throws GiftiException - If the external file can't be replaced.
+ */
+void
+GiftiFileWriter::replaceExternalFile()
+{
+    const AString tempName = this->getExternalTempFileName();
+    if (QFile::exists(tempName) == false) {
+        return;
+    }
+    const AString externalName = this->getExternalFileNameForWriting();
+#ifdef CARET_OS_WINDOWS
+    //
+    // Windows rename doesn't replace, and a mapped file can't be deleted
+    //
+    if (QFile::exists(externalName)
+        && (QFile::remove(externalName) == false)) {
+        QFile::remove(tempName);
+        throw GiftiException("Unable to replace the external file \""
+                             + externalName
+                             + "\", it may be in use by another file.");
+    }
+#endif
+    if (std::rename(QFile::encodeName(tempName).constData(),
+                    QFile::encodeName(externalName).constData()) != 0) {
+        QFile::remove(tempName);
+        throw GiftiException("Unable to rename \""
+                             + tempName
+                             + "\" to \""
+                             + externalName
+                             + "\".");
+    }
+}
+
 /**
  * Get the name of the external file that should be used for writing.
  * 
@@ -53,6 +53,8 @@ namespace caret {
         
         void setMaximumExternalFileSize(const long size);
         
+        AString getExternalFileNameForWriting() const;
+        
     private:
         GiftiFileWriter(const GiftiFileWriter&);
 
@@ -66,7 +68,9 @@ namespace caret {
         
         AString getExternalFileNamePrefix() const;
         
-        AString getExternalFileNameForWriting() const;
+        AString getExternalTempFileName() const;
+        
+        void replaceExternalFile();
         
     public:
         virtual AString toString() const;
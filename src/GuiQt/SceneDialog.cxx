@@ -1453,7 +1453,18 @@ SceneDialog::displayScenePrivate(SceneFile* sceneFile,
     
     const AString sceneFileName = sceneFile->getFileName();
     
+    AString deferredErrorMessage;
+    if (scene->loadDeferredContent(deferredErrorMessage) == false) {
+        WuQMessageBox::errorOk(this,
+                               deferredErrorMessage);
+        return false;
+    }
+    
     const SceneClass* guiManagerClass = scene->getClassWithName("guiManager");
+    if (guiManagerClass == NULL) {
+        WuQMessageBox::errorOk(this,"Scene is missing the guiManager class");
+        return false;
+    }
     if (guiManagerClass->getName() != "guiManager") {
         WuQMessageBox::errorOk(this,"Top level scene class should be guiManager but it is: "
                                + guiManagerClass->getName());
@@ -372,7 +372,7 @@ QString NiftiHeader::toString() const
 
 void NiftiHeader::setDataType(const int16_t& type)
 {
-    m_header.bitpix = typeToNumBits(m_header.datatype);//to check for errors
+    m_header.bitpix = typeToNumBits(type);//to check for errors
     m_header.datatype = type;
 }
 
@@ -24,6 +24,7 @@
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
 #include "CaretBinaryFile.h"
+#include "CaretProfiler.h"
 #include "DataFileException.h"
 #include "NiftiHeader.h"
 
@@ -47,6 +48,8 @@ namespace caret
         void convertRead(TO* out, FROM* in, const int64_t& count);//for reading from file
         template<typename TO, typename FROM>
         void convertWrite(TO* out, const FROM* in, const int64_t& count);//for writing to file
+        template<typename T>
+        void readDataImpl(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const int64_t& numSlabs, const bool& tolerateShortRead);
     public:
         void openRead(const QString& filename);
         void writeNew(const QString& filename, const NiftiHeader& header, const int& version = 1, const bool& withRead = false, const bool& swapEndian = false);
@@ -60,6 +63,9 @@ namespace caret
         //NOTE: you need to provide storage for all components within the range, if getNumComponents() == 3 and fullDims == 0, you need 3 elements allocated
         template<typename T>
         void readData(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead = false);
+        //read numSlabs consecutive slabs along dimension fullDims with a single seek and read, starting from indexSelect
+        template<typename T>
+        void readDataSlabs(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const int64_t& numSlabs);
         template<typename T>
         void writeData(const T* dataIn, const int& fullDims, const std::vector<int64_t>& indexSelect);
     };
@@ -67,6 +73,21 @@ namespace caret
     template<typename T>
     void NiftiIO::readData(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead)
     {
+        readDataImpl(dataOut, fullDims, indexSelect, 1, tolerateShortRead);
+    }
+    
+    template<typename T>
+    void NiftiIO::readDataSlabs(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const int64_t& numSlabs)
+    {
+        CaretAssert(fullDims < (int)m_dims.size() && numSlabs > 0);
+        CaretAssert(indexSelect[0] + numSlabs <= m_dims[fullDims]);//only the first selected dimension advances, so the slabs must not wrap
+        readDataImpl(dataOut, fullDims, indexSelect, numSlabs, false);
+    }
+    
+    template<typename T>
+    void NiftiIO::readDataImpl(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const int64_t& numSlabs, const bool& tolerateShortRead)
+    {
+        CaretProfileSpan mySpan("NiftiIO::readData", "io");
         CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
         CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
         int64_t numElems = getNumComponents();//for now, calculate read size on the fly, as the read call will be the slowest part
@@ -76,6 +97,7 @@ namespace caret
             numElems *= m_dims[curDim];
         }
         int64_t numDimSkip = numElems, numSkip = 0;
+        numElems *= numSlabs;//consecutive slabs are contiguous in the file
         for (; curDim < (int)m_dims.size(); ++curDim)
         {
             CaretAssert(indexSelect[curDim - fullDims] >= 0 && indexSelect[curDim - fullDims] < m_dims[curDim]);
@@ -138,6 +160,7 @@ namespace caret
     template<typename T>
     void NiftiIO::writeData(const T* dataIn, const int& fullDims, const std::vector<int64_t>& indexSelect)
     {
+        CaretProfileSpan mySpan("NiftiIO::writeData", "io");
         CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
         CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
         int64_t numElems = getNumComponents();//for now, calculate read size on the fly, as the read call will be the slowest part
@@ -249,9 +272,13 @@ namespace caret
         {
             if (doScale)
             {
+                const long double typeMin = std::numeric_limits<TO>::min(), typeMax = std::numeric_limits<TO>::max();
                 for (int64_t i = 0; i < count; ++i)
                 {
-                    out[i] = (TO)floor(0.5 + ((long double)in[i] - offset) / mult);//we don't always need that much precision, but it will still be faster than hard drives
+                    long double value = floor(0.5 + ((long double)in[i] - offset) / mult);//we don't always need that much precision, but it will still be faster than hard drives
+                    if (value < typeMin) value = typeMin;//float rounding of the stored scaling can push the extremes slightly out of range, don't let the cast wrap
+                    if (value > typeMax) value = typeMax;
+                    out[i] = (TO)value;
                 }
             } else {
                 for (int64_t i = 0; i < count; ++i)
@@ -0,0 +1,241 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "NiftiOutputDataType.h"
+
+#include "CaretAssert.h"
+#include "DataFileException.h"
+#include "NiftiHeader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace caret;
+
+NiftiOutputDataType NiftiOutputDataType::s_default;
+
+NiftiOutputDataType::NiftiOutputDataType()
+{
+    m_type = NIFTI_TYPE_FLOAT32;
+    m_mode = EXACT;
+    m_haveRange = false;
+    m_scanned = false;
+    m_allIntegers = true;
+    m_min = 0.0;
+    m_max = 0.0;
+}
+
+NiftiOutputDataType::NiftiOutputDataType(const int16_t& niftiType, const Mode& mode)
+{
+    double dummy1, dummy2;
+    getTypeLimits(niftiType, dummy1, dummy2);//throws on unsupported types
+    m_type = niftiType;
+    m_mode = mode;
+    if (m_type == NIFTI_TYPE_FLOAT32) m_mode = EXACT;//scaling floats is pointless
+    m_haveRange = false;
+    m_scanned = false;
+    m_allIntegers = true;
+    m_min = 0.0;
+    m_max = 0.0;
+}
+
+void NiftiOutputDataType::getTypeLimits(const int16_t& niftiType, double& minOut, double& maxOut)
+{
+    switch (niftiType)
+    {
+        case NIFTI_TYPE_FLOAT32:
+            minOut = -numeric_limits<float>::max();
+            maxOut = numeric_limits<float>::max();
+            break;
+        case NIFTI_TYPE_INT32:
+            minOut = numeric_limits<int32_t>::min();
+            maxOut = numeric_limits<int32_t>::max();
+            break;
+        case NIFTI_TYPE_UINT16:
+            minOut = numeric_limits<uint16_t>::min();
+            maxOut = numeric_limits<uint16_t>::max();
+            break;
+        case NIFTI_TYPE_INT16:
+            minOut = numeric_limits<int16_t>::min();
+            maxOut = numeric_limits<int16_t>::max();
+            break;
+        case NIFTI_TYPE_UINT8:
+            minOut = numeric_limits<uint8_t>::min();
+            maxOut = numeric_limits<uint8_t>::max();
+            break;
+        default:
+            throw DataFileException("unsupported output datatype code: " + QString::number(niftiType));
+    }
+}
+
+bool NiftiOutputDataType::isFloat32() const
+{
+    return m_type == NIFTI_TYPE_FLOAT32;
+}
+
+QString NiftiOutputDataType::getName() const
+{
+    QString ret;
+    switch (m_type)
+    {
+        case NIFTI_TYPE_FLOAT32:
+            ret = "FLOAT32";
+            break;
+        case NIFTI_TYPE_INT32:
+            ret = "INT32";
+            break;
+        case NIFTI_TYPE_UINT16:
+            ret = "UINT16";
+            break;
+        case NIFTI_TYPE_INT16:
+            ret = "INT16";
+            break;
+        case NIFTI_TYPE_UINT8:
+            ret = "UINT8";
+            break;
+        default:
+            CaretAssert(false);
+    }
+    if (m_mode == SCALED) ret += "_SCALED";
+    return ret;
+}
+
+void NiftiOutputDataType::setRange(const double& minVal, const double& maxVal)
+{
+    if (!(minVal <= maxVal)) throw DataFileException("output data range minimum must not be greater than the maximum");
+    m_min = minVal;
+    m_max = maxVal;
+    m_haveRange = true;
+    m_scanned = false;
+    m_allIntegers = false;//a hint says nothing about integer values, so always scale
+}
+
+void NiftiOutputDataType::scanData(const float* data, const int64_t& count)
+{
+    if (m_mode != SCALED) return;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        const float value = data[i];
+        if (value != value || std::abs(value) > numeric_limits<float>::max())
+        {
+            throw DataFileException("data contains NaN or infinity, which can't be written as " + getName() + ", use FLOAT32 output");
+        }
+        if (!m_haveRange)
+        {
+            m_min = value;
+            m_max = value;
+            m_haveRange = true;
+        } else {
+            if (value < m_min) m_min = value;
+            if (value > m_max) m_max = value;
+        }
+        if (m_allIntegers && floor(value) != value) m_allIntegers = false;
+    }
+    m_scanned = true;
+}
+
+void NiftiOutputDataType::configureHeader(NiftiHeader& header) const
+{
+    header.setDataType(m_type);
+    header.clearDataScaling();
+    if (m_mode != SCALED) return;
+    if (!m_haveRange)
+    {
+        CaretAssertMessage(false, "configureHeader called on SCALED output type without a range");
+        throw DataFileException("internal error: output data range unknown for scaled datatype");
+    }
+    double typeMin, typeMax;
+    getTypeLimits(m_type, typeMin, typeMax);
+    if (m_scanned && m_allIntegers && m_min >= typeMin && m_max <= typeMax) return;//the data fits exactly, don't add quantization error
+    double slope = (m_max - m_min) / (typeMax - typeMin);
+    if (slope == 0.0)
+    {//constant data, store all zeros and let the offset carry the value
+        slope = 1.0;
+    }
+    double inter = m_min - typeMin * slope;
+    inter = (float)inter;//nifti-1 stores these as float, so make the values we convert with match what a reader will see
+    double neededSlope = (m_max - inter) / typeMax;//with a large offset and a narrow range, rounding inter moves the data by many type units, so refit the slope around it
+    if (typeMin < 0.0) neededSlope = max(neededSlope, (m_min - inter) / typeMin);
+    if (neededSlope > slope) slope = neededSlope;
+    float slopeFloat = (float)slope;
+    if (slopeFloat < slope) slopeFloat = (float)(slope * (1.0 + numeric_limits<float>::epsilon()));//round up, so the extremes stay in range
+    slope = slopeFloat;
+    header.setDataScaling(slope, inter);
+}
+
+void NiftiOutputDataType::checkData(const float* data, const int64_t& count) const
+{
+    if (m_type == NIFTI_TYPE_FLOAT32) return;
+    if (m_mode == SCALED)
+    {
+        CaretAssert(m_haveRange);
+        for (int64_t i = 0; i < count; ++i)
+        {
+            if (!(data[i] >= m_min && data[i] <= m_max))//also catches NaN
+            {
+                throw DataFileException("value " + QString::number(data[i]) + " is outside the output data range [" +
+                                        QString::number(m_min) + ", " + QString::number(m_max) + "] for " + getName());
+            }
+        }
+    } else {
+        double typeMin, typeMax;
+        getTypeLimits(m_type, typeMin, typeMax);
+        for (int64_t i = 0; i < count; ++i)
+        {
+            const double value = data[i];
+            if (!(value >= typeMin && value <= typeMax) || floor(value) != value)//also catches NaN
+            {
+                throw DataFileException("value " + QString::number(data[i]) + " can't be stored exactly as " + getName() +
+                                        ", use a larger or scaled datatype, or FLOAT32");
+            }
+        }
+    }
+}
+
+NiftiOutputDataType NiftiOutputDataType::fromName(const QString& name, bool* validOut)
+{
+    if (validOut != NULL) *validOut = true;
+    if (name == "FLOAT32") return NiftiOutputDataType();
+    if (name == "INT32") return NiftiOutputDataType(NIFTI_TYPE_INT32);
+    if (name == "UINT16") return NiftiOutputDataType(NIFTI_TYPE_UINT16);
+    if (name == "INT16") return NiftiOutputDataType(NIFTI_TYPE_INT16);
+    if (name == "UINT8") return NiftiOutputDataType(NIFTI_TYPE_UINT8);
+    if (name == "INT16_SCALED") return NiftiOutputDataType(NIFTI_TYPE_INT16, SCALED);
+    if (name == "UINT8_SCALED") return NiftiOutputDataType(NIFTI_TYPE_UINT8, SCALED);
+    if (validOut != NULL) *validOut = false;
+    return NiftiOutputDataType();
+}
+
+QString NiftiOutputDataType::getValidNames()
+{
+    return "FLOAT32, INT32, UINT16, INT16, UINT8, INT16_SCALED, UINT8_SCALED";
+}
+
+const NiftiOutputDataType& NiftiOutputDataType::getDefault()
+{
+    return s_default;
+}
+
+void NiftiOutputDataType::setDefault(const NiftiOutputDataType& type)
+{
+    s_default = type;
+}
@@ -0,0 +1,82 @@
+#ifndef __NIFTI_OUTPUT_DATA_TYPE_H__
+#define __NIFTI_OUTPUT_DATA_TYPE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <QString>
+
+#include <stdint.h>
+
+namespace caret
+{
+    
+    struct NiftiHeader;
+    
+    ///what datatype to write volume or cifti data as, and how float values map into it
+    class NiftiOutputDataType
+    {
+    public:
+        enum Mode
+        {
+            EXACT,//integer types: every value must already be an integer in range, otherwise writing fails
+            SCALED//integer types: use scl_slope/scl_inter to fit the data range into the type
+        };
+        
+        NiftiOutputDataType();//float32, the historical default
+        explicit NiftiOutputDataType(const int16_t& niftiType, const Mode& mode = EXACT);
+        
+        int16_t getType() const { return m_type; }
+        Mode getMode() const { return m_mode; }
+        bool isFloat32() const;
+        QString getName() const;
+        
+        ///for SCALED, give the range of the data so writing doesn't need an extra pass over it
+        void setRange(const double& minVal, const double& maxVal);
+        bool hasRange() const { return m_haveRange; }
+        ///true when the header can't be configured until the data has been passed to scanData
+        bool needsScan() const { return m_mode == SCALED && !m_haveRange; }
+        ///first pass of a two-pass write, accumulates the range of the data
+        void scanData(const float* data, const int64_t& count);
+        
+        ///set datatype and scaling on the header, throws if the scanned range can't be represented
+        void configureHeader(NiftiHeader& header) const;
+        ///throws if any value would lose precision or fall outside the range the header was configured for
+        void checkData(const float* data, const int64_t& count) const;
+        
+        ///valid names are FLOAT32, INT32, UINT16, INT16, UINT8, INT16_SCALED, UINT8_SCALED
+        static NiftiOutputDataType fromName(const QString& name, bool* validOut = NULL);
+        static QString getValidNames();
+        
+        ///process-wide default used by files that haven't had a datatype set, wb_command sets it from a global option
+        static const NiftiOutputDataType& getDefault();
+        static void setDefault(const NiftiOutputDataType& type);
+    private:
+        int16_t m_type;
+        Mode m_mode;
+        bool m_haveRange, m_scanned, m_allIntegers;
+        double m_min, m_max;
+        static NiftiOutputDataType s_default;
+        static void getTypeLimits(const int16_t& niftiType, double& minOut, double& maxOut);
+    };
+    
+}
+
+#endif //__NIFTI_OUTPUT_DATA_TYPE_H__
@@ -21,6 +21,7 @@
 #include "AString.h"
 #include "ByteOrderEnum.h"
 #include "ByteSwapping.h"
+#include "CaretMutex.h"
 #include "CaretOMP.h"
 #include "CaretPointer.h"
 #include "CiftiFile.h"
@@ -179,6 +180,7 @@ void OperationBackendAverageROICorrelation::processCifti(const CiftiFile* myCift
     }
     float rrs = sqrt(accum);
     int curRow = 0;
+    CaretMutex readMutex;//per call rather than a global critical, so concurrent calls on different files don't wait on each other
 #pragma omp CARET_PAR
     {
         vector<float> rowscratch(rowSize);
@@ -186,8 +188,8 @@ void OperationBackendAverageROICorrelation::processCifti(const CiftiFile* myCift
         for (int i = 0; i < colSize; ++i)
         {
             int myRow;
-#pragma omp critical
             {
+                CaretMutexLocker locked(&readMutex);
                 myRow = curRow;//force sequential reading
                 ++curRow;
                 myCifti->getRow(rowscratch.data(), myRow);//but never read multiple rows at once from the same file
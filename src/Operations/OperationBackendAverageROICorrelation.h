@@ -29,8 +29,8 @@ namespace caret {
     
     class OperationBackendAverageROICorrelation : public AbstractOperation
     {
-        static void processCifti(const CiftiFile* myCifti, const std::vector<int>& indexList, std::vector<float>& output);
     public:
+        static void processCifti(const CiftiFile* myCifti, const std::vector<int>& indexList, std::vector<float>& output);//also used by -backend-server
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
@@ -0,0 +1,512 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationBackendServer.h"
+#include "OperationException.h"
+
+#include "ByteOrderEnum.h"
+#include "ByteSwapping.h"
+#include "CaretException.h"
+#include "CaretLogger.h"
+#include "CaretMutex.h"
+#include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "CiftiFile.h"
+#include "OperationBackendAverageDenseROI.h"
+#include "OperationBackendAverageROICorrelation.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QRunnable>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <exception>
+#include <list>
+#include <map>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationBackendServer::getCommandSwitch()
+{
+    return "-backend-server";
+}
+
+AString OperationBackendServer::getShortDescription()
+{
+    return "CONNECTOME DB BACKEND QUERY SERVER";
+}
+
+OperationParameters* OperationBackendServer::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addStringParameter(1, "socket-name", "name or path of the local socket to listen on");
+    
+    OptionalParameter* threadsOpt = ret->createOptionalParameter(2, "-threads", "set the number of requests to serve concurrently");
+    threadsOpt->addIntegerParameter(1, "num-threads", "number of worker threads (default is the number of cores)");
+    
+    OptionalParameter* filesOpt = ret->createOptionalParameter(3, "-max-open-files", "set the number of cifti files to keep open between requests");
+    filesOpt->addIntegerParameter(1, "num-files", "maximum number of open files (default 256)");
+    
+    OptionalParameter* cacheOpt = ret->createOptionalParameter(4, "-row-cache-mb", "set the memory limit of the row cache");
+    cacheOpt->addIntegerParameter(1, "megabytes", "size of the row cache in megabytes (default 1024)");
+    
+    ret->setHelpText(
+        AString("This command is probably not the one you are looking for.  ") +
+        "It runs until killed, serving requests for " + OperationBackendAverageDenseROI::getCommandSwitch() + " and " +
+        OperationBackendAverageROICorrelation::getCommandSwitch() + " over a local (unix domain) socket, " +
+        "so that cifti files stay open and frequently requested rows stay in memory between requests.  " +
+        "Requests are served concurrently by a pool of worker threads, and each request computes with its share of the cores.\n\n" +
+        "A request is sent as lines of text: the command switch, then the comma separated list of cifti indexes, then the cifti files, one per line, " +
+        "followed by an empty line.  " +
+        "The response uses the same format as the output file of those commands: a little endian, 32-bit integer of row size followed by the row as 32-bit floats.  " +
+        "If the request fails, the row size is -1, and is followed by a little endian, 32-bit integer of message length and the error message as UTF-8.  " +
+        "The server closes the connection after each response.\n\n" +
+        "If a cifti file is modified after it was opened, it is reopened on its next use."
+    );
+    return ret;
+}
+
+namespace
+{
+    const int SOCKET_TIMEOUT_MSEC = 60000;
+    
+    ///an open cifti file, shared between requests
+    struct CachedCifti
+    {
+        CaretPointer<CiftiFile> m_file;
+        CaretMutex m_mutex;//on-disk reading seeks, so only one reader at a time per file
+        QDateTime m_modified;
+        int64_t m_generation;//identifies this instance of the file in the row cache
+        int64_t m_lastUsed;
+    };
+    
+    ///keeps cifti files open and caches recently used rows, with LRU eviction of both
+    class BackendCiftiCache
+    {
+        typedef pair<int64_t, int64_t> RowKey;//generation, row index
+        struct CachedRow
+        {
+            vector<float> m_data;
+            list<RowKey>::iterator m_lruPos;
+        };
+        map<AString, CaretPointer<CachedCifti> > m_files;
+        map<RowKey, CachedRow> m_rows;
+        list<RowKey> m_rowLRU;//front is most recently used
+        int64_t m_maxFiles, m_maxRowBytes, m_rowBytes, m_useCounter, m_generationCounter;
+        CaretMutex m_filesMutex, m_rowsMutex;
+        
+        bool lookupRow(const RowKey& key, float* dataOut, const int64_t& rowSize)
+        {
+            CaretMutexLocker locked(&m_rowsMutex);
+            map<RowKey, CachedRow>::iterator iter = m_rows.find(key);
+            if (iter == m_rows.end()) return false;
+            CaretAssert((int64_t)iter->second.m_data.size() == rowSize);
+            for (int64_t i = 0; i < rowSize; ++i)
+            {
+                dataOut[i] = iter->second.m_data[i];
+            }
+            m_rowLRU.splice(m_rowLRU.begin(), m_rowLRU, iter->second.m_lruPos);
+            return true;
+        }
+        
+        void storeRow(const RowKey& key, const float* data, const int64_t& rowSize)
+        {
+            int64_t rowBytes = rowSize * sizeof(float);
+            if (rowBytes > m_maxRowBytes) return;
+            CaretMutexLocker locked(&m_rowsMutex);
+            if (m_rows.find(key) != m_rows.end()) return;//another thread got here first
+            while (m_rowBytes + rowBytes > m_maxRowBytes && !m_rowLRU.empty())
+            {
+                map<RowKey, CachedRow>::iterator victim = m_rows.find(m_rowLRU.back());
+                CaretAssert(victim != m_rows.end());
+                m_rowBytes -= victim->second.m_data.size() * sizeof(float);
+                m_rows.erase(victim);
+                m_rowLRU.pop_back();
+            }
+            m_rowLRU.push_front(key);
+            CachedRow& newRow = m_rows[key];
+            newRow.m_data.assign(data, data + rowSize);
+            newRow.m_lruPos = m_rowLRU.begin();
+            m_rowBytes += rowBytes;
+        }
+        CaretPointer<CachedCifti> findFresh(const AString& fileName, const QDateTime& modified)
+        {
+            CaretMutexLocker locked(&m_filesMutex);
+            map<AString, CaretPointer<CachedCifti> >::iterator iter = m_files.find(fileName);
+            if (iter == m_files.end()) return CaretPointer<CachedCifti>();
+            if (iter->second->m_modified != modified)
+            {
+                m_files.erase(iter);//stale, requests already using it keep their reference
+                return CaretPointer<CachedCifti>();
+            }
+            iter->second->m_lastUsed = m_useCounter++;
+            return iter->second;
+        }
+    public:
+        BackendCiftiCache(const int64_t& maxFiles, const int64_t& maxRowBytes)
+        {
+            m_maxFiles = maxFiles;
+            m_maxRowBytes = maxRowBytes;
+            m_rowBytes = 0;
+            m_useCounter = 0;
+            m_generationCounter = 0;
+        }
+        
+        CaretPointer<CachedCifti> getFile(const AString& fileName)
+        {
+            QFileInfo myInfo(fileName);
+            if (!myInfo.exists())
+            {
+                throw OperationException("file does not exist: " + fileName);
+            }
+            QDateTime modified = myInfo.lastModified();
+            CaretPointer<CachedCifti> ret = findFresh(fileName, modified);
+            if (ret.getPointer() != NULL) return ret;
+            CaretPointer<CiftiFile> newFile(new CiftiFile(fileName));//open without the lock so other requests aren't held up - can't skip parsing XML, as different arguments could be different cifti versions, which results in different dimension order
+            CaretMutexLocker locked(&m_filesMutex);
+            map<AString, CaretPointer<CachedCifti> >::iterator iter = m_files.find(fileName);
+            if (iter != m_files.end())
+            {
+                if (iter->second->m_modified == modified)
+                {//another request opened it meanwhile, use theirs so the row cache is shared
+                    iter->second->m_lastUsed = m_useCounter++;
+                    return iter->second;
+                }
+                m_files.erase(iter);
+            }
+            if ((int64_t)m_files.size() >= m_maxFiles)
+            {
+                map<AString, CaretPointer<CachedCifti> >::iterator oldest = m_files.begin();
+                for (iter = m_files.begin(); iter != m_files.end(); ++iter)
+                {
+                    if (iter->second->m_lastUsed < oldest->second->m_lastUsed) oldest = iter;
+                }
+                m_files.erase(oldest);
+            }
+            ret.grabNew(new CachedCifti());
+            ret->m_file = newFile;
+            ret->m_modified = modified;
+            ret->m_generation = m_generationCounter++;
+            ret->m_lastUsed = m_useCounter++;
+            m_files[fileName] = ret;
+            return ret;
+        }
+        
+        void getRow(CachedCifti* cached, float* dataOut, const int64_t& index)
+        {
+            int64_t rowSize = cached->m_file->getNumberOfColumns();
+            RowKey key(cached->m_generation, index);
+            if (lookupRow(key, dataOut, rowSize)) return;
+            {
+                CaretMutexLocker locked(&(cached->m_mutex));
+                cached->m_file->getRow(dataOut, index);
+            }
+            storeRow(key, dataOut, rowSize);
+        }
+    };
+    
+    vector<int> parseIndexList(const AString& indexListString)
+    {
+        bool ok = false;
+        QStringList indexStrings = indexListString.split(",");
+        int numStrings = (int)indexStrings.size();
+        vector<int> indexList(numStrings);
+        for (int i = 0; i < numStrings; ++i)
+        {
+            indexList[i] = indexStrings[i].toInt(&ok);
+            if (!ok)
+            {
+                throw OperationException("failed to parse '" + indexStrings[i] + "' as integer");
+            }
+            if (indexList[i] < 0)
+            {
+                throw OperationException("negative integers are not valid cifti indexes");
+            }
+        }
+        return indexList;
+    }
+    
+    void averageDenseROI(BackendCiftiCache& myCache, const vector<int>& indexList, const vector<CaretPointer<CachedCifti> >& ciftiList, vector<float>& output)
+    {
+        int numCifti = (int)ciftiList.size();
+        int numIndices = (int)indexList.size();
+        const CiftiXML& baseXML = ciftiList[0]->m_file->getCiftiXML();
+        if (baseXML.getNumberOfDimensions() != 2) throw OperationException("this command currently only supports 2D cifti");
+        int numRows = baseXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
+        int rowSize = baseXML.getDimensionLength(CiftiXML::ALONG_ROW);
+        vector<double> accum(rowSize, 0.0);
+        output.resize(rowSize);
+        for (int i = 0; i < numCifti; ++i)
+        {
+            if (baseXML != ciftiList[i]->m_file->getCiftiXML())
+            {
+                throw OperationException("error, cifti header of file #" + AString::number(i + 1) + " doesn't match");
+            }
+            for (int j = 0; j < numIndices; ++j)
+            {
+                if (indexList[j] >= numRows)
+                {
+                    throw OperationException("error, cifti index outside number of rows");
+                }
+                myCache.getRow(ciftiList[i], output.data(), indexList[j]);
+                for (int k = 0; k < rowSize; ++k)
+                {
+                    accum[k] += output[k];
+                }
+            }
+        }
+        for (int k = 0; k < rowSize; ++k)
+        {
+            output[k] = accum[k] / numCifti / numIndices;
+        }
+    }
+    
+    void averageROICorrelation(const vector<int>& indexList, const vector<CaretPointer<CachedCifti> >& ciftiList, vector<float>& output)
+    {
+        int numCifti = (int)ciftiList.size();
+        int numIndices = (int)indexList.size();
+        const CiftiXML& baseXML = ciftiList[0]->m_file->getCiftiXML();
+        if (baseXML.getNumberOfDimensions() != 2) throw OperationException("operation only supports 2D cifti files");
+        int rowSize = baseXML.getDimensionLength(CiftiXML::ALONG_ROW);
+        vector<double> accum(rowSize, 0.0);
+        output.resize(rowSize);
+        for (int i = 0; i < numCifti; ++i)
+        {
+            if (!baseXML.approximateMatch(ciftiList[i]->m_file->getCiftiXML()))
+            {
+                throw OperationException("error, cifti header of file #" + AString::number(i + 1) + " doesn't match");
+            }
+            {
+                CaretMutexLocker locked(&(ciftiList[i]->m_mutex));//reads every row of the file
+                OperationBackendAverageROICorrelation::processCifti(ciftiList[i]->m_file, indexList, output);
+            }
+            for (int k = 0; k < rowSize; ++k)
+            {
+                accum[k] += output[k];
+            }
+        }
+        for (int k = 0; k < rowSize; ++k)
+        {
+            output[k] = accum[k] / numCifti / numIndices;
+        }
+    }
+    
+    void appendInt32(QByteArray& buffer, int32_t value)
+    {
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapBytes(&value, 1);
+        }
+        buffer.append((const char*)&value, sizeof(int32_t));
+    }
+    
+    class BackendRequest : public QRunnable
+    {
+        quintptr m_socketDescriptor;
+        BackendCiftiCache* m_cache;
+        int m_ompThreads;
+        
+        static QByteArray errorResponse(const AString& error)
+        {
+            QByteArray message = error.toUtf8(), ret;
+            appendInt32(ret, -1);
+            appendInt32(ret, message.size());
+            ret.append(message);
+            CaretLogInfo("backend server request failed: " + error);
+            return ret;
+        }
+        
+        bool readLine(QLocalSocket& mySocket, AString& lineOut)
+        {
+            while (!mySocket.canReadLine())
+            {
+                if (!mySocket.waitForReadyRead(SOCKET_TIMEOUT_MSEC)) return false;
+            }
+            QByteArray myLine = mySocket.readLine();
+            while (myLine.endsWith('\n') || myLine.endsWith('\r'))
+            {
+                myLine.chop(1);
+            }
+            lineOut = AString::fromUtf8(myLine.constData(), myLine.size());
+            return true;
+        }
+        
+        QByteArray processRequest(QLocalSocket& mySocket)
+        {
+            AString commandSwitch, indexListString, myLine;
+            if (!readLine(mySocket, commandSwitch) || !readLine(mySocket, indexListString))
+            {
+                throw OperationException("incomplete request");
+            }
+            vector<CaretPointer<CachedCifti> > ciftiList;
+            while (true)
+            {
+                if (!readLine(mySocket, myLine)) throw OperationException("incomplete request");
+                if (myLine == "") break;//blank line ends the request
+                ciftiList.push_back(m_cache->getFile(myLine));
+            }
+            vector<int> indexList = parseIndexList(indexListString);
+            vector<float> output;
+            if (!ciftiList.empty())
+            {
+                if (commandSwitch == OperationBackendAverageDenseROI::getCommandSwitch())
+                {
+                    averageDenseROI(*m_cache, indexList, ciftiList, output);
+                } else if (commandSwitch == OperationBackendAverageROICorrelation::getCommandSwitch()) {
+                    averageROICorrelation(indexList, ciftiList, output);
+                } else {
+                    throw OperationException("unrecognized backend command: " + commandSwitch);
+                }
+            }
+            int32_t rowSize = (int32_t)output.size();
+            if (ByteOrderEnum::isSystemBigEndian())
+            {
+                ByteSwapping::swapBytes(output.data(), rowSize);//beware, we are doing the byteswapping in place
+            }
+            QByteArray ret;
+            ret.reserve(sizeof(int32_t) + rowSize * sizeof(float));
+            appendInt32(ret, rowSize);
+            ret.append((const char*)output.data(), rowSize * sizeof(float));
+            return ret;
+        }
+    public:
+        BackendRequest(quintptr socketDescriptor, BackendCiftiCache* myCache, const int& ompThreads)
+        {
+            m_socketDescriptor = socketDescriptor;
+            m_cache = myCache;
+            m_ompThreads = ompThreads;
+        }
+        
+        void run()
+        {
+#ifdef CARET_OMP
+            omp_set_num_threads(m_ompThreads);//only affects parallel regions started from this pool thread
+#endif
+            QLocalSocket mySocket;//created in the worker thread, so blocking calls work without an event loop
+            if (!mySocket.setSocketDescriptor(m_socketDescriptor))
+            {
+                CaretLogWarning("backend server failed to take over connection: " + mySocket.errorString());
+                return;
+            }
+            QByteArray response;
+            try
+            {
+                response = processRequest(mySocket);
+            } catch (CaretException& e) {
+                response = errorResponse(e.whatString());
+            } catch (bad_alloc&) {
+                response = errorResponse("ran out of memory");
+            } catch (exception& e) {
+                response = errorResponse(e.what());
+            }
+            mySocket.write(response);
+            while (mySocket.bytesToWrite() > 0)
+            {
+                if (!mySocket.waitForBytesWritten(SOCKET_TIMEOUT_MSEC))
+                {
+                    CaretLogWarning("backend server failed to send response: " + mySocket.errorString());
+                    break;
+                }
+            }
+            mySocket.disconnectFromServer();
+            if (mySocket.state() != QLocalSocket::UnconnectedState)
+            {
+                mySocket.waitForDisconnected(SOCKET_TIMEOUT_MSEC);
+            }
+        }
+    };
+    
+    ///hands each new connection's native descriptor to the worker pool, rather than a QLocalSocket owned by this thread
+    class BackendLocalServer : public QLocalServer
+    {
+        QThreadPool* m_pool;
+        BackendCiftiCache* m_cache;
+        int m_ompThreads;
+    public:
+        BackendLocalServer(QThreadPool* myPool, BackendCiftiCache* myCache, const int& ompThreads)
+        {
+            m_pool = myPool;
+            m_cache = myCache;
+            m_ompThreads = ompThreads;
+        }
+    protected:
+        void incomingConnection(quintptr socketDescriptor)
+        {
+            m_pool->start(new BackendRequest(socketDescriptor, m_cache, m_ompThreads));//pool deletes it when done
+        }
+    };
+}
+
+void OperationBackendServer::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    AString socketName = myParams->getString(1);
+    int numThreads = -1;
+    OptionalParameter* threadsOpt = myParams->getOptionalParameter(2);
+    if (threadsOpt->m_present)
+    {
+        numThreads = (int)threadsOpt->getInteger(1);
+        if (numThreads < 1) throw OperationException("number of threads must be positive");
+    }
+    int64_t maxFiles = 256;
+    OptionalParameter* filesOpt = myParams->getOptionalParameter(3);
+    if (filesOpt->m_present)
+    {
+        maxFiles = filesOpt->getInteger(1);
+        if (maxFiles < 1) throw OperationException("maximum number of open files must be positive");
+    }
+    int64_t cacheMB = 1024;
+    OptionalParameter* cacheOpt = myParams->getOptionalParameter(4);
+    if (cacheOpt->m_present)
+    {
+        cacheMB = cacheOpt->getInteger(1);
+        if (cacheMB < 0) throw OperationException("row cache size must not be negative");
+    }
+    BackendCiftiCache myCache(maxFiles, cacheMB * 1024 * 1024);//must outlive the pool, whose destructor waits for running requests
+    QThreadPool myPool;
+    if (numThreads > 0)
+    {
+        myPool.setMaxThreadCount(numThreads);
+    }
+    int ompThreads = 1;
+#ifdef CARET_OMP
+    ompThreads = max(1, omp_get_max_threads() / myPool.maxThreadCount());//split the cores between concurrent requests, so each request's parallel loops don't oversubscribe them
+#endif
+    BackendLocalServer myServer(&myPool, &myCache, ompThreads);
+    QLocalServer::removeServer(socketName);//clean up after a server that was killed
+    if (!myServer.listen(socketName))
+    {
+        throw OperationException("failed to listen on socket '" + socketName + "': " + myServer.errorString());
+    }
+    CaretLogInfo("backend server listening on " + myServer.fullServerName());
+    while (myServer.isListening())
+    {
+        myServer.waitForNewConnection(-1);//calls incomingConnection, which queues the request
+    }
+    myPool.waitForDone();
+}
@@ -1,5 +1,5 @@
-#ifndef __CHART_POINT_H__
-#define __CHART_POINT_H__
+#ifndef __OPERATION_BACKEND_SERVER_H__
+#define __OPERATION_BACKEND_SERVER_H__
 
 /*LICENSE_START*/
 /*
@@ -21,47 +21,21 @@
  */
 /*LICENSE_END*/
 
-
-#include "CaretObject.h"
-
-
+#include "AbstractOperation.h"
 
 namespace caret {
-
-    class ChartPoint : public CaretObject {
-        
+    
+    class OperationBackendServer : public AbstractOperation
+    {
     public:
-        ChartPoint(const float x,
-                   const float y);
-        
-        virtual ~ChartPoint();
-        
-        ChartPoint(const ChartPoint& obj);
-
-        ChartPoint& operator=(const ChartPoint& obj);
-        
-        const float* getXY() const;
-        
-        float getX() const;
-        
-        float getY() const;
-
-        // ADD_NEW_METHODS_HERE
-
-        virtual AString toString() const;
-        
-    private:
-        void copyHelperChartPoint(const ChartPoint& obj);
+        static OperationParameters* getParameters();
+        static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
+        static AString getCommandSwitch();
+        static AString getShortDescription();
+    };
 
-        float m_xyz[3];
-        
-        // ADD_NEW_MEMBERS_HERE
+    typedef TemplateAutoOperation<OperationBackendServer> AutoOperationBackendServer;
 
-    };
-    
-#ifdef __CHART_POINT_DECLARE__
-    // <PLACE DECLARATIONS OF STATIC MEMBERS HERE>
-#endif // __CHART_POINT_DECLARE__
+}
 
-} // namespace
-#endif  //__CHART_POINT_H__
+#endif //__OPERATION_BACKEND_SERVER_H__
@@ -21,7 +21,9 @@
 #include "OperationCiftiStats.h"
 #include "OperationException.h"
 
+#include "CaretOMP.h"
 #include "CiftiFile.h"
+#include "MultiReduction.h"
 #include "ReductionOperation.h"
 
 #include <algorithm>
@@ -50,10 +52,10 @@ OperationParameters* OperationCiftiStats::getParameters()
     
     ret->addCiftiParameter(1, "cifti-in", "the input cifti");
     
-    OptionalParameter* reduceOpt = ret->createOptionalParameter(2, "-reduce", "use a reduction operation");
+    ParameterComponent* reduceOpt = ret->createRepeatableParameter(2, "-reduce", "use a reduction operation");
     reduceOpt->addStringParameter(1, "operation", "the reduction operation");
     
-    OptionalParameter* percentileOpt = ret->createOptionalParameter(3, "-percentile", "give the value at a percentile");
+    ParameterComponent* percentileOpt = ret->createRepeatableParameter(3, "-percentile", "give the value at a percentile");
     percentileOpt->addDoubleParameter(1, "percent", "the percentile to find");
     
     OptionalParameter* columnOpt = ret->createOptionalParameter(4, "-column", "only display output for one column");
@@ -66,10 +68,12 @@ OperationParameters* OperationCiftiStats::getParameters()
     ret->createOptionalParameter(6, "-show-map-name", "print column index and name before each output");
     
     ret->setHelpText(
-        AString("For each column of the input, a single number is printed, resulting from the specified reduction or percentile operation.  ") +
+        AString("For each column of the input, a line is printed containing the results of the specified reduction and percentile operations, separated by spaces.  ") +
         "Use -column to only give output for a single column.  " +
         "Use -roi to consider only the data within a region.  " +
-        "Exactly one of -reduce or -percentile must be specified.\n\n" +
+        "At least one -reduce or -percentile must be specified, and both options may be repeated.  " +
+        "Results are printed with all -reduce operations first, in the order given, followed by all -percentile operations, in the order given.  " +
+        "All results are computed from a single read of the input, so requesting several statistics at once is faster than running this command several times.\n\n" +
         "The argument to the -reduce option must be one of the following:\n\n" +
         ReductionOperation::getHelpInfo());
     return ret;
@@ -77,14 +81,14 @@ OperationParameters* OperationCiftiStats::getParameters()
 
 namespace
 {
-    float reduce(const vector<float>& data, const ReductionEnum::Enum& myop, const vector<float>& roiData)
+    const int64_t STREAM_BLOCK_BYTES = 64 * 1024 * 1024;//rows read serially before their columns are accumulated in parallel
+    
+    void computeColumn(const MultiReduction& myReduce, const float* data, const int64_t& numElems, const float* roiData, float* resultsOut)
     {
-        if (roiData.empty())
+        if (roiData == NULL)
         {
-            return ReductionOperation::reduce(data.data(), data.size(), myop);
+            myReduce.compute(data, numElems, resultsOut);
         } else {
-            int64_t numElems = (int64_t)data.size();
-            CaretAssert(numElems == (int64_t)roiData.size());
             vector<float> toUse;
             toUse.reserve(numElems);
             for (int64_t i = 0; i < numElems; ++i)
@@ -95,37 +99,20 @@ namespace
                 }
             }
             if (toUse.empty()) throw OperationException("roi column is empty");
-            return ReductionOperation::reduce(toUse.data(), toUse.size(), myop);
+            myReduce.compute(toUse.data(), toUse.size(), resultsOut);
         }
     }
     
-    float percentile(const vector<float>& data, const float& percent, const vector<float>& roiData)
+    void printResults(const float* results, const int& numResults)
     {
-        CaretAssert(percent >= 0.0f && percent <= 100.0f);
-        vector<float> toUse;
-        if (roiData.empty())
+        stringstream resultsstr;
+        resultsstr << setprecision(7);
+        for (int i = 0; i < numResults; ++i)
         {
-            toUse = data;
-        } else {
-            int64_t numElems = (int64_t)data.size();
-            CaretAssert(numElems == (int64_t)roiData.size());
-            toUse.reserve(numElems);
-            for (int i = 0; i < numElems; ++i)
-            {
-                if (roiData[i] > 0.0f)
-                {
-                    toUse.push_back(data[i]);
-                }
-            }
+            if (i != 0) resultsstr << " ";
+            resultsstr << results[i];
         }
-        if (toUse.empty()) throw OperationException("roi is empty");
-        sort(toUse.begin(), toUse.end());
-        const float index = percent / 100.0f * (toUse.size() - 1);
-        if (index <= 0) return toUse[0];
-        if (index >= toUse.size() - 1) return toUse.back();
-        float ipart, fpart;
-        fpart = modf(index, &ipart);
-        return (1.0f - fpart) * toUse[(int)ipart] + fpart * toUse[((int)ipart) + 1];
+        cout << resultsstr.str() << endl;
     }
 }
 
@@ -137,25 +124,27 @@ void OperationCiftiStats::useParameters(OperationParameters* myParams, ProgressO
     if (myXML.getNumberOfDimensions() != 2) throw OperationException("only 2D cifti are supported in this command");
     int64_t numCols = myXML.getDimensionLength(CiftiXML::ALONG_ROW);
     int64_t colLength = myXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
-    OptionalParameter* reduceOpt = myParams->getOptionalParameter(2);
-    OptionalParameter* percentileOpt = myParams->getOptionalParameter(3);
-    if (reduceOpt->m_present == percentileOpt->m_present)//use == as logical xor
+    const vector<ParameterComponent*>& reduceInstances = *(myParams->getRepeatableParameterInstances(2));
+    const vector<ParameterComponent*>& percentileInstances = *(myParams->getRepeatableParameterInstances(3));
+    if (reduceInstances.empty() && percentileInstances.empty())
     {
-        throw OperationException("you must use exactly one of -reduce or -percentile");
+        throw OperationException("you must specify at least one -reduce or -percentile");
     }
-    ReductionEnum::Enum myop = ReductionEnum::INVALID;
-    if (reduceOpt->m_present)
+    MultiReduction myReduce;
+    for (int i = 0; i < (int)reduceInstances.size(); ++i)
     {
         bool ok = false;
-        myop = ReductionEnum::fromName(reduceOpt->getString(1), &ok);
-        if (!ok) throw OperationException("unrecognized reduction operation: " + reduceOpt->getString(1));
+        ReductionEnum::Enum myop = ReductionEnum::fromName(reduceInstances[i]->getString(1), &ok);
+        if (!ok) throw OperationException("unrecognized reduction operation: " + reduceInstances[i]->getString(1));
+        myReduce.addReduction(myop);
     }
-    float percent = 0.0f;
-    if (percentileOpt->m_present)
+    for (int i = 0; i < (int)percentileInstances.size(); ++i)
     {
-        percent = (float)percentileOpt->getDouble(1);//use not within range to trap NaNs, just in case
+        float percent = (float)percentileInstances[i]->getDouble(1);//use not within range to trap NaNs, just in case
         if (!(percent >= 0.0f && percent <= 100.0f)) throw OperationException("percentile must be between 0 and 100");
+        myReduce.addPercentile(percent);
     }
+    const int numResults = myReduce.getNumberOfResults();
     int useColumn = -1;
     OptionalParameter* columnOpt = myParams->getOptionalParameter(4);
     if (columnOpt->m_present)
@@ -188,57 +177,112 @@ void OperationCiftiStats::useParameters(OperationParameters* myParams, ProgressO
     }
     bool showMapName = myParams->getOptionalParameter(6)->m_present;
     const CiftiMappingType* rowMap = myXML.getMap(CiftiXML::ALONG_ROW);
-    vector<float> colScratch(colLength);
     if (useColumn == -1)
     {
-        myInput->convertToInMemory();//we will be getting all columns, so read it all in first
-        if (matchColumnMode)
-        {
-            roiCifti->convertToInMemory();//ditto
-        }
-        for (int i = 0; i < numCols; ++i)
-        {
-            myInput->getColumn(colScratch.data(), i);
+        vector<float> results(numCols * numResults);
+        vector<AString> errors(numCols);//exceptions can't leave an omp region, so collect them and throw afterwards
+        if (myReduce.isStreamable())
+        {//everything can be accumulated, so read each row once without converting to in-memory, and accumulate every column at the same time
+            vector<MultiReduction::Accumulator> accums(numCols);
+            int64_t blockRows = STREAM_BLOCK_BYTES / (numCols * (int64_t)sizeof(float) * (matchColumnMode ? 2 : 1));
+            if (blockRows > colLength) blockRows = colLength;
+            if (blockRows < 1) blockRows = 1;
+            vector<float> blockScratch(blockRows * numCols), roiBlockScratch;
+            if (matchColumnMode) roiBlockScratch.resize(blockRows * numCols);
+            for (int64_t blockStart = 0; blockStart < colLength; blockStart += blockRows)
+            {
+                int64_t blockEnd = min(blockStart + blockRows, colLength);
+                int64_t numRead = 0;
+                for (int64_t row = blockStart; row < blockEnd; ++row)
+                {
+                    if (roiCifti != NULL && !matchColumnMode && !(roiData[row] > 0.0f)) continue;
+                    myInput->getRow(blockScratch.data() + numRead * numCols, row);
+                    if (matchColumnMode)
+                    {
+                        roiCifti->getRow(roiBlockScratch.data() + numRead * numCols, row);
+                    }
+                    ++numRead;
+                }
+#pragma omp CARET_PARFOR schedule(static)
+                for (int64_t i = 0; i < numCols; ++i)
+                {//each column still gets its values in row order, so the results don't depend on the number of threads
+                    for (int64_t r = 0; r < numRead; ++r)
+                    {
+                        if (matchColumnMode && !(roiBlockScratch[r * numCols + i] > 0.0f)) continue;
+                        accums[i].add(blockScratch[r * numCols + i]);
+                    }
+                }
+            }
+            for (int64_t i = 0; i < numCols; ++i)
+            {
+                if (accums[i].getCount() == 0) throw OperationException("roi column is empty");
+                try
+                {
+                    myReduce.getResults(accums[i], results.data() + i * numResults);
+                } catch (CaretException& e) {
+                    throw OperationException(e);
+                }
+            }
+        } else {
+            myInput->convertToInMemory();//we will be getting all columns, so read it all in first
             if (matchColumnMode)
             {
-                roiCifti->getColumn(roiData.data(), i);
+                roiCifti->convertToInMemory();//ditto
             }
-            float result;
-            if (reduceOpt->m_present)
+#pragma omp CARET_PAR
             {
-                result = reduce(colScratch, myop, roiData);
-            } else {
-                CaretAssert(percentileOpt->m_present);
-                result = percentile(colScratch, percent, roiData);
+                vector<float> colScratch(colLength), roiColScratch;
+                if (matchColumnMode) roiColScratch.resize(colLength);
+#pragma omp CARET_FOR schedule(dynamic)
+                for (int64_t i = 0; i < numCols; ++i)
+                {
+                    try
+                    {
+                        myInput->getColumn(colScratch.data(), i);
+                        const float* roiPtr = NULL;
+                        if (matchColumnMode)
+                        {
+                            roiCifti->getColumn(roiColScratch.data(), i);
+                            roiPtr = roiColScratch.data();
+                        } else if (roiCifti != NULL) {
+                            roiPtr = roiData.data();
+                        }
+                        computeColumn(myReduce, colScratch.data(), colLength, roiPtr, results.data() + i * numResults);
+                    } catch (CaretException& e) {
+                        errors[i] = e.whatString();
+                    }
+                }
+            }
+            for (int64_t i = 0; i < numCols; ++i)
+            {
+                if (!errors[i].isEmpty()) throw OperationException(errors[i]);
             }
+        }
+        for (int64_t i = 0; i < numCols; ++i)
+        {
             if (showMapName)
             {
                 cout << AString::number(i + 1) << ": " << rowMap->getIndexName(i) << ": ";
             }
-            stringstream resultsstr;
-            resultsstr << setprecision(7) << result;
-            cout << resultsstr.str() << endl;
+            printResults(results.data() + i * numResults, numResults);
         }
     } else {
+        vector<float> colScratch(colLength), results(numResults);
         myInput->getColumn(colScratch.data(), useColumn);
         if (matchColumnMode)
         {
             roiCifti->getColumn(roiData.data(), useColumn);
         }
-        float result;
-        if (reduceOpt->m_present)
+        try
         {
-            result = reduce(colScratch, myop, roiData);
-        } else {
-            CaretAssert(percentileOpt->m_present);
-            result = percentile(colScratch, percent, roiData);
+            computeColumn(myReduce, colScratch.data(), colLength, (roiCifti == NULL ? NULL : roiData.data()), results.data());
+        } catch (CaretException& e) {
+            throw OperationException(e);
         }
         if (showMapName)
         {
             cout << AString::number(useColumn + 1) << ": " << rowMap->getIndexName(useColumn) << ": ";
         }
-        stringstream resultsstr;
-        resultsstr << setprecision(7) << result;
-        cout << resultsstr.str() << endl;
+        printResults(results.data(), numResults);
     }
 }
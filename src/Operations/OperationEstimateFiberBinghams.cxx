@@ -21,6 +21,7 @@
 #include "OperationEstimateFiberBinghams.h"
 #include "OperationException.h"
 
+#include "CaretOMP.h"
 #include "CiftiFile.h"
 #include "MathFunctions.h"
 #include "StructureEnum.h"
@@ -33,6 +34,124 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int64_t DEFAULT_SLAB_SLICES = 8;//enough voxels per block to keep the threads busy, while the block's rows stay small
+    
+    ///per-thread buffers, resized only when the number of samples changes
+    struct BinghamScratch
+    {
+        vector<Vector3D> m_samples;
+        vector<float> m_fSamples, m_xSamples, m_ySamples;
+        void resize(const int64_t& numSamples)
+        {
+            if ((int64_t)m_samples.size() == numSamples) return;
+            m_samples.resize(numSamples);
+            m_fSamples.resize(numSamples);
+            m_xSamples.resize(numSamples);
+            m_ySamples.resize(numSamples);
+        }
+    };
+    
+    void estimateBingham(float* binghamOut, const int64_t ijk[3], const int64_t& numSamples, const VolumeFile* f_samples, const VolumeFile* theta_samples,
+                             const VolumeFile* phi_samples, BinghamScratch& scratch)
+    {
+        scratch.resize(numSamples);
+        vector<Vector3D>& samples = scratch.m_samples;
+        vector<float>& fsamplearray = scratch.m_fSamples;//to do two-pass mean/stdev without using the VolumeFile function twice per sample
+        double accum = 0.0;
+        Vector3D accumvec;//initializes to the zero vector
+        for (int i = 0; i < numSamples; ++i)
+        {
+            fsamplearray[i] = f_samples->getValue(ijk, i);
+            accum += fsamplearray[i];
+            float theta = theta_samples->getValue(ijk, i);//these have already been checked to have the same number of bricks
+            float phi = phi_samples->getValue(ijk, i);
+            samples[i][0] = -sin(theta) * cos(phi);//NOTE: theta, phi are polar coordinates for a RADIOLOGICAL volume, so flip x so that +x = right
+            samples[i][1] = sin(theta) * sin(phi);//ignore the f values for directionality testing
+            samples[i][2] = cos(theta);//beware, samples may be the negative of other samples, BAS model doesn't care, and they may have restricted the samples to +z or something
+            if (i != 0)
+            {
+                if (accumvec.dot(samples[i]) < 0.0f)//invert the ones that have a negative dot product with the current accumulated vector, and hope the first samples don't have a spread of more than 90 degrees
+                {
+                    samples[i] = -samples[i];
+                }
+            }
+            accumvec += samples[i];
+        }
+        accumvec = accumvec.normal();//normalize the average direction, trust this to make all components in [-1, 1]
+        binghamOut[0] = accum / numSamples;//the mean value of f
+        accum = 0.0;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float temp = fsamplearray[i] - binghamOut[0];
+            accum += temp * temp;
+        }
+        binghamOut[1] = sqrt(accum / (numSamples - 1));//sample standard deviation
+        float theta = acos(accumvec[2]);//[0, pi]
+        float phi = atan2(accumvec[1], -accumvec[0]);//[-pi, pi] - NOTE: radiological polar strikes again
+        if (phi < 0.0f) phi += 2 * 3.14159265358979;//[0, 2pi]
+        binghamOut[2] = theta;
+        binghamOut[3] = phi;
+        Vector3D xhat, yhat;//vectors to project to the normal plane of the average direction, assuming psi=0
+        xhat[0] = cos(theta) * cos(phi);//more radiological polar to neurological euclidean stuff
+        xhat[1] = -cos(theta) * sin(phi);
+        xhat[2] = sin(theta);
+        yhat[0] = sin(phi);
+        yhat[1] = cos(phi);
+        yhat[2] = 0.0f;
+        vector<float>& x_samples = scratch.m_xSamples, &y_samples = scratch.m_ySamples;
+        float dist = -1.0f;
+        int end1 = -1, end2 = -1;
+        for (int i = 0; i < numSamples; ++i)//first endpoint is farthest from mean direction
+        {
+            x_samples[i] = samples[i].dot(xhat);
+            y_samples[i] = samples[i].dot(yhat);
+            float tempf = x_samples[i] * x_samples[i] + y_samples[i] * y_samples[i];
+            if (tempf > dist)
+            {
+                end1 = i;
+                dist = tempf;
+            }
+        }
+        dist = -1.0f;
+        for (int i = 0; i < numSamples; ++i)//second endpoint is farthest from first endpoint
+        {
+            float xdiff = x_samples[i] - x_samples[end1];
+            float ydiff = y_samples[i] - y_samples[end1];
+            float tempf = xdiff * xdiff + ydiff * ydiff;
+            if (tempf > dist)
+            {
+                end2 = i;
+                dist = tempf;
+            }
+        }//NOTE: the MAJOR axis of fanning is along y when psi = 0! ka > kb means kb is in the direction of more fanning
+        float psi = atan((x_samples[end2] - x_samples[end1]) / (y_samples[end2] - y_samples[end1]));//[-pi/2, pi/2] - TODO: check radiological psi orientation
+        if (!MathFunctions::isNumeric(psi))
+        {
+            const float LARGE_K = 1800.0f;//stdev of 1/60, typical maximum ka in a voxel is around 200
+            binghamOut[4] = LARGE_K;
+            binghamOut[5] = LARGE_K;
+            binghamOut[6] = 0;
+            return;
+        }
+        if (psi < 0) psi += 3.14159265358979;//[0, pi]
+        binghamOut[6] = psi;
+        double accumx = 0.0, accumy = 0.0;
+        for (int i = 0; i < numSamples; ++i)
+        {//rotate the samples through -psi on the plane to orient them to the axes
+            float newx = x_samples[i] * cos(psi) + y_samples[i] * -sin(psi);//NOTE: again, radiological psi?
+            float newy = x_samples[i] * sin(psi) + y_samples[i] * cos(psi);
+            accumx += newx * newx;//assume mean of zero, because we already chose the center of the distribution
+            accumy += newy * newy;
+        }
+        float ka = (numSamples - 1) / (2 * accumx);//convert variance to concentrations
+        float kb = (numSamples - 1) / (2 * accumy);//but they aren't negative
+        binghamOut[4] = ka;
+        binghamOut[5] = kb;
+    }
+}
+
 AString OperationEstimateFiberBinghams::getCommandSwitch()
 {
     return "-estimate-fiber-binghams";
@@ -57,6 +176,8 @@ OperationParameters* OperationEstimateFiberBinghams::getParameters()
     ret->addVolumeParameter(9, "merged_ph3samples", "fiber 3 phi samples");
     ret->addVolumeParameter(10, "label-volume", "volume of cifti structure labels");
     ret->addCiftiOutputParameter(11, "cifti-out", "output cifti fiber distributons file");
+    OptionalParameter* slabOpt = ret->createOptionalParameter(12, "-slab", "set the number of slices in each block of the volume");
+    slabOpt->addIntegerParameter(1, "slices", "number of slices along the third dimension in each block, default " + AString::number(DEFAULT_SLAB_SLICES));
     AString myText = AString("This command does an estimation of a bingham distribution for each fiber orientation in each voxel which is ") +
         "labeled a structure identifier.  These labelings come from the <label-volume> argument, which must have labels that match the following strings:\n";
     vector<StructureEnum::Enum> myStructureEnums;
@@ -65,6 +186,9 @@ OperationParameters* OperationEstimateFiberBinghams::getParameters()
     {
         myText += "\n" + StructureEnum::toName(myStructureEnums[i]);
     }
+    myText += "\n\nVoxels are estimated in parallel, and the output does not depend on the number of threads.  " +
+        AString("The volume is estimated in blocks of slices, which bounds the memory used for the voxel list and estimated rows of a block before they are added to the output.  ") +
+        "The sample volumes are always read entirely into memory, so -slab does not reduce the memory used by the inputs.";
     ret->setHelpText(myText);
     return ret;
 }
@@ -173,7 +297,7 @@ void OperationEstimateFiberBinghams::useParameters(OperationParameters* myParams
     {
         myXML.addVolumeModelToColumns(voxelLists[myiter->second], myiter->first);
     }
-    myXML.resetRowsToScalars(24);
+    myXML.resetRowsToScalars(NUM_ROW_VALUES);
     myXML.setMapNameForRowIndex(0, "x coord");
     myXML.setMapNameForRowIndex(1, "y coord");
     myXML.setMapNameForRowIndex(2, "z coord");
@@ -200,114 +324,81 @@ void OperationEstimateFiberBinghams::useParameters(OperationParameters* myParams
     myXML.setMapNameForRowIndex(23, "psi3");
     CiftiFile* myCifti = myParams->getOutputCifti(11);
     myCifti->setCiftiXML(myXML);
-    vector<CiftiVolumeMap> volMap;
-    CaretArray<float> temprow(24);
-    myXML.getVolumeMapForColumns(volMap);//we don't need to know which voxel is from which parcel
-    int64_t end = (int64_t)volMap.size();
-    for (int64_t i = 0; i < end; ++i)
+    vector<vector<voxelIndexType> >().swap(voxelLists);//the xml has the voxel lists now
+    int64_t slabSlices = DEFAULT_SLAB_SLICES;
+    OptionalParameter* slabOpt = myParams->getOptionalParameter(12);
+    if (slabOpt->m_present)
     {
-        myVolLabel->indexToSpace(volMap[i].m_ijk, temprow);//first three elements are the coordinates
-        estimateBingham(temprow.getArray() + 3, volMap[i].m_ijk, f1_samples, th1_samples, ph1_samples);
-        estimateBingham(temprow.getArray() + 10, volMap[i].m_ijk, f2_samples, th2_samples, ph2_samples);
-        estimateBingham(temprow.getArray() + 17, volMap[i].m_ijk, f3_samples, th3_samples, ph3_samples);
-        myCifti->setRow(temprow, volMap[i].m_ciftiIndex);
+        slabSlices = slabOpt->getInteger(1);
+        if (slabSlices < 1)
+        {
+            throw OperationException("-slab must be given a positive number of slices");
+        }
     }
-}
-
-void OperationEstimateFiberBinghams::estimateBingham(float* binghamOut, const int64_t ijk[3], const VolumeFile* f_samples, const VolumeFile* theta_samples, const VolumeFile* phi_samples)
-{
-    vector<int64_t> fdims;
-    f_samples->getDimensions(fdims);
-    vector<Vector3D> samples(fdims[3]);
-    vector<float> fsamplearray(fdims[3]);//to do two-pass mean/stdev without using the VolumeFile function twice per sample
-    double accum = 0.0;
-    Vector3D accumvec;//initializes to the zero vector
-    for (int i = 0; i < fdims[3]; ++i)
+    const VolumeFile* sampleVolumes[9] = { f1_samples, th1_samples, ph1_samples,
+                                           f2_samples, th2_samples, ph2_samples,
+                                           f3_samples, th3_samples, ph3_samples };
+    vector<int64_t> slabIJK, slabCiftiIndices;
+    vector<float> slabRows;
+    for (int64_t slabStart = 0; slabStart < mydims[2]; slabStart += slabSlices)
     {
-        fsamplearray[i] = f_samples->getValue(ijk, i);
-        accum += fsamplearray[i];
-        float theta = theta_samples->getValue(ijk, i);//these have already been checked to have the same number of bricks
-        float phi = phi_samples->getValue(ijk, i);
-        samples[i][0] = -sin(theta) * cos(phi);//NOTE: theta, phi are polar coordinates for a RADIOLOGICAL volume, so flip x so that +x = right
-        samples[i][1] = sin(theta) * sin(phi);//ignore the f values for directionality testing
-        samples[i][2] = cos(theta);//beware, samples may be the negative of other samples, BAS model doesn't care, and they may have restricted the samples to +z or something
-        if (i != 0)
-        {
-            if (accumvec.dot(samples[i]) < 0.0f)//invert the ones that have a negative dot product with the current accumulated vector, and hope the first samples don't have a spread of more than 90 degrees
+        int64_t slabEnd = slabStart + slabSlices;
+        if (slabEnd > mydims[2]) slabEnd = mydims[2];
+        slabIJK.clear();
+        slabCiftiIndices.clear();
+        int64_t ijk[3];
+        for (ijk[2] = slabStart; ijk[2] < slabEnd; ++ijk[2])
+        {//only the current block's voxels are listed
+            for (ijk[1] = 0; ijk[1] < mydims[1]; ++ijk[1])
             {
-                samples[i] = -samples[i];
+                for (ijk[0] = 0; ijk[0] < mydims[0]; ++ijk[0])
+                {
+                    int64_t ciftiIndex = myXML.getColumnIndexForVoxel(ijk);
+                    if (ciftiIndex < 0) continue;
+                    slabIJK.insert(slabIJK.end(), ijk, ijk + 3);
+                    slabCiftiIndices.push_back(ciftiIndex);
+                }
             }
         }
-        accumvec += samples[i];
-    }
-    accumvec = accumvec.normal();//normalize the average direction, trust this to make all components in [-1, 1]
-    binghamOut[0] = accum / fdims[3];//the mean value of f
-    accum = 0.0;
-    for (int i = 0; i < fdims[3]; ++i)
-    {
-        float temp = fsamplearray[i] - binghamOut[0];
-        accum += temp * temp;
-    }
-    binghamOut[1] = sqrt(accum / (fdims[3] - 1));//sample standard deviation
-    float theta = acos(accumvec[2]);//[0, pi]
-    float phi = atan2(accumvec[1], -accumvec[0]);//[-pi, pi] - NOTE: radiological polar strikes again
-    if (phi < 0.0f) phi += 2 * 3.14159265358979;//[0, 2pi]
-    binghamOut[2] = theta;
-    binghamOut[3] = phi;
-    Vector3D xhat, yhat;//vectors to project to the normal plane of the average direction, assuming psi=0
-    xhat[0] = cos(theta) * cos(phi);//more radiological polar to neurological euclidean stuff
-    xhat[1] = -cos(theta) * sin(phi);
-    xhat[2] = sin(theta);
-    yhat[0] = sin(phi);
-    yhat[1] = cos(phi);
-    yhat[2] = 0.0f;
-    vector<float> x_samples(fdims[3]), y_samples(fdims[3]);
-    float dist = -1.0f;
-    int end1 = -1, end2 = -1;
-    for (int i = 0; i < fdims[3]; ++i)//first endpoint is farthest from mean direction
-    {
-        x_samples[i] = samples[i].dot(xhat);
-        y_samples[i] = samples[i].dot(yhat);
-        float tempf = x_samples[i] * x_samples[i] + y_samples[i] * y_samples[i];
-        if (tempf > dist)
+        int64_t numVoxels = (int64_t)slabCiftiIndices.size();
+        if (numVoxels != 0)
         {
-            end1 = i;
-            dist = tempf;
+            slabRows.resize(numVoxels * NUM_ROW_VALUES);
+            estimateVoxelRows(sampleVolumes, myVolLabel, slabIJK, slabRows.data());
+            for (int64_t i = 0; i < numVoxels; ++i)
+            {//write serially, in voxel order
+                myCifti->setRow(slabRows.data() + i * NUM_ROW_VALUES, slabCiftiIndices[i]);
+            }
         }
+        myProgress.reportProgress((float)slabEnd / mydims[2]);
     }
-    dist = -1.0f;
-    for (int i = 0; i < fdims[3]; ++i)//second endpoint is farthest from first endpoint
-    {
-        float xdiff = x_samples[i] - x_samples[end1];
-        float ydiff = y_samples[i] - y_samples[end1];
-        float tempf = xdiff * xdiff + ydiff * ydiff;
-        if (tempf > dist)
-        {
-            end2 = i;
-            dist = tempf;
-        }
-    }//NOTE: the MAJOR axis of fanning is along y when psi = 0! ka > kb means kb is in the direction of more fanning
-    float psi = atan((x_samples[end2] - x_samples[end1]) / (y_samples[end2] - y_samples[end1]));//[-pi/2, pi/2] - TODO: check radiological psi orientation
-    if (!MathFunctions::isNumeric(psi))
+}
+
+void OperationEstimateFiberBinghams::estimateVoxelRows(const VolumeFile* const sampleVolumes[9], const VolumeFile* spaceVolume,
+                                                       const vector<int64_t>& voxelIJK, float* rowsOut)
+{
+    int64_t numVoxels = (int64_t)voxelIJK.size() / 3;
+    int64_t numSamples[3];
+    for (int fiber = 0; fiber < 3; ++fiber)
     {
-        const float LARGE_K = 1800.0f;//stdev of 1/60, typical maximum ka in a voxel is around 200
-        binghamOut[4] = LARGE_K;
-        binghamOut[5] = LARGE_K;
-        binghamOut[6] = 0;
-        return;
+        vector<int64_t> fdims;
+        sampleVolumes[fiber * 3]->getDimensions(fdims);
+        numSamples[fiber] = fdims[3];
     }
-    if (psi < 0) psi += 3.14159265358979;//[0, pi]
-    binghamOut[6] = psi;
-    double accumx = 0.0, accumy = 0.0;
-    for (int i = 0; i < fdims[3]; ++i)
-    {//rotate the samples through -psi on the plane to orient them to the axes
-        float newx = x_samples[i] * cos(psi) + y_samples[i] * -sin(psi);//NOTE: again, radiological psi?
-        float newy = x_samples[i] * sin(psi) + y_samples[i] * cos(psi);
-        accumx += newx * newx;//assume mean of zero, because we already chose the center of the distribution
-        accumy += newy * newy;
+#pragma omp CARET_PAR
+    {
+        BinghamScratch myScratch;
+#pragma omp CARET_FOR schedule(dynamic, 64)
+        for (int64_t v = 0; v < numVoxels; ++v)
+        {//each voxel only writes its own row, so the output doesn't depend on the number of threads
+            const int64_t* ijk = voxelIJK.data() + v * 3;
+            float* row = rowsOut + v * NUM_ROW_VALUES;
+            spaceVolume->indexToSpace(ijk, row);//first three elements are the coordinates
+            for (int fiber = 0; fiber < 3; ++fiber)
+            {
+                estimateBingham(row + 3 + fiber * 7, ijk, numSamples[fiber], sampleVolumes[fiber * 3],
+                                sampleVolumes[fiber * 3 + 1], sampleVolumes[fiber * 3 + 2], myScratch);
+            }
+        }
     }
-    float ka = (fdims[3] - 1) / (2 * accumx);//convert variance to concentrations
-    float kb = (fdims[3] - 1) / (2 * accumy);//but they aren't negative
-    binghamOut[4] = ka;
-    binghamOut[5] = kb;
 }
@@ -23,12 +23,18 @@
 
 #include "AbstractOperation.h"
 
+#include <vector>
+
 namespace caret {
     
     class OperationEstimateFiberBinghams : public AbstractOperation
     {
-        static void estimateBingham(float* binghamOut, const int64_t ijk[3], const caret::VolumeFile* f_samples, const caret::VolumeFile* theta_samples, const caret::VolumeFile* phi_samples);
     public:
+        ///values in each output row: coordinates, then mean f, stdev f, theta, phi, ka, kb, psi for each fiber
+        static const int NUM_ROW_VALUES = 24;
+        ///sampleVolumes are the f, theta, phi samples of fibers 1 to 3, voxelIJK has 3 indices per voxel, rowsOut gets NUM_ROW_VALUES per voxel
+        static void estimateVoxelRows(const caret::VolumeFile* const sampleVolumes[9], const caret::VolumeFile* spaceVolume,
+                                      const std::vector<int64_t>& voxelIJK, float* rowsOut);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
@@ -21,7 +21,9 @@
 #include "OperationMetricStats.h"
 #include "OperationException.h"
 
+#include "CaretOMP.h"
 #include "MetricFile.h"
+#include "MultiReduction.h"
 #include "ReductionOperation.h"
 
 #include <algorithm>
@@ -50,10 +52,10 @@ OperationParameters* OperationMetricStats::getParameters()
     
     ret->addMetricParameter(1, "metric-in", "the input metric");
     
-    OptionalParameter* reduceOpt = ret->createOptionalParameter(2, "-reduce", "use a reduction operation");
+    ParameterComponent* reduceOpt = ret->createRepeatableParameter(2, "-reduce", "use a reduction operation");
     reduceOpt->addStringParameter(1, "operation", "the reduction operation");
     
-    OptionalParameter* percentileOpt = ret->createOptionalParameter(3, "-percentile", "give the value at a percentile");
+    ParameterComponent* percentileOpt = ret->createRepeatableParameter(3, "-percentile", "give the value at a percentile");
     percentileOpt->addDoubleParameter(1, "percent", "the percentile to find");
     
     OptionalParameter* columnOpt = ret->createOptionalParameter(4, "-column", "only display output for one column");
@@ -66,10 +68,11 @@ OperationParameters* OperationMetricStats::getParameters()
     ret->createOptionalParameter(6, "-show-map-name", "print map index and name before each output");
     
     ret->setHelpText(
-        AString("For each column of the input, a single number is printed, resulting from the specified reduction or percentile operation.  ") +
+        AString("For each column of the input, a line is printed containing the results of the specified reduction and percentile operations, separated by spaces.  ") +
         "Use -column to only give output for a single column.  " +
         "Use -roi to consider only the data within a region.  " +
-        "Exactly one of -reduce or -percentile must be specified.\n\n" +
+        "At least one -reduce or -percentile must be specified, and both options may be repeated.  " +
+        "Results are printed with all -reduce operations first, in the order given, followed by all -percentile operations, in the order given.\n\n" +
         "The argument to the -reduce option must be one of the following:\n\n" +
         ReductionOperation::getHelpInfo());
     return ret;
@@ -77,15 +80,15 @@ OperationParameters* OperationMetricStats::getParameters()
 
 namespace
 {
-    float reduce(const float* data, const int& numNodes, const ReductionEnum::Enum& myop, const float* roiData)
+    void computeMap(const MultiReduction& myReduce, const float* data, const int64_t& numElements, const float* roiData, float* resultsOut)
     {
         if (roiData == NULL)
         {
-            return ReductionOperation::reduce(data, numNodes, myop);
+            myReduce.compute(data, numElements, resultsOut);
         } else {
             vector<float> toUse;
-            toUse.reserve(numNodes);
-            for (int i = 0; i < numNodes; ++i)
+            toUse.reserve(numElements);
+            for (int64_t i = 0; i < numElements; ++i)
             {
                 if (roiData[i] > 0.0f)
                 {
@@ -93,35 +96,20 @@ namespace
                 }
             }
             if (toUse.empty()) throw OperationException("roi contains no vertices");
-            return ReductionOperation::reduce(toUse.data(), toUse.size(), myop);
+            myReduce.compute(toUse.data(), toUse.size(), resultsOut);
         }
     }
     
-    float percentile(const float* data, const int& numNodes, const float& percent, const float* roiData)
+    void printResults(const float* results, const int& numResults)
     {
-        CaretAssert(percent >= 0.0f && percent <= 100.0f);
-        vector<float> toUse;
-        if (roiData == NULL)
+        stringstream resultsstr;
+        resultsstr << setprecision(7);
+        for (int i = 0; i < numResults; ++i)
         {
-            toUse = vector<float>(data, data + numNodes);
-        } else {
-            toUse.reserve(numNodes);
-            for (int i = 0; i < numNodes; ++i)
-            {
-                if (roiData[i] > 0.0f)
-                {
-                    toUse.push_back(data[i]);
-                }
-            }
+            if (i != 0) resultsstr << " ";
+            resultsstr << results[i];
         }
-        if (toUse.empty()) throw OperationException("roi contains no vertices");
-        sort(toUse.begin(), toUse.end());
-        const float index = percent / 100.0f * (toUse.size() - 1);
-        if (index <= 0) return toUse[0];
-        if (index >= toUse.size() - 1) return toUse.back();
-        float ipart, fpart;
-        fpart = modf(index, &ipart);
-        return (1.0f - fpart) * toUse[(int)ipart] + fpart * toUse[((int)ipart) + 1];
+        cout << resultsstr.str() << endl;
     }
 }
 
@@ -131,25 +119,27 @@ void OperationMetricStats::useParameters(OperationParameters* myParams, Progress
     MetricFile* input = myParams->getMetric(1);
     int numNodes = input->getNumberOfNodes();
     int numCols = input->getNumberOfColumns();
-    OptionalParameter* reduceOpt = myParams->getOptionalParameter(2);
-    OptionalParameter* percentileOpt = myParams->getOptionalParameter(3);
-    if (reduceOpt->m_present == percentileOpt->m_present)//use == as logical xor
+    const vector<ParameterComponent*>& reduceInstances = *(myParams->getRepeatableParameterInstances(2));
+    const vector<ParameterComponent*>& percentileInstances = *(myParams->getRepeatableParameterInstances(3));
+    if (reduceInstances.empty() && percentileInstances.empty())
     {
-        throw OperationException("you must use exactly one of -reduce or -percentile");
+        throw OperationException("you must specify at least one -reduce or -percentile");
     }
-    ReductionEnum::Enum myop = ReductionEnum::INVALID;
-    if (reduceOpt->m_present)
+    MultiReduction myReduce;
+    for (int i = 0; i < (int)reduceInstances.size(); ++i)
     {
         bool ok = false;
-        myop = ReductionEnum::fromName(reduceOpt->getString(1), &ok);
-        if (!ok) throw OperationException("unrecognized reduction operation: " + reduceOpt->getString(1));
+        ReductionEnum::Enum myop = ReductionEnum::fromName(reduceInstances[i]->getString(1), &ok);
+        if (!ok) throw OperationException("unrecognized reduction operation: " + reduceInstances[i]->getString(1));
+        myReduce.addReduction(myop);
     }
-    float percent = 0.0f;
-    if (percentileOpt->m_present)
+    for (int i = 0; i < (int)percentileInstances.size(); ++i)
     {
-        percent = (float)percentileOpt->getDouble(1);//use not within range to trap NaNs, just in case
+        float percent = (float)percentileInstances[i]->getDouble(1);//use not within range to trap NaNs, just in case
         if (!(percent >= 0.0f && percent <= 100.0f)) throw OperationException("percentile must be between 0 and 100");
+        myReduce.addPercentile(percent);
     }
+    const int numResults = myReduce.getNumberOfResults();
     int column = -1;
     OptionalParameter* columnOpt = myParams->getOptionalParameter(4);
     if (columnOpt->m_present)
@@ -179,55 +169,42 @@ void OperationMetricStats::useParameters(OperationParameters* myParams, Progress
     bool showMapName = myParams->getOptionalParameter(6)->m_present;
     if (column == -1)
     {
-        if (reduceOpt->m_present)
+        vector<float> results(numCols * numResults);
+        vector<AString> errors(numCols);//exceptions can't leave an omp region, so collect them and throw afterwards
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int i = 0; i < numCols; ++i)
         {
-            for (int i = 0; i < numCols; ++i)
-            {//store result before printing anything, in case it throws while computing
-                if (matchColumnMode)
-                {
-                    roiData = myRoi->getValuePointerForColumn(i);
-                }
-                const float result = reduce(input->getValuePointerForColumn(i), numNodes, myop, roiData);
-                if (showMapName) cout << AString::number(i + 1) << ": " << input->getMapName(i) << ": ";
-                stringstream resultsstr;
-                resultsstr << setprecision(7) << result;
-                cout << resultsstr.str() << endl;
-            }
-        } else {
-            CaretAssert(percentileOpt->m_present);
-            for (int i = 0; i < numCols; ++i)
-            {//store result before printing anything, in case it throws while computing
-                if (matchColumnMode)
-                {
-                    roiData = myRoi->getValuePointerForColumn(i);
-                }
-                const float result = percentile(input->getValuePointerForColumn(i), numNodes, percent, roiData);
-                if (showMapName) cout << AString::number(i + 1) << ": " << input->getMapName(i) << ": ";
-                stringstream resultsstr;
-                resultsstr << setprecision(7) << result;
-                cout << resultsstr.str() << endl;
+            try
+            {
+                const float* useRoi = (matchColumnMode ? myRoi->getValuePointerForColumn(i) : roiData);
+                computeMap(myReduce, input->getValuePointerForColumn(i), numNodes, useRoi, results.data() + i * numResults);
+            } catch (CaretException& e) {
+                errors[i] = e.whatString();
             }
         }
+        for (int i = 0; i < numCols; ++i)
+        {
+            if (!errors[i].isEmpty()) throw OperationException(errors[i]);
+        }
+        for (int i = 0; i < numCols; ++i)
+        {
+            if (showMapName) cout << AString::number(i + 1) << ": " << input->getMapName(i) << ": ";
+            printResults(results.data() + i * numResults, numResults);
+        }
     } else {
         CaretAssert(column >= 0 && column < numCols);
         if (matchColumnMode)
         {
             roiData = myRoi->getValuePointerForColumn(column);
         }
-        if (reduceOpt->m_present)
+        vector<float> results(numResults);
+        try
         {
-            const float result = reduce(input->getValuePointerForColumn(column), numNodes, myop, roiData);
-            if (showMapName) cout << AString::number(column + 1) << ": " << input->getMapName(column) << ": ";
-            stringstream resultsstr;
-            resultsstr << setprecision(7) << result;
-            cout << resultsstr.str() << endl;
-        } else {
-            CaretAssert(percentileOpt->m_present);
-            const float result = percentile(input->getValuePointerForColumn(column), numNodes, percent, roiData);
-            if (showMapName) cout << AString::number(column + 1) << ": " << input->getMapName(column) << ": ";
-            stringstream resultsstr;
-            resultsstr << setprecision(7) << result;
-            cout << resultsstr.str() << endl;
+            computeMap(myReduce, input->getValuePointerForColumn(column), numNodes, roiData, results.data());
+        } catch (CaretException& e) {
+            throw OperationException(e);
         }
+        if (showMapName) cout << AString::number(column + 1) << ": " << input->getMapName(column) << ": ";
+        printResults(results.data(), numResults);
     }
 }
@@ -227,7 +227,14 @@ OperationShowScene::useParameters(OperationParameters* myParams,
     /*
      * Restore the scene
      */
+    AString deferredErrorMessage;
+    if (scene->loadDeferredContent(deferredErrorMessage) == false) {
+        throw OperationException(deferredErrorMessage);
+    }
     const SceneClass* guiManagerClass = scene->getClassWithName("guiManager");
+    if (guiManagerClass == NULL) {
+        throw OperationException("Scene is missing the guiManager class");
+    }
     if (guiManagerClass->getName() != "guiManager") {
         throw OperationException("Top level scene class should be guiManager but it is: "
                                  + guiManagerClass->getName());
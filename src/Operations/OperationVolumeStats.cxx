@@ -21,6 +21,8 @@
 #include "OperationVolumeStats.h"
 #include "OperationException.h"
 
+#include "CaretOMP.h"
+#include "MultiReduction.h"
 #include "ReductionOperation.h"
 #include "VolumeFile.h"
 
@@ -50,10 +52,10 @@ OperationParameters* OperationVolumeStats::getParameters()
     
     ret->addVolumeParameter(1, "volume-in", "the input volume");
     
-    OptionalParameter* reduceOpt = ret->createOptionalParameter(2, "-reduce", "use a reduction operation");
+    ParameterComponent* reduceOpt = ret->createRepeatableParameter(2, "-reduce", "use a reduction operation");
     reduceOpt->addStringParameter(1, "operation", "the reduction operation");
     
-    OptionalParameter* percentileOpt = ret->createOptionalParameter(3, "-percentile", "give the value at a percentile");
+    ParameterComponent* percentileOpt = ret->createRepeatableParameter(3, "-percentile", "give the value at a percentile");
     percentileOpt->addDoubleParameter(1, "percent", "the percentile to find");
     
     OptionalParameter* subvolOpt = ret->createOptionalParameter(4, "-subvolume", "only display output for one subvolume");
@@ -66,10 +68,11 @@ OperationParameters* OperationVolumeStats::getParameters()
     ret->createOptionalParameter(6, "-show-map-name", "print map index and name before each output");
     
     ret->setHelpText(
-        AString("For each subvolume of the input, a single number is printed, resulting from the specified reduction or percentile operation.  ") +
+        AString("For each subvolume of the input, a line is printed containing the results of the specified reduction and percentile operations, separated by spaces.  ") +
         "Use -subvolume to only give output for a single subvolume.  " +
         "Use -roi to consider only the data within a region.  " +
-        "Exactly one of -reduce or -percentile must be specified.\n\n" +
+        "At least one -reduce or -percentile must be specified, and both options may be repeated.  " +
+        "Results are printed with all -reduce operations first, in the order given, followed by all -percentile operations, in the order given.\n\n" +
         "The argument to the -reduce option must be one of the following:\n\n" +
         ReductionOperation::getHelpInfo());
     return ret;
@@ -77,11 +80,11 @@ OperationParameters* OperationVolumeStats::getParameters()
 
 namespace
 {
-    float reduce(const float* data, const int64_t& numElements, const ReductionEnum::Enum& myop, const float* roiData)
+    void computeMap(const MultiReduction& myReduce, const float* data, const int64_t& numElements, const float* roiData, float* resultsOut)
     {
         if (roiData == NULL)
         {
-            return ReductionOperation::reduce(data, numElements, myop);
+            myReduce.compute(data, numElements, resultsOut);
         } else {
             vector<float> toUse;
             toUse.reserve(numElements);
@@ -93,35 +96,20 @@ namespace
                 }
             }
             if (toUse.empty()) throw OperationException("roi contains no voxels");
-            return ReductionOperation::reduce(toUse.data(), toUse.size(), myop);
+            myReduce.compute(toUse.data(), toUse.size(), resultsOut);
         }
     }
     
-    float percentile(const float* data, const int64_t& numElements, const float& percent, const float* roiData)
+    void printResults(const float* results, const int& numResults)
     {
-        CaretAssert(percent >= 0.0f && percent <= 100.0f);
-        vector<float> toUse;
-        if (roiData == NULL)
+        stringstream resultsstr;
+        resultsstr << setprecision(7);
+        for (int i = 0; i < numResults; ++i)
         {
-            toUse = vector<float>(data, data + numElements);
-        } else {
-            toUse.reserve(numElements);
-            for (int64_t i = 0; i < numElements; ++i)
-            {
-                if (roiData[i] > 0.0f)
-                {
-                    toUse.push_back(data[i]);
-                }
-            }
+            if (i != 0) resultsstr << " ";
+            resultsstr << results[i];
         }
-        if (toUse.empty()) throw OperationException("roi contains no voxels");
-        sort(toUse.begin(), toUse.end());
-        const double index = percent / 100.0f * (toUse.size() - 1);
-        if (index <= 0) return toUse[0];
-        if (index >= toUse.size() - 1) return toUse.back();
-        double ipart, fpart;
-        fpart = modf(index, &ipart);
-        return (1.0f - fpart) * toUse[(int64_t)ipart] + fpart * toUse[((int64_t)ipart) + 1];
+        cout << resultsstr.str() << endl;
     }
 }
 
@@ -132,25 +120,27 @@ void OperationVolumeStats::useParameters(OperationParameters* myParams, Progress
     vector<int64_t> dims = input->getDimensions();
     const int64_t frameSize = dims[0] * dims[1] * dims[2];
     if (input->getNumberOfComponents() != 1) throw OperationException("multi-component volumes are not supported in -volume-stats");
-    OptionalParameter* reduceOpt = myParams->getOptionalParameter(2);
-    OptionalParameter* percentileOpt = myParams->getOptionalParameter(3);
-    if (reduceOpt->m_present == percentileOpt->m_present)//use == as logical xnor
+    const vector<ParameterComponent*>& reduceInstances = *(myParams->getRepeatableParameterInstances(2));
+    const vector<ParameterComponent*>& percentileInstances = *(myParams->getRepeatableParameterInstances(3));
+    if (reduceInstances.empty() && percentileInstances.empty())
     {
-        throw OperationException("you must use exactly one of -reduce or -percentile");
+        throw OperationException("you must specify at least one -reduce or -percentile");
     }
-    ReductionEnum::Enum myop = ReductionEnum::INVALID;
-    if (reduceOpt->m_present)
+    MultiReduction myReduce;
+    for (int i = 0; i < (int)reduceInstances.size(); ++i)
     {
         bool ok = false;
-        myop = ReductionEnum::fromName(reduceOpt->getString(1), &ok);
-        if (!ok) throw OperationException("unrecognized reduction operation: " + reduceOpt->getString(1));
+        ReductionEnum::Enum myop = ReductionEnum::fromName(reduceInstances[i]->getString(1), &ok);
+        if (!ok) throw OperationException("unrecognized reduction operation: " + reduceInstances[i]->getString(1));
+        myReduce.addReduction(myop);
     }
-    float percent = 0.0f;
-    if (percentileOpt->m_present)
+    for (int i = 0; i < (int)percentileInstances.size(); ++i)
     {
-        percent = (float)percentileOpt->getDouble(1);//use not within range to trap NaNs, just in case
+        float percent = (float)percentileInstances[i]->getDouble(1);//use not within range to trap NaNs, just in case
         if (!(percent >= 0.0f && percent <= 100.0f)) throw OperationException("percentile must be between 0 and 100");
+        myReduce.addPercentile(percent);
     }
+    const int numResults = myReduce.getNumberOfResults();
     int subvol = -1;
     OptionalParameter* subvolOpt = myParams->getOptionalParameter(4);
     if (subvolOpt->m_present)
@@ -181,55 +171,42 @@ void OperationVolumeStats::useParameters(OperationParameters* myParams, Progress
     int numMaps = input->getNumberOfMaps();
     if (subvol == -1)
     {
-        if (reduceOpt->m_present)
+        vector<float> results(numMaps * numResults);
+        vector<AString> errors(numMaps);//exceptions can't leave an omp region, so collect them and throw afterwards
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int i = 0; i < numMaps; ++i)
         {
-            for (int i = 0; i < numMaps; ++i)
-            {//store result before printing anything, in case it throws while computing
-                if (matchSubvolMode)
-                {
-                    roiData = myRoi->getFrame(i);
-                }
-                const float result = reduce(input->getFrame(i), frameSize, myop, roiData);
-                if (showMapName) cout << AString::number(i + 1) << ": " << input->getMapName(i) << ": ";
-                stringstream resultsstr;
-                resultsstr << setprecision(7) << result;
-                cout << resultsstr.str() << endl;
-            }
-        } else {
-            CaretAssert(percentileOpt->m_present);
-            for (int i = 0; i < numMaps; ++i)
-            {//store result before printing anything, in case it throws while computing
-                if (matchSubvolMode)
-                {
-                    roiData = myRoi->getFrame(i);
-                }
-                const float result = percentile(input->getFrame(i), frameSize, percent, roiData);
-                if (showMapName) cout << AString::number(i + 1) << ": " << input->getMapName(i) << ": ";
-                stringstream resultsstr;
-                resultsstr << setprecision(7) << result;
-                cout << resultsstr.str() << endl;
+            try
+            {
+                const float* useRoi = (matchSubvolMode ? myRoi->getFrame(i) : roiData);
+                computeMap(myReduce, input->getFrame(i), frameSize, useRoi, results.data() + i * numResults);
+            } catch (CaretException& e) {
+                errors[i] = e.whatString();
             }
         }
+        for (int i = 0; i < numMaps; ++i)
+        {
+            if (!errors[i].isEmpty()) throw OperationException(errors[i]);
+        }
+        for (int i = 0; i < numMaps; ++i)
+        {
+            if (showMapName) cout << AString::number(i + 1) << ": " << input->getMapName(i) << ": ";
+            printResults(results.data() + i * numResults, numResults);
+        }
     } else {
         CaretAssert(subvol >= 0 && subvol < numMaps);
         if (matchSubvolMode)
         {
             roiData = myRoi->getFrame(subvol);
         }
-        if (reduceOpt->m_present)
+        vector<float> results(numResults);
+        try
         {
-            const float result = reduce(input->getFrame(subvol), frameSize, myop, roiData);
-            if (showMapName) cout << AString::number(subvol + 1) << ": " << input->getMapName(subvol) << ": ";
-            stringstream resultsstr;
-            resultsstr << setprecision(7) << result;
-            cout << resultsstr.str() << endl;
-        } else {
-            CaretAssert(percentileOpt->m_present);
-            const float result = percentile(input->getFrame(subvol), frameSize, percent, roiData);
-            if (showMapName) cout << AString::number(subvol + 1) << ": " << input->getMapName(subvol) << ": ";
-            stringstream resultsstr;
-            resultsstr << setprecision(7) << result;
-            cout << resultsstr.str() << endl;
+            computeMap(myReduce, input->getFrame(subvol), frameSize, roiData, results.data());
+        } catch (CaretException& e) {
+            throw OperationException(e);
         }
+        if (showMapName) cout << AString::number(subvol + 1) << ": " << input->getMapName(subvol) << ": ";
+        printResults(results.data(), numResults);
     }
 }
@@ -18,7 +18,10 @@
  */
 /*LICENSE_END*/
 
+#include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CaretPointer.h"
 #include "DataFile.h"
 #include "EventManager.h"
 #include "EventProgressUpdate.h"
@@ -36,9 +39,14 @@
 #include "quazipfile.h"
 
 #include <QDir>
+#include <QFileInfo>
+#include <QTemporaryFile>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <set>
+#include <vector>
 
 using namespace caret;
 using namespace std;
@@ -67,7 +75,8 @@ OperationParameters* OperationZipSceneFile::getParameters()
 
     ret->setHelpText("If zip-file already exists, it will be overwritten.  "
         "If -base-dir is not specified, the directory containing the scene file is used for the base directory.  "
-        "The scene file must contain only relative paths, and no data files may be outside the base directory.");
+        "The scene file must contain only relative paths, and no data files may be outside the base directory.  "
+        "Files that are already compressed (.gz, images) are stored without recompressing them, so they can be read directly from the zip file.");
     return ret;
 }
 
@@ -141,6 +150,11 @@ void OperationZipSceneFile::createZipFile(const AString& sceneFileName,
     {
         Scene* thisScene = sceneFile.getSceneAtIndex(i);
         SceneAttributes* myAttrs = thisScene->getAttributes();
+        AString deferredErrorMessage;
+        if (!thisScene->loadDeferredContent(deferredErrorMessage))
+        {
+            throw OperationException(deferredErrorMessage);
+        }
         const SceneClass* guiMgrClass = thisScene->getClassWithName("guiManager");
         if (guiMgrClass == NULL)
         {
@@ -197,95 +211,297 @@ void OperationZipSceneFile::createZipFile(const AString& sceneFileName,
             }
         }
     }
-    EventProgressUpdate progressEvent(0, allFiles.size(), 0, "Creating ZIP File");
-    EventManager::get()->sendEvent(progressEvent.getPointer());
+    vector<AString> dataFileNames(allFiles.begin(), allFiles.end());
+    vector<AString> memberNames;
+    for (vector<AString>::iterator iter = dataFileNames.begin(); iter != dataFileNames.end(); ++iter)
+    {
+        memberNames.push_back(outputSubDirectory + "/" + iter->mid(myBaseDir.size()));//we know the string matches to the length of myBaseDir, and is cleaned, so we can just chop the right number of characters off
+    }
+    writeZipFile(zipFileName, dataFileNames, memberNames, progressMode);
+}
 
-    QFile zipFileObject(zipFileName);
-    QuaZip zipFile(&zipFileObject);
-    if (!zipFile.open(QuaZip::mdCreate))
+namespace
+{
+    //members at or above this size are compressed to a temporary file instead of memory
+    const qint64 ZIP_SPILL_SIZE = 64 * 1024 * 1024;
+    const qint64 ZIP_BUFFER_SIZE = 1024 * 1024;
+    
+    struct ZipMemberJob
     {
-        throw OperationException("Unable to open ZIP File \""
-                                 + zipFileName
-                                 + "\" for writing.");
+        AString m_sourceName, m_memberName, m_error;
+        qint64 m_size, m_uncompressedSize;
+        bool m_store, m_sequential;
+        uLong m_crc;
+        vector<char> m_compressed;
+        CaretPointer<QTemporaryFile> m_spillFile;
+        ZipMemberJob() : m_size(0), m_uncompressedSize(0), m_store(false), m_sequential(false), m_crc(0) { }
+    };
+    
+    //deflate gains nothing on these, so they are stored as-is
+    bool isAlreadyCompressed(const AString& fileName)
+    {
+        static const char* storeExtensions[] = { ".gz", ".zip", ".bz2", ".xz", ".zst", ".png", ".jpg", ".jpeg", ".gif" };
+        const int numExtensions = sizeof(storeExtensions) / sizeof(storeExtensions[0]);
+        for (int i = 0; i < numExtensions; ++i)
+        {
+            if (fileName.endsWith(storeExtensions[i], Qt::CaseInsensitive)) return true;
+        }
+        return false;
     }
-    int32_t fileIndex = 1;
-    static const char *myUnits[9] = {" B    ", " KB", " MB", " GB", " TB", " PB", " EB", " ZB", " YB"};
-    for (set<AString>::iterator iter = allFiles.begin(); iter != allFiles.end(); ++iter, ++fileIndex)
+    
+    void appendCompressed(ZipMemberJob& job, const char* data, const qint64 count)
     {
-        AString dataFileName = *iter;
-        AString unzippedDataFileName = outputSubDirectory + "/" + dataFileName.mid(myBaseDir.size());//we know the string matches to the length of myBaseDir, and is cleaned, so we can just chop the right number of characters off
-        QFile dataFileIn(dataFileName);
-        if (!dataFileIn.open(QFile::ReadOnly)) {
-            throw OperationException("Unable to open \"" + dataFileName + "\" for reading: " + dataFileIn.errorString());
+        if (count == 0) return;
+        if (job.m_spillFile != NULL)
+        {
+            if (job.m_spillFile->write(data, count) != count)
+            {
+                job.m_error = "Error writing to temporary file for \"" + job.m_sourceName + "\": " + job.m_spillFile->errorString();
+            }
+        } else {
+            job.m_compressed.insert(job.m_compressed.end(), data, data + count);
         }
-        float fileSize = (float)dataFileIn.size();
-        int unit = 0;
-        while (unit < 8 && fileSize >= 1000.0f)//don't let there be 4 digits to the left of decimal point
+    }
+    
+    //runs in worker threads, so it reports errors through the job instead of throwing
+    void compressMember(ZipMemberJob& job, const AString& spillTemplate)
+    {
+        QFile dataFileIn(job.m_sourceName);
+        if (!dataFileIn.open(QFile::ReadOnly))
         {
-            ++unit;
-            fileSize /= 1000.0f;//use GB and friends, not GiB
+            job.m_error = "Unable to open \"" + job.m_sourceName + "\" for reading: " + dataFileIn.errorString();
+            return;
         }
-        switch (progressMode) {
-            case PROGRESS_COMMAND_LINE:
-                if (unit > 0)
+        if (job.m_size >= ZIP_SPILL_SIZE)
+        {
+            job.m_spillFile.grabNew(new QTemporaryFile(spillTemplate));
+            if (!job.m_spillFile->open())
+            {
+                job.m_error = "Unable to create temporary file for \"" + job.m_sourceName + "\": " + job.m_spillFile->errorString();
+                return;
+            }
+        }
+        z_stream myStream;
+        memset(&myStream, 0, sizeof(myStream));
+        if (deflateInit2(&myStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)//raw deflate, quazip writes the headers
+        {
+            job.m_error = "Unable to initialize compression for \"" + job.m_sourceName + "\"";
+            return;
+        }
+        vector<char> inBuffer(ZIP_BUFFER_SIZE), outBuffer(ZIP_BUFFER_SIZE);
+        uLong crc = crc32(0L, Z_NULL, 0);
+        qint64 totalRead = 0;
+        bool finished = false;
+        while (!finished && job.m_error.isEmpty())
+        {
+            const qint64 numRead = dataFileIn.read(inBuffer.data(), ZIP_BUFFER_SIZE);
+            if (numRead < 0)
+            {
+                job.m_error = "Error reading from data file \"" + job.m_sourceName + "\"";
+                break;
+            }
+            totalRead += numRead;
+            finished = dataFileIn.atEnd();
+            crc = crc32(crc, (const Bytef*)inBuffer.data(), (uInt)numRead);
+            myStream.next_in = (Bytef*)inBuffer.data();
+            myStream.avail_in = (uInt)numRead;
+            const int flush = (finished ? Z_FINISH : Z_NO_FLUSH);
+            do
+            {
+                myStream.next_out = (Bytef*)outBuffer.data();
+                myStream.avail_out = (uInt)ZIP_BUFFER_SIZE;
+                if (deflate(&myStream, flush) == Z_STREAM_ERROR)
                 {
-                    cout << AString::number(fileSize, 'f', 2);
-                } else {
-                    cout << AString::number(fileSize);
+                    job.m_error = "Error compressing \"" + job.m_sourceName + "\"";
+                    break;
                 }
-                cout << myUnits[unit] << "     \t" << unzippedDataFileName;
-                cout.flush();//don't endl until it finishes
-                break;
-            case PROGRESS_GUI_EVENT:
-                progressEvent.setProgress(fileIndex,
-                                          ("Adding "
-                                           + (QString::number(fileIndex) + " of " + QString::number(allFiles.size()) + " (")
-                                           + ((unit > 0) ? AString::number(fileSize, 'f', 2) : AString::number(fileSize))
-                                           + myUnits[unit]
-                                           + ") "
-                                           + FileInformation(unzippedDataFileName).getFileName()));
-                EventManager::get()->sendEvent(progressEvent.getPointer());
-                break;
+                appendCompressed(job, outBuffer.data(), ZIP_BUFFER_SIZE - myStream.avail_out);
+            } while (myStream.avail_out == 0 && job.m_error.isEmpty());
+        }
+        deflateEnd(&myStream);
+        job.m_crc = crc;
+        job.m_uncompressedSize = totalRead;
+        if (job.m_spillFile != NULL && job.m_error.isEmpty())
+        {
+            job.m_spillFile->flush();
+            job.m_spillFile->seek(0);
         }
-        
-        QuaZipNewInfo zipNewInfo(unzippedDataFileName,
-                                 dataFileName);
+    }
+    
+    void writeCompressedMember(QuaZip& zipFile, ZipMemberJob& job)
+    {
+        QuaZipNewInfo zipNewInfo(job.m_memberName, job.m_sourceName);
         zipNewInfo.externalAttr |= (6 << 22L) | (6 << 19L) | (4 << 16L);//make permissions 664
-        
+        zipNewInfo.uncompressedSize = job.m_uncompressedSize;//raw mode needs the sizes and crc up front
         QuaZipFile dataFileOut(&zipFile);
-        if (!dataFileOut.open(QIODevice::WriteOnly, zipNewInfo)) {
-            throw OperationException("Unable to open zip output for \"" + dataFileName + "\"");
+        if (!dataFileOut.open(QIODevice::WriteOnly, zipNewInfo, NULL, job.m_crc, Z_DEFLATED, Z_DEFAULT_COMPRESSION, true))
+        {
+            throw OperationException("Unable to open zip output for \"" + job.m_sourceName + "\"");
+        }
+        if (job.m_spillFile != NULL)
+        {
+            vector<char> buffer(ZIP_BUFFER_SIZE);
+            while (!job.m_spillFile->atEnd())
+            {
+                const qint64 numRead = job.m_spillFile->read(buffer.data(), ZIP_BUFFER_SIZE);
+                if (numRead < 0) throw OperationException("Error reading temporary file for \"" + job.m_sourceName + "\"");
+                if (dataFileOut.write(buffer.data(), numRead) != numRead) throw OperationException("Error writing to zip file");
+            }
+        } else if (!job.m_compressed.empty()) {
+            const qint64 count = (qint64)job.m_compressed.size();
+            if (dataFileOut.write(job.m_compressed.data(), count) != count) throw OperationException("Error writing to zip file");
         }
-        
-        const qint64 BUFFER_SIZE = 1024 * 1024;
-        vector<char> buffer(BUFFER_SIZE);
-        
-        while (dataFileIn.atEnd() == false) {
-            const qint64 numRead = dataFileIn.read(buffer.data(), BUFFER_SIZE);
+        dataFileOut.close();
+    }
+    
+    //stored members and members too large for the raw size field go through quazip's own stream
+    void writeStreamedMember(QuaZip& zipFile, const ZipMemberJob& job)
+    {
+        QFile dataFileIn(job.m_sourceName);
+        if (!dataFileIn.open(QFile::ReadOnly))
+        {
+            throw OperationException("Unable to open \"" + job.m_sourceName + "\" for reading: " + dataFileIn.errorString());
+        }
+        QuaZipNewInfo zipNewInfo(job.m_memberName, job.m_sourceName);
+        zipNewInfo.externalAttr |= (6 << 22L) | (6 << 19L) | (4 << 16L);//make permissions 664
+        QuaZipFile dataFileOut(&zipFile);
+        const int method = (job.m_store ? 0 : Z_DEFLATED), level = (job.m_store ? 0 : Z_DEFAULT_COMPRESSION);
+        if (!dataFileOut.open(QIODevice::WriteOnly, zipNewInfo, NULL, 0, method, level))
+        {
+            throw OperationException("Unable to open zip output for \"" + job.m_sourceName + "\"");
+        }
+        vector<char> buffer(ZIP_BUFFER_SIZE);
+        while (!dataFileIn.atEnd())
+        {
+            const qint64 numRead = dataFileIn.read(buffer.data(), ZIP_BUFFER_SIZE);
             if (numRead < 0) throw OperationException("Error reading from data file");
-            if (numRead > 0) {
-                qint64 result = dataFileOut.write(buffer.data(), numRead);
-                if (result != numRead) throw OperationException("Error writing to zip file");
+            if (numRead > 0)
+            {
+                if (dataFileOut.write(buffer.data(), numRead) != numRead) throw OperationException("Error writing to zip file");
             }
         }
-        
-        dataFileIn.close();
         dataFileOut.close();
-        switch (progressMode) {
-            case PROGRESS_COMMAND_LINE:
-                cout << endl;
-                break;
-            case PROGRESS_GUI_EVENT:
-                break;
+    }
+}
+
+void OperationZipSceneFile::writeZipFile(const AString& zipFileName,
+                                         const vector<AString>& dataFileNames,
+                                         const vector<AString>& memberNames,
+                                         const ProgressMode progressMode)
+{
+    CaretAssert(dataFileNames.size() == memberNames.size());
+    const int64_t numFiles = (int64_t)dataFileNames.size();
+    vector<ZipMemberJob> jobs(numFiles);
+    qint64 totalSize = 0;
+    for (int64_t i = 0; i < numFiles; ++i)
+    {
+        jobs[i].m_sourceName = dataFileNames[i];
+        jobs[i].m_memberName = memberNames[i];
+        jobs[i].m_size = QFileInfo(dataFileNames[i]).size();
+        jobs[i].m_store = isAlreadyCompressed(dataFileNames[i]);
+        jobs[i].m_sequential = (jobs[i].m_size >= (qint64)0xFFFFFFFFLL);//QuaZipNewInfo::uncompressedSize is 32 bit on some platforms
+        totalSize += jobs[i].m_size;
+    }
+    EventProgressUpdate progressEvent(0, numFiles, 0, "Creating ZIP File");
+    EventManager::get()->sendEvent(progressEvent.getPointer());
+    
+    QFile zipFileObject(zipFileName);
+    QuaZip zipFile(&zipFileObject);
+    if (totalSize >= (qint64)0xFFFFFFFFLL)
+    {
+        zipFile.setZip64Enabled(true);
+    }
+    if (!zipFile.open(QuaZip::mdCreate))
+    {
+        throw OperationException("Unable to open ZIP File \""
+                                 + zipFileName
+                                 + "\" for writing.");
+    }
+    const AString spillTemplate = FileInformation(zipFileName).getAbsolutePath() + "/.wb_zip_XXXXXX";
+    int numThreads = 1;
+#ifdef CARET_OMP
+    numThreads = max(1, omp_get_max_threads());
+#endif
+    AString errorMessage;
+    static const char *myUnits[9] = {" B    ", " KB", " MB", " GB", " TB", " PB", " EB", " ZB", " YB"};
+    try
+    {
+        for (int64_t batchStart = 0; batchStart < numFiles; batchStart += numThreads)
+        {//compress a batch in parallel, then write it in order from this thread, so progress events stay on the calling thread
+            const int64_t batchEnd = min(numFiles, batchStart + numThreads);
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int64_t i = batchStart; i < batchEnd; ++i)
+            {
+                if (!jobs[i].m_store && !jobs[i].m_sequential)
+                {
+                    compressMember(jobs[i], spillTemplate);
+                }
+            }
+            for (int64_t i = batchStart; i < batchEnd; ++i)
+            {
+                ZipMemberJob& job = jobs[i];
+                if (!job.m_error.isEmpty()) throw OperationException(job.m_error);
+                float fileSize = (float)job.m_size;
+                int unit = 0;
+                while (unit < 8 && fileSize >= 1000.0f)//don't let there be 4 digits to the left of decimal point
+                {
+                    ++unit;
+                    fileSize /= 1000.0f;//use GB and friends, not GiB
+                }
+                switch (progressMode) {
+                    case PROGRESS_COMMAND_LINE:
+                        if (unit > 0)
+                        {
+                            cout << AString::number(fileSize, 'f', 2);
+                        } else {
+                            cout << AString::number(fileSize);
+                        }
+                        cout << myUnits[unit] << "     \t" << job.m_memberName;
+                        cout.flush();//don't endl until it finishes
+                        break;
+                    case PROGRESS_GUI_EVENT:
+                        progressEvent.setProgress(i + 1,
+                                                  ("Adding "
+                                                   + (QString::number(i + 1) + " of " + QString::number(numFiles) + " (")
+                                                   + ((unit > 0) ? AString::number(fileSize, 'f', 2) : AString::number(fileSize))
+                                                   + myUnits[unit]
+                                                   + ") "
+                                                   + FileInformation(job.m_memberName).getFileName()));
+                        EventManager::get()->sendEvent(progressEvent.getPointer());
+                        break;
+                }
+                if (job.m_store || job.m_sequential)
+                {
+                    writeStreamedMember(zipFile, job);
+                } else {
+                    writeCompressedMember(zipFile, job);
+                }
+                job.m_compressed = vector<char>();//release memory and temporary files as we go
+                job.m_spillFile.grabNew(NULL);
+                switch (progressMode) {
+                    case PROGRESS_COMMAND_LINE:
+                        cout << endl;
+                        break;
+                    case PROGRESS_GUI_EVENT:
+                        break;
+                }
+            }
         }
+    } catch (CaretException& e) {
+        errorMessage = e.whatString();
     }
     zipFile.close();
-
+    if (!errorMessage.isEmpty())
+    {
+        QFile::remove(zipFileName);
+        throw OperationException(errorMessage);
+    }
+    
     switch (progressMode) {
         case PROGRESS_COMMAND_LINE:
             break;
         case PROGRESS_GUI_EVENT:
-            progressEvent.setProgress(allFiles.size(),
+            progressEvent.setProgress(numFiles,
                                       "Zip created successfully");
             EventManager::get()->sendEvent(progressEvent.getPointer());
             break;
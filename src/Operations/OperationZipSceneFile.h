@@ -23,6 +23,8 @@
 
 #include "AbstractOperation.h"
 
+#include <vector>
+
 namespace caret {
     
     class OperationZipSceneFile : public AbstractOperation
@@ -43,6 +45,11 @@ namespace caret {
                                   const AString& baseDirectory,
                                   const ProgressMode progressMode,
                                   ProgressObject* myProgObj);
+        ///compresses members in parallel, stores already-compressed files, writes them in the given order
+        static void writeZipFile(const AString& zipFileName,
+                                 const std::vector<AString>& dataFileNames,
+                                 const std::vector<AString>& memberNames,
+                                 const ProgressMode progressMode);
     };
 
     typedef TemplateAutoOperation<OperationZipSceneFile> AutoOperationZipSceneFile;
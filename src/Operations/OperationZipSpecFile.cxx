@@ -21,17 +21,14 @@
 #include "CaretLogger.h"
 #include "DataFile.h"
 #include "FileInformation.h"
+#include "OperationZipSceneFile.h"
 #include "OperationZipSpecFile.h"
 #include "OperationException.h"
 #include "SpecFile.h"
 
-#include "quazip.h"
-#include "quazipfile.h"
-
 //for cleanPath
 #include <QDir>
 
-//to print file sizes as it makes the zip
 #include <iostream>
 #include <vector>
 
@@ -63,7 +60,8 @@ OperationParameters* OperationZipSpecFile::getParameters()
     ret->setHelpText(AString("If zip-file already exists, it will be overwritten.  ") +
         "If -base-dir is not specified, the directory containing the spec file is used for the base directory.  " +
         "The spec file must contain only relative paths, and no data files may be outside the base directory.  " +
-        "Scene files inside spec files are not checked for what files they reference, ensure that all data files referenced by the scene files are also referenced by the spec file.");
+        "Scene files inside spec files are not checked for what files they reference, ensure that all data files referenced by the scene files are also referenced by the spec file.  " +
+        "Files that are already compressed (.gz, images) are stored without recompressing them, so they can be read directly from the zip file.");
     return ret;
 }
 
@@ -160,99 +158,14 @@ void OperationZipSpecFile::useParameters(OperationParameters* myParams, Progress
     }
     
     /*
-     * Create the ZIP file
-     */
-    QFile zipFileObject(zipFileName);
-    QuaZip zipFile(&zipFileObject);
-    if (zipFile.open(QuaZip::mdCreate) == false) {
-        throw OperationException("Unable to open ZIP File \""
-                                 + zipFileName
-                                 + "\" for writing.");
-    }
-    
-    /*
-     * Compress each of the files and add them to the zip file
-     */
-    AString errorMessage;
-    static const char *myUnits[9] = {" B    ", " KB", " MB", " GB", " TB", " PB", " EB", " ZB", " YB"};
-    for (int32_t i = 0; i < numberOfDataFiles; i++) {
-        AString dataFileName = allDataFileNames[i];
-        AString unzippedDataFileName = outputSubDirectory + "/" + dataFileName.mid(myBaseDir.size());//we know the string matches to the length of myBaseDir, and is cleaned, so we can just chop the right number of characters off
-        QFile dataFileIn(dataFileName);
-        if (dataFileIn.open(QFile::ReadOnly) == false) {
-            errorMessage = "Unable to open \""
-                                   + dataFileName
-                                   + "\" for reading: "
-                                   + dataFileIn.errorString();
-            break;
-        }
-        float fileSize = (float)dataFileIn.size();
-        int unit = 0;
-        while (unit < 8 && fileSize >= 1000.0f)//don't let there be 4 digits to the left of decimal point
-        {
-            ++unit;
-            fileSize /= 1000.0f;//use GB and friends, not GiB
-        }
-        if (unit > 0)
-        {
-            cout << AString::number(fileSize, 'f', 2);
-        } else {
-            cout << AString::number(fileSize);
-        }
-        cout << myUnits[unit] << "     \t" << unzippedDataFileName;
-        cout.flush();//don't endl until it finishes
-        
-        QuaZipNewInfo zipNewInfo(unzippedDataFileName,
-                                 dataFileName);
-        zipNewInfo.externalAttr |= (6 << 22L) | (6 << 19L) | (4 << 16L);//make permissions 664
-        
-        QuaZipFile dataFileOut(&zipFile);
-        if (dataFileOut.open(QIODevice::WriteOnly,
-                             zipNewInfo) == false) {
-            errorMessage = "Unable to open zip output for \""
-                            + dataFileName
-                            + "\"";
-            break;
-        }
-        
-        const qint64 BUFFER_SIZE = 1024 * 1024;
-        vector<char> buffer(BUFFER_SIZE);
-        
-        while (dataFileIn.atEnd() == false) {
-            const qint64 numRead = dataFileIn.read(buffer.data(), BUFFER_SIZE);
-            if (numRead < 0)
-            {
-                errorMessage = "Error reading from data file";
-                break;
-            }
-            if (numRead > 0) {
-                qint64 result = dataFileOut.write(buffer.data(), numRead);
-                if (result != numRead)
-                {
-                    errorMessage = "Error writing to zip file";
-                    break;
-                }
-            }
-        }
-        if (!errorMessage.isEmpty()) break;
-        
-        dataFileIn.close();
-        dataFileOut.close();
-        cout << endl;
-    }
-    
-    /*
-     * Close the zip file
-     */
-    zipFile.close();
-    
-    /*
-     * If there are errors, remove the ZIP file and
-     * indicate an error has occurred.
+     * Create the ZIP file, removing it if any file fails
      */
-    if (errorMessage.isEmpty() == false) {
-        QFile::remove(zipFileName);
-        
-        throw OperationException(errorMessage);
+    vector<AString> memberNames;
+    for (int32_t i = 0; i < (int32_t)allDataFileNames.size(); i++) {
+        memberNames.push_back(outputSubDirectory + "/" + allDataFileNames[i].mid(myBaseDir.size()));//we know the string matches to the length of myBaseDir, and is cleaned, so we can just chop the right number of characters off
     }
+    OperationZipSceneFile::writeZipFile(zipFileName,
+                                        allDataFileNames,
+                                        memberNames,
+                                        OperationZipSceneFile::PROGRESS_COMMAND_LINE);
 }
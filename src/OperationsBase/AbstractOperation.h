@@ -24,6 +24,7 @@
 //make it easy to use these in an algorithm class, don't just forward declare them
 #include "ProgressObject.h"
 #include "CaretAssert.h"
+#include "CaretProfiler.h"
 #include "OperationParameters.h"
 
 #include "StructureEnum.h"
@@ -76,7 +77,11 @@ namespace caret {
     {
         TemplateAutoOperation() { }
         OperationParameters* getParameters() { return T::getParameters(); }
-        void useParameters(OperationParameters* a, ProgressObject* b) { T::useParameters(a, b); }
+        void useParameters(OperationParameters* a, ProgressObject* b)
+        {
+            CaretProfileSpan mySpan(T::getCommandSwitch(), "operation");
+            T::useParameters(a, b);
+        }
         AString getCommandSwitch() { return T::getCommandSwitch(); }
         AString getShortDescription() { return T::getShortDescription(); }
         bool takesParameters() { return T::takesParameters(); }
@@ -24,9 +24,12 @@
 #undef __SCENE_DECLARE__
 
 #include "CaretAssert.h"
+#include "CaretLogger.h"
 #include "SceneAttributes.h"
 #include "SceneClass.h"
+#include "SceneDeferredContent.h"
 #include "SceneInfo.h"
+#include "XmlSaxParserException.h"
 
 using namespace caret;
 
@@ -236,6 +239,7 @@ Scene::Scene(const SceneTypeEnum::Enum sceneType)
     m_sceneAttributes = new SceneAttributes(sceneType);
     m_hasFilesWithRemotePaths = false;
     m_sceneInfo = new SceneInfo();
+    m_deferredContent = NULL;
 }
 
 /**
@@ -245,13 +249,14 @@ Scene::~Scene()
 {
     delete m_sceneAttributes;
 
-    const int32_t numberOfSceneClasses = this->getNumberOfClasses();
+    const int32_t numberOfSceneClasses = static_cast<int32_t>(m_sceneClasses.size());
     for (int32_t i = 0; i < numberOfSceneClasses; i++) {
         delete m_sceneClasses[i];
     }
     m_sceneClasses.clear();
     
     delete m_sceneInfo;
+    delete m_deferredContent;
 }
 
 /**
@@ -275,6 +280,7 @@ Scene::getAttributes()
 void
 Scene::addClass(SceneClass* sceneClass)
 {
+    loadDeferredContent();
     if (sceneClass != NULL) {
         m_sceneClasses.push_back(sceneClass);
     }
@@ -287,6 +293,7 @@ Scene::addClass(SceneClass* sceneClass)
 int32_t
 Scene::getNumberOfClasses() const
 {
+    loadDeferredContent();
     return m_sceneClasses.size();
 }
 
@@ -299,6 +306,7 @@ Scene::getNumberOfClasses() const
 const SceneClass* 
 Scene::getClassAtIndex(const int32_t indx) const
 {
+    loadDeferredContent();
     CaretAssertVectorIndex(m_sceneClasses, indx);
     return m_sceneClasses[indx];
 }
@@ -390,6 +398,7 @@ Scene::setDescription(const AString& sceneDescription)
 bool
 Scene::hasFilesWithRemotePaths() const
 {
+    loadDeferredContent();
     return m_hasFilesWithRemotePaths;
 }
 
@@ -405,6 +414,97 @@ Scene::setHasFilesWithRemotePaths(const bool hasFilesWithRemotePaths)
     m_hasFilesWithRemotePaths = hasFilesWithRemotePaths;
 }
 
+/**
+ * Set the location of the scene's classes in its scene file so that
+ * they are parsed when first accessed.  Ownership of the pointer is taken
+ * by this Scene object.
+ *
+ * @param deferredContent
+ *    Location of the classes in the file.
+ */
+void
+Scene::setDeferredContent(SceneDeferredContent* deferredContent)
+{
+    if (m_deferredContent != NULL) {
+        delete m_deferredContent;
+    }
+    m_deferredContent = deferredContent;
+}
+
+/**
+ * @return true if the scene's classes have not yet been read from its file.
+ */
+bool
+Scene::hasDeferredContent() const
+{
+    return (m_deferredContent != NULL);
+}
+
+/**
+ * Read the scene's classes from its file if they have not yet been read.
+ * If reading fails, an error is logged and the scene has no classes.
+ * The class accessors use this, so callers that restore a scene should
+ * use the method with an error message first.
+ *
+ * @return true if the classes are available, false if reading failed.
+ */
+bool
+Scene::loadDeferredContent() const
+{
+    if (m_deferredContent == NULL) {
+        return m_deferredContentErrorMessage.isEmpty();
+    }
+    
+    /*
+     * Clear the member first, reading adds classes through addClass()
+     */
+    SceneDeferredContent* deferredContent = m_deferredContent;
+    m_deferredContent = NULL;
+    
+    Scene* scene = const_cast<Scene*>(this);
+    bool validFlag = true;
+    try {
+        deferredContent->readIntoScene(scene);
+    }
+    catch (const XmlSaxParserException& e) {
+        for (std::vector<SceneClass*>::iterator iter = scene->m_sceneClasses.begin();
+             iter != scene->m_sceneClasses.end();
+             iter++) {
+            delete *iter;
+        }
+        scene->m_sceneClasses.clear();
+        m_deferredContentErrorMessage = ("Error reading scene "
+                                         + getName()
+                                         + ": "
+                                         + e.whatString());
+        CaretLogSevere(m_deferredContentErrorMessage);
+        validFlag = false;
+    }
+    delete deferredContent;
+    
+    return validFlag;
+}
+
+/**
+ * Read the scene's classes from its file if they have not yet been read.
+ * A failed read is remembered, so this also reports a failure that
+ * happened during an earlier access to the scene's classes.
+ *
+ * @param errorMessageOut
+ *    Output with the reason the classes could not be read.
+ * @return true if the classes are available, false if reading failed.
+ */
+bool
+Scene::loadDeferredContent(AString& errorMessageOut) const
+{
+    errorMessageOut.clear();
+    if (loadDeferredContent()) {
+        return true;
+    }
+    errorMessageOut = m_deferredContentErrorMessage;
+    return false;
+}
+
 /**
  * Set a static value for the scene that is being created.
  */
@@ -28,6 +28,7 @@
 namespace caret {
     class SceneAttributes;
     class SceneClass;
+    class SceneDeferredContent;
     class SceneInfo;
     
     class Scene : public CaretObject {
@@ -78,6 +79,13 @@ namespace caret {
         
         void setHasFilesWithRemotePaths(const bool hasFilesWithRemotePaths);
 
+        void setDeferredContent(SceneDeferredContent* deferredContent);
+        
+        bool hasDeferredContent() const;
+        
+        bool loadDeferredContent() const;
+        
+        bool loadDeferredContent(AString& errorMessageOut) const;
         
         // ADD_NEW_METHODS_HERE
 
@@ -99,6 +107,12 @@ namespace caret {
         /** True if it found a ScenePathName with a remote file */
         bool m_hasFilesWithRemotePaths;
         
+        /** Classes still in the scene file, parsed on first access */
+        mutable SceneDeferredContent* m_deferredContent;
+        
+        /** Error from reading the deferred classes, empty if there was none */
+        mutable AString m_deferredContentErrorMessage;
+        
         /** When a scene is being created, this will be set */
         static Scene* s_sceneBeingCreated;
         
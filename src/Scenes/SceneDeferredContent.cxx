@@ -0,0 +1,135 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SceneDeferredContent.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+
+#include <memory>
+
+#include "CaretAssert.h"
+#include "CaretProfiler.h"
+#include "Scene.h"
+#include "SceneSaxReader.h"
+#include "SceneXmlElements.h"
+#include "XmlSaxParser.h"
+#include "XmlSaxParserException.h"
+
+using namespace caret;
+
+
+    
+/**
+ * \class caret::SceneDeferredContent 
+ * \brief Location of a scene's classes in a scene file that have not been parsed.
+ * \ingroup Scenes
+ *
+ * When a scene file is opened, only the scene info is parsed.  The classes
+ * of each scene remain in the file and are parsed when the scene is first
+ * used, so that opening a file with many large scenes is fast and only
+ * the scenes that are displayed occupy memory.
+ */
+
+/**
+ * Constructor.
+ * @param sceneFileName
+ *    Name of the scene file containing the scene.
+ * @param sceneStartTag
+ *    The Scene element's start tag, including its attributes.
+ * @param contentOffset
+ *    Byte offset of the first class of the scene.
+ * @param contentSize
+ *    Number of bytes from the first class to the Scene end tag.
+ * @param fileSize
+ *    Size of the file when it was indexed.
+ * @param fileLastModified
+ *    Modification time of the file when it was indexed.
+ */
+SceneDeferredContent::SceneDeferredContent(const AString& sceneFileName,
+                                           const QByteArray& sceneStartTag,
+                                           const int64_t& contentOffset,
+                                           const int64_t& contentSize,
+                                           const int64_t& fileSize,
+                                           const QDateTime& fileLastModified)
+: m_sceneFileName(sceneFileName),
+m_sceneStartTag(sceneStartTag),
+m_contentOffset(contentOffset),
+m_contentSize(contentSize),
+m_fileSize(fileSize),
+m_fileLastModified(fileLastModified)
+{
+}
+
+/**
+ * Read the scene's classes from the file and add them to the scene.
+ * @param scene
+ *    Scene that receives the classes.
+ * @throws XmlSaxParserException
+ *    If the file has changed since it was indexed or cannot be parsed.
+ */
+void
+SceneDeferredContent::readIntoScene(Scene* scene) const
+{
+    CaretAssert(scene);
+    CaretProfileSpan mySpan("SceneDeferredContent::readIntoScene", "io");
+    
+    const QFileInfo fileInfo(m_sceneFileName);
+    if ((fileInfo.exists() == false)
+        || (fileInfo.size() != m_fileSize)
+        || (fileInfo.lastModified() != m_fileLastModified)) {
+        throw XmlSaxParserException("Scene file "
+                                    + m_sceneFileName
+                                    + " has changed since it was opened, reopen the file to display scene "
+                                    + scene->getName());
+    }
+    
+    QFile file(m_sceneFileName);
+    if (file.open(QFile::ReadOnly) == false) {
+        throw XmlSaxParserException("Unable to open file " + m_sceneFileName);
+    }
+    if (file.seek(m_contentOffset) == false) {
+        throw XmlSaxParserException("Unable to seek in file " + m_sceneFileName);
+    }
+    
+    /*
+     * The scene's name and description elements were parsed with the
+     * scene info, so the document is the start tag followed by the classes
+     */
+    QByteArray sceneDocument = m_sceneStartTag;
+    sceneDocument.append(file.read(m_contentSize));
+    if (sceneDocument.size() != m_sceneStartTag.size() + m_contentSize) {
+        throw XmlSaxParserException("Unable to read scene "
+                                    + scene->getName()
+                                    + " from file "
+                                    + m_sceneFileName);
+    }
+    file.close();
+    sceneDocument.append(("</" + SceneXmlElements::SCENE_TAG + ">").toUtf8());
+    mySpan.addBytes(sceneDocument.size());
+    
+    SceneSaxReader saxReader(m_sceneFileName,
+                             scene);
+    std::auto_ptr<XmlSaxParser> parser(XmlSaxParser::createXmlParser());
+    parser->parseString(QString::fromUtf8(sceneDocument.constData(),
+                                          sceneDocument.size()),
+                        &saxReader);
+}
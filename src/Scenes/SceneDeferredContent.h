@@ -0,0 +1,74 @@
+#ifndef __SCENE_DEFERRED_CONTENT_H__
+#define __SCENE_DEFERRED_CONTENT_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <QByteArray>
+#include <QDateTime>
+
+#include <stdint.h>
+
+#include "AString.h"
+
+namespace caret {
+
+    class Scene;
+    
+    class SceneDeferredContent {
+        
+    public:
+        SceneDeferredContent(const AString& sceneFileName,
+                             const QByteArray& sceneStartTag,
+                             const int64_t& contentOffset,
+                             const int64_t& contentSize,
+                             const int64_t& fileSize,
+                             const QDateTime& fileLastModified);
+        
+        void readIntoScene(Scene* scene) const;
+        
+        int64_t getContentSize() const { return m_contentSize; }
+        
+    private:
+        SceneDeferredContent(const SceneDeferredContent&);
+
+        SceneDeferredContent& operator=(const SceneDeferredContent&);
+        
+        /** name of the scene file, as given to the scene sax reader */
+        AString m_sceneFileName;
+        
+        /** the Scene element's start tag, copied from the file */
+        QByteArray m_sceneStartTag;
+        
+        /** byte offset of the scene's classes in the file */
+        int64_t m_contentOffset;
+        
+        /** byte count of the scene's classes in the file */
+        int64_t m_contentSize;
+        
+        /** size of the file when it was indexed */
+        int64_t m_fileSize;
+        
+        /** modification time of the file when it was indexed */
+        QDateTime m_fileLastModified;
+    };
+    
+} // namespace
+#endif  //__SCENE_DEFERRED_CONTENT_H__
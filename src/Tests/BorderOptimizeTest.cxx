@@ -0,0 +1,176 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "BorderOptimizeTest.h"
+
+#include "AlgorithmBorderOptimize.h"
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "Border.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "SurfaceProjectedItem.h"
+#include "SurfaceProjectionBarycentric.h"
+#include "TopologyHelper.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+BorderOptimizeTest::BorderOptimizeTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int NUM_BORDERS = 5;
+    
+    int32_t closestNode(const SurfaceFile& surface, const float& x, const float& y, const float& z)
+    {
+        int32_t ret = 0;
+        float bestDist = -1.0f;
+        for (int32_t i = 0; i < surface.getNumberOfNodes(); ++i)
+        {
+            const float* coord = surface.getCoordinate(i);
+            float dist = (coord[0] - x) * (coord[0] - x) + (coord[1] - y) * (coord[1] - y) + (coord[2] - z) * (coord[2] - z);
+            if (bestDist < 0.0f || dist < bestDist)
+            {
+                bestDist = dist;
+                ret = i;
+            }
+        }
+        return ret;
+    }
+    
+    //open border along a line of latitude, crossing the roi on the +x side of the sphere
+    Border* makeLatitudeBorder(const SurfaceFile& sphere, const float& z)
+    {
+        Border* ret = new Border();
+        ret->setName("latitude " + AString::number(z));
+        CaretPointer<TopologyHelper> myTopoHelp = sphere.getTopologyHelper();
+        const float ringRadius = sqrt(100.0f * 100.0f - z * z);
+        for (int degrees = -120; degrees <= 120; degrees += 10)
+        {
+            const float angle = degrees * 3.14159265f / 180.0f;
+            int32_t node = closestNode(sphere, ringRadius * cos(angle), ringRadius * sin(angle), z);
+            const int32_t* tileNodes = sphere.getTriangle(myTopoHelp->getNodeTiles(node)[0]);
+            float weights[3] = { 0.0f, 0.0f, 0.0f };
+            for (int whichNode = 0; whichNode < 3; ++whichNode)
+            {
+                if (tileNodes[whichNode] == node) weights[whichNode] = 1.0f;
+            }
+            SurfaceProjectedItem* myItem = new SurfaceProjectedItem();
+            myItem->getBarycentricProjection()->setTriangleNodes(tileNodes);
+            myItem->getBarycentricProjection()->setTriangleAreas(weights);
+            myItem->getBarycentricProjection()->setValid(true);
+            myItem->setStructure(sphere.getStructure());
+            ret->addPoint(myItem);
+        }
+        return ret;
+    }
+    
+    bool samePoints(const Border& first, const Border& second)
+    {
+        if (first.getNumberOfPoints() != second.getNumberOfPoints()) return false;
+        for (int i = 0; i < first.getNumberOfPoints(); ++i)
+        {
+            const SurfaceProjectionBarycentric* firstBary = first.getPoint(i)->getBarycentricProjection();
+            const SurfaceProjectionBarycentric* secondBary = second.getPoint(i)->getBarycentricProjection();
+            for (int j = 0; j < 3; ++j)
+            {
+                if (firstBary->getTriangleNodes()[j] != secondBary->getTriangleNodes()[j] || firstBary->getTriangleAreas()[j] != secondBary->getTriangleAreas()[j]) return false;
+            }
+        }
+        return true;
+    }
+}
+
+void BorderOptimizeTest::execute()
+{
+    int maxThreads = 1, multiThreads = 4;
+#ifdef CARET_OMP
+    maxThreads = omp_get_max_threads();
+    if (maxThreads > multiThreads) multiThreads = maxThreads;
+#endif
+    try
+    {
+        SurfaceFile sphere;
+        AlgorithmSurfaceCreateSphere(NULL, 2562, &sphere);
+        sphere.setStructure(StructureEnum::CORTEX_LEFT);
+        const int32_t numNodes = sphere.getNumberOfNodes();
+        vector<int32_t> roiNodes;
+        vector<float> dataValues(numNodes);
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            const float* coord = sphere.getCoordinate(i);
+            if (coord[0] > 20.0f) roiNodes.push_back(i);
+            dataValues[i] = sin(coord[1] / 15.0f) + 0.3f * cos(coord[2] / 20.0f);//ridges for the paths to follow
+        }
+        MetricFile dataMetric;
+        dataMetric.setNumberOfNodesAndColumns(numNodes, 1);
+        dataMetric.setStructure(StructureEnum::CORTEX_LEFT);
+        dataMetric.setValuesForColumn(0, dataValues.data());
+        vector<AlgorithmBorderOptimize::DataInput> dataInputs;
+        dataInputs.push_back(AlgorithmBorderOptimize::DataInput(&dataMetric, 0, false, 0.0f, 1.0f, false, false, 0.0f));
+        vector<CaretPointer<Border> > borderStore;
+        vector<const Border*> borders;
+        for (int i = 0; i < NUM_BORDERS; ++i)
+        {
+            borderStore.push_back(CaretPointer<Border>(makeLatitudeBorder(sphere, -60.0f + 30.0f * i)));
+            borders.push_back(borderStore.back().getPointer());
+        }
+        vector<Border> singleOut, multiOut;
+        AString singleStats, multiStats;
+#ifdef CARET_OMP
+        omp_set_num_threads(1);
+#endif
+        AlgorithmBorderOptimize(NULL, &sphere, borders, roiNodes, dataInputs, singleOut, singleStats);
+#ifdef CARET_OMP
+        omp_set_num_threads(multiThreads);//the borders' paths are followed in parallel
+#endif
+        AlgorithmBorderOptimize(NULL, &sphere, borders, roiNodes, dataInputs, multiOut, multiStats);
+#ifdef CARET_OMP
+        omp_set_num_threads(maxThreads);
+#endif
+        if (singleOut.size() != borders.size() || multiOut.size() != borders.size())
+        {
+            setFailed("border optimize returned the wrong number of borders");
+            return;
+        }
+        for (int i = 0; i < NUM_BORDERS; ++i)
+        {
+            if (!samePoints(singleOut[i], multiOut[i]))
+            {
+                setFailed("optimized border '" + borders[i]->getName() + "' differs between 1 and " + AString::number(multiThreads) + " threads");
+            }
+        }
+        if (singleStats != multiStats)
+        {
+            setFailed("border optimize statistics differ between 1 and " + AString::number(multiThreads) + " threads");
+        }
+    } catch (CaretException& e) {
+#ifdef CARET_OMP
+        omp_set_num_threads(maxThreads);
+#endif
+        setFailed("border optimize failed: " + e.whatString());
+    }
+}
@@ -178,12 +178,24 @@ void CiftiFileTest::testCiftiReadWriteOnDisk()
         writer.setRow(row,i);
     }
 
+    //on-disk writes are queued, rows read back before writeFile must still have the new data
+    float *testRow = new float [rowSize];
+    for(int64_t i = 0;i<columnSize;i++)
+    {
+        reader.getRow(row,i);
+        writer.getRow(testRow,i);
+        if(memcmp((void *)row,(void *)testRow,rowSize*sizeof(float)))
+        {
+            this->setFailed("Rows read back before writeFile are not the same as the rows written.");
+            return;
+        }
+    }
+
     writer.writeFile(outFile);
 
     //reopen output file, and check that frames agree
     CiftiFile test(outFile);
 
-    float *testRow = new float [rowSize];
     for(int64_t i = 0;i<columnSize;i++)
     {
         reader.getRow(row,i);
@@ -0,0 +1,264 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2015  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "CommandBatchTest.h"
+
+#include "CaretPointer.h"
+#include "CiftiFile.h"
+#include "CommandException.h"
+#include "CommandFileCache.h"
+#include "CommandOperationManager.h"
+#include "MetricFile.h"
+
+#include <QDir>
+#include <QFile>
+
+using namespace caret;
+using namespace std;
+
+CommandBatchTest::CommandBatchTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    void writeMetric(const AString& fileName, const int32_t& numNodes)
+    {
+        MetricFile myFile;
+        myFile.setNumberOfNodesAndColumns(numNodes, 1);
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            myFile.setValue(i, 0, i);
+        }
+        myFile.writeFile(fileName);
+    }
+    
+    //what the parser does for a disk input: check the cache, otherwise read and add
+    CaretPointer<MetricFile> readMetric(CommandFileCache& cache, const AString& fileName, bool& reusedOut)
+    {
+        CaretPointer<MetricFile> ret;
+        reusedOut = cache.getFile(fileName, ret);
+        if (!reusedOut)
+        {
+            ret.grabNew(new MetricFile());
+            ret->readFile(fileName);
+            cache.addFile(fileName, ret);
+        }
+        return ret;
+    }
+    
+    //whether endCommand rejects the command
+    bool endCommandThrows(CommandFileCache& cache, const vector<AString>& arguments)
+    {
+        try
+        {
+            cache.endCommand(arguments);
+        } catch (CommandException&) {
+            return true;
+        }
+        return false;
+    }
+}
+
+void CommandBatchTest::testParse()
+{
+    const QString text =
+        "wb_command -metric-math 'a b' \"x \\\"y\\\"\" # trailing comment\n"
+        "# a whole line comment\n"
+        "\n"
+        "-foo a#b \\\n"
+        "   c\\ d\n"
+        "last";
+    vector<CommandOperationManager::BatchCommand> commands;
+    CommandOperationManager::parseBatchScript(text, "script", commands);
+    if (commands.size() != 3)
+    {
+        setFailed("expected 3 commands, parsed " + AString::number(commands.size()));
+        return;
+    }
+    const char* expected0[] = { "wb_command", "-metric-math", "a b", "x \"y\"" };
+    const char* expected1[] = { "-foo", "a#b", "c d" };
+    const int expectedLines[] = { 1, 4, 6 };
+    const size_t expectedCounts[] = { 4, 3, 1 };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (commands[i].m_lineNumber != expectedLines[i])
+        {
+            setFailed("command " + AString::number(i) + " reported line " + AString::number(commands[i].m_lineNumber) + ", expected " + AString::number(expectedLines[i]));
+        }
+        if (commands[i].m_arguments.size() != expectedCounts[i])
+        {
+            setFailed("command " + AString::number(i) + " has " + AString::number(commands[i].m_arguments.size()) + " arguments, expected " + AString::number(expectedCounts[i]));
+            return;
+        }
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        if (commands[0].m_arguments[i] != expected0[i])
+        {
+            setFailed("quoting parsed incorrectly: '" + commands[0].m_arguments[i] + "' instead of '" + expected0[i] + "'");
+        }
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        if (commands[1].m_arguments[i] != expected1[i])
+        {
+            setFailed("line continuation parsed incorrectly: '" + commands[1].m_arguments[i] + "' instead of '" + expected1[i] + "'");
+        }
+    }
+    if (commands[2].m_arguments[0] != "last")
+    {
+        setFailed("last line without a newline parsed incorrectly: '" + commands[2].m_arguments[0] + "'");
+    }
+    const char* unterminated[] = { "-foo 'bar\n", "-foo \"bar\n" };
+    for (int i = 0; i < 2; ++i)
+    {
+        bool threw = false;
+        try
+        {
+            CommandOperationManager::parseBatchScript(unterminated[i], "script", commands);
+        } catch (CommandException&) {
+            threw = true;
+        }
+        if (!threw)
+        {
+            setFailed("unterminated quote was not an error: " + AString(unterminated[i]));
+        }
+    }
+}
+
+void CommandBatchTest::testCache()
+{
+    const AString fileName = QDir::tempPath() + "/wb_command_batch_test.func.gii";
+    try
+    {
+        writeMetric(fileName, 10);
+        vector<AString> arguments(1, fileName);
+        CommandFileCache cache;
+        bool reused = false;
+        
+        cache.beginCommand();
+        CaretPointer<MetricFile> first = readMetric(cache, fileName, reused);
+        cache.endCommand(arguments);
+        cache.beginCommand();
+        CaretPointer<MetricFile> second = readMetric(cache, fileName, reused);
+        cache.endCommand(arguments);
+        if (!reused || second.getPointer() != first.getPointer())
+        {
+            setFailed("unchanged input was not reused by a later command");
+        }
+        
+        writeMetric(fileName, 20);//changes the size, so the stamp no longer matches
+        cache.beginCommand();
+        CaretPointer<MetricFile> third = readMetric(cache, fileName, reused);
+        cache.endCommand(arguments);
+        if (reused || third->getNumberOfNodes() != 20)
+        {
+            setFailed("input changed on disk was reused");
+        }
+        
+        cache.beginCommand();
+        CaretPointer<MetricFile> fourth = readMetric(cache, fileName, reused);
+        fourth->setValue(0, 0, -1.0f);//modified in memory, no longer matches the file
+        cache.endCommand(arguments);
+        cache.beginCommand();
+        CaretPointer<MetricFile> fifth = readMetric(cache, fileName, reused);
+        cache.endCommand(arguments);
+        if (reused || fifth->getValue(0, 0) != 0.0f)
+        {
+            setFailed("input modified in memory was reused");
+        }
+        
+        vector<AString> memoryArguments(1, "@metric");
+        cache.beginCommand();
+        CaretPointer<MetricFile> memoryOut(new MetricFile());
+        memoryOut->setNumberOfNodesAndColumns(5, 1);
+        cache.addFile("@metric", memoryOut);//an in-memory output
+        cache.endCommand(memoryArguments);
+        cache.beginCommand();
+        CaretPointer<MetricFile> memoryIn;
+        if (!cache.getFile("@metric", memoryIn) || memoryIn.getPointer() != memoryOut.getPointer())
+        {
+            setFailed("in-memory output was not available to a later command");
+        }
+        if (endCommandThrows(cache, memoryArguments))
+        {
+            setFailed("reading an in-memory file without modifying it was rejected");
+        }
+        cache.beginCommand();
+        cache.getFile("@metric", memoryIn);
+        CaretPointer<MetricFile> replacement(new MetricFile());
+        replacement->setNumberOfNodesAndColumns(5, 1);
+        memoryIn->setValue(0, 0, 1.0f);
+        cache.addFile("@metric", replacement);//the old object is no longer visible to later commands
+        if (endCommandThrows(cache, memoryArguments))
+        {
+            setFailed("replacing an in-memory input with an output of the same name was rejected");
+        }
+        cache.beginCommand();
+        cache.getFile("@metric", memoryIn);
+        memoryIn->setValue(0, 0, 1.0f);
+        if (!endCommandThrows(cache, memoryArguments))
+        {
+            setFailed("modifying an in-memory metric input in place was not rejected");
+        }
+        
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        CiftiSeriesMap mySeries;
+        mySeries.setLength(3);
+        myXML.setMap(CiftiXML::ALONG_ROW, mySeries);
+        myXML.setMap(CiftiXML::ALONG_COLUMN, mySeries);
+        vector<float> row(3, 1.0f);
+        vector<AString> ciftiArguments(1, "@cifti");
+        cache.beginCommand();
+        CaretPointer<CiftiFile> ciftiOut(new CiftiFile());
+        ciftiOut->setCiftiXML(myXML);
+        ciftiOut->setRow(row.data(), 0);
+        cache.addFile("@cifti", ciftiOut);
+        cache.endCommand(ciftiArguments);
+        cache.beginCommand();
+        CaretPointer<CiftiFile> ciftiIn;
+        cache.getFile("@cifti", ciftiIn);
+        if (endCommandThrows(cache, ciftiArguments))
+        {
+            setFailed("reading an in-memory cifti file without modifying it was rejected");
+        }
+        cache.beginCommand();
+        cache.getFile("@cifti", ciftiIn);
+        ciftiIn->setRow(row.data(), 1);
+        if (!endCommandThrows(cache, ciftiArguments))
+        {
+            setFailed("modifying an in-memory cifti input in place was not rejected");
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    QFile::remove(fileName);
+}
+
+void CommandBatchTest::execute()
+{
+    try
+    {
+        testParse();
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    testCache();
+}
@@ -0,0 +1,89 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "FeatureDrawCacheTest.h"
+
+#include "BrainOpenGLFeatureDrawCache.h"
+#include "FociFile.h"
+#include "Focus.h"
+#include "GroupAndNameHierarchyModel.h"
+#include "SurfaceFile.h"
+#include "SurfaceProjectedItem.h"
+
+using namespace caret;
+using namespace std;
+
+FeatureDrawCacheTest::FeatureDrawCacheTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void FeatureDrawCacheTest::execute()
+{
+    //no display is needed, the draw lists are built from the files alone
+    SurfaceFile mySurface;
+    mySurface.setNumberOfNodesAndTriangles(3, 1);
+    mySurface.setStructure(StructureEnum::CORTEX_LEFT);
+    
+    const StructureEnum::Enum structures[3] = { StructureEnum::CORTEX_LEFT, StructureEnum::CORTEX_RIGHT, StructureEnum::INVALID };
+    FociFile myFoci;
+    for (int i = 0; i < 3; ++i)
+    {
+        Focus* myFocus = new Focus();
+        myFocus->setName("focus" + AString::number(i));
+        myFocus->setClassName("class");
+        SurfaceProjectedItem* myProjection = new SurfaceProjectedItem();
+        float xyz[3] = { (float)i, 2.0f * i, 3.0f * i };
+        myProjection->setStereotaxicXYZ(xyz);
+        myProjection->setStructure(structures[i]);
+        myFocus->addProjection(myProjection);
+        myFoci.addFocus(myFocus);
+    }
+    myFoci.clearModified();
+    
+    BrainOpenGLFeatureDrawCache::DrawSettings mySettings;
+    mySettings.m_displayGroup = DisplayGroupEnum::DISPLAY_GROUP_TAB;
+    mySettings.m_tabIndex = 0;
+    mySettings.m_coloringType = FeatureColoringTypeEnum::FEATURE_COLORING_TYPE_STANDARD_COLOR;
+    mySettings.m_standardColor = CaretColorEnum::RED;
+    BrainOpenGLFeatureDrawCache::FociDrawList myList;
+    BrainOpenGLFeatureDrawCache::buildFociDrawList(&myFoci, &mySurface, mySettings, myList);
+    if (myList.m_focusIndices.size() != 2 || myList.m_xyz.size() != 6 || myList.m_rgba.size() != 8)
+    {
+        setFailed("expected the left and structureless foci, got " + AString::number(myList.m_focusIndices.size()) + " items");
+    } else {
+        if (myList.m_focusIndices[0] != 0 || myList.m_focusIndices[1] != 2) setFailed("wrong foci in draw list");
+        if (myList.m_xyz[3] != 2.0f || myList.m_xyz[5] != 6.0f) setFailed("wrong position in draw list");
+        float redRGBA[4];
+        CaretColorEnum::toRGBFloat(CaretColorEnum::RED, redRGBA);
+        for (int i = 0; i < 4; ++i)
+        {
+            if (myList.m_rgba[i] != redRGBA[i]) setFailed("wrong color in draw list");
+        }
+    }
+    mySettings.m_contralateralEnabled = true;
+    BrainOpenGLFeatureDrawCache::buildFociDrawList(&myFoci, &mySurface, mySettings, myList);
+    if (myList.m_focusIndices.size() != 3) setFailed("contralateral focus not in draw list");
+    
+    BrainOpenGLFeatureDrawCache myCache;
+    const BrainOpenGLFeatureDrawCache::FociDrawList* cachedList = myCache.getFociDrawList(&myFoci, &mySurface, mySettings);
+    if (cachedList->m_focusIndices.size() != 3) setFailed("cached draw list differs from built draw list");
+    myFoci.getGroupAndNameHierarchyModel()->setSelected(mySettings.m_displayGroup, mySettings.m_tabIndex, false);
+    cachedList = myCache.getFociDrawList(&myFoci, &mySurface, mySettings);
+    if (!cachedList->m_focusIndices.empty()) setFailed("cached draw list not rebuilt after selection change");
+}
@@ -0,0 +1,131 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "FiberBinghamTest.h"
+
+#include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "FloatMatrix.h"
+#include "OperationEstimateFiberBinghams.h"
+#include "VolumeFile.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+FiberBinghamTest::FiberBinghamTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    void compareRows(FiberBinghamTest* theTest, const AString& condition, const vector<float>& first, const vector<float>& second)
+    {
+        if (memcmp(first.data(), second.data(), first.size() * sizeof(float)) != 0)//should be bitwise identical, not just close
+        {
+            for (size_t i = 0; i < first.size(); ++i)
+            {
+                if (first[i] != second[i])
+                {
+                    theTest->setFailed(condition + ", found different value at voxel " + AString::number(i / OperationEstimateFiberBinghams::NUM_ROW_VALUES) +
+                                       ", element " + AString::number(i % OperationEstimateFiberBinghams::NUM_ROW_VALUES));
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void FiberBinghamTest::execute()
+{
+    const int64_t DIM = 12, NUM_SAMPLES = 50;
+    vector<int64_t> myDims(3, DIM);
+    myDims.push_back(NUM_SAMPLES);
+    FloatMatrix mySform = FloatMatrix::identity(4);
+    CaretPointer<VolumeFile> myVolumes[9];
+    srand(12345);//synthetic bedpostx samples, clustered around one direction per voxel so the estimates are meaningful
+    for (int v = 0; v < 9; ++v)
+    {
+        myVolumes[v].grabNew(new VolumeFile(myDims, mySform.getMatrix()));
+    }
+    for (int64_t k = 0; k < DIM; ++k)
+    {
+        for (int64_t j = 0; j < DIM; ++j)
+        {
+            for (int64_t i = 0; i < DIM; ++i)
+            {
+                for (int fiber = 0; fiber < 3; ++fiber)
+                {
+                    float baseTheta = 3.14159265f * rand() / RAND_MAX, basePhi = 6.2831853f * rand() / RAND_MAX;
+                    for (int64_t b = 0; b < NUM_SAMPLES; ++b)
+                    {
+                        myVolumes[fiber * 3]->setValue(((float)rand()) / RAND_MAX, i, j, k, b);
+                        myVolumes[fiber * 3 + 1]->setValue(baseTheta + 0.2f * rand() / RAND_MAX - 0.1f, i, j, k, b);
+                        myVolumes[fiber * 3 + 2]->setValue(basePhi + 0.4f * rand() / RAND_MAX - 0.2f, i, j, k, b);
+                    }
+                }
+            }
+        }
+    }
+    const VolumeFile* sampleVolumes[9];
+    for (int v = 0; v < 9; ++v)
+    {
+        sampleVolumes[v] = myVolumes[v];
+    }
+    vector<int64_t> voxelIJK;
+    for (int64_t k = 0; k < DIM; ++k)
+    {
+        for (int64_t j = 0; j < DIM; ++j)
+        {
+            for (int64_t i = 0; i < DIM; ++i)
+            {
+                voxelIJK.push_back(i);
+                voxelIJK.push_back(j);
+                voxelIJK.push_back(k);
+            }
+        }
+    }
+    int64_t numVoxels = DIM * DIM * DIM;
+    vector<float> singleRows(numVoxels * OperationEstimateFiberBinghams::NUM_ROW_VALUES);
+    vector<float> multiRows(singleRows.size()), slabRows(singleRows.size());
+#ifdef CARET_OMP
+    int maxThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    OperationEstimateFiberBinghams::estimateVoxelRows(sampleVolumes, sampleVolumes[0], voxelIJK, singleRows.data());
+#ifdef CARET_OMP
+    omp_set_num_threads(maxThreads < 4 ? 4 : maxThreads);//use several threads even on small machines, to exercise the scratch buffers
+#endif
+    OperationEstimateFiberBinghams::estimateVoxelRows(sampleVolumes, sampleVolumes[0], voxelIJK, multiRows.data());
+    compareRows(this, "comparing single thread to multiple threads", singleRows, multiRows);
+    int64_t slabVoxels = DIM * DIM * 5;//do the volume in uneven blocks, like -slab does
+    for (int64_t start = 0; start < numVoxels; start += slabVoxels)
+    {
+        int64_t end = start + slabVoxels;
+        if (end > numVoxels) end = numVoxels;
+        vector<int64_t> slabIJK(voxelIJK.begin() + start * 3, voxelIJK.begin() + end * 3);
+        OperationEstimateFiberBinghams::estimateVoxelRows(sampleVolumes, sampleVolumes[0], slabIJK,
+                                                          slabRows.data() + start * OperationEstimateFiberBinghams::NUM_ROW_VALUES);
+    }
+    compareRows(this, "comparing whole volume to slabs", singleRows, slabRows);
+#ifdef CARET_OMP
+    omp_set_num_threads(maxThreads);
+#endif
+}
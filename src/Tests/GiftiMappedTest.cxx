@@ -0,0 +1,119 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2015  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "GiftiMappedTest.h"
+
+#include "CaretException.h"
+#include "GiftiDataArray.h"
+#include "GiftiFile.h"
+
+#include <QDir>
+#include <QFile>
+
+using namespace caret;
+using namespace std;
+
+GiftiMappedTest::GiftiMappedTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int32_t NUM_VALUES = 1000;
+    
+    void writeIntFile(const AString& fileName, const int32_t& valueOffset)
+    {
+        GiftiFile myFile;
+        vector<int64_t> dims(1, NUM_VALUES);
+        GiftiDataArray* myArray = new GiftiDataArray(NiftiIntentEnum::NIFTI_INTENT_LABEL, NiftiDataTypeEnum::NIFTI_TYPE_INT32, dims);
+        int32_t* data = myArray->getDataPointerInt();
+        for (int32_t i = 0; i < NUM_VALUES; ++i)
+        {
+            data[i] = i * 3 + valueOffset;//not valid as floats when reinterpreted
+        }
+        myFile.addDataArray(myArray);
+        myFile.setEncodingForWriting(GiftiEncodingEnum::EXTERNAL_FILE_BINARY);
+        myFile.writeFile(fileName);
+    }
+    
+    void removeFiles(const AString& fileName)
+    {
+        QFile::remove(fileName);
+        QFile::remove(fileName + ".data");
+    }
+}
+
+void GiftiMappedTest::execute()
+{
+    AString fileName = QDir::tempPath() + "/wb_gifti_mapped_test.gii";
+    try
+    {
+        writeIntFile(fileName, 1);
+        GiftiFile mappedFile;
+        mappedFile.readFile(fileName);
+        GiftiDataArray* mappedArray = mappedFile.getDataArray(0);
+        GiftiFile otherReader;//a second mapping of the same sidecar, which overwriting must not disturb
+        otherReader.readFile(fileName);
+        mappedArray->convertToDataType(NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32);
+        const float* converted = mappedArray->getDataPointerFloat();
+        for (int32_t i = 0; i < NUM_VALUES; ++i)
+        {
+            if (converted[i] != (float)(i * 3 + 1))
+            {
+                setFailed("INT32 to FLOAT32 conversion of external binary data gave " + AString::number(converted[i]) + " instead of " + AString::number(i * 3 + 1));
+                break;
+            }
+        }
+#ifdef CARET_OS_WINDOWS
+        bool refused = false;
+        try
+        {
+            writeIntFile(fileName, 7);
+        } catch (CaretException&) {
+            refused = true;//a mapped file can't be replaced on windows, the writer must refuse rather than corrupt it
+        }
+        if (!refused && otherReader.getDataArray(0)->isDataMapped()) setFailed("replacing a mapped external file was not refused");
+        removeFiles(fileName);
+        return;
+#endif
+        writeIntFile(fileName, 7);//replace the sidecar while otherReader may still map it
+        const int32_t* oldData = otherReader.getDataArray(0)->getDataPointerInt();
+        for (int32_t i = 0; i < NUM_VALUES; ++i)
+        {
+            if (oldData[i] != i * 3 + 1)
+            {
+                setFailed("data read before the external file was overwritten changed");
+                break;
+            }
+        }
+        GiftiFile newReader;
+        newReader.readFile(fileName);
+        const int32_t* newData = newReader.getDataArray(0)->getDataPointerInt();
+        for (int32_t i = 0; i < NUM_VALUES; ++i)
+        {
+            if (newData[i] != i * 3 + 7)
+            {
+                setFailed("overwritten external file has the wrong data");
+                break;
+            }
+        }
+    } catch (CaretException& e) {
+        setFailed("exception: " + e.whatString());
+    }
+    removeFiles(fileName);
+}
@@ -0,0 +1,175 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "GroupReductionTest.h"
+
+#include "CaretOMP.h"
+#include "GroupReduction.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+GroupReductionTest::GroupReductionTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void GroupReductionTest::execute()
+{
+    const int NUM_INPUTS = 12;
+    const int64_t NUM_ELEMENTS = 1 << 16;//enough that the accumulation loops are split across threads
+    vector<vector<float> > inputs(NUM_INPUTS, vector<float>(NUM_ELEMENTS)), masks(NUM_INPUTS, vector<float>(NUM_ELEMENTS));
+    vector<float> weights(NUM_INPUTS);
+    for (int j = 0; j < NUM_INPUTS; ++j)
+    {
+        weights[j] = 0.5f + j * 0.25f;
+        for (int64_t k = 0; k < NUM_ELEMENTS; ++k)
+        {
+            inputs[j][k] = (rand() * 100.0f / RAND_MAX) - 50.0f + 1000.0f * (k % 7);//include offsets, to catch naive sum of squares
+            masks[j][k] = ((k + j) % 5 == 0 ? 1.0f : 0.0f);
+        }
+        inputs[j][j] = numeric_limits<float>::quiet_NaN();//some non-numeric values
+    }
+    for (int j = 0; j < NUM_INPUTS; ++j)
+    {
+        masks[j][1000] = 1.0f;//one element with everything excluded
+    }
+    GroupReduction myReduction(NUM_ELEMENTS, true);
+    for (int j = 0; j < NUM_INPUTS; ++j)
+    {
+        myReduction.addInput(inputs[j].data(), weights[j], masks[j].data());
+    }
+    vector<float> mean(NUM_ELEMENTS), sampleVar(NUM_ELEMENTS), popVar(NUM_ELEMENTS);
+    myReduction.getMean(mean.data());
+    myReduction.getVariance(sampleVar.data());
+    myReduction.getVariance(popVar.data(), false);
+    for (int64_t k = 0; k < NUM_ELEMENTS; ++k)
+    {//serial two-pass reference
+        double weightSum = 0.0, weightSquaredSum = 0.0, accum = 0.0;
+        for (int j = 0; j < NUM_INPUTS; ++j)
+        {
+            if (masks[j][k] > 0.0f || inputs[j][k] != inputs[j][k]) continue;
+            weightSum += weights[j];
+            weightSquaredSum += (double)weights[j] * weights[j];
+            accum += inputs[j][k] * weights[j];
+        }
+        double refMean = (weightSum != 0.0 ? accum / weightSum : 0.0), residSquared = 0.0;
+        for (int j = 0; j < NUM_INPUTS; ++j)
+        {
+            if (masks[j][k] > 0.0f || inputs[j][k] != inputs[j][k]) continue;
+            double temp = inputs[j][k] - refMean;
+            residSquared += weights[j] * temp * temp;
+        }
+        double refPopVar = (weightSum != 0.0 ? residSquared / weightSum : 0.0);
+        double refSampleVar = (weightSum != 0.0 ? residSquared / (weightSum - weightSquaredSum / weightSum) : 0.0);
+        if (mean[k] != (float)refMean)//same sums in the same order, so this should be exact
+        {
+            setFailed("mismatch in weighted mean at element " + AString::number(k) + ", serial: " + AString::number(refMean) + ", reduction: " + AString::number(mean[k]));
+            return;
+        }
+        if (abs(popVar[k] - refPopVar) > 1e-4 * (refPopVar + 1.0) || abs(sampleVar[k] - refSampleVar) > 1e-4 * (refSampleVar + 1.0))
+        {
+            setFailed("mismatch in weighted variance at element " + AString::number(k) + ", serial: " + AString::number(refSampleVar) + ", reduction: " + AString::number(sampleVar[k]));
+            return;
+        }
+    }
+    if (mean[1000] != 0.0f || sampleVar[1000] != 0.0f)
+    {
+        setFailed("fully excluded element should give zero mean and variance");
+    }
+    GroupReduction equalWeights(3, true);//equal weights should give the ordinary sample variance
+    const float first[3] = { 1.0f, 2.0f, 3.0f }, second[3] = { 3.0f, 2.0f, 5.0f };
+    equalWeights.addInput(first);
+    equalWeights.addInput(second);
+    float variance[3];
+    equalWeights.getVariance(variance);
+    if (abs(variance[0] - 2.0f) > 1e-6f || variance[1] != 0.0f || abs(variance[2] - 2.0f) > 1e-6f)
+    {
+        setFailed("unweighted sample variance incorrect: " + AString::number(variance[0]) + ", " + AString::number(variance[1]) + ", " + AString::number(variance[2]));
+    }
+    GroupReduction meanOnly(3), withVariance(3, true);//zero and negative weights must not change the mean when variance is requested
+    const float third[3] = { 4.0f, -1.0f, 7.0f };
+    const float oddWeights[3] = { 1.0f, -1.0f, 0.0f };
+    const float* oddInputs[3] = { first, second, third };
+    float meanOnlyOut[3], withVarianceOut[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        meanOnly.addInput(oddInputs[j], oddWeights[j]);
+        withVariance.addInput(oddInputs[j], oddWeights[j]);
+        meanOnly.getMean(meanOnlyOut);
+        withVariance.getMean(withVarianceOut);
+        for (int k = 0; k < 3; ++k)
+        {
+            if (meanOnly.getWeightSums()[k] != withVariance.getWeightSums()[k] || meanOnlyOut[k] != withVarianceOut[k])
+            {
+                setFailed("computing variance changed the mean with zero or negative weights, after input " + AString::number(j) + ", element " + AString::number(k));
+            }
+        }
+    }
+    GroupReduction keepNaN(1, false, false);
+    const float nanValue = numeric_limits<float>::quiet_NaN(), one = 1.0f;
+    keepNaN.addInput(&one);
+    keepNaN.addInput(&nanValue);
+    float nanMean;
+    keepNaN.getMean(&nanMean);
+    if (nanMean == nanMean)
+    {
+        setFailed("non-numeric values should propagate when not skipped");
+    }
+    vector<float> singleMean(NUM_ELEMENTS), singleVar(NUM_ELEMENTS), multiMean(NUM_ELEMENTS), multiVar(NUM_ELEMENTS);
+#ifdef CARET_OMP
+    int maxThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    {
+        GroupReduction singleThread(NUM_ELEMENTS, true);
+        for (int j = 0; j < NUM_INPUTS; ++j)
+        {
+            singleThread.addInput(inputs[j].data(), weights[j], masks[j].data());
+        }
+        singleThread.getMean(singleMean.data());
+        singleThread.getVariance(singleVar.data());
+    }
+#ifdef CARET_OMP
+    omp_set_num_threads(maxThreads < 4 ? 4 : maxThreads);//use several threads even on small machines
+#endif
+    {
+        GroupReduction multiThread(NUM_ELEMENTS, true);
+        for (int j = 0; j < NUM_INPUTS; ++j)
+        {
+            multiThread.addInput(inputs[j].data(), weights[j], masks[j].data());
+        }
+        multiThread.getMean(multiMean.data());
+        multiThread.getVariance(multiVar.data());
+    }
+#ifdef CARET_OMP
+    omp_set_num_threads(maxThreads);
+#endif
+    for (int64_t k = 0; k < NUM_ELEMENTS; ++k)
+    {
+        if (singleMean[k] != multiMean[k] || singleVar[k] != multiVar[k])
+        {
+            setFailed("group reduction at element " + AString::number(k) + " depends on the number of threads");
+            break;
+        }
+    }
+}
@@ -21,8 +21,12 @@
 
 #include "CaretCompactLookup.h"
 #include "CaretCompact3DLookup.h"
+#include "GiftiLabel.h"
+#include "GiftiLabelTable.h"
+#include "GiftiLabelTableLookup.h"
 
 #include <cstdlib>
+#include <set>
 
 using namespace caret;
 using namespace std;
@@ -104,4 +108,36 @@ void LookupTest::execute()
           }
       }      
    }
+   
+    {//label table lookup, which must be rebuilt when labels are deleted
+        GiftiLabelTable myTable;
+        const int32_t keepKey = myTable.addLabel("keep", 1.0f, 0.0f, 0.0f, 1.0f);
+        const int32_t dropKey = myTable.addLabel("drop", 0.0f, 1.0f, 0.0f, 1.0f);
+        CaretPointer<const GiftiLabelTableLookup> before = myTable.getLookup();
+        if (before->findIndex(dropKey) < 0) setFailed("label table lookup is missing a label");
+        set<int32_t> usedKeys;
+        usedKeys.insert(keepKey);
+        myTable.deleteUnusedLabels(usedKeys);
+        CaretPointer<const GiftiLabelTableLookup> after = myTable.getLookup();
+        if (after.getPointer() == before.getPointer())
+        {
+            setFailed("label table lookup was not rebuilt after deleting unused labels");
+        }
+        if (after->findIndex(dropKey) >= 0)
+        {
+            setFailed("label table lookup still has a deleted label");
+        }
+        const int32_t keepIndex = after->findIndex(keepKey);
+        if (keepIndex < 0 || after->getLabelAtIndex(keepIndex) != myTable.getLabel(keepKey))
+        {
+            setFailed("label table lookup lost a kept label");
+        }
+        for (int32_t i = 0; i < after->getNumberOfLabels(); ++i)
+        {
+            if (myTable.getLabel(after->getLabelAtIndex(i)->getKey()) != after->getLabelAtIndex(i))
+            {
+                setFailed("label table lookup has a label that is not in the table");
+            }
+        }
+    }
 }
@@ -0,0 +1,192 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "MultiReductionTest.h"
+
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "MultiReduction.h"
+#include "ReductionEnum.h"
+#include "ReductionOperation.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+MultiReductionTest::MultiReductionTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_ELEMENTS = 500;
+    const int64_t NUM_COLUMNS = 256;
+    
+    bool closeEnough(const float& value, const float& reference)
+    {
+        if (value == reference) return true;
+        return abs(value - reference) <= 1e-4f * max(1.0f, abs(reference));
+    }
+    
+    //accumulate each column in row order, in parallel over columns like -cifti-stats
+    void accumulateColumns(const vector<float>& rowMajor, vector<MultiReduction::Accumulator>& accumsOut)
+    {
+        accumsOut.assign(NUM_COLUMNS, MultiReduction::Accumulator());
+#pragma omp CARET_PARFOR schedule(static)
+        for (int64_t i = 0; i < NUM_COLUMNS; ++i)
+        {
+            for (int64_t r = 0; r < NUM_ELEMENTS; ++r)
+            {
+                accumsOut[i].add(rowMajor[r * NUM_COLUMNS + i]);
+            }
+        }
+    }
+}
+
+void MultiReductionTest::execute()
+{
+    vector<float> data(NUM_ELEMENTS), offsetData(NUM_ELEMENTS), nanData(NUM_ELEMENTS);
+    for (int64_t i = 0; i < NUM_ELEMENTS; ++i)
+    {
+        data[i] = 0.9f + (rand() % 21) * 0.01f;//repeated values for MODE, product stays in range
+        offsetData[i] = (i % 10 == 0 ? 0.0f : 1000.0f + data[i] * (i % 3 == 0 ? -1.0f : 1.0f));//zeros for COUNT_NONZERO, offset to catch naive variance
+        nanData[i] = (i % 17 == 0 ? numeric_limits<float>::quiet_NaN() : offsetData[i]);
+    }
+    data[NUM_ELEMENTS / 2] = 2.0f;//an outlier for -exclude-outliers
+    vector<ReductionEnum::Enum> allEnums, testEnums;
+    ReductionEnum::getAllEnums(allEnums);
+    for (int i = 0; i < (int)allEnums.size(); ++i)
+    {
+        if (allEnums[i] != ReductionEnum::INVALID) testEnums.push_back(allEnums[i]);
+    }
+    const int numTypes = (int)testEnums.size();
+    MultiReduction allReduce, streamReduce;
+    for (int t = 0; t < numTypes; ++t)
+    {
+        allReduce.addReduction(testEnums[t]);
+        if (testEnums[t] != ReductionEnum::MEDIAN && testEnums[t] != ReductionEnum::MODE) streamReduce.addReduction(testEnums[t]);
+    }
+    allReduce.addPercentile(0.0f);
+    allReduce.addPercentile(50.0f);
+    allReduce.addPercentile(100.0f);
+    try
+    {
+        const vector<float>* testData[2] = { &data, &offsetData };
+        for (int d = 0; d < 2; ++d)
+        {
+            const float* myData = testData[d]->data();
+            vector<float> results(allReduce.getNumberOfResults()), onlyNumeric(allReduce.getNumberOfResults()), excluded(allReduce.getNumberOfResults());
+            allReduce.compute(myData, NUM_ELEMENTS, results.data());
+            allReduce.computeOnlyNumeric(nanData.data(), NUM_ELEMENTS, onlyNumeric.data());
+            allReduce.computeExcludeDev(myData, NUM_ELEMENTS, excluded.data(), 2.0f, 2.0f);
+            for (int t = 0; t < numTypes; ++t)
+            {//serial reference, one reduction at a time
+                const AString name = ReductionEnum::toName(testEnums[t]);
+                float reference = ReductionOperation::reduce(myData, NUM_ELEMENTS, testEnums[t]);
+                if (!closeEnough(results[t], reference))
+                {
+                    setFailed(name + " gave " + AString::number(results[t]) + ", serial reduction gave " + AString::number(reference));
+                }
+                if (d == 1)
+                {
+                    reference = ReductionOperation::reduceOnlyNumeric(nanData.data(), NUM_ELEMENTS, testEnums[t]);
+                    if (!closeEnough(onlyNumeric[t], reference))
+                    {
+                        setFailed(name + " of only numeric values gave " + AString::number(onlyNumeric[t]) + ", serial reduction gave " + AString::number(reference));
+                    }
+                }
+                reference = ReductionOperation::reduceExcludeDev(myData, NUM_ELEMENTS, testEnums[t], 2.0f, 2.0f);
+                if (!closeEnough(excluded[t], reference))
+                {
+                    setFailed(name + " excluding outliers gave " + AString::number(excluded[t]) + ", serial reduction gave " + AString::number(reference));
+                }
+            }
+            const float percentileRefs[3] = { ReductionOperation::reduce(myData, NUM_ELEMENTS, ReductionEnum::MIN),
+                                              ReductionOperation::reduce(myData, NUM_ELEMENTS, ReductionEnum::MEDIAN),
+                                              ReductionOperation::reduce(myData, NUM_ELEMENTS, ReductionEnum::MAX) };
+            for (int p = 0; p < 3; ++p)
+            {
+                if (!closeEnough(results[numTypes + p], percentileRefs[p]))
+                {
+                    setFailed(allReduce.getResultName(numTypes + p) + " gave " + AString::number(results[numTypes + p]) + ", expected " + AString::number(percentileRefs[p]));
+                }
+            }
+        }
+        
+        const int numStream = streamReduce.getNumberOfResults();
+        vector<float> rowMajor(NUM_ELEMENTS * NUM_COLUMNS), column(NUM_ELEMENTS);
+        for (int64_t i = 0; i < NUM_ELEMENTS * NUM_COLUMNS; ++i)
+        {
+            rowMajor[i] = 0.9f + (rand() % 21) * 0.01f + ((i / NUM_COLUMNS) % 7 == 0 ? 1000.0f : 0.0f);
+        }
+        vector<MultiReduction::Accumulator> singleAccums, multiAccums;
+#ifdef CARET_OMP
+        int maxThreads = omp_get_max_threads();
+        omp_set_num_threads(1);
+#endif
+        accumulateColumns(rowMajor, singleAccums);
+#ifdef CARET_OMP
+        omp_set_num_threads(maxThreads < 4 ? 4 : maxThreads);
+#endif
+        accumulateColumns(rowMajor, multiAccums);
+#ifdef CARET_OMP
+        omp_set_num_threads(maxThreads);
+#endif
+        vector<float> singleResults(numStream), multiResults(numStream), mergedResults(numStream), reference(numStream);
+        for (int64_t i = 0; i < NUM_COLUMNS; ++i)
+        {
+            for (int64_t r = 0; r < NUM_ELEMENTS; ++r)
+            {
+                column[r] = rowMajor[r * NUM_COLUMNS + i];
+            }
+            MultiReduction::Accumulator first, second, third;//uneven blocks, merged in order
+            for (int64_t r = 0; r < NUM_ELEMENTS; ++r)
+            {
+                (r < 100 ? first : (r < 333 ? second : third)).add(column[r]);
+            }
+            first.merge(second);
+            first.merge(third);
+            streamReduce.getResults(singleAccums[i], singleResults.data());
+            streamReduce.getResults(multiAccums[i], multiResults.data());
+            streamReduce.getResults(first, mergedResults.data());
+            streamReduce.compute(column.data(), NUM_ELEMENTS, reference.data());
+            for (int t = 0; t < numStream; ++t)
+            {
+                const AString name = streamReduce.getResultName(t);
+                if (multiResults[t] != singleResults[t])
+                {
+                    setFailed("streaming " + name + " of column " + AString::number(i) + " depends on the number of threads");
+                }
+                if (!closeEnough(singleResults[t], reference[t]))
+                {
+                    setFailed("streaming " + name + " of column " + AString::number(i) + " gave " + AString::number(singleResults[t]) + ", whole column gave " + AString::number(reference[t]));
+                }
+                if (!closeEnough(mergedResults[t], reference[t]))
+                {
+                    setFailed("merged " + name + " of column " + AString::number(i) + " gave " + AString::number(mergedResults[t]) + ", whole column gave " + AString::number(reference[t]));
+                }
+            }
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+}
@@ -20,9 +20,21 @@
 
 #include "NiftiTest.h"
 
+#include "CiftiFile.h"
+#include "CiftiScalarsMap.h"
+#include "DataFileException.h"
+#include "FloatMatrix.h"
 #include "MultiDimIterator.h"
 #include "NiftiIO.h"
+#include "NiftiOutputDataType.h"
+#include "VolumeFile.h"
 
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
 
 using namespace std;
@@ -159,3 +171,120 @@ void NiftiHeaderTest::writeNifti2Header(AString filename, NiftiHeader &header)
     myFile.open(filename, CaretBinaryFile::WRITE_TRUNCATE);
     header.write(myFile, 2);
 }
+
+//Tests for writing scaled integer datatypes
+
+NiftiScaledWriteTest::NiftiScaledWriteTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    void checkScaledRoundTrip(NiftiScaledWriteTest* theTest, const AString& condition, const vector<float>& values, const NiftiOutputDataType& type, const double& typeSteps)
+    {
+        vector<int64_t> dims(3, 1);
+        dims[0] = (int64_t)values.size();
+        VolumeFile outVol(dims, FloatMatrix::identity(4).getMatrix());
+        outVol.setFrame(values.data());
+        outVol.setWritingDataType(type);
+        AString fileName = QDir::tempPath() + "/wb_scaled_write_test.nii";
+        VolumeFile inVol;
+        try
+        {
+            outVol.writeFile(fileName);
+            inVol.readFile(fileName);
+        } catch (DataFileException& e) {
+            QFile::remove(fileName);
+            theTest->setFailed(condition + ", " + e.whatString());
+            return;
+        }
+        QFile::remove(fileName);
+        const float* readBack = inVol.getFrame();
+        double minVal = *min_element(values.begin(), values.end()), maxVal = *max_element(values.begin(), values.end());
+        if (type.hasRange())
+        {
+            minVal = min(minVal, -20.0);//the explicit range used below
+            maxVal = max(maxVal, 20.0);
+        }
+        const double maxAbs = max(abs(minVal), abs(maxVal));
+        const double tolerance = (maxVal - minVal) / typeSteps + maxAbs * numeric_limits<float>::epsilon();//one type step, plus float rounding of the read values
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            if (!(abs(readBack[i] - values[i]) <= tolerance))
+            {
+                theTest->setFailed(condition + ", wrote " + AString::number(values[i], 'g', 10) + ", read back " + AString::number(readBack[i], 'g', 10));
+                return;
+            }
+        }
+    }
+
+    void checkRefusedCifti(NiftiScaledWriteTest* theTest, const bool& onDisk)
+    {
+        const AString condition = (onDisk ? "on-disk cifti writing" : "cifti writeFile");
+        CiftiScalarsMap rowMap, colMap;
+        rowMap.setLength(10);
+        colMap.setLength(20);
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        myXML.setMap(CiftiXML::ALONG_ROW, rowMap);
+        myXML.setMap(CiftiXML::ALONG_COLUMN, colMap);
+        vector<float> row(10, 1.0f);
+        AString fileName = QDir::tempPath() + "/wb_refused_write_test.nii";
+        QFile::remove(fileName);
+        bool threw = false;
+        try
+        {
+            CiftiFile outFile;
+            outFile.setWritingDataType(NiftiOutputDataType::fromName("INT16"));
+            if (onDisk) outFile.setWritingFile(fileName);
+            outFile.setCiftiXML(myXML);
+            for (int i = 0; i < 20; ++i)
+            {
+                if (i == 15) row[3] = 0.5f;//can't be stored as INT16, after the header and some rows are written
+                outFile.setRow(row.data(), i);
+            }
+            outFile.writeFile(fileName);
+        } catch (DataFileException&) {
+            threw = true;
+        }
+        if (!threw) theTest->setFailed(condition + ", value that INT16 can't store was accepted");
+        if (QFile::exists(fileName))
+        {
+            QFile::remove(fileName);
+            theTest->setFailed(condition + ", refused data left a partial file behind");
+        }
+    }
+}
+
+void NiftiScaledWriteTest::execute()
+{
+    const int NUM_VALUES = 1000;
+    vector<float> values(NUM_VALUES), offsetValues(NUM_VALUES);
+    for (int i = 0; i < NUM_VALUES; ++i)
+    {
+        values[i] = -3.7f + 16.6f * i / (NUM_VALUES - 1);
+        offsetValues[i] = 1000000.0f + (float)i / (NUM_VALUES - 1);//narrow range far from zero, rounding the offset to float matters here
+    }
+    NiftiOutputDataType int16Scaled = NiftiOutputDataType::fromName("INT16_SCALED"), uint8Scaled = NiftiOutputDataType::fromName("UINT8_SCALED");
+    checkScaledRoundTrip(this, "INT16_SCALED", values, int16Scaled, 65535.0);
+    checkScaledRoundTrip(this, "UINT8_SCALED", values, uint8Scaled, 255.0);
+    checkScaledRoundTrip(this, "INT16_SCALED with large offset", offsetValues, int16Scaled, 65535.0);
+    checkScaledRoundTrip(this, "UINT8_SCALED with large offset", offsetValues, uint8Scaled, 255.0);
+    NiftiOutputDataType int16Range = int16Scaled, uint8Range = uint8Scaled;//as given by -output-datatype-range
+    int16Range.setRange(-20.0, 20.0);
+    uint8Range.setRange(-20.0, 20.0);
+    checkScaledRoundTrip(this, "INT16_SCALED with explicit range", values, int16Range, 65535.0);
+    checkScaledRoundTrip(this, "UINT8_SCALED with explicit range", values, uint8Range, 255.0);
+    vector<float> outside(values);
+    outside[0] = -25.0f;
+    bool threw = false;
+    try
+    {
+        int16Range.checkData(outside.data(), NUM_VALUES);
+    } catch (DataFileException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("value outside the explicit range was accepted");
+    checkRefusedCifti(this, false);
+    checkRefusedCifti(this, true);
+}
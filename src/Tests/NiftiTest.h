@@ -44,6 +44,13 @@ public:
     void writeNifti2Header(AString filename, NiftiHeader &header);
 };
 
+class NiftiScaledWriteTest : public TestInterface
+{
+public:
+    NiftiScaledWriteTest(const AString& identifier);
+    virtual void execute();
+};
+
 
 }
 
@@ -0,0 +1,191 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2015  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "SceneFileTest.h"
+
+#include "CaretException.h"
+#include "Scene.h"
+#include "SceneClass.h"
+#include "SceneFile.h"
+#include "SceneFileSaxReader.h"
+#include "XmlSaxParser.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <memory>
+
+using namespace caret;
+using namespace std;
+
+SceneFileTest::SceneFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    //markup that a scan for scene boundaries could mistake for structure: comments, CDATA,
+    //'>' inside attribute values, and scene tags inside text
+    const char* SCENE_FILE_TEXT =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!-- a comment mentioning <Scene Index=\"9\" Type=\"SCENE_TYPE_FULL\"> and </Scene> -->\n"
+    "<SceneFile Version=\"2\">\n"
+    "<SceneInfoDirectory>\n"
+    "<BalsaStudyID><![CDATA[]]></BalsaStudyID>\n"
+    "<BaseDirectory><![CDATA[]]></BaseDirectory>\n"
+    "<SceneInfo Index=\"0\"><Name><![CDATA[first]]></Name><BalsaSceneID><![CDATA[]]></BalsaSceneID><Description><![CDATA[has <Scene> in it]]></Description></SceneInfo>\n"
+    "<SceneInfo Index=\"1\"><Name><![CDATA[second]]></Name><BalsaSceneID><![CDATA[]]></BalsaSceneID><Description><![CDATA[]]></Description></SceneInfo>\n"
+    "<SceneInfo Index=\"2\"><Name><![CDATA[empty]]></Name><BalsaSceneID><![CDATA[]]></BalsaSceneID><Description><![CDATA[]]></Description></SceneInfo>\n"
+    "</SceneInfoDirectory>\n"
+    "<Scene Index=\"0\" Type=\"SCENE_TYPE_FULL\">\n"
+    "<Name><![CDATA[first]]></Name>\n"
+    "<Description><![CDATA[has <Scene> in it]]></Description>\n"
+    "<!-- </Scene> inside a comment -->\n"
+    "<Object Type=\"class\" Class=\"guiManager\" Name=\"guiManager\" Version=\"1\">\n"
+    "<Object Type=\"string\" Name=\"tricky\"><![CDATA[</Object></Scene><Scene Index=\"5\">]]></Object>\n"
+    "<Object Type=\"integer\" Name=\"count>1\">3</Object>\n"
+    "<Object Type=\"class\" Class=\"Child>Class\" Name=\"m_child\" Version=\"1\">\n"
+    "<Object Type=\"float\" Name=\"m_value\">2.5</Object>\n"
+    "</Object>\n"
+    "</Object>\n"
+    "</Scene>\n"
+    "<Scene Index=\"1\" Type=\"SCENE_TYPE_FULL\">\n"
+    "<Name><![CDATA[second]]></Name>\n"
+    "<Description><![CDATA[]]></Description>\n"
+    "<Object Type=\"class\" Class=\"guiManager\" Name=\"guiManager\" Version=\"1\">\n"
+    "<Object Type=\"string\" Name=\"text\"><![CDATA[<Scene Type=\"SCENE_TYPE_FULL\">]]></Object>\n"
+    "<Object Type=\"boolean\" Name=\"flag\">true</Object>\n"
+    "</Object>\n"
+    "</Scene>\n"
+    "<Scene Index=\"2\" Type=\"SCENE_TYPE_FULL\"><Name><![CDATA[empty]]></Name><Description><![CDATA[]]></Description></Scene>\n"
+    "</SceneFile>\n";
+    
+    bool writeText(const AString& fileName, const QByteArray& text)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) return false;
+        bool ret = (file.write(text) == text.size());
+        file.close();
+        return ret;
+    }
+    
+    QByteArray readText(const AString& fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly)) return QByteArray();
+        return file.readAll();
+    }
+}
+
+void SceneFileTest::execute()
+{
+    const AString fileName = QDir::tempPath() + "/wb_scene_file_test.scene";
+    const AString lazyOutName = QDir::tempPath() + "/wb_scene_file_test_lazy.scene";
+    const AString fullOutName = QDir::tempPath() + "/wb_scene_file_test_full.scene";
+    try
+    {
+        if (!writeText(fileName, QByteArray(SCENE_FILE_TEXT)))
+        {
+            setFailed("unable to write " + fileName);
+            return;
+        }
+        SceneFile lazyFile;
+        lazyFile.readFile(fileName);
+        SceneFile fullFile;//the whole-file parse that readFile falls back to
+        fullFile.setFileName(fileName);
+        {
+            SceneFileSaxReader saxReader(&fullFile);
+            auto_ptr<XmlSaxParser> parser(XmlSaxParser::createXmlParser());
+            parser->parseFile(fileName, &saxReader);
+        }
+        if (lazyFile.getNumberOfScenes() != 3 || fullFile.getNumberOfScenes() != 3)
+        {
+            setFailed("expected 3 scenes, lazy read found " + AString::number(lazyFile.getNumberOfScenes()) + ", full parse found " + AString::number(fullFile.getNumberOfScenes()));
+            return;
+        }
+        if (!lazyFile.getSceneAtIndex(0)->hasDeferredContent() || !lazyFile.getSceneAtIndex(1)->hasDeferredContent())
+        {
+            setFailed("scene classes were not deferred, the scan fell back to a full parse");
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            const Scene* lazyScene = lazyFile.getSceneAtIndex(i);
+            const Scene* fullScene = fullFile.getSceneAtIndex(i);
+            if (lazyScene->getName() != fullScene->getName() || lazyScene->getDescription() != fullScene->getDescription())
+            {
+                setFailed("scene " + AString::number(i) + " name or description differs: '" + lazyScene->getName() + "' vs '" + fullScene->getName() + "'");
+            }
+            if (lazyScene->getNumberOfClasses() != fullScene->getNumberOfClasses())
+            {
+                setFailed("scene " + AString::number(i) + " has " + AString::number(lazyScene->getNumberOfClasses()) + " classes when deferred, " + AString::number(fullScene->getNumberOfClasses()) + " when fully parsed");
+            }
+        }
+        const SceneClass* firstGui = lazyFile.getSceneAtIndex(0)->getClassWithName("guiManager");
+        const SceneClass* secondGui = lazyFile.getSceneAtIndex(1)->getClassWithName("guiManager");
+        if (firstGui == NULL || secondGui == NULL)
+        {
+            setFailed("deferred scene is missing its guiManager class");
+            return;
+        }
+        if (firstGui->getStringValue("tricky") != "</Object></Scene><Scene Index=\"5\">")
+        {
+            setFailed("CDATA content read incorrectly: '" + firstGui->getStringValue("tricky") + "'");
+        }
+        if (firstGui->getIntegerValue("count>1", -1) != 3)
+        {
+            setFailed("object with '>' in its name attribute read incorrectly");
+        }
+        if (firstGui->getClass("m_child") == NULL || firstGui->getClass("m_child")->getFloatValue("m_value") != 2.5f)
+        {
+            setFailed("nested class read incorrectly");
+        }
+        if (secondGui->getStringValue("text") != "<Scene Type=\"SCENE_TYPE_FULL\">" || !secondGui->getBooleanValue("flag"))
+        {
+            setFailed("second scene read incorrectly");
+        }
+        lazyFile.writeFile(lazyOutName);
+        fullFile.writeFile(fullOutName);
+        QByteArray lazyText = readText(lazyOutName), fullText = readText(fullOutName);
+        if (lazyText.isEmpty() || lazyText != fullText)
+        {
+            setFailed("rewriting a deferred scene file differs from rewriting a fully parsed one");
+        }
+        
+        SceneFile changedFile;//a file that changes on disk before a scene is used must report an error, not an empty scene
+        changedFile.readFile(fileName);
+        if (!writeText(fileName, QByteArray(SCENE_FILE_TEXT) + "<!-- changed -->\n"))
+        {
+            setFailed("unable to rewrite " + fileName);
+        } else {
+            AString errorMessage;
+            if (changedFile.getSceneAtIndex(0)->loadDeferredContent(errorMessage) || errorMessage.isEmpty())
+            {
+                setFailed("loading a scene from a changed file did not report an error");
+            }
+            if (changedFile.getSceneAtIndex(0)->loadDeferredContent(errorMessage) || errorMessage.isEmpty())
+            {
+                setFailed("a failed scene load was not remembered");
+            }
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    QFile::remove(fileName);
+    QFile::remove(lazyOutName);
+    QFile::remove(fullOutName);
+}
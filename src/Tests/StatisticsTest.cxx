@@ -21,8 +21,10 @@
 #include <cstdlib>
 #include <cmath>
 
+#include "DataBlockSource.h"
 #include "FastStatistics.h"
 #include "DescriptiveStatistics.h"
+#include "Histogram.h"
 
 using namespace caret;
 using namespace std;
@@ -76,4 +78,34 @@ void StatisticsTest::execute()
     {
         setFailed(AString("mismatch in 90% negative percentile, full: ") + AString::number(myFullStats.getNegativePercentile(90.0f)) + ", fast: " + AString::number(myFastStats.getApproxNegativePercentile(90.0f)));
     }
+    MemoryBlockSource myBlocks;//uneven arrays, so blocks don't line up with the array boundaries
+    myBlocks.addArray(myData.data(), NUM_ELEMENTS / 3);
+    myBlocks.addArray(myData.data() + NUM_ELEMENTS / 3, NUM_ELEMENTS - NUM_ELEMENTS / 3);
+    FastStatistics myBlockStats;
+    myBlockStats.update(myBlocks);
+    if (abs(myBlockStats.getMean() - myFastStats.getMean()) > exacttolerance)
+    {
+        setFailed(AString("mismatch in block mean, array: ") + AString::number(myFastStats.getMean()) + ", block: " + AString::number(myBlockStats.getMean()));
+    }
+    if (abs(myBlockStats.getSampleStdDev() - myFastStats.getSampleStdDev()) > exacttolerance)
+    {
+        setFailed(AString("mismatch in block sample stddev, array: ") + AString::number(myFastStats.getSampleStdDev()) + ", block: " + AString::number(myBlockStats.getSampleStdDev()));
+    }
+    if (abs(myBlockStats.getApproxAbsolutePercentile(90.0f) - myFastStats.getApproxAbsolutePercentile(90.0f)) > exacttolerance)
+    {
+        setFailed(AString("mismatch in block 90% absolute percentile, array: ") + AString::number(myFastStats.getApproxAbsolutePercentile(90.0f)) + ", block: " + AString::number(myBlockStats.getApproxAbsolutePercentile(90.0f)));
+    }
+    Histogram myArrayHist, myBlockHist, myArrayLimitedHist, myBlockLimitedHist;
+    myArrayHist.update(myData.data(), NUM_ELEMENTS);
+    myBlockHist.update(myBlocks);
+    if (myArrayHist.getHistogramCounts() != myBlockHist.getHistogramCounts())
+    {
+        setFailed("mismatch in block histogram counts");
+    }
+    myArrayLimitedHist.update(myData.data(), NUM_ELEMENTS, 40.0f, 10.0f, -10.0f, -40.0f, false);
+    myBlockLimitedHist.update(myBlocks, 40.0f, 10.0f, -10.0f, -40.0f, false);
+    if (myArrayLimitedHist.getHistogramCounts() != myBlockLimitedHist.getHistogramCounts())
+    {
+        setFailed("mismatch in block limited histogram counts");
+    }
 }
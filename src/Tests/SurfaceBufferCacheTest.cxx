@@ -0,0 +1,153 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2015  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "SurfaceBufferCacheTest.h"
+
+#include "BrainOpenGLSurfaceBufferCache.h"
+#include "CaretException.h"
+#include "SurfaceFile.h"
+
+#include <utility>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+SurfaceBufferCacheTest::SurfaceBufferCacheTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_VERTICES = 20;
+    const int64_t MAX_GAP = 2;
+    
+    AString rangesToString(const vector<pair<int64_t, int64_t> >& ranges)
+    {
+        AString ret;
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            ret += "[" + AString::number(ranges[i].first) + ", " + AString::number(ranges[i].second) + ")";
+        }
+        return ret;
+    }
+}
+
+void SurfaceBufferCacheTest::testChangedRanges()
+{
+    const vector<float> previous(NUM_VERTICES * 4, 0.5f);
+    struct RangeCase
+    {
+        const char* m_name;
+        int m_changed[NUM_VERTICES];//vertex indices, terminated by -1
+        const char* m_expected;
+    };
+    const RangeCase cases[] = {
+        { "no change", { -1 }, "" },
+        { "single vertex", { 5, -1 }, "[5, 6)" },
+        { "last vertex", { NUM_VERTICES - 1, -1 }, "[19, 20)" },
+        { "adjacent run", { 3, 4, 5, -1 }, "[3, 6)" },
+        { "runs within the gap", { 3, 6, 7, -1 }, "[3, 8)" },
+        { "distant runs", { 3, 4, 8, 15, -1 }, "[3, 5)[8, 9)[15, 16)" }
+    };
+    const int numCases = sizeof(cases) / sizeof(cases[0]);
+    vector<pair<int64_t, int64_t> > ranges;
+    for (int i = 0; i < numCases; ++i)
+    {
+        vector<float> changed = previous;
+        for (int j = 0; cases[i].m_changed[j] >= 0; ++j)
+        {
+            changed[cases[i].m_changed[j] * 4 + 3] = 1.0f;//alpha only, every component must be compared
+        }
+        BrainOpenGLSurfaceBufferCache::findChangedVertexRanges(&previous[0], &changed[0], NUM_VERTICES, MAX_GAP, ranges);
+        if (rangesToString(ranges) != cases[i].m_expected)
+        {
+            setFailed(AString(cases[i].m_name) + ": expected ranges " + cases[i].m_expected + ", got " + rangesToString(ranges));
+        }
+    }
+    const vector<float> allChanged(NUM_VERTICES * 4, 1.0f);
+    BrainOpenGLSurfaceBufferCache::findChangedVertexRanges(&previous[0], &allChanged[0], NUM_VERTICES, MAX_GAP, ranges);
+    if (rangesToString(ranges) != "[0, 20)")
+    {
+        setFailed("all vertices: expected ranges [0, 20), got " + rangesToString(ranges));
+    }
+}
+
+void SurfaceBufferCacheTest::testSurfaceStamps()
+{
+    SurfaceFile surface;
+    surface.setNumberOfNodesAndTriangles(4, 2);
+    const float coords[] = { 0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f, 0.0f };
+    surface.setCoordinates(coords);
+    surface.setTriangle(0, 0, 1, 2);
+    surface.setTriangle(1, 1, 3, 2);
+    surface.computeNormals();
+    const int64_t coordStamp = surface.getCoordinateModificationStamp();
+    const int64_t topoStamp = surface.getTopologyModificationStamp();
+    surface.computeNormals();//already computed, nothing changes
+    if (surface.getCoordinateModificationStamp() != coordStamp || surface.getTopologyModificationStamp() != topoStamp)
+    {
+        setFailed("stamps changed without a modification");
+    }
+    
+    surface.setCoordinate(3, 1.0f, 1.0f, 0.5f);
+    surface.computeNormals();
+    const int64_t movedStamp = surface.getCoordinateModificationStamp();
+    if (movedStamp == coordStamp)
+    {
+        setFailed("coordinate stamp did not change after setCoordinate");
+    }
+    if (surface.getTopologyModificationStamp() != topoStamp)
+    {
+        setFailed("topology stamp changed after setCoordinate");
+    }
+    
+    surface.setCoordinates(coords);
+    surface.computeNormals();
+    const int64_t resetStamp = surface.getCoordinateModificationStamp();
+    if (resetStamp == movedStamp || resetStamp == coordStamp)
+    {
+        setFailed("coordinate stamp did not get a new value after setCoordinates");
+    }
+    
+    surface.flipNormals();
+    if (surface.getTopologyModificationStamp() == topoStamp)
+    {
+        setFailed("topology stamp did not change after flipNormals");
+    }
+    
+    SurfaceFile otherSurface;//a different surface, possibly at a reused address, must never match
+    otherSurface.setNumberOfNodesAndTriangles(4, 2);
+    otherSurface.setCoordinates(coords);
+    if (otherSurface.getCoordinateModificationStamp() == surface.getCoordinateModificationStamp() ||
+        otherSurface.getTopologyModificationStamp() == surface.getTopologyModificationStamp())
+    {
+        setFailed("two surfaces share a stamp");
+    }
+}
+
+void SurfaceBufferCacheTest::execute()
+{
+    try
+    {
+        testChangedRanges();
+        testSurfaceStamps();
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+}
@@ -20,7 +20,9 @@
 #include "VolumeFileTest.h"
 
 #include "FloatMatrix.h"
+#include "Matrix4x4.h"
 #include "VolumeFile.h"
+#include "VolumeFileEditorDelegate.h"
 
 #include <cstdlib>
 
@@ -110,4 +112,70 @@ void VolumeFileTest::execute()
             }
         }
     }
+    testFloodFillUndo();
+}
+
+void VolumeFileTest::testFloodFillUndo()
+{//a wall at k = half splits the volume, 3D fill below it, then undo and redo
+    const int64_t dim = 48, half = dim / 2;
+    vector<int64_t> myDims(3, dim);
+    VolumeFile myTestVol;
+    myTestVol.reinitialize(myDims, FloatMatrix::identity(4).getMatrix());
+    myTestVol.setValueAllVoxels(0.0f);
+    for (int64_t j = 0; j < dim; ++j)
+    {
+        for (int64_t i = 0; i < dim; ++i)
+        {
+            myTestVol.setValue(1.0f, i, j, half);
+        }
+    }
+    VolumeFileEditorDelegate* myEditor = myTestVol.getVolumeFileEditorDelegate();
+    myEditor->updateIfVolumeFileChangedNumberOfMaps();
+    myEditor->setLocked(0, false);
+    const float diffXYZ[3] = { 0.0f, 0.0f, 0.0f };
+    const int64_t seedIJK[3] = { 3, 5, 7 };
+    const int64_t brushSize[3] = { 1, 1, 1 };
+    AString errorMessage;
+    if (!myEditor->performEditingOperation(0, VolumeEditingModeEnum::VOLUME_EDITING_MODE_FLOOD_FILL_3D, VolumeSliceViewPlaneEnum::AXIAL,
+                                           VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_ORTHOGONAL, Matrix4x4(), diffXYZ, seedIJK, brushSize,
+                                           2.0f, 0.0f, errorMessage))
+    {
+        setFailed("flood fill failed: " + errorMessage);
+        return;
+    }
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        if (pass == 1 && !myEditor->undo(0, errorMessage))
+        {
+            setFailed("undo failed: " + errorMessage);
+            return;
+        }
+        if (pass == 2 && !myEditor->redo(0, errorMessage))
+        {
+            setFailed("redo failed: " + errorMessage);
+            return;
+        }
+        for (int64_t k = 0; k < dim; ++k)
+        {
+            float expected = 0.0f;
+            if (k == half)
+            {
+                expected = 1.0f;
+            } else if (k < half && pass != 1) {
+                expected = 2.0f;
+            }
+            for (int64_t j = 0; j < dim; ++j)
+            {
+                for (int64_t i = 0; i < dim; ++i)
+                {
+                    if (myTestVol.getValue(i, j, k) != expected)
+                    {
+                        setFailed("after pass " + AString::number(pass) + ", voxel (" + AString::number(i) + ", " + AString::number(j) + ", " + AString::number(k) +
+                                  ") was " + AString::number(myTestVol.getValue(i, j, k)) + ", expected " + AString::number(expected));
+                        return;
+                    }
+                }
+            }
+        }
+    }
 }
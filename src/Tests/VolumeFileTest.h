@@ -29,6 +29,7 @@ namespace caret {
     public:
         VolumeFileTest(const AString& identifier);
         virtual void execute();
+        void testFloodFillUndo();
     };
 
 }
@@ -0,0 +1,129 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "VolumeSmoothingTest.h"
+
+#include "AlgorithmVolumeSmoothing.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "VolumeFile.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+VolumeSmoothingTest::VolumeSmoothingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t XDIM = 23, YDIM = 19, ZDIM = 17;
+    
+    vector<vector<float> > makeSform()
+    {
+        vector<vector<float> > ret(4, vector<float>(4, 0.0f));
+        ret[0][0] = 2.0f;//orthogonal, so the separable smoother is used
+        ret[1][1] = 2.0f;
+        ret[2][2] = 2.5f;
+        ret[3][3] = 1.0f;
+        ret[0][3] = -20.0f;
+        return ret;
+    }
+    
+    //smooths with the current thread count, every frame and then a single subvolume
+    void smoothAll(const VolumeFile& inVol, const VolumeFile* roiVol, const bool& fixZeros, VolumeFile& allOut, VolumeFile& oneOut)
+    {
+        AlgorithmVolumeSmoothing(NULL, &inVol, 3.0f, &allOut, roiVol, fixZeros);
+        AlgorithmVolumeSmoothing(NULL, &inVol, 3.0f, &oneOut, roiVol, fixZeros, 1);
+    }
+    
+    bool sameFrames(const VolumeFile& first, const VolumeFile& second)
+    {
+        vector<int64_t> firstDims, secondDims;
+        first.getDimensions(firstDims);
+        second.getDimensions(secondDims);
+        if (firstDims != secondDims) return false;
+        const int64_t frameSize = firstDims[0] * firstDims[1] * firstDims[2];
+        for (int64_t b = 0; b < firstDims[3]; ++b)
+        {
+            if (memcmp(first.getFrame(b), second.getFrame(b), frameSize * sizeof(float)) != 0) return false;
+        }
+        return true;
+    }
+}
+
+void VolumeSmoothingTest::execute()
+{
+    int multiThreads = 4;
+#ifdef CARET_OMP
+    int maxThreads = omp_get_max_threads();
+    if (maxThreads > multiThreads) multiThreads = maxThreads;
+#endif
+    const int64_t numFrames = multiThreads + 1;//enough frames that every frame is given to one thread, with a partial last batch
+    vector<int64_t> dims(4);
+    dims[0] = XDIM; dims[1] = YDIM; dims[2] = ZDIM; dims[3] = numFrames;
+    VolumeFile inVol(dims, makeSform());
+    dims.resize(3);
+    VolumeFile roiVol(dims, makeSform());
+    const int64_t frameSize = XDIM * YDIM * ZDIM;
+    vector<float> frame(frameSize), roiFrame(frameSize);
+    for (int64_t v = 0; v < frameSize; ++v)
+    {
+        roiFrame[v] = ((v % XDIM) > 2 && (v / XDIM) % YDIM < YDIM - 3 ? 1.0f : 0.0f);//box shaped roi that doesn't touch every edge
+    }
+    roiVol.setFrame(roiFrame.data());
+    for (int64_t b = 0; b < numFrames; ++b)
+    {
+        for (int64_t v = 0; v < frameSize; ++v)
+        {
+            frame[v] = ((v * 7 + b * 13) % 11 == 0 ? 0.0f : (float)((v * 31 + b * 17) % 101) / 7.0f);//some zeros for -fix-zeros
+        }
+        inVol.setFrame(frame.data(), b);
+    }
+    try
+    {
+        for (int test = 0; test < 2; ++test)
+        {
+            const VolumeFile* useRoi = (test == 0 ? NULL : &roiVol);
+            const bool fixZeros = (test == 1);
+            VolumeFile singleAll, singleOne, multiAll, multiOne;
+#ifdef CARET_OMP
+            omp_set_num_threads(1);
+#endif
+            smoothAll(inVol, useRoi, fixZeros, singleAll, singleOne);
+#ifdef CARET_OMP
+            omp_set_num_threads(multiThreads);//all frames splits across frames, a single subvolume splits each pass
+#endif
+            smoothAll(inVol, useRoi, fixZeros, multiAll, multiOne);
+#ifdef CARET_OMP
+            omp_set_num_threads(maxThreads);
+#endif
+            const AString condition = (test == 0 ? "without roi" : "with roi and -fix-zeros");
+            if (!sameFrames(singleAll, multiAll)) setFailed("smoothing all frames " + condition + " differs between 1 and " + AString::number(multiThreads) + " threads");
+            if (!sameFrames(singleOne, multiOne)) setFailed("smoothing one subvolume " + condition + " differs between 1 and " + AString::number(multiThreads) + " threads");
+        }
+    } catch (CaretException& e) {
+#ifdef CARET_OMP
+        omp_set_num_threads(maxThreads);
+#endif
+        setFailed("smoothing failed: " + e.whatString());
+    }
+}
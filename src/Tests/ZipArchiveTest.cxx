@@ -0,0 +1,310 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "ZipArchiveTest.h"
+
+#include "CaretBinaryFile.h"
+#include "DataFileException.h"
+#include "ZipArchiveReader.h"
+
+#include <QDir>
+#include <QFile>
+#include "zlib.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+ZipArchiveTest::ZipArchiveTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t PAYLOAD_SIZE = 3 * 1024 * 1024 + 12345;//several reader chunks, and not a multiple of them
+    
+    struct TestMember
+    {
+        AString m_name;
+        vector<char> m_bytes;//as stored in the archive
+        uint16_t m_method;
+        uint32_t m_crc;
+        int64_t m_uncompressedSize;
+    };
+    
+    void appendLE16(vector<char>& out, const uint16_t& value)
+    {
+        out.push_back((char)(value & 0xFF));
+        out.push_back((char)(value >> 8));
+    }
+    
+    void appendLE32(vector<char>& out, const uint32_t& value)
+    {
+        appendLE16(out, (uint16_t)(value & 0xFFFF));
+        appendLE16(out, (uint16_t)(value >> 16));
+    }
+    
+    void appendLE64(vector<char>& out, const uint64_t& value)
+    {
+        appendLE32(out, (uint32_t)(value & 0xFFFFFFFFULL));
+        appendLE32(out, (uint32_t)(value >> 32));
+    }
+    
+    //windowBits as for deflateInit2, negative for a raw deflate stream, 31 for gzip
+    bool compressBytes(const vector<char>& input, const int& windowBits, vector<char>& output)
+    {
+        z_stream myStream;
+        memset(&myStream, 0, sizeof(myStream));
+        if (deflateInit2(&myStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+        output.resize(deflateBound(&myStream, (uLong)input.size()) + 32);//gzip header isn't in the bound for old zlib
+        myStream.next_in = (Bytef*)input.data();
+        myStream.avail_in = (uInt)input.size();
+        myStream.next_out = (Bytef*)output.data();
+        myStream.avail_out = (uInt)output.size();
+        int ret = deflate(&myStream, Z_FINISH);
+        output.resize(myStream.total_out);
+        deflateEnd(&myStream);
+        return ret == Z_STREAM_END;
+    }
+    
+    //writes the archive by hand, so that the zip64 records can be tested without 4GB of data
+    bool writeZip(const AString& fileName, const vector<TestMember>& members, const bool& zip64)
+    {
+        vector<char> archive, directory;
+        const uint16_t version = (zip64 ? 45 : 20);
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            const TestMember& thisMember = members[i];
+            QByteArray name = thisMember.m_name.toUtf8();
+            const int64_t localOffset = (int64_t)archive.size();
+            vector<char> localExtra, centralExtra;
+            if (zip64)
+            {
+                appendLE16(localExtra, 0x0001);
+                appendLE16(localExtra, 16);
+                appendLE64(localExtra, thisMember.m_uncompressedSize);
+                appendLE64(localExtra, thisMember.m_bytes.size());
+                appendLE16(centralExtra, 0x0001);
+                appendLE16(centralExtra, 24);
+                appendLE64(centralExtra, thisMember.m_uncompressedSize);
+                appendLE64(centralExtra, thisMember.m_bytes.size());
+                appendLE64(centralExtra, localOffset);
+            }
+            const uint32_t compressedField = (zip64 ? 0xFFFFFFFFU : (uint32_t)thisMember.m_bytes.size());
+            const uint32_t uncompressedField = (zip64 ? 0xFFFFFFFFU : (uint32_t)thisMember.m_uncompressedSize);
+            appendLE32(archive, 0x04034b50);
+            appendLE16(archive, version);
+            appendLE16(archive, 0x800);//utf-8 name
+            appendLE16(archive, thisMember.m_method);
+            appendLE32(archive, 0);//time and date
+            appendLE32(archive, thisMember.m_crc);
+            appendLE32(archive, compressedField);
+            appendLE32(archive, uncompressedField);
+            appendLE16(archive, (uint16_t)name.size());
+            appendLE16(archive, (uint16_t)localExtra.size());
+            archive.insert(archive.end(), name.constData(), name.constData() + name.size());
+            archive.insert(archive.end(), localExtra.begin(), localExtra.end());
+            archive.insert(archive.end(), thisMember.m_bytes.begin(), thisMember.m_bytes.end());
+            appendLE32(directory, 0x02014b50);
+            appendLE16(directory, version);//made by
+            appendLE16(directory, version);//needed
+            appendLE16(directory, 0x800);
+            appendLE16(directory, thisMember.m_method);
+            appendLE32(directory, 0);
+            appendLE32(directory, thisMember.m_crc);
+            appendLE32(directory, compressedField);
+            appendLE32(directory, uncompressedField);
+            appendLE16(directory, (uint16_t)name.size());
+            appendLE16(directory, (uint16_t)centralExtra.size());
+            appendLE16(directory, 0);//comment
+            appendLE16(directory, 0);//disk
+            appendLE16(directory, 0);//internal attributes
+            appendLE32(directory, 0);//external attributes
+            appendLE32(directory, (zip64 ? 0xFFFFFFFFU : (uint32_t)localOffset));
+            directory.insert(directory.end(), name.constData(), name.constData() + name.size());
+            directory.insert(directory.end(), centralExtra.begin(), centralExtra.end());
+        }
+        const int64_t directoryOffset = (int64_t)archive.size();
+        archive.insert(archive.end(), directory.begin(), directory.end());
+        if (zip64)
+        {
+            const int64_t zip64EndOffset = (int64_t)archive.size();
+            appendLE32(archive, 0x06064b50);
+            appendLE64(archive, 44);//size of the rest of the record
+            appendLE16(archive, version);
+            appendLE16(archive, version);
+            appendLE32(archive, 0);
+            appendLE32(archive, 0);
+            appendLE64(archive, members.size());
+            appendLE64(archive, members.size());
+            appendLE64(archive, directory.size());
+            appendLE64(archive, directoryOffset);
+            appendLE32(archive, 0x07064b50);
+            appendLE32(archive, 0);
+            appendLE64(archive, zip64EndOffset);
+            appendLE32(archive, 1);
+        }
+        appendLE32(archive, 0x06054b50);
+        appendLE16(archive, 0);
+        appendLE16(archive, 0);
+        appendLE16(archive, (zip64 ? 0xFFFF : (uint16_t)members.size()));
+        appendLE16(archive, (zip64 ? 0xFFFF : (uint16_t)members.size()));
+        appendLE32(archive, (zip64 ? 0xFFFFFFFFU : (uint32_t)directory.size()));
+        appendLE32(archive, (zip64 ? 0xFFFFFFFFU : (uint32_t)directoryOffset));
+        appendLE16(archive, 0);
+        QFile myFile(fileName);
+        if (!myFile.open(QIODevice::WriteOnly)) return false;
+        return myFile.write(archive.data(), archive.size()) == (int64_t)archive.size();
+    }
+    
+    //reads the whole member, then reads pieces after forward and backward seeks
+    void checkMemberReads(ZipArchiveTest* theTest, const AString& path, const vector<char>& payload)
+    {
+        try
+        {
+            const int64_t FORWARD_POS = PAYLOAD_SIZE / 3 + 17;
+            vector<char> forwardPiece(1000);
+            CaretBinaryFile forwardFile(path);//a compressed stream skips forward without decompressing into memory
+            forwardFile.seek(FORWARD_POS);
+            forwardFile.read(forwardPiece.data(), forwardPiece.size());
+            if (memcmp(forwardPiece.data(), payload.data() + FORWARD_POS, forwardPiece.size()) != 0)
+            {
+                theTest->setFailed("read after forward seek in '" + path + "' doesn't match");
+                return;
+            }
+            CaretBinaryFile myFile(path);
+            vector<char> readBack(payload.size());
+            myFile.read(readBack.data(), readBack.size());
+            if (readBack != payload)
+            {
+                theTest->setFailed("sequential read of '" + path + "' doesn't match");
+                return;
+            }
+            char extra = 0;
+            int64_t numRead = -1;
+            myFile.read(&extra, 1, &numRead);
+            if (numRead != 0)
+            {
+                theTest->setFailed("read past the end of '" + path + "' returned data");
+                return;
+            }
+            const int64_t PIECE_SIZE = 5000;
+            const int64_t positions[] = { 0, PAYLOAD_SIZE / 2, 1000, PAYLOAD_SIZE - PIECE_SIZE, PAYLOAD_SIZE / 3, 2 * PAYLOAD_SIZE / 3, 7 };
+            vector<char> piece(PIECE_SIZE);
+            for (int i = 0; i < (int)(sizeof(positions) / sizeof(positions[0])); ++i)
+            {
+                myFile.seek(positions[i]);
+                if (myFile.pos() != positions[i])
+                {
+                    theTest->setFailed("seek in '" + path + "' to " + AString::number(positions[i]) + " reported position " + AString::number(myFile.pos()));
+                    return;
+                }
+                myFile.read(piece.data(), PIECE_SIZE);
+                if (memcmp(piece.data(), payload.data() + positions[i], PIECE_SIZE) != 0)
+                {
+                    theTest->setFailed("read after seek to " + AString::number(positions[i]) + " in '" + path + "' doesn't match");
+                    return;
+                }
+                if (myFile.pos() != positions[i] + PIECE_SIZE)
+                {
+                    theTest->setFailed("position after read in '" + path + "' is wrong");
+                    return;
+                }
+            }
+        } catch (DataFileException& e) {
+            theTest->setFailed("reading '" + path + "' failed: " + e.whatString());
+        }
+    }
+    
+    void checkArchive(ZipArchiveTest* theTest, const vector<TestMember>& members, const vector<char>& payload, const bool& zip64)
+    {
+        const AString fileName = QDir::tempPath() + (zip64 ? "/wb_zip_archive_test64.zip" : "/wb_zip_archive_test.zip");
+        if (!writeZip(fileName, members, zip64))
+        {
+            theTest->setFailed("failed to write test archive '" + fileName + "'");
+            QFile::remove(fileName);
+            return;
+        }
+        try
+        {
+            ZipArchiveReader myReader(fileName);
+            if (myReader.getMembers().size() != members.size()) theTest->setFailed("wrong number of members in '" + fileName + "'");
+            for (size_t i = 0; i < members.size(); ++i)
+            {
+                const ZipArchiveReader::Member* found = myReader.findMember(members[i].m_name);
+                if (found == NULL)
+                {
+                    theTest->setFailed("member '" + members[i].m_name + "' not found in '" + fileName + "'");
+                    continue;
+                }
+                if (found->m_method != members[i].m_method || found->m_crc != members[i].m_crc ||
+                    found->m_compressedSize != (int64_t)members[i].m_bytes.size() || found->m_uncompressedSize != members[i].m_uncompressedSize)
+                {
+                    theTest->setFailed("directory entry for '" + members[i].m_name + "' in '" + fileName + "' doesn't match");
+                }
+                checkMemberReads(theTest, fileName + "/" + members[i].m_name, payload);
+            }
+            if (myReader.findMember("data/missing.bin") != NULL) theTest->setFailed("found a member that doesn't exist");
+        } catch (DataFileException& e) {
+            theTest->setFailed("reading the directory of '" + fileName + "' failed: " + e.whatString());
+        }
+        bool threw = false;
+        try
+        {
+            CaretBinaryFile myFile(fileName + "/" + members[0].m_name, CaretBinaryFile::WRITE);
+        } catch (DataFileException&) {
+            threw = true;
+        }
+        if (!threw) theTest->setFailed("zip member was opened for writing");
+        QFile::remove(fileName);
+    }
+}
+
+void ZipArchiveTest::execute()
+{
+    vector<char> payload(PAYLOAD_SIZE);
+    uint32_t state = 12345;
+    for (int64_t i = 0; i < PAYLOAD_SIZE; ++i)
+    {
+        state = state * 1103515245U + 12345U;
+        payload[i] = (char)((i / 64) + (state >> 29));//compressible, but not trivially
+    }
+    const uint32_t payloadCrc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)payload.data(), (uInt)payload.size());
+    vector<TestMember> members(3);
+    members[0].m_name = "data/stored.bin";
+    members[0].m_bytes = payload;
+    members[0].m_method = 0;
+    members[1].m_name = "data/deflated.bin";
+    members[1].m_method = 8;
+    members[2].m_name = "data/gzipped.bin.gz";//stored in the zip, gunzipped by the reader
+    members[2].m_method = 0;
+    if (!compressBytes(payload, -MAX_WBITS, members[1].m_bytes) || !compressBytes(payload, 31, members[2].m_bytes))
+    {
+        setFailed("failed to compress test data");
+        return;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        members[i].m_uncompressedSize = (members[i].m_method == 0 ? (int64_t)members[i].m_bytes.size() : PAYLOAD_SIZE);
+        members[i].m_crc = (members[i].m_method == 0 ? crc32(crc32(0L, Z_NULL, 0), (const Bytef*)members[i].m_bytes.data(), (uInt)members[i].m_bytes.size()) : payloadCrc);
+    }
+    checkArchive(this, members, payload, false);
+    checkArchive(this, members, payload, true);
+}
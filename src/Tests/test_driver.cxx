@@ -33,21 +33,32 @@
 #include "CaretException.h"
 
 //tests
+#include "BorderOptimizeTest.h"
 #include "CiftiFileTest.h"
+#include "CommandBatchTest.h"
+#include "FeatureDrawCacheTest.h"
+#include "FiberBinghamTest.h"
 #include "GeodesicHelperTest.h"
+#include "GiftiMappedTest.h"
+#include "GroupReductionTest.h"
 #include "HttpTest.h"
 #include "HeapTest.h"
 #include "LookupTest.h"
 #include "MathExpressionTest.h"
+#include "MultiReductionTest.h"
 #include "NiftiTest.h"
 #include "PointerTest.h"
 #include "ProgressTest.h"
 #include "QuatTest.h"
+#include "SceneFileTest.h"
 #include "StatisticsTest.h"
+#include "SurfaceBufferCacheTest.h"
 #include "TimerTest.h"
 #include "TopologyHelperTest.h"
 #include "VolumeFileTest.h"
+#include "VolumeSmoothingTest.h"
 #include "XnatTest.h"
+#include "ZipArchiveTest.h"
 
 using namespace std;
 using namespace caret;
@@ -68,22 +79,34 @@ int main(int argc, char** argv)
         caret_global_commandLine_init(argc, argv);
         SessionManager::createSessionManager(ApplicationTypeEnum::APPLICATION_TYPE_COMMAND_LINE);
         vector<TestInterface*> mytests;
+        mytests.push_back(new BorderOptimizeTest("borderoptimize"));
         mytests.push_back(new CiftiFileTest("ciftifile"));
+        mytests.push_back(new CommandBatchTest("commandbatch"));
+        mytests.push_back(new FeatureDrawCacheTest("featuredrawcache"));
+        mytests.push_back(new FiberBinghamTest("fiberbingham"));
         mytests.push_back(new GeodesicHelperTest("geohelp"));
+        mytests.push_back(new GiftiMappedTest("giftimapped"));
+        mytests.push_back(new GroupReductionTest("groupreduction"));
         mytests.push_back(new HeapTest("heap"));
         mytests.push_back(new HttpTest("http"));
         mytests.push_back(new LookupTest("lookup"));
         mytests.push_back(new MathExpressionTest("mathexpression"));
+        mytests.push_back(new MultiReductionTest("multireduction"));
         mytests.push_back(new NiftiFileTest("niftifile"));
         mytests.push_back(new NiftiHeaderTest("niftiheader"));
+        mytests.push_back(new NiftiScaledWriteTest("niftiscaledwrite"));
         mytests.push_back(new PointerTest("pointer"));
         mytests.push_back(new ProgressTest("progress"));
         mytests.push_back(new QuatTest("quaternion"));
+        mytests.push_back(new SceneFileTest("scenefile"));
         mytests.push_back(new StatisticsTest("statistics"));
+        mytests.push_back(new SurfaceBufferCacheTest("surfacebuffercache"));
         mytests.push_back(new TimerTest("timer"));
         mytests.push_back(new TopologyHelperTest("topohelp"));
         mytests.push_back(new VolumeFileTest("volumefile"));
+        mytests.push_back(new VolumeSmoothingTest("volumesmoothing"));
         mytests.push_back(new XnatTest("xnat"));
+        mytests.push_back(new ZipArchiveTest("ziparchive"));
         if (argc < 2)
         {
             cout << "No test specified, please specify one of the following:" << endl;